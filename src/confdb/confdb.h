@@ -102,6 +102,11 @@
 #else
 #define CONFDB_RESPONDER_CACHE_FIRST_DEFAILT true
 #endif
+#define CONFDB_RESPONDER_PARALLEL_DOMAIN_SEARCH "parallel_domain_search"
+#define CONFDB_RESPONDER_HOT_CACHE_SIZE "hot_object_cache_size"
+#define CONFDB_RESPONDER_HOT_CACHE_SIZE_DEFAULT 0
+#define CONFDB_RESPONDER_HOT_CACHE_TIMEOUT "hot_object_cache_timeout"
+#define CONFDB_RESPONDER_HOT_CACHE_TIMEOUT_DEFAULT 5
 
 /* NSS */
 #define CONFDB_NSS_CONF_ENTRY "config/nss"
@@ -124,6 +129,7 @@
 #define CONFDB_NSS_MEMCACHE_SIZE_GROUP "memcache_size_group"
 #define CONFDB_NSS_MEMCACHE_SIZE_INITGROUPS "memcache_size_initgroups"
 #define CONFDB_NSS_MEMCACHE_SIZE_SID "memcache_size_sid"
+#define CONFDB_NSS_MEMCACHE_SIZE_NEGATIVE "memcache_size_negative"
 #define CONFDB_NSS_HOMEDIR_SUBSTRING "homedir_substring"
 #define CONFDB_DEFAULT_HOMEDIR_SUBSTRING "/home"
 
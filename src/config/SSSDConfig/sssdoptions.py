@@ -28,6 +28,9 @@ class SSSDOptions(object):
         'client_idle_timeout': _('Idle time before automatic disconnection of a client'),
         'responder_idle_timeout': _('Idle time before automatic shutdown of the responder'),
         'cache_first': _('Always query all the caches before querying the Data Providers'),
+        'parallel_domain_search': _('Search all domains at the same time in domain-less lookups'),
+        'hot_object_cache_size': _('Number of objects kept in the in-memory object cache of the responder'),
+        'hot_object_cache_timeout': _('How long are objects kept in the in-memory object cache of the responder'),
         'offline_timeout': _('When SSSD switches to offline mode the amount of time before it tries to go back online '
                              'will increase based upon the time spent disconnected. This value is in seconds and '
                              'calculated by the following: offline_timeout + random_offset.'),
@@ -77,6 +80,8 @@ class SSSDOptions(object):
             'Size (in megabytes) of the data table allocated inside fast in-memory cache for group requests'),
         'memcache_size_initgroups': _(
             'Size (in megabytes) of the data table allocated inside fast in-memory cache for initgroups requests'),
+        'memcache_size_negative': _(
+            'Size (in megabytes) of the data table allocated inside fast in-memory cache for negative entries'),
         'homedir_substring': _('The value of this option will be used in the expansion of the override_homedir option '
                                'if the template contains the format string %H.'),
         'get_domains_timeout': _('Specifies time in seconds for which the list of subdomains will be considered '
@@ -349,6 +354,8 @@ class SSSDOptions(object):
         'krb5_canonicalize': _("Enables principal canonicalization"),
         'krb5_use_enterprise_principal': _("Enables enterprise principals"),
         'krb5_use_subdomain_realm': _("Enables using of subdomains realms for authentication"),
+        'krb5_child_pool_size': _('Number of pre-forked krb5_child worker processes'),
+        'krb5_child_max_requests': _('Number of requests a krb5_child worker handles before it is replaced'),
         'krb5_map_user': _('A mapping from user names to Kerberos principal names'),
 
         # [provider/krb5/chpass]
@@ -383,10 +390,18 @@ class SSSDOptions(object):
         'ldap_krb5_init_creds': _('Use Kerberos auth for LDAP connection'),
         'ldap_referrals': _('Follow LDAP referrals'),
         'ldap_krb5_ticket_lifetime': _('Lifetime of TGT for LDAP connection'),
+        'ldap_krb5_persistent_child': _('Keep the TGT for LDAP connections in a long-running ldap_child'),
         'ldap_deref': _('How to dereference aliases'),
         'ldap_dns_service_name': _('Service name for DNS service lookups'),
         'ldap_page_size': _('The number of records to retrieve in a single LDAP query'),
         'ldap_deref_threshold': _('The number of members that must be missing to trigger a full deref'),
+        'ldap_group_nesting_concurrency': _('Maximum number of group members looked up in parallel'),
+        'ldap_group_parents_cache_timeout': _('How long to keep the parent groups found by initgroups in memory'),
+        'ldap_refresh_usn_full_interval': _('How often expired entries are refreshed one by one instead of with a USN based search'),
+        'ldap_change_notification': _('Whether to subscribe to notifications about changed entries on the server'),
+        'ldap_connection_pool_size': _('Maximum number of connections used for identity lookups'),
+        'ldap_page_size_min': _('The smallest number of records to retrieve in a single LDAP query'),
+        'ldap_page_size_max': _('The largest number of records to retrieve in a single LDAP query'),
         'ldap_ignore_unreadable_references': _('Ignore unreadable LDAP references'),
         'ldap_sasl_canonicalize': _('Whether the LDAP library should perform a reverse lookup to canonicalize the '
                                     'host name during a SASL bind'),
@@ -337,6 +337,9 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'client_idle_timeout',
             'responder_idle_timeout',
             'cache_first',
+            'parallel_domain_search',
+            'hot_object_cache_size',
+            'hot_object_cache_timeout',
             'description',
             'certificate_verification',
             'override_space',
@@ -660,6 +663,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_subdomain_realm',
+             'krb5_child_pool_size',
+             'krb5_child_max_requests',
              'krb5_use_kdcinfo',
              'krb5_map_user'])
 
@@ -824,6 +829,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'krb5_canonicalize',
             'krb5_use_enterprise_principal',
             'krb5_use_subdomain_realm',
+            'krb5_child_pool_size',
+            'krb5_child_max_requests',
             'krb5_use_kdcinfo',
             'krb5_map_user']
 
@@ -1027,6 +1034,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_subdomain_realm',
+             'krb5_child_pool_size',
+             'krb5_child_max_requests',
              'krb5_use_kdcinfo',
              'krb5_map_user'])
 
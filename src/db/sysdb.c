@@ -928,6 +928,232 @@ int sysdb_transaction_cancel(struct sysdb_ctx *sysdb)
     return sysdb_error_to_errno(ret);
 }
 
+/* Control entry handled by the memberof module, it is never stored */
+#define SYSDB_MEMBEROF_REBUILD "@MEMBEROF-REBUILD"
+/* Attribute of the control entry listing the DNs to recompute */
+#define SYSDB_MEMBEROF_AFFECTED "affected"
+
+struct sysdb_bulk_membership {
+    struct sysdb_ctx *sysdb;
+
+    /* DNs written in the session */
+    hash_table_t *affected;
+};
+
+static int sysdb_bulk_membership_destructor(struct sysdb_bulk_membership *bulk)
+{
+    sysdb_bulk_membership_leave(bulk);
+    return 0;
+}
+
+int sysdb_bulk_membership_start(TALLOC_CTX *mem_ctx,
+                                struct sysdb_ctx *sysdb,
+                                struct sysdb_bulk_membership **_bulk)
+{
+    struct sysdb_bulk_membership *bulk;
+    errno_t ret;
+
+    bulk = talloc_zero(mem_ctx, struct sysdb_bulk_membership);
+    if (bulk == NULL) {
+        return ENOMEM;
+    }
+    bulk->sysdb = sysdb;
+
+    ret = sss_hash_create(bulk, 0, &bulk->affected);
+    if (ret != EOK) {
+        talloc_free(bulk);
+        return ret;
+    }
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) {
+        talloc_free(bulk);
+        return ret;
+    }
+
+    talloc_set_destructor(bulk, sysdb_bulk_membership_destructor);
+
+    *_bulk = bulk;
+    return EOK;
+}
+
+void sysdb_bulk_membership_enter(struct sysdb_bulk_membership *bulk)
+{
+    if (bulk == NULL) {
+        return;
+    }
+
+    bulk->sysdb->bulk = bulk;
+}
+
+void sysdb_bulk_membership_leave(struct sysdb_bulk_membership *bulk)
+{
+    if (bulk == NULL) {
+        return;
+    }
+
+    if (bulk->sysdb->bulk == bulk) {
+        bulk->sysdb->bulk = NULL;
+    }
+}
+
+static int sysdb_bulk_membership_write(struct sysdb_ctx *sysdb,
+                                       struct ldb_message *msg,
+                                       bool add)
+{
+    struct ldb_request *req;
+    hash_value_t value;
+    hash_key_t key;
+    int ret;
+
+    ret = ldb_msg_sanity_check(sysdb->ldb, msg);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_linearized(msg->dn));
+    if (key.str == NULL) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+    value.type = HASH_VALUE_UNDEF;
+
+    ret = hash_enter(sysdb->bulk->affected, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    if (add) {
+        ret = ldb_build_add_req(&req, sysdb->ldb, sysdb->ldb, msg, NULL,
+                                NULL, ldb_op_default_callback, NULL);
+    } else {
+        ret = ldb_build_mod_req(&req, sysdb->ldb, sysdb->ldb, msg, NULL,
+                                NULL, ldb_op_default_callback, NULL);
+    }
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    ret = ldb_request_add_control(req, SYSDB_MEMBEROF_DEFER_OID, false, NULL);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+
+    /* always inside the transaction of the session */
+    ret = ldb_request(sysdb->ldb, req);
+    if (ret == LDB_SUCCESS) {
+        ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+    }
+
+done:
+    talloc_free(req);
+    return ret;
+}
+
+int sysdb_ldb_add(struct sysdb_ctx *sysdb, struct ldb_message *msg)
+{
+    if (sysdb->bulk == NULL) {
+        return ldb_add(sysdb->ldb, msg);
+    }
+
+    return sysdb_bulk_membership_write(sysdb, msg, true);
+}
+
+int sysdb_ldb_modify(struct sysdb_ctx *sysdb, struct ldb_message *msg)
+{
+    if (sysdb->bulk == NULL) {
+        return ldb_modify(sysdb->ldb, msg);
+    }
+
+    return sysdb_bulk_membership_write(sysdb, msg, false);
+}
+
+/* Ask the memberof module to recompute the memberships around the entries
+ * written in the session */
+static errno_t sysdb_bulk_membership_rebuild(struct sysdb_bulk_membership *bulk)
+{
+    struct sysdb_ctx *sysdb = bulk->sysdb;
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    hash_key_t *keys = NULL;
+    unsigned long count;
+    unsigned long i;
+    int ret;
+
+    if (hash_count(bulk->affected) == 0) {
+        /* nothing was written */
+        return EOK;
+    }
+
+    msg = ldb_msg_new(NULL);
+    if (msg == NULL) {
+        return ENOMEM;
+    }
+
+    msg->dn = ldb_dn_new(msg, sysdb->ldb, SYSDB_MEMBEROF_REBUILD);
+    if (msg->dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = hash_keys(bulk->affected, &count, &keys);
+    if (ret != HASH_SUCCESS) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_msg_add_empty(msg, SYSDB_MEMBEROF_AFFECTED, 0, &el);
+    if (ret != LDB_SUCCESS) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    el->values = talloc_array(msg, struct ldb_val, count);
+    if (el->values == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    el->num_values = count;
+
+    for (i = 0; i < count; i++) {
+        el->values[i].data = (uint8_t *)keys[i].str;
+        el->values[i].length = strlen(keys[i].str);
+    }
+
+    ret = ldb_add(sysdb->ldb, msg);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to add %s: [%s]\n",
+              SYSDB_MEMBEROF_REBUILD, ldb_errstring(sysdb->ldb));
+    }
+    ret = sysdb_error_to_errno(ret);
+
+done:
+    talloc_free(keys);
+    talloc_free(msg);
+    return ret;
+}
+
+int sysdb_bulk_membership_commit(struct sysdb_bulk_membership *bulk)
+{
+    struct sysdb_ctx *sysdb = bulk->sysdb;
+    errno_t ret;
+    errno_t sret;
+
+    sysdb_bulk_membership_leave(bulk);
+
+    ret = sysdb_bulk_membership_rebuild(bulk);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to recompute memberships\n");
+        sret = sysdb_transaction_cancel(sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to cancel transaction\n");
+        }
+        return ret;
+    }
+
+    return sysdb_transaction_commit(sysdb);
+}
+
 int compare_ldb_dn_comp_num(const void *m1, const void *m2)
 {
     struct ldb_message *msg1 = talloc_get_type(*(void **) discard_const(m1),
@@ -1930,6 +2156,29 @@ done:
     return differs;
 }
 
+bool sysdb_entry_msg_attrs_diff(struct sysdb_ctx *sysdb,
+                                struct ldb_dn *entry_dn,
+                                struct ldb_message *db_msg,
+                                struct sysdb_attrs *attrs,
+                                int mod_op)
+{
+    struct ldb_message *new_entry_msg;
+    bool differs = true;
+
+    if (sysdb->ldb_ts == NULL || is_ts_ldb_dn(entry_dn) == false) {
+        return true;
+    }
+
+    new_entry_msg = sysdb_attrs2msg(NULL, entry_dn, attrs, mod_op);
+    if (new_entry_msg == NULL) {
+        return true;
+    }
+
+    differs = sysdb_ldb_msg_difference(entry_dn, db_msg, new_entry_msg);
+    talloc_free(new_entry_msg);
+    return differs;
+}
+
 void ldb_debug_messages(void *context, enum ldb_debug_level level,
                         const char *fmt, va_list ap)
 {
@@ -525,6 +525,31 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb);
 int sysdb_transaction_commit(struct sysdb_ctx *sysdb);
 int sysdb_transaction_cancel(struct sysdb_ctx *sysdb);
 
+/* Bulk membership sessions defer the maintenance of the memberof, memberuid
+ * and ghost attributes of the entries written in the session. They are
+ * recomputed once, for the written entries and the entries nested in or
+ * above them, by sysdb_bulk_membership_commit(). This is cheaper when many
+ * groups are written, e.g. during enumeration. Until then the membership
+ * attributes of the entries written in the session are not up to date.
+ *
+ * sysdb_bulk_membership_start() opens a transaction. Only the writes done
+ * between sysdb_bulk_membership_enter() and sysdb_bulk_membership_leave()
+ * belong to the session. Leave the session before returning to the main
+ * loop so that writes done by other requests while the transaction is open
+ * are maintained as usual. The session is aborted with
+ * sysdb_transaction_cancel() and talloc_free(). */
+struct sysdb_bulk_membership;
+
+int sysdb_bulk_membership_start(TALLOC_CTX *mem_ctx,
+                                struct sysdb_ctx *sysdb,
+                                struct sysdb_bulk_membership **_bulk);
+/* bulk may be NULL, nothing is done then */
+void sysdb_bulk_membership_enter(struct sysdb_bulk_membership *bulk);
+void sysdb_bulk_membership_leave(struct sysdb_bulk_membership *bulk);
+/* Recompute the memberships and commit the transaction. The transaction is
+ * cancelled if the memberships cannot be recomputed. */
+int sysdb_bulk_membership_commit(struct sysdb_bulk_membership *bulk);
+
 /* functions related to subdomains */
 errno_t sysdb_domain_create(struct sysdb_ctx *sysdb, const char *domain_name);
 
@@ -1175,6 +1200,50 @@ int sysdb_store_group(struct sss_domain_info *domain,
                       uint64_t cache_timeout,
                       time_t now);
 
+/* An entry of sysdb_store_users_batch(), the fields have the same meaning
+ * as the arguments of sysdb_store_user(). The result of storing the entry
+ * is returned in ret. */
+struct sysdb_store_user_entry {
+    const char *name;
+    const char *pwd;
+    uid_t uid;
+    gid_t gid;
+    const char *gecos;
+    const char *homedir;
+    const char *shell;
+    const char *orig_dn;
+    struct sysdb_attrs *attrs;
+    char **remove_attrs;
+    uint64_t cache_timeout;
+
+    errno_t ret;
+};
+
+/* Stores all users in a single transaction. The existing entries are looked
+ * up with a single search and only modified if they differ. A failure to
+ * store one of the users does not fail the whole batch, it is only
+ * returned in the ret field of the entry. */
+errno_t sysdb_store_users_batch(struct sss_domain_info *domain,
+                                struct sysdb_store_user_entry *users,
+                                size_t num_users,
+                                time_t now);
+
+/* An entry of sysdb_store_groups_batch(), see sysdb_store_group() */
+struct sysdb_store_group_entry {
+    const char *name;
+    gid_t gid;
+    struct sysdb_attrs *attrs;
+    uint64_t cache_timeout;
+
+    errno_t ret;
+};
+
+/* Same as sysdb_store_users_batch() for groups */
+errno_t sysdb_store_groups_batch(struct sss_domain_info *domain,
+                                 struct sysdb_store_group_entry *groups,
+                                 size_t num_groups,
+                                 time_t now);
+
 int sysdb_add_group_member(struct sss_domain_info *domain,
                            const char *group,
                            const char *member,
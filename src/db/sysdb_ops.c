@@ -1281,7 +1281,8 @@ static errno_t sysdb_create_ts_usr(struct sss_domain_info *domain,
 }
 
 /* =Replace-Attributes-On-Entry=========================================== */
-static int sysdb_set_cache_entry_attr(struct ldb_context *ldb,
+static int sysdb_set_cache_entry_attr(struct sysdb_ctx *sysdb,
+                                      struct ldb_context *ldb,
                                       struct ldb_dn *entry_dn,
                                       struct sysdb_attrs *attrs,
                                       int mod_op)
@@ -1307,7 +1308,11 @@ static int sysdb_set_cache_entry_attr(struct ldb_context *ldb,
         goto done;
     }
 
-    lret = ldb_modify(ldb, msg);
+    if (ldb == sysdb->ldb) {
+        lret = sysdb_ldb_modify(sysdb, msg);
+    } else {
+        lret = ldb_modify(ldb, msg);
+    }
     if (lret != LDB_SUCCESS) {
         DEBUG(SSSDBG_MINOR_FAILURE,
               "ldb_modify failed: [%s](%d)[%s]\n",
@@ -1342,19 +1347,29 @@ static const char *get_attr_storage(int state_mask)
     return storage;
 }
 
-int sysdb_set_entry_attr(struct sysdb_ctx *sysdb,
-                         struct ldb_dn *entry_dn,
-                         struct sysdb_attrs *attrs,
-                         int mod_op)
+/* If db_msg is not NULL, it is the current entry in the cache and is used
+ * to find out whether the cache needs to be written instead of searching
+ * for the entry again. */
+static int sysdb_set_entry_attr_msg(struct sysdb_ctx *sysdb,
+                                    struct ldb_dn *entry_dn,
+                                    struct ldb_message *db_msg,
+                                    struct sysdb_attrs *attrs,
+                                    int mod_op)
 {
     bool sysdb_write = true;
     errno_t ret = EOK;
     errno_t tret = EOK;
     int state_mask = SSS_SYSDB_NO_CACHE;
 
-    sysdb_write = sysdb_entry_attrs_diff(sysdb, entry_dn, attrs, mod_op);
+    if (db_msg != NULL) {
+        sysdb_write = sysdb_entry_msg_attrs_diff(sysdb, entry_dn, db_msg,
+                                                 attrs, mod_op);
+    } else {
+        sysdb_write = sysdb_entry_attrs_diff(sysdb, entry_dn, attrs, mod_op);
+    }
     if (sysdb_write == true) {
-        ret = sysdb_set_cache_entry_attr(sysdb->ldb, entry_dn, attrs, mod_op);
+        ret = sysdb_set_cache_entry_attr(sysdb, sysdb->ldb, entry_dn,
+                                         attrs, mod_op);
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE,
                   "Cannot set attrs for %s, %d [%s]\n",
@@ -1393,6 +1408,14 @@ int sysdb_set_entry_attr(struct sysdb_ctx *sysdb,
     return ret;
 }
 
+int sysdb_set_entry_attr(struct sysdb_ctx *sysdb,
+                         struct ldb_dn *entry_dn,
+                         struct sysdb_attrs *attrs,
+                         int mod_op)
+{
+    return sysdb_set_entry_attr_msg(sysdb, entry_dn, NULL, attrs, mod_op);
+}
+
 static int sysdb_rep_ts_entry_attr(struct sysdb_ctx *sysdb,
                                    struct ldb_dn *entry_dn,
                                    struct sysdb_attrs *attrs)
@@ -1401,7 +1424,7 @@ static int sysdb_rep_ts_entry_attr(struct sysdb_ctx *sysdb,
         return EOK;
     }
 
-    return sysdb_set_cache_entry_attr(sysdb->ldb_ts, entry_dn,
+    return sysdb_set_cache_entry_attr(sysdb, sysdb->ldb_ts, entry_dn,
                                       attrs, SYSDB_MOD_REP);
 }
 
@@ -1641,7 +1664,7 @@ int sysdb_add_basic_user(struct sss_domain_info *domain,
     ret = sysdb_add_ulong(msg, SYSDB_CREATE_TIME, (unsigned long)time(NULL));
     if (ret) goto done;
 
-    ret = ldb_add(domain->sysdb->ldb, msg);
+    ret = sysdb_ldb_add(domain->sysdb, msg);
     ret = sysdb_error_to_errno(ret);
 
 done:
@@ -2059,7 +2082,7 @@ int sysdb_add_basic_group(struct sss_domain_info *domain,
     ret = sysdb_add_ulong(msg, SYSDB_CREATE_TIME, (unsigned long)time(NULL));
     if (ret) goto done;
 
-    ret = ldb_add(domain->sysdb->ldb, msg);
+    ret = sysdb_ldb_add(domain->sysdb, msg);
     ret = sysdb_error_to_errno(ret);
 
 done:
@@ -2376,7 +2399,7 @@ int sysdb_mod_group_member(struct sss_domain_info *domain,
         ERROR_OUT(ret, EINVAL, fail);
     }
 
-    ret = ldb_modify(domain->sysdb->ldb, msg);
+    ret = sysdb_ldb_modify(domain->sysdb, msg);
     if (ret != LDB_SUCCESS) {
         DEBUG(SSSDBG_MINOR_FAILURE,
               "ldb_modify failed: [%s](%d)[%s]\n",
@@ -2512,6 +2535,42 @@ done:
     return ret;
 }
 
+/* Replaces the attributes of a user or a group. db_msg is the entry as it
+ * was found in the cache by the caller or NULL. */
+static errno_t sysdb_set_obj_attr_msg(struct sss_domain_info *domain,
+                                      enum sysdb_obj_type obj_type,
+                                      const char *name,
+                                      struct ldb_message *db_msg,
+                                      struct sysdb_attrs *attrs)
+{
+    struct ldb_dn *dn;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = get_sysdb_obj_dn(tmp_ctx, domain, obj_type, name, &dn);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* In MPG domains a group can be found as a user entry, only use
+     * the message if it is the entry that is going to be modified. */
+    if (db_msg != NULL && ldb_dn_compare(dn, db_msg->dn) != 0) {
+        db_msg = NULL;
+    }
+
+    ret = sysdb_set_entry_attr_msg(domain->sysdb, dn, db_msg, attrs,
+                                   SYSDB_MOD_REP);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 /* =Store-Users-(Native/Legacy)-(replaces-existing-data)================== */
 
 static errno_t sysdb_store_new_user(struct sss_domain_info *domain,
@@ -2537,6 +2596,7 @@ static errno_t sysdb_store_user_attrs(struct sss_domain_info *domain,
                                       const char *orig_dn,
                                       struct sysdb_attrs *attrs,
                                       char **remove_attrs,
+                                      struct ldb_message *db_msg,
                                       uint64_t cache_timeout,
                                       time_t now);
 
@@ -2633,7 +2693,7 @@ int sysdb_store_user(struct sss_domain_info *domain,
 
         ret = sysdb_store_user_attrs(domain, name, uid, gid, gecos, homedir,
                                      shell, orig_dn, attrs, remove_attrs,
-                                     cache_timeout, now);
+                                     NULL, cache_timeout, now);
         if (ret != EOK) {
             DEBUG(SSSDBG_OP_FAILURE, "sysdb_store_user_attrs() failed: %d\n", ret);
         }
@@ -2723,6 +2783,7 @@ static errno_t sysdb_store_user_attrs(struct sss_domain_info *domain,
                                       const char *orig_dn,
                                       struct sysdb_attrs *attrs,
                                       char **remove_attrs,
+                                      struct ldb_message *db_msg,
                                       uint64_t cache_timeout,
                                       time_t now)
 {
@@ -2766,7 +2827,7 @@ static errno_t sysdb_store_user_attrs(struct sss_domain_info *domain,
                                   (now + cache_timeout) : 0));
     if (ret) return ret;
 
-    ret = sysdb_set_user_attr(domain, name, attrs, SYSDB_MOD_REP);
+    ret = sysdb_set_obj_attr_msg(domain, SYSDB_USER, name, db_msg, attrs);
     if (ret) return ret;
 
     if (remove_attrs) {
@@ -2797,6 +2858,7 @@ static errno_t sysdb_store_group_attrs(struct sss_domain_info *domain,
                                        const char *name,
                                        gid_t gid,
                                        struct sysdb_attrs *attrs,
+                                       struct ldb_message *db_msg,
                                        uint64_t cache_timeout,
                                        time_t now);
 
@@ -2882,7 +2944,7 @@ int sysdb_store_group(struct sss_domain_info *domain,
         }
 
         ret = sysdb_store_group_attrs(domain, name, gid, attrs,
-                                      cache_timeout, now);
+                                      NULL, cache_timeout, now);
     }
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Cache update failed: %d\n", ret);
@@ -2964,6 +3026,7 @@ static errno_t sysdb_store_group_attrs(struct sss_domain_info *domain,
                                        const char *name,
                                        gid_t gid,
                                        struct sysdb_attrs *attrs,
+                                       struct ldb_message *db_msg,
                                        uint64_t cache_timeout,
                                        time_t now)
 {
@@ -2992,7 +3055,7 @@ static errno_t sysdb_store_group_attrs(struct sss_domain_info *domain,
         return ret;
     }
 
-    ret = sysdb_set_group_attr(domain, name, attrs, SYSDB_MOD_REP);
+    ret = sysdb_set_obj_attr_msg(domain, SYSDB_GROUP, name, db_msg, attrs);
     if (ret) {
         DEBUG(SSSDBG_TRACE_LIBS, "sysdb_set_group_attr failed.\n");
         return ret;
@@ -3001,6 +3064,538 @@ static errno_t sysdb_store_group_attrs(struct sss_domain_info *domain,
     return EOK;
 }
 
+/* =Store-Users-And-Groups-In-Batches===================================== */
+
+static errno_t sysdb_batch_hash_add(hash_table_t *table,
+                                    const char *name,
+                                    void *ptr)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+    value.type = HASH_VALUE_PTR;
+    value.ptr = ptr;
+
+    hret = hash_enter(table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to add [%s] to hash table: %s\n",
+              name, hash_error_string(hret));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static void *sysdb_batch_hash_lookup(hash_table_t *table, const char *name)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+
+    hret = hash_lookup(table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return value.ptr;
+}
+
+/* Looks up the existing users or groups with the given names in a single
+ * search. The returned array contains the entry of each name in the same
+ * order or NULL if the entry does not exist. The entries are read from the
+ * cache only, without the timestamp attributes, so they can be compared
+ * with the new attributes. */
+static errno_t sysdb_search_by_names(TALLOC_CTX *mem_ctx,
+                                     struct sss_domain_info *domain,
+                                     enum sysdb_obj_type type,
+                                     const char **names,
+                                     size_t num_names,
+                                     struct ldb_message ***_msgs)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { "*", NULL };
+    const char *class_filter;
+    struct ldb_message **found = NULL;
+    struct ldb_message **msgs;
+    struct ldb_message_element *el;
+    struct ldb_dn *basedn;
+    hash_table_t *table;
+    size_t found_count = 0;
+    char *sanitized_name;
+    char *lc_sanitized_name;
+    const char *name;
+    char *filter;
+    size_t i;
+    size_t j;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    switch (type) {
+    case SYSDB_USER:
+        class_filter = SYSDB_UC;
+        basedn = sysdb_user_base_dn(tmp_ctx, domain);
+        break;
+    case SYSDB_GROUP:
+        if (sss_domain_is_mpg(domain)) {
+            class_filter = SYSDB_MPGC;
+            basedn = sysdb_domain_dn(tmp_ctx, domain);
+        } else {
+            class_filter = SYSDB_GC;
+            basedn = sysdb_group_base_dn(tmp_ctx, domain);
+        }
+        break;
+    default:
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (basedn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    filter = talloc_asprintf(tmp_ctx, "(&(%s)(|", class_filter);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        ret = sss_filter_sanitize_for_dom(tmp_ctx, names[i], domain,
+                                          &sanitized_name,
+                                          &lc_sanitized_name);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        filter = talloc_asprintf_append(filter, "(%s=%s)(%s=%s)(%s=%s)",
+                                        SYSDB_NAME_ALIAS, lc_sanitized_name,
+                                        SYSDB_NAME_ALIAS, sanitized_name,
+                                        SYSDB_NAME, sanitized_name);
+        if (filter == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        talloc_free(sanitized_name);
+        talloc_free(lc_sanitized_name);
+    }
+
+    filter = talloc_strdup_append(filter, "))");
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_entry(tmp_ctx, domain->sysdb, basedn, LDB_SCOPE_SUBTREE,
+                             filter, attrs, &found_count, &found);
+    if (ret != EOK && ret != ENOENT) {
+        goto done;
+    }
+
+    msgs = talloc_zero_array(tmp_ctx, struct ldb_message *, num_names);
+    if (msgs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (found_count == 0) {
+        *_msgs = talloc_steal(mem_ctx, msgs);
+        ret = EOK;
+        goto done;
+    }
+
+    /* Map all names and aliases of the found entries to the entry */
+    ret = sss_hash_create(tmp_ctx, found_count * 2, &table);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < found_count; i++) {
+        el = ldb_msg_find_element(found[i], SYSDB_NAME_ALIAS);
+        for (j = 0; el != NULL && j < el->num_values; j++) {
+            ret = sysdb_batch_hash_add(table,
+                                       (const char *)el->values[j].data,
+                                       found[i]);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    }
+
+    /* The name has precedence over the aliases of other entries */
+    for (i = 0; i < found_count; i++) {
+        name = ldb_msg_find_attr_as_string(found[i], SYSDB_NAME, NULL);
+        if (name == NULL) {
+            continue;
+        }
+
+        ret = sysdb_batch_hash_add(table, name, found[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    for (i = 0; i < num_names; i++) {
+        msgs[i] = sysdb_batch_hash_lookup(table, names[i]);
+        if (msgs[i] == NULL && !domain->case_sensitive) {
+            name = sss_tc_utf8_str_tolower(tmp_ctx, names[i]);
+            if (name == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            msgs[i] = sysdb_batch_hash_lookup(table, name);
+        }
+
+        if (msgs[i] != NULL) {
+            talloc_steal(msgs, msgs[i]);
+        }
+    }
+
+    *_msgs = talloc_steal(mem_ctx, msgs);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Returns true if the entry was already stored in this batch. Such entries
+ * are stored one by one, because the entry that was read at the beginning
+ * of the batch is no longer current. */
+static bool sysdb_batch_seen(hash_table_t *seen,
+                             struct sss_domain_info *domain,
+                             struct ldb_message *msg,
+                             const char *name)
+{
+    const char *key;
+    bool ret;
+
+    if (msg != NULL) {
+        name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, name);
+    }
+
+    key = sss_get_cased_name(NULL, name, domain->case_sensitive);
+    if (key == NULL) {
+        /* Play safe and store the entry alone */
+        return true;
+    }
+
+    ret = sysdb_batch_hash_lookup(seen, key) != NULL;
+    if (!ret) {
+        if (sysdb_batch_hash_add(seen, key, discard_const(name)) != EOK) {
+            ret = true;
+        }
+    }
+
+    talloc_free(discard_const(key));
+    return ret;
+}
+
+/* Stores the entry @i of @entries, the existing entry @msg was read at the
+ * beginning of the batch. If @seen is set, the entry was already stored in
+ * this batch and @msg must not be used. */
+typedef void (*sysdb_store_batch_fn)(struct sss_domain_info *domain,
+                                     void *entries,
+                                     size_t i,
+                                     struct ldb_message *msg,
+                                     bool seen,
+                                     time_t now);
+
+/* Stores the users or groups with @names in a single transaction, see
+ * sysdb_store_users_batch() */
+static errno_t sysdb_store_batch(struct sss_domain_info *domain,
+                                 enum sysdb_obj_type type,
+                                 const char **names,
+                                 size_t num_names,
+                                 time_t now,
+                                 sysdb_store_batch_fn store_fn,
+                                 void *entries)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_message **msgs;
+    hash_table_t *seen;
+    bool in_transaction = false;
+    errno_t sret;
+    errno_t ret;
+    size_t i;
+
+    if (now == 0) {
+        now = time(NULL);
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_hash_create(tmp_ctx, num_names, &seen);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_transaction_start(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
+    }
+    in_transaction = true;
+
+    ret = sysdb_search_by_names(tmp_ctx, domain, type, names, num_names,
+                                &msgs);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to look up existing entries "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        goto done;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        store_fn(domain, entries, i, msgs[i],
+                 sysdb_batch_seen(seen, domain, msgs[i], names[i]), now);
+    }
+
+    ret = sysdb_transaction_commit(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "%zu %s have been stored\n", num_names,
+          type == SYSDB_USER ? "users" : "groups");
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(domain->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t sysdb_store_user_batch_entry(struct sss_domain_info *domain,
+                                            struct sysdb_store_user_entry *user,
+                                            struct ldb_message *msg,
+                                            time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    const char *name;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    attrs = user->attrs;
+    if (attrs == NULL) {
+        attrs = sysdb_new_attrs(tmp_ctx);
+        if (attrs == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    if (user->pwd && !*user->pwd) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_PWD, user->pwd);
+        if (ret) goto done;
+    }
+
+    if (msg == NULL) {
+        DEBUG(SSSDBG_TRACE_LIBS, "User %s does not exist.\n", user->name);
+        ret = sysdb_store_new_user(domain, user->name, user->uid, user->gid,
+                                   user->gecos, user->homedir, user->shell,
+                                   user->orig_dn, attrs, user->cache_timeout,
+                                   now);
+    } else {
+        /* Use the cached name, see sysdb_store_user() */
+        name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, user->name);
+        ret = sysdb_store_user_attrs(domain, name, user->uid, user->gid,
+                                     user->gecos, user->homedir, user->shell,
+                                     user->orig_dn, attrs, user->remove_attrs,
+                                     msg, user->cache_timeout, now);
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void sysdb_store_users_batch_cb(struct sss_domain_info *domain,
+                                       void *entries,
+                                       size_t i,
+                                       struct ldb_message *msg,
+                                       bool seen,
+                                       time_t now)
+{
+    struct sysdb_store_user_entry *user;
+
+    user = &((struct sysdb_store_user_entry *) entries)[i];
+
+    if (seen) {
+        user->ret = sysdb_store_user(domain, user->name, user->pwd,
+                                     user->uid, user->gid, user->gecos,
+                                     user->homedir, user->shell,
+                                     user->orig_dn, user->attrs,
+                                     user->remove_attrs,
+                                     user->cache_timeout, now);
+        return;
+    }
+
+    user->ret = sysdb_store_user_batch_entry(domain, user, msg, now);
+    if (user->ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to store user %s [%d]: %s\n",
+              user->name, user->ret, sss_strerror(user->ret));
+    }
+}
+
+errno_t sysdb_store_users_batch(struct sss_domain_info *domain,
+                                struct sysdb_store_user_entry *users,
+                                size_t num_users,
+                                time_t now)
+{
+    const char **names;
+    errno_t ret;
+    size_t i;
+
+    if (num_users == 0) {
+        return EOK;
+    }
+
+    names = talloc_array(NULL, const char *, num_users);
+    if (names == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_users; i++) {
+        names[i] = users[i].name;
+    }
+
+    ret = sysdb_store_batch(domain, SYSDB_USER, names, num_users, now,
+                            sysdb_store_users_batch_cb, users);
+    talloc_free(names);
+    return ret;
+}
+
+static errno_t sysdb_store_group_batch_entry(struct sss_domain_info *domain,
+                                             struct sysdb_store_group_entry *group,
+                                             struct ldb_message *msg,
+                                             time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    const char *name;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    attrs = group->attrs;
+    if (attrs == NULL) {
+        attrs = sysdb_new_attrs(tmp_ctx);
+        if (attrs == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    if (msg == NULL) {
+        DEBUG(SSSDBG_TRACE_LIBS, "Group %s does not exist.\n", group->name);
+        ret = sysdb_store_new_group(domain, group->name, group->gid, attrs,
+                                    group->cache_timeout, now);
+        goto done;
+    }
+
+    /* Use the cached name, see sysdb_store_group() */
+    name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, group->name);
+
+    ret = sysdb_check_and_update_ts_grp(domain, name, attrs,
+                                        group->cache_timeout, now);
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_LIBS,
+              "The group record of %s did not change, only updated "
+              "the timestamp cache\n", name);
+        goto done;
+    }
+
+    ret = sysdb_store_group_attrs(domain, name, group->gid, attrs, msg,
+                                  group->cache_timeout, now);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void sysdb_store_groups_batch_cb(struct sss_domain_info *domain,
+                                        void *entries,
+                                        size_t i,
+                                        struct ldb_message *msg,
+                                        bool seen,
+                                        time_t now)
+{
+    struct sysdb_store_group_entry *group;
+
+    group = &((struct sysdb_store_group_entry *) entries)[i];
+
+    if (seen) {
+        group->ret = sysdb_store_group(domain, group->name, group->gid,
+                                       group->attrs, group->cache_timeout,
+                                       now);
+        return;
+    }
+
+    group->ret = sysdb_store_group_batch_entry(domain, group, msg, now);
+    if (group->ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to store group %s [%d]: %s\n",
+              group->name, group->ret, sss_strerror(group->ret));
+    }
+}
+
+errno_t sysdb_store_groups_batch(struct sss_domain_info *domain,
+                                 struct sysdb_store_group_entry *groups,
+                                 size_t num_groups,
+                                 time_t now)
+{
+    const char **names;
+    errno_t ret;
+    size_t i;
+
+    if (num_groups == 0) {
+        return EOK;
+    }
+
+    names = talloc_array(NULL, const char *, num_groups);
+    if (names == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_groups; i++) {
+        names[i] = groups[i].name;
+    }
+
+    ret = sysdb_store_batch(domain, SYSDB_GROUP, names, num_groups, now,
+                            sysdb_store_groups_batch_cb, groups);
+    talloc_free(names);
+    return ret;
+}
+
 /* =Add-User-to-Group(Native/Legacy)====================================== */
 static int
 sysdb_group_membership_mod(struct sss_domain_info *domain,
@@ -5278,7 +5873,8 @@ errno_t sysdb_remove_mapped_data(struct sss_domain_info *domain,
         DEBUG(SSSDBG_TRACE_ALL, "Removing mapped data from [%s].\n",
                                 ldb_dn_get_linearized(res->msgs[c]->dn));
         /* The timestamp cache is skipped on purpose here. */
-        ret = sysdb_set_cache_entry_attr(domain->sysdb->ldb, res->msgs[c]->dn,
+        ret = sysdb_set_cache_entry_attr(domain->sysdb, domain->sysdb->ldb,
+                                         res->msgs[c]->dn,
                                          mapped_attr, SYSDB_MOD_DEL);
         if (ret != EOK) {
             all_ok = false;
@@ -5690,7 +6286,7 @@ int sysdb_invalidate_cache_entry(struct sss_domain_info *domain,
         goto done;
     }
 
-    ret = sysdb_set_cache_entry_attr(sysdb->ldb, entry_dn,
+    ret = sysdb_set_cache_entry_attr(sysdb, sysdb->ldb, entry_dn,
                                      attrs, SYSDB_MOD_REP);
     if (ret != EOK) {
         DEBUG(SSSDBG_MINOR_FAILURE,
@@ -5700,7 +6296,7 @@ int sysdb_invalidate_cache_entry(struct sss_domain_info *domain,
     }
 
     if (sysdb->ldb_ts != NULL) {
-        ret = sysdb_set_cache_entry_attr(sysdb->ldb_ts, entry_dn,
+        ret = sysdb_set_cache_entry_attr(sysdb, sysdb->ldb_ts, entry_dn,
                                          attrs, SYSDB_MOD_REP);
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE,
@@ -135,9 +135,22 @@ struct sysdb_ctx {
     char *ldb_ts_file;
 
     int transaction_nesting;
+
+    /* Set only while the writes of a bulk membership session are done */
+    struct sysdb_bulk_membership *bulk;
 };
 
+/* Control attached to the writes of a bulk membership session, handled by
+ * the memberof module. It never leaves the process. */
+#define SYSDB_MEMBEROF_DEFER_OID "1.3.6.1.4.1.2312.24.8.1"
+
 /* Internal utility functions */
+/* ldb_add() and ldb_modify() of the persistent cache. Inside a bulk
+ * membership session the memberships of the entry are left to the end of
+ * the session. Return LDB error codes. */
+int sysdb_ldb_add(struct sysdb_ctx *sysdb, struct ldb_message *msg);
+int sysdb_ldb_modify(struct sysdb_ctx *sysdb, struct ldb_message *msg);
+
 int sysdb_get_db_file(TALLOC_CTX *mem_ctx,
                       const char *provider,
                       const char *name,
@@ -303,4 +316,13 @@ bool sysdb_entry_attrs_diff(struct sysdb_ctx *sysdb,
                             struct sysdb_attrs *attrs,
                             int mod_op);
 
+/* Same as sysdb_entry_attrs_diff() but compares against db_msg, the entry
+ * as it was read from the cache (not the timestamp cache) by the caller.
+ */
+bool sysdb_entry_msg_attrs_diff(struct sysdb_ctx *sysdb,
+                                struct ldb_dn *entry_dn,
+                                struct ldb_message *db_msg,
+                                struct sysdb_attrs *attrs,
+                                int mod_op);
+
 #endif /* __INT_SYS_DB_H__ */
@@ -33,6 +33,20 @@
 #define DB_CACHE_EXPIRE "dataExpireTimestamp"
 #define DB_OC "objectCategory"
 
+/* Upper bound of groups kept in the ancestor index, it is reset when the
+ * bound is reached. */
+#define MBOF_INDEX_MAX_GROUPS 65536
+
+/* Control attached by sysdb to the writes of a bulk membership session, it
+ * never leaves the process. Must match SYSDB_MEMBEROF_DEFER_OID. */
+#define MBOF_DEFER_OID "1.3.6.1.4.1.2312.24.8.1"
+/* Attribute of the @MEMBEROF-REBUILD control entry listing the DNs written
+ * by a bulk membership session */
+#define MBOF_REBUILD_AFFECTED "affected"
+/* Bulk rebuilds that would search for more users than this fall back to
+ * recomputing the whole cache */
+#define MBOF_RCMP_SCOPE_MAX_TERMS 4096
+
 struct mbof_val_array {
     struct ldb_val *vals;
     int num;
@@ -48,6 +62,14 @@ struct mbof_dn {
     struct ldb_dn *dn;
 };
 
+/* Module private data */
+struct mbof_priv {
+    /* Index of the memberof attribute of groups read while recomputing
+     * ancestors, see mbof_index_lookup() */
+    TALLOC_CTX *index_ctx;
+    hash_table_t *index;
+};
+
 struct mbof_ctx {
     struct ldb_module *module;
     struct ldb_request *req;
@@ -189,6 +211,200 @@ static void hash_free(void *ptr, void *pvt)
     talloc_free(ptr);
 }
 
+/* The memberof attribute of a group holds all its ancestors, so when the
+ * ancestors of many entries are recomputed after a removal the same parent
+ * groups are needed again and again. They are kept in an in-memory index
+ * for the duration of a transaction. Other processes can not modify the
+ * database while the transaction is open and every entry written by or
+ * through this module is dropped from the index, so it always matches the
+ * database. The index is discarded when the transaction ends. */
+
+static struct mbof_priv *mbof_get_priv(struct ldb_module *module)
+{
+    return talloc_get_type(ldb_module_get_private(module), struct mbof_priv);
+}
+
+static void mbof_index_clear(struct ldb_module *module)
+{
+    struct mbof_priv *priv = mbof_get_priv(module);
+
+    if (priv == NULL) {
+        return;
+    }
+
+    talloc_zfree(priv->index_ctx);
+    priv->index = NULL;
+}
+
+static void mbof_index_evict(struct ldb_module *module, struct ldb_dn *dn)
+{
+    struct mbof_priv *priv = mbof_get_priv(module);
+    hash_key_t key;
+    hash_value_t value;
+    int ret;
+
+    if (priv == NULL || priv->index == NULL) {
+        return;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_casefold(dn));
+    if (key.str == NULL) {
+        mbof_index_clear(module);
+        return;
+    }
+
+    ret = hash_lookup(priv->index, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return;
+    }
+
+    ret = hash_delete(priv->index, &key);
+    if (ret != HASH_SUCCESS) {
+        mbof_index_clear(module);
+        return;
+    }
+
+    talloc_free(value.ptr);
+}
+
+static struct ldb_message_element *
+mbof_index_lookup(struct ldb_module *module, struct ldb_dn *dn)
+{
+    struct mbof_priv *priv = mbof_get_priv(module);
+    hash_key_t key;
+    hash_value_t value;
+    int ret;
+
+    if (priv == NULL || priv->index == NULL) {
+        return NULL;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_casefold(dn));
+    if (key.str == NULL) {
+        return NULL;
+    }
+
+    ret = hash_lookup(priv->index, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct ldb_message_element);
+}
+
+static void mbof_index_store(struct ldb_module *module,
+                             struct ldb_dn *dn,
+                             const struct ldb_message_element *memberof)
+{
+    struct mbof_priv *priv = mbof_get_priv(module);
+    struct ldb_message_element *el;
+    hash_key_t key;
+    hash_value_t value;
+    unsigned int i;
+    int ret;
+
+    if (priv == NULL) {
+        return;
+    }
+
+    if (priv->index != NULL
+            && hash_count(priv->index) >= MBOF_INDEX_MAX_GROUPS) {
+        mbof_index_clear(module);
+    }
+
+    if (priv->index == NULL) {
+        priv->index_ctx = talloc_new(priv);
+        if (priv->index_ctx == NULL) {
+            return;
+        }
+
+        ret = hash_create_ex(1024, &priv->index, 0, 0, 0, 0,
+                             hash_alloc, hash_free, priv->index_ctx,
+                             NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            talloc_zfree(priv->index_ctx);
+            priv->index = NULL;
+            return;
+        }
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_casefold(dn));
+    if (key.str == NULL) {
+        return;
+    }
+
+    el = talloc_zero(priv->index_ctx, struct ldb_message_element);
+    if (el == NULL) {
+        return;
+    }
+
+    if (memberof != NULL && memberof->num_values > 0) {
+        el->values = talloc_array(el, struct ldb_val, memberof->num_values);
+        if (el->values == NULL) {
+            talloc_free(el);
+            return;
+        }
+
+        for (i = 0; i < memberof->num_values; i++) {
+            el->values[i] = ldb_val_dup(el->values, &memberof->values[i]);
+            if (el->values[i].data == NULL) {
+                talloc_free(el);
+                return;
+            }
+        }
+        el->num_values = memberof->num_values;
+    }
+
+    mbof_index_evict(module, dn);
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = el;
+
+    ret = hash_enter(priv->index, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        talloc_free(el);
+    }
+}
+
+/* Every write issued by the module goes through here so the index never
+ * holds stale data. */
+static int mbof_next_write(struct ldb_module *module, struct ldb_request *req)
+{
+    switch (req->operation) {
+    case LDB_ADD:
+        mbof_index_evict(module, req->op.add.message->dn);
+        break;
+    case LDB_MODIFY:
+        mbof_index_evict(module, req->op.mod.message->dn);
+        break;
+    case LDB_DELETE:
+        mbof_index_evict(module, req->op.del.dn);
+        break;
+    default:
+        mbof_index_clear(module);
+        break;
+    }
+
+    return ldb_next_request(module, req);
+}
+
+/* Bulk membership sessions are used when most of the cache is rewritten at
+ * once, e.g. by enumeration. The adds and modifies done by the session
+ * carry the MBOF_DEFER_OID control and are passed down untouched. The
+ * memberof, memberuid and ghost attributes of the entries they affect are
+ * recomputed once by the rebuild task at the end of the session, instead
+ * of walking the group hierarchy for every single write. Writes without
+ * the control, including the ones done by other requests while the session
+ * is open, are maintained as usual. Deletes are always processed normally
+ * so that no dangling member values are left behind. */
+static bool mbof_is_deferred(struct ldb_request *req)
+{
+    return ldb_request_get_control(req, MBOF_DEFER_OID) != NULL;
+}
+
 static int entry_has_objectclass(struct ldb_message *entry,
                                  const char *objectclass)
 {
@@ -490,6 +706,11 @@ static int memberof_add(struct ldb_module *module, struct ldb_request *req)
         return LDB_ERR_UNWILLING_TO_PERFORM;
     }
 
+    if (mbof_is_deferred(req)) {
+        /* memberships are recomputed when the bulk session ends */
+        return mbof_next_write(module, req);
+    }
+
     ctx = mbof_init(module, req);
     if (!ctx) {
         return LDB_ERR_OPERATIONS_ERROR;
@@ -555,7 +776,7 @@ done:
         return ret;
     }
 
-    return ldb_next_request(module, add_req);
+    return mbof_next_write(module, add_req);
 }
 
 static int mbof_add_callback(struct ldb_request *req,
@@ -954,7 +1175,7 @@ static int mbof_add_operation(struct mbof_add_operation *addop)
     }
     talloc_steal(mod_req, msg);
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_add_fill_ghop(struct mbof_add_ctx *add_ctx,
@@ -1044,7 +1265,7 @@ static int mbof_add_cleanup(struct mbof_add_ctx *add_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_add_cleanup_callback(struct ldb_request *req,
@@ -1133,7 +1354,7 @@ static int mbof_add_muop(struct mbof_add_ctx *add_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_add_muop_callback(struct ldb_request *req,
@@ -1490,7 +1711,7 @@ static int mbof_orig_del(struct mbof_del_ctx *del_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, del_req);
+    return mbof_next_write(ctx->module, del_req);
 }
 
 static int mbof_orig_del_callback(struct ldb_request *req,
@@ -1620,7 +1841,7 @@ static int mbof_del_cleanup_parents(struct mbof_del_ctx *del_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_del_clean_par_callback(struct ldb_request *req,
@@ -1943,6 +2164,49 @@ static int mbof_del_execute_cont(struct mbof_del_operation *delop)
     return mbof_del_ancestors(delop);
 }
 
+/* add the ancestors listed in memberof to new_list, skipping duplicates */
+static int mbof_del_anc_merge(struct ldb_context *ldb,
+                              struct mbof_dn_array *new_list,
+                              const struct ldb_message_element *el)
+{
+    struct ldb_dn *valdn;
+    int i, j;
+
+    if (el == NULL) {
+        return LDB_SUCCESS;
+    }
+
+    for (i = 0; i < el->num_values; i++) {
+        valdn = ldb_dn_from_ldb_val(new_list, ldb, &el->values[i]);
+        if (!valdn) {
+            ldb_debug(ldb, LDB_DEBUG_TRACE,
+                           "Invalid dn for memberof: (%s)",
+                           (const char *)el->values[i].data);
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+        for (j = 0; j < new_list->num; j++) {
+            if (ldb_dn_compare(valdn, new_list->dns[j]) == 0)
+                break;
+        }
+        if (j < new_list->num) {
+            talloc_free(valdn);
+            continue;
+        }
+
+        new_list->dns = talloc_realloc(new_list,
+                                       new_list->dns,
+                                       struct ldb_dn *,
+                                       new_list->num + 1);
+        if (!new_list->dns) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+        new_list->dns[new_list->num] = valdn;
+        new_list->num++;
+    }
+
+    return LDB_SUCCESS;
+}
+
 static int mbof_del_ancestors(struct mbof_del_operation *delop)
 {
     struct mbof_del_ancestors_ctx *anc_ctx;
@@ -1950,6 +2214,7 @@ static int mbof_del_ancestors(struct mbof_del_operation *delop)
     struct mbof_ctx *ctx;
     struct ldb_context *ldb;
     struct mbof_dn_array *new_list;
+    struct ldb_message_element *el;
     static const char *attrs[] = { DB_MEMBEROF, NULL };
     struct ldb_request *search;
     int ret;
@@ -1960,6 +2225,26 @@ static int mbof_del_ancestors(struct mbof_del_operation *delop)
     anc_ctx = delop->anc_ctx;
     new_list = anc_ctx->new_list;
 
+    /* use the index for as many parents as possible before going to
+     * the database */
+    while (anc_ctx->cur < anc_ctx->num_direct) {
+        el = mbof_index_lookup(ctx->module, new_list->dns[anc_ctx->cur]);
+        if (el == NULL) {
+            break;
+        }
+
+        ret = mbof_del_anc_merge(ldb, new_list, el);
+        if (ret != LDB_SUCCESS) {
+            return ret;
+        }
+        anc_ctx->cur++;
+    }
+
+    if (anc_ctx->cur >= anc_ctx->num_direct) {
+        /* ok, end of the story, proceed to modify the entry */
+        return mbof_del_mod_entry(delop);
+    }
+
     ret = ldb_build_search_req(&search, ldb, anc_ctx,
                                new_list->dns[anc_ctx->cur],
                                LDB_SCOPE_BASE, NULL, attrs, NULL,
@@ -1983,8 +2268,7 @@ static int mbof_del_anc_callback(struct ldb_request *req,
     struct ldb_message *msg;
     const struct ldb_message_element *el;
     struct mbof_dn_array *new_list;
-    struct ldb_dn *valdn;
-    int i, j, ret;
+    int ret;
 
     delop = talloc_get_type(req->context, struct mbof_del_operation);
     del_ctx = delop->del_ctx;
@@ -2036,52 +2320,21 @@ static int mbof_del_anc_callback(struct ldb_request *req,
 
         /* check entry */
         el = ldb_msg_find_element(anc_ctx->entry, DB_MEMBEROF);
-        if (el) {
-            for (i = 0; i < el->num_values; i++) {
-                valdn = ldb_dn_from_ldb_val(new_list, ldb, &el->values[i]);
-                if (!valdn) {
-                    ldb_debug(ldb, LDB_DEBUG_TRACE,
-                                   "Invalid dn for memberof: (%s)",
-                                   (const char *)el->values[i].data);
-                    return ldb_module_done(ctx->req, NULL, NULL,
-                                           LDB_ERR_OPERATIONS_ERROR);
-                }
-                for (j = 0; j < new_list->num; j++) {
-                    if (ldb_dn_compare(valdn, new_list->dns[j]) == 0)
-                        break;
-                }
-                if (j < new_list->num) {
-                    talloc_free(valdn);
-                    continue;
-                }
-
-                new_list->dns = talloc_realloc(new_list,
-                                               new_list->dns,
-                                               struct ldb_dn *,
-                                               new_list->num + 1);
-                if (!new_list->dns) {
-                    return ldb_module_done(ctx->req, NULL, NULL,
-                                           LDB_ERR_OPERATIONS_ERROR);
-                }
-                new_list->dns[new_list->num] = valdn;
-                new_list->num++;
-            }
+        ret = mbof_del_anc_merge(ldb, new_list, el);
+        if (ret != LDB_SUCCESS) {
+            return ldb_module_done(ctx->req, NULL, NULL, ret);
         }
 
+        /* remember it for the next entries with the same parents */
+        mbof_index_store(ctx->module, anc_ctx->entry->dn, el);
+
         /* done with this one */
         talloc_free(anc_ctx->entry);
         anc_ctx->entry = NULL;
         anc_ctx->cur++;
 
-        /* check if we need to process any more */
-        if (anc_ctx->cur < anc_ctx->num_direct) {
-            /* ok process the next one */
-            ret = mbof_del_ancestors(delop);
-        } else {
-            /* ok, end of the story, proceed to modify the entry */
-            ret = mbof_del_mod_entry(delop);
-        }
-
+        /* process the next one or modify the entry */
+        ret = mbof_del_ancestors(delop);
         if (ret != LDB_SUCCESS) {
             return ldb_module_done(ctx->req, NULL, NULL,
                                    LDB_ERR_OPERATIONS_ERROR);
@@ -2248,7 +2501,7 @@ static int mbof_del_mod_entry(struct mbof_del_operation *delop)
     }
     talloc_steal(mod_req, msg);
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_del_mod_callback(struct ldb_request *req,
@@ -2600,7 +2853,7 @@ static int mbof_del_muop(struct mbof_del_ctx *del_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_del_muop_callback(struct ldb_request *req,
@@ -2716,7 +2969,7 @@ static int mbof_del_ghop(struct mbof_del_ctx *del_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_del_ghop_callback(struct ldb_request *req,
@@ -2870,7 +3123,7 @@ static int memberof_mod(struct ldb_module *module, struct ldb_request *req)
 
     if (getenv("SSSD_UPGRADE_DB")) {
         /* do not do anything during upgrade */
-        return ldb_next_request(module, req);
+        return mbof_next_write(module, req);
     }
 
     if (ldb_dn_is_special(req->op.mod.message->dn)) {
@@ -2894,6 +3147,11 @@ static int memberof_mod(struct ldb_module *module, struct ldb_request *req)
         return LDB_ERR_UNWILLING_TO_PERFORM;
     }
 
+    if (mbof_is_deferred(req)) {
+        /* memberships are recomputed when the bulk session ends */
+        return mbof_next_write(module, req);
+    }
+
     ctx = mbof_init(module, req);
     if (!ctx) {
         return LDB_ERR_OPERATIONS_ERROR;
@@ -3180,7 +3438,7 @@ static int mbof_orig_mod(struct mbof_mod_ctx *mod_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_orig_mod_callback(struct ldb_request *req,
@@ -3321,7 +3579,7 @@ static int mbof_inherited_mod(struct mbof_mod_ctx *mod_ctx)
         return ret;
     }
 
-    return ldb_next_request(ctx->module, mod_req);
+    return mbof_next_write(ctx->module, mod_req);
 }
 
 static int mbof_inherited_mod_callback(struct ldb_request *req,
@@ -3861,6 +4119,21 @@ struct mbof_member {
 
     struct ldb_message_element *memuids;
 
+    /* only used when rebuilding at the end of a bulk session */
+    bool orig_has_ghost;
+    bool fix_members;
+    /* written in the session */
+    bool affected;
+    /* the members of the group are loaded */
+    bool in_scope;
+    /* the membership attributes of the group are written */
+    bool rewrite;
+    struct ldb_message_element *orig_memberof;
+    struct ldb_message_element *orig_memberuid;
+    struct ldb_message_element *orig_ghosts;
+    hash_table_t *inherited_ghosts;
+    hash_table_t *ghosts;
+
     enum { MBOF_GROUP_TO_DO = 0,
            MBOF_GROUP_DONE,
            MBOF_USER,
@@ -3876,6 +4149,13 @@ struct mbof_rcmp_context {
 
     struct mbof_member *group_list;
     hash_table_t *group_table;
+    int num_groups;
+
+    /* DNs written by the bulk session that requested the rebuild */
+    struct ldb_message_element *affected;
+    bool bulk;
+    /* only the entries around the affected ones are rewritten */
+    bool scoped;
 };
 
 static int mbof_steal_msg_el(TALLOC_CTX *memctx,
@@ -3904,16 +4184,19 @@ static int mbof_steal_msg_el(TALLOC_CTX *memctx,
     return LDB_SUCCESS;
 }
 
-static int mbof_rcmp_usr_callback(struct ldb_request *req,
-                                  struct ldb_reply *ares);
 static int mbof_rcmp_search_groups(struct mbof_rcmp_context *ctx);
 static int mbof_rcmp_grp_callback(struct ldb_request *req,
                                   struct ldb_reply *ares);
+static int mbof_rcmp_search_users(struct mbof_rcmp_context *ctx);
+static int mbof_rcmp_usr_callback(struct ldb_request *req,
+                                  struct ldb_reply *ares);
+static int mbof_rcmp_compute(struct mbof_rcmp_context *ctx);
 static int mbof_member_update(struct mbof_rcmp_context *ctx,
                               struct mbof_member *parent,
                               struct mbof_member *mem);
 static bool mbof_member_iter(hash_entry_t *item, void *user_data);
 static int mbof_add_memuid(struct mbof_member *grp, const char *user);
+static int mbof_rcmp_ghosts(struct mbof_rcmp_context *ctx);
 static int mbof_rcmp_update(struct mbof_rcmp_context *ctx);
 static int mbof_rcmp_mod_callback(struct ldb_request *req,
                                   struct ldb_reply *ares);
@@ -3921,12 +4204,7 @@ static int mbof_rcmp_mod_callback(struct ldb_request *req,
 static int memberof_recompute_task(struct ldb_module *module,
                                    struct ldb_request *req)
 {
-    struct ldb_context *ldb = ldb_module_get_ctx(module);
-    static const char *attrs[] = { DB_NAME, DB_MEMBEROF, NULL };
-    static const char *filter = "("DB_OC"="DB_USER_CLASS")";
     struct mbof_rcmp_context *ctx;
-    struct ldb_request *src_req;
-    int ret;
 
     ctx = talloc_zero(req, struct mbof_rcmp_context);
     if (!ctx) {
@@ -3935,108 +4213,464 @@ static int memberof_recompute_task(struct ldb_module *module,
     ctx->module = module;
     ctx->req = req;
 
-    ret = hash_create_ex(1024, &ctx->user_table, 0, 0, 0, 0,
-                         hash_alloc, hash_free, ctx, NULL, NULL);
-    if (ret != HASH_SUCCESS) {
-        return LDB_ERR_OPERATIONS_ERROR;
-    }
-
-    ret = ldb_build_search_req(&src_req, ldb, ctx,
-                               NULL, LDB_SCOPE_SUBTREE,
-                               filter, attrs, NULL,
-                               ctx, mbof_rcmp_usr_callback, ctx->req);
-    if (ret != LDB_SUCCESS) {
-        return ret;
+    /* the rebuild requested at the end of a bulk session lists the
+     * entries written by the session */
+    ctx->affected = ldb_msg_find_element(req->op.add.message,
+                                         MBOF_REBUILD_AFFECTED);
+    if (ctx->affected) {
+        ctx->bulk = true;
+        if (ctx->affected->num_values == 0) {
+            return ldb_module_done(req, NULL, NULL, LDB_SUCCESS);
+        }
     }
+    mbof_index_clear(module);
 
-    return ldb_request(ldb, src_req);
+    /* groups are searched first, in a bulk session the users to load
+     * depend on the groups that were written */
+    return mbof_rcmp_search_groups(ctx);
 }
 
-static int mbof_rcmp_usr_callback(struct ldb_request *req,
-                                  struct ldb_reply *ares)
+static struct mbof_member *mbof_rcmp_find_group(struct mbof_rcmp_context *ctx,
+                                                const char *dn)
 {
-    struct mbof_rcmp_context *ctx;
-    struct mbof_member *usr;
     hash_value_t value;
     hash_key_t key;
-    const char *name;
     int ret;
 
-    ctx = talloc_get_type(req->context, struct mbof_rcmp_context);
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(dn);
 
-    if (!ares) {
-        return ldb_module_done(ctx->req, NULL, NULL,
-                               LDB_ERR_OPERATIONS_ERROR);
-    }
-    if (ares->error != LDB_SUCCESS) {
-        return ldb_module_done(ctx->req,
-                               ares->controls,
-                               ares->response,
-                               ares->error);
+    ret = hash_lookup(ctx->group_table, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return NULL;
     }
 
-    switch (ares->type) {
-    case LDB_REPLY_ENTRY:
+    return (struct mbof_member *)value.ptr;
+}
 
-        usr = talloc_zero(ctx, struct mbof_member);
-        if (!usr) {
-            return ldb_module_done(ctx->req, NULL, NULL,
-                                   LDB_ERR_OPERATIONS_ERROR);
-        }
+/* Extend the set of groups flagged as in_scope, or as rewrite, to all the
+ * groups nested in them */
+static int mbof_rcmp_mark_nested(struct mbof_rcmp_context *ctx, bool scope)
+{
+    struct ldb_message_element *el;
+    struct mbof_member **stack;
+    struct mbof_member *grp;
+    struct mbof_member *mem;
+    int top = 0;
+    int i;
 
-        usr->status = MBOF_USER;
-        usr->dn = talloc_steal(usr, ares->message->dn);
-        name = ldb_msg_find_attr_as_string(ares->message, DB_NAME, NULL);
-        if (name) {
-            usr->name = talloc_steal(usr, name);
-        }
+    /* every group is pushed at most once */
+    stack = talloc_array(ctx, struct mbof_member *, ctx->num_groups);
+    if (!stack) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
 
-        if (ldb_msg_find_element(ares->message, DB_MEMBEROF)) {
-            usr->orig_has_memberof = true;
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (scope ? grp->in_scope : grp->rewrite) {
+            stack[top++] = grp;
         }
+    }
 
-        DLIST_ADD(ctx->user_list, usr);
+    while (top > 0) {
+        grp = stack[--top];
 
-        key.type = HASH_KEY_STRING;
-        key.str = discard_const(ldb_dn_get_linearized(usr->dn));
-        value.type = HASH_VALUE_PTR;
-        value.ptr = usr;
+        el = grp->orig_members;
+        for (i = 0; el && i < el->num_values; i++) {
+            mem = mbof_rcmp_find_group(ctx, (const char *)el->values[i].data);
+            if (!mem) {
+                continue;
+            }
 
-        ret = hash_enter(ctx->user_table, &key, &value);
-        if (ret != HASH_SUCCESS) {
-            return ldb_module_done(ctx->req, NULL, NULL,
-                                   LDB_ERR_OPERATIONS_ERROR);
+            if (scope) {
+                if (mem->in_scope) continue;
+                mem->in_scope = true;
+            } else {
+                if (mem->rewrite) continue;
+                mem->rewrite = true;
+            }
+            stack[top++] = mem;
         }
-
-        break;
-
-    case LDB_REPLY_REFERRAL:
-        /* ignore */
-        break;
-
-    case LDB_REPLY_DONE:
-        talloc_zfree(ares);
-
-        /* and now search groups */
-        return mbof_rcmp_search_groups(ctx);
     }
 
-    talloc_zfree(ares);
+    talloc_free(stack);
     return LDB_SUCCESS;
 }
 
-static int mbof_rcmp_search_groups(struct mbof_rcmp_context *ctx)
+/* Flag as rewrite all the parents of the groups flagged as rewrite */
+static void mbof_rcmp_mark_parents(struct mbof_rcmp_context *ctx)
 {
-    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
-    static const char *attrs[] = { DB_MEMBEROF, DB_MEMBERUID,
-                                   DB_NAME, DB_MEMBER, NULL };
-    static const char *filter = "("DB_OC"="DB_GROUP_CLASS")";
-    struct ldb_request *req;
-    int ret;
+    struct ldb_message_element *el;
+    struct mbof_member *grp;
+    struct mbof_member *mem;
+    bool changed = true;
+    int i;
 
-    ret = hash_create_ex(1024, &ctx->group_table, 0, 0, 0, 0,
-                         hash_alloc, hash_free, ctx, NULL, NULL);
-    if (ret != HASH_SUCCESS) {
+    /* one pass per nesting level */
+    while (changed) {
+        changed = false;
+
+        for (grp = ctx->group_list; grp; grp = grp->next) {
+            if (grp->rewrite) {
+                continue;
+            }
+
+            el = grp->orig_members;
+            for (i = 0; el && i < el->num_values; i++) {
+                mem = mbof_rcmp_find_group(ctx,
+                                           (const char *)el->values[i].data);
+                if (mem && mem->rewrite) {
+                    grp->rewrite = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static int mbof_rcmp_add_term(TALLOC_CTX *mem_ctx, char **filter,
+                              const char *attr, const char *dn)
+{
+    char *val;
+
+    val = ldb_binary_encode_string(mem_ctx, dn);
+    if (!val) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    *filter = talloc_asprintf_append(*filter, "(%s=%s)", attr, val);
+    talloc_free(val);
+    if (!*filter) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    return LDB_SUCCESS;
+}
+
+/* Restrict the rebuild at the end of a bulk session to the entries whose
+ * memberships the session can have changed:
+ * - the groups written in the session and the groups that were nested in
+ *   one of them, they have it in memberof;
+ * - the groups nested in those, their memberof may change;
+ * - the parents of all of these and the groups that have a written user
+ *   as a member, their memberuid and ghost attributes may change.
+ * These groups are rewritten. Their memberuid attribute depends on all the
+ * users nested in them, so the users of every group nested in a rewritten
+ * group are loaded, together with the written users and the new members of
+ * the written groups. All groups are still read, the closure is computed
+ * over the whole group hierarchy.
+ *
+ * When most of the groups are in scope the whole cache is recomputed and
+ * _filter is left untouched. */
+static int mbof_rcmp_scope(struct mbof_rcmp_context *ctx,
+                           const char **_filter)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    struct ldb_message_element *el;
+    struct mbof_member *grp;
+    struct mbof_member *mem;
+    TALLOC_CTX *tmp_ctx;
+    hash_table_t *users;
+    hash_value_t value;
+    hash_key_t *keys;
+    hash_key_t key;
+    unsigned long count;
+    const char *dn;
+    char *filter;
+    int num_scope = 0;
+    int num_terms = 0;
+    int i, ret;
+
+    tmp_ctx = talloc_new(ctx);
+    if (!tmp_ctx) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    ret = hash_create_ex(0, &users, 0, 0, 0, 0,
+                         hash_alloc, hash_free, tmp_ctx, NULL, NULL);
+    if (ret != HASH_SUCCESS) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    for (i = 0; i < ctx->affected->num_values; i++) {
+        dn = (const char *)ctx->affected->values[i].data;
+
+        grp = mbof_rcmp_find_group(ctx, dn);
+        if (grp) {
+            grp->affected = true;
+            grp->rewrite = true;
+            continue;
+        }
+
+        /* not a group, the written users are looked up by DN */
+        key.type = HASH_KEY_STRING;
+        key.str = discard_const(dn);
+        value.type = HASH_VALUE_UNDEF;
+
+        ret = hash_enter(users, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            ret = LDB_ERR_OPERATIONS_ERROR;
+            goto done;
+        }
+    }
+
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        /* groups removed from a written group */
+        el = grp->orig_memberof;
+        for (i = 0; el && !grp->rewrite && i < el->num_values; i++) {
+            mem = mbof_rcmp_find_group(ctx, (const char *)el->values[i].data);
+            if (mem && mem->affected) {
+                grp->rewrite = true;
+            }
+        }
+
+        /* groups with a written user as a member */
+        el = grp->orig_members;
+        for (i = 0; el && !grp->rewrite && i < el->num_values; i++) {
+            key.type = HASH_KEY_STRING;
+            key.str = (char *)el->values[i].data;
+
+            if (hash_has_key(users, &key)) {
+                grp->rewrite = true;
+            }
+        }
+    }
+
+    ret = mbof_rcmp_mark_nested(ctx, false);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+    mbof_rcmp_mark_parents(ctx);
+
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        grp->in_scope = grp->rewrite;
+    }
+    ret = mbof_rcmp_mark_nested(ctx, true);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (grp->in_scope) {
+            num_scope++;
+        }
+    }
+    if (num_scope * 2 > ctx->num_groups) {
+        ldb_debug(ldb, LDB_DEBUG_TRACE,
+                  "%d of %d groups affected, recomputing all memberships",
+                  num_scope, ctx->num_groups);
+        ret = LDB_SUCCESS;
+        goto done;
+    }
+
+    filter = talloc_strdup(tmp_ctx, "(&("DB_OC"="DB_USER_CLASS")(|");
+    if (!filter) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (!grp->in_scope) {
+            continue;
+        }
+
+        /* the current users of the group */
+        ret = mbof_rcmp_add_term(tmp_ctx, &filter, DB_MEMBEROF,
+                                 ldb_dn_get_linearized(grp->dn));
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+        num_terms++;
+
+        if (!grp->affected) {
+            continue;
+        }
+
+        /* and the new ones, they do not have it in memberof yet */
+        el = grp->orig_members;
+        for (i = 0; el && i < el->num_values; i++) {
+            dn = (const char *)el->values[i].data;
+            if (mbof_rcmp_find_group(ctx, dn)) {
+                continue;
+            }
+
+            ret = mbof_rcmp_add_term(tmp_ctx, &filter, "dn", dn);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
+            num_terms++;
+        }
+    }
+
+    ret = hash_keys(users, &count, &keys);
+    if (ret != HASH_SUCCESS) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+    for (i = 0; i < count; i++) {
+        ret = mbof_rcmp_add_term(tmp_ctx, &filter, "dn", keys[i].str);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+        num_terms++;
+    }
+    talloc_free(keys);
+
+    if (num_terms == 0 || num_terms > MBOF_RCMP_SCOPE_MAX_TERMS) {
+        ldb_debug(ldb, LDB_DEBUG_TRACE,
+                  "%d users affected, recomputing all memberships",
+                  num_terms);
+        ret = LDB_SUCCESS;
+        goto done;
+    }
+
+    filter = talloc_strdup_append(filter, "))");
+    if (!filter) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    ldb_debug(ldb, LDB_DEBUG_TRACE,
+              "Recomputing the memberships of %d of %d groups",
+              num_scope, ctx->num_groups);
+
+    ctx->scoped = true;
+    *_filter = talloc_steal(ctx, filter);
+    ret = LDB_SUCCESS;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int mbof_rcmp_search_users(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    static const char *attrs[] = { DB_NAME, DB_MEMBEROF, NULL };
+    const char *filter = "("DB_OC"="DB_USER_CLASS")";
+    struct ldb_request *req;
+    int ret;
+
+    ret = hash_create_ex(1024, &ctx->user_table, 0, 0, 0, 0,
+                         hash_alloc, hash_free, ctx, NULL, NULL);
+    if (ret != HASH_SUCCESS) {
+        return ldb_module_done(ctx->req, NULL, NULL,
+                               LDB_ERR_OPERATIONS_ERROR);
+    }
+
+    if (ctx->bulk) {
+        ret = mbof_rcmp_scope(ctx, &filter);
+        if (ret != LDB_SUCCESS) {
+            return ldb_module_done(ctx->req, NULL, NULL, ret);
+        }
+    }
+
+    ret = ldb_build_search_req(&req, ldb, ctx,
+                               NULL, LDB_SCOPE_SUBTREE,
+                               filter, attrs, NULL,
+                               ctx, mbof_rcmp_usr_callback, ctx->req);
+    if (ret != LDB_SUCCESS) {
+        return ldb_module_done(ctx->req, NULL, NULL, ret);
+    }
+
+    return ldb_request(ldb, req);
+}
+
+static int mbof_rcmp_usr_callback(struct ldb_request *req,
+                                  struct ldb_reply *ares)
+{
+    struct mbof_rcmp_context *ctx;
+    struct mbof_member *usr;
+    hash_value_t value;
+    hash_key_t key;
+    const char *name;
+    int ret;
+
+    ctx = talloc_get_type(req->context, struct mbof_rcmp_context);
+
+    if (!ares) {
+        return ldb_module_done(ctx->req, NULL, NULL,
+                               LDB_ERR_OPERATIONS_ERROR);
+    }
+    if (ares->error != LDB_SUCCESS) {
+        return ldb_module_done(ctx->req,
+                               ares->controls,
+                               ares->response,
+                               ares->error);
+    }
+
+    switch (ares->type) {
+    case LDB_REPLY_ENTRY:
+
+        usr = talloc_zero(ctx, struct mbof_member);
+        if (!usr) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
+        }
+
+        usr->status = MBOF_USER;
+        usr->dn = talloc_steal(usr, ares->message->dn);
+        name = ldb_msg_find_attr_as_string(ares->message, DB_NAME, NULL);
+        if (name) {
+            usr->name = talloc_steal(usr, name);
+        }
+
+        if (ldb_msg_find_element(ares->message, DB_MEMBEROF)) {
+            usr->orig_has_memberof = true;
+        }
+
+        if (ctx->bulk) {
+            ret = mbof_steal_msg_el(usr, DB_MEMBEROF,
+                                    ares->message, &usr->orig_memberof);
+            if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+                return ldb_module_done(ctx->req, NULL, NULL,
+                                       LDB_ERR_OPERATIONS_ERROR);
+            }
+        }
+
+        DLIST_ADD(ctx->user_list, usr);
+
+        key.type = HASH_KEY_STRING;
+        key.str = discard_const(ldb_dn_get_linearized(usr->dn));
+        value.type = HASH_VALUE_PTR;
+        value.ptr = usr;
+
+        ret = hash_enter(ctx->user_table, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
+        }
+
+        break;
+
+    case LDB_REPLY_REFERRAL:
+        /* ignore */
+        break;
+
+    case LDB_REPLY_DONE:
+        talloc_zfree(ares);
+
+        /* all entries are loaded, compute the memberships */
+        return mbof_rcmp_compute(ctx);
+    }
+
+    talloc_zfree(ares);
+    return LDB_SUCCESS;
+}
+
+static int mbof_rcmp_search_groups(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    static const char *attrs[] = { DB_MEMBEROF, DB_MEMBERUID,
+                                   DB_NAME, DB_MEMBER, DB_GHOST, NULL };
+    static const char *filter = "("DB_OC"="DB_GROUP_CLASS")";
+    struct ldb_request *req;
+    int ret;
+
+    ret = hash_create_ex(1024, &ctx->group_table, 0, 0, 0, 0,
+                         hash_alloc, hash_free, ctx, NULL, NULL);
+    if (ret != HASH_SUCCESS) {
         return ldb_module_done(ctx->req, NULL, NULL,
                                LDB_ERR_OPERATIONS_ERROR);
     }
@@ -4055,19 +4689,14 @@ static int mbof_rcmp_search_groups(struct mbof_rcmp_context *ctx)
 static int mbof_rcmp_grp_callback(struct ldb_request *req,
                                   struct ldb_reply *ares)
 {
-    struct ldb_context *ldb;
     struct mbof_rcmp_context *ctx;
-    struct ldb_message_element *el;
-    struct mbof_member *iter;
     struct mbof_member *grp;
     hash_value_t value;
     hash_key_t key;
     const char *name;
-    int i, j;
     int ret;
 
     ctx = talloc_get_type(req->context, struct mbof_rcmp_context);
-    ldb = ldb_module_get_ctx(ctx->module);
 
     if (!ares) {
         return ldb_module_done(ctx->req, NULL, NULL,
@@ -4105,6 +4734,22 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
             grp->orig_has_memberuid = true;
         }
 
+        if (ctx->bulk) {
+            ret = mbof_steal_msg_el(grp, DB_MEMBEROF,
+                                    ares->message, &grp->orig_memberof);
+            if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+                return ldb_module_done(ctx->req, NULL, NULL,
+                                       LDB_ERR_OPERATIONS_ERROR);
+            }
+
+            ret = mbof_steal_msg_el(grp, DB_MEMBERUID,
+                                    ares->message, &grp->orig_memberuid);
+            if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+                return ldb_module_done(ctx->req, NULL, NULL,
+                                       LDB_ERR_OPERATIONS_ERROR);
+            }
+        }
+
         ret = mbof_steal_msg_el(grp, DB_MEMBER,
                                 ares->message, &grp->orig_members);
         if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
@@ -4112,7 +4757,17 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
                                    LDB_ERR_OPERATIONS_ERROR);
         }
 
-        DLIST_ADD(ctx->group_list, grp);
+        ret = mbof_steal_msg_el(grp, DB_GHOST,
+                                ares->message, &grp->orig_ghosts);
+        if (ret == LDB_SUCCESS) {
+            grp->orig_has_ghost = true;
+        } else if (ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
+        }
+
+        DLIST_ADD(ctx->group_list, grp);
+        ctx->num_groups++;
 
         key.type = HASH_KEY_STRING;
         key.str = discard_const(ldb_dn_get_linearized(grp->dn));
@@ -4134,227 +4789,592 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
     case LDB_REPLY_DONE:
         talloc_zfree(ares);
 
-        if (!ctx->group_list) {
-            /* no groups? */
-            return ldb_module_done(ctx->req, NULL, NULL, LDB_SUCCESS);
+        if (!ctx->group_list) {
+            /* no groups? */
+            return ldb_module_done(ctx->req, NULL, NULL, LDB_SUCCESS);
+        }
+
+        /* and now search users */
+        return mbof_rcmp_search_users(ctx);
+    }
+
+    talloc_zfree(ares);
+    return LDB_SUCCESS;
+}
+
+static int mbof_rcmp_compute(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    struct ldb_message_element *el;
+    struct mbof_member *iter;
+    struct mbof_member *grp;
+    hash_value_t value;
+    hash_key_t key;
+    int i, j;
+    int ret;
+
+    /* for each group compute the members list */
+    for (iter = ctx->group_list; iter; iter = iter->next) {
+
+        el = iter->orig_members;
+        if (!el || el->num_values == 0) {
+            /* no members */
+            continue;
+        }
+
+        /* we have at most num_values group members */
+        iter->members = talloc_array(iter, struct mbof_member *,
+                                     el->num_values +1);
+        if (!iter->members) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
+        }
+
+        for (i = 0, j = 0; i < el->num_values; i++) {
+            key.type = HASH_KEY_STRING;
+            key.str = (char *)el->values[i].data;
+
+            ret = hash_lookup(ctx->user_table, &key, &value);
+            switch (ret) {
+            case HASH_SUCCESS:
+                iter->members[j] = (struct mbof_member *)value.ptr;
+                j++;
+                break;
+
+            case HASH_ERROR_KEY_NOT_FOUND:
+                /* not a user, see if it is a group */
+
+                ret = hash_lookup(ctx->group_table, &key, &value);
+                if (ret != HASH_SUCCESS) {
+                    if (ret != HASH_ERROR_KEY_NOT_FOUND) {
+                        return ldb_module_done(ctx->req, NULL, NULL,
+                                               LDB_ERR_OPERATIONS_ERROR);
+                    }
+                }
+                if (ret == HASH_ERROR_KEY_NOT_FOUND) {
+                    if (ctx->scoped && !iter->in_scope) {
+                        /* users of groups outside of the scope of the
+                         * rebuild are not loaded */
+                        break;
+                    }
+                    /* not a known user, nor a known group!?
+                       give a warning and continue */
+                    ldb_debug(ldb, LDB_DEBUG_ERROR,
+                              "member attribute [%s] has no corresponding"
+                              " entry!", key.str);
+                    /* adds and modifies drop missing members, do the
+                     * same for the groups written in a bulk session */
+                    iter->fix_members = ctx->bulk
+                                        && (!ctx->scoped || iter->affected);
+                    break;
+                }
+
+                iter->members[j] = (struct mbof_member *)value.ptr;
+                j++;
+                break;
+
+            default:
+                return ldb_module_done(ctx->req, NULL, NULL,
+                                       LDB_ERR_OPERATIONS_ERROR);
+            }
+        }
+        /* terminate */
+        iter->members[j] = NULL;
+
+        talloc_zfree(iter->orig_members);
+    }
+
+    /* now generate correct memberof tables */
+    while (ctx->group_list->status == MBOF_GROUP_TO_DO) {
+
+        grp = ctx->group_list;
+
+        /* move to end of list and mark as done.
+         * NOTE: this is not efficient, but will do for now */
+        DLIST_DEMOTE(ctx->group_list, grp, struct mbof_member *);
+        grp->status = MBOF_GROUP_DONE;
+
+        /* verify if members need updating */
+        if (!grp->members) {
+            continue;
+        }
+        for (i = 0; grp->members[i]; i++) {
+            ret = mbof_member_update(ctx, grp, grp->members[i]);
+            if (ret != LDB_SUCCESS) {
+                return ldb_module_done(ctx->req, NULL, NULL,
+                                       LDB_ERR_OPERATIONS_ERROR);
+            }
+        }
+    }
+
+    if (ctx->bulk) {
+        ret = mbof_rcmp_ghosts(ctx);
+        if (ret != LDB_SUCCESS) {
+            return ldb_module_done(ctx->req, NULL, NULL, ret);
+        }
+    }
+
+    /* ok all done, now go on and modify the tree */
+    return mbof_rcmp_update(ctx);
+}
+
+static int mbof_member_update(struct mbof_rcmp_context *ctx,
+                              struct mbof_member *parent,
+                              struct mbof_member *mem)
+{
+    hash_value_t value;
+    hash_key_t key;
+    int ret;
+
+    /* ignore loops */
+    if (parent == mem) return LDB_SUCCESS;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_linearized(parent->dn));
+
+    if (!mem->memberofs) {
+        ret = hash_create_ex(0, &mem->memberofs, 0, 0, 0, 0,
+                             hash_alloc, hash_free, mem, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+
+        ret = HASH_ERROR_KEY_NOT_FOUND;
+
+    } else {
+
+        ret = hash_lookup(mem->memberofs, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            if (ret != HASH_ERROR_KEY_NOT_FOUND) {
+                /* fatal error */
+                return LDB_ERR_OPERATIONS_ERROR;
+            }
+        }
+    }
+
+    if (ret == HASH_ERROR_KEY_NOT_FOUND) {
+
+        /* it's missing, update member */
+        value.type = HASH_VALUE_PTR;
+        value.ptr = parent;
+
+        ret = hash_enter(mem->memberofs, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+
+        if (mem->status == MBOF_USER) {
+            /* add corresponding memuid to the group */
+            ret = mbof_add_memuid(parent, mem->name);
+            if (ret != LDB_SUCCESS) {
+                return ret;
+            }
+        }
+
+        /* if we updated a group, mark it as TO DO again */
+        if (mem->status == MBOF_GROUP_DONE) {
+            mem->status = MBOF_GROUP_TO_DO;
+        }
+    }
+
+    /* now see if the parent has memberofs to pass down */
+    if (parent->memberofs) {
+        ret = hash_iterate(parent->memberofs, mbof_member_iter, mem);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+        if (mem->status == MBOF_ITER_ERROR) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+
+    /* finally, if it was made TO DO move it to the head */
+    if (mem->status == MBOF_GROUP_TO_DO) {
+        DLIST_PROMOTE(ctx->group_list, mem);
+    }
+
+    return LDB_SUCCESS;
+}
+
+static bool mbof_member_iter(hash_entry_t *item, void *user_data)
+{
+    struct mbof_member *parent;
+    struct mbof_member *mem;
+    hash_value_t value;
+    int ret;
+
+    mem = talloc_get_type(user_data, struct mbof_member);
+
+    /* exclude self */
+    if (strcmp(item->key.str, ldb_dn_get_linearized(mem->dn)) == 0) {
+        return true;
+    }
+
+    /* check if we already have it */
+    ret = hash_lookup(mem->memberofs, &item->key, &value);
+    if (ret != HASH_SUCCESS) {
+        if (ret != HASH_ERROR_KEY_NOT_FOUND) {
+            /* fatal error */
+            mem->status = MBOF_ITER_ERROR;
+            return false;
+        }
+
+        /* was not already here, add it and mark group as TO DO */
+        ret = hash_enter(mem->memberofs, &item->key, &item->value);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+
+        if (mem->status == MBOF_GROUP_DONE) {
+            mem->status = MBOF_GROUP_TO_DO;
+        }
+
+        if (mem->status == MBOF_USER) {
+            /* add corresponding memuid to the group */
+            parent = (struct mbof_member *)item->value.ptr;
+            ret = mbof_add_memuid(parent, mem->name);
+            if (ret != LDB_SUCCESS) {
+                mem->status = MBOF_ITER_ERROR;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static int mbof_rcmp_add_ghosts(struct mbof_member *grp,
+                                hash_table_t **_ghosts,
+                                struct ldb_message_element *el)
+{
+    hash_value_t value;
+    hash_key_t key;
+    int i, ret;
+
+    if (!*_ghosts) {
+        ret = hash_create_ex(0, _ghosts, 0, 0, 0, 0,
+                             hash_alloc, hash_free, grp, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+
+    for (i = 0; i < el->num_values; i++) {
+        key.type = HASH_KEY_STRING;
+        key.str = (char *)el->values[i].data;
+        value.type = HASH_VALUE_PTR;
+        value.ptr = NULL;
+
+        ret = hash_enter(*_ghosts, &key, &value);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+
+    return LDB_SUCCESS;
+}
+
+/* The ghost attribute of a group also holds the ghost users of the groups
+ * that were nested in it, tell its own ones apart */
+static int mbof_rcmp_own_ghosts(TALLOC_CTX *mem_ctx,
+                                struct mbof_member *grp,
+                                struct ldb_message_element **_own)
+{
+    struct ldb_message_element *own;
+    hash_key_t key;
+    int i;
+
+    if (!grp->inherited_ghosts) {
+        *_own = grp->orig_ghosts;
+        return LDB_SUCCESS;
+    }
+
+    own = talloc_zero(mem_ctx, struct ldb_message_element);
+    if (!own) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    own->values = talloc_array(own, struct ldb_val,
+                               grp->orig_ghosts->num_values);
+    if (!own->values) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    for (i = 0; i < grp->orig_ghosts->num_values; i++) {
+        key.type = HASH_KEY_STRING;
+        key.str = (char *)grp->orig_ghosts->values[i].data;
+
+        if (!hash_has_key(grp->inherited_ghosts, &key)) {
+            own->values[own->num_values++] = grp->orig_ghosts->values[i];
+        }
+    }
+
+    *_own = own;
+    return LDB_SUCCESS;
+}
+
+/* A group holds its own ghost users plus the ghost users of all groups
+ * nested in it, users that are cached members are not ghosts anymore */
+static int mbof_rcmp_ghosts(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_message_element *own;
+    struct mbof_member *grp;
+    struct mbof_member *anc;
+    TALLOC_CTX *tmp_ctx;
+    hash_value_t value;
+    hash_key_t *keys;
+    hash_key_t key;
+    unsigned long count;
+    int i, ret;
+
+    tmp_ctx = talloc_new(ctx);
+    if (!tmp_ctx) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    /* the ghosts a group got from the groups nested in it before */
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (!grp->orig_ghosts || grp->orig_ghosts->num_values == 0
+                || !grp->orig_memberof) {
+            continue;
+        }
+
+        for (i = 0; i < grp->orig_memberof->num_values; i++) {
+            anc = mbof_rcmp_find_group(ctx,
+                            (const char *)grp->orig_memberof->values[i].data);
+            if (!anc) {
+                continue;
+            }
+
+            ret = mbof_rcmp_add_ghosts(anc, &anc->inherited_ghosts,
+                                       grp->orig_ghosts);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
+        }
+    }
+
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (!grp->orig_ghosts || grp->orig_ghosts->num_values == 0) {
+            continue;
+        }
+
+        ret = mbof_rcmp_own_ghosts(tmp_ctx, grp, &own);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+        if (own->num_values == 0) {
+            continue;
+        }
+
+        ret = mbof_rcmp_add_ghosts(grp, &grp->ghosts, own);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+
+        if (!grp->memberofs) {
+            continue;
         }
 
-        /* for each group compute the members list */
-        for (iter = ctx->group_list; iter; iter = iter->next) {
+        ret = hash_keys(grp->memberofs, &count, &keys);
+        if (ret != HASH_SUCCESS) {
+            ret = LDB_ERR_OPERATIONS_ERROR;
+            goto done;
+        }
 
-            el = iter->orig_members;
-            if (!el || el->num_values == 0) {
-                /* no members */
-                continue;
+        for (i = 0; i < count; i++) {
+            ret = hash_lookup(ctx->group_table, &keys[i], &value);
+            if (ret != HASH_SUCCESS) {
+                ret = LDB_ERR_OPERATIONS_ERROR;
+                goto done;
             }
+            anc = talloc_get_type(value.ptr, struct mbof_member);
 
-            /* we have at most num_values group members */
-            iter->members = talloc_array(iter, struct mbof_member *,
-                                         el->num_values +1);
-            if (!iter->members) {
-                return ldb_module_done(ctx->req, NULL, NULL,
-                                       LDB_ERR_OPERATIONS_ERROR);
+            ret = mbof_rcmp_add_ghosts(anc, &anc->ghosts, own);
+            if (ret != LDB_SUCCESS) {
+                goto done;
             }
+        }
+        talloc_free(keys);
+    }
 
-            for (i = 0, j = 0; i < el->num_values; i++) {
-                key.type = HASH_KEY_STRING;
-                key.str = (char *)el->values[i].data;
+    for (grp = ctx->group_list; grp; grp = grp->next) {
+        if (!grp->ghosts || !grp->memuids) {
+            continue;
+        }
 
-                ret = hash_lookup(ctx->user_table, &key, &value);
-                switch (ret) {
-                case HASH_SUCCESS:
-                    iter->members[j] = (struct mbof_member *)value.ptr;
-                    j++;
-                    break;
+        for (i = 0; i < grp->memuids->num_values; i++) {
+            key.type = HASH_KEY_STRING;
+            key.str = (char *)grp->memuids->values[i].data;
 
-                case HASH_ERROR_KEY_NOT_FOUND:
-                    /* not a user, see if it is a group */
+            ret = hash_delete(grp->ghosts, &key);
+            if (ret != HASH_SUCCESS && ret != HASH_ERROR_KEY_NOT_FOUND) {
+                ret = LDB_ERR_OPERATIONS_ERROR;
+                goto done;
+            }
+        }
+    }
 
-                    ret = hash_lookup(ctx->group_table, &key, &value);
-                    if (ret != HASH_SUCCESS) {
-                        if (ret != HASH_ERROR_KEY_NOT_FOUND) {
-                            return ldb_module_done(ctx->req, NULL, NULL,
-                                                   LDB_ERR_OPERATIONS_ERROR);
-                        }
-                    }
-                    if (ret == HASH_ERROR_KEY_NOT_FOUND) {
-                        /* not a known user, nor a known group!?
-                           give a warning and continue */
-                        ldb_debug(ldb, LDB_DEBUG_ERROR,
-                                  "member attribute [%s] has no corresponding"
-                                  " entry!", key.str);
-                        break;
-                    }
+    ret = LDB_SUCCESS;
 
-                    iter->members[j] = (struct mbof_member *)value.ptr;
-                    j++;
-                    break;
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
 
-                default:
-                    return ldb_module_done(ctx->req, NULL, NULL,
-                                           LDB_ERR_OPERATIONS_ERROR);
-                }
-            }
-            /* terminate */
-            iter->members[j] = NULL;
+static int mbof_val_cmp(const void *a, const void *b)
+{
+    const struct ldb_val *va = (const struct ldb_val *)a;
+    const struct ldb_val *vb = (const struct ldb_val *)b;
 
-            talloc_zfree(iter->orig_members);
-        }
+    if (va->length != vb->length) {
+        return va->length < vb->length ? -1 : 1;
+    }
 
-        /* now generate correct memberof tables */
-        while (ctx->group_list->status == MBOF_GROUP_TO_DO) {
+    return memcmp(va->data, vb->data, va->length);
+}
 
-            grp = ctx->group_list;
+static bool mbof_el_equal(struct ldb_message_element *a,
+                          struct ldb_message_element *b)
+{
+    struct ldb_val *va;
+    struct ldb_val *vb;
+    bool equal = false;
+    int i;
 
-            /* move to end of list and mark as done.
-             * NOTE: this is not efficient, but will do for now */
-            DLIST_DEMOTE(ctx->group_list, grp, struct mbof_member *);
-            grp->status = MBOF_GROUP_DONE;
+    if (a->num_values != b->num_values) {
+        return false;
+    }
 
-            /* verify if members need updating */
-            if (!grp->members) {
-                continue;
-            }
-            for (i = 0; grp->members[i]; i++) {
-                ret = mbof_member_update(ctx, grp, grp->members[i]);
-                if (ret != LDB_SUCCESS) {
-                    return ldb_module_done(ctx->req, NULL, NULL,
-                                           LDB_ERR_OPERATIONS_ERROR);
-                }
-            }
-        }
+    va = talloc_memdup(NULL, a->values, a->num_values * sizeof(*va));
+    vb = talloc_memdup(NULL, b->values, b->num_values * sizeof(*vb));
+    if ((va == NULL || vb == NULL) && a->num_values > 0) {
+        goto done;
+    }
 
-        /* ok all done, now go on and modify the tree */
-        return mbof_rcmp_update(ctx);
+    qsort(va, a->num_values, sizeof(*va), mbof_val_cmp);
+    qsort(vb, b->num_values, sizeof(*vb), mbof_val_cmp);
+
+    for (i = 0; i < a->num_values; i++) {
+        if (mbof_val_cmp(&va[i], &vb[i]) != 0) {
+            goto done;
+        }
     }
+    equal = true;
 
-    talloc_zfree(ares);
-    return LDB_SUCCESS;
+done:
+    talloc_free(va);
+    talloc_free(vb);
+    return equal;
 }
 
-static int mbof_member_update(struct mbof_rcmp_context *ctx,
-                              struct mbof_member *parent,
-                              struct mbof_member *mem)
+/* remove the replaced attributes whose values did not change */
+static void mbof_rcmp_drop_unchanged(struct mbof_member *x,
+                                     struct ldb_message *msg)
 {
-    hash_value_t value;
-    hash_key_t key;
-    int ret;
-
-    /* ignore loops */
-    if (parent == mem) return LDB_SUCCESS;
+    struct ldb_message_element *orig;
+    struct ldb_message_element *el;
+    int i;
 
-    key.type = HASH_KEY_STRING;
-    key.str = discard_const(ldb_dn_get_linearized(parent->dn));
+    for (i = msg->num_elements - 1; i >= 0; i--) {
+        el = &msg->elements[i];
 
-    if (!mem->memberofs) {
-        ret = hash_create_ex(0, &mem->memberofs, 0, 0, 0, 0,
-                             hash_alloc, hash_free, mem, NULL, NULL);
-        if (ret != HASH_SUCCESS) {
-            return LDB_ERR_OPERATIONS_ERROR;
+        if (LDB_FLAG_MOD_TYPE(el->flags) != LDB_FLAG_MOD_REPLACE) {
+            continue;
         }
 
-        ret = HASH_ERROR_KEY_NOT_FOUND;
-
-    } else {
+        if (strcmp(el->name, DB_MEMBEROF) == 0) {
+            orig = x->orig_memberof;
+        } else if (strcmp(el->name, DB_MEMBERUID) == 0) {
+            orig = x->orig_memberuid;
+        } else if (strcmp(el->name, DB_GHOST) == 0) {
+            orig = x->orig_ghosts;
+        } else {
+            continue;
+        }
 
-        ret = hash_lookup(mem->memberofs, &key, &value);
-        if (ret != HASH_SUCCESS) {
-            if (ret != HASH_ERROR_KEY_NOT_FOUND) {
-                /* fatal error */
-                return LDB_ERR_OPERATIONS_ERROR;
-            }
+        if (orig != NULL && mbof_el_equal(el, orig)) {
+            ldb_msg_remove_element(msg, el);
         }
     }
+}
 
-    if (ret == HASH_ERROR_KEY_NOT_FOUND) {
+/* ghost and member attributes of a group at the end of a bulk session */
+static int mbof_rcmp_bulk_attrs(struct mbof_member *x,
+                                struct ldb_message *msg)
+{
+    struct ldb_message_element *el;
+    hash_key_t *keys;
+    unsigned long count = 0;
+    int flags;
+    int ret, i;
 
-        /* it's missing, update member */
-        value.type = HASH_VALUE_PTR;
-        value.ptr = parent;
+    if (x->ghosts) {
+        count = hash_count(x->ghosts);
+    }
 
-        ret = hash_enter(mem->memberofs, &key, &value);
+    if (count > 0) {
+        ret = hash_keys(x->ghosts, &count, &keys);
         if (ret != HASH_SUCCESS) {
             return LDB_ERR_OPERATIONS_ERROR;
         }
 
-        if (mem->status == MBOF_USER) {
-            /* add corresponding memuid to the group */
-            ret = mbof_add_memuid(parent, mem->name);
-            if (ret != LDB_SUCCESS) {
-                return ret;
-            }
+        if (x->orig_has_ghost) {
+            flags = LDB_FLAG_MOD_REPLACE;
+        } else {
+            flags = LDB_FLAG_MOD_ADD;
         }
 
-        /* if we updated a group, mark it as TO DO again */
-        if (mem->status == MBOF_GROUP_DONE) {
-            mem->status = MBOF_GROUP_TO_DO;
+        ret = ldb_msg_add_empty(msg, DB_GHOST, flags, &el);
+        if (ret != LDB_SUCCESS) {
+            return ret;
         }
-    }
 
-    /* now see if the parent has memberofs to pass down */
-    if (parent->memberofs) {
-        ret = hash_iterate(parent->memberofs, mbof_member_iter, mem);
-        if (ret != HASH_SUCCESS) {
+        el->values = talloc_array(el, struct ldb_val, count);
+        if (!el->values) {
             return LDB_ERR_OPERATIONS_ERROR;
         }
-        if (mem->status == MBOF_ITER_ERROR) {
-            return LDB_ERR_OPERATIONS_ERROR;
+        el->num_values = count;
+
+        for (i = 0; i < count; i++) {
+            el->values[i].data = (uint8_t *)keys[i].str;
+            el->values[i].length = strlen(keys[i].str);
+        }
+    } else if (x->orig_has_ghost) {
+        ret = ldb_msg_add_empty(msg, DB_GHOST, LDB_FLAG_MOD_DELETE, NULL);
+        if (ret != LDB_SUCCESS) {
+            return ret;
         }
     }
 
-    /* finally, if it was made TO DO move it to the head */
-    if (mem->status == MBOF_GROUP_TO_DO) {
-        DLIST_PROMOTE(ctx->group_list, mem);
+    if (!x->fix_members) {
+        return LDB_SUCCESS;
     }
 
-    return LDB_SUCCESS;
-}
-
-static bool mbof_member_iter(hash_entry_t *item, void *user_data)
-{
-    struct mbof_member *parent;
-    struct mbof_member *mem;
-    hash_value_t value;
-    int ret;
-
-    mem = talloc_get_type(user_data, struct mbof_member);
+    for (count = 0; x->members && x->members[count]; count++) ;
 
-    /* exclude self */
-    if (strcmp(item->key.str, ldb_dn_get_linearized(mem->dn)) == 0) {
-        return true;
+    if (count == 0) {
+        return ldb_msg_add_empty(msg, DB_MEMBER, LDB_FLAG_MOD_DELETE, NULL);
     }
 
-    /* check if we already have it */
-    ret = hash_lookup(mem->memberofs, &item->key, &value);
-    if (ret != HASH_SUCCESS) {
-        if (ret != HASH_ERROR_KEY_NOT_FOUND) {
-            /* fatal error */
-            mem->status = MBOF_ITER_ERROR;
-            return false;
-        }
-
-        /* was not already here, add it and mark group as TO DO */
-        ret = hash_enter(mem->memberofs, &item->key, &item->value);
-        if (ret != HASH_SUCCESS) {
-            return LDB_ERR_OPERATIONS_ERROR;
-        }
+    ret = ldb_msg_add_empty(msg, DB_MEMBER, LDB_FLAG_MOD_REPLACE, &el);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
 
-        if (mem->status == MBOF_GROUP_DONE) {
-            mem->status = MBOF_GROUP_TO_DO;
-        }
+    el->values = talloc_array(el, struct ldb_val, count);
+    if (!el->values) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+    el->num_values = count;
 
-        if (mem->status == MBOF_USER) {
-            /* add corresponding memuid to the group */
-            parent = (struct mbof_member *)item->value.ptr;
-            ret = mbof_add_memuid(parent, mem->name);
-            if (ret != LDB_SUCCESS) {
-                mem->status = MBOF_ITER_ERROR;
-                return false;
-            }
-        }
+    for (i = 0; i < count; i++) {
+        el->values[i].data = (uint8_t *)discard_const(
+                                ldb_dn_get_linearized(x->members[i]->dn));
+        el->values[i].length = strlen((const char *)el->values[i].data);
     }
 
-    return true;
+    return LDB_SUCCESS;
 }
 
 static int mbof_add_memuid(struct mbof_member *grp, const char *user)
@@ -4391,39 +5411,20 @@ static int mbof_add_memuid(struct mbof_member *grp, const char *user)
     return LDB_SUCCESS;
 }
 
-static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
+static int mbof_rcmp_build_msg(struct mbof_rcmp_context *ctx,
+                               struct mbof_member *x,
+                               struct ldb_message **_msg)
 {
-    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
     struct ldb_message_element *el;
-    struct ldb_message *msg = NULL;
-    struct ldb_request *req;
-    struct mbof_member *x = NULL;
+    struct ldb_message *msg;
     hash_key_t *keys;
     unsigned long count;
     int flags;
     int ret, i;
 
-    /* we process all users first and then all groups */
-    if (ctx->user_list) {
-        /* take the next entry and remove it from the list */
-        x = ctx->user_list;
-        DLIST_REMOVE(ctx->user_list, x);
-    }
-    else if (ctx->group_list) {
-        /* take the next entry and remove it from the list */
-        x = ctx->group_list;
-        DLIST_REMOVE(ctx->group_list, x);
-    }
-    else {
-        /* processing terminated, return */
-        ret = LDB_SUCCESS;
-        goto done;
-    }
-
     msg = ldb_msg_new(ctx);
     if (!msg) {
-        ret = LDB_ERR_OPERATIONS_ERROR;
-        goto done;
+        return LDB_ERR_OPERATIONS_ERROR;
     }
 
     msg->dn = x->dn;
@@ -4432,8 +5433,7 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
     if (x->memberofs) {
         ret = hash_keys(x->memberofs, &count, &keys);
         if (ret != HASH_SUCCESS) {
-            ret = LDB_ERR_OPERATIONS_ERROR;
-            goto done;
+            return LDB_ERR_OPERATIONS_ERROR;
         }
 
         if (x->orig_has_memberof) {
@@ -4444,13 +5444,12 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
 
         ret = ldb_msg_add_empty(msg, DB_MEMBEROF, flags, &el);
         if (ret != LDB_SUCCESS) {
-            goto done;
+            return ret;
         }
 
         el->values = talloc_array(el, struct ldb_val, count);
         if (!el->values) {
-            ret = LDB_ERR_OPERATIONS_ERROR;
-            goto done;
+            return LDB_ERR_OPERATIONS_ERROR;
         }
         el->num_values = count;
 
@@ -4461,7 +5460,7 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
     } else if (x->orig_has_memberof) {
         ret = ldb_msg_add_empty(msg, DB_MEMBEROF, LDB_FLAG_MOD_DELETE, NULL);
         if (ret != LDB_SUCCESS) {
-            goto done;
+            return ret;
         }
     }
 
@@ -4475,11 +5474,67 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
 
         ret = ldb_msg_add(msg, x->memuids, flags);
         if (ret != LDB_SUCCESS) {
-            goto done;
+            return ret;
         }
     }
     else if (x->orig_has_memberuid) {
         ret = ldb_msg_add_empty(msg, DB_MEMBERUID, LDB_FLAG_MOD_DELETE, NULL);
+        if (ret != LDB_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (ctx->bulk) {
+        ret = mbof_rcmp_bulk_attrs(x, msg);
+        if (ret != LDB_SUCCESS) {
+            return ret;
+        }
+
+        /* most entries do not change between two bulk sessions, do not
+         * rewrite them */
+        mbof_rcmp_drop_unchanged(x, msg);
+        if (msg->num_elements == 0) {
+            talloc_free(msg);
+            msg = NULL;
+        }
+    }
+
+    *_msg = msg;
+    return LDB_SUCCESS;
+}
+
+static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    struct ldb_message *msg = NULL;
+    struct ldb_request *req;
+    struct mbof_member *x = NULL;
+    int ret;
+
+    while (msg == NULL) {
+        /* we process all users first and then all groups */
+        if (ctx->user_list) {
+            /* take the next entry and remove it from the list */
+            x = ctx->user_list;
+            DLIST_REMOVE(ctx->user_list, x);
+        }
+        else if (ctx->group_list) {
+            /* take the next entry and remove it from the list */
+            x = ctx->group_list;
+            DLIST_REMOVE(ctx->group_list, x);
+
+            if (ctx->scoped && !x->rewrite) {
+                /* not affected by the bulk session */
+                continue;
+            }
+        }
+        else {
+            /* processing terminated, return */
+            ret = LDB_SUCCESS;
+            goto done;
+        }
+
+        ret = mbof_rcmp_build_msg(ctx, x, &msg);
         if (ret != LDB_SUCCESS) {
             goto done;
         }
@@ -4494,7 +5549,7 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
     talloc_steal(req, msg);
 
     /* fire next call */
-    return ldb_next_request(ctx->module, req);
+    return mbof_next_write(ctx->module, req);
 
 done:
     /* all users and groups have been processed */
@@ -4545,11 +5600,43 @@ static int mbof_rcmp_mod_callback(struct ldb_request *req,
 
 
 
+/* Renames may move whole subtrees, forget everything we know */
+static int memberof_rename(struct ldb_module *module, struct ldb_request *req)
+{
+    mbof_index_clear(module);
+
+    return ldb_next_request(module, req);
+}
+
+/* The ancestor index is only valid while we hold the transaction lock */
+static int memberof_start_transaction(struct ldb_module *module)
+{
+    mbof_index_clear(module);
+
+    return ldb_next_start_trans(module);
+}
+
+static int memberof_end_transaction(struct ldb_module *module)
+{
+    mbof_index_clear(module);
+
+    return ldb_next_end_trans(module);
+}
+
+static int memberof_del_transaction(struct ldb_module *module)
+{
+    mbof_index_clear(module);
+
+    return ldb_next_del_trans(module);
+}
+
+
 /* module init code */
 
 static int memberof_init(struct ldb_module *module)
 {
     struct ldb_context *ldb = ldb_module_get_ctx(module);
+    struct mbof_priv *priv;
     int ret;
 
     /* set syntaxes for member and memberof so that comparisons in filters and
@@ -4560,6 +5647,10 @@ static int memberof_init(struct ldb_module *module)
     ret = ldb_schema_attribute_add(ldb, DB_MEMBEROF, 0, LDB_SYNTAX_DN);
     if (ret != 0) return LDB_ERR_OPERATIONS_ERROR;
 
+    priv = talloc_zero(module, struct mbof_priv);
+    if (priv == NULL) return LDB_ERR_OPERATIONS_ERROR;
+    ldb_module_set_private(module, priv);
+
     return ldb_next_init(module);
 }
 
@@ -4569,6 +5660,10 @@ const struct ldb_module_ops ldb_memberof_module_ops = {
     .add = memberof_add,
     .modify = memberof_mod,
     .del = memberof_del,
+    .rename = memberof_rename,
+    .start_transaction = memberof_start_transaction,
+    .end_transaction = memberof_end_transaction,
+    .del_transaction = memberof_del_transaction,
 };
 
 int ldb_init_module(const char *version)
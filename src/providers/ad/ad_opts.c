@@ -171,6 +171,14 @@ struct dp_option ad_def_ldap_opts[] = {
     { "ldap_library_debug_level", DP_OPT_NUMBER, NULL_NUMBER, NULL_NUMBER},
     { "ldap_use_ppolicy", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "ldap_ppolicy_pwd_change_threshold", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_group_nesting_concurrency", DP_OPT_NUMBER, { .number = 8 }, NULL_NUMBER },
+    { "ldap_group_parents_cache_timeout", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_refresh_usn_full_interval", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_change_notification", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_connection_pool_size", DP_OPT_NUMBER, { .number = 1 }, NULL_NUMBER },
+    { "ldap_page_size_min", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_page_size_max", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_krb5_persistent_child", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     DP_OPTION_TERMINATOR
 };
 
@@ -198,6 +206,8 @@ struct dp_option ad_def_krb5_opts[] = {
     { "krb5_kdcinfo_lookahead", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_map_user", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_use_subdomain_realm", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -200,10 +200,32 @@ static errno_t ad_refresh_recv(struct tevent_req *req)
     return EOK;
 }
 
+static struct tevent_req *ad_refresh_usn_send(TALLOC_CTX *mem_ctx,
+                                               struct tevent_context *ev,
+                                               struct be_ctx *be_ctx,
+                                               struct sss_domain_info *domain,
+                                               int entry_type,
+                                               char **names,
+                                               void *pvt)
+{
+    struct ad_id_ctx *id_ctx = talloc_get_type(pvt, struct ad_id_ctx);
+
+    return sdap_refresh_usn_send(mem_ctx, ev, domain, entry_type,
+                                 SYSDB_SID_STR, names,
+                                 ad_get_dom_ldap_conn(id_ctx, domain));
+}
+
+static errno_t ad_refresh_usn_recv(struct tevent_req *req)
+{
+    return sdap_refresh_usn_recv(req);
+}
+
 REFRESH_SEND_RECV_FNS(ad_refresh_initgroups, ad_refresh, BE_REQ_INITGROUPS);
 REFRESH_SEND_RECV_FNS(ad_refresh_users, ad_refresh, BE_REQ_USER);
 REFRESH_SEND_RECV_FNS(ad_refresh_groups, ad_refresh, BE_REQ_GROUP);
 REFRESH_SEND_RECV_FNS(ad_refresh_netgroups, ad_refresh, BE_REQ_NETGROUP);
+REFRESH_SEND_RECV_FNS(ad_refresh_users_usn, ad_refresh_usn, BE_REQ_USER);
+REFRESH_SEND_RECV_FNS(ad_refresh_groups_usn, ad_refresh_usn, BE_REQ_GROUP);
 
 errno_t ad_refresh_init(struct be_ctx *be_ctx,
                         struct ad_id_ctx *id_ctx)
@@ -216,10 +238,14 @@ errno_t ad_refresh_init(struct be_ctx *be_ctx,
         },
         { .send_fn = ad_refresh_users_send,
           .recv_fn = ad_refresh_users_recv,
+          .bulk_send_fn = ad_refresh_users_usn_send,
+          .bulk_recv_fn = ad_refresh_users_usn_recv,
           .pvt = id_ctx,
         },
         { .send_fn = ad_refresh_groups_send,
           .recv_fn = ad_refresh_groups_recv,
+          .bulk_send_fn = ad_refresh_groups_usn_send,
+          .bulk_recv_fn = ad_refresh_groups_usn_recv,
           .pvt = id_ctx,
         },
         { .send_fn = ad_refresh_netgroups_send,
@@ -215,6 +215,8 @@ static errno_t be_refresh_add_cb(struct be_refresh_ctx *ctx,
     ctx->callbacks[type].enabled = true;
     ctx->callbacks[type].cb.send_fn = cb->send_fn;
     ctx->callbacks[type].cb.recv_fn = cb->recv_fn;
+    ctx->callbacks[type].cb.bulk_send_fn = cb->bulk_send_fn;
+    ctx->callbacks[type].cb.bulk_recv_fn = cb->bulk_recv_fn;
     ctx->callbacks[type].cb.pvt = cb->pvt;
 
     return EOK;
@@ -314,6 +316,7 @@ static void be_refresh_batch_step_wakeup(struct tevent_context *ev,
                                          struct timeval tv,
                                          void *pvt);
 static errno_t be_refresh_step(struct tevent_req *req);
+static void be_refresh_bulk_done(struct tevent_req *subreq);
 static void be_refresh_done(struct tevent_req *subreq);
 
 struct tevent_req *be_refresh_send(TALLOC_CTX *mem_ctx,
@@ -375,6 +378,7 @@ immediately:
 static errno_t be_refresh_step(struct tevent_req *req)
 {
     struct be_refresh_state *state = NULL;
+    struct tevent_req *subreq = NULL;
     errno_t ret;
 
     state = tevent_req_data(req, struct be_refresh_state);
@@ -427,6 +431,25 @@ static errno_t be_refresh_step(struct tevent_req *req)
               state->cb_ctx->name,
               state->domain->name);
 
+        if (state->refresh_val_size > 0
+                && state->cb_ctx->cb.bulk_send_fn != NULL
+                && state->cb_ctx->cb.bulk_recv_fn != NULL) {
+            subreq = state->cb_ctx->cb.bulk_send_fn(state, state->ev,
+                                                    state->be_ctx,
+                                                    state->domain,
+                                                    state->refresh_values,
+                                                    state->cb_ctx->cb.pvt);
+            if (subreq == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+            tevent_req_set_callback(subreq, be_refresh_bulk_done, req);
+
+            state->index++;
+            ret = EAGAIN;
+            goto done;
+        }
+
         ret = be_refresh_batch_step(req, 0);
         if (ret == EOK) {
             state->index++;
@@ -509,6 +532,59 @@ static void be_refresh_batch_step_wakeup(struct tevent_context *ev,
     tevent_req_set_callback(subreq, be_refresh_done, req);
 }
 
+static void be_refresh_bulk_done(struct tevent_req *subreq)
+{
+    struct be_refresh_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct be_refresh_state);
+
+    ret = state->cb_ctx->cb.bulk_recv_fn(subreq);
+    talloc_zfree(subreq);
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, "All %s refreshed at once\n",
+              state->cb_ctx->name);
+        ret = be_refresh_step(req);
+        if (ret == EAGAIN) {
+            DEBUG(SSSDBG_TRACE_INTERNAL, "Another step in progress\n");
+            return;
+        }
+        goto done;
+    }
+
+    if (ret == ENOTSUP) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Refreshing %s one by one\n",
+              state->cb_ctx->name);
+    } else {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to refresh %s at once, "
+              "refreshing them one by one [%d]: %s\n",
+              state->cb_ctx->name, ret, sss_strerror(ret));
+    }
+
+    ret = be_refresh_batch_step(req, 0);
+    if (ret == EAGAIN) {
+        return;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    ret = be_refresh_step(req);
+    if (ret == EAGAIN) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Another step in progress\n");
+        return;
+    }
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 static void be_refresh_done(struct tevent_req *subreq)
 {
     struct be_refresh_state *state = NULL;
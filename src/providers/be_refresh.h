@@ -71,9 +71,17 @@ enum be_refresh_type {
     BE_REFRESH_TYPE_SENTINEL
 };
 
+/**
+ * bulk_send_fn and bulk_recv_fn are optional. If set, they are called first
+ * with all expired records and should refresh them in a single request. If
+ * the request fails, for example with ENOTSUP, the records are refreshed
+ * with send_fn and recv_fn in batches.
+ */
 struct be_refresh_cb {
     be_refresh_send_t send_fn;
     be_refresh_recv_t recv_fn;
+    be_refresh_send_t bulk_send_fn;
+    be_refresh_recv_t bulk_recv_fn;
     void *pvt;
 };
 
@@ -48,6 +48,7 @@
 #define CHILD_OPT_SSS_CREDS_PASSWORD "sss-creds-password"
 #define CHILD_OPT_CHAIN_ID "chain-id"
 #define CHILD_OPT_CHECK_PAC "check-pac"
+#define CHILD_OPT_WORKER "worker"
 
 struct krb5child_req {
     struct pam_data *pd;
@@ -125,6 +125,9 @@ struct krb5_req {
 
 static krb5_context krb5_error_ctx;
 
+/* Pid of the worker which forked the current process, see k5c_worker() */
+static pid_t k5c_worker_pid;
+
 #define KRB5_CHILD_DEBUG_INT(level, errctx, krb5_error) do { \
     const char *__krb5_error_msg; \
     __krb5_error_msg = sss_krb5_get_error_message(errctx, krb5_error); \
@@ -1738,7 +1741,9 @@ static errno_t k5c_attach_keep_alive_msg(struct krb5_req *kr)
     pid_t pid;
     int ret;
 
-    pid = getpid();
+    /* A request handled by a worker is continued over the worker's pipes,
+     * so the backend has to find it by the worker's pid. */
+    pid = (k5c_worker_pid != 0) ? k5c_worker_pid : getpid();
 
     msg = talloc_memdup(kr, &pid, sizeof(pid_t));
     if (msg == NULL) {
@@ -4090,6 +4095,131 @@ static void try_open_krb5_conf(void)
     }
 }
 
+/* Run as a long-lived worker which reads requests from STDIN and hands each
+ * of them over to a freshly forked process. The Kerberos libraries and
+ * configuration are loaded only once by the worker while no Kerberos state
+ * or credentials are shared between requests.
+ *
+ * The function only returns in the forked process, with the request in
+ * _buf, or when the worker should terminate, with _buf set to NULL. */
+static errno_t k5c_worker(TALLOC_CTX *mem_ctx, uint8_t **_buf, size_t *_len)
+{
+    uint8_t buf[IN_BUF_SIZE];
+    krb5_context ctx = NULL;
+    krb5_error_code kerr;
+    uint64_t chain_id;
+    pid_t worker_pid;
+    pid_t pid;
+    ssize_t len;
+    int status;
+    errno_t ret;
+
+    *_buf = NULL;
+    *_len = 0;
+
+    kerr = krb5_init_context(&ctx);
+    if (kerr != 0) {
+        /* Not fatal, every request initializes its own context anyway */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "krb5_init_context failed [%d], libraries are not preloaded.\n",
+              kerr);
+        ctx = NULL;
+    }
+
+    worker_pid = getpid();
+
+    while (true) {
+        errno = 0;
+        len = sss_atomic_read_safe_s(STDIN_FILENO, buf, IN_BUF_SIZE, NULL);
+        if (len == -1) {
+            ret = errno;
+            if (ret == EIO) {
+                /* The backend closed the pipe, we are done. */
+                DEBUG(SSSDBG_TRACE_FUNC, "Worker is shutting down.\n");
+                ret = EOK;
+            } else {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "read failed [%d][%s].\n", ret, strerror(ret));
+            }
+            goto done;
+        }
+
+        /* Each request starts with the chain id of the backend request */
+        if ((size_t) len < sizeof(uint64_t)) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Request is too short.\n");
+            sss_erase_mem_securely(buf, len);
+            ret = EINVAL;
+            goto done;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+#ifndef __FreeBSD__
+            /* Do not outlive the worker if it is killed on timeout */
+            (void) prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0);
+#endif // __FreeBSD__
+            k5c_worker_pid = worker_pid;
+            debug_prg_name = talloc_asprintf(NULL, "krb5_child[%d]", getpid());
+            if (debug_prg_name == NULL) {
+                debug_prg_name = "krb5_child";
+                DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf failed.\n");
+                /* Try to carry on */
+            }
+
+            safealign_memcpy(&chain_id, buf, sizeof(uint64_t), NULL);
+            sss_chain_id_set(chain_id);
+
+            *_buf = talloc_memdup(mem_ctx, buf + sizeof(uint64_t),
+                                  len - sizeof(uint64_t));
+            sss_erase_mem_securely(buf, len);
+            if (*_buf == NULL) {
+                return ENOMEM;
+            }
+            *_len = len - sizeof(uint64_t);
+
+            return EOK;
+        }
+
+        sss_erase_mem_securely(buf, len);
+        if (pid == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, "fork failed [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto done;
+        }
+
+        /* The backend talks directly to the forked process until it has
+         * finished, including further rounds of a kept alive request. */
+        do {
+            errno = 0;
+            pid = waitpid(pid, &status, 0);
+        } while (pid == -1 && errno == EINTR);
+
+        if (pid == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, "waitpid failed [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto done;
+        }
+
+        /* A request which failed before sending a reply is detected by the
+         * backend when the pipe is closed, so do not keep it open. */
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Request process [%d] failed, terminating worker.\n", pid);
+            ret = EIO;
+            goto done;
+        }
+    }
+
+done:
+    if (ctx != NULL) {
+        krb5_free_context(ctx);
+    }
+
+    return ret;
+}
+
 int main(int argc, const char *argv[])
 {
     struct krb5_req *kr = NULL;
@@ -4106,6 +4236,9 @@ int main(int argc, const char *argv[])
     struct cli_opts cli_opts = { 0 };
     int sss_creds_password = 0;
     long dummy_long = 0;
+    int worker = 0;
+    uint8_t *worker_buf = NULL;
+    size_t worker_len = 0;
 
 
     struct poptOption long_options[] = {
@@ -4139,6 +4272,8 @@ int main(int argc, const char *argv[])
          0, _("Tevent chain ID used for logging purposes"), NULL},
         {CHILD_OPT_CHECK_PAC, 0, POPT_ARG_LONG, &dummy_long, 0,
          _("Check PAC flags"), NULL},
+        {CHILD_OPT_WORKER, 0, POPT_ARG_NONE, &worker, 0,
+         _("Handle multiple requests, each in a new process"), NULL},
         POPT_TABLEEND
     };
 
@@ -4208,6 +4343,13 @@ int main(int argc, const char *argv[])
 
     sss_log_process_caps("Starting");
 
+    if (worker != 0) {
+        ret = k5c_worker(NULL, &worker_buf, &worker_len);
+        if (ret != EOK || worker_buf == NULL) {
+            goto done;
+        }
+    }
+
     kr = talloc_zero(NULL, struct krb5_req);
     if (kr == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
@@ -4215,6 +4357,7 @@ int main(int argc, const char *argv[])
         goto done;
     }
     talloc_steal(kr, debug_prg_name);
+    talloc_steal(kr, worker_buf);
 
     kr->cli_opts = &cli_opts;
     if (sss_creds_password != 0) {
@@ -4223,7 +4366,16 @@ int main(int argc, const char *argv[])
         kr->krb5_get_init_creds_password = krb5_get_init_creds_password;
     }
 
-    ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
+    if (worker_buf != NULL) {
+        ret = unpack_buffer(worker_buf, worker_len, kr, &offline);
+        sss_erase_mem_securely(worker_buf, worker_len);
+        talloc_zfree(worker_buf);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "unpack_buffer failed.\n");
+        }
+    } else {
+        ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
+    }
     if (ret != EOK) {
         goto done;
     }
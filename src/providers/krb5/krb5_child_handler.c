@@ -42,6 +42,8 @@
 
 #define KRB5_CHILD KRB5_CHILD_DIR"/krb5_child"
 
+#define KRB5_CHILD_KEEP_ALIVE_TIMEOUT 300
+
 #define TIME_T_MAX LONG_MAX
 #define int64_to_time_t(val) ((time_t)((val) < TIME_T_MAX ? val : TIME_T_MAX))
 
@@ -55,8 +57,25 @@ struct handle_child_state {
     pid_t child_pid;
 
     struct child_io_fds *io;
+    struct krb5_child_worker *worker;
+};
+
+/* A long-lived krb5_child started with --worker which handles one request
+ * after another, see k5c_worker() in krb5_child.c */
+struct krb5_child_worker {
+    struct krb5_child_worker *prev;
+    struct krb5_child_worker *next;
+
+    /* NULL once the worker was taken out of the pool */
+    struct krb5_ctx *krb5_ctx;
+    struct child_io_fds *io;
+    struct tevent_timer *keep_alive;
+    int requests;
+    bool busy;
 };
 
+static void krb5_child_worker_retire(struct krb5_child_worker *worker);
+
 static errno_t pack_authtok(struct io_buffer *buf, size_t *rp,
                             struct sss_auth_token *tok)
 {
@@ -253,6 +272,36 @@ static errno_t create_send_buffer(struct krb5child_req *kr,
     return EOK;
 }
 
+/* A worker forks a new process for each request, the chain id of the
+ * request is sent in front of it instead of on the command line. */
+static errno_t krb5_child_worker_buffer(TALLOC_CTX *mem_ctx,
+                                        struct io_buffer *buf,
+                                        struct io_buffer **_worker_buf)
+{
+    struct io_buffer *worker_buf;
+    uint64_t chain_id;
+    size_t rp = 0;
+
+    worker_buf = talloc(mem_ctx, struct io_buffer);
+    if (worker_buf == NULL) {
+        return ENOMEM;
+    }
+
+    worker_buf->size = sizeof(uint64_t) + buf->size;
+    worker_buf->data = talloc_size(worker_buf, worker_buf->size);
+    if (worker_buf->data == NULL) {
+        talloc_free(worker_buf);
+        return ENOMEM;
+    }
+
+    chain_id = sss_chain_id_get();
+    SAFEALIGN_SET_VALUE(&worker_buf->data[rp], chain_id, uint64_t, &rp);
+    safealign_memcpy(&worker_buf->data[rp], buf->data, buf->size, &rp);
+
+    *_worker_buf = worker_buf;
+    return EOK;
+}
+
 static void krb5_child_terminate(pid_t pid)
 {
     int ret;
@@ -284,6 +333,11 @@ static void krb5_child_timeout(struct tevent_context *ev,
     /* No I/O expected anymore, make sure sockets are closed properly */
     state->io->in_use = false;
 
+    if (state->worker != NULL) {
+        krb5_child_worker_retire(state->worker);
+        state->worker = NULL;
+    }
+
     DEBUG(SSSDBG_IMPORTANT_INFO,
           "Timeout for child [%d] reached. In case KDC is distant or network "
            "is slow you may consider increasing value of krb5_auth_timeout.\n",
@@ -315,7 +369,7 @@ static errno_t activate_child_timeout_handler(struct tevent_req *req,
 }
 
 errno_t set_extra_args(TALLOC_CTX *mem_ctx, struct krb5_ctx *krb5_ctx,
-                       struct sss_domain_info *domain,
+                       struct sss_domain_info *domain, bool worker,
                        const char ***krb5_child_extra_args)
 {
     const char **extra_args;
@@ -441,14 +495,25 @@ errno_t set_extra_args(TALLOC_CTX *mem_ctx, struct krb5_ctx *krb5_ctx,
         c++;
     }
 
-    chain_id = sss_chain_id_get();
-    extra_args[c] = talloc_asprintf(extra_args,
-                                    "--"CHILD_OPT_CHAIN_ID"=%lu",
-                                    chain_id);
-    if (extra_args[c] == NULL) {
-        DEBUG(SSSDBG_OP_FAILURE, "talloc_asprintf failed.\n");
-        ret = ENOMEM;
-        goto done;
+    if (worker) {
+        /* A worker handles requests of different chains, it gets the chain
+         * id with each request, see krb5_child_worker_buffer(). */
+        extra_args[c] = talloc_strdup(extra_args, "--" CHILD_OPT_WORKER);
+        if (extra_args[c] == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "talloc_strdup failed.\n");
+            ret = ENOMEM;
+            goto done;
+        }
+    } else {
+        chain_id = sss_chain_id_get();
+        extra_args[c] = talloc_asprintf(extra_args,
+                                        "--"CHILD_OPT_CHAIN_ID"=%lu",
+                                        chain_id);
+        if (extra_args[c] == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "talloc_asprintf failed.\n");
+            ret = ENOMEM;
+            goto done;
+        }
     }
     c++;
 
@@ -503,6 +568,7 @@ static void child_keep_alive_timeout(struct tevent_context *ev,
 
 static errno_t fork_child(struct tevent_context *ev,
                           struct krb5child_req *kr,
+                          bool worker,
                           pid_t *_child_pid,
                           struct child_io_fds **_io)
 {
@@ -522,7 +588,8 @@ static errno_t fork_child(struct tevent_context *ev,
         return ENOMEM;
     }
 
-    ret = set_extra_args(tmp_ctx, kr->krb5_ctx, kr->dom, &krb5_child_extra_args);
+    ret = set_extra_args(tmp_ctx, kr->krb5_ctx, kr->dom, worker,
+                         &krb5_child_extra_args);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "set_extra_args failed.\n");
         goto done;
@@ -600,13 +667,16 @@ static errno_t fork_child(struct tevent_context *ev,
 
     /* Setup child's keep alive timeout for open file descriptors. This timeout
      * is quite big to allow additional user interactions when the child is kept
-     * alive for further communication. */
-    tv = tevent_timeval_current_ofs(300, 0);
-    te = tevent_add_timer(ev, io, tv, child_keep_alive_timeout, io);
-    if (te == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to setup child timeout\n");
-        ret = ENOMEM;
-        goto done;
+     * alive for further communication. Workers are only limited while they
+     * are kept alive for a request, see krb5_child_worker_release(). */
+    if (!worker) {
+        tv = tevent_timeval_current_ofs(KRB5_CHILD_KEEP_ALIVE_TIMEOUT, 0);
+        te = tevent_add_timer(ev, io, tv, child_keep_alive_timeout, io);
+        if (te == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to setup child timeout\n");
+            ret = ENOMEM;
+            goto done;
+        }
     }
 
     /* Setup the child handler. It will free io and remove it from the hash
@@ -637,6 +707,186 @@ done:
     return ret;
 }
 
+static int krb5_child_worker_destructor(struct krb5_child_worker *worker)
+{
+    if (worker->krb5_ctx != NULL) {
+        DLIST_REMOVE(worker->krb5_ctx->child_workers, worker);
+    }
+
+    return 0;
+}
+
+static bool krb5_child_worker_usable(struct krb5child_req *kr)
+{
+    if (dp_opt_get_int(kr->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE) <= 0) {
+        return false;
+    }
+
+    /* Workers are started with the realm of the configured domain, see
+     * set_extra_args(). */
+    if (kr->dom != NULL && IS_SUBDOMAIN(kr->dom)
+            && dp_opt_get_bool(kr->krb5_ctx->opts, KRB5_USE_SUBDOMAIN_REALM)) {
+        return false;
+    }
+
+    return true;
+}
+
+/* Reserve an idle worker for a new request or start a new one if the pool
+ * is not full yet. Returns EAGAIN if all workers are busy. */
+static errno_t krb5_child_worker_get(struct tevent_context *ev,
+                                     struct krb5child_req *kr,
+                                     struct krb5_child_worker **_worker)
+{
+    struct krb5_ctx *krb5_ctx = kr->krb5_ctx;
+    struct krb5_child_worker *worker;
+    struct child_io_fds *io;
+    pid_t pid;
+    int count = 0;
+    errno_t ret;
+
+    DLIST_FOR_EACH(worker, krb5_ctx->child_workers) {
+        if (!worker->busy && !worker->io->child_exited) {
+            goto done;
+        }
+        count++;
+    }
+
+    if (count >= dp_opt_get_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE)) {
+        return EAGAIN;
+    }
+
+    ret = fork_child(ev, kr, true, &pid, &io);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to start krb5_child worker "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        return ret;
+    }
+
+    worker = talloc_zero(io, struct krb5_child_worker);
+    if (worker == NULL) {
+        /* io is freed by child_exited() */
+        krb5_child_terminate(pid);
+        return ENOMEM;
+    }
+
+    worker->krb5_ctx = krb5_ctx;
+    worker->io = io;
+    talloc_set_destructor(worker, krb5_child_worker_destructor);
+    DLIST_ADD(krb5_ctx->child_workers, worker);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started krb5_child worker [%d].\n", pid);
+
+done:
+    worker->busy = true;
+    worker->requests++;
+
+    *_worker = worker;
+    return EOK;
+}
+
+static struct krb5_child_worker *
+krb5_child_worker_find(struct krb5_ctx *krb5_ctx, struct child_io_fds *io)
+{
+    struct krb5_child_worker *worker;
+
+    DLIST_FOR_EACH(worker, krb5_ctx->child_workers) {
+        if (worker->io == io) {
+            return worker;
+        }
+    }
+
+    return NULL;
+}
+
+/* Take the worker out of the pool. Closing its input makes it exit, the
+ * worker is freed together with the io structure by child_exited(). */
+static void krb5_child_worker_retire(struct krb5_child_worker *worker)
+{
+    if (worker->krb5_ctx == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Retiring krb5_child worker [%d].\n",
+          worker->io->pid);
+
+    DLIST_REMOVE(worker->krb5_ctx->child_workers, worker);
+    worker->krb5_ctx = NULL;
+    talloc_zfree(worker->keep_alive);
+
+    if (worker->io->write_to_child_fd != -1) {
+        close(worker->io->write_to_child_fd);
+        worker->io->write_to_child_fd = -1;
+    }
+}
+
+static bool krb5_child_response_keep_alive(uint8_t *buf, ssize_t len)
+{
+    size_t p = sizeof(int32_t);
+    int32_t msg_type;
+    int32_t msg_len;
+
+    /* See parse_krb5_child_response() for the message format */
+    while (len > 0 && p + 2 * sizeof(int32_t) <= (size_t) len) {
+        SAFEALIGN_COPY_INT32(&msg_type, buf + p, &p);
+        SAFEALIGN_COPY_INT32(&msg_len, buf + p, &p);
+
+        if (msg_type == SSS_CHILD_KEEP_ALIVE) {
+            return true;
+        }
+
+        if (msg_len < 0 || (size_t) msg_len > len - p) {
+            return false;
+        }
+        p += msg_len;
+    }
+
+    return false;
+}
+
+/* Return the worker to the pool once the request is finished. */
+static void krb5_child_worker_release(struct tevent_context *ev,
+                                      struct krb5_child_worker *worker,
+                                      errno_t error,
+                                      uint8_t *buf,
+                                      ssize_t len)
+{
+    struct timeval tv;
+
+    if (worker->krb5_ctx == NULL) {
+        return;
+    }
+
+    talloc_zfree(worker->keep_alive);
+
+    /* Without a reply the request process failed and the worker exits. */
+    if (error != EOK || len <= 0) {
+        krb5_child_worker_retire(worker);
+        return;
+    }
+
+    if (krb5_child_response_keep_alive(buf, len)) {
+        /* The request continues with the same process, keep the worker
+         * reserved as long as a forked krb5_child would be kept alive. */
+        tv = tevent_timeval_current_ofs(KRB5_CHILD_KEEP_ALIVE_TIMEOUT, 0);
+        worker->keep_alive = tevent_add_timer(ev, worker, tv,
+                                              child_keep_alive_timeout,
+                                              worker->io);
+        if (worker->keep_alive == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to setup child timeout\n");
+            krb5_child_worker_retire(worker);
+        }
+        return;
+    }
+
+    worker->busy = false;
+
+    if (worker->requests >= dp_opt_get_int(worker->krb5_ctx->opts,
+                                           KRB5_CHILD_MAX_REQUESTS)) {
+        krb5_child_worker_retire(worker);
+    }
+}
+
 static void handle_child_step(struct tevent_req *subreq);
 static void handle_child_done(struct tevent_req *subreq);
 
@@ -678,11 +928,31 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
     }
 
     if (kr->pd->child_pid == 0) {
-        /* Create new child. */
-        ret = fork_child(ev, kr, &state->child_pid, &state->io);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "fork_child failed.\n");
-            goto fail;
+        if (krb5_child_worker_usable(kr)) {
+            ret = krb5_child_worker_get(ev, kr, &state->worker);
+            if (ret != EOK && ret != EAGAIN) {
+                DEBUG(SSSDBG_MINOR_FAILURE, "No krb5_child worker available "
+                      "[%d]: %s\n", ret, sss_strerror(ret));
+            }
+        }
+
+        if (state->worker != NULL) {
+            state->io = state->worker->io;
+            state->child_pid = state->io->pid;
+
+            ret = krb5_child_worker_buffer(state, buf, &buf);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "krb5_child_worker_buffer failed.\n");
+                goto fail;
+            }
+        } else {
+            /* Create new child. */
+            ret = fork_child(ev, kr, false, &state->child_pid, &state->io);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "fork_child failed.\n");
+                goto fail;
+            }
         }
 
         /* Setup timeout. If failed, terminate the child process. */
@@ -710,6 +980,8 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
             ret = ENOENT;
             goto fail;
         }
+
+        state->worker = krb5_child_worker_find(kr->krb5_ctx, state->io);
     }
 
     state->io->in_use = true;
@@ -724,6 +996,9 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
     return req;
 
 fail:
+    if (state->worker != NULL) {
+        krb5_child_worker_release(ev, state->worker, ret, NULL, 0);
+    }
     tevent_req_error(req, ret);
     tevent_req_post(req, ev);
     return req;
@@ -754,6 +1029,9 @@ static void handle_child_step(struct tevent_req *subreq)
 done:
     if (ret != EOK) {
         state->io->in_use = false;
+        if (state->worker != NULL) {
+            krb5_child_worker_release(state->ev, state->worker, ret, NULL, 0);
+        }
         if (state->io->child_exited) {
             talloc_free(state->io);
         }
@@ -781,6 +1059,10 @@ static void handle_child_done(struct tevent_req *subreq)
 
 done:
     state->io->in_use = false;
+    if (state->worker != NULL) {
+        krb5_child_worker_release(state->ev, state->worker, ret,
+                                  state->buf, state->len);
+    }
     if (state->io->child_exited) {
         talloc_free(state->io);
     }
@@ -65,6 +65,8 @@ enum krb5_opts {
     KRB5_KDCINFO_LOOKAHEAD,
     KRB5_MAP_USER,
     KRB5_USE_SUBDOMAIN_REALM,
+    KRB5_CHILD_POOL_SIZE,
+    KRB5_CHILD_MAX_REQUESTS,
 
     KRB5_OPTS
 };
@@ -137,6 +139,7 @@ struct krb5_ctx {
 
     hash_table_t *wait_queue_hash;
     hash_table_t *io_table;
+    struct krb5_child_worker *child_workers;
 
     enum krb5_config_type config_type;
 
@@ -244,6 +247,6 @@ krb5_error_code copy_keytab_into_memory(TALLOC_CTX *mem_ctx, krb5_context kctx,
                                         krb5_keytab *_mem_keytab);
 
 errno_t set_extra_args(TALLOC_CTX *mem_ctx, struct krb5_ctx *krb5_ctx,
-                       struct sss_domain_info *domain,
+                       struct sss_domain_info *domain, bool worker,
                        const char ***krb5_child_extra_args);
 #endif /* __KRB5_COMMON_H__ */
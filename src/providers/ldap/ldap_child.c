@@ -29,7 +29,9 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <signal.h>
+#include <poll.h>
 #include <popt.h>
 #ifndef __FreeBSD__
 #include <sys/prctl.h>
@@ -41,6 +43,7 @@
 #include "providers/backend.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/krb5/krb5_common.h"
+#include "providers/ldap/ldap_child_tgt_cache.h"
 
 char *global_ccname_file_dummy = NULL;
 
@@ -63,6 +66,7 @@ struct input_buffer {
     const char *princ_str;
     char *keytab_name;
     krb5_deltat lifetime;
+    bool canonicalize;
     krb5_context context;
 };
 
@@ -136,6 +140,12 @@ static errno_t unpack_buffer(uint8_t *buf, size_t size,
     ibuf->lifetime = (krb5_deltat)value;
     DEBUG(SSSDBG_TRACE_LIBS, "lifetime: %u\n", ibuf->lifetime);
 
+    /* canonicalize */
+    SAFEALIGN_COPY_UINT32_CHECK(&value, buf + p, size, &p);
+    ibuf->canonicalize = (value != 0);
+    DEBUG(SSSDBG_TRACE_LIBS, "canonicalize: %s\n",
+          ibuf->canonicalize ? "true" : "false");
+
     return EOK;
 }
 
@@ -519,6 +529,7 @@ static krb5_error_code ldap_child_get_tgt_sync(TALLOC_CTX *memctx,
                                                const char *princ_str,
                                                const char *keytab_name,
                                                const krb5_deltat lifetime,
+                                               bool canonicalize,
                                                const char **ccname_out,
                                                time_t *expire_time_out,
                                                char **_krb5_msg)
@@ -528,7 +539,6 @@ static krb5_error_code ldap_child_get_tgt_sync(TALLOC_CTX *memctx,
     char *realm_name = NULL;
     char *full_princ = NULL;
     char *default_realm = NULL;
-    char *tmp_str = NULL;
     krb5_keytab keytab = NULL;
     krb5_ccache ccache = NULL;
     krb5_principal kprinc;
@@ -536,7 +546,6 @@ static krb5_error_code ldap_child_get_tgt_sync(TALLOC_CTX *memctx,
     krb5_get_init_creds_opt *options = NULL;
     krb5_error_code krberr;
     krb5_timestamp kdc_time_offset;
-    int canonicalize = 0;
     int kdc_time_offset_usec;
     int ret;
     errno_t error_code;
@@ -662,12 +671,10 @@ static krb5_error_code ldap_child_get_tgt_sync(TALLOC_CTX *memctx,
     }
 
 
-    tmp_str = getenv("KRB5_CANONICALIZE");
-    if (tmp_str != NULL && strcasecmp(tmp_str, "true") == 0) {
+    if (canonicalize) {
         DEBUG(SSSDBG_CONF_SETTINGS, "Will canonicalize principals\n");
-        canonicalize = 1;
     }
-    sss_krb5_get_init_creds_opt_set_canonicalize(options, canonicalize);
+    sss_krb5_get_init_creds_opt_set_canonicalize(options, canonicalize ? 1 : 0);
 
     ccname_file = talloc_asprintf(tmp_ctx, "%s/ccache_%s",
                                   DB_PATH, realm_name);
@@ -961,6 +968,7 @@ static errno_t handle_get_tgt(TALLOC_CTX *mem_ctx,
     kerr = ldap_child_get_tgt_sync(mem_ctx, ibuf->context,
                                    ibuf->realm_str, ibuf->princ_str,
                                    ibuf->keytab_name, ibuf->lifetime,
+                                   ibuf->canonicalize,
                                    &ccname, &expire_time, &krb5_msg);
     if (kerr != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "ldap_child_get_tgt_sync() failed.\n");
@@ -977,6 +985,279 @@ static errno_t handle_get_tgt(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+static errno_t handle_request(TALLOC_CTX *mem_ctx,
+                              uint8_t *buf, size_t len,
+                              struct response **resp)
+{
+    struct input_buffer *ibuf;
+    errno_t ret;
+
+    ibuf = talloc_zero(mem_ctx, struct input_buffer);
+    if (ibuf == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
+        return ENOMEM;
+    }
+
+    ret = unpack_buffer(buf, len, ibuf);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "unpack_buffer failed.[%d][%s].\n", ret, strerror(ret));
+        return ret;
+    }
+
+    if (ibuf->cmd == LDAP_CHILD_SELECT_PRINCIPAL) {
+        ret = handle_select_principal(mem_ctx, ibuf, resp);
+    } else if (ibuf->cmd == LDAP_CHILD_GET_TGT) {
+        ret = handle_get_tgt(mem_ctx, ibuf, resp);
+    } else {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected command [%d]\n", ibuf->cmd);
+        ret = EINVAL;
+    }
+
+    return ret;
+}
+
+/* ==Persistent-mode====================================================== */
+
+/* In persistent mode ldap_child reads length-prefixed requests from STDIN
+ * until the backend closes the pipe. Every request is still handled by a
+ * short-lived forked process, so keys and Kerberos state never live in the
+ * long-running process and privileges are dropped as usual. The long-running
+ * process only remembers the replies to GET_TGT requests and repeats the
+ * requests on its own shortly before the tickets expire. */
+
+#define LC_RESPONSE_SIZE 4096
+
+static errno_t lc_fork_request(TALLOC_CTX *mem_ctx,
+                               uint8_t *req, size_t req_len,
+                               uint8_t **_resp, size_t *_resp_len)
+{
+    int pipefd[2] = PIPE_INIT;
+    struct response *resp = NULL;
+    uint8_t *buf;
+    ssize_t len;
+    pid_t pid;
+    pid_t wpid;
+    int status;
+    errno_t ret;
+
+    buf = talloc_size(mem_ctx, LC_RESPONSE_SIZE);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    ret = pipe(pipefd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto done;
+    }
+
+    pid = fork();
+    if (pid == 0) { /* child */
+        PIPE_FD_CLOSE(pipefd[0]);
+#ifndef __FreeBSD__
+        /* Let sig_term_handler() clean up if the parent is terminated */
+        (void) prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+#endif // __FreeBSD__
+        debug_prg_name = talloc_asprintf(mem_ctx, "ldap_child[%d]", getpid());
+        if (debug_prg_name == NULL) {
+            debug_prg_name = "ldap_child";
+        }
+
+        ret = handle_request(mem_ctx, req, req_len, &resp);
+        if (ret == EOK) {
+            len = sss_atomic_write_s(pipefd[1], resp->buf, resp->size);
+            if (len == -1 || (size_t) len != resp->size) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "write failed.\n");
+                ret = EIO;
+            }
+        }
+
+        _exit(ret == EOK ? 0 : -1);
+    } else if (pid == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        goto done;
+    }
+
+    PIPE_FD_CLOSE(pipefd[1]);
+
+    errno = 0;
+    len = sss_atomic_read_s(pipefd[0], buf, LC_RESPONSE_SIZE);
+    ret = errno;
+
+    do {
+        errno = 0;
+        wpid = waitpid(pid, &status, 0);
+    } while (wpid == -1 && errno == EINTR);
+
+    if (len <= 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "Request process [%d] did not reply [%d][%s].\n",
+              pid, ret, strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+
+    *_resp = buf;
+    *_resp_len = len;
+    ret = EOK;
+
+done:
+    PIPE_CLOSE(pipefd);
+    if (ret != EOK) {
+        talloc_free(buf);
+    }
+
+    return ret;
+}
+
+static void lc_tgt_renew(struct lc_tgt_cache *cache)
+{
+    struct lc_tgt *tgt;
+    struct lc_tgt *next;
+    TALLOC_CTX *tmp_ctx;
+    uint8_t *resp;
+    size_t resp_len;
+    errno_t ret;
+
+    DLIST_FOR_EACH_SAFE(tgt, next, cache->tgts) {
+        if (tgt->renew_time > time(NULL)) {
+            continue;
+        }
+
+        tmp_ctx = talloc_new(NULL);
+        if (tmp_ctx == NULL) {
+            return;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "Renewing TGT before it expires.\n");
+        ret = lc_fork_request(tmp_ctx, tgt->req, tgt->req_len,
+                              &resp, &resp_len);
+        if (ret != EOK) {
+            resp = NULL;
+            resp_len = 0;
+        }
+
+        lc_tgt_update(cache, tgt->req, tgt->req_len, resp, resp_len);
+        talloc_free(tmp_ctx);
+    }
+}
+
+static errno_t lc_process_request(TALLOC_CTX *mem_ctx,
+                                  struct lc_tgt_cache *cache,
+                                  uint8_t *req, size_t req_len,
+                                  uint8_t **_resp, size_t *_resp_len)
+{
+    struct lc_tgt *tgt;
+    uint32_t cmd;
+    size_t p = 0;
+    errno_t ret;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&cmd, req + p, req_len, &p);
+    DEBUG(SSSDBG_TRACE_LIBS, "command: %s\n", command_to_str(cmd));
+
+    if (cmd == LDAP_CHILD_GET_TGT) {
+        tgt = lc_tgt_find(cache, req, req_len);
+        if (tgt != NULL && time(NULL) < tgt->renew_time) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Using previously acquired TGT.\n");
+            *_resp = talloc_memdup(mem_ctx, tgt->resp, tgt->resp_len);
+            if (*_resp == NULL) {
+                return ENOMEM;
+            }
+            *_resp_len = tgt->resp_len;
+            return EOK;
+        }
+    }
+
+    ret = lc_fork_request(mem_ctx, req, req_len, _resp, _resp_len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (cmd == LDAP_CHILD_GET_TGT) {
+        lc_tgt_update(cache, req, req_len, *_resp, *_resp_len);
+    }
+
+    return EOK;
+}
+
+static errno_t lc_persistent(TALLOC_CTX *mem_ctx)
+{
+    struct lc_tgt_cache *cache;
+    uint8_t buf[IN_BUF_SIZE];
+    TALLOC_CTX *tmp_ctx;
+    struct pollfd pfd;
+    uint8_t *resp;
+    size_t resp_len;
+    ssize_t len;
+    errno_t ret;
+
+    cache = talloc_zero(mem_ctx, struct lc_tgt_cache);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+
+    while (true) {
+        lc_tgt_renew(cache);
+
+        pfd.fd = STDIN_FILENO;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        ret = poll(&pfd, 1, lc_tgt_renew_timeout(cache));
+        if (ret == -1) {
+            ret = errno;
+            if (ret == EINTR) {
+                continue;
+            }
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "poll failed [%d][%s].\n", ret, strerror(ret));
+            return ret;
+        } else if (ret == 0) {
+            /* A renewal is due */
+            continue;
+        }
+
+        errno = 0;
+        len = sss_atomic_read_safe_s(STDIN_FILENO, buf, IN_BUF_SIZE, NULL);
+        if (len == -1) {
+            ret = errno;
+            if (ret == EIO) {
+                DEBUG(SSSDBG_TRACE_FUNC, "Input closed, exiting.\n");
+                return EOK;
+            }
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "read failed [%d][%s].\n", ret, strerror(ret));
+            return ret;
+        }
+
+        tmp_ctx = talloc_new(mem_ctx);
+        if (tmp_ctx == NULL) {
+            return ENOMEM;
+        }
+
+        ret = lc_process_request(tmp_ctx, cache, buf, len, &resp, &resp_len);
+        if (ret != EOK) {
+            /* An empty reply tells the backend that the request failed */
+            resp = NULL;
+            resp_len = 0;
+        }
+
+        errno = 0;
+        len = sss_atomic_write_safe_s(STDOUT_FILENO, resp, resp_len);
+        ret = errno;
+        talloc_free(tmp_ctx);
+        if (len == -1 || (size_t) len != resp_len) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "write failed [%d][%s].\n", ret, strerror(ret));
+            return EIO;
+        }
+    }
+}
+
 int main(int argc, const char *argv[])
 {
     int ret;
@@ -984,12 +1265,12 @@ int main(int argc, const char *argv[])
     int dummy = 1;
     int backtrace = 1;
     int debug_fd = -1;
+    int persistent = 0;
     const char *opt_logger = NULL;
     poptContext pc;
     TALLOC_CTX *main_ctx = NULL;
     uint8_t *buf = NULL;
     ssize_t len = 0;
-    struct input_buffer *ibuf = NULL;
     struct response *resp = NULL;
     ssize_t written;
 
@@ -1003,6 +1284,9 @@ int main(int argc, const char *argv[])
         {"debug-fd", 0, POPT_ARG_INT, &debug_fd, 0,
          _("An open file descriptor for the debug logs"), NULL},
         SSSD_LOGGER_OPTS
+        {LDAP_CHILD_OPT_PERSISTENT, 0, POPT_ARG_NONE, &persistent, 0,
+         _("Handle requests until the input is closed and renew the "
+           "acquired tickets"), NULL},
         POPT_TABLEEND
     };
 
@@ -1060,14 +1344,16 @@ int main(int argc, const char *argv[])
     }
     talloc_steal(main_ctx, debug_prg_name);
 
-    buf = talloc_size(main_ctx, sizeof(uint8_t)*IN_BUF_SIZE);
-    if (buf == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
-        goto fail;
+    if (persistent != 0) {
+        ret = lc_persistent(main_ctx);
+        if (ret != EOK) {
+            goto fail;
+        }
+        goto done;
     }
 
-    ibuf = talloc_zero(main_ctx, struct input_buffer);
-    if (ibuf == NULL) {
+    buf = talloc_size(main_ctx, sizeof(uint8_t)*IN_BUF_SIZE);
+    if (buf == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
         goto fail;
     }
@@ -1084,25 +1370,8 @@ int main(int argc, const char *argv[])
 
     close(STDIN_FILENO);
 
-    ret = unpack_buffer(buf, len, ibuf);
+    ret = handle_request(main_ctx, buf, len, &resp);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "unpack_buffer failed.[%d][%s].\n", ret, strerror(ret));
-        goto fail;
-    }
-
-    if (ibuf->cmd == LDAP_CHILD_SELECT_PRINCIPAL) {
-        ret = handle_select_principal(main_ctx, ibuf, &resp);
-        if (ret != 0) {
-            goto fail;
-        }
-    } else if (ibuf->cmd == LDAP_CHILD_GET_TGT) {
-        ret = handle_get_tgt(main_ctx, ibuf, &resp);
-        if (ret != 0) {
-            goto fail;
-        }
-    } else {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected command [%d]\n", ibuf->cmd);
         goto fail;
     }
 
@@ -1121,6 +1390,7 @@ int main(int argc, const char *argv[])
         goto fail;
     }
 
+done:
     DEBUG(SSSDBG_TRACE_FUNC, "ldap_child completed successfully\n");
     close(STDOUT_FILENO);
     talloc_free(main_ctx);
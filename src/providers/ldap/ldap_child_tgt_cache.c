@@ -0,0 +1,155 @@
+/*
+    SSSD
+
+    LDAP Backend Module -- tickets remembered by the persistent ldap_child
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <limits.h>
+
+#include "util/util.h"
+#include "util/sss_krb5.h"
+#include "providers/ldap/ldap_child_tgt_cache.h"
+
+static errno_t lc_parse_tgt_response(uint8_t *buf, size_t size,
+                                     uint32_t *_result, time_t *_expire_time)
+{
+    uint32_t result;
+    size_t p = 0;
+
+    if (buf == NULL) {
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32_CHECK(&result, buf + p, size, &p);
+
+    if (size < p + sizeof(krb5_error_code) + sizeof(uint32_t)
+                 + sizeof(time_t)) {
+        return EINVAL;
+    }
+
+    /* The expiration time is the last field, see pack_buffer() */
+    safealign_memcpy(_expire_time, buf + size - sizeof(time_t),
+                     sizeof(time_t), NULL);
+    *_result = result;
+
+    return EOK;
+}
+
+struct lc_tgt *lc_tgt_find(struct lc_tgt_cache *cache,
+                           uint8_t *req, size_t req_len)
+{
+    struct lc_tgt *tgt;
+
+    DLIST_FOR_EACH(tgt, cache->tgts) {
+        if (tgt->req_len == req_len && memcmp(tgt->req, req, req_len) == 0) {
+            return tgt;
+        }
+    }
+
+    return NULL;
+}
+
+void lc_tgt_update(struct lc_tgt_cache *cache,
+                   uint8_t *req, size_t req_len,
+                   uint8_t *resp, size_t resp_len)
+{
+    struct lc_tgt *tgt;
+    time_t expire_time = 0;
+    uint32_t result = EFAULT;
+    time_t now;
+    errno_t ret;
+
+    tgt = lc_tgt_find(cache, req, req_len);
+    now = time(NULL);
+
+    ret = lc_parse_tgt_response(resp, resp_len, &result, &expire_time);
+    if (ret != EOK || result != EOK || expire_time <= now) {
+        if (tgt == NULL) {
+            return;
+        }
+
+        /* Keep a ticket which is still valid and retry later */
+        if (tgt->expire_time > now + LC_RENEW_RETRY_TIME) {
+            tgt->renew_time = now + LC_RENEW_RETRY_TIME;
+        } else {
+            DLIST_REMOVE(cache->tgts, tgt);
+            talloc_free(tgt);
+        }
+        return;
+    }
+
+    if (tgt == NULL) {
+        tgt = talloc_zero(cache, struct lc_tgt);
+        if (tgt == NULL) {
+            return;
+        }
+
+        tgt->req = talloc_memdup(tgt, req, req_len);
+        if (tgt->req == NULL) {
+            talloc_free(tgt);
+            return;
+        }
+        tgt->req_len = req_len;
+
+        DLIST_ADD(cache->tgts, tgt);
+    }
+
+    talloc_free(tgt->resp);
+    tgt->resp = talloc_memdup(tgt, resp, resp_len);
+    if (tgt->resp == NULL) {
+        DLIST_REMOVE(cache->tgts, tgt);
+        talloc_free(tgt);
+        return;
+    }
+    tgt->resp_len = resp_len;
+
+    tgt->expire_time = expire_time;
+    tgt->renew_time = now + (expire_time - now) * LC_RENEW_PERCENT / 100;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "TGT expires at [%"SPRItime"], renewal at [%"SPRItime"].\n",
+          tgt->expire_time, tgt->renew_time);
+}
+
+int lc_tgt_renew_timeout(struct lc_tgt_cache *cache)
+{
+    struct lc_tgt *tgt;
+    time_t next = 0;
+    time_t now;
+
+    DLIST_FOR_EACH(tgt, cache->tgts) {
+        if (next == 0 || tgt->renew_time < next) {
+            next = tgt->renew_time;
+        }
+    }
+
+    if (next == 0) {
+        return -1;
+    }
+
+    now = time(NULL);
+    if (next <= now) {
+        return 0;
+    }
+
+    if (next - now > INT_MAX / 1000) {
+        return INT_MAX;
+    }
+
+    return (next - now) * 1000;
+}
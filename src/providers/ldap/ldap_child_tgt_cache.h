@@ -0,0 +1,62 @@
+/*
+    SSSD
+
+    LDAP Backend Module -- tickets remembered by the persistent ldap_child
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LDAP_CHILD_TGT_CACHE_H__
+#define __LDAP_CHILD_TGT_CACHE_H__
+
+#include "util/util.h"
+
+/* Renew a ticket once this share of its remaining lifetime has passed */
+#define LC_RENEW_PERCENT 80
+#define LC_RENEW_RETRY_TIME 60
+
+struct lc_tgt {
+    struct lc_tgt *prev;
+    struct lc_tgt *next;
+
+    /* The request which acquired the ticket, used as the cache key */
+    uint8_t *req;
+    size_t req_len;
+
+    uint8_t *resp;
+    size_t resp_len;
+
+    time_t expire_time;
+    time_t renew_time;
+};
+
+struct lc_tgt_cache {
+    struct lc_tgt *tgts;
+};
+
+struct lc_tgt *lc_tgt_find(struct lc_tgt_cache *cache,
+                           uint8_t *req, size_t req_len);
+
+/* Remember the reply to a GET_TGT request. Failed replies drop the ticket
+ * unless the previous one is still valid, then only a retry is scheduled. */
+void lc_tgt_update(struct lc_tgt_cache *cache,
+                   uint8_t *req, size_t req_len,
+                   uint8_t *resp, size_t resp_len);
+
+/* Milliseconds until the next renewal is due, -1 if there is none */
+int lc_tgt_renew_timeout(struct lc_tgt_cache *cache);
+
+#endif /* __LDAP_CHILD_TGT_CACHE_H__ */
@@ -65,8 +65,11 @@ errno_t sdap_id_setup_tasks(struct be_ctx *be_ctx,
                                   sdom->dom->name);
         ret = ldap_id_setup_cleanup(ctx, sdom);
     }
+    if (ret != EOK) {
+        return ret;
+    }
 
-    return ret;
+    return ldap_id_setup_change_notify(ctx, sdom);
 }
 
 static void sdap_uri_callback(void *private_data, struct fo_server *server)
@@ -51,6 +51,10 @@ enum ldap_child_command {
     LDAP_CHILD_SELECT_PRINCIPAL = 1
 };
 
+/* Command line option which keeps ldap_child running to serve several
+ * requests, see ldap_krb5_persistent_child */
+#define LDAP_CHILD_OPT_PERSISTENT "persistent"
+
 struct sdap_id_ctx;
 
 struct sdap_id_conn_ctx {
@@ -87,6 +91,12 @@ struct sdap_id_ctx {
     struct timeval last_enum;
     /* cleanup loop timer */
     struct timeval last_purge;
+
+    /* state of the USN based background refresh */
+    struct sdap_refresh_usn_ctx *refresh_usn;
+
+    /* change notification subscription, NULL if disabled */
+    struct sdap_change_notify_ctx *notify;
 };
 
 struct sdap_auth_ctx {
@@ -135,7 +145,7 @@ errno_t sdap_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data);
 
-/* Set up enumeration and/or cleanup */
+/* Set up enumeration and/or cleanup and change notification */
 errno_t ldap_id_setup_tasks(struct sdap_id_ctx *ctx);
 errno_t sdap_id_setup_tasks(struct be_ctx *be_ctx,
                             struct sdap_id_ctx *ctx,
@@ -292,6 +302,13 @@ errno_t ldap_id_setup_cleanup(struct sdap_id_ctx *id_ctx,
 errno_t ldap_id_cleanup(struct sdap_id_ctx *id_ctx,
                         struct sdap_domain *sdom);
 
+errno_t ldap_id_setup_change_notify(struct sdap_id_ctx *id_ctx,
+                                    struct sdap_domain *sdom);
+
+/* Returns the time since when all changes on the server are known from
+ * the change notification subscription or 0 if it is not active. */
+time_t sdap_change_notify_active_since(struct sdap_id_ctx *id_ctx);
+
 struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
                                    struct tevent_context *ev,
                                    struct sdap_id_ctx *ctx,
@@ -468,6 +485,19 @@ sdap_resolver_ctx_new(TALLOC_CTX *mem_ctx,
 errno_t sdap_refresh_init(struct be_ctx *be_ctx,
                           struct sdap_id_ctx *id_ctx);
 
+/* Refresh expired users or groups identified by @key_attr with a single
+ * search for entries changed since they were stored. Returns ENOTSUP if
+ * the entries must be refreshed one by one instead. */
+struct tevent_req *sdap_refresh_usn_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct sss_domain_info *domain,
+                                         int entry_type,
+                                         const char *key_attr,
+                                         char **keys,
+                                         struct sdap_id_conn_ctx *conn);
+
+errno_t sdap_refresh_usn_recv(struct tevent_req *req);
+
 errno_t sdap_init_certmap(TALLOC_CTX *mem_ctx, struct sdap_id_ctx *id_ctx);
 
 errno_t sdap_setup_certmap(struct sdap_certmap_ctx *sdap_certmap_ctx,
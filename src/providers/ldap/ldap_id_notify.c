@@ -0,0 +1,486 @@
+/*
+    SSSD
+
+    LDAP Identity Change Notification Functions
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <time.h>
+
+#include "util/util.h"
+#include "util/sss_ptr_hash.h"
+#include "db/sysdb.h"
+#include "providers/be_refresh.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async.h"
+
+/*
+ * While ldap_change_notification is enabled, the backend keeps a change
+ * notification search open on the server. Cached users and groups that
+ * change on the server are refreshed as soon as the notification arrives.
+ *
+ * All changes of entries stored after the subscription was established
+ * are known, so the background refresh can extend the expiration of such
+ * entries without searching the server, see sdap_refresh.c. Neither
+ * control is acknowledged by the server, the subscription is only known to
+ * be established when the first change notification arrives. Whenever
+ * a change is lost, only the entries stored afterwards are known to be
+ * current.
+ */
+
+/* Seconds between attempts to (re)establish the subscription */
+#define LDAP_CHANGE_NOTIFY_PERIOD 60
+
+/* Maximum number of changed entries waiting to be refreshed */
+#define LDAP_CHANGE_NOTIFY_MAX_QUEUE 10000
+
+struct ldap_change_notify_item {
+    struct ldap_change_notify_item *prev;
+    struct ldap_change_notify_item *next;
+
+    const char *dn;
+};
+
+struct sdap_change_notify_ctx {
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+
+    /* Time since when all changes on the server are known, 0 if the
+     * subscription is not active. */
+    time_t active_since;
+    /* The search is sent, but the server may not have processed it yet */
+    bool subscribed;
+    /* The server supports no change notification method */
+    bool unsupported;
+
+    /* Changed entries waiting to be refreshed, the table is keyed by DN */
+    struct ldap_change_notify_item *queue;
+    hash_table_t *queued;
+    size_t queue_len;
+    /* The entry that is being refreshed */
+    struct dp_id_data *account_req;
+};
+
+static void ldap_change_notify_next(struct sdap_change_notify_ctx *nctx);
+static void ldap_change_notify_refresh_done(struct tevent_req *subreq);
+
+/* A change was not applied to the cache, the entries stored before now may
+ * be stale. */
+static void ldap_change_notify_lost(struct sdap_change_notify_ctx *nctx)
+{
+    if (nctx->active_since != 0) {
+        nctx->active_since = time(NULL);
+    }
+}
+
+static void ldap_change_notify_entry(struct sysdb_attrs *entry, void *pvt)
+{
+    struct sdap_change_notify_ctx *nctx;
+    struct ldap_change_notify_item *item;
+    const char *dn;
+    errno_t ret;
+
+    nctx = talloc_get_type(pvt, struct sdap_change_notify_ctx);
+
+    /* The server is sending changes, so it has processed the search. */
+    if (nctx->subscribed && nctx->active_since == 0) {
+        nctx->active_since = time(NULL);
+        DEBUG(SSSDBG_TRACE_FUNC, "Change notification of domain %s is "
+              "active\n", nctx->sdom->dom->name);
+    }
+
+    ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &dn);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Change notification without DN\n");
+        ldap_change_notify_lost(nctx);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Entry [%s] changed on the server\n", dn);
+
+    if (sss_ptr_hash_has_key(nctx->queued, dn)) {
+        return;
+    }
+
+    if (nctx->queue_len >= LDAP_CHANGE_NOTIFY_MAX_QUEUE) {
+        /* The change is lost, entries stored before now may be stale. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Too many changed entries, dropping "
+              "change of [%s]\n", dn);
+        ldap_change_notify_lost(nctx);
+        return;
+    }
+
+    item = talloc_zero(nctx, struct ldap_change_notify_item);
+    if (item == NULL) {
+        ldap_change_notify_lost(nctx);
+        return;
+    }
+
+    item->dn = talloc_strdup(item, dn);
+    if (item->dn == NULL) {
+        talloc_free(item);
+        ldap_change_notify_lost(nctx);
+        return;
+    }
+
+    /* The item is removed from the table when it is freed. */
+    ret = sss_ptr_hash_add(nctx->queued, item->dn, item,
+                           struct ldap_change_notify_item);
+    if (ret != EOK) {
+        talloc_free(item);
+        ldap_change_notify_lost(nctx);
+        return;
+    }
+
+    DLIST_ADD_END(nctx->queue, item, struct ldap_change_notify_item *);
+    nctx->queue_len++;
+
+    if (nctx->account_req == NULL) {
+        ldap_change_notify_next(nctx);
+    }
+}
+
+static errno_t ldap_change_notify_find(TALLOC_CTX *mem_ctx,
+                                       struct sss_domain_info *domain,
+                                       const char *dn,
+                                       int *_entry_type,
+                                       const char **_name)
+{
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message **msgs;
+    size_t count;
+    errno_t ret;
+
+    ret = sysdb_search_users_by_orig_dn(mem_ctx, domain, dn, attrs,
+                                        &count, &msgs);
+    if (ret == EOK && count == 1) {
+        *_entry_type = BE_REQ_USER;
+    } else if (ret == EOK || ret == ENOENT) {
+        ret = sysdb_search_groups_by_orig_dn(mem_ctx, domain, dn, attrs,
+                                             &count, &msgs);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        if (count != 1) {
+            return ENOENT;
+        }
+        *_entry_type = BE_REQ_GROUP;
+    } else {
+        return ret;
+    }
+
+    *_name = ldb_msg_find_attr_as_string(msgs[0], SYSDB_NAME, NULL);
+    if (*_name == NULL) {
+        return ENOENT;
+    }
+
+    return EOK;
+}
+
+static void ldap_change_notify_next(struct sdap_change_notify_ctx *nctx)
+{
+    struct ldap_change_notify_item *item;
+    struct dp_id_data *account_req;
+    struct tevent_req *subreq;
+    const char *name;
+    int entry_type;
+    errno_t ret;
+
+    talloc_zfree(nctx->account_req);
+
+    while ((item = nctx->queue) != NULL) {
+        DLIST_REMOVE(nctx->queue, item);
+        nctx->queue_len--;
+
+        /* Entries that are not cached are not interesting. */
+        ret = ldap_change_notify_find(item, nctx->sdom->dom, item->dn,
+                                      &entry_type, &name);
+        if (ret != EOK) {
+            if (ret != ENOENT) {
+                DEBUG(SSSDBG_OP_FAILURE, "Unable to look up [%s] [%d]: %s\n",
+                      item->dn, ret, sss_strerror(ret));
+                ldap_change_notify_lost(nctx);
+            }
+            talloc_free(item);
+            continue;
+        }
+
+        account_req = be_refresh_acct_req(nctx, entry_type, BE_FILTER_NAME,
+                                          nctx->sdom->dom);
+        if (account_req == NULL) {
+            talloc_free(item);
+            ldap_change_notify_lost(nctx);
+            continue;
+        }
+
+        account_req->filter_value = talloc_strdup(account_req, name);
+        talloc_free(item);
+        if (account_req->filter_value == NULL) {
+            talloc_free(account_req);
+            ldap_change_notify_lost(nctx);
+            continue;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "Refreshing changed %s %s\n",
+              be_req2str(entry_type), account_req->filter_value);
+
+        subreq = sdap_handle_acct_req_send(account_req, nctx->id_ctx->be,
+                                           account_req, nctx->id_ctx,
+                                           nctx->sdom, nctx->id_ctx->conn,
+                                           true);
+        if (subreq == NULL) {
+            talloc_free(account_req);
+            ldap_change_notify_lost(nctx);
+            continue;
+        }
+        tevent_req_set_callback(subreq, ldap_change_notify_refresh_done,
+                                nctx);
+
+        nctx->account_req = account_req;
+        return;
+    }
+}
+
+static void ldap_change_notify_refresh_done(struct tevent_req *subreq)
+{
+    struct sdap_change_notify_ctx *nctx;
+    const char *err_msg = NULL;
+    int dp_error;
+    int sdap_ret;
+    errno_t ret;
+
+    nctx = tevent_req_callback_data(subreq, struct sdap_change_notify_ctx);
+
+    ret = sdap_handle_acct_req_recv(subreq, &dp_error, &err_msg, &sdap_ret);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to refresh changed %s %s "
+              "[dp_error: %d, sdap_ret: %d, errno: %d]: %s\n",
+              be_req2str(nctx->account_req->entry_type),
+              nctx->account_req->filter_value,
+              dp_error, sdap_ret, ret, err_msg);
+        /* The stale entry must not be extended by the background refresh */
+        ldap_change_notify_lost(nctx);
+    }
+
+    /* frees subreq and err_msg as well */
+    ldap_change_notify_next(nctx);
+}
+
+struct ldap_change_notify_state {
+    struct tevent_context *ev;
+    struct sdap_change_notify_ctx *nctx;
+    struct sdap_id_op *op;
+};
+
+static void ldap_change_notify_connect_done(struct tevent_req *subreq);
+static void ldap_change_notify_search_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+ldap_change_notify_send(TALLOC_CTX *mem_ctx,
+                        struct tevent_context *ev,
+                        struct be_ctx *be_ctx,
+                        struct be_ptask *be_ptask,
+                        void *pvt)
+{
+    struct ldap_change_notify_state *state;
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ldap_change_notify_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->nctx = talloc_get_type(pvt, struct sdap_change_notify_ctx);
+
+    if (state->nctx->unsupported) {
+        ret = EOK;
+        goto immediately;
+    }
+
+    state->op = sdap_id_op_create(state,
+                                  state->nctx->id_ctx->conn->conn_cache);
+    if (state->op == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (subreq == NULL) {
+        goto immediately;
+    }
+    tevent_req_set_callback(subreq, ldap_change_notify_connect_done, req);
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void ldap_change_notify_connect_done(struct tevent_req *subreq)
+{
+    struct ldap_change_notify_state *state;
+    struct tevent_req *req;
+    int dp_error;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct ldap_change_notify_state);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    subreq = sdap_change_notify_search_send(state, state->ev,
+                                            state->nctx->id_ctx->opts,
+                                            sdap_id_op_handle(state->op),
+                                            state->nctx->sdom->basedn,
+                                            ldap_change_notify_entry,
+                                            state->nctx);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(subreq, ldap_change_notify_search_done, req);
+
+    /* active_since is set by the first change notification. Changes made
+     * before the server processed the search would not be reported. */
+    state->nctx->subscribed = true;
+}
+
+static void ldap_change_notify_search_done(struct tevent_req *subreq)
+{
+    struct ldap_change_notify_state *state;
+    struct tevent_req *req;
+    int dp_error;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct ldap_change_notify_state);
+
+    state->nctx->active_since = 0;
+    state->nctx->subscribed = false;
+
+    ret = sdap_change_notify_search_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret == ENOTSUP) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Change notification is not supported "
+              "by the server of domain %s\n", state->nctx->sdom->dom->name);
+        state->nctx->unsupported = true;
+    }
+
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t ldap_change_notify_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+errno_t ldap_id_setup_change_notify(struct sdap_id_ctx *id_ctx,
+                                    struct sdap_domain *sdom)
+{
+    struct sdap_change_notify_ctx *nctx;
+    char *name = NULL;
+    errno_t ret;
+
+    if (!dp_opt_get_bool(id_ctx->opts->basic, SDAP_CHANGE_NOTIFICATION)) {
+        return EOK;
+    }
+
+    nctx = talloc_zero(id_ctx, struct sdap_change_notify_ctx);
+    if (nctx == NULL) {
+        return ENOMEM;
+    }
+
+    nctx->id_ctx = id_ctx;
+    nctx->sdom = sdom;
+
+    nctx->queued = sss_ptr_hash_create(nctx, NULL, NULL);
+    if (nctx->queued == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    name = talloc_asprintf(nctx, "Change notification [id] of %s",
+                           sdom->dom->name);
+    if (name == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = be_ptask_create(nctx, id_ctx->be,
+                          LDAP_CHANGE_NOTIFY_PERIOD,  /* period */
+                          10,                         /* first_delay */
+                          5,                          /* enabled delay */
+                          0,                          /* random offset */
+                          0,                          /* timeout */
+                          0,                          /* max_backoff */
+                          ldap_change_notify_send,
+                          ldap_change_notify_recv,
+                          nctx, name,
+                          BE_PTASK_OFFLINE_DISABLE
+                              | BE_PTASK_SCHEDULE_FROM_NOW,
+                          NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Unable to initialize change "
+              "notification task for %s\n", sdom->dom->name);
+        goto done;
+    }
+
+    id_ctx->notify = nctx;
+    ret = EOK;
+
+done:
+    talloc_free(name);
+    if (ret != EOK) {
+        talloc_free(nctx);
+    }
+
+    return ret;
+}
+
+time_t sdap_change_notify_active_since(struct sdap_id_ctx *id_ctx)
+{
+    if (id_ctx->notify == NULL) {
+        return 0;
+    }
+
+    return id_ctx->notify->active_since;
+}
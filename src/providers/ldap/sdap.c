@@ -1559,6 +1559,7 @@ void sdap_steal_server_opts(struct sdap_id_ctx *id_ctx,
 
     if (!id_ctx->srv_opts) {
         id_ctx->srv_opts = talloc_move(id_ctx, srv_opts);
+        id_ctx->srv_opts->first_seen = time(NULL);
         return;
     }
 
@@ -1572,6 +1573,7 @@ void sdap_steal_server_opts(struct sdap_id_ctx *id_ctx,
 
     talloc_zfree(id_ctx->srv_opts);
     id_ctx->srv_opts = talloc_move(id_ctx, srv_opts);
+    id_ctx->srv_opts->first_seen = time(NULL);
 }
 
 static bool attr_is_filtered(const char *attr, const char **filter)
@@ -2106,6 +2108,95 @@ size_t sdap_steal_objects_in_dom(struct sdap_options *opts,
     return copied;
 }
 
+size_t sdap_filter_cached_objects(struct sdap_options *opts,
+                                  struct sss_domain_info *dom,
+                                  enum sysdb_member_type type,
+                                  struct sysdb_attrs **objects,
+                                  size_t count)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_domain_info *obj_dom;
+    struct ldb_message **msgs;
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    const char *orig_dn;
+    size_t msgs_count;
+    size_t kept = 0;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        /* Keep all objects, storing too much is not fatal */
+        return count;
+    }
+
+    /* Compact objects to those that are already in the cache of their
+     * domain, objects that cannot be checked are kept. */
+    for (size_t i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_string(objects[i], SYSDB_ORIG_DN, &orig_dn);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Object has no original DN\n");
+            objects[kept] = objects[i];
+            kept++;
+            continue;
+        }
+
+        obj_dom = sdap_get_object_domain(opts, objects[i], dom);
+        ret = sysdb_search_by_orig_dn(tmp_ctx,
+                                      obj_dom == NULL ? dom : obj_dom,
+                                      type, orig_dn, attrs,
+                                      &msgs_count, &msgs);
+        if (ret == ENOENT) {
+            DEBUG(SSSDBG_TRACE_ALL, "[%s] is not cached, skipping\n",
+                  orig_dn);
+            continue;
+        } else if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Unable to check if object is cached [%d]: %s\n",
+                  ret, sss_strerror(ret));
+        }
+
+        objects[kept] = objects[i];
+        kept++;
+    }
+
+    if (kept < count) {
+        objects[kept] = NULL;
+    }
+
+    talloc_free(tmp_ctx);
+
+    return kept;
+}
+
+ber_int_t sdap_page_size_adjust(ber_int_t page_size,
+                                ber_int_t page_size_min,
+                                ber_int_t page_size_max,
+                                int entries,
+                                int64_t msecs)
+{
+    int64_t next = page_size;
+
+    if (page_size_min >= page_size_max) {
+        return page_size;
+    }
+
+    if (msecs > SDAP_PAGE_TARGET_MSEC) {
+        /* Slow server or large entries, shrink the page in proportion to
+         * the time it took but at most to a quarter at once. */
+        next = (int64_t)page_size * SDAP_PAGE_TARGET_MSEC / msecs;
+        next = MAX(next, page_size / 4);
+    } else if (entries >= page_size && msecs < SDAP_PAGE_TARGET_MSEC / 4) {
+        /* Only full pages say anything about the server being able to
+         * return more entries in time. */
+        next = (int64_t)page_size * 2;
+    }
+
+    next = MAX(next, page_size_min);
+    next = MIN(next, page_size_max);
+
+    return (ber_int_t)next;
+}
+
 void sdap_domain_copy_search_bases(struct sdap_domain *to,
                                    struct sdap_domain *from)
 {
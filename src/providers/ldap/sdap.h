@@ -69,6 +69,10 @@ struct sdap_handle {
     /* Configured idle timeout */
     int idle_timeout;
     ber_int_t page_size;
+    /* Limits of the page size, it is adjusted to the response times of
+     * the server if they differ */
+    ber_int_t page_size_min;
+    ber_int_t page_size_max;
     bool disable_deref;
 
     struct sdap_fd_events *sdap_fd_events;
@@ -239,6 +243,14 @@ enum sdap_basic_opt {
     SDAP_LIBRARY_DEBUG_LEVEL,
     SDAP_USE_PPOLICY,
     SDAP_PPOLICY_PWD_CHANGE_THRESHOLD,
+    SDAP_NESTING_CONCURRENCY,
+    SDAP_PARENTS_CACHE_TIMEOUT,
+    SDAP_REFRESH_USN_FULL_INTERVAL,
+    SDAP_CHANGE_NOTIFICATION,
+    SDAP_CONNECTION_POOL_SIZE,
+    SDAP_PAGE_SIZE_MIN,
+    SDAP_PAGE_SIZE_MAX,
+    SDAP_KRB5_PERSISTENT_CHILD,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -535,6 +547,9 @@ struct sdap_options {
     /* Resolving external members */
     struct sdap_ext_member_ctx *ext_ctx;
 
+    /* Parent groups resolved by initgroups */
+    struct sss_ptr_cache *parents_cache;
+
     /* FIXME - should this go to a special struct to avoid mixing with name-service-switch maps? */
     struct sdap_attr_map *sudorule_map;
     struct sdap_attr_map *autofs_mobject_map;
@@ -578,6 +593,8 @@ struct sdap_server_opts {
     char *max_sudo_value;
     char *max_iphost_value;
     char *max_ipnetwork_value;
+    /* when the backend started to talk to this server */
+    time_t first_seen;
 };
 
 struct sdap_id_ctx;
@@ -748,6 +765,12 @@ size_t sdap_steal_objects_in_dom(struct sdap_options *opts,
                                  size_t count,
                                  bool filter);
 
+size_t sdap_filter_cached_objects(struct sdap_options *opts,
+                                  struct sss_domain_info *dom,
+                                  enum sysdb_member_type type,
+                                  struct sysdb_attrs **objects,
+                                  size_t count);
+
 struct sss_domain_info *sdap_get_object_domain(struct sdap_options *opts,
                                                struct sysdb_attrs *obj,
                                                struct sss_domain_info *dom);
@@ -759,4 +782,15 @@ bool sdap_object_in_domain(struct sdap_options *opts,
 void sdap_domain_copy_search_bases(struct sdap_domain *to,
                                    struct sdap_domain *from);
 
+/* Response time of a page the page size is adjusted to */
+#define SDAP_PAGE_TARGET_MSEC 1000
+
+/* Returns the size of the next page of a paged search after a page of
+ * @entries entries was returned in @msecs milliseconds with @page_size. */
+ber_int_t sdap_page_size_adjust(ber_int_t page_size,
+                                ber_int_t page_size_min,
+                                ber_int_t page_size_max,
+                                int entries,
+                                int64_t msecs);
+
 #endif /* _SDAP_H_ */
@@ -21,6 +21,7 @@
 
 
 #include <ctype.h>
+#include <sys/time.h>
 #include "util/util.h"
 #include "util/strtonum.h"
 #include "util/probes.h"
@@ -1480,6 +1481,13 @@ struct sdap_get_generic_ext_state {
     void *cb_data;
 
     unsigned int flags;
+
+    /* Current page of a paged search, the time spent in parse_cb is not
+     * counted because the callback may store the entries synchronously */
+    struct timeval page_start;
+    struct timeval page_cb_time;
+    ber_int_t page_size;
+    int page_entries;
 };
 
 static errno_t sdap_get_generic_ext_step(struct tevent_req *req);
@@ -1662,6 +1670,11 @@ static errno_t sdap_get_generic_ext_step(struct tevent_req *req)
         }
         state->serverctrls[state->nserverctrls] = page_control;
         state->serverctrls[state->nserverctrls+1] = NULL;
+
+        state->page_size = state->sh->page_size;
+        state->page_entries = 0;
+        timerclear(&state->page_cb_time);
+        gettimeofday(&state->page_start, NULL);
     }
 
     lret = ldap_search_ext(state->sh->ldap, state->search_base,
@@ -1756,6 +1769,38 @@ sdap_get_generic_ext_add_references(struct sdap_get_generic_ext_state *state,
     return EOK;
 }
 
+/* Adapt the page size of the connection to the time the server took to
+ * return the last page, which ended with the search result at @page_end */
+static void
+sdap_get_generic_ext_adjust_page(struct sdap_get_generic_ext_state *state,
+                                 struct timeval *page_end)
+{
+    struct timeval elapsed;
+    int64_t msecs;
+    ber_int_t next;
+
+    if (state->page_size != state->sh->page_size) {
+        /* Another search on the connection already adjusted it */
+        return;
+    }
+
+    timersub(page_end, &state->page_start, &elapsed);
+    timersub(&elapsed, &state->page_cb_time, &elapsed);
+    msecs = elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000;
+    msecs = MAX(msecs, 0);
+
+    next = sdap_page_size_adjust(state->page_size,
+                                 state->sh->page_size_min,
+                                 state->sh->page_size_max,
+                                 state->page_entries, msecs);
+    if (next != state->page_size) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Page of %d entries took %"PRId64" ms, "
+              "changing page size from %d to %d\n", state->page_entries,
+              msecs, state->page_size, next);
+        state->sh->page_size = next;
+    }
+}
+
 static void sdap_get_generic_op_finished(struct sdap_op *op,
                                          struct sdap_msg *reply,
                                          int error, void *pvt)
@@ -1772,6 +1817,8 @@ static void sdap_get_generic_op_finished(struct sdap_op *op,
     struct berval cookie;
     LDAPControl **returned_controls = NULL;
     LDAPControl *page_control;
+    struct timeval cb_start;
+    struct timeval now;
 
     if (error) {
         tevent_req_error(req, error);
@@ -1807,6 +1854,7 @@ static void sdap_get_generic_op_finished(struct sdap_op *op,
         break;
 
     case LDAP_RES_SEARCH_ENTRY:
+        gettimeofday(&cb_start, NULL);
         ret = state->parse_cb(state->sh, reply, state->cb_data);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "reply parsing callback failed.\n");
@@ -1814,10 +1862,16 @@ static void sdap_get_generic_op_finished(struct sdap_op *op,
             return;
         }
 
+        gettimeofday(&now, NULL);
+        timersub(&now, &cb_start, &now);
+        timeradd(&state->page_cb_time, &now, &state->page_cb_time);
+
+        state->page_entries++;
         sdap_unlock_next_reply(state->op);
         break;
 
     case LDAP_RES_SEARCH_RESULT:
+        gettimeofday(&now, NULL);
         ret = ldap_parse_result(state->sh->ldap, reply->msg,
                                 &result, NULL, &errmsg, &refs,
                                 &returned_controls, 0);
@@ -1900,6 +1954,8 @@ static void sdap_get_generic_op_finished(struct sdap_op *op,
             /* Cookie contains data, which means there are more requests
              * to be processed.
              */
+            sdap_get_generic_ext_adjust_page(state, &now);
+
             talloc_zfree(state->cookie.bv_val);
             state->cookie.bv_len = cookie.bv_len;
             state->cookie.bv_val = talloc_memdup(state,
@@ -2010,29 +2066,41 @@ struct sdap_get_and_parse_generic_state {
 
     struct sdap_reply sreply;
     struct sdap_options *opts;
+
+    /* Batch mode, entries are handed over to batch_fn instead of being
+     * collected in sreply */
+    size_t batch_size;
+    sdap_batch_fn batch_fn;
+    void *batch_pvt;
+    size_t total_count;
 };
 
 static void sdap_get_and_parse_generic_done(struct tevent_req *subreq);
+static void sdap_get_and_parse_generic_batch_done(struct tevent_req *subreq);
 static errno_t sdap_get_and_parse_generic_parse_entry(struct sdap_handle *sh,
                                                       struct sdap_msg *msg,
                                                       void *pvt);
 
-struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
-                                                   struct tevent_context *ev,
-                                                   struct sdap_options *opts,
-                                                   struct sdap_handle *sh,
-                                                   const char *search_base,
-                                                   int scope,
-                                                   const char *filter,
-                                                   const char **attrs,
-                                                   struct sdap_attr_map *map,
-                                                   int map_num_attrs,
-                                                   int attrsonly,
-                                                   LDAPControl **serverctrls,
-                                                   LDAPControl **clientctrls,
-                                                   int sizelimit,
-                                                   int timeout,
-                                                   bool allow_paging)
+static struct tevent_req *
+sdap_get_and_parse_generic_internal_send(TALLOC_CTX *memctx,
+                                         struct tevent_context *ev,
+                                         struct sdap_options *opts,
+                                         struct sdap_handle *sh,
+                                         const char *search_base,
+                                         int scope,
+                                         const char *filter,
+                                         const char **attrs,
+                                         struct sdap_attr_map *map,
+                                         int map_num_attrs,
+                                         int attrsonly,
+                                         LDAPControl **serverctrls,
+                                         LDAPControl **clientctrls,
+                                         int sizelimit,
+                                         int timeout,
+                                         bool allow_paging,
+                                         size_t batch_size,
+                                         sdap_batch_fn batch_fn,
+                                         void *batch_pvt)
 {
     struct tevent_req *req = NULL;
     struct tevent_req *subreq = NULL;
@@ -2046,6 +2114,9 @@ struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
     state->map = map;
     state->map_num_attrs = map_num_attrs;
     state->opts = opts;
+    state->batch_size = batch_size > 0 ? batch_size : 1;
+    state->batch_fn = batch_fn;
+    state->batch_pvt = batch_pvt;
 
     if (allow_paging) {
         flags |= SDAP_SRCH_FLG_PAGING;
@@ -2064,11 +2135,104 @@ struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
         talloc_zfree(req);
         return NULL;
     }
-    tevent_req_set_callback(subreq, sdap_get_and_parse_generic_done, req);
+
+    if (batch_fn != NULL) {
+        tevent_req_set_callback(subreq, sdap_get_and_parse_generic_batch_done,
+                                req);
+    } else {
+        tevent_req_set_callback(subreq, sdap_get_and_parse_generic_done, req);
+    }
 
     return req;
 }
 
+struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
+                                                   struct tevent_context *ev,
+                                                   struct sdap_options *opts,
+                                                   struct sdap_handle *sh,
+                                                   const char *search_base,
+                                                   int scope,
+                                                   const char *filter,
+                                                   const char **attrs,
+                                                   struct sdap_attr_map *map,
+                                                   int map_num_attrs,
+                                                   int attrsonly,
+                                                   LDAPControl **serverctrls,
+                                                   LDAPControl **clientctrls,
+                                                   int sizelimit,
+                                                   int timeout,
+                                                   bool allow_paging)
+{
+    return sdap_get_and_parse_generic_internal_send(memctx, ev, opts, sh,
+                                                    search_base, scope,
+                                                    filter, attrs,
+                                                    map, map_num_attrs,
+                                                    attrsonly, serverctrls,
+                                                    clientctrls, sizelimit,
+                                                    timeout, allow_paging,
+                                                    0, NULL, NULL);
+}
+
+struct tevent_req *
+sdap_get_and_parse_generic_batch_send(TALLOC_CTX *memctx,
+                                      struct tevent_context *ev,
+                                      struct sdap_options *opts,
+                                      struct sdap_handle *sh,
+                                      const char *search_base,
+                                      int scope,
+                                      const char *filter,
+                                      const char **attrs,
+                                      struct sdap_attr_map *map,
+                                      int map_num_attrs,
+                                      int sizelimit,
+                                      int timeout,
+                                      bool allow_paging,
+                                      size_t batch_size,
+                                      sdap_batch_fn batch_fn,
+                                      void *batch_pvt)
+{
+    if (batch_fn == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Batch search without a batch callback\n");
+        return NULL;
+    }
+
+    return sdap_get_and_parse_generic_internal_send(memctx, ev, opts, sh,
+                                                    search_base, scope,
+                                                    filter, attrs,
+                                                    map, map_num_attrs,
+                                                    false, NULL, NULL,
+                                                    sizelimit, timeout,
+                                                    allow_paging,
+                                                    batch_size, batch_fn,
+                                                    batch_pvt);
+}
+
+static errno_t
+sdap_get_and_parse_generic_flush(struct sdap_get_and_parse_generic_state *state)
+{
+    errno_t ret;
+
+    if (state->sreply.reply_count == 0) {
+        return EOK;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Processing batch of %zu entries\n",
+          state->sreply.reply_count);
+
+    ret = state->batch_fn(state->sreply.reply, state->sreply.reply_count,
+                          state->batch_pvt);
+
+    state->total_count += state->sreply.reply_count;
+
+    /* The entries are not needed anymore, release the memory before
+     * the next batch is read. */
+    talloc_zfree(state->sreply.reply);
+    state->sreply.reply_count = 0;
+    state->sreply.reply_max = 0;
+
+    return ret;
+}
+
 static errno_t sdap_get_and_parse_generic_parse_entry(struct sdap_handle *sh,
                                                       struct sdap_msg *msg,
                                                       void *pvt)
@@ -2098,6 +2262,17 @@ static errno_t sdap_get_and_parse_generic_parse_entry(struct sdap_handle *sh,
     }
 
     /* add_to_reply steals attrs, no need to free them here */
+
+    if (state->batch_fn != NULL
+            && state->sreply.reply_count >= state->batch_size) {
+        ret = sdap_get_and_parse_generic_flush(state);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to process batch [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+    }
+
     return EOK;
 }
 
@@ -2111,6 +2286,35 @@ static void sdap_get_and_parse_generic_done(struct tevent_req *subreq)
     return generic_ext_search_handler(subreq, state->opts);
 }
 
+static void sdap_get_and_parse_generic_batch_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_and_parse_generic_state *state =
+                tevent_req_data(req, struct sdap_get_and_parse_generic_state);
+    errno_t ret;
+
+    ret = sdap_get_generic_ext_recv(subreq, state, NULL, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "sdap_get_generic_ext_recv request failed: [%d]: %s\n",
+              ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = sdap_get_and_parse_generic_flush(state);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to process batch [%d]: %s\n",
+              ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 int sdap_get_and_parse_generic_recv(struct tevent_req *req,
                                     TALLOC_CTX *mem_ctx,
                                     size_t *reply_count,
@@ -2127,6 +2331,19 @@ int sdap_get_and_parse_generic_recv(struct tevent_req *req,
     return EOK;
 }
 
+int sdap_get_and_parse_generic_batch_recv(struct tevent_req *req,
+                                          size_t *_total_count)
+{
+    struct sdap_get_and_parse_generic_state *state = tevent_req_data(req,
+                                     struct sdap_get_and_parse_generic_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_total_count = state->total_count;
+
+    return EOK;
+}
+
 
 /* ==Simple generic search============================================== */
 struct sdap_get_generic_state {
@@ -2656,6 +2873,202 @@ int sdap_sd_search_recv(struct tevent_req *req,
     return EOK;
 }
 
+/* ==Change notification search======================================== */
+/* Changes that are reported by the persistent search: add, modify and
+ * modDN, deleted entries are left to the regular cache cleanup. */
+#define SDAP_PSEARCH_CHANGE_TYPES (1 | 4 | 8)
+
+struct sdap_change_notify_search_state {
+    struct sdap_options *opts;
+    LDAPControl **ctrls;
+    sdap_change_notify_fn notify_fn;
+    void *pvt;
+};
+
+static int sdap_change_notify_create_control(struct sdap_handle *sh,
+                                             LDAPControl **ctrl);
+static int sdap_change_notify_ctrls_destructor(void *ptr);
+static errno_t sdap_change_notify_parse_entry(struct sdap_handle *sh,
+                                              struct sdap_msg *msg,
+                                              void *pvt);
+static void sdap_change_notify_search_done(struct tevent_req *subreq);
+
+struct tevent_req *
+sdap_change_notify_search_send(TALLOC_CTX *memctx,
+                               struct tevent_context *ev,
+                               struct sdap_options *opts,
+                               struct sdap_handle *sh,
+                               const char *base_dn,
+                               sdap_change_notify_fn notify_fn,
+                               void *pvt)
+{
+    static const char *attrs[] = { "objectClass", NULL };
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sdap_change_notify_search_state *state;
+    int ret;
+
+    req = tevent_req_create(memctx, &state,
+                            struct sdap_change_notify_search_state);
+    if (!req) return NULL;
+
+    state->opts = opts;
+    state->notify_fn = notify_fn;
+    state->pvt = pvt;
+
+    state->ctrls = talloc_zero_array(state, LDAPControl *, 2);
+    if (state->ctrls == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    talloc_set_destructor((TALLOC_CTX *) state->ctrls,
+                          sdap_change_notify_ctrls_destructor);
+
+    ret = sdap_change_notify_create_control(sh, &state->ctrls[0]);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Subscribing to changes under [%s] using %s\n",
+          base_dn, state->ctrls[0]->ldctl_oid);
+
+    /* Active Directory only accepts (objectclass=*) as the filter of
+     * a change notification search. There is no timeout, the search runs
+     * until the connection is closed. */
+    subreq = sdap_get_generic_ext_send(state, ev, opts, sh, base_dn,
+                                       LDAP_SCOPE_SUBTREE, "(objectclass=*)",
+                                       attrs, state->ctrls, NULL, 0, 0,
+                                       sdap_change_notify_parse_entry,
+                                       state, 0);
+    if (!subreq) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    tevent_req_set_callback(subreq, sdap_change_notify_search_done, req);
+    return req;
+
+fail:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static int sdap_change_notify_create_control(struct sdap_handle *sh,
+                                             LDAPControl **ctrl)
+{
+    struct berval *psval;
+    BerElement *ber = NULL;
+    int ret;
+
+    if (sdap_is_control_supported(sh, LDAP_SERVER_NOTIFICATION_OID)) {
+        ret = sdap_control_create(sh, LDAP_SERVER_NOTIFICATION_OID, 1,
+                                  NULL, 0, ctrl);
+        if (ret != LDAP_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "sdap_control_create failed\n");
+            return EIO;
+        }
+
+        return EOK;
+    }
+
+    if (!sdap_is_control_supported(sh, LDAP_CONTROL_PERSIST_REQUEST)) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Server does not support any known change notification "
+              "method\n");
+        return ENOTSUP;
+    }
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "ber_alloc_t failed.\n");
+        return ENOMEM;
+    }
+
+    /* changeTypes, changesOnly, returnECs */
+    ret = ber_printf(ber, "{ibb}", SDAP_PSEARCH_CHANGE_TYPES, 1, 0);
+    if (ret == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, "ber_printf failed.\n");
+        ber_free(ber, 1);
+        return EIO;
+    }
+
+    ret = ber_flatten(ber, &psval);
+    ber_free(ber, 1);
+    if (ret == -1) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "ber_flatten failed.\n");
+        return EIO;
+    }
+
+    ret = sdap_control_create(sh, LDAP_CONTROL_PERSIST_REQUEST, 1, psval, 1,
+                              ctrl);
+    ber_bvfree(psval);
+    if (ret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_control_create failed\n");
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static errno_t sdap_change_notify_parse_entry(struct sdap_handle *sh,
+                                              struct sdap_msg *msg,
+                                              void *pvt)
+{
+    struct sdap_change_notify_search_state *state =
+                talloc_get_type(pvt, struct sdap_change_notify_search_state);
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    ret = sdap_parse_entry(state, sh, msg, NULL, 0, &attrs, true);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "sdap_parse_entry failed [%d]: %s\n", ret, sss_strerror(ret));
+        /* do not cancel the subscription because of a single entry */
+        return EOK;
+    }
+
+    state->notify_fn(attrs, state->pvt);
+    talloc_free(attrs);
+
+    return EOK;
+}
+
+static void sdap_change_notify_search_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    errno_t ret;
+
+    ret = sdap_get_generic_ext_recv(subreq, NULL, NULL, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Change notification search failed "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Server ended change notification search\n");
+    tevent_req_done(req);
+}
+
+static int sdap_change_notify_ctrls_destructor(void *ptr)
+{
+    LDAPControl **ctrls = talloc_get_type(ptr, LDAPControl *);
+    if (ctrls && ctrls[0]) {
+        ldap_control_free(ctrls[0]);
+    }
+
+    return 0;
+}
+
+errno_t sdap_change_notify_search_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /* ==Attribute scoped search============================================ */
 struct sdap_asq_search_state {
     struct sdap_attr_map_info *maps;
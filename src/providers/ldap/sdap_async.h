@@ -64,6 +64,8 @@ enum sdap_entry_lookup_type {
     SDAP_LOOKUP_SINGLE,         /* Direct single-user/group lookup */
     SDAP_LOOKUP_WILDCARD,       /* Multiple entries with a limit */
     SDAP_LOOKUP_ENUMERATE,      /* Fetch all entries from the server */
+    SDAP_LOOKUP_REFRESH,        /* Changed entries, only cached ones are
+                                 * stored */
 };
 
 struct tevent_req *sdap_search_user_send(TALLOC_CTX *memctx,
@@ -246,6 +248,36 @@ int sdap_get_and_parse_generic_recv(struct tevent_req *req,
                                     size_t *reply_count,
                                     struct sysdb_attrs ***reply);
 
+/* Called with every batch of at most batch_size parsed entries. The entries
+ * are freed once the callback returns, an error aborts the search. */
+typedef errno_t (*sdap_batch_fn)(struct sysdb_attrs **entries,
+                                 size_t count,
+                                 void *pvt);
+
+/* Like sdap_get_and_parse_generic_send() but the entries are handed over
+ * to batch_fn while the search is still running instead of being returned
+ * all at once, so the memory used does not grow with the number of
+ * returned entries. */
+struct tevent_req *
+sdap_get_and_parse_generic_batch_send(TALLOC_CTX *memctx,
+                                      struct tevent_context *ev,
+                                      struct sdap_options *opts,
+                                      struct sdap_handle *sh,
+                                      const char *search_base,
+                                      int scope,
+                                      const char *filter,
+                                      const char **attrs,
+                                      struct sdap_attr_map *map,
+                                      int map_num_attrs,
+                                      int sizelimit,
+                                      int timeout,
+                                      bool allow_paging,
+                                      size_t batch_size,
+                                      sdap_batch_fn batch_fn,
+                                      void *batch_pvt);
+int sdap_get_and_parse_generic_batch_recv(struct tevent_req *req,
+                                          size_t *_total_count);
+
 struct tevent_req *sdap_get_generic_send(TALLOC_CTX *memctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
@@ -323,6 +355,25 @@ int sdap_sd_search_recv(struct tevent_req *req,
                         size_t *_ref_count,
                         char ***_refs);
 
+/* Called for every entry that is added, modified or renamed on the server
+ * while the change notification search is running. */
+typedef void (*sdap_change_notify_fn)(struct sysdb_attrs *entry, void *pvt);
+
+/* Subscribe to changes of all entries under @base_dn using the AD change
+ * notification control or the persistent search control. The request does
+ * not finish until the server stops sending notifications or the
+ * connection is lost. Fails with ENOTSUP if the server supports neither
+ * control. */
+struct tevent_req *
+sdap_change_notify_search_send(TALLOC_CTX *memctx,
+                               struct tevent_context *ev,
+                               struct sdap_options *opts,
+                               struct sdap_handle *sh,
+                               const char *base_dn,
+                               sdap_change_notify_fn notify_fn,
+                               void *pvt);
+errno_t sdap_change_notify_search_recv(struct tevent_req *req);
+
 errno_t
 sdap_attrs_add_ldap_attr(struct sysdb_attrs *ldap_attrs,
                          const char *attr_name,
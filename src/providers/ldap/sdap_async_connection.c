@@ -109,6 +109,17 @@ struct tevent_req *sdap_connect_send(TALLOC_CTX *memctx,
 
     state->sh->page_size = dp_opt_get_int(state->opts->basic,
                                           SDAP_PAGE_SIZE);
+    state->sh->page_size_min = dp_opt_get_int(state->opts->basic,
+                                              SDAP_PAGE_SIZE_MIN);
+    state->sh->page_size_max = dp_opt_get_int(state->opts->basic,
+                                              SDAP_PAGE_SIZE_MAX);
+    if (state->sh->page_size_min <= 0
+            || state->sh->page_size_min > state->sh->page_size) {
+        state->sh->page_size_min = state->sh->page_size;
+    }
+    if (state->sh->page_size_max < state->sh->page_size) {
+        state->sh->page_size_max = state->sh->page_size;
+    }
 
     timeout = dp_opt_get_int(state->opts->basic, SDAP_NETWORK_TIMEOUT);
 
@@ -1138,6 +1149,8 @@ struct sdap_kinit_state {
     const char *realm;
     int    timeout;
     int    lifetime;
+    bool   canonicalize;
+    bool   persistent;
 
     const char *krb_service_name;
     struct tevent_context *ev;
@@ -1162,12 +1175,12 @@ struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
                                    const char *principal,
                                    const char *realm,
                                    bool canonicalize,
-                                   int lifetime)
+                                   int lifetime,
+                                   bool persistent)
 {
     struct tevent_req *req;
     struct tevent_req *subreq;
     struct sdap_kinit_state *state;
-    int ret;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Attempting kinit (%s, %s, %s, %d)\n",
               keytab ? keytab : "default",
@@ -1188,20 +1201,10 @@ struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
     state->be = be;
     state->timeout = timeout;
     state->lifetime = lifetime;
+    state->canonicalize = canonicalize;
+    state->persistent = persistent;
     state->krb_service_name = krb_service_name;
 
-    if (canonicalize) {
-        ret = setenv("KRB5_CANONICALIZE", "true", 1);
-    } else {
-        ret = setenv("KRB5_CANONICALIZE", "false", 1);
-    }
-    if (ret == -1) {
-        DEBUG(SSSDBG_OP_FAILURE, "Failed to set KRB5_CANONICALIZE to %s\n",
-                  ((canonicalize)?"true":"false"));
-        talloc_free(req);
-        return NULL;
-    }
-
     subreq = sdap_kinit_next_kdc(req);
     if (!subreq) {
         talloc_free(req);
@@ -1255,7 +1258,8 @@ static void sdap_kinit_kdc_resolved(struct tevent_req *subreq)
 
     tgtreq = sdap_get_tgt_send(state, state->ev, state->realm,
                                state->principal, state->keytab,
-                               state->lifetime, state->timeout);
+                               state->lifetime, state->canonicalize,
+                               state->persistent, state->timeout);
     if (!tgtreq) {
         tevent_req_error(req, ENOMEM);
         return;
@@ -1862,7 +1866,9 @@ static void sdap_cli_kinit_step(struct tevent_req *req)
                         dp_opt_get_bool(state->opts->basic,
                                                    SDAP_KRB5_CANONICALIZE),
                         dp_opt_get_int(state->opts->basic,
-                                                   SDAP_KRB5_TICKET_LIFETIME));
+                                                   SDAP_KRB5_TICKET_LIFETIME),
+                        dp_opt_get_bool(state->opts->basic,
+                                                   SDAP_KRB5_PERSISTENT_CHILD));
     if (!subreq) {
         tevent_req_error(req, ENOMEM);
         return;
@@ -423,6 +423,8 @@ struct enum_users_state {
     struct sdap_id_ctx *ctx;
     struct sdap_domain *sdom;
     struct sdap_id_op *op;
+    bool track_usn;
+    char *usn_value;
 
     char *filter;
     const char **attrs;
@@ -430,12 +432,13 @@ struct enum_users_state {
 
 static void enum_users_done(struct tevent_req *subreq);
 
-static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
-                                          struct tevent_context *ev,
-                                          struct sdap_id_ctx *ctx,
-                                          struct sdap_domain *sdom,
-                                          struct sdap_id_op *op,
-                                          bool purge)
+static struct tevent_req *enum_users_since_send(TALLOC_CTX *memctx,
+                                                struct tevent_context *ev,
+                                                struct sdap_id_ctx *ctx,
+                                                struct sdap_domain *sdom,
+                                                struct sdap_id_op *op,
+                                                const char *usn_value,
+                                                bool track_usn)
 {
     struct tevent_req *req, *subreq;
     struct enum_users_state *state;
@@ -449,6 +452,7 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
     state->sdom = sdom;
     state->ctx = ctx;
     state->op = op;
+    state->track_usn = track_usn;
 
     use_mapping = sdap_idmap_domain_has_algorithmic_mapping(
                                                         ctx->opts->idmap_ctx,
@@ -488,17 +492,17 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
         goto fail;
     }
 
-    if (ctx->srv_opts && ctx->srv_opts->max_user_value && !purge) {
-        /* If we have lastUSN available and we're not doing a full
-         * refresh, limit to changes with a higher entryUSN value.
+    if (usn_value != NULL) {
+        /* If we have a USN value, limit to changes with a higher
+         * entryUSN value.
          */
         state->filter = talloc_asprintf_append_buffer(
                 state->filter,
                 "(%s>=%s)(!(%s=%s))",
                 ctx->opts->user_map[SDAP_AT_USER_USN].name,
-                ctx->srv_opts->max_user_value,
+                usn_value,
                 ctx->opts->user_map[SDAP_AT_USER_USN].name,
-                ctx->srv_opts->max_user_value);
+                usn_value);
 
         if (!state->filter) {
             DEBUG(SSSDBG_MINOR_FAILURE,
@@ -534,7 +538,9 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
                                  state->attrs, state->filter,
                                  dp_opt_get_int(state->ctx->opts->basic,
                                                 SDAP_ENUM_SEARCH_TIMEOUT),
-                                 SDAP_LOOKUP_ENUMERATE, NULL);
+                                 state->track_usn ? SDAP_LOOKUP_ENUMERATE
+                                                  : SDAP_LOOKUP_REFRESH,
+                                 NULL);
     if (!subreq) {
         ret = ENOMEM;
         goto fail;
@@ -567,6 +573,12 @@ static void enum_users_done(struct tevent_req *subreq)
         return;
     }
 
+    if (usn_value && !state->track_usn) {
+        state->usn_value = usn_value;
+        tevent_req_done(req);
+        return;
+    }
+
     if (usn_value) {
         talloc_zfree(state->ctx->srv_opts->max_user_value);
         state->ctx->srv_opts->max_user_value =
@@ -592,12 +604,55 @@ static errno_t enum_users_recv(struct tevent_req *req)
     return EOK;
 }
 
+static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
+                                          struct tevent_context *ev,
+                                          struct sdap_id_ctx *ctx,
+                                          struct sdap_domain *sdom,
+                                          struct sdap_id_op *op,
+                                          bool purge)
+{
+    const char *usn_value = NULL;
+
+    if (ctx->srv_opts && !purge) {
+        usn_value = ctx->srv_opts->max_user_value;
+    }
+
+    return enum_users_since_send(memctx, ev, ctx, sdom, op, usn_value, true);
+}
+
+struct tevent_req *
+sdap_enum_users_changed_send(TALLOC_CTX *memctx,
+                             struct tevent_context *ev,
+                             struct sdap_id_ctx *ctx,
+                             struct sdap_domain *sdom,
+                             struct sdap_id_op *op,
+                             const char *usn_value)
+{
+    return enum_users_since_send(memctx, ev, ctx, sdom, op, usn_value, false);
+}
+
+errno_t sdap_enum_users_changed_recv(struct tevent_req *req,
+                                     TALLOC_CTX *mem_ctx,
+                                     char **_usn_value)
+{
+    struct enum_users_state *state = tevent_req_data(req,
+                                                     struct enum_users_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_usn_value = talloc_steal(mem_ctx, state->usn_value);
+
+    return EOK;
+}
+
 /* =Group-Enumeration===================================================== */
 struct enum_groups_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *ctx;
     struct sdap_domain *sdom;
     struct sdap_id_op *op;
+    bool track_usn;
+    char *usn_value;
 
     char *filter;
     const char **attrs;
@@ -605,12 +660,13 @@ struct enum_groups_state {
 
 static void enum_groups_done(struct tevent_req *subreq);
 
-static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
-                                          struct tevent_context *ev,
-                                          struct sdap_id_ctx *ctx,
-                                          struct sdap_domain *sdom,
-                                          struct sdap_id_op *op,
-                                          bool purge)
+static struct tevent_req *enum_groups_since_send(TALLOC_CTX *memctx,
+                                                 struct tevent_context *ev,
+                                                 struct sdap_id_ctx *ctx,
+                                                 struct sdap_domain *sdom,
+                                                 struct sdap_id_op *op,
+                                                 const char *usn_value,
+                                                 bool track_usn)
 {
     struct tevent_req *req, *subreq;
     struct enum_groups_state *state;
@@ -626,6 +682,7 @@ static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
     state->sdom = sdom;
     state->ctx = ctx;
     state->op = op;
+    state->track_usn = track_usn;
 
     if (sdom->dom->type == DOM_TYPE_APPLICATION) {
         non_posix = true;
@@ -674,14 +731,14 @@ static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
         goto fail;
     }
 
-    if (ctx->srv_opts && ctx->srv_opts->max_group_value && !purge) {
+    if (usn_value != NULL) {
         state->filter = talloc_asprintf_append_buffer(
                 state->filter,
                 "(%s>=%s)(!(%s=%s))",
                 ctx->opts->group_map[SDAP_AT_GROUP_USN].name,
-                ctx->srv_opts->max_group_value,
+                usn_value,
                 ctx->opts->group_map[SDAP_AT_GROUP_USN].name,
-                ctx->srv_opts->max_group_value);
+                usn_value);
         if (!state->filter) {
             DEBUG(SSSDBG_MINOR_FAILURE,
                   "Failed to build base filter\n");
@@ -714,7 +771,9 @@ static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
                                   state->attrs, state->filter,
                                   dp_opt_get_int(state->ctx->opts->basic,
                                                  SDAP_ENUM_SEARCH_TIMEOUT),
-                                  SDAP_LOOKUP_ENUMERATE, false);
+                                  state->track_usn ? SDAP_LOOKUP_ENUMERATE
+                                                   : SDAP_LOOKUP_REFRESH,
+                                  false);
     if (!subreq) {
         ret = ENOMEM;
         goto fail;
@@ -747,6 +806,12 @@ static void enum_groups_done(struct tevent_req *subreq)
         return;
     }
 
+    if (usn_value && !state->track_usn) {
+        state->usn_value = usn_value;
+        tevent_req_done(req);
+        return;
+    }
+
     if (usn_value) {
         talloc_zfree(state->ctx->srv_opts->max_group_value);
         state->ctx->srv_opts->max_group_value =
@@ -771,3 +836,44 @@ static errno_t enum_groups_recv(struct tevent_req *req)
 
     return EOK;
 }
+
+static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
+                                          struct tevent_context *ev,
+                                          struct sdap_id_ctx *ctx,
+                                          struct sdap_domain *sdom,
+                                          struct sdap_id_op *op,
+                                          bool purge)
+{
+    const char *usn_value = NULL;
+
+    if (ctx->srv_opts && !purge) {
+        usn_value = ctx->srv_opts->max_group_value;
+    }
+
+    return enum_groups_since_send(memctx, ev, ctx, sdom, op, usn_value, true);
+}
+
+struct tevent_req *
+sdap_enum_groups_changed_send(TALLOC_CTX *memctx,
+                              struct tevent_context *ev,
+                              struct sdap_id_ctx *ctx,
+                              struct sdap_domain *sdom,
+                              struct sdap_id_op *op,
+                              const char *usn_value)
+{
+    return enum_groups_since_send(memctx, ev, ctx, sdom, op, usn_value, false);
+}
+
+errno_t sdap_enum_groups_changed_recv(struct tevent_req *req,
+                                      TALLOC_CTX *mem_ctx,
+                                      char **_usn_value)
+{
+    struct enum_groups_state *state = tevent_req_data(req,
+                                                      struct enum_groups_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_usn_value = talloc_steal(mem_ctx, state->usn_value);
+
+    return EOK;
+}
@@ -46,4 +46,32 @@ sdap_dom_enum_send(TALLOC_CTX *memctx,
 
 errno_t sdap_dom_enum_recv(struct tevent_req *req);
 
+/* Download and store all users or groups with a USN higher than
+ * @usn_value. Unlike enumeration, the highest USN values tracked in
+ * ctx->srv_opts are not updated, the highest USN found is returned
+ * instead. */
+struct tevent_req *
+sdap_enum_users_changed_send(TALLOC_CTX *memctx,
+                             struct tevent_context *ev,
+                             struct sdap_id_ctx *ctx,
+                             struct sdap_domain *sdom,
+                             struct sdap_id_op *op,
+                             const char *usn_value);
+
+errno_t sdap_enum_users_changed_recv(struct tevent_req *req,
+                                     TALLOC_CTX *mem_ctx,
+                                     char **_usn_value);
+
+struct tevent_req *
+sdap_enum_groups_changed_send(TALLOC_CTX *memctx,
+                              struct tevent_context *ev,
+                              struct sdap_id_ctx *ctx,
+                              struct sdap_domain *sdom,
+                              struct sdap_id_op *op,
+                              const char *usn_value);
+
+errno_t sdap_enum_groups_changed_recv(struct tevent_req *req,
+                                      TALLOC_CTX *mem_ctx,
+                                      char **_usn_value);
+
 #endif /* _SDAP_ASYNC_ENUM_H_ */
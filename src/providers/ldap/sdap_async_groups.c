@@ -340,38 +340,6 @@ done:
     /* FIXME: support non legacy */
     /* FIXME: support storing additional attributes */
 
-static errno_t
-sdap_store_group_with_gid(struct sss_domain_info *domain,
-                          const char *name,
-                          gid_t gid,
-                          struct sysdb_attrs *group_attrs,
-                          uint64_t cache_timeout,
-                          bool posix_group,
-                          time_t now)
-{
-    errno_t ret;
-
-    /* make sure that non-POSIX (empty or explicit gid=0) groups have the
-     * gidNumber set to zero even if updating existing group */
-    if (!posix_group) {
-        ret = sysdb_attrs_add_uint32(group_attrs, SYSDB_GIDNUM, 0);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                  "Could not set explicit GID 0 for %s\n", name);
-            return ret;
-        }
-    }
-
-    ret = sysdb_store_group(domain, name, gid, group_attrs,
-                            cache_timeout, now);
-    if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE, "Could not store group %s\n", name);
-        return ret;
-    }
-
-    return ret;
-}
-
 static errno_t
 sdap_process_ghost_members(struct sysdb_attrs *attrs,
                            struct sdap_options *opts,
@@ -491,15 +459,19 @@ sdap_process_ghost_members(struct sysdb_attrs *attrs,
     return EOK;
 }
 
-static int sdap_save_group(TALLOC_CTX *memctx,
-                           struct sdap_options *opts,
-                           struct sss_domain_info *dom,
-                           struct sysdb_attrs *attrs,
-                           bool populate_members,
-                           bool store_original_member,
-                           hash_table_t *ghosts,
-                           char **_usn_value,
-                           time_t now)
+/* Converts the LDAP attributes of a group to the cache entry in _entry and
+ * returns the domain the group belongs to. The name of the entry is left
+ * NULL if the group should not be stored. */
+static int sdap_prepare_group(TALLOC_CTX *memctx,
+                              struct sdap_options *opts,
+                              struct sss_domain_info *dom,
+                              struct sysdb_attrs *attrs,
+                              bool populate_members,
+                              bool store_original_member,
+                              hash_table_t *ghosts,
+                              char **_usn_value,
+                              struct sss_domain_info **_dom,
+                              struct sysdb_store_group_entry *_entry)
 {
     struct ldb_message_element *el;
     struct sysdb_attrs *group_attrs;
@@ -514,6 +486,8 @@ static int sdap_save_group(TALLOC_CTX *memctx,
     char *sid_str;
     struct sss_domain_info *subdomain;
 
+    memset(_entry, 0, sizeof(struct sysdb_store_group_entry));
+
     tmpctx = talloc_new(NULL);
     if (!tmpctx) {
         ret = ENOMEM;
@@ -571,7 +545,7 @@ static int sdap_save_group(TALLOC_CTX *memctx,
         }
     }
 
-    ret = sdap_get_group_primary_name(tmpctx, opts, attrs, dom, &group_name);
+    ret = sdap_get_group_primary_name(memctx, opts, attrs, dom, &group_name);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Failed to get group name\n");
         goto done;
@@ -744,18 +718,23 @@ static int sdap_save_group(TALLOC_CTX *memctx,
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to save group names\n");
         goto done;
     }
-    DEBUG(SSSDBG_TRACE_FUNC, "Storing info for group %s\n", group_name);
-
-    ret = sdap_store_group_with_gid(dom, group_name, gid, group_attrs,
-                                    dom->group_timeout,
-                                    posix_group, now);
-    if (ret) {
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              "Could not store group with GID: [%s]\n",
-               sss_strerror(ret));
-        goto done;
+    /* make sure that non-POSIX (empty or explicit gid=0) groups have the
+     * gidNumber set to zero even if updating existing group */
+    if (!posix_group) {
+        ret = sysdb_attrs_add_uint32(group_attrs, SYSDB_GIDNUM, 0);
+        if (ret) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Could not set explicit GID 0 for %s\n", group_name);
+            goto done;
+        }
     }
 
+    _entry->name = group_name;
+    _entry->gid = gid;
+    _entry->attrs = group_attrs;
+    _entry->cache_timeout = dom->group_timeout;
+    *_dom = dom;
+
     if (_usn_value) {
         *_usn_value = talloc_steal(memctx, usn_value);
     }
@@ -1036,6 +1015,11 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
                             char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
+    struct sysdb_store_group_entry *entries;
+    struct sss_domain_info **doms;
+    char **usn_values;
+    int *entry_idx;
+    int num_entries = 0;
     char *higher_usn = NULL;
     char *usn_value;
     bool twopass;
@@ -1069,6 +1053,17 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
         return ENOMEM;
     }
 
+    entries = talloc_zero_array(tmpctx, struct sysdb_store_group_entry,
+                                num_groups);
+    doms = talloc_zero_array(tmpctx, struct sss_domain_info *, num_groups);
+    usn_values = talloc_zero_array(tmpctx, char *, num_groups);
+    entry_idx = talloc_zero_array(tmpctx, int, num_groups);
+    if (entries == NULL || doms == NULL || usn_values == NULL
+            || entry_idx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
     ret = sysdb_transaction_start(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
@@ -1085,29 +1080,55 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
         }
     }
 
-    now = time(NULL);
     for (i = 0; i < num_groups; i++) {
-        usn_value = NULL;
-
         /* if 2 pass savemembers = false */
-        ret = sdap_save_group(tmpctx, opts, dom, groups[i],
-                              populate_members,
-                              has_nesting && save_orig_member,
-                              ghosts, &usn_value, now);
+        ret = sdap_prepare_group(tmpctx, opts, dom, groups[i],
+                                 populate_members,
+                                 has_nesting && save_orig_member,
+                                 ghosts, &usn_values[num_entries],
+                                 &doms[num_entries], &entries[num_entries]);
 
         /* Do not fail completely on errors.
          * Just report the failure to save and go on */
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "Failed to store group %d. Ignoring.\n", i);
-        } else {
-            DEBUG(SSSDBG_TRACE_ALL, "Group %d processed!\n", i);
+            continue;
+        }
+
+        if (entries[num_entries].name == NULL) {
+            /* Skipped, but processed */
             if (twopass && !populate_members) {
                 saved_groups[nsaved_groups] = groups[i];
                 nsaved_groups++;
             }
+            continue;
+        }
+
+        entry_idx[num_entries] = i;
+        num_entries++;
+    }
+
+    /* All groups are stored at once to avoid looking up the existing
+     * entries one by one */
+    now = time(NULL);
+    sdap_store_batches(tmpctx, SYSDB_GROUP, doms, entries, num_entries,
+                       now);
+
+    for (i = 0; i < num_entries; i++) {
+        if (entries[i].ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Failed to store group %d. Ignoring.\n", entry_idx[i]);
+            continue;
+        }
+
+        DEBUG(SSSDBG_TRACE_ALL, "Group %d processed!\n", entry_idx[i]);
+        if (twopass && !populate_members) {
+            saved_groups[nsaved_groups] = groups[entry_idx[i]];
+            nsaved_groups++;
         }
 
+        usn_value = usn_values[i];
         if (usn_value) {
             if (higher_usn) {
                 if ((strlen(usn_value) > strlen(higher_usn)) ||
@@ -1756,6 +1777,9 @@ struct sdap_get_groups_state {
     hash_table_t *user_hash;
     hash_table_t *group_hash;
 
+    /* enumeration only */
+    struct sysdb_bulk_membership *bulk;
+
     size_t base_iter;
     struct sdap_search_base **search_bases;
 
@@ -1906,6 +1930,7 @@ static errno_t sdap_get_groups_next_base(struct tevent_req *req)
         need_paging = true;
         break;
     case SDAP_LOOKUP_ENUMERATE:
+    case SDAP_LOOKUP_REFRESH:
         need_paging = true;
         break;
     }
@@ -1958,6 +1983,7 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
 
     if (state->lookup_type == SDAP_LOOKUP_WILDCARD || \
             state->lookup_type == SDAP_LOOKUP_ENUMERATE || \
+            state->lookup_type == SDAP_LOOKUP_REFRESH || \
         count == 0) {
         /* No users found in this search or looking up multiple entries */
         next_base = true;
@@ -2054,7 +2080,14 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
     /* We have all of the groups. Save them to the sysdb */
     state->check_count = state->count;
 
-    ret = sysdb_transaction_start(state->sysdb);
+    if (state->lookup_type == SDAP_LOOKUP_ENUMERATE
+            || state->lookup_type == SDAP_LOOKUP_REFRESH) {
+        /* All groups are rewritten, compute the memberships only once
+         * when all of them are saved. */
+        ret = sysdb_bulk_membership_start(state, state->sysdb, &state->bulk);
+    } else {
+        ret = sysdb_transaction_start(state->sysdb);
+    }
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Failed to start transaction\n");
         tevent_req_error(req, ret);
@@ -2062,14 +2095,19 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
     }
 
     if ((state->lookup_type == SDAP_LOOKUP_ENUMERATE
+                || state->lookup_type == SDAP_LOOKUP_REFRESH
                 || state->lookup_type == SDAP_LOOKUP_WILDCARD)
             && state->opts->schema_type != SDAP_SCHEMA_RFC2307
             && dp_opt_get_int(state->opts->basic, SDAP_NESTING_LEVEL) != 0) {
         DEBUG(SSSDBG_TRACE_ALL, "Saving groups without members first "
                   "to allow unrolling of nested groups.\n");
+        /* groups are processed asynchronously below, only these writes
+         * belong to the bulk session */
+        sysdb_bulk_membership_enter(state->bulk);
         ret = sdap_save_groups(state, state->sysdb, state->dom, state->opts,
                                state->groups, state->count, false,
                                NULL, true, NULL);
+        sysdb_bulk_membership_leave(state->bulk);
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to store groups.\n");
             tevent_req_error(req, ret);
@@ -2081,7 +2119,8 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
         subreq = sdap_process_group_send(state, state->ev, state->dom,
                                          state->sysdb, state->opts,
                                          state->sh, state->groups[i],
-                                         state->lookup_type == SDAP_LOOKUP_ENUMERATE);
+                                         state->lookup_type == SDAP_LOOKUP_ENUMERATE
+                                         || state->lookup_type == SDAP_LOOKUP_REFRESH);
 
         if (!subreq) {
             tevent_req_error(req, ENOMEM);
@@ -2107,6 +2146,13 @@ static void sdap_search_group_copy_batch(struct sdap_get_groups_state *state,
                                        state->dom,
                                        groups, count, filter);
 
+    if (state->lookup_type == SDAP_LOOKUP_REFRESH) {
+        copied = sdap_filter_cached_objects(state->opts, state->dom,
+                                            SYSDB_MEMBER_GROUP,
+                                            state->groups + state->count,
+                                            copied);
+    }
+
     state->count += copied;
     state->groups[state->count] = NULL;
 }
@@ -2145,18 +2191,24 @@ static void sdap_get_groups_done(struct tevent_req *subreq)
          * If enumeration is on, don't overwrite orig_members as they've been
          * saved earlier.
          */
+        sysdb_bulk_membership_enter(state->bulk);
         ret = sdap_save_groups(state, state->sysdb, state->dom, state->opts,
                                state->groups, state->count,
                                !state->dom->ignore_group_members, NULL,
                                state->lookup_type == SDAP_LOOKUP_SINGLE,
                                &state->higher_usn);
+        sysdb_bulk_membership_leave(state->bulk);
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to store groups.\n");
             tevent_req_error(req, ret);
             return;
         }
         DEBUG(SSSDBG_TRACE_ALL, "Saving %zu Groups - Done\n", state->count);
-        sysret = sysdb_transaction_commit(state->sysdb);
+        if (state->bulk != NULL) {
+            sysret = sysdb_bulk_membership_commit(state->bulk);
+        } else {
+            sysret = sysdb_transaction_commit(state->sysdb);
+        }
         if (sysret != EOK) {
             DEBUG(SSSDBG_FATAL_FAILURE, "Couldn't commit transaction\n");
             tevent_req_error(req, sysret);
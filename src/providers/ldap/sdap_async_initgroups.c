@@ -28,6 +28,7 @@
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_idmap.h"
 #include "providers/ldap/sdap_users.h"
+#include "providers/ldap/sdap_parents_cache.h"
 
 /* ==Save-fake-group-list=====================================*/
 errno_t sdap_add_incomplete_groups(struct sysdb_ctx *sysdb,
@@ -1856,6 +1857,8 @@ static void sdap_initgr_rfc2307bis_done(struct tevent_req *subreq)
             tevent_req_data(req, struct sdap_initgr_rfc2307bis_state);
     bool in_transaction = false;
     errno_t tret;
+    uint64_t hits;
+    uint64_t misses;
 
     ret = rfc2307bis_nested_groups_recv(subreq);
     talloc_zfree(subreq);
@@ -1864,6 +1867,10 @@ static void sdap_initgr_rfc2307bis_done(struct tevent_req *subreq)
         return;
     }
 
+    sdap_parents_cache_get_stats(state->opts, &hits, &misses);
+    DEBUG(SSSDBG_TRACE_FUNC, "Parent groups cache: %"PRIu64" hits, "
+          "%"PRIu64" misses\n", hits, misses);
+
     ret = sysdb_transaction_start(state->sysdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
@@ -2355,6 +2362,7 @@ done:
 }
 
 static errno_t rfc2307bis_nested_groups_next_base(struct tevent_req *req);
+static errno_t rfc2307bis_nested_groups_resolved(struct tevent_req *req);
 static void rfc2307bis_nested_groups_process(struct tevent_req *subreq);
 static errno_t rfc2307bis_nested_groups_step(struct tevent_req *req)
 {
@@ -2368,6 +2376,7 @@ static errno_t rfc2307bis_nested_groups_step(struct tevent_req *req)
             tevent_req_data(req, struct sdap_rfc2307bis_nested_ctx);
     char *oc_list;
     const char *class;
+    struct sdap_nested_group *ngr;
 
     tmp_ctx = talloc_new(state);
     if (!tmp_ctx) {
@@ -2436,6 +2445,19 @@ static errno_t rfc2307bis_nested_groups_step(struct tevent_req *req)
         goto done;
     }
 
+    /* The parents may have been found by a previous initgroups request */
+    ngr = state->processed_groups[state->group_iter];
+    ret = sdap_parents_cache_lookup(ngr, state->opts, ngr->group,
+                                    &ngr->ldap_parents, &ngr->parents_count);
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Found %zu parent groups of [%s] "
+              "in the parents cache\n", ngr->parents_count, state->orig_dn);
+        ret = rfc2307bis_nested_groups_resolved(req);
+        goto done;
+    } else if (ret != ENOENT) {
+        goto done;
+    }
+
     attr_filter = talloc_array(state, const char *, 2);
     if (!attr_filter) {
         ret = ENOMEM;
@@ -2561,9 +2583,6 @@ static void rfc2307bis_nested_groups_process(struct tevent_req *subreq)
     size_t i;
     struct sysdb_attrs **ldap_groups;
     struct sdap_nested_group *ngr;
-    hash_value_t value;
-    hash_key_t key;
-    int hret;
 
     ret = sdap_get_generic_recv(subreq, state,
                                 &count,
@@ -2624,12 +2643,40 @@ static void rfc2307bis_nested_groups_process(struct tevent_req *subreq)
     /* Reset the base iterator for future lookups */
     state->base_iter = 0;
 
+    sdap_parents_cache_store(state->opts, ngr->group,
+                             ngr->ldap_parents, ngr->parents_count);
+
+    ret = rfc2307bis_nested_groups_resolved(req);
+    if (ret == EOK) {
+        /* No parent groups for this group in LDAP
+         * Move on to the next group
+         */
+        rfc2307bis_nested_groups_iterate(req, state);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+/* Called when the direct parents of the current group are known. Returns
+ * EAGAIN if the parents are being processed and EOK if the group has no
+ * parents. */
+static errno_t rfc2307bis_nested_groups_resolved(struct tevent_req *req)
+{
+    struct sdap_rfc2307bis_nested_ctx *state =
+            tevent_req_data(req, struct sdap_rfc2307bis_nested_ctx);
+    struct tevent_req *subreq;
+    struct sdap_nested_group *ngr;
+    hash_value_t value;
+    hash_key_t key;
+    int hret;
+
+    ngr = state->processed_groups[state->group_iter];
+
     /* Save the group into the hash table */
     key.type = HASH_KEY_STRING;
     key.str = talloc_strdup(state, state->primary_name);
     if (!key.str) {
-        tevent_req_error(req, ENOMEM);
-        return;
+        return ENOMEM;
     }
 
     /* Steal the nested group entry on the group_hash context so it can
@@ -2640,19 +2687,13 @@ static void rfc2307bis_nested_groups_process(struct tevent_req *subreq)
     value.ptr = ngr;
 
     hret = hash_enter(state->group_hash, &key, &value);
+    talloc_free(key.str);
     if (hret != HASH_SUCCESS) {
-        talloc_free(key.str);
-        tevent_req_error(req, EIO);
-        return;
+        return EIO;
     }
-    talloc_free(key.str);
 
     if (ngr->parents_count == 0) {
-        /* No parent groups for this group in LDAP
-         * Move on to the next group
-         */
-        rfc2307bis_nested_groups_iterate(req, state);
-        return;
+        return EOK;
     }
 
     /* Otherwise, recurse into the groups */
@@ -2665,10 +2706,11 @@ static void rfc2307bis_nested_groups_process(struct tevent_req *subreq)
             state->group_hash,
             state->nesting_level+1);
     if (!subreq) {
-        tevent_req_error(req, EIO);
-        return;
+        return EIO;
     }
     tevent_req_set_callback(subreq, rfc2307bis_nested_groups_done, req);
+
+    return EAGAIN;
 }
 
 errno_t rfc2307bis_nested_groups_recv(struct tevent_req *req)
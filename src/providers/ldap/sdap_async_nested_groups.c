@@ -1345,15 +1345,24 @@ struct sdap_nested_group_single_state {
     struct sdap_nested_group_member *members;
     int nesting_level;
 
-    struct sdap_nested_group_member *current_member;
     int num_members;
     int member_index;
 
+    /* member lookups in progress, up to max_lookups at a time */
+    TALLOC_CTX *lookups;
+    int num_lookups;
+    int max_lookups;
+
     struct sysdb_attrs **nested_groups;
     int num_groups;
     bool ignore_unreadable_references;
 };
 
+struct sdap_nested_group_single_lookup {
+    struct tevent_req *req;
+    struct sdap_nested_group_member *member;
+};
+
 static errno_t sdap_nested_group_single_step(struct tevent_req *req);
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq);
 static void sdap_nested_group_single_done(struct tevent_req *subreq);
@@ -1382,9 +1391,19 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
     state->group_ctx = group_ctx;
     state->members = members;
     state->nesting_level = nesting_level;
-    state->current_member = NULL;
     state->num_members = num_members;
     state->member_index = 0;
+    state->num_lookups = 0;
+    state->max_lookups = dp_opt_get_int(group_ctx->opts->basic,
+                                        SDAP_NESTING_CONCURRENCY);
+    if (state->max_lookups < 1) {
+        state->max_lookups = 1;
+    }
+    state->lookups = talloc_new(state);
+    if (state->lookups == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
     state->nested_groups = talloc_zero_array(state, struct sysdb_attrs *,
                                              num_groups_max);
     if (state->nested_groups == NULL) {
@@ -1395,9 +1414,10 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
     state->ignore_unreadable_references = dp_opt_get_bool(
             group_ctx->opts->basic, SDAP_IGNORE_UNREADABLE_REFERENCES);
 
-    /* process each member individually */
+    /* look up the members, several of them at a time */
     ret = sdap_nested_group_single_step(req);
     if (ret != EAGAIN) {
+        talloc_zfree(state->lookups);
         goto immediately;
     }
 
@@ -1458,74 +1478,95 @@ static errno_t must_ignore(struct sdap_search_base **ignore_user_search_bases,
     return EOK;
 }
 
+static struct tevent_req *
+sdap_nested_group_lookup_send(struct sdap_nested_group_single_lookup *lookup,
+                              struct tevent_context *ev,
+                              struct sdap_nested_group_ctx *group_ctx)
+{
+    switch (lookup->member->type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        return sdap_nested_group_lookup_user_send(lookup, ev, group_ctx,
+                                                  lookup->member);
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        return sdap_nested_group_lookup_group_send(lookup, ev, group_ctx,
+                                                   lookup->member);
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        return sdap_nested_group_lookup_unknown_send(lookup, ev, group_ctx,
+                                                     lookup->member);
+    }
+
+    return NULL;
+}
+
+/* Start lookups until the window is full. Returns EOK when all members
+ * were processed and EAGAIN while some lookups are still in progress. */
 static errno_t sdap_nested_group_single_step(struct tevent_req *req)
 {
     struct sdap_nested_group_single_state *state = NULL;
+    struct sdap_nested_group_single_lookup *lookup = NULL;
+    struct sdap_nested_group_member *member = NULL;
     struct tevent_req *subreq = NULL;
     errno_t ret;
     bool ignore;
 
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
-    do {
-        if (state->member_index >= state->num_members) {
-            /* we're done */
-            return EOK;
-        }
-
-        state->current_member = &state->members[state->member_index];
+    while (state->num_lookups < state->max_lookups
+            && state->member_index < state->num_members) {
+        member = &state->members[state->member_index];
         state->member_index++;
 
         ret = must_ignore(state->group_ctx->ignore_user_search_bases,
                           sysdb_ctx_get_ldb(state->group_ctx->domain->sysdb),
-                          state->current_member->dn, &ignore);
+                          member->dn, &ignore);
         if (ret != EOK) {
             return ret;
         }
-    } while (ignore);
 
-    switch (state->current_member->type) {
-    case SDAP_NESTED_GROUP_DN_USER:
-        subreq = sdap_nested_group_lookup_user_send(state, state->ev,
-                                                    state->group_ctx,
-                                                    state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_GROUP:
-        subreq = sdap_nested_group_lookup_group_send(state, state->ev,
-                                                     state->group_ctx,
-                                                     state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_UNKNOWN:
-        subreq = sdap_nested_group_lookup_unknown_send(state, state->ev,
-                                                   state->group_ctx,
-                                                   state->current_member);
-        break;
-    }
+        if (ignore) {
+            continue;
+        }
 
-    if (subreq == NULL) {
-        return ENOMEM;
+        lookup = talloc_zero(state->lookups,
+                             struct sdap_nested_group_single_lookup);
+        if (lookup == NULL) {
+            return ENOMEM;
+        }
+        lookup->req = req;
+        lookup->member = member;
+
+        subreq = sdap_nested_group_lookup_send(lookup, state->ev,
+                                               state->group_ctx);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, sdap_nested_group_single_step_done,
+                                lookup);
+        state->num_lookups++;
     }
 
-    tevent_req_set_callback(subreq, sdap_nested_group_single_step_done, req);
+    if (state->num_lookups > 0) {
+        return EAGAIN;
+    }
 
-    return EAGAIN;
+    /* we're done */
+    return EOK;
 }
 
 static errno_t
-sdap_nested_group_single_step_process(struct tevent_req *subreq)
+sdap_nested_group_single_step_process(
+                                struct sdap_nested_group_single_state *state,
+                                struct sdap_nested_group_member *member,
+                                struct tevent_req *subreq)
 {
-    struct sdap_nested_group_single_state *state = NULL;
-    struct tevent_req *req = NULL;
     struct sysdb_attrs *entry = NULL;
     enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
     const char *orig_dn = NULL;
     errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
-    state = tevent_req_data(req, struct sdap_nested_group_single_state);
-
     /* set correct type if possible */
-    if (state->current_member->type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
+    if (member->type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
         ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
                                                     &entry, &type);
         if (ret != EOK) {
@@ -1533,11 +1574,11 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
         }
 
         if (entry != NULL) {
-            state->current_member->type = type;
+            member->type = type;
         }
     }
 
-    switch (state->current_member->type) {
+    switch (member->type) {
     case SDAP_NESTED_GROUP_DN_USER:
         if (entry == NULL) {
             /* type was not unknown, receive data */
@@ -1559,7 +1600,7 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
          */
         ret = sysdb_attrs_add_string(entry,
                                      SYSDB_DN_FOR_MEMBER_HASH_TABLE,
-                                     state->current_member->dn);
+                                     member->dn);
         if (ret != EOK) {
             DEBUG(SSSDBG_OP_FAILURE, "sysdb_attrs_add_string failed.\n");
             goto done;
@@ -1629,10 +1670,10 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
     case SDAP_NESTED_GROUP_DN_UNKNOWN:
         if (state->ignore_unreadable_references) {
             DEBUG(SSSDBG_TRACE_FUNC, "Ignoring unreadable reference [%s]\n",
-                  state->current_member->dn);
+                  member->dn);
         } else {
             DEBUG(SSSDBG_OP_FAILURE, "Unknown entry type [%s]!\n",
-                  state->current_member->dn);
+                  member->dn);
             DEBUG(SSSDBG_OP_FAILURE, "Consider enabling sssd-ldap option "
                                      "ldap_ignore_unreadable_references\n");
             ret = EINVAL;
@@ -1650,15 +1691,20 @@ done:
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
 {
     struct sdap_nested_group_single_state *state = NULL;
+    struct sdap_nested_group_single_lookup *lookup = NULL;
     struct tevent_req *req = NULL;
     errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
+    lookup = tevent_req_callback_data(subreq,
+                                      struct sdap_nested_group_single_lookup);
+    req = lookup->req;
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
     /* process direct members */
-    ret = sdap_nested_group_single_step_process(subreq);
+    ret = sdap_nested_group_single_step_process(state, lookup->member, subreq);
     talloc_zfree(subreq);
+    talloc_zfree(lookup);
+    state->num_lookups--;
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Error processing direct membership "
                                     "[%d]: %s\n", ret, strerror(ret));
@@ -1689,6 +1735,11 @@ static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
     ret = EAGAIN;
 
 done:
+    if (ret != EAGAIN) {
+        /* do not let the remaining lookups finish the request again */
+        talloc_zfree(state->lookups);
+    }
+
     if (ret == EOK) {
         /* tevent_req_error() cannot cope with EOK */
         DEBUG(SSSDBG_CRIT_FAILURE, "We should not get here with EOK\n");
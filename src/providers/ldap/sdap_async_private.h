@@ -88,6 +88,8 @@ struct tevent_req *sdap_get_tgt_send(TALLOC_CTX *mem_ctx,
                                      const char *princ_str,
                                      const char *keytab_name,
                                      int32_t lifetime,
+                                     bool canonicalize,
+                                     bool persistent,
                                      int timeout);
 
 int sdap_get_tgt_recv(struct tevent_req *req,
@@ -97,6 +99,17 @@ int sdap_get_tgt_recv(struct tevent_req *req,
                       char **ccname,
                       time_t *expire_time_out);
 
+/* Stores the users or groups in @entries, an array of struct
+ * sysdb_store_user_entry or struct sysdb_store_group_entry according to
+ * @type, in one batch per domain in @doms. Usually all entries belong to
+ * the same domain. The result of each entry is set in its ret field. */
+void sdap_store_batches(TALLOC_CTX *mem_ctx,
+                        enum sysdb_obj_type type,
+                        struct sss_domain_info **doms,
+                        void *entries,
+                        size_t num_entries,
+                        time_t now);
+
 int sdap_save_users(TALLOC_CTX *memctx,
                     struct sysdb_ctx *sysdb,
                     struct sss_domain_info *dom,
@@ -168,15 +168,17 @@ static int sdap_user_set_mpg(struct sysdb_attrs *user_attrs,
     return EOK;
 }
 
-/* FIXME: support storing additional attributes */
-int sdap_save_user(TALLOC_CTX *memctx,
-                   struct sdap_options *opts,
-                   struct sss_domain_info *dom,
-                   struct sysdb_attrs *attrs,
-                   struct sysdb_attrs *mapped_attrs,
-                   char **_usn_value,
-                   time_t now,
-                   bool set_non_posix)
+/* Converts the LDAP attributes of a user to the cache entry in _entry and
+ * returns the domain the user belongs to. The name of the entry is left
+ * NULL if the user should not be stored. */
+static int sdap_prepare_user(TALLOC_CTX *memctx,
+                             struct sdap_options *opts,
+                             struct sss_domain_info *dom,
+                             struct sysdb_attrs *attrs,
+                             char **_usn_value,
+                             bool set_non_posix,
+                             struct sss_domain_info **_dom,
+                             struct sysdb_store_user_entry *_entry)
 {
     struct ldb_message_element *el;
     int ret;
@@ -209,6 +211,8 @@ int sdap_save_user(TALLOC_CTX *memctx,
 
     DEBUG(SSSDBG_TRACE_FUNC, "Save user\n");
 
+    memset(_entry, 0, sizeof(struct sysdb_store_user_entry));
+
     tmpctx = talloc_new(NULL);
     if (!tmpctx) {
         ret = ENOMEM;
@@ -642,17 +646,18 @@ int sdap_save_user(TALLOC_CTX *memctx,
         goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Storing info for user %s\n", user_name);
-
-    ret = sysdb_store_user(dom, user_name, pwd, uid, gid,
-                           gecos, homedir, shell, orig_dn,
-                           user_attrs, missing, cache_timeout, now);
-    if (ret) goto done;
-
-    if (mapped_attrs != NULL) {
-        ret = sysdb_set_user_attr(dom, user_name, mapped_attrs, SYSDB_MOD_ADD);
-        if (ret) return ret;
-    }
+    _entry->name = user_name;
+    _entry->pwd = pwd;
+    _entry->uid = uid;
+    _entry->gid = gid;
+    _entry->gecos = gecos;
+    _entry->homedir = homedir;
+    _entry->shell = shell;
+    _entry->orig_dn = orig_dn;
+    _entry->attrs = user_attrs;
+    _entry->remove_attrs = missing;
+    _entry->cache_timeout = cache_timeout;
+    *_dom = dom;
 
     if (_usn_value) {
         *_usn_value = talloc_steal(memctx, usn_value);
@@ -672,8 +677,164 @@ done:
 }
 
 
+/* FIXME: support storing additional attributes */
+int sdap_save_user(TALLOC_CTX *memctx,
+                   struct sdap_options *opts,
+                   struct sss_domain_info *dom,
+                   struct sysdb_attrs *attrs,
+                   struct sysdb_attrs *mapped_attrs,
+                   char **_usn_value,
+                   time_t now,
+                   bool set_non_posix)
+{
+    struct sysdb_store_user_entry user;
+    char *usn_value = NULL;
+    int ret;
+
+    ret = sdap_prepare_user(memctx, opts, dom, attrs, &usn_value,
+                            set_non_posix, &dom, &user);
+    if (ret != EOK || user.name == NULL) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Storing info for user %s\n", user.name);
+
+    ret = sysdb_store_user(dom, user.name, user.pwd, user.uid, user.gid,
+                           user.gecos, user.homedir, user.shell, user.orig_dn,
+                           user.attrs, user.remove_attrs, user.cache_timeout,
+                           now);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to save user [%s]\n", user.name);
+        goto done;
+    }
+
+    if (mapped_attrs != NULL) {
+        ret = sysdb_set_user_attr(dom, user.name, mapped_attrs,
+                                  SYSDB_MOD_ADD);
+        if (ret) goto done;
+    }
+
+    if (_usn_value) {
+        *_usn_value = usn_value;
+        usn_value = NULL;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(usn_value);
+    return ret;
+}
+
+
 /* ==Generic-Function-to-save-multiple-users============================= */
 
+static size_t sdap_batch_entry_size(enum sysdb_obj_type type)
+{
+    switch (type) {
+    case SYSDB_USER:
+        return sizeof(struct sysdb_store_user_entry);
+    case SYSDB_GROUP:
+        return sizeof(struct sysdb_store_group_entry);
+    default:
+        return 0;
+    }
+}
+
+static errno_t *sdap_batch_entry_ret(enum sysdb_obj_type type,
+                                     void *entries,
+                                     size_t i)
+{
+    switch (type) {
+    case SYSDB_USER:
+        return &((struct sysdb_store_user_entry *) entries)[i].ret;
+    case SYSDB_GROUP:
+        return &((struct sysdb_store_group_entry *) entries)[i].ret;
+    default:
+        return NULL;
+    }
+}
+
+static errno_t sdap_store_batch(enum sysdb_obj_type type,
+                                struct sss_domain_info *dom,
+                                void *batch,
+                                size_t num,
+                                time_t now)
+{
+    switch (type) {
+    case SYSDB_USER:
+        return sysdb_store_users_batch(dom, batch, num, now);
+    case SYSDB_GROUP:
+        return sysdb_store_groups_batch(dom, batch, num, now);
+    default:
+        return EINVAL;
+    }
+}
+
+void sdap_store_batches(TALLOC_CTX *mem_ctx,
+                        enum sysdb_obj_type type,
+                        struct sss_domain_info **doms,
+                        void *entries,
+                        size_t num_entries,
+                        time_t now)
+{
+    size_t entry_size;
+    uint8_t *batch;
+    size_t *idx;
+    bool *stored;
+    size_t num;
+    size_t i;
+    size_t j;
+    errno_t ret;
+
+    entry_size = sdap_batch_entry_size(type);
+    if (entry_size == 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unsupported object type [%d]\n", type);
+        return;
+    }
+
+    batch = talloc_size(mem_ctx, entry_size * num_entries);
+    idx = talloc_array(mem_ctx, size_t, num_entries);
+    stored = talloc_zero_array(mem_ctx, bool, num_entries);
+    if (batch == NULL || idx == NULL || stored == NULL) {
+        for (i = 0; i < num_entries; i++) {
+            *sdap_batch_entry_ret(type, entries, i) = ENOMEM;
+        }
+        goto done;
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        if (stored[i]) {
+            continue;
+        }
+
+        num = 0;
+        for (j = i; j < num_entries; j++) {
+            if (!stored[j] && doms[j] == doms[i]) {
+                memcpy(batch + num * entry_size,
+                       (uint8_t *) entries + j * entry_size, entry_size);
+                idx[num] = j;
+                stored[j] = true;
+                num++;
+            }
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "Storing %zu %s of domain %s\n", num,
+              type == SYSDB_USER ? "users" : "groups", doms[i]->name);
+
+        ret = sdap_store_batch(type, doms[i], batch, num, now);
+        for (j = 0; j < num; j++) {
+            *sdap_batch_entry_ret(type, entries, idx[j]) =
+                (ret == EOK) ? *sdap_batch_entry_ret(type, batch, j) : ret;
+        }
+    }
+
+done:
+    talloc_free(batch);
+    talloc_free(idx);
+    talloc_free(stored);
+}
+
 int sdap_save_users(TALLOC_CTX *memctx,
                     struct sysdb_ctx *sysdb,
                     struct sss_domain_info *dom,
@@ -684,8 +845,12 @@ int sdap_save_users(TALLOC_CTX *memctx,
                     char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
+    struct sysdb_store_user_entry *entries;
+    struct sss_domain_info **doms;
+    char **usn_values;
     char *higher_usn = NULL;
     char *usn_value;
+    int num_entries = 0;
     int ret;
     errno_t sret;
     int i;
@@ -702,6 +867,15 @@ int sdap_save_users(TALLOC_CTX *memctx,
         return ENOMEM;
     }
 
+    entries = talloc_zero_array(tmpctx, struct sysdb_store_user_entry,
+                                num_users);
+    doms = talloc_zero_array(tmpctx, struct sss_domain_info *, num_users);
+    usn_values = talloc_zero_array(tmpctx, char *, num_users);
+    if (entries == NULL || doms == NULL || usn_values == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
     ret = sysdb_transaction_start(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
@@ -717,21 +891,48 @@ int sdap_save_users(TALLOC_CTX *memctx,
         }
     }
 
-    now = time(NULL);
     for (i = 0; i < num_users; i++) {
-        usn_value = NULL;
-
-        ret = sdap_save_user(tmpctx, opts, dom, users[i], mapped_attrs,
-                             &usn_value, now, false);
+        ret = sdap_prepare_user(tmpctx, opts, dom, users[i],
+                                &usn_values[num_entries], false,
+                                &doms[num_entries], &entries[num_entries]);
 
         /* Do not fail completely on errors.
          * Just report the failure to save and go on */
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %d. Ignoring.\n", i);
-        } else {
-            DEBUG(SSSDBG_TRACE_ALL, "User %d processed!\n", i);
+            continue;
+        }
+
+        if (entries[num_entries].name != NULL) {
+            num_entries++;
+        }
+    }
+
+    /* All users are stored at once to avoid looking up the existing entries
+     * one by one */
+    now = time(NULL);
+    sdap_store_batches(tmpctx, SYSDB_USER, doms, entries, num_entries, now);
+
+    for (i = 0; i < num_entries; i++) {
+        if (entries[i].ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %s. Ignoring.\n",
+                  entries[i].name);
+            continue;
+        }
+
+        if (mapped_attrs != NULL) {
+            ret = sysdb_set_user_attr(doms[i], entries[i].name, mapped_attrs,
+                                      SYSDB_MOD_ADD);
+            if (ret) {
+                DEBUG(SSSDBG_OP_FAILURE, "Failed to store mapped data of "
+                      "user %s. Ignoring.\n", entries[i].name);
+                continue;
+            }
         }
 
+        DEBUG(SSSDBG_TRACE_ALL, "User %s processed!\n", entries[i].name);
+
+        usn_value = usn_values[i];
         if (usn_value) {
             if (higher_usn) {
                 if ((strlen(usn_value) > strlen(higher_usn)) ||
@@ -790,6 +991,11 @@ struct sdap_search_user_state {
 
     size_t base_iter;
     struct sdap_search_base **search_bases;
+
+    /* If set, the users are handed over to batch_fn as they are read
+     * instead of being returned */
+    sdap_batch_fn batch_fn;
+    void *batch_pvt;
 };
 
 static errno_t sdap_search_user_next_base(struct tevent_req *req);
@@ -798,16 +1004,19 @@ static void sdap_search_user_copy_batch(struct sdap_search_user_state *state,
                                         size_t count);
 static void sdap_search_user_process(struct tevent_req *subreq);
 
-struct tevent_req *sdap_search_user_send(TALLOC_CTX *memctx,
-                                         struct tevent_context *ev,
-                                         struct sss_domain_info *dom,
-                                         struct sdap_options *opts,
-                                         struct sdap_search_base **search_bases,
-                                         struct sdap_handle *sh,
-                                         const char **attrs,
-                                         const char *filter,
-                                         int timeout,
-                                         enum sdap_entry_lookup_type lookup_type)
+static struct tevent_req *
+sdap_search_user_internal_send(TALLOC_CTX *memctx,
+                               struct tevent_context *ev,
+                               struct sss_domain_info *dom,
+                               struct sdap_options *opts,
+                               struct sdap_search_base **search_bases,
+                               struct sdap_handle *sh,
+                               const char **attrs,
+                               const char *filter,
+                               int timeout,
+                               enum sdap_entry_lookup_type lookup_type,
+                               sdap_batch_fn batch_fn,
+                               void *batch_pvt)
 {
     errno_t ret;
     struct tevent_req *req;
@@ -829,6 +1038,8 @@ struct tevent_req *sdap_search_user_send(TALLOC_CTX *memctx,
     state->base_iter = 0;
     state->search_bases = search_bases;
     state->lookup_type = lookup_type;
+    state->batch_fn = batch_fn;
+    state->batch_pvt = batch_pvt;
 
     if (!state->search_bases) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -848,6 +1059,22 @@ done:
     return req;
 }
 
+struct tevent_req *sdap_search_user_send(TALLOC_CTX *memctx,
+                                         struct tevent_context *ev,
+                                         struct sss_domain_info *dom,
+                                         struct sdap_options *opts,
+                                         struct sdap_search_base **search_bases,
+                                         struct sdap_handle *sh,
+                                         const char **attrs,
+                                         const char *filter,
+                                         int timeout,
+                                         enum sdap_entry_lookup_type lookup_type)
+{
+    return sdap_search_user_internal_send(memctx, ev, dom, opts, search_bases,
+                                          sh, attrs, filter, timeout,
+                                          lookup_type, NULL, NULL);
+}
+
 static errno_t sdap_search_user_next_base(struct tevent_req *req)
 {
     struct tevent_req *subreq;
@@ -879,18 +1106,31 @@ static errno_t sdap_search_user_next_base(struct tevent_req *req)
         need_paging = true;
         break;
     case SDAP_LOOKUP_ENUMERATE:
+    case SDAP_LOOKUP_REFRESH:
         need_paging = true;
         break;
     }
 
-    subreq = sdap_get_and_parse_generic_send(
-            state, state->ev, state->opts, state->sh,
-            state->search_bases[state->base_iter]->basedn,
-            state->search_bases[state->base_iter]->scope,
-            state->filter, state->attrs,
-            state->opts->user_map, state->opts->user_map_cnt,
-            0, NULL, NULL, sizelimit, state->timeout,
-            need_paging);
+    if (state->batch_fn != NULL) {
+        subreq = sdap_get_and_parse_generic_batch_send(
+                state, state->ev, state->opts, state->sh,
+                state->search_bases[state->base_iter]->basedn,
+                state->search_bases[state->base_iter]->scope,
+                state->filter, state->attrs,
+                state->opts->user_map, state->opts->user_map_cnt,
+                sizelimit, state->timeout, need_paging,
+                dp_opt_get_int(state->opts->basic, SDAP_PAGE_SIZE),
+                state->batch_fn, state->batch_pvt);
+    } else {
+        subreq = sdap_get_and_parse_generic_send(
+                state, state->ev, state->opts, state->sh,
+                state->search_bases[state->base_iter]->basedn,
+                state->search_bases[state->base_iter]->scope,
+                state->filter, state->attrs,
+                state->opts->user_map, state->opts->user_map_cnt,
+                0, NULL, NULL, sizelimit, state->timeout,
+                need_paging);
+    }
     if (subreq == NULL) {
         return ENOMEM;
     }
@@ -907,11 +1147,15 @@ static void sdap_search_user_process(struct tevent_req *subreq)
                                             struct sdap_search_user_state);
     int ret;
     size_t count;
-    struct sysdb_attrs **users;
+    struct sysdb_attrs **users = NULL;
     bool next_base = false;
 
-    ret = sdap_get_and_parse_generic_recv(subreq, state,
-                                          &count, &users);
+    if (state->batch_fn != NULL) {
+        ret = sdap_get_and_parse_generic_batch_recv(subreq, &count);
+    } else {
+        ret = sdap_get_and_parse_generic_recv(subreq, state,
+                                              &count, &users);
+    }
     talloc_zfree(subreq);
     if (ret) {
         tevent_req_error(req, ret);
@@ -923,13 +1167,17 @@ static void sdap_search_user_process(struct tevent_req *subreq)
 
     if (state->lookup_type == SDAP_LOOKUP_WILDCARD || \
             state->lookup_type == SDAP_LOOKUP_ENUMERATE || \
+            state->lookup_type == SDAP_LOOKUP_REFRESH || \
         count == 0) {
         /* No users found in this search or looking up multiple entries */
         next_base = true;
     }
 
-    /* Add this batch of users to the list */
-    if (count > 0) {
+    if (state->batch_fn != NULL) {
+        /* The users were already processed */
+        state->count += count;
+    } else if (count > 0) {
+        /* Add this batch of users to the list */
         state->users =
                 talloc_realloc(state,
                                state->users,
@@ -984,6 +1232,13 @@ static void sdap_search_user_copy_batch(struct sdap_search_user_state *state,
                                        state->dom,
                                        users, count, filter);
 
+    if (state->lookup_type == SDAP_LOOKUP_REFRESH) {
+        copied = sdap_filter_cached_objects(state->opts, state->dom,
+                                            SYSDB_MEMBER_USER,
+                                            state->users + state->count,
+                                            copied);
+    }
+
     state->count += copied;
     state->users[state->count] = NULL;
 }
@@ -1023,8 +1278,16 @@ struct sdap_get_users_state {
     struct sysdb_attrs **users;
     struct sysdb_attrs *mapped_attrs;
     size_t count;
+
+    /* Users are saved in batches while the search is running */
+    bool streaming;
+    /* Only users that are already cached are saved */
+    bool cached_only;
 };
 
+static errno_t sdap_get_users_save_batch(struct sysdb_attrs **users,
+                                         size_t count,
+                                         void *pvt);
 static void sdap_get_users_done(struct tevent_req *subreq);
 
 struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
@@ -1072,8 +1335,21 @@ struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
         }
     }
 
-    subreq = sdap_search_user_send(state, ev, dom, opts, search_bases,
-                                   sh, attrs, filter, timeout, lookup_type);
+    /* Enumeration can return all users in the directory, save them as they
+     * are read so they do not have to be kept in memory all at once.
+     * Mapped data are removed before saving, so they must be saved at once. */
+    state->streaming = ((lookup_type == SDAP_LOOKUP_ENUMERATE
+                                || lookup_type == SDAP_LOOKUP_REFRESH)
+                            && mapped_attrs == NULL);
+    state->cached_only = (lookup_type == SDAP_LOOKUP_REFRESH);
+
+    subreq = sdap_search_user_internal_send(state, ev, dom, opts,
+                                            search_bases, sh, attrs,
+                                            filter, timeout, lookup_type,
+                                            state->streaming ?
+                                                sdap_get_users_save_batch :
+                                                NULL,
+                                            state);
     if (subreq == NULL) {
         ret = ENOMEM;
         goto done;
@@ -1090,6 +1366,51 @@ done:
     return req;
 }
 
+static errno_t sdap_get_users_save_batch(struct sysdb_attrs **users,
+                                         size_t count,
+                                         void *pvt)
+{
+    struct sdap_get_users_state *state;
+    char *usn_value = NULL;
+    errno_t ret;
+
+    state = talloc_get_type(pvt, struct sdap_get_users_state);
+
+    if (state->cached_only) {
+        count = sdap_filter_cached_objects(state->opts, state->dom,
+                                           SYSDB_MEMBER_USER, users, count);
+        if (count == 0) {
+            return EOK;
+        }
+    }
+
+    PROBE(SDAP_SEARCH_USER_SAVE_BEGIN, state->filter);
+    ret = sdap_save_users(state, state->sysdb, state->dom, state->opts,
+                          users, count, NULL, &usn_value);
+    PROBE(SDAP_SEARCH_USER_SAVE_END, state->filter);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to store users [%d][%s].\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    if (usn_value != NULL) {
+        if (state->higher_usn == NULL
+                || strlen(usn_value) > strlen(state->higher_usn)
+                || (strlen(usn_value) == strlen(state->higher_usn)
+                    && strcmp(usn_value, state->higher_usn) > 0)) {
+            talloc_free(state->higher_usn);
+            state->higher_usn = usn_value;
+        } else {
+            talloc_free(usn_value);
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Saved batch of %zu users\n", count);
+
+    return EOK;
+}
+
 static void sdap_get_users_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
@@ -1098,7 +1419,8 @@ static void sdap_get_users_done(struct tevent_req *subreq)
                                             struct sdap_get_users_state);
     int ret;
 
-    ret = sdap_search_user_recv(state, subreq, &state->higher_usn,
+    ret = sdap_search_user_recv(state, subreq,
+                                state->streaming ? NULL : &state->higher_usn,
                                 &state->users, &state->count);
     if (ret) {
         if (ret != ENOENT) {
@@ -1109,6 +1431,12 @@ static void sdap_get_users_done(struct tevent_req *subreq)
         return;
     }
 
+    if (state->streaming) {
+        DEBUG(SSSDBG_TRACE_ALL, "Saving %zu Users - Done\n", state->count);
+        tevent_req_done(req);
+        return;
+    }
+
     PROBE(SDAP_SEARCH_USER_SAVE_BEGIN, state->filter);
 
     ret = sdap_save_users(state, state->sysdb,
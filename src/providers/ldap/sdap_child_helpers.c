@@ -80,7 +80,9 @@ static void child_callback(int child_status,
 }
 
 static errno_t sdap_fork_child(struct tevent_context *ev,
-                               struct sdap_child *child, struct tevent_req *req)
+                               struct sdap_child *child,
+                               const char **extra_argv,
+                               sss_child_callback_t cb, void *pvt)
 {
     int pipefd_to_child[2] = PIPE_INIT;
     int pipefd_from_child[2] = PIPE_INIT;
@@ -105,9 +107,11 @@ static errno_t sdap_fork_child(struct tevent_context *ev,
     pid = fork();
 
     if (pid == 0) { /* child */
-        exec_child(child,
-                   pipefd_to_child, pipefd_from_child,
-                   LDAP_CHILD, LDAP_CHILD_LOG_FILE);
+        exec_child_ex(child,
+                      pipefd_to_child, pipefd_from_child,
+                      LDAP_CHILD, LDAP_CHILD_LOG_FILE,
+                      extra_argv, false,
+                      STDIN_FILENO, STDOUT_FILENO);
 
         /* We should never get here */
         DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec LDAP child\n");
@@ -121,7 +125,7 @@ static errno_t sdap_fork_child(struct tevent_context *ev,
         sss_fd_nonblocking(child->io->write_to_child_fd);
 
         if (ev != NULL) {
-            ret = child_handler_setup(ev, pid, child_callback, req, NULL);
+            ret = child_handler_setup(ev, pid, cb, pvt, NULL);
             if (ret != EOK) {
                 goto fail;
             }
@@ -148,6 +152,7 @@ static errno_t create_child_req_send_buffer(TALLOC_CTX *mem_ctx,
                                             const char *princ_str,
                                             const char *keytab_name,
                                             int32_t lifetime,
+                                            bool canonicalize,
                                             struct io_buffer **io_buf)
 {
     struct io_buffer *buf;
@@ -159,7 +164,9 @@ static errno_t create_child_req_send_buffer(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
-    buf->size = 7 * sizeof(uint32_t);
+    /* The size must be exact, the persistent ldap_child compares whole
+     * requests to find previously acquired tickets. */
+    buf->size = 6 * sizeof(uint32_t);
     if (realm_str) {
         buf->size += strlen(realm_str);
     }
@@ -211,6 +218,9 @@ static errno_t create_child_req_send_buffer(TALLOC_CTX *mem_ctx,
     /* lifetime */
     SAFEALIGN_SET_UINT32(&buf->data[rp], lifetime, &rp);
 
+    /* canonicalize */
+    SAFEALIGN_SET_UINT32(&buf->data[rp], canonicalize ? 1 : 0, &rp);
+
     *io_buf = buf;
     return EOK;
 }
@@ -340,14 +350,14 @@ errno_t sdap_select_principal_from_keytab_sync(TALLOC_CTX *mem_ctx,
 
     ret = create_child_req_send_buffer(mem_ctx, LDAP_CHILD_SELECT_PRINCIPAL,
                                        realm_str, princ_str, keytab_name, 0,
-                                       &buf);
+                                       false, &buf);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "create_child_req_send_buffer() failed.\n");
         ret = EFAULT;
         goto done;
     }
 
-    ret = sdap_fork_child(NULL, child, NULL);
+    ret = sdap_fork_child(NULL, child, NULL, NULL, NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "sdap_fork_child() failed.\n");
         goto done;
@@ -389,6 +399,109 @@ done:
     return ret;
 }
 
+/* ==Persistent-ldap_child================================================*/
+
+/* With ldap_krb5_persistent_child all TGT requests of the backend are sent
+ * to a single long-running ldap_child which keeps the acquired tickets and
+ * renews them before they expire. The requests are serialized over its
+ * pipes with a tevent queue. */
+struct sdap_persistent_child {
+    struct tevent_queue *queue;
+    struct sdap_child *child;
+};
+
+static struct sdap_persistent_child *persistent_child;
+
+static int sdap_persistent_child_destructor(struct sdap_persistent_child *pc)
+{
+    if (persistent_child == pc) {
+        persistent_child = NULL;
+    }
+
+    return 0;
+}
+
+static errno_t sdap_persistent_child_get(struct tevent_context *ev,
+                                         struct sdap_persistent_child **_pc)
+{
+    struct sdap_persistent_child *pc;
+
+    if (persistent_child != NULL) {
+        *_pc = persistent_child;
+        return EOK;
+    }
+
+    pc = talloc_zero(ev, struct sdap_persistent_child);
+    if (pc == NULL) {
+        return ENOMEM;
+    }
+
+    pc->queue = tevent_queue_create(pc, "ldap_child");
+    if (pc->queue == NULL) {
+        talloc_free(pc);
+        return ENOMEM;
+    }
+
+    talloc_set_destructor(pc, sdap_persistent_child_destructor);
+    persistent_child = pc;
+
+    *_pc = pc;
+    return EOK;
+}
+
+static void persistent_child_exited(int child_status,
+                                    struct tevent_signal *sige,
+                                    void *pvt)
+{
+    struct sdap_child *child = talloc_get_type(pvt, struct sdap_child);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Persistent ldap_child [%d] exited.\n",
+          child->pid);
+
+    if (persistent_child != NULL && persistent_child->child == child) {
+        persistent_child->child = NULL;
+    }
+
+    /* Do not free it if we still need to read some data. */
+    if (child->io->in_use) {
+        child->io->child_exited = true;
+        return;
+    }
+
+    talloc_free(child);
+}
+
+static errno_t sdap_persistent_child_start(struct tevent_context *ev,
+                                           struct sdap_persistent_child *pc)
+{
+    const char *extra_argv[] = { "--"LDAP_CHILD_OPT_PERSISTENT, NULL };
+    struct sdap_child *child;
+    errno_t ret;
+
+    if (pc->child != NULL) {
+        return EOK;
+    }
+
+    ret = alloc_child(pc, &child);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sdap_fork_child(ev, child, extra_argv,
+                          persistent_child_exited, child);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_fork_child failed.\n");
+        talloc_free(child);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started persistent ldap_child [%d].\n",
+          child->pid);
+
+    pc->child = child;
+    return EOK;
+}
+
 /* ==The-public-async-interface============================================*/
 
 struct sdap_get_tgt_state {
@@ -398,6 +511,13 @@ struct sdap_get_tgt_state {
     uint8_t *buf;
 
     struct tevent_timer *kill_te;
+
+    /* persistent ldap_child only */
+    struct io_buffer *req_buf;
+    int timeout;
+    struct tevent_req *queue_req;
+    struct tevent_req *pipe_req;
+    struct tevent_timer *timeout_te;
 };
 
 static errno_t set_tgt_child_timeout(struct tevent_req *req,
@@ -405,6 +525,7 @@ static errno_t set_tgt_child_timeout(struct tevent_req *req,
                                      int timeout);
 static void sdap_get_tgt_step(struct tevent_req *subreq);
 static void sdap_get_tgt_done(struct tevent_req *subreq);
+static errno_t sdap_get_tgt_persistent(struct tevent_req *req);
 
 struct tevent_req *sdap_get_tgt_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
@@ -412,6 +533,8 @@ struct tevent_req *sdap_get_tgt_send(TALLOC_CTX *mem_ctx,
                                      const char *princ_str,
                                      const char *keytab_name,
                                      int32_t lifetime,
+                                     bool canonicalize,
+                                     bool persistent,
                                      int timeout)
 {
     struct tevent_req *req, *subreq;
@@ -426,21 +549,33 @@ struct tevent_req *sdap_get_tgt_send(TALLOC_CTX *mem_ctx,
 
     state->ev = ev;
 
-    ret = alloc_child(state, &state->child);
-    if (ret != EOK) {
-        goto fail;
-    }
-
     /* prepare the data to pass to child */
     ret = create_child_req_send_buffer(state, LDAP_CHILD_GET_TGT,
                                        realm_str, princ_str, keytab_name, lifetime,
-                                       &buf);
+                                       canonicalize, &buf);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "create_child_req_send_buffer() failed.\n");
         goto fail;
     }
 
-    ret = sdap_fork_child(state->ev, state->child, req);
+    if (persistent) {
+        state->req_buf = buf;
+        state->timeout = timeout;
+
+        ret = sdap_get_tgt_persistent(req);
+        if (ret != EOK) {
+            goto fail;
+        }
+
+        return req;
+    }
+
+    ret = alloc_child(state, &state->child);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    ret = sdap_fork_child(state->ev, state->child, NULL, child_callback, req);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "sdap_fork_child failed.\n");
         goto fail;
@@ -519,6 +654,226 @@ static void sdap_get_tgt_done(struct tevent_req *subreq)
     /* wait for child callback to terminate the request */
 }
 
+static void sdap_get_tgt_persistent_step(struct tevent_req *subreq);
+static void sdap_get_tgt_persistent_written(struct tevent_req *subreq);
+static void sdap_get_tgt_persistent_done(struct tevent_req *subreq);
+static void sdap_get_tgt_persistent_timeout(struct tevent_context *ev,
+                                            struct tevent_timer *te,
+                                            struct timeval tv, void *pvt);
+
+/* Stop using the persistent ldap_child. If the exchange did not complete the
+ * state of the pipes is unknown, so the child is killed and the next request
+ * starts a new one. */
+static void sdap_get_tgt_persistent_release(struct sdap_get_tgt_state *state,
+                                            bool terminate)
+{
+    struct sdap_child *child = state->child;
+    int ret;
+
+    talloc_zfree(state->timeout_te);
+
+    if (child == NULL) {
+        return;
+    }
+    state->child = NULL;
+
+    talloc_zfree(state->pipe_req);
+
+    if (terminate) {
+        if (persistent_child != NULL && persistent_child->child == child) {
+            persistent_child->child = NULL;
+        }
+
+        ret = kill(child->pid, SIGKILL);
+        if (ret == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "kill failed [%d][%s].\n", ret, strerror(ret));
+        }
+    }
+
+    child->io->in_use = false;
+    if (child->io->child_exited) {
+        talloc_free(child);
+    }
+}
+
+static int sdap_get_tgt_state_destructor(struct sdap_get_tgt_state *state)
+{
+    sdap_get_tgt_persistent_release(state, true);
+    return 0;
+}
+
+static errno_t sdap_get_tgt_persistent(struct tevent_req *req)
+{
+    struct sdap_get_tgt_state *state = tevent_req_data(req,
+                                                  struct sdap_get_tgt_state);
+    struct sdap_persistent_child *pc;
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    ret = sdap_persistent_child_get(state->ev, &pc);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    talloc_set_destructor(state, sdap_get_tgt_state_destructor);
+
+    subreq = tevent_queue_wait_send(state, state->ev, pc->queue);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, sdap_get_tgt_persistent_step, req);
+
+    return EOK;
+}
+
+static void sdap_get_tgt_persistent_step(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_tgt_state *state = tevent_req_data(req,
+                                                  struct sdap_get_tgt_state);
+    struct sdap_persistent_child *pc;
+    struct timeval tv;
+    errno_t ret;
+
+    /* The queue entry is released together with the request, this keeps
+     * other requests waiting until the reply is read. */
+    state->queue_req = subreq;
+    if (!tevent_queue_wait_recv(subreq)) {
+        ret = EFAULT;
+        goto done;
+    }
+
+    ret = sdap_persistent_child_get(state->ev, &pc);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sdap_persistent_child_start(state->ev, pc);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Setting %d seconds timeout for persistent ldap_child\n",
+          state->timeout);
+
+    tv = tevent_timeval_current_ofs(state->timeout, 0);
+    state->timeout_te = tevent_add_timer(state->ev, state, tv,
+                                         sdap_get_tgt_persistent_timeout, req);
+    if (state->timeout_te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    state->child = pc->child;
+    state->child->io->in_use = true;
+
+    state->pipe_req = write_pipe_safe_send(state, state->ev,
+                                           state->req_buf->data,
+                                           state->req_buf->size,
+                                           state->child->io->write_to_child_fd);
+    if (state->pipe_req == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    tevent_req_set_callback(state->pipe_req,
+                            sdap_get_tgt_persistent_written, req);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        sdap_get_tgt_persistent_release(state, true);
+        tevent_req_error(req, ret);
+    }
+}
+
+static void sdap_get_tgt_persistent_written(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_tgt_state *state = tevent_req_data(req,
+                                                  struct sdap_get_tgt_state);
+    errno_t ret;
+
+    ret = write_pipe_safe_recv(subreq);
+    talloc_zfree(subreq);
+    state->pipe_req = NULL;
+    if (ret != EOK) {
+        goto done;
+    }
+
+    state->pipe_req = read_pipe_safe_send(state, state->ev,
+                                          state->child->io->read_from_child_fd);
+    if (state->pipe_req == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    tevent_req_set_callback(state->pipe_req,
+                            sdap_get_tgt_persistent_done, req);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        sdap_get_tgt_persistent_release(state, true);
+        tevent_req_error(req, ret);
+    }
+}
+
+static void sdap_get_tgt_persistent_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_tgt_state *state = tevent_req_data(req,
+                                                  struct sdap_get_tgt_state);
+    errno_t ret;
+
+    ret = read_pipe_safe_recv(subreq, state, &state->buf, &state->len);
+    talloc_zfree(subreq);
+    state->pipe_req = NULL;
+    if (ret != EOK) {
+        sdap_get_tgt_persistent_release(state, true);
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    sdap_get_tgt_persistent_release(state, false);
+
+    if (state->len == 0) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Persistent ldap_child failed to handle the request, "
+              "see ldap_child.log for details.\n");
+        tevent_req_error(req, EIO);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static void sdap_get_tgt_persistent_timeout(struct tevent_context *ev,
+                                            struct tevent_timer *te,
+                                            struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct sdap_get_tgt_state *state = tevent_req_data(req,
+                                            struct sdap_get_tgt_state);
+
+    /* The timer is freed by the event loop */
+    state->timeout_te = NULL;
+
+    DEBUG(SSSDBG_CRIT_FAILURE,
+          "Timeout for persistent ldap_child [%d] reached.\n",
+          state->child != NULL ? state->child->pid : -1);
+
+    sdap_get_tgt_persistent_release(state, true);
+    tevent_req_error(req, ETIMEDOUT);
+}
+
 int sdap_get_tgt_recv(struct tevent_req *req,
                       TALLOC_CTX *mem_ctx,
                       int  *result,
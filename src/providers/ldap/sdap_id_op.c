@@ -33,8 +33,10 @@ struct sdap_id_conn_cache {
 
     /* list of all open connections */
     struct sdap_id_conn_data *connections;
-    /* cached (current) connection */
-    struct sdap_id_conn_data *cached_connection;
+    /* pool of cached (current) connections, new operations are assigned
+     * to the connection with the least operations in progress */
+    struct sdap_id_conn_data **pool;
+    int pool_size;
 };
 
 /* LDAP async operation tracker:
@@ -78,6 +80,10 @@ struct sdap_id_conn_data {
     int notify_lock;
     /* list of operations using connect */
     struct sdap_id_op *ops;
+    /* number of operations in the list */
+    int num_ops;
+    /* slot of the connection in the pool */
+    int slot;
     /* A flag which is signalizing that this
      * connection will be disconnected and should
      * not be used any more */
@@ -86,6 +92,8 @@ struct sdap_id_conn_data {
 
 static void sdap_id_conn_cache_be_offline_cb(void *pvt);
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt);
+static bool sdap_id_conn_data_is_cached(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_data_uncache(struct sdap_id_conn_data *conn_data);
 
 static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data);
 static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data);
@@ -153,16 +161,105 @@ fail:
     return ret;
 }
 
+/* Allocate the connection pool on first use, the options are not
+ * available yet when the connection cache is created */
+static int sdap_id_conn_cache_init_pool(struct sdap_id_conn_cache *conn_cache)
+{
+    int pool_size;
+
+    if (conn_cache->pool != NULL) {
+        return EOK;
+    }
+
+    pool_size = dp_opt_get_int(conn_cache->id_conn->id_ctx->opts->basic,
+                               SDAP_CONNECTION_POOL_SIZE);
+    if (pool_size < 1) {
+        pool_size = 1;
+    }
+
+    conn_cache->pool = talloc_zero_array(conn_cache, struct sdap_id_conn_data *,
+                                         pool_size);
+    if (conn_cache->pool == NULL) {
+        return ENOMEM;
+    }
+
+    conn_cache->pool_size = pool_size;
+    DEBUG(SSSDBG_CONF_SETTINGS, "Using up to %d connections\n", pool_size);
+
+    return EOK;
+}
+
+/* Check whether connection is one of the cached connections */
+static bool sdap_id_conn_data_is_cached(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+
+    return conn_cache->pool != NULL
+            && conn_data->slot < conn_cache->pool_size
+            && conn_cache->pool[conn_data->slot] == conn_data;
+}
+
+/* Remove connection from the pool, it is not used for new operations */
+static void sdap_id_conn_data_uncache(struct sdap_id_conn_data *conn_data)
+{
+    if (sdap_id_conn_data_is_cached(conn_data)) {
+        conn_data->conn_cache->pool[conn_data->slot] = NULL;
+    }
+}
+
+/* Put connection back to the pool if there is a free slot */
+static bool sdap_id_conn_data_cache(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    int i;
+
+    if (sdap_id_conn_data_is_cached(conn_data)) {
+        return true;
+    }
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] == NULL) {
+            conn_cache->pool[i] = conn_data;
+            conn_data->slot = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Check whether there is another established connection in the pool */
+static bool sdap_id_conn_cache_is_connected(struct sdap_id_conn_cache *conn_cache,
+                                            struct sdap_id_conn_data *except)
+{
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] != NULL && conn_cache->pool[i] != except
+                && conn_cache->pool[i]->connect_req == NULL
+                && conn_cache->pool[i]->sh != NULL
+                && conn_cache->pool[i]->sh->connected) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /* Callback on BE going offline */
 static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
+    struct sdap_id_conn_data *cached_connection;
+    int i;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(cached_connection);
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        cached_connection = conn_cache->pool[i];
+        if (cached_connection != NULL) {
+            conn_cache->pool[i] = NULL;
+            sdap_id_release_conn_data(cached_connection);
+        }
     }
 }
 
@@ -170,14 +267,31 @@ static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
+    int i;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        cached_connection->disconnecting = true;
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] != NULL) {
+            conn_cache->pool[i]->disconnecting = true;
+        }
     }
 }
 
+/* Get number of operations in progress on each of the pooled connections */
+int sdap_id_conn_cache_get_outstanding(struct sdap_id_conn_cache *conn_cache,
+                                       int *outstanding,
+                                       int max)
+{
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size && i < max; i++) {
+        outstanding[i] = conn_cache->pool[i] == NULL ?
+                            -1 : conn_cache->pool[i]->num_ops;
+    }
+
+    return conn_cache->pool_size;
+}
+
 /* Release sdap_id_conn_data and destroy it if no longer needed */
 static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data)
 {
@@ -191,7 +305,7 @@ static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data)
     }
 
     conn_cache = conn_data->conn_cache;
-    if (conn_data == conn_cache->cached_connection) {
+    if (sdap_id_conn_data_is_cached(conn_data)) {
         return;
     }
 
@@ -220,6 +334,7 @@ static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data)
         op->conn_data = NULL;
         DLIST_REMOVE(conn_data->ops, op);
     }
+    conn_data->num_ops = 0;
 
     return 0;
 }
@@ -302,12 +417,11 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
 {
     struct sdap_id_conn_data *conn_data = talloc_get_type(pvt,
                                                           struct sdap_id_conn_data);
-    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
 
-    if (conn_cache->cached_connection == conn_data) {
+    if (sdap_id_conn_data_is_cached(conn_data)) {
         DEBUG(SSSDBG_TRACE_ALL,
               "Connection is about to expire, releasing it\n");
-        conn_cache->cached_connection = NULL;
+        sdap_id_conn_data_uncache(conn_data);
         sdap_id_release_conn_data(conn_data);
     }
 }
@@ -376,7 +490,7 @@ static void sdap_id_conn_data_idle_handler(struct tevent_context *ev,
     int idle_timeout;
     struct timeval tv;
 
-    if (conn_cache->cached_connection != conn_data) {
+    if (!sdap_id_conn_data_is_cached(conn_data)) {
         DEBUG(SSSDBG_TRACE_ALL, "Abandoning idle timer for released connection\n");
         return;
     }
@@ -388,7 +502,7 @@ static void sdap_id_conn_data_idle_handler(struct tevent_context *ev,
     if (idle_time != 0 && idle_time + idle_timeout <= now) {
         DEBUG(SSSDBG_TRACE_ALL,
               "Connection has reached idle timeout, releasing it\n");
-        conn_cache->cached_connection = NULL;
+        sdap_id_conn_data_uncache(conn_data);
         sdap_id_release_conn_data(conn_data);
         return;
     }
@@ -463,6 +577,7 @@ static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn
 
     if (current) {
         DLIST_REMOVE(current->ops, op);
+        current->num_ops--;
     }
 
     op->conn_data = conn_data;
@@ -470,10 +585,11 @@ static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn
     if (conn_data) {
         sdap_id_conn_data_not_idle(conn_data);
         DLIST_ADD_END(conn_data->ops, op, struct sdap_id_op*);
+        conn_data->num_ops++;
     }
 
     if (current && !current->ops) {
-        if (current == current->conn_cache->cached_connection) {
+        if (sdap_id_conn_data_is_cached(current)) {
             sdap_id_conn_data_idle(current);
         } else {
             sdap_id_release_conn_data(current);
@@ -609,27 +725,54 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     struct sdap_id_conn_cache *conn_cache = op->conn_cache;
 
     int ret = EOK;
-    struct sdap_id_conn_data *conn_data;
+    struct sdap_id_conn_data *conn_data = NULL;
+    struct sdap_id_conn_data *best = NULL;
     struct tevent_req *subreq = NULL;
+    int free_slot = -1;
+    int i;
 
-    /* Try to reuse context cached connection */
-    conn_data = conn_cache->cached_connection;
-    if (conn_data) {
-        if (conn_data->connect_req) {
-            DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
-            sdap_id_op_hook_conn_data(op, conn_data);
-            goto done;
+    ret = sdap_id_conn_cache_init_pool(conn_cache);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* Find the cached connection with the least operations in progress */
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        conn_data = conn_cache->pool[i];
+        if (conn_data == NULL) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+            continue;
         }
 
-        if (sdap_can_reuse_connection(conn_data)) {
-            DEBUG(SSSDBG_TRACE_ALL, "reusing cached connection\n");
-            sdap_id_op_hook_conn_data(op, conn_data);
-            goto done;
+        if (conn_data->connect_req == NULL
+                && !sdap_can_reuse_connection(conn_data)) {
+            DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
+            conn_cache->pool[i] = NULL;
+            sdap_id_release_conn_data(conn_data);
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+            continue;
         }
 
-        DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(conn_data);
+        if (best == NULL || conn_data->num_ops < best->num_ops) {
+            best = conn_data;
+        }
+    }
+    conn_data = NULL;
+
+    /* Only open another connection if all cached ones are busy */
+    if (best != NULL && (best->num_ops == 0 || free_slot < 0)) {
+        if (best->connect_req) {
+            DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
+        } else {
+            DEBUG(SSSDBG_TRACE_ALL, "reusing cached connection [%d] with "
+                  "%d operations in progress\n", best->slot, best->num_ops);
+        }
+        sdap_id_op_hook_conn_data(op, best);
+        goto done;
     }
 
     DEBUG(SSSDBG_TRACE_ALL, "beginning to connect\n");
@@ -658,7 +801,8 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     conn_data->connect_req = subreq;
 
     DLIST_ADD(conn_cache->connections, conn_data);
-    conn_cache->cached_connection = conn_data;
+    conn_cache->pool[free_slot] = conn_data;
+    conn_data->slot = free_slot;
 
     sdap_id_op_hook_conn_data(op, conn_data);
 
@@ -814,9 +958,7 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
             bool retry = false;
 
             /* drop connection from cache now */
-            if (conn_cache->cached_connection == conn_data) {
-                conn_cache->cached_connection = NULL;
-            }
+            sdap_id_conn_data_uncache(conn_data);
 
             if (can_retry) {
                 /* determining whether retry is possible */
@@ -876,20 +1018,20 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
 
     if ((ret == EOK)
             && conn_data->sh->connected
-            && !be_is_offline(conn_cache->id_conn->id_ctx->be)) {
+            && !be_is_offline(conn_cache->id_conn->id_ctx->be)
+            && sdap_id_conn_data_cache(conn_data)) {
         DEBUG(SSSDBG_TRACE_ALL,
               "caching successful connection after %d notifies\n", notify_count);
-        conn_cache->cached_connection = conn_data;
-
-        /* Run any post-connection routines */
-        be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
-        be_run_online_cb(conn_cache->id_conn->id_ctx->be);
 
-    } else {
-        if (conn_cache->cached_connection == conn_data) {
-            conn_cache->cached_connection = NULL;
+        /* Run any post-connection routines, additional connections to
+         * the same server do not change anything */
+        if (!sdap_id_conn_cache_is_connected(conn_cache, conn_data)) {
+            be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
+            be_run_online_cb(conn_cache->id_conn->id_ctx->be);
         }
 
+    } else {
+        sdap_id_conn_data_uncache(conn_data);
         sdap_id_release_conn_data(conn_data);
     }
 
@@ -995,9 +1137,9 @@ int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_err_out)
     }
 
     if (communication_error && current_conn != 0
-            && current_conn == op->conn_cache->cached_connection) {
+            && sdap_id_conn_data_is_cached(current_conn)) {
         /* do not reuse failed connection */
-        op->conn_cache->cached_connection = NULL;
+        sdap_id_conn_data_uncache(current_conn);
 
         DEBUG(SSSDBG_FUNC_DATA,
               "communication error on cached connection, moving to next server\n");
@@ -41,6 +41,13 @@ int sdap_id_conn_cache_create(TALLOC_CTX *memctx,
                               struct sdap_id_conn_ctx *id_conn,
                               struct sdap_id_conn_cache** conn_cache_out);
 
+/* Get the number of operations in progress on each of the pooled
+ * connections, -1 is reported for slots without a connection.
+ * Returns the size of the pool. */
+int sdap_id_conn_cache_get_outstanding(struct sdap_id_conn_cache *conn_cache,
+                                       int *outstanding,
+                                       int max);
+
 /* Create an operation object */
 struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cache *cache);
 
@@ -0,0 +1,260 @@
+/*
+    SSSD
+
+    LDAP parent groups cache
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/sss_ptr_cache.h"
+#include "db/sysdb.h"
+#include "providers/ldap/sdap.h"
+#include "providers/ldap/sdap_parents_cache.h"
+
+/*
+ * The direct parent groups of groups found during rfc2307bis initgroups
+ * are kept in memory for ldap_group_parents_cache_timeout seconds, so users
+ * sharing a group hierarchy only need their direct memberships to be looked
+ * up in LDAP and the rest of the hierarchy is resolved from this cache.
+ *
+ * Entries are keyed by the original DN of the group and remember the USN
+ * (or the modification timestamp) of the group entry. A cached entry is not
+ * used if the group entry that is being resolved has a different version.
+ * Since adding a group to another group only modifies the parent, changes
+ * in the hierarchy are picked up when the entry expires.
+ */
+
+struct sdap_parents_cache_entry {
+    const char *version;
+
+    struct sysdb_attrs **parents;
+    size_t num_parents;
+};
+
+static struct sss_ptr_cache *
+sdap_parents_cache_get(struct sdap_options *opts)
+{
+    int timeout;
+
+    if (opts->parents_cache != NULL) {
+        return opts->parents_cache;
+    }
+
+    timeout = dp_opt_get_int(opts->basic, SDAP_PARENTS_CACHE_TIMEOUT);
+    if (timeout <= 0) {
+        return NULL;
+    }
+
+    opts->parents_cache = sss_ptr_cache_create(opts,
+                                               SDAP_PARENTS_CACHE_MAX_ENTRIES,
+                                               timeout);
+
+    return opts->parents_cache;
+}
+
+static const char *
+sdap_parents_cache_version(struct sdap_options *opts,
+                           struct sysdb_attrs *group)
+{
+    const char *version;
+    errno_t ret;
+
+    ret = sysdb_attrs_get_string(group,
+                                 opts->group_map[SDAP_AT_GROUP_USN].sys_name,
+                                 &version);
+    if (ret == EOK) {
+        return version;
+    }
+
+    ret = sysdb_attrs_get_string(group,
+                                 opts->group_map[SDAP_AT_GROUP_MODSTAMP].sys_name,
+                                 &version);
+    if (ret == EOK) {
+        return version;
+    }
+
+    return NULL;
+}
+
+static bool sdap_parents_cache_version_eq(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    return strcmp(a, b) == 0;
+}
+
+/* The cached entry is only used for the same version of the group */
+static bool sdap_parents_cache_entry_valid(void *ptr, void *pvt)
+{
+    struct sdap_parents_cache_entry *entry;
+
+    entry = talloc_get_type(ptr, struct sdap_parents_cache_entry);
+
+    return sdap_parents_cache_version_eq(entry->version, pvt);
+}
+
+static errno_t
+sdap_parents_cache_copy(TALLOC_CTX *mem_ctx,
+                        struct sysdb_attrs **parents,
+                        size_t num_parents,
+                        struct sysdb_attrs ***_copy)
+{
+    struct sysdb_attrs **copy;
+    errno_t ret;
+    size_t i;
+
+    copy = talloc_zero_array(mem_ctx, struct sysdb_attrs *, num_parents + 1);
+    if (copy == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_parents; i++) {
+        copy[i] = sysdb_new_attrs(copy);
+        if (copy[i] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sysdb_attrs_copy(parents[i], copy[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_copy = copy;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(copy);
+    }
+
+    return ret;
+}
+
+errno_t sdap_parents_cache_lookup(TALLOC_CTX *mem_ctx,
+                                  struct sdap_options *opts,
+                                  struct sysdb_attrs *group,
+                                  struct sysdb_attrs ***_parents,
+                                  size_t *_num_parents)
+{
+    struct sss_ptr_cache *cache;
+    struct sdap_parents_cache_entry *entry;
+    const char *version;
+    const char *orig_dn;
+    errno_t ret;
+
+    cache = sdap_parents_cache_get(opts);
+    if (cache == NULL) {
+        return ENOENT;
+    }
+
+    ret = sysdb_attrs_get_string(group, SYSDB_ORIG_DN, &orig_dn);
+    if (ret != EOK) {
+        return ENOENT;
+    }
+
+    version = sdap_parents_cache_version(opts, group);
+    entry = sss_ptr_cache_lookup(cache, orig_dn,
+                                 sdap_parents_cache_entry_valid,
+                                 discard_const(version));
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    ret = sdap_parents_cache_copy(mem_ctx, entry->parents, entry->num_parents,
+                                  _parents);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_num_parents = entry->num_parents;
+
+    return EOK;
+}
+
+void sdap_parents_cache_store(struct sdap_options *opts,
+                              struct sysdb_attrs *group,
+                              struct sysdb_attrs **parents,
+                              size_t num_parents)
+{
+    struct sss_ptr_cache *cache;
+    struct sdap_parents_cache_entry *entry;
+    const char *version;
+    const char *orig_dn;
+    errno_t ret;
+
+    cache = sdap_parents_cache_get(opts);
+    if (cache == NULL) {
+        return;
+    }
+
+    ret = sysdb_attrs_get_string(group, SYSDB_ORIG_DN, &orig_dn);
+    if (ret != EOK) {
+        return;
+    }
+
+    entry = talloc_zero(NULL, struct sdap_parents_cache_entry);
+    if (entry == NULL) {
+        return;
+    }
+
+    version = sdap_parents_cache_version(opts, group);
+    if (version != NULL) {
+        entry->version = talloc_strdup(entry, version);
+        if (entry->version == NULL) {
+            talloc_free(entry);
+            return;
+        }
+    }
+
+    ret = sdap_parents_cache_copy(entry, parents, num_parents,
+                                  &entry->parents);
+    if (ret != EOK) {
+        talloc_free(entry);
+        return;
+    }
+
+    entry->num_parents = num_parents;
+
+    ret = sss_ptr_cache_add(cache, orig_dn, entry);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unable to cache parent groups of [%s] [%d]: %s\n",
+              orig_dn, ret, sss_strerror(ret));
+    }
+}
+
+void sdap_parents_cache_flush(struct sdap_options *opts)
+{
+    if (opts->parents_cache == NULL) {
+        return;
+    }
+
+    sss_ptr_cache_flush(opts->parents_cache, NULL, NULL);
+}
+
+void sdap_parents_cache_get_stats(struct sdap_options *opts,
+                                  uint64_t *_hits,
+                                  uint64_t *_misses)
+{
+    sss_ptr_cache_get_stats(opts->parents_cache, _hits, _misses);
+}
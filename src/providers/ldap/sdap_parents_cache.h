@@ -0,0 +1,52 @@
+/*
+    SSSD
+
+    LDAP parent groups cache
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SDAP_PARENTS_CACHE_H_
+#define _SDAP_PARENTS_CACHE_H_
+
+#include "providers/ldap/sdap.h"
+
+/* Maximum number of groups kept in the cache, groups that were not used
+ * recently are evicted when it is full */
+#define SDAP_PARENTS_CACHE_MAX_ENTRIES 50000
+
+/* Returns copies of the cached direct parent groups of @group, allocated
+ * on @mem_ctx. Returns ENOENT if the parents of the group are not cached,
+ * the cached entry expired or the group changed since it was cached. */
+errno_t sdap_parents_cache_lookup(TALLOC_CTX *mem_ctx,
+                                  struct sdap_options *opts,
+                                  struct sysdb_attrs *group,
+                                  struct sysdb_attrs ***_parents,
+                                  size_t *_num_parents);
+
+/* Remembers the direct parent groups of @group as found in LDAP. */
+void sdap_parents_cache_store(struct sdap_options *opts,
+                              struct sysdb_attrs *group,
+                              struct sysdb_attrs **parents,
+                              size_t num_parents);
+
+void sdap_parents_cache_flush(struct sdap_options *opts);
+
+void sdap_parents_cache_get_stats(struct sdap_options *opts,
+                                  uint64_t *_hits,
+                                  uint64_t *_misses);
+
+#endif /* _SDAP_PARENTS_CACHE_H_ */
@@ -23,6 +23,7 @@
 
 #include "providers/ldap/sdap.h"
 #include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async_enum.h"
 
 struct sdap_refresh_state {
     struct tevent_context *ev;
@@ -198,6 +199,631 @@ static errno_t sdap_refresh_recv(struct tevent_req *req)
     return EOK;
 }
 
+/* Expired users and groups can be refreshed with a single search for
+ * entries with a USN higher than the lowest USN of the expired entries as
+ * long as all of them were stored from the server the backend currently
+ * talks to. Every entry that is not returned by the search did not change
+ * on the server and only its expiration is bumped. Each successful search
+ * is remembered as a checkpoint, entries updated after the checkpoint are
+ * known to be current up to the highest USN seen by the search.
+ *
+ * If all expired entries were stored while the change notification
+ * subscription was active, no search is needed at all.
+ *
+ * Since deleted entries are not returned by the search, the expired
+ * entries are refreshed one by one once per ldap_refresh_usn_full_interval
+ * seconds. */
+
+#define SDAP_REFRESH_USN_MAX_CHECKPOINTS 64
+
+struct sdap_refresh_usn_checkpoint {
+    time_t time;
+    unsigned long long usn;
+};
+
+struct sdap_refresh_usn_type {
+    time_t last_full;
+
+    struct sdap_refresh_usn_checkpoint *checkpoints;
+    size_t num_checkpoints;
+};
+
+struct sdap_refresh_usn_ctx {
+    struct sdap_refresh_usn_type users;
+    struct sdap_refresh_usn_type groups;
+};
+
+struct sdap_refresh_usn_record {
+    struct ldb_dn *dn;
+    bool has_usn;
+    unsigned long long usn;
+    time_t last_update;
+};
+
+static errno_t sdap_refresh_usn_parse(const char *str,
+                                      unsigned long long *_usn)
+{
+    unsigned long long usn;
+    char *endptr;
+
+    if (str == NULL) {
+        return EINVAL;
+    }
+
+    errno = 0;
+    usn = strtoull(str, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || endptr == str) {
+        return EINVAL;
+    }
+
+    *_usn = usn;
+    return EOK;
+}
+
+static struct sdap_refresh_usn_type *
+sdap_refresh_usn_get_type(struct sdap_id_ctx *id_ctx, int entry_type)
+{
+    if (id_ctx->refresh_usn == NULL) {
+        id_ctx->refresh_usn = talloc_zero(id_ctx, struct sdap_refresh_usn_ctx);
+        if (id_ctx->refresh_usn == NULL) {
+            return NULL;
+        }
+    }
+
+    if (entry_type == BE_REQ_USER) {
+        return &id_ctx->refresh_usn->users;
+    }
+
+    return &id_ctx->refresh_usn->groups;
+}
+
+/* Returns the USN up to which an entry updated at @last_update is known
+ * to be current. */
+static unsigned long long
+sdap_refresh_usn_checkpoint(struct sdap_refresh_usn_type *type,
+                            time_t last_update)
+{
+    unsigned long long usn = 0;
+    size_t i;
+
+    for (i = 0; i < type->num_checkpoints; i++) {
+        if (type->checkpoints[i].time > last_update) {
+            break;
+        }
+        usn = type->checkpoints[i].usn;
+    }
+
+    return usn;
+}
+
+static errno_t sdap_refresh_usn_add_checkpoint(TALLOC_CTX *mem_ctx,
+                                               struct sdap_refresh_usn_type *type,
+                                               time_t time,
+                                               time_t oldest,
+                                               unsigned long long usn)
+{
+    struct sdap_refresh_usn_checkpoint *checkpoints;
+    size_t skip;
+
+    /* Checkpoints older than the oldest entry that might still be cached
+     * are never used again. */
+    for (skip = 0; skip < type->num_checkpoints; skip++) {
+        if (type->checkpoints[skip].time >= oldest) {
+            break;
+        }
+    }
+
+    if (type->num_checkpoints - skip >= SDAP_REFRESH_USN_MAX_CHECKPOINTS) {
+        skip = type->num_checkpoints - SDAP_REFRESH_USN_MAX_CHECKPOINTS + 1;
+    }
+
+    if (skip > 0) {
+        memmove(type->checkpoints, type->checkpoints + skip,
+                sizeof(struct sdap_refresh_usn_checkpoint)
+                    * (type->num_checkpoints - skip));
+        type->num_checkpoints -= skip;
+    }
+
+    checkpoints = talloc_realloc(mem_ctx, type->checkpoints,
+                                 struct sdap_refresh_usn_checkpoint,
+                                 type->num_checkpoints + 1);
+    if (checkpoints == NULL) {
+        return ENOMEM;
+    }
+
+    checkpoints[type->num_checkpoints].time = time;
+    checkpoints[type->num_checkpoints].usn = usn;
+    type->checkpoints = checkpoints;
+    type->num_checkpoints++;
+
+    return EOK;
+}
+
+static errno_t sdap_refresh_usn_get_records(TALLOC_CTX *mem_ctx,
+                                            struct sss_domain_info *domain,
+                                            int entry_type,
+                                            const char *key_attr,
+                                            char **keys,
+                                            struct sdap_refresh_usn_record **_records,
+                                            size_t *_num_records)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { key_attr, SYSDB_USN, SYSDB_LAST_UPDATE, NULL };
+    struct sdap_refresh_usn_record *records;
+    struct ldb_message **msgs;
+    hash_table_t *table;
+    hash_key_t key;
+    hash_value_t value;
+    const char *str;
+    size_t num_keys;
+    size_t count;
+    size_t num;
+    size_t i;
+    errno_t ret;
+    int hret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    for (num_keys = 0; keys[num_keys] != NULL; num_keys++);
+
+    ret = sss_hash_create(tmp_ctx, num_keys, &table);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    key.type = HASH_KEY_CONST_STRING;
+    value.type = HASH_VALUE_UNDEF;
+    for (i = 0; i < num_keys; i++) {
+        key.c_str = keys[i];
+        hret = hash_enter(table, &key, &value);
+        if (hret != HASH_SUCCESS) {
+            ret = EIO;
+            goto done;
+        }
+    }
+
+    if (entry_type == BE_REQ_USER) {
+        ret = sysdb_search_users(tmp_ctx, domain, "("SYSDB_NAME"=*)", attrs,
+                                 &count, &msgs);
+    } else {
+        ret = sysdb_search_groups(tmp_ctx, domain, "("SYSDB_NAME"=*)", attrs,
+                                  &count, &msgs);
+    }
+    if (ret == ENOENT) {
+        count = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    records = talloc_zero_array(tmp_ctx, struct sdap_refresh_usn_record,
+                                num_keys);
+    if (records == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0, num = 0; i < count && num < num_keys; i++) {
+        key.c_str = ldb_msg_find_attr_as_string(msgs[i], key_attr, NULL);
+        if (key.c_str == NULL || !hash_has_key(table, &key)) {
+            continue;
+        }
+
+        str = ldb_msg_find_attr_as_string(msgs[i], SYSDB_USN, NULL);
+        ret = sdap_refresh_usn_parse(str, &records[num].usn);
+        records[num].has_usn = (ret == EOK);
+
+        records[num].last_update = ldb_msg_find_attr_as_uint64(msgs[i],
+                                                    SYSDB_LAST_UPDATE, 0);
+        records[num].dn = talloc_steal(records, msgs[i]->dn);
+        num++;
+    }
+
+    if (num != num_keys) {
+        DEBUG(SSSDBG_TRACE_FUNC, "%zu of %zu entries were not found\n",
+              num_keys - num, num_keys);
+        ret = ENOTSUP;
+        goto done;
+    }
+
+    *_records = talloc_steal(mem_ctx, records);
+    *_num_records = num;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+struct sdap_refresh_usn_state {
+    struct tevent_context *ev;
+    struct sss_domain_info *domain;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+    struct sdap_id_op *op;
+    struct sdap_refresh_usn_type *type;
+    int entry_type;
+    time_t timeout;
+    time_t start;
+    unsigned long long start_usn;
+    unsigned long long min_usn;
+
+    struct sdap_refresh_usn_record *records;
+    size_t num_records;
+};
+
+static errno_t sdap_refresh_usn_bump(struct sdap_refresh_usn_state *state);
+static void sdap_refresh_usn_connect_done(struct tevent_req *subreq);
+static void sdap_refresh_usn_done(struct tevent_req *subreq);
+
+struct tevent_req *sdap_refresh_usn_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct sss_domain_info *domain,
+                                         int entry_type,
+                                         const char *key_attr,
+                                         char **keys,
+                                         struct sdap_id_conn_ctx *conn)
+{
+    struct sdap_refresh_usn_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    struct tevent_req *req = NULL;
+    const char *usn_attr = NULL;
+    time_t notify_since;
+    int interval;
+    errno_t ret;
+    size_t i;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_refresh_usn_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    if (keys == NULL || keys[0] == NULL) {
+        ret = EOK;
+        goto immediately;
+    }
+
+    state->ev = ev;
+    state->domain = domain;
+    state->id_ctx = conn->id_ctx;
+    state->entry_type = entry_type;
+    state->start = time(NULL);
+
+    interval = dp_opt_get_int(state->id_ctx->opts->basic,
+                              SDAP_REFRESH_USN_FULL_INTERVAL);
+    if (interval <= 0) {
+        ret = ENOTSUP;
+        goto immediately;
+    }
+
+    switch (entry_type) {
+    case BE_REQ_USER:
+        state->timeout = domain->user_timeout;
+        usn_attr = state->id_ctx->opts->user_map[SDAP_AT_USER_USN].name;
+        break;
+    case BE_REQ_GROUP:
+        state->timeout = domain->group_timeout;
+        usn_attr = state->id_ctx->opts->group_map[SDAP_AT_GROUP_USN].name;
+        break;
+    default:
+        ret = EINVAL;
+        goto immediately;
+    }
+
+    state->sdom = sdap_domain_get(state->id_ctx->opts, domain);
+    if (state->sdom == NULL) {
+        ret = ERR_DOMAIN_NOT_FOUND;
+        goto immediately;
+    }
+
+    state->type = sdap_refresh_usn_get_type(state->id_ctx, entry_type);
+    if (state->type == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    if (state->start >= state->type->last_full + interval) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Full refresh of %s is due\n",
+              be_req2str(entry_type));
+        state->type->last_full = state->start;
+        ret = ENOTSUP;
+        goto immediately;
+    }
+
+    ret = sdap_refresh_usn_get_records(state, domain, entry_type, key_attr,
+                                       keys, &state->records,
+                                       &state->num_records);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    /* Entries stored while the change notification subscription is active
+     * would have been refreshed if they changed. */
+    notify_since = sdap_change_notify_active_since(state->id_ctx);
+    for (i = 0; notify_since != 0 && i < state->num_records; i++) {
+        if (state->records[i].last_update < notify_since) {
+            notify_since = 0;
+        }
+    }
+
+    if (notify_since != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "No %s changed since they were stored\n",
+              be_req2str(entry_type));
+        ret = sdap_refresh_usn_bump(state);
+        goto immediately;
+    }
+
+    for (i = 0; i < state->num_records; i++) {
+        if (!state->records[i].has_usn) {
+            usn_attr = NULL;
+            break;
+        }
+    }
+
+    if (usn_attr == NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC, "USN of some %s is not known\n",
+              be_req2str(entry_type));
+        ret = ENOTSUP;
+        goto immediately;
+    }
+
+    state->op = sdap_id_op_create(state, conn->conn_cache);
+    if (state->op == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (subreq == NULL) {
+        goto immediately;
+    }
+    tevent_req_set_callback(subreq, sdap_refresh_usn_connect_done, req);
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sdap_refresh_usn_connect_done(struct tevent_req *subreq)
+{
+    struct sdap_refresh_usn_state *state = NULL;
+    struct sdap_server_opts *srv_opts;
+    struct tevent_req *req = NULL;
+    unsigned long long min_usn = ULLONG_MAX;
+    unsigned long long usn;
+    char *usn_value;
+    int dp_error;
+    errno_t ret;
+    size_t i;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_refresh_usn_state);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    srv_opts = state->id_ctx->srv_opts;
+    if (srv_opts == NULL || !srv_opts->supports_usn) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Server does not support USN\n");
+        tevent_req_error(req, ENOTSUP);
+        return;
+    }
+
+    for (i = 0; i < state->num_records; i++) {
+        /* USN values are local to each server */
+        if (state->records[i].last_update < srv_opts->first_seen) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Some %s were stored from another "
+                  "server\n", be_req2str(state->entry_type));
+            tevent_req_error(req, ENOTSUP);
+            return;
+        }
+
+        usn = MAX(state->records[i].usn,
+                  sdap_refresh_usn_checkpoint(state->type,
+                                              state->records[i].last_update));
+        min_usn = MIN(min_usn, usn);
+    }
+
+    usn_value = talloc_asprintf(state, "%llu", min_usn);
+    if (usn_value == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    state->start_usn = srv_opts->last_usn;
+    state->min_usn = min_usn;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Refreshing %zu %s changed since USN %s\n",
+          state->num_records, be_req2str(state->entry_type), usn_value);
+
+    if (state->entry_type == BE_REQ_USER) {
+        subreq = sdap_enum_users_changed_send(state, state->ev, state->id_ctx,
+                                              state->sdom, state->op,
+                                              usn_value);
+    } else {
+        subreq = sdap_enum_groups_changed_send(state, state->ev, state->id_ctx,
+                                               state->sdom, state->op,
+                                               usn_value);
+    }
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(subreq, sdap_refresh_usn_done, req);
+}
+
+static errno_t sdap_refresh_usn_bump(struct sdap_refresh_usn_state *state)
+{
+    struct sysdb_attrs *attrs;
+    bool in_transaction = false;
+    errno_t sret;
+    errno_t ret;
+    size_t i;
+
+    attrs = sysdb_new_attrs(state);
+    if (attrs == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_LAST_UPDATE, state->start);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE,
+                                 state->timeout == 0 ? 0
+                                     : state->start + state->timeout);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_transaction_start(state->domain->sysdb);
+    if (ret != EOK) {
+        goto done;
+    }
+    in_transaction = true;
+
+    for (i = 0; i < state->num_records; i++) {
+        ret = sysdb_set_entry_attr(state->domain->sysdb, state->records[i].dn,
+                                   attrs, SYSDB_MOD_REP);
+        if (ret == ENOENT) {
+            /* removed while the search was running */
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_transaction_commit(state->domain->sysdb);
+    if (ret != EOK) {
+        goto done;
+    }
+    in_transaction = false;
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(state->domain->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+    talloc_free(attrs);
+
+    return ret;
+}
+
+static void sdap_refresh_usn_done(struct tevent_req *subreq)
+{
+    struct sdap_refresh_usn_state *state = NULL;
+    struct tevent_req *req = NULL;
+    unsigned long long usn = 0;
+    char *usn_value = NULL;
+    int dp_error;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_refresh_usn_state);
+
+    if (state->entry_type == BE_REQ_USER) {
+        ret = sdap_enum_users_changed_recv(subreq, state, &usn_value);
+    } else {
+        ret = sdap_enum_groups_changed_recv(subreq, state, &usn_value);
+    }
+    talloc_zfree(subreq);
+    if (ret == ENOENT) {
+        /* No cached entry changed since the lowest USN */
+        ret = EOK;
+    }
+
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to search for changed %s "
+              "[%d]: %s\n", be_req2str(state->entry_type),
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = sdap_refresh_usn_bump(state);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to update expiration of %s "
+              "[%d]: %s\n", be_req2str(state->entry_type),
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (usn_value != NULL) {
+        sdap_refresh_usn_parse(usn_value, &usn);
+    }
+
+    /* The entries are current at least up to the USN the search started
+     * from even if it returned nothing */
+    ret = sdap_refresh_usn_add_checkpoint(state->id_ctx->refresh_usn,
+                                          state->type, state->start,
+                                          state->start - state->timeout,
+                                          MAX(MAX(usn, state->min_usn),
+                                              state->start_usn));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Refreshed %zu %s\n", state->num_records,
+          be_req2str(state->entry_type));
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+errno_t sdap_refresh_usn_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+static struct tevent_req *sdap_refresh_usn_cb_send(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_context *ev,
+                                                   struct be_ctx *be_ctx,
+                                                   struct sss_domain_info *domain,
+                                                   int entry_type,
+                                                   char **names,
+                                                   void *pvt)
+{
+    struct sdap_id_ctx *id_ctx = talloc_get_type(pvt, struct sdap_id_ctx);
+
+    return sdap_refresh_usn_send(mem_ctx, ev, domain, entry_type, SYSDB_NAME,
+                                 names, id_ctx->conn);
+}
+
+static errno_t sdap_refresh_usn_cb_recv(struct tevent_req *req)
+{
+    return sdap_refresh_usn_recv(req);
+}
+
+REFRESH_SEND_RECV_FNS(sdap_refresh_users_usn, sdap_refresh_usn_cb, BE_REQ_USER);
+REFRESH_SEND_RECV_FNS(sdap_refresh_groups_usn, sdap_refresh_usn_cb, BE_REQ_GROUP);
+
 REFRESH_SEND_RECV_FNS(sdap_refresh_initgroups, sdap_refresh, BE_REQ_INITGROUPS);
 REFRESH_SEND_RECV_FNS(sdap_refresh_users, sdap_refresh, BE_REQ_USER);
 REFRESH_SEND_RECV_FNS(sdap_refresh_groups, sdap_refresh, BE_REQ_GROUP);
@@ -214,10 +840,14 @@ errno_t sdap_refresh_init(struct be_ctx *be_ctx,
         },
         { .send_fn = sdap_refresh_users_send,
           .recv_fn = sdap_refresh_users_recv,
+          .bulk_send_fn = sdap_refresh_users_usn_send,
+          .bulk_recv_fn = sdap_refresh_users_usn_recv,
           .pvt = id_ctx,
         },
         { .send_fn = sdap_refresh_groups_send,
           .recv_fn = sdap_refresh_groups_recv,
+          .bulk_send_fn = sdap_refresh_groups_usn_send,
+          .bulk_recv_fn = sdap_refresh_groups_usn_recv,
           .pvt = id_ctx,
         },
         { .send_fn = sdap_refresh_netgroups_send,
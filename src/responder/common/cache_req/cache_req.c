@@ -176,6 +176,31 @@ cache_req_create(TALLOC_CTX *mem_ctx,
     return cr;
 }
 
+/* Copy of the request that can be bound to a different domain. */
+static struct cache_req *
+cache_req_clone(TALLOC_CTX *mem_ctx,
+                struct cache_req *cr)
+{
+    struct cache_req *clone;
+
+    clone = talloc_zero(mem_ctx, struct cache_req);
+    if (clone == NULL) {
+        return NULL;
+    }
+
+    *clone = *cr;
+    clone->domain = NULL;
+    clone->debugobj = NULL;
+
+    clone->data = cache_req_data_copy(clone, cr->data);
+    if (clone->data == NULL) {
+        talloc_free(clone);
+        return NULL;
+    }
+
+    return clone;
+}
+
 static errno_t
 cache_req_set_name(struct cache_req *cr, const char *name)
 {
@@ -688,6 +713,19 @@ static errno_t cache_req_locate_dom_cache_recv(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+/* Search of a single domain when all domains are searched at once. */
+struct cache_req_parallel_search {
+    struct tevent_req *req;
+    struct cache_req *cr;
+    struct sss_domain_info *domain;
+    struct tevent_req *subreq;
+
+    bool done;
+    errno_t ret;
+    struct ldb_result *result;
+    bool dp_success;
+};
+
 struct cache_req_search_domains_state {
     /* input data */
     struct tevent_context *ev;
@@ -702,9 +740,15 @@ struct cache_req_search_domains_state {
     bool check_next;
     bool dp_success;
     bool first_iteration;
+
+    /* parallel search, ordered by domain resolution order */
+    struct cache_req_parallel_search *parallel;
+    size_t num_parallel;
+    size_t parallel_next;
 };
 
 static errno_t cache_req_search_domains_next(struct tevent_req *req);
+static errno_t cache_req_search_domains_parallel(struct tevent_req *req);
 static errno_t cache_req_handle_result(struct tevent_req *req,
                                        struct ldb_result *result);
 
@@ -772,7 +816,10 @@ cache_req_search_domains_send(TALLOC_CTX *mem_ctx,
         cache_req_domain_set_locate_flag(cr_domain, cr);
     }
 
-    ret = cache_req_search_domains_next(req);
+    ret = cache_req_search_domains_parallel(req);
+    if (ret == ENOENT) {
+        ret = cache_req_search_domains_next(req);
+    }
     if (ret == EAGAIN) {
         return req;
     }
@@ -787,23 +834,49 @@ cache_req_search_domains_send(TALLOC_CTX *mem_ctx,
     return req;
 }
 
+static bool
+cache_req_search_domains_skip(struct cache_req_search_domains_state *state,
+                              struct cache_req_domain *cr_domain)
+{
+    struct cache_req *cr = state->cr;
+
+    /* As the cr_domain list is a flatten version of the domains
+     * list, we have to ensure to only go through the subdomains in
+     * case it's specified in the plugin to do so.
+     */
+    if (cr->plugin->get_next_domain_flags == 0
+            && IS_SUBDOMAIN(cr_domain->domain)) {
+        return true;
+    }
+
+    /* Check if this domain is valid for this request. */
+    if (!cache_req_validate_domain(cr, cr_domain->domain)) {
+        return true;
+    }
+
+    /* If not specified otherwise, we skip domains that require fully
+     * qualified names on domain less search. We do not descend into
+     * subdomains here since those are implicitly qualified.
+     */
+    if (state->check_next && !cr->plugin->allow_missing_fqn
+            && cr_domain->fqnames) {
+        return true;
+    }
+
+    return false;
+}
+
 static errno_t cache_req_search_domains_next(struct tevent_req *req)
 {
     struct cache_req_search_domains_state *state;
     struct tevent_req *subreq;
     struct cache_req *cr;
     struct sss_domain_info *domain;
-    uint32_t next_domain_flag;
-    bool is_domain_valid;
-    bool allow_no_fqn;
     errno_t ret;
 
     state = tevent_req_data(req, struct cache_req_search_domains_state);
     cr = state->cr;
 
-    next_domain_flag = cr->plugin->get_next_domain_flags;
-    allow_no_fqn = cr->plugin->allow_missing_fqn;
-
     while (state->cr_domain != NULL) {
         domain = state->cr_domain->domain;
 
@@ -811,27 +884,7 @@ static errno_t cache_req_search_domains_next(struct tevent_req *req)
             break;
         }
 
-        /* As the cr_domain list is a flatten version of the domains
-         * list, we have to ensure to only go through the subdomains in
-         * case it's specified in the plugin to do so.
-         */
-        if (next_domain_flag == 0 && IS_SUBDOMAIN(domain)) {
-            state->cr_domain = state->cr_domain->next;
-            continue;
-        }
-
-        /* Check if this domain is valid for this request. */
-        is_domain_valid = cache_req_validate_domain(cr, domain);
-        if (!is_domain_valid) {
-            state->cr_domain = state->cr_domain->next;
-            continue;
-        }
-
-        /* If not specified otherwise, we skip domains that require fully
-         * qualified names on domain less search. We do not descend into
-         * subdomains here since those are implicitly qualified.
-         */
-        if (state->check_next && !allow_no_fqn && state->cr_domain->fqnames) {
+        if (cache_req_search_domains_skip(state, state->cr_domain)) {
             state->cr_domain = state->cr_domain->next;
             continue;
         }
@@ -1058,6 +1111,248 @@ done:
     return;
 }
 
+static void cache_req_search_domains_parallel_done(struct tevent_req *subreq);
+
+/* With parallel_domain_search enabled, a domain-less search is sent to all
+ * candidate domains at once. The results are still processed in the domain
+ * resolution order, a domain is only looked at once all preceding domains
+ * finished, so the outcome is the same as with the sequential search.
+ *
+ * Returns ENOENT if the search should be done sequentially. */
+static errno_t cache_req_search_domains_parallel(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_parallel_search *search;
+    struct cache_req_domain *cr_domain;
+    size_t max;
+    size_t i;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    if (!state->cr->rctx->parallel_domain_search || !state->check_next) {
+        return ENOENT;
+    }
+
+    max = 0;
+    DLIST_FOR_EACH(cr_domain, state->cr_domain) {
+        /* The domain locator selects a single domain by itself. */
+        if (cr_domain->locate_domain) {
+            return ENOENT;
+        }
+        max++;
+    }
+
+    if (max < 2) {
+        return ENOENT;
+    }
+
+    state->parallel = talloc_zero_array(state, struct cache_req_parallel_search,
+                                        max);
+    if (state->parallel == NULL) {
+        return ENOMEM;
+    }
+
+    DLIST_FOR_EACH(cr_domain, state->cr_domain) {
+        if (cr_domain->domain == NULL) {
+            break;
+        }
+
+        if (cache_req_search_domains_skip(state, cr_domain)) {
+            continue;
+        }
+
+        state->parallel[state->num_parallel].domain = cr_domain->domain;
+        state->num_parallel++;
+    }
+
+    if (state->num_parallel < 2) {
+        talloc_zfree(state->parallel);
+        state->num_parallel = 0;
+        return ENOENT;
+    }
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                    "Searching %zu domains in parallel\n",
+                    state->num_parallel);
+
+    for (i = 0; i < state->num_parallel; i++) {
+        search = &state->parallel[i];
+        search->req = req;
+
+        /* Each search needs its own per-domain data. */
+        search->cr = cache_req_clone(state->parallel, state->cr);
+        if (search->cr == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = cache_req_set_domain(search->cr, search->domain);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        search->subreq = cache_req_search_send(state->parallel, state->ev,
+                                               search->cr,
+                                               state->first_iteration,
+                                               false);
+        if (search->subreq == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        tevent_req_set_callback(search->subreq,
+                                cache_req_search_domains_parallel_done,
+                                search);
+    }
+
+    ret = EAGAIN;
+
+done:
+    if (ret != EAGAIN) {
+        talloc_zfree(state->parallel);
+        state->num_parallel = 0;
+    }
+
+    return ret;
+}
+
+/* Cancel searches that are still running, their result is not needed. */
+static errno_t
+cache_req_search_domains_parallel_finish(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    size_t pending = 0;
+    size_t i;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    for (i = 0; i < state->num_parallel; i++) {
+        if (!state->parallel[i].done) {
+            pending++;
+        }
+    }
+
+    if (pending > 0) {
+        CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                        "Cancelling %zu remaining domain searches\n", pending);
+    }
+
+    talloc_zfree(state->parallel);
+    state->num_parallel = 0;
+
+    /* Keep the request bound to the last processed domain as with
+     * the sequential search. */
+    return cache_req_set_domain(state->cr, state->selected_domain);
+}
+
+static errno_t
+cache_req_search_domains_parallel_process(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_parallel_search *search;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    while (state->parallel_next < state->num_parallel) {
+        search = &state->parallel[state->parallel_next];
+        if (!search->done) {
+            /* Wait for domains that take precedence. */
+            return EAGAIN;
+        }
+        state->parallel_next++;
+
+        state->selected_domain = search->domain;
+
+        /* Remember if any DP request fails, if DP was contacted. */
+        if (cache_req_dp_contacted(state)) {
+            state->dp_success = !search->dp_success ? false : state->dp_success;
+        }
+
+        switch (search->ret) {
+        case EOK:
+            ret = cache_req_create_and_add_result(state, search->cr,
+                                                  search->domain,
+                                                  search->result,
+                                                  search->cr->data->name.lookup,
+                                                  &state->results,
+                                                  &state->num_results);
+            if (ret != EOK) {
+                return ret;
+            }
+
+            if (!state->cr->plugin->search_all_domains) {
+                /* We are not interested in more results. */
+                return EOK;
+            }
+            break;
+        case ERR_ID_OUTSIDE_RANGE:
+        case ENOENT:
+            /* Continue with next domain. */
+            break;
+        default:
+            /* Some serious error has happened. Finish. */
+            return search->ret;
+        }
+    }
+
+    if (state->num_results > 0) {
+        return EOK;
+    }
+
+    return ENOENT;
+}
+
+static void cache_req_search_domains_parallel_done(struct tevent_req *subreq)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_parallel_search *search;
+    struct tevent_req *req;
+    errno_t ret;
+
+    search = tevent_req_callback_data(subreq, struct cache_req_parallel_search);
+    req = search->req;
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    search->ret = cache_req_search_recv(state->parallel, subreq,
+                                        &search->result, &search->dp_success);
+    talloc_zfree(subreq);
+    search->subreq = NULL;
+    search->done = true;
+
+    ret = cache_req_search_domains_parallel_process(req);
+    if (ret == EAGAIN) {
+        return;
+    }
+
+    /* The search structure is released here. */
+    if (cache_req_search_domains_parallel_finish(req) != EOK && ret == EOK) {
+        ret = ERR_INTERNAL;
+    }
+
+    if (ret == ENOENT && cache_req_dp_contacted(state) && state->dp_success) {
+        /* All domains were searched and no result was found. */
+        cache_req_global_ncache_add(state->cr);
+    }
+
+    switch (ret) {
+    case EOK:
+        tevent_req_done(req);
+        break;
+    default:
+        if (cache_req_dp_contacted(state)
+            && ret == ENOENT
+            && !state->dp_success
+            && state->cr->data->propogate_offline_status) {
+            /* Not found and data provider request failed so we were
+             * unable to fetch the data. */
+            ret = ERR_OFFLINE;
+        }
+        tevent_req_error(req, ret);
+        break;
+    }
+}
+
 static errno_t
 cache_req_search_domains_recv(TALLOC_CTX *mem_ctx,
                               struct tevent_req *req,
@@ -1120,14 +1415,15 @@ static void cache_req_process_result(struct tevent_req *subreq);
 
 static void cache_req_done(struct tevent_req *subreq);
 
-struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
-                                  struct tevent_context *ev,
-                                  struct resp_ctx *rctx,
-                                  struct sss_nc_ctx *ncache,
-                                  int midpoint,
-                                  enum cache_req_dom_type req_dom_type,
-                                  const char *domain,
-                                  struct cache_req_data *data)
+static struct tevent_req *
+cache_req_execute_send(TALLOC_CTX *mem_ctx,
+                       struct tevent_context *ev,
+                       struct resp_ctx *rctx,
+                       struct sss_nc_ctx *ncache,
+                       int midpoint,
+                       enum cache_req_dom_type req_dom_type,
+                       const char *domain,
+                       struct cache_req_data *data)
 {
     struct cache_req_state *state;
     struct cache_req_result *result;
@@ -1539,6 +1835,438 @@ static void cache_req_done(struct tevent_req *subreq)
     }
 }
 
+/* Identical lookups that run at the same time are coalesced. The first one
+ * starts the actual lookup and the following ones are attached to it as
+ * waiters, all of them receive a copy of its result. */
+struct cache_req_inflight_ctx {
+    hash_table_t *table;
+    uint64_t num_lookups;
+    uint64_t num_coalesced;
+};
+
+struct cache_req_waiter;
+
+struct cache_req_inflight {
+    struct cache_req_inflight_ctx *ctx;
+    char *key;
+    uint32_t reqid;
+    struct cache_req_waiter *waiters;
+};
+
+struct cache_req_waiter {
+    struct cache_req_waiter *prev;
+    struct cache_req_waiter *next;
+
+    struct cache_req_inflight *inflight;
+    struct tevent_req *req;
+
+    /* false for the request that started the lookup */
+    bool coalesced;
+};
+
+static void cache_req_inflight_done(struct tevent_req *subreq);
+
+static const char *
+cache_req_coalesce_input(struct cache_req_data *data)
+{
+    if (data->requested_domains != NULL) {
+        return NULL;
+    }
+
+    switch (data->type) {
+    case CACHE_REQ_USER_BY_NAME:
+    case CACHE_REQ_USER_BY_UPN:
+    case CACHE_REQ_GROUP_BY_NAME:
+    case CACHE_REQ_INITGROUPS:
+    case CACHE_REQ_INITGROUPS_BY_UPN:
+    case CACHE_REQ_OBJECT_BY_NAME:
+        return data->name.input;
+    case CACHE_REQ_USER_BY_ID:
+    case CACHE_REQ_GROUP_BY_ID:
+    case CACHE_REQ_OBJECT_BY_ID:
+        return "";
+    case CACHE_REQ_OBJECT_BY_SID:
+        return data->sid;
+    default:
+        /* Other lookups are not frequent enough to be worth it. */
+        return NULL;
+    }
+}
+
+static char *
+cache_req_coalesce_key(TALLOC_CTX *mem_ctx,
+                       struct cache_req *cr,
+                       const char *domain)
+{
+    const char *input;
+    char *attrs;
+    char *key;
+    int i;
+
+    input = cache_req_coalesce_input(cr->data);
+    if (input == NULL) {
+        return NULL;
+    }
+
+    attrs = talloc_strdup(mem_ctx, "");
+    for (i = 0; attrs != NULL && cr->data->attrs != NULL
+                && cr->data->attrs[i] != NULL; i++) {
+        attrs = talloc_asprintf_append(attrs, "%s,", cr->data->attrs[i]);
+    }
+    if (attrs == NULL) {
+        return NULL;
+    }
+
+    /* The input is the last part so it may contain any character. */
+    key = talloc_asprintf(mem_ctx, "%d:%d:%d:%d:%d:%d:%p:%"PRIu32":%zu:%s:%s:%s",
+                          cr->data->type, cr->req_dom_type,
+                          cr->cache_behavior,
+                          cr->data->propogate_offline_status,
+                          cr->data->hybrid_lookup, cr->midpoint, cr->ncache,
+                          cr->data->id, domain == NULL ? 0 : strlen(domain),
+                          domain == NULL ? "" : domain, attrs, input);
+    talloc_free(attrs);
+
+    return key;
+}
+
+static struct cache_req_inflight_ctx *
+cache_req_inflight_ctx_get(struct resp_ctx *rctx)
+{
+    struct cache_req_inflight_ctx *ctx;
+    errno_t ret;
+
+    if (rctx->cr_inflight != NULL) {
+        return rctx->cr_inflight;
+    }
+
+    ctx = talloc_zero(rctx, struct cache_req_inflight_ctx);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ret = sss_hash_create(ctx, 0, &ctx->table);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create hash table [%d]: %s\n",
+              ret, sss_strerror(ret));
+        talloc_free(ctx);
+        return NULL;
+    }
+
+    rctx->cr_inflight = ctx;
+
+    return ctx;
+}
+
+static struct cache_req_inflight *
+cache_req_inflight_lookup(struct cache_req_inflight_ctx *ctx,
+                          const char *key)
+{
+    hash_key_t hkey;
+    hash_value_t value;
+    int hret;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(key);
+
+    hret = hash_lookup(ctx->table, &hkey, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct cache_req_inflight);
+}
+
+static void cache_req_inflight_unregister(struct cache_req_inflight *inflight)
+{
+    hash_key_t hkey;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = inflight->key;
+
+    hash_delete(inflight->ctx->table, &hkey);
+}
+
+static int cache_req_inflight_destructor(struct cache_req_inflight *inflight)
+{
+    struct cache_req_waiter *waiter;
+
+    cache_req_inflight_unregister(inflight);
+
+    /* The responder is going away, the waiters will never finish. */
+    DLIST_FOR_EACH(waiter, inflight->waiters) {
+        waiter->inflight = NULL;
+    }
+
+    return 0;
+}
+
+static struct cache_req_inflight *
+cache_req_inflight_create(struct cache_req_inflight_ctx *ctx,
+                          struct tevent_context *ev,
+                          struct resp_ctx *rctx,
+                          struct sss_nc_ctx *ncache,
+                          int midpoint,
+                          enum cache_req_dom_type req_dom_type,
+                          const char *domain,
+                          struct cache_req_data *data,
+                          char *key)
+{
+    struct cache_req_inflight *inflight;
+    struct cache_req_data *data_copy;
+    struct tevent_req *subreq;
+    hash_key_t hkey;
+    hash_value_t value;
+    int hret;
+
+    inflight = talloc_zero(ctx, struct cache_req_inflight);
+    if (inflight == NULL) {
+        return NULL;
+    }
+
+    inflight->ctx = ctx;
+    inflight->key = talloc_steal(inflight, key);
+
+    /* The lookup must not depend on the data of the first caller since it
+     * may go away before the lookup is finished. */
+    data_copy = cache_req_data_copy(inflight, data);
+    if (data_copy == NULL) {
+        goto fail;
+    }
+
+    subreq = cache_req_execute_send(inflight, ev, rctx, ncache, midpoint,
+                                    req_dom_type, domain, data_copy);
+    if (subreq == NULL) {
+        goto fail;
+    }
+    talloc_steal(subreq, data_copy);
+    tevent_req_set_callback(subreq, cache_req_inflight_done, inflight);
+    inflight->reqid = cache_req_get_reqid(subreq);
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = inflight->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = inflight;
+
+    hret = hash_enter(ctx->table, &hkey, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to add in-flight request [%d]: %s\n",
+              hret, hash_error_string(hret));
+        goto fail;
+    }
+    talloc_set_destructor(inflight, cache_req_inflight_destructor);
+
+    return inflight;
+
+fail:
+    talloc_free(inflight);
+    return NULL;
+}
+
+static int cache_req_waiter_destructor(struct cache_req_waiter *waiter)
+{
+    if (waiter->inflight != NULL) {
+        DLIST_REMOVE(waiter->inflight->waiters, waiter);
+    }
+
+    return 0;
+}
+
+static void cache_req_inflight_done(struct tevent_req *subreq)
+{
+    struct cache_req_inflight *inflight;
+    struct cache_req_result **results = NULL;
+    struct cache_req_result *copy;
+    struct cache_req_waiter *waiter;
+    struct cache_req_state *state;
+    struct tevent_req *req;
+    bool coalesced;
+    errno_t ret;
+    errno_t wret;
+    size_t i;
+
+    inflight = tevent_req_callback_data(subreq, struct cache_req_inflight);
+
+    ret = cache_req_recv(inflight, subreq, &results);
+    talloc_zfree(subreq);
+
+    /* New requests must start a new lookup from now on. */
+    talloc_set_destructor(inflight, NULL);
+    cache_req_inflight_unregister(inflight);
+
+    /* A waiter's callback may free other waiters, so always take the
+     * first one from the list. */
+    while ((waiter = inflight->waiters) != NULL) {
+        DLIST_REMOVE(inflight->waiters, waiter);
+        waiter->inflight = NULL;
+
+        req = waiter->req;
+        state = tevent_req_data(req, struct cache_req_state);
+        coalesced = waiter->coalesced;
+        talloc_free(waiter);
+
+        if (ret != EOK) {
+            if (coalesced) {
+                CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                                "Finished: Error %d: %s (coalesced with "
+                                "CR #%u)\n", ret, sss_strerror(ret),
+                                inflight->reqid);
+            }
+            tevent_req_error(req, ret);
+            continue;
+        }
+
+        wret = EOK;
+        for (i = 0; results != NULL && results[i] != NULL; i++) {
+            copy = cache_req_copy_result(state, results[i]);
+            if (copy == NULL) {
+                wret = ENOMEM;
+                break;
+            }
+
+            wret = cache_req_add_result(state, copy, &state->results,
+                                        &state->num_results);
+            if (wret != EOK) {
+                break;
+            }
+        }
+
+        if (wret != EOK) {
+            tevent_req_error(req, wret);
+            continue;
+        }
+
+        if (coalesced) {
+            CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                            "Finished: Success (coalesced with CR #%u)\n",
+                            inflight->reqid);
+        }
+        tevent_req_done(req);
+    }
+
+    talloc_free(inflight);
+}
+
+static errno_t cache_req_coalesce(struct tevent_req *req,
+                                  struct tevent_context *ev,
+                                  struct resp_ctx *rctx,
+                                  struct sss_nc_ctx *ncache,
+                                  int midpoint,
+                                  enum cache_req_dom_type req_dom_type,
+                                  const char *domain,
+                                  struct cache_req_data *data)
+{
+    struct cache_req_inflight_ctx *ctx;
+    struct cache_req_inflight *inflight;
+    struct cache_req_waiter *waiter;
+    struct cache_req_state *state;
+    char *key;
+
+    state = tevent_req_data(req, struct cache_req_state);
+
+    key = cache_req_coalesce_key(state, state->cr, domain);
+    if (key == NULL) {
+        return ENOENT;
+    }
+
+    ctx = cache_req_inflight_ctx_get(rctx);
+    if (ctx == NULL) {
+        talloc_free(key);
+        return ENOENT;
+    }
+
+    waiter = talloc_zero(state, struct cache_req_waiter);
+    if (waiter == NULL) {
+        talloc_free(key);
+        return ENOENT;
+    }
+    waiter->req = req;
+
+    inflight = cache_req_inflight_lookup(ctx, key);
+    if (inflight == NULL) {
+        inflight = cache_req_inflight_create(ctx, ev, rctx, ncache, midpoint,
+                                             req_dom_type, domain, data, key);
+        if (inflight == NULL) {
+            talloc_free(waiter);
+            return ENOENT;
+        }
+        ctx->num_lookups++;
+    } else {
+        talloc_free(key);
+        ctx->num_coalesced++;
+        waiter->coalesced = true;
+        SSS_REQ_TRACE_CID_CR(SSSDBG_TRACE_FUNC, state->cr,
+                             "New request [CID #%lu] '%s'\n",
+                             sss_chain_id_get(), state->cr->reqname);
+        CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                        "Waiting for identical request CR #%u "
+                        "[%"PRIu64" of %"PRIu64" requests coalesced]\n",
+                        inflight->reqid, ctx->num_coalesced,
+                        ctx->num_lookups + ctx->num_coalesced);
+    }
+
+    waiter->inflight = inflight;
+    DLIST_ADD_END(inflight->waiters, waiter, struct cache_req_waiter *);
+    talloc_set_destructor(waiter, cache_req_waiter_destructor);
+
+    return EOK;
+}
+
+struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
+                                  struct tevent_context *ev,
+                                  struct resp_ctx *rctx,
+                                  struct sss_nc_ctx *ncache,
+                                  int midpoint,
+                                  enum cache_req_dom_type req_dom_type,
+                                  const char *domain,
+                                  struct cache_req_data *data)
+{
+    struct cache_req_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    if (cache_req_coalesce_input(data) == NULL) {
+        return cache_req_execute_send(mem_ctx, ev, rctx, ncache, midpoint,
+                                      req_dom_type, domain, data);
+    }
+
+    req = tevent_req_create(mem_ctx, &state, struct cache_req_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->cr = cache_req_create(state, rctx, data,
+                                 ncache, midpoint, req_dom_type);
+    if (state->cr == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+
+    ret = cache_req_coalesce(req, ev, rctx, ncache, midpoint, req_dom_type,
+                             domain, data);
+    if (ret == EOK) {
+        return req;
+    }
+
+    /* The request cannot be coalesced, run it directly. */
+    talloc_free(req);
+
+    return cache_req_execute_send(mem_ctx, ev, rctx, ncache, midpoint,
+                                  req_dom_type, domain, data);
+}
+
+void cache_req_get_coalesce_stats(struct resp_ctx *rctx,
+                                  uint64_t *_num_lookups,
+                                  uint64_t *_num_coalesced)
+{
+    struct cache_req_inflight_ctx *ctx = rctx->cr_inflight;
+
+    *_num_lookups = ctx == NULL ? 0 : ctx->num_lookups;
+    *_num_coalesced = ctx == NULL ? 0 : ctx->num_coalesced;
+}
+
 uint32_t cache_req_get_reqid(struct tevent_req *req)
 {
     const struct cache_req_state *state;
@@ -255,6 +255,34 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
 
 uint32_t cache_req_get_reqid(struct tevent_req *req);
 
+/* Classes of objects kept in the hot object cache */
+#define CACHE_REQ_HOT_USERS      0x01
+#define CACHE_REQ_HOT_GROUPS     0x02
+#define CACHE_REQ_HOT_INITGROUPS 0x04
+#define CACHE_REQ_HOT_ALL        (CACHE_REQ_HOT_USERS \
+                                  | CACHE_REQ_HOT_GROUPS \
+                                  | CACHE_REQ_HOT_INITGROUPS)
+
+/**
+ * Drop objects of the given classes from the hot object cache. This must be
+ * called whenever the cached data may have been changed outside of the
+ * responder, e.g. when the memory caches are invalidated.
+ */
+void cache_req_hot_cache_flush(struct resp_ctx *rctx, uint32_t hot_classes);
+
+void cache_req_hot_cache_get_stats(struct resp_ctx *rctx,
+                                   uint64_t *_hits,
+                                   uint64_t *_misses);
+
+/**
+ * Identical requests that run at the same time share a single lookup.
+ * Return the number of lookups that were started for such requests and the
+ * number of requests that were attached to an already running lookup.
+ */
+void cache_req_get_coalesce_stats(struct resp_ctx *rctx,
+                                  uint64_t *_num_lookups,
+                                  uint64_t *_num_coalesced);
+
 errno_t cache_req_recv(TALLOC_CTX *mem_ctx,
                        struct tevent_req *req,
                        struct cache_req_result ***_results);
@@ -446,6 +446,35 @@ cache_req_data_autofs_entry(TALLOC_CTX *mem_ctx,
     return cache_req_data_create(mem_ctx, type, &input);
 }
 
+struct cache_req_data *
+cache_req_data_copy(TALLOC_CTX *mem_ctx,
+                    struct cache_req_data *data)
+{
+    struct cache_req_data *copy;
+
+    copy = cache_req_data_create(mem_ctx, data->type, data);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    /* The name is already parsed once the request is running. */
+    if (data->name.name != NULL) {
+        copy->name.name = talloc_strdup(copy, data->name.name);
+        if (copy->name.name == NULL) {
+            talloc_free(copy);
+            return NULL;
+        }
+    }
+
+    copy->bypass_cache = data->bypass_cache;
+    copy->bypass_dp = data->bypass_dp;
+    copy->requested_domains = data->requested_domains;
+    copy->propogate_offline_status = data->propogate_offline_status;
+    copy->hybrid_lookup = data->hybrid_lookup;
+
+    return copy;
+}
+
 void
 cache_req_data_set_bypass_cache(struct cache_req_data *data,
                                 bool bypass_cache)
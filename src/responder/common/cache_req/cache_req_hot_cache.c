@@ -0,0 +1,227 @@
+/*
+    SSSD
+
+    Cache request hot object cache
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ldb.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/sss_ptr_cache.h"
+#include "responder/common/responder.h"
+#include "responder/common/cache_req/cache_req_private.h"
+
+/*
+ * Bounded cache of sysdb lookup results kept in the responder process, so
+ * lookups of frequently requested objects do not need to search the cache
+ * and timestamp databases.
+ *
+ * Entries are kept for a short time only since the responder is not
+ * notified about every change done to sysdb by the backend. They are also
+ * dropped when the backend or sss_cache invalidate the memory caches and
+ * whenever the data provider is contacted for the object.
+ */
+
+struct cache_req_hot_entry {
+    uint32_t hot_class;
+    struct ldb_result *result;
+};
+
+static uint32_t cache_req_hot_class(struct cache_req *cr)
+{
+    /* Lookups with a custom set of attributes are not cached. */
+    if (cr->data->attrs != NULL) {
+        return 0;
+    }
+
+    switch (cr->data->type) {
+    case CACHE_REQ_USER_BY_NAME:
+    case CACHE_REQ_USER_BY_ID:
+        return CACHE_REQ_HOT_USERS;
+    case CACHE_REQ_GROUP_BY_NAME:
+    case CACHE_REQ_GROUP_BY_ID:
+        return CACHE_REQ_HOT_GROUPS;
+    case CACHE_REQ_INITGROUPS:
+        return CACHE_REQ_HOT_INITGROUPS;
+    default:
+        return 0;
+    }
+}
+
+static struct sss_ptr_cache *
+cache_req_hot_cache_get(struct resp_ctx *rctx)
+{
+    if (rctx->cr_hot_cache != NULL || rctx->hot_cache_size <= 0) {
+        return rctx->cr_hot_cache;
+    }
+
+    rctx->cr_hot_cache = sss_ptr_cache_create(rctx, rctx->hot_cache_size,
+                                              rctx->hot_cache_timeout);
+
+    return rctx->cr_hot_cache;
+}
+
+static char *
+cache_req_hot_cache_key(TALLOC_CTX *mem_ctx, struct cache_req *cr)
+{
+    return talloc_asprintf(mem_ctx, "%d:%d:%s:%"PRIu32":%s",
+                           cr->data->type, cr->data->hybrid_lookup,
+                           cr->domain->name, cr->data->id,
+                           cr->data->name.lookup == NULL
+                               ? "" : cr->data->name.lookup);
+}
+
+errno_t cache_req_hot_cache_lookup(TALLOC_CTX *mem_ctx,
+                                   struct cache_req *cr,
+                                   struct ldb_result **_result)
+{
+    struct sss_ptr_cache *cache;
+    struct cache_req_hot_entry *entry;
+    struct ldb_result *result;
+    char *key;
+
+    if (cache_req_hot_class(cr) == 0) {
+        return ENOENT;
+    }
+
+    cache = cache_req_hot_cache_get(cr->rctx);
+    if (cache == NULL) {
+        return ENOENT;
+    }
+
+    key = cache_req_hot_cache_key(NULL, cr);
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    entry = sss_ptr_cache_lookup(cache, key, NULL, NULL);
+    talloc_free(key);
+
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    /* The caller may modify the result. */
+    result = cache_req_copy_ldb_result(mem_ctx, entry->result->msgs,
+                                       entry->result->count);
+    if (result == NULL) {
+        return ENOMEM;
+    }
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, cr,
+                    "Returning [%s] from hot object cache\n", cr->debugobj);
+
+    *_result = result;
+    return EOK;
+}
+
+void cache_req_hot_cache_store(struct cache_req *cr,
+                               struct ldb_result *result)
+{
+    struct sss_ptr_cache *cache;
+    struct cache_req_hot_entry *entry;
+    uint32_t hot_class;
+    char *key;
+    errno_t ret;
+
+    hot_class = cache_req_hot_class(cr);
+    if (hot_class == 0) {
+        return;
+    }
+
+    cache = cache_req_hot_cache_get(cr->rctx);
+    if (cache == NULL) {
+        return;
+    }
+
+    key = cache_req_hot_cache_key(NULL, cr);
+    if (key == NULL) {
+        return;
+    }
+
+    entry = talloc_zero(NULL, struct cache_req_hot_entry);
+    if (entry == NULL) {
+        goto done;
+    }
+
+    entry->hot_class = hot_class;
+    entry->result = cache_req_copy_ldb_result(entry, result->msgs,
+                                              result->count);
+    if (entry->result == NULL) {
+        talloc_free(entry);
+        goto done;
+    }
+
+    ret = sss_ptr_cache_add(cache, key, entry);
+    if (ret != EOK) {
+        CACHE_REQ_DEBUG(SSSDBG_MINOR_FAILURE, cr,
+                        "Unable to store [%s] in hot object cache [%d]: %s\n",
+                        cr->debugobj, ret, sss_strerror(ret));
+    }
+
+done:
+    talloc_free(key);
+}
+
+void cache_req_hot_cache_remove(struct cache_req *cr)
+{
+    char *key;
+
+    if (cache_req_hot_class(cr) == 0 || cr->rctx->cr_hot_cache == NULL) {
+        return;
+    }
+
+    key = cache_req_hot_cache_key(NULL, cr);
+    if (key == NULL) {
+        return;
+    }
+
+    sss_ptr_cache_delete(cr->rctx->cr_hot_cache, key);
+    talloc_free(key);
+}
+
+static bool cache_req_hot_entry_match(void *ptr, void *pvt)
+{
+    struct cache_req_hot_entry *entry;
+    uint32_t hot_classes = *(uint32_t *) pvt;
+
+    entry = talloc_get_type(ptr, struct cache_req_hot_entry);
+
+    return (entry->hot_class & hot_classes) != 0;
+}
+
+void cache_req_hot_cache_flush(struct resp_ctx *rctx, uint32_t hot_classes)
+{
+    if (rctx->cr_hot_cache == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Flushing hot object cache [0x%x]\n",
+          hot_classes);
+
+    sss_ptr_cache_flush(rctx->cr_hot_cache, cache_req_hot_entry_match,
+                        &hot_classes);
+}
+
+void cache_req_hot_cache_get_stats(struct resp_ctx *rctx,
+                                   uint64_t *_hits,
+                                   uint64_t *_misses)
+{
+    sss_ptr_cache_get_stats(rctx->cr_hot_cache, _hits, _misses);
+}
@@ -145,6 +145,10 @@ cache_req_steal_data_and_send(TALLOC_CTX *mem_ctx,
                               const char *domain,
                               struct cache_req_data *data);
 
+struct cache_req_data *
+cache_req_data_copy(TALLOC_CTX *mem_ctx,
+                    struct cache_req_data *data);
+
 void cache_req_search_ncache_add_to_domain(struct cache_req *cr,
                                            struct sss_domain_info *domain);
 
@@ -170,6 +174,17 @@ cache_req_create_and_add_result(TALLOC_CTX *mem_ctx,
                                 struct cache_req_result ***_results,
                                 size_t *_num_results);
 
+/* Deep copy of ldb messages. */
+struct ldb_result *
+cache_req_copy_ldb_result(TALLOC_CTX *mem_ctx,
+                          struct ldb_message **msgs,
+                          unsigned int count);
+
+/* Deep copy of cache request result. */
+struct cache_req_result *
+cache_req_copy_result(TALLOC_CTX *mem_ctx,
+                      struct cache_req_result *result);
+
 struct ldb_result *
 cache_req_create_ldb_result_from_msg_list(TALLOC_CTX *mem_ctx,
                                           struct ldb_message **ldb_msgs,
@@ -186,6 +201,16 @@ cache_req_create_result_from_msg(TALLOC_CTX *mem_ctx,
                                  const char *lookup_name,
                                  const char *well_known_domain);
 
+/* Hot object cache, see cache_req_hot_cache.c */
+errno_t cache_req_hot_cache_lookup(TALLOC_CTX *mem_ctx,
+                                   struct cache_req *cr,
+                                   struct ldb_result **_result);
+
+void cache_req_hot_cache_store(struct cache_req *cr,
+                               struct ldb_result *result);
+
+void cache_req_hot_cache_remove(struct cache_req *cr);
+
 struct tevent_req *
 cache_req_sr_overlay_send(TALLOC_CTX *mem_ctx,
                           struct tevent_context *ev,
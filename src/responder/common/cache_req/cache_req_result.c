@@ -272,3 +272,92 @@ done:
 
     return out;
 }
+
+struct ldb_result *
+cache_req_copy_ldb_result(TALLOC_CTX *mem_ctx,
+                          struct ldb_message **msgs,
+                          unsigned int count)
+{
+    struct ldb_result *ldb_result;
+    unsigned int i;
+
+    ldb_result = talloc_zero(mem_ctx, struct ldb_result);
+    if (ldb_result == NULL) {
+        return NULL;
+    }
+
+    ldb_result->msgs = talloc_zero_array(ldb_result, struct ldb_message *,
+                                         count + 1);
+    if (ldb_result->msgs == NULL) {
+        talloc_free(ldb_result);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        ldb_result->msgs[i] = ldb_msg_copy(ldb_result->msgs, msgs[i]);
+        if (ldb_result->msgs[i] == NULL) {
+            talloc_free(ldb_result);
+            return NULL;
+        }
+    }
+    ldb_result->count = count;
+
+    return ldb_result;
+}
+
+struct cache_req_result *
+cache_req_copy_result(TALLOC_CTX *mem_ctx,
+                      struct cache_req_result *result)
+{
+    struct cache_req_result *out = NULL;
+    struct ldb_result *ldb_result;
+    errno_t ret;
+
+    out = talloc_zero(mem_ctx, struct cache_req_result);
+    if (out == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ldb_result = cache_req_copy_ldb_result(out, result->msgs, result->count);
+    if (ldb_result == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    out->domain = result->domain;
+    out->ldb_result = ldb_result;
+    out->count = ldb_result->count;
+    out->msgs = ldb_result->msgs;
+    out->well_known_object = result->well_known_object;
+
+    if (result->lookup_name != NULL) {
+        out->lookup_name = talloc_strdup(out, result->lookup_name);
+        if (out->lookup_name == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    if (result->well_known_domain != NULL) {
+        out->well_known_domain = talloc_strdup(out,
+                                               result->well_known_domain);
+        if (out->well_known_domain == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to copy cache request result "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+
+        talloc_free(out);
+        return NULL;
+    }
+
+    return out;
+}
@@ -196,9 +196,11 @@ cache_req_should_be_in_cache(struct cache_req *cr,
 
 static errno_t cache_req_search_cache(TALLOC_CTX *mem_ctx,
                                       struct cache_req *cr,
+                                      bool refreshed,
                                       struct ldb_result **_result)
 {
     struct ldb_result *result = NULL;
+    bool hot_hit = false;
     errno_t ret;
 
     if (cr->plugin->lookup_fn == NULL) {
@@ -211,7 +213,20 @@ static errno_t cache_req_search_cache(TALLOC_CTX *mem_ctx,
                     "Looking up [%s] in cache\n",
                     cr->debugobj);
 
-    ret = cr->plugin->lookup_fn(mem_ctx, cr, cr->data, cr->domain, &result);
+    /* The object was just updated by the data provider so the copy in
+     * the hot object cache is outdated. */
+    if (refreshed) {
+        cache_req_hot_cache_remove(cr);
+    } else {
+        hot_hit = cache_req_hot_cache_lookup(mem_ctx, cr, &result) == EOK;
+    }
+
+    if (!hot_hit) {
+        ret = cr->plugin->lookup_fn(mem_ctx, cr, cr->data, cr->domain,
+                                    &result);
+    } else {
+        ret = EOK;
+    }
     if (ret == EOK && (result == NULL || result->count == 0)) {
         ret = ENOENT;
     }
@@ -230,6 +245,10 @@ static errno_t cache_req_search_cache(TALLOC_CTX *mem_ctx,
             goto done;
         }
 
+        if (!hot_hit) {
+            cache_req_hot_cache_store(cr, result);
+        }
+
         *_result = result;
         break;
     case ERR_ID_OUTSIDE_RANGE:
@@ -359,7 +378,7 @@ cache_req_search_send(TALLOC_CTX *mem_ctx,
     state->result = NULL;
     status = CACHE_OBJECT_MISSING;
     if (!bypass_cache) {
-        ret = cache_req_search_cache(state, cr, &state->result);
+        ret = cache_req_search_cache(state, cr, false, &state->result);
         if (ret != EOK && ret != ENOENT) {
             goto done;
         }
@@ -430,6 +449,9 @@ static errno_t cache_req_search_dp(struct tevent_req *req,
                         "Performing midpoint cache update of [%s]\n",
                         state->cr->debugobj);
 
+        /* Do not keep serving the copy that is about to be updated. */
+        cache_req_hot_cache_remove(state->cr);
+
         subreq = state->cr->plugin->dp_send_fn(state->rctx, state->cr,
                                                state->cr->data,
                                                state->cr->domain,
@@ -507,7 +529,7 @@ static void cache_req_search_done(struct tevent_req *subreq)
 #endif /* BUILD_FILES_PROVIDER */
 
     /* Get result from cache again. */
-    ret = cache_req_search_cache(state, state->cr, &state->result);
+    ret = cache_req_search_cache(state, state->cr, true, &state->result);
     if (ret != EOK) {
         if (ret == ENOENT) {
             /* Only store entry in negative cache if DP request succeeded
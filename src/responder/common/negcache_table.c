@@ -0,0 +1,544 @@
+/*
+   SSSD
+
+   Negative cache table
+
+   Copyright (C) 2026 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "util/util.h"
+#include "util/dlinklist.h"
+#include "util/crypto/sss_crypto.h"
+#include "shared/murmurhash3.h"
+#include "responder/common/negcache_table.h"
+
+/* The table is split into shards selected by the top bits of the hash, each
+ * shard is an open addressing hash table with linear probing that is grown
+ * on its own, so a resize never has to rehash the whole cache at once. */
+#define NC_SHARD_BITS       4
+#define NC_SHARDS           (1 << NC_SHARD_BITS)
+#define NC_SHARD_MIN_SIZE   64
+
+/* Hierarchical timing wheel with one second ticks. Level 0 has a slot for
+ * each of the next 64 seconds, every further level covers 64 times the
+ * span of the previous one, four levels cover more than half a year. */
+#define NC_WHEEL_BITS       6
+#define NC_WHEEL_SLOTS      (1 << NC_WHEEL_BITS)
+#define NC_WHEEL_MASK       (NC_WHEEL_SLOTS - 1)
+#define NC_WHEEL_LEVELS     4
+#define NC_WHEEL_SPAN       ((time_t)1 << (NC_WHEEL_BITS * NC_WHEEL_LEVELS))
+
+struct nc_entry {
+    struct nc_entry *prev;
+    struct nc_entry *next;
+    /* wheel slot or permanent list the entry is linked to */
+    struct nc_entry **list;
+
+    time_t expire;          /* 0 for permanent entries */
+    uint32_t hash;
+    uint32_t gen;           /* class generation the entry was set in */
+    enum sss_nc_type type;
+    size_t dom_len;
+    size_t name_len;
+    char key[];             /* domain '\0' name '\0' */
+};
+
+struct nc_bucket {
+    uint32_t hash;
+    struct nc_entry *entry; /* NULL for a free bucket */
+};
+
+struct nc_shard {
+    struct nc_bucket *buckets;
+    uint32_t mask;
+    uint32_t count;
+};
+
+struct sss_nc_table {
+    uint32_t seed;
+    struct nc_shard shards[NC_SHARDS];
+
+    /* the next tick that was not processed yet */
+    time_t wheel_time;
+    struct nc_entry *wheel[NC_WHEEL_LEVELS][NC_WHEEL_SLOTS];
+    struct nc_entry *permanent;
+
+    uint32_t gen[SSS_NC_CLASS_SENTINEL];
+    size_t count;
+};
+
+static enum sss_nc_class nc_type_class(enum sss_nc_type type)
+{
+    switch (type) {
+    case SSS_NC_USER:
+    case SSS_NC_UID:
+        return SSS_NC_CLASS_USERS;
+    case SSS_NC_GROUP:
+    case SSS_NC_GID:
+        return SSS_NC_CLASS_GROUPS;
+    default:
+        return SSS_NC_CLASS_OTHER;
+    }
+}
+
+static uint32_t nc_hash(struct sss_nc_table *table,
+                        enum sss_nc_type type,
+                        const char *domain, size_t dom_len,
+                        const char *name, size_t name_len)
+{
+    uint32_t hash;
+
+    hash = murmurhash3(domain, dom_len, table->seed ^ (uint32_t)type);
+    return murmurhash3(name, name_len, hash);
+}
+
+static struct nc_shard *nc_hash_shard(struct sss_nc_table *table,
+                                      uint32_t hash)
+{
+    return &table->shards[hash >> (32 - NC_SHARD_BITS)];
+}
+
+static bool nc_entry_match(struct nc_entry *entry,
+                           enum sss_nc_type type,
+                           const char *domain, size_t dom_len,
+                           const char *name, size_t name_len)
+{
+    return entry->type == type
+        && entry->dom_len == dom_len
+        && entry->name_len == name_len
+        && memcmp(entry->key, domain, dom_len) == 0
+        && memcmp(entry->key + dom_len + 1, name, name_len) == 0;
+}
+
+static errno_t nc_shard_alloc(TALLOC_CTX *mem_ctx,
+                              struct nc_shard *shard,
+                              uint32_t size)
+{
+    shard->buckets = talloc_zero_array(mem_ctx, struct nc_bucket, size);
+    if (shard->buckets == NULL) {
+        return ENOMEM;
+    }
+    shard->mask = size - 1;
+    shard->count = 0;
+
+    return EOK;
+}
+
+static void nc_shard_put(struct nc_shard *shard,
+                         uint32_t hash,
+                         struct nc_entry *entry)
+{
+    uint32_t i;
+
+    for (i = hash & shard->mask;
+         shard->buckets[i].entry != NULL;
+         i = (i + 1) & shard->mask);
+
+    shard->buckets[i].hash = hash;
+    shard->buckets[i].entry = entry;
+    shard->count++;
+}
+
+/* Keeps the load factor at or below one half, so probe sequences stay short
+ * and a lookup always ends in a free bucket. */
+static errno_t nc_shard_reserve(TALLOC_CTX *mem_ctx, struct nc_shard *shard)
+{
+    struct nc_bucket *old = shard->buckets;
+    uint32_t old_size = shard->mask + 1;
+    uint32_t i;
+    errno_t ret;
+
+    if ((shard->count + 1) * 2 <= old_size) {
+        return EOK;
+    }
+
+    ret = nc_shard_alloc(mem_ctx, shard, old_size * 2);
+    if (ret != EOK) {
+        shard->buckets = old;
+        return ret;
+    }
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i].entry != NULL) {
+            nc_shard_put(shard, old[i].hash, old[i].entry);
+        }
+    }
+    talloc_free(old);
+
+    return EOK;
+}
+
+static struct nc_bucket *nc_shard_find(struct nc_shard *shard,
+                                       uint32_t hash,
+                                       enum sss_nc_type type,
+                                       const char *domain, size_t dom_len,
+                                       const char *name, size_t name_len)
+{
+    struct nc_bucket *bucket;
+    uint32_t i;
+
+    for (i = hash & shard->mask; ; i = (i + 1) & shard->mask) {
+        bucket = &shard->buckets[i];
+        if (bucket->entry == NULL) {
+            return NULL;
+        }
+
+        if (bucket->hash == hash
+                && nc_entry_match(bucket->entry, type, domain, dom_len,
+                                  name, name_len)) {
+            return bucket;
+        }
+    }
+}
+
+/* Backward shift deletion, entries that follow the removed one in the same
+ * probe sequence are moved up so no tombstones are needed. */
+static void nc_shard_remove(struct nc_shard *shard, uint32_t i)
+{
+    uint32_t j = i;
+    uint32_t home;
+
+    for (;;) {
+        j = (j + 1) & shard->mask;
+        if (shard->buckets[j].entry == NULL) {
+            break;
+        }
+
+        /* the entry can fill the hole unless its home bucket lies
+         * cyclically in (i, j] */
+        home = shard->buckets[j].hash & shard->mask;
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            shard->buckets[i] = shard->buckets[j];
+            i = j;
+        }
+    }
+
+    shard->buckets[i].hash = 0;
+    shard->buckets[i].entry = NULL;
+    shard->count--;
+}
+
+static void nc_entry_free(struct sss_nc_table *table, struct nc_entry *entry)
+{
+    struct nc_shard *shard = nc_hash_shard(table, entry->hash);
+    uint32_t i;
+
+    for (i = entry->hash & shard->mask;
+         shard->buckets[i].entry != entry;
+         i = (i + 1) & shard->mask);
+
+    nc_shard_remove(shard, i);
+    DLIST_REMOVE(*entry->list, entry);
+    table->count--;
+    talloc_free(entry);
+}
+
+static void nc_list_add(struct nc_entry **list, struct nc_entry *entry)
+{
+    entry->list = list;
+    DLIST_ADD(*list, entry);
+}
+
+static void nc_wheel_add(struct sss_nc_table *table, struct nc_entry *entry)
+{
+    /* the entry is valid during its expire second and dies at the tick
+     * after it */
+    time_t dead = entry->expire + 1;
+    time_t delta;
+    unsigned int level;
+    size_t slot;
+
+    if (dead < table->wheel_time) {
+        dead = table->wheel_time;
+    }
+
+    delta = dead - table->wheel_time;
+    if (delta >= NC_WHEEL_SPAN) {
+        /* The entry will be put back to the wheel when this tick is
+         * processed and it is still valid */
+        dead = table->wheel_time + NC_WHEEL_SPAN - 1;
+        delta = NC_WHEEL_SPAN - 1;
+    }
+
+    for (level = 0; level < NC_WHEEL_LEVELS - 1; level++) {
+        if (delta < ((time_t)1 << (NC_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    slot = (dead >> (NC_WHEEL_BITS * level)) & NC_WHEEL_MASK;
+    nc_list_add(&table->wheel[level][slot], entry);
+}
+
+/* Moves the entries of a higher level slot to the lower levels */
+static void nc_wheel_cascade(struct sss_nc_table *table,
+                             unsigned int level,
+                             size_t slot)
+{
+    struct nc_entry *list = table->wheel[level][slot];
+    struct nc_entry *entry;
+
+    table->wheel[level][slot] = NULL;
+    while ((entry = list) != NULL) {
+        DLIST_REMOVE(list, entry);
+        nc_wheel_add(table, entry);
+    }
+}
+
+static void nc_wheel_tick(struct sss_nc_table *table)
+{
+    time_t tick = table->wheel_time;
+    struct nc_entry **slot;
+    struct nc_entry *entry;
+    unsigned int level;
+    size_t index;
+
+    for (level = 1; level < NC_WHEEL_LEVELS; level++) {
+        if (((tick >> (NC_WHEEL_BITS * (level - 1))) & NC_WHEEL_MASK) != 0) {
+            break;
+        }
+
+        index = (tick >> (NC_WHEEL_BITS * level)) & NC_WHEEL_MASK;
+        nc_wheel_cascade(table, level, index);
+    }
+
+    slot = &table->wheel[0][tick & NC_WHEEL_MASK];
+    table->wheel_time = tick + 1;
+    while ((entry = *slot) != NULL) {
+        if (entry->expire < tick) {
+            nc_entry_free(table, entry);
+        } else {
+            DLIST_REMOVE(*slot, entry);
+            nc_wheel_add(table, entry);
+        }
+    }
+}
+
+/* Only used after a large time jump, sorts all entries into a new wheel
+ * instead of processing each of the skipped ticks. */
+static void nc_wheel_rebuild(struct sss_nc_table *table, time_t now)
+{
+    struct nc_entry *list = NULL;
+    struct nc_entry *entry;
+    unsigned int level;
+    size_t slot;
+
+    for (level = 0; level < NC_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < NC_WHEEL_SLOTS; slot++) {
+            while ((entry = table->wheel[level][slot]) != NULL) {
+                DLIST_REMOVE(table->wheel[level][slot], entry);
+                nc_list_add(&list, entry);
+            }
+        }
+    }
+
+    table->wheel_time = now + 1;
+    while ((entry = list) != NULL) {
+        if (entry->expire < now) {
+            nc_entry_free(table, entry);
+        } else {
+            DLIST_REMOVE(list, entry);
+            nc_wheel_add(table, entry);
+        }
+    }
+}
+
+static void nc_wheel_advance(struct sss_nc_table *table, time_t now)
+{
+    if (now < table->wheel_time) {
+        /* nothing to do, or the clock went backwards; entries are checked
+         * against their expiration time anyway */
+        return;
+    }
+
+    if (now - table->wheel_time >= NC_WHEEL_SLOTS * NC_WHEEL_SLOTS) {
+        nc_wheel_rebuild(table, now);
+        return;
+    }
+
+    while (table->wheel_time <= now) {
+        nc_wheel_tick(table);
+    }
+}
+
+errno_t sss_nc_table_init(TALLOC_CTX *mem_ctx, time_t now,
+                          struct sss_nc_table **_table)
+{
+    struct sss_nc_table *table;
+    errno_t ret;
+    int i;
+
+    table = talloc_zero(mem_ctx, struct sss_nc_table);
+    if (table == NULL) {
+        return ENOMEM;
+    }
+
+    /* the keys are chosen by clients, a random seed avoids collision
+     * attacks */
+    ret = sss_generate_csprng_buffer((uint8_t *)&table->seed,
+                                     sizeof(table->seed));
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to generate random seed.\n");
+        goto done;
+    }
+
+    for (i = 0; i < NC_SHARDS; i++) {
+        ret = nc_shard_alloc(table, &table->shards[i], NC_SHARD_MIN_SIZE);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    table->wheel_time = now + 1;
+    *_table = table;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(table);
+    }
+
+    return ret;
+}
+
+errno_t sss_nc_table_check(struct sss_nc_table *table,
+                           enum sss_nc_type type,
+                           const char *domain,
+                           const char *name,
+                           time_t now)
+{
+    struct nc_bucket *bucket;
+    struct nc_entry *entry;
+    size_t dom_len;
+    size_t name_len;
+    uint32_t hash;
+
+    if (domain == NULL) {
+        domain = "";
+    }
+    dom_len = strlen(domain);
+    name_len = strlen(name);
+
+    nc_wheel_advance(table, now);
+
+    hash = nc_hash(table, type, domain, dom_len, name, name_len);
+    bucket = nc_shard_find(nc_hash_shard(table, hash), hash, type,
+                           domain, dom_len, name, name_len);
+    if (bucket == NULL) {
+        return ENOENT;
+    }
+
+    entry = bucket->entry;
+    if (entry->expire == 0) {
+        /* permanent entries survive class resets */
+        return EEXIST;
+    }
+
+    if (entry->expire < now
+            || entry->gen != table->gen[nc_type_class(type)]) {
+        nc_entry_free(table, entry);
+        return ENOENT;
+    }
+
+    return EEXIST;
+}
+
+errno_t sss_nc_table_set(struct sss_nc_table *table,
+                         enum sss_nc_type type,
+                         const char *domain,
+                         const char *name,
+                         time_t expire,
+                         time_t now)
+{
+    struct nc_shard *shard;
+    struct nc_bucket *bucket;
+    struct nc_entry *entry;
+    size_t dom_len;
+    size_t name_len;
+    uint32_t hash;
+    errno_t ret;
+
+    if (domain == NULL) {
+        domain = "";
+    }
+    dom_len = strlen(domain);
+    name_len = strlen(name);
+
+    nc_wheel_advance(table, now);
+
+    hash = nc_hash(table, type, domain, dom_len, name, name_len);
+    shard = nc_hash_shard(table, hash);
+    bucket = nc_shard_find(shard, hash, type, domain, dom_len,
+                           name, name_len);
+    if (bucket != NULL) {
+        entry = bucket->entry;
+        DLIST_REMOVE(*entry->list, entry);
+    } else {
+        ret = nc_shard_reserve(table, shard);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        entry = talloc_size(table,
+                            sizeof(struct nc_entry) + dom_len + name_len + 2);
+        if (entry == NULL) {
+            return ENOMEM;
+        }
+        talloc_set_name_const(entry, "struct nc_entry");
+
+        entry->prev = NULL;
+        entry->next = NULL;
+        entry->hash = hash;
+        entry->type = type;
+        entry->dom_len = dom_len;
+        entry->name_len = name_len;
+        memcpy(entry->key, domain, dom_len + 1);
+        memcpy(entry->key + dom_len + 1, name, name_len + 1);
+
+        nc_shard_put(shard, hash, entry);
+        table->count++;
+    }
+
+    entry->expire = expire;
+    entry->gen = table->gen[nc_type_class(type)];
+    if (expire == 0) {
+        nc_list_add(&table->permanent, entry);
+    } else {
+        nc_wheel_add(table, entry);
+    }
+
+    return EOK;
+}
+
+void sss_nc_table_reset_class(struct sss_nc_table *table,
+                              enum sss_nc_class nc_class)
+{
+    table->gen[nc_class]++;
+}
+
+void sss_nc_table_reset_permanent(struct sss_nc_table *table)
+{
+    while (table->permanent != NULL) {
+        nc_entry_free(table, table->permanent);
+    }
+}
+
+size_t sss_nc_table_count(struct sss_nc_table *table)
+{
+    return table->count;
+}
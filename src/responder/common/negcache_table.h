@@ -0,0 +1,119 @@
+/*
+   SSSD
+
+   Negative cache table
+
+   Copyright (C) 2026 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _NEGCACHE_TABLE_H_
+#define _NEGCACHE_TABLE_H_
+
+#include <time.h>
+#include <talloc.h>
+
+#include "util/util_errors.h"
+
+/* Kind of the negatively cached object, part of the key so the same name
+ * can be cached e.g. as a missing user and as a missing group. */
+enum sss_nc_type {
+    SSS_NC_USER,
+    SSS_NC_GROUP,
+    SSS_NC_NETGROUP,
+    SSS_NC_SERVICE,
+    SSS_NC_UID,
+    SSS_NC_GID,
+    SSS_NC_SID,
+    SSS_NC_CERT,
+    SSS_NC_LOCATE_UID,
+    SSS_NC_LOCATE_GID,
+    SSS_NC_LOCATE_SID,
+    SSS_NC_LOCATE_TYPE,
+
+    SSS_NC_TYPE_SENTINEL
+};
+
+/* Types that can be flushed together with sss_nc_table_reset_class() */
+enum sss_nc_class {
+    SSS_NC_CLASS_USERS,     /* SSS_NC_USER, SSS_NC_UID */
+    SSS_NC_CLASS_GROUPS,    /* SSS_NC_GROUP, SSS_NC_GID */
+    SSS_NC_CLASS_OTHER,
+
+    SSS_NC_CLASS_SENTINEL
+};
+
+struct sss_nc_table;
+
+/*
+ * In-memory table of negative cache entries.
+ *
+ * Entries are keyed by (type, domain, name) and are looked up with a single
+ * hash computation and without any memory allocation. Entries expire at the
+ * end of the second given by their expiration time, they are freed by a
+ * timing wheel that is advanced with the 'now' argument of every call, so
+ * expiration does not require walking the whole table.
+ *
+ * @param mem_ctx   Talloc context of the table.
+ * @param now       Current time.
+ * @param _table    The new table.
+ *
+ * @return EOK on success, errno on failure.
+ */
+errno_t sss_nc_table_init(TALLOC_CTX *mem_ctx, time_t now,
+                          struct sss_nc_table **_table);
+
+/*
+ * Check if an entry is negatively cached.
+ *
+ * @param domain    Domain name, NULL for entries that are not bound to
+ *                  a domain.
+ *
+ * @return EEXIST if the entry is present and valid, ENOENT otherwise.
+ */
+errno_t sss_nc_table_check(struct sss_nc_table *table,
+                           enum sss_nc_type type,
+                           const char *domain,
+                           const char *name,
+                           time_t now);
+
+/*
+ * Add or replace an entry.
+ *
+ * @param expire    Last second the entry is valid, 0 for an entry that
+ *                  is kept until sss_nc_table_reset_permanent() is called.
+ *
+ * @return EOK on success, errno on failure.
+ */
+errno_t sss_nc_table_set(struct sss_nc_table *table,
+                         enum sss_nc_type type,
+                         const char *domain,
+                         const char *name,
+                         time_t expire,
+                         time_t now);
+
+/* Invalidates all non-permanent entries of the class in constant time,
+ * the memory is released as the entries are looked up or expire. */
+void sss_nc_table_reset_class(struct sss_nc_table *table,
+                              enum sss_nc_class nc_class);
+
+/* Removes all permanent entries */
+void sss_nc_table_reset_permanent(struct sss_nc_table *table);
+
+/* Number of entries held by the table including the invalidated ones that
+ * were not released yet */
+size_t sss_nc_table_count(struct sss_nc_table *table);
+
+#endif /* _NEGCACHE_TABLE_H_ */
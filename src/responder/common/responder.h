@@ -70,6 +70,9 @@ struct cli_protocol {
     struct cli_protocol_version *cli_protocol_version;
 };
 
+struct cache_req_inflight_ctx;
+struct sss_ptr_cache;
+
 struct resp_ctx {
     struct tevent_context *ev;
     struct tevent_fd *lfde;
@@ -118,11 +121,20 @@ struct resp_ctx {
     uint32_t cache_req_num;
     uint32_t client_id_num;
 
+    /* cache_req lookups that identical requests can attach to */
+    struct cache_req_inflight_ctx *cr_inflight;
+
+    /* recently used cache_req results */
+    struct sss_ptr_cache *cr_hot_cache;
+
     void *pvt_ctx;
 
     bool shutting_down;
     bool socket_activated;
     bool cache_first;
+    bool parallel_domain_search;
+    int hot_cache_size;
+    int hot_cache_timeout;
     bool enumeration_warn_logged;
 };
 
@@ -1119,6 +1119,39 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
               ret, sss_strerror(ret));
     }
 
+    ret = confdb_get_bool(rctx->cdb, rctx->confdb_service_path,
+                          CONFDB_RESPONDER_PARALLEL_DOMAIN_SEARCH,
+                          false, &rctx->parallel_domain_search);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get \"%s\", domains will be searched one by one "
+              "[%d]: %s.\n", CONFDB_RESPONDER_PARALLEL_DOMAIN_SEARCH,
+              ret, sss_strerror(ret));
+    }
+
+    ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
+                         CONFDB_RESPONDER_HOT_CACHE_SIZE,
+                         CONFDB_RESPONDER_HOT_CACHE_SIZE_DEFAULT,
+                         &rctx->hot_cache_size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get \"%s\", hot object cache will not be used "
+              "[%d]: %s.\n", CONFDB_RESPONDER_HOT_CACHE_SIZE,
+              ret, sss_strerror(ret));
+        rctx->hot_cache_size = 0;
+    }
+
+    ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
+                         CONFDB_RESPONDER_HOT_CACHE_TIMEOUT,
+                         CONFDB_RESPONDER_HOT_CACHE_TIMEOUT_DEFAULT,
+                         &rctx->hot_cache_timeout);
+    if (ret != EOK || rctx->hot_cache_timeout < 0) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get \"%s\", hot object cache will not be used.\n",
+              CONFDB_RESPONDER_HOT_CACHE_TIMEOUT);
+        rctx->hot_cache_size = 0;
+    }
+
     ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
                          CONFDB_RESPONDER_GET_DOMAINS_TIMEOUT,
                          GET_DOMAINS_DEFAULT_TIMEOUT, &rctx->domains_timeout);
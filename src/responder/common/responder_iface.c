@@ -19,6 +19,7 @@
 #include "sss_iface/sss_iface_async.h"
 #include "responder/common/negcache.h"
 #include "responder/common/responder.h"
+#include "responder/common/cache_req/cache_req.h"
 
 #ifdef BUILD_FILES_PROVIDER
 static void set_domain_state_by_name(struct resp_ctx *rctx,
@@ -95,6 +96,50 @@ sss_resp_reset_ncache_groups(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+static errno_t
+sss_resp_hot_cache_invalidate_users(TALLOC_CTX *mem_ctx,
+                                    struct sbus_request *sbus_req,
+                                    struct resp_ctx *rctx)
+{
+    cache_req_hot_cache_flush(rctx, CACHE_REQ_HOT_USERS
+                                    | CACHE_REQ_HOT_INITGROUPS);
+
+    return EOK;
+}
+
+static errno_t
+sss_resp_hot_cache_invalidate_groups(TALLOC_CTX *mem_ctx,
+                                     struct sbus_request *sbus_req,
+                                     struct resp_ctx *rctx)
+{
+    cache_req_hot_cache_flush(rctx, CACHE_REQ_HOT_GROUPS
+                                    | CACHE_REQ_HOT_INITGROUPS);
+
+    return EOK;
+}
+
+static errno_t
+sss_resp_hot_cache_invalidate_initgroups(TALLOC_CTX *mem_ctx,
+                                         struct sbus_request *sbus_req,
+                                         struct resp_ctx *rctx)
+{
+    cache_req_hot_cache_flush(rctx, CACHE_REQ_HOT_INITGROUPS);
+
+    return EOK;
+}
+
+static errno_t
+sss_resp_hot_cache_invalidate_group_by_id(TALLOC_CTX *mem_ctx,
+                                          struct sbus_request *sbus_req,
+                                          struct resp_ctx *rctx,
+                                          uint32_t gid)
+{
+    cache_req_hot_cache_flush(rctx, CACHE_REQ_HOT_GROUPS
+                                    | CACHE_REQ_HOT_INITGROUPS);
+
+    return EOK;
+}
+
 errno_t
 sss_resp_register_sbus_iface(struct sbus_connection *conn,
                              struct resp_ctx *rctx)
@@ -111,7 +156,15 @@ sss_resp_register_sbus_iface(struct sbus_connection *conn,
         SBUS_LISTEN_SYNC(sssd_Responder_NegativeCache, ResetUsers,
                          SSS_BUS_PATH, sss_resp_reset_ncache_users, rctx),
         SBUS_LISTEN_SYNC(sssd_Responder_NegativeCache, ResetGroups,
-                         SSS_BUS_PATH, sss_resp_reset_ncache_groups, rctx)
+                         SSS_BUS_PATH, sss_resp_reset_ncache_groups, rctx),
+        SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateAllUsers,
+                         SSS_BUS_PATH, sss_resp_hot_cache_invalidate_users, rctx),
+        SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateAllGroups,
+                         SSS_BUS_PATH, sss_resp_hot_cache_invalidate_groups, rctx),
+        SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateAllInitgroups,
+                         SSS_BUS_PATH, sss_resp_hot_cache_invalidate_initgroups, rctx),
+        SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateGroupById,
+                         SSS_BUS_PATH, sss_resp_hot_cache_invalidate_group_by_id, rctx)
     );
 
     ret = sbus_router_listen_map(conn, listeners);
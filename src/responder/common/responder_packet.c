@@ -21,6 +21,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <string.h>
 #include <errno.h>
 #include <talloc.h>
@@ -33,6 +34,9 @@
 
 #define SSSSRV_PACKET_MEM_SIZE 512
 
+/* Maximum number of buffers passed to a single sendmsg() call */
+#define SSSSRV_PACKET_MAX_IOV 16
+
 struct sss_packet {
     size_t memsize;
 
@@ -49,6 +53,13 @@ struct sss_packet {
 
     /* io pointer */
     size_t iop;
+
+    /* Buffers sent after the packet body without being copied into it,
+     * see sss_packet_append_buffer(). They are included in the packet
+     * length. */
+    struct iovec *segments;
+    size_t num_segments;
+    size_t segments_len;
 };
 
 /* Offsets to data in sss_packet's buffer */
@@ -95,6 +106,9 @@ int sss_packet_new(TALLOC_CTX *mem_ctx, size_t size,
     sss_packet_set_cmd(packet, cmd);
 
     packet->iop = 0;
+    packet->segments = NULL;
+    packet->num_segments = 0;
+    packet->segments_len = 0;
 
     *rpacket = packet;
 
@@ -112,6 +126,11 @@ int sss_packet_grow(struct sss_packet *packet, size_t size)
         return EOK;
     }
 
+    /* The body must be complete before buffers are appended. */
+    if (packet->num_segments != 0) {
+        return EINVAL;
+    }
+
     totlen = packet->memsize;
     packet_len = sss_packet_get_len(packet);
 
@@ -155,6 +174,7 @@ int sss_packet_shrink(struct sss_packet *packet, size_t size)
     size_t oldlen = sss_packet_get_len(packet);
 
     if (size > oldlen) return EINVAL;
+    if (packet->num_segments != 0) return EINVAL;
 
     newlen = oldlen - size;
     if (newlen < SSS_NSS_HEADER_SIZE) return EINVAL;
@@ -163,6 +183,19 @@ int sss_packet_shrink(struct sss_packet *packet, size_t size)
     return 0;
 }
 
+static void sss_packet_free_segments(struct sss_packet *packet)
+{
+    size_t i;
+
+    for (i = 0; i < packet->num_segments; i++) {
+        talloc_free(packet->segments[i].iov_base);
+    }
+
+    talloc_zfree(packet->segments);
+    packet->num_segments = 0;
+    packet->segments_len = 0;
+}
+
 int sss_packet_set_size(struct sss_packet *packet, size_t size)
 {
     size_t newlen;
@@ -172,6 +205,9 @@ int sss_packet_set_size(struct sss_packet *packet, size_t size)
     /* make sure we do not overflow */
     if (packet->memsize < newlen) return EINVAL;
 
+    /* Appended buffers are dropped, only the body can be resized. */
+    sss_packet_free_segments(packet);
+
     sss_packet_set_len(packet, newlen);
 
     return 0;
@@ -229,6 +265,11 @@ int sss_packet_recv(struct sss_packet *packet, int fd)
             max_recv_size = SSS_CERT_PACKET_MAX_RECV_SIZE;
             break;
 
+        case SSS_NSS_GETPWUID_BATCH:
+        case SSS_NSS_GETGRGID_BATCH:
+            max_recv_size = SSS_BATCH_PACKET_MAX_RECV_SIZE;
+            break;
+
         case SSS_GSSAPI_SEC_CTX:
         case SSS_PAC_ADD_PAC_USER:
             max_recv_size = SSS_GSSAPI_PACKET_MAX_RECV_SIZE;
@@ -261,8 +302,80 @@ int sss_packet_recv(struct sss_packet *packet, int fd)
     return EOK;
 }
 
+errno_t sss_packet_append_buffer(struct sss_packet *packet,
+                                 uint8_t *buf,
+                                 size_t len)
+{
+    struct iovec *segments;
+    uint32_t packet_len;
+
+    if (len == 0) {
+        return EOK;
+    }
+
+    packet_len = sss_packet_get_len(packet);
+    if (len > UINT32_MAX - packet_len) {
+        return EINVAL;
+    }
+
+    segments = talloc_realloc(packet, packet->segments, struct iovec,
+                              packet->num_segments + 1);
+    if (segments == NULL) {
+        return ENOMEM;
+    }
+    packet->segments = segments;
+
+    segments[packet->num_segments].iov_base = talloc_steal(packet, buf);
+    segments[packet->num_segments].iov_len = len;
+    packet->num_segments++;
+    packet->segments_len += len;
+
+    sss_packet_set_len(packet, packet_len + len);
+
+    return EOK;
+}
+
+/* Fills iov with the data that was not sent yet */
+static int sss_packet_get_iov(struct sss_packet *packet,
+                              struct iovec *iov,
+                              int max_iov)
+{
+    size_t linear_len;
+    size_t offset;
+    size_t i;
+    int n = 0;
+
+    linear_len = sss_packet_get_len(packet) - packet->segments_len;
+    offset = packet->iop;
+
+    if (offset < linear_len) {
+        iov[n].iov_base = packet->buffer + offset;
+        iov[n].iov_len = linear_len - offset;
+        n++;
+        offset = 0;
+    } else {
+        offset -= linear_len;
+    }
+
+    for (i = 0; i < packet->num_segments && n < max_iov; i++) {
+        if (offset >= packet->segments[i].iov_len) {
+            offset -= packet->segments[i].iov_len;
+            continue;
+        }
+
+        iov[n].iov_base = (uint8_t *)packet->segments[i].iov_base + offset;
+        iov[n].iov_len = packet->segments[i].iov_len - offset;
+        n++;
+        offset = 0;
+    }
+
+    return n;
+}
+
 int sss_packet_send(struct sss_packet *packet, int fd)
 {
+    struct iovec iov[SSSSRV_PACKET_MAX_IOV];
+    struct msghdr msg = { 0 };
     size_t rb;
     size_t len;
     void *buf;
@@ -272,11 +385,19 @@ int sss_packet_send(struct sss_packet *packet, int fd)
         return EINVAL;
     }
 
-    buf = packet->buffer + packet->iop;
-    len = sss_packet_get_len(packet) - packet->iop;
-
     errno = 0;
-    rb = send(fd, buf, len, 0);
+    if (packet->num_segments == 0) {
+        buf = packet->buffer + packet->iop;
+        len = sss_packet_get_len(packet) - packet->iop;
+
+        rb = send(fd, buf, len, 0);
+    } else {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = sss_packet_get_iov(packet, iov,
+                                            SSSSRV_PACKET_MAX_IOV);
+
+        rb = sendmsg(fd, &msg, 0);
+    }
 
     if (rb == -1) {
         if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
@@ -319,7 +440,8 @@ uint32_t sss_packet_get_status(struct sss_packet *packet)
 void sss_packet_get_body(struct sss_packet *packet, uint8_t **body, size_t *blen)
 {
     *body = packet->buffer + SSS_PACKET_BODY_OFFSET;
-    *blen = sss_packet_get_len(packet) - SSS_NSS_HEADER_SIZE;
+    *blen = sss_packet_get_len(packet) - packet->segments_len
+                - SSS_NSS_HEADER_SIZE;
 }
 
 errno_t sss_packet_set_body(struct sss_packet *packet,
@@ -27,6 +27,8 @@
 #define SSS_PACKET_MAX_RECV_SIZE 1024
 #define SSS_CERT_PACKET_MAX_RECV_SIZE ( 10 * SSS_PACKET_MAX_RECV_SIZE )
 #define SSS_GSSAPI_PACKET_MAX_RECV_SIZE ( 128 * 1024 )
+#define SSS_BATCH_PACKET_MAX_RECV_SIZE \
+    ( SSS_NSS_HEADER_SIZE + (2 + SSS_NSS_BATCH_MAX_IDS) * sizeof(uint32_t) )
 
 struct sss_packet;
 
@@ -43,6 +45,14 @@ uint32_t sss_packet_get_status(struct sss_packet *packet);
 void sss_packet_get_body(struct sss_packet *packet, uint8_t **body, size_t *blen);
 void sss_packet_set_error(struct sss_packet *packet, int error);
 
+/* Append a buffer to the packet after its body. The buffer is stolen by
+ * the packet and sent with sendmsg() without being copied into the packet,
+ * it is not part of the body returned by sss_packet_get_body(). The packet
+ * can not be grown or shrunk after a buffer was appended. */
+errno_t sss_packet_append_buffer(struct sss_packet *packet,
+                                 uint8_t *buf,
+                                 size_t len);
+
 /* Grow packet and set its body. */
 errno_t sss_packet_set_body(struct sss_packet *packet,
                             uint8_t *body,
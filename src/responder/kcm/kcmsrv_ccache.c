@@ -450,6 +450,39 @@ struct sss_iobuf *kcm_cred_get_creds(struct kcm_cred *crd)
     return crd ? crd->cred_blob : NULL;
 }
 
+time_t kcm_cred_get_endtime(struct kcm_cred *crd)
+{
+#ifdef HAVE_KRB5_UNMARSHAL_CREDENTIALS
+    krb5_error_code kerr;
+    krb5_context kctx;
+    krb5_creds *kcrd;
+    time_t endtime;
+
+    kerr = krb5_init_context(&kctx);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to init krb5 context\n");
+        return 0;
+    }
+
+    kcrd = kcm_cred_to_krb5(kctx, crd);
+    if (kcrd == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Failed to convert kcm cred to krb5\n");
+        krb5_free_context(kctx);
+        return 0;
+    }
+
+    endtime = (time_t) kcrd->times.endtime;
+
+    sss_erase_krb5_creds_securely(kcrd);
+    krb5_free_creds(kctx, kcrd);
+    krb5_free_context(kctx);
+
+    return endtime;
+#else
+    return 0;
+#endif
+}
+
 errno_t kcm_ccdb_renew_tgts(TALLOC_CTX *mem_ctx,
                             struct krb5_ctx *krb5_ctx,
                             struct tevent_context *ev,
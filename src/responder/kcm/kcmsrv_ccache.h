@@ -124,6 +124,9 @@ errno_t kcm_cred_get_uuid(struct kcm_cred *crd, uuid_t uuid);
  * them, just as the clients sends the credentials.
  */
 struct sss_iobuf *kcm_cred_get_creds(struct kcm_cred *crd);
+
+/* Return the end time of the credential or 0 if it is not known */
+time_t kcm_cred_get_endtime(struct kcm_cred *crd);
 errno_t kcm_cc_store_cred_blob(struct kcm_ccache *cc,
                                struct sss_iobuf *cred_blob);
  /*
@@ -374,6 +377,39 @@ errno_t kcm_ccache_to_sec_input_binary(TALLOC_CTX *mem_ctx,
                                        struct kcm_ccache *cc,
                                        struct sss_iobuf **_payload);
 
+/*
+ * Convert the header of a kcm_ccache whose credentials are stored as
+ * separate records to its binary representation. The header does not
+ * contain any credentials, only the expiration time of the ccache.
+ */
+errno_t kcm_ccache_header_to_sec_input_binary(TALLOC_CTX *mem_ctx,
+                                              struct kcm_ccache *cc,
+                                              time_t expiration,
+                                              struct sss_iobuf **_payload);
+
+/*
+ * Tell whether the binary ccache in sec_value keeps its credentials in
+ * separate records and if so, return the expiration time from its header.
+ */
+errno_t sec_value_ccache_layout_binary(struct sss_iobuf *sec_value,
+                                       bool *_separate_creds,
+                                       time_t *_expiration);
+
+/*
+ * Convert a single credential to and from its binary representation.
+ * The sequence number orders the credentials of a ccache, a higher number
+ * means a newer credential.
+ */
+errno_t kcm_cred_to_sec_input_binary(TALLOC_CTX *mem_ctx,
+                                     struct kcm_cred *crd,
+                                     uint32_t seq,
+                                     struct sss_iobuf **_payload);
+
+errno_t sec_value_to_kcm_cred_binary(TALLOC_CTX *mem_ctx,
+                                     struct sss_iobuf *sec_value,
+                                     uint32_t *_seq,
+                                     struct kcm_cred **_crd);
+
 errno_t bin_to_krb_data(TALLOC_CTX *mem_ctx,
                         struct sss_iobuf *buf,
                         krb5_data *out);
@@ -28,6 +28,10 @@
 #include "util/crypto/sss_crypto.h"
 #include "responder/kcm/kcmsrv_ccache_pvt.h"
 
+/* Follows the (empty) list of credentials in a ccache header whose
+ * credentials are stored as separate records. */
+#define KCM_BINARY_SEPARATE_CREDS 0x4b434d31
+
 static errno_t krb_data_to_bin(krb5_data *data, struct sss_iobuf *buf)
 {
     return sss_iobuf_write_varlen(buf, (uint8_t *)data->data, data->length);
@@ -72,6 +76,18 @@ static errno_t princ_to_bin(krb5_principal princ, struct sss_iobuf *buf)
     return EOK;
 }
 
+static errno_t cred_to_bin(struct kcm_cred *crd, struct sss_iobuf *buf)
+{
+    errno_t ret;
+
+    ret = sss_iobuf_write_len(buf, (uint8_t *)crd->uuid, sizeof(uuid_t));
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return sss_iobuf_write_iobuf(buf, crd->cred_blob);
+}
+
 static errno_t creds_to_bin(struct kcm_cred *creds, struct sss_iobuf *buf)
 {
     struct kcm_cred *crd;
@@ -88,12 +104,7 @@ static errno_t creds_to_bin(struct kcm_cred *creds, struct sss_iobuf *buf)
     }
 
     DLIST_FOR_EACH(crd, creds) {
-        ret = sss_iobuf_write_len(buf, (uint8_t *)crd->uuid, sizeof(uuid_t));
-        if (ret != EOK) {
-            return ret;
-        }
-
-        ret = sss_iobuf_write_iobuf(buf, crd->cred_blob);
+        ret = cred_to_bin(crd, buf);
         if (ret != EOK) {
             return ret;
         }
@@ -141,6 +152,88 @@ done:
     return ret;
 }
 
+errno_t kcm_ccache_header_to_sec_input_binary(TALLOC_CTX *mem_ctx,
+                                              struct kcm_ccache *cc,
+                                              time_t expiration,
+                                              struct sss_iobuf **_payload)
+{
+    struct sss_iobuf *buf;
+    errno_t ret;
+
+    buf = sss_iobuf_init_empty(mem_ctx, sizeof(krb5_principal_data), 0, true);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_iobuf_write_int32(buf, cc->kdc_offset);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = princ_to_bin(cc->client, buf);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* No inline credentials, readers of the whole-ccache format see
+     * an empty ccache. */
+    ret = sss_iobuf_write_uint32(buf, 0);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, KCM_BINARY_SEPARATE_CREDS);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, (uint32_t)expiration);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    *_payload = buf;
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(buf);
+    }
+
+    return ret;
+}
+
+errno_t kcm_cred_to_sec_input_binary(TALLOC_CTX *mem_ctx,
+                                     struct kcm_cred *crd,
+                                     uint32_t seq,
+                                     struct sss_iobuf **_payload)
+{
+    struct sss_iobuf *buf;
+    errno_t ret;
+
+    buf = sss_iobuf_init_empty(mem_ctx,
+                               sizeof(uint32_t) + sizeof(uuid_t), 0, true);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, seq);
+    if (ret != EOK) {
+        talloc_free(buf);
+        return ret;
+    }
+
+    ret = cred_to_bin(crd, buf);
+    if (ret != EOK) {
+        talloc_free(buf);
+        return ret;
+    }
+
+    *_payload = buf;
+    return EOK;
+}
+
 errno_t bin_to_krb_data(TALLOC_CTX *mem_ctx,
                         struct sss_iobuf *buf,
                         krb5_data *out)
@@ -218,15 +311,42 @@ static errno_t bin_to_princ(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+static errno_t bin_to_cred(TALLOC_CTX *mem_ctx,
+                           struct sss_iobuf *buf,
+                           struct kcm_cred **_crd)
+{
+    struct kcm_cred *crd;
+    struct sss_iobuf *cred_blob;
+    uuid_t uuid;
+    errno_t ret;
+
+    ret = sss_iobuf_read_len(buf, sizeof(uuid_t), (uint8_t*)uuid);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sss_iobuf_read_iobuf(NULL, buf, &cred_blob);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    crd = kcm_cred_new(mem_ctx, uuid, cred_blob);
+    if (crd == NULL) {
+        talloc_free(cred_blob);
+        return ENOMEM;
+    }
+
+    *_crd = crd;
+    return EOK;
+}
+
 static errno_t bin_to_creds(TALLOC_CTX *mem_ctx,
                             struct sss_iobuf *buf,
                             struct kcm_cred **_creds)
 {
     struct kcm_cred *creds = NULL;
     struct kcm_cred *crd;
-    struct sss_iobuf *cred_blob;
     uint32_t count;
-    uuid_t uuid;
     errno_t ret;
 
     ret = sss_iobuf_read_uint32(buf, &count);
@@ -235,22 +355,11 @@ static errno_t bin_to_creds(TALLOC_CTX *mem_ctx,
     }
 
     for (uint32_t i = 0; i < count; i++) {
-        ret = sss_iobuf_read_len(buf, sizeof(uuid_t), (uint8_t*)uuid);
-        if (ret != EOK) {
-            return ret;
-        }
-
-        ret = sss_iobuf_read_iobuf(NULL, buf, &cred_blob);
+        ret = bin_to_cred(mem_ctx, buf, &crd);
         if (ret != EOK) {
             return ret;
         }
 
-        crd = kcm_cred_new(mem_ctx, uuid, cred_blob);
-        if (crd == NULL) {
-            talloc_free(cred_blob);
-            return ENOMEM;
-        }
-
         DLIST_ADD(creds, crd);
     }
 
@@ -306,3 +415,84 @@ done:
 
     return ret;
 }
+
+errno_t sec_value_ccache_layout_binary(struct sss_iobuf *sec_value,
+                                       bool *_separate_creds,
+                                       time_t *_expiration)
+{
+    TALLOC_CTX *tmp_ctx;
+    krb5_principal princ;
+    struct kcm_cred *creds;
+    int32_t kdc_offset;
+    uint32_t marker;
+    uint32_t expiration;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    sss_iobuf_cursor_reset(sec_value);
+
+    ret = sss_iobuf_read_int32(sec_value, &kdc_offset);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = bin_to_princ(tmp_ctx, sec_value, &princ);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = bin_to_creds(tmp_ctx, sec_value, &creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The whole-ccache format ends with the credentials. */
+    ret = sss_iobuf_read_uint32(sec_value, &marker);
+    if (ret != EOK || marker != KCM_BINARY_SEPARATE_CREDS) {
+        *_separate_creds = false;
+        *_expiration = 0;
+        ret = EOK;
+        goto done;
+    }
+
+    ret = sss_iobuf_read_uint32(sec_value, &expiration);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    *_separate_creds = true;
+    *_expiration = (time_t)expiration;
+
+    ret = EOK;
+
+done:
+    sss_iobuf_cursor_reset(sec_value);
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t sec_value_to_kcm_cred_binary(TALLOC_CTX *mem_ctx,
+                                     struct sss_iobuf *sec_value,
+                                     uint32_t *_seq,
+                                     struct kcm_cred **_crd)
+{
+    uint32_t seq;
+    errno_t ret;
+
+    ret = sss_iobuf_read_uint32(sec_value, &seq);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = bin_to_cred(mem_ctx, sec_value, _crd);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_seq = seq;
+    return EOK;
+}
@@ -43,6 +43,11 @@
 #define KCM_SECDB_CCACHE_FMT  KCM_SECDB_BASE_FMT"ccache/"
 #define KCM_SECDB_DFL_FMT     KCM_SECDB_BASE_FMT"default"
 
+/* Credentials of a ccache, one record per credential:
+ * creds/<uid>/<ccache uuid>/<credential uuid> */
+#define KCM_SECDB_CREDS_BASE_FMT  KCM_CREDS_PATH"/%"SPRIuid"/"
+#define KCM_SECDB_CREDS_FMT       KCM_SECDB_CREDS_BASE_FMT"%s/"
+
 static errno_t sec_get(TALLOC_CTX *mem_ctx,
                        struct sss_sec_req *req,
                        struct sss_iobuf **_buf)
@@ -137,6 +142,36 @@ static const char *secdb_dfl_url_create(TALLOC_CTX *mem_ctx,
                            cli_creds_get_uid(client));
 }
 
+static const char *secdb_creds_url_create(TALLOC_CTX *mem_ctx,
+                                          struct cli_creds *client,
+                                          uuid_t cc_uuid)
+{
+    char uuid_str[UUID_STR_SIZE];
+
+    uuid_unparse(cc_uuid, uuid_str);
+    return talloc_asprintf(mem_ctx,
+                           KCM_SECDB_CREDS_FMT,
+                           cli_creds_get_uid(client),
+                           uuid_str);
+}
+
+static const char *secdb_cred_url_create(TALLOC_CTX *mem_ctx,
+                                         struct cli_creds *client,
+                                         uuid_t cc_uuid,
+                                         uuid_t cred_uuid)
+{
+    char cc_uuid_str[UUID_STR_SIZE];
+    char cred_uuid_str[UUID_STR_SIZE];
+
+    uuid_unparse(cc_uuid, cc_uuid_str);
+    uuid_unparse(cred_uuid, cred_uuid_str);
+    return talloc_asprintf(mem_ctx,
+                           KCM_SECDB_CREDS_FMT"%s",
+                           cli_creds_get_uid(client),
+                           cc_uuid_str,
+                           cred_uuid_str);
+}
+
 static errno_t kcm_ccache_to_secdb_kv(TALLOC_CTX *mem_ctx,
                                       struct kcm_ccache *cc,
                                       struct cli_creds *client,
@@ -168,7 +203,8 @@ static errno_t kcm_ccache_to_secdb_kv(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    ret = kcm_ccache_to_sec_input_binary(mem_ctx, cc, &payload);
+    /* The credentials are stored as separate records */
+    ret = kcm_ccache_header_to_sec_input_binary(mem_ctx, cc, 0, &payload);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Cannot convert ccache to a secret [%d][%s]\n", ret, sss_strerror(ret));
@@ -186,6 +222,12 @@ done:
 
 struct ccdb_secdb {
     struct sss_sec_ctx *sctx;
+
+    /* Maximum size of a ccache including its credentials in KiB */
+    int max_ccache_size;
+
+    /* In-memory copy of the ccaches, struct secdb_mem_uid by UID */
+    hash_table_t *mem_uids;
 };
 
 /* Since with the synchronous database, the database operations are just
@@ -327,169 +369,728 @@ done:
     return ret;
 }
 
-static errno_t key_by_uuid(TALLOC_CTX *mem_ctx,
-                           struct sss_sec_ctx *sctx,
-                           struct cli_creds *client,
-                           uuid_t uuid,
-                           char **_key)
+/* The serialized ccaches of a UID are read from the secrets database when
+ * the UID is first used and kept in memory afterwards, so lookups do not
+ * touch the database. Modifications are written to the database first and
+ * only then to the memory, which makes the database the authoritative copy
+ * should sssd_kcm stop at any point. */
+struct secdb_mem_cred {
+    struct secdb_mem_cred *prev;
+    struct secdb_mem_cred *next;
+
+    uuid_t uuid;
+    uint32_t seq;
+    struct sss_iobuf *payload;
+};
+
+struct secdb_mem_cc {
+    struct secdb_mem_cc *prev;
+    struct secdb_mem_cc *next;
+
+    char *key;
+    struct sss_iobuf *payload;
+
+    /* Ccaches written in the whole-ccache format carry their credentials
+     * in the payload, otherwise they are kept here, newest (highest
+     * sequence number) first. */
+    bool separate_creds;
+    time_t expiration;
+    struct secdb_mem_cred *creds;
+};
+
+struct secdb_mem_uid {
+    bool has_container;
+    struct secdb_mem_cc *ccaches;
+
+    bool has_default;
+    uuid_t dfl;
+};
+
+static errno_t secdb_mem_set(struct secdb_mem_uid *mem_uid,
+                             const char *key,
+                             struct sss_iobuf *payload)
 {
-    TALLOC_CTX *tmp_ctx;
+    struct secdb_mem_cc *mcc;
     errno_t ret;
-    char *key_match = NULL;
-    char **keys = NULL;
-    size_t nkeys;
-    struct sss_sec_req *sreq = NULL;
 
-    tmp_ctx = talloc_new(mem_ctx);
-    if (tmp_ctx == NULL) {
-        return ENOMEM;
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        if (strcmp(mcc->key, key) == 0) {
+            break;
+        }
+    }
+
+    if (mcc == NULL) {
+        mcc = talloc_zero(mem_uid, struct secdb_mem_cc);
+        if (mcc == NULL) {
+            return ENOMEM;
+        }
+
+        mcc->key = talloc_strdup(mcc, key);
+        if (mcc->key == NULL) {
+            talloc_free(mcc);
+            return ENOMEM;
+        }
+
+        DLIST_ADD_END(mem_uid->ccaches, mcc, struct secdb_mem_cc *);
     }
 
-    ret = secdb_container_url_req(tmp_ctx, sctx, client, &sreq);
+    talloc_free(mcc->payload);
+    mcc->payload = talloc_steal(mcc, payload);
+    mem_uid->has_container = true;
+
+    ret = sec_value_ccache_layout_binary(payload,
+                                         &mcc->separate_creds,
+                                         &mcc->expiration);
     if (ret != EOK) {
-        goto done;
+        /* Malformed payloads are removed when the ccache is read */
+        mcc->separate_creds = false;
+        mcc->expiration = 0;
     }
 
-    ret = sss_sec_list(tmp_ctx, sreq, &keys, &nkeys);
-    if (ret == ENOENT) {
-        DEBUG(SSSDBG_MINOR_FAILURE, "The container was not found\n");
-        goto done;
-    } else if (ret != EOK) {
-        goto done;
+    return EOK;
+}
+
+static errno_t secdb_mem_set_cred(struct secdb_mem_cc *mcc,
+                                  uuid_t uuid,
+                                  uint32_t seq,
+                                  struct sss_iobuf *payload)
+{
+    struct secdb_mem_cred *mcred;
+    struct secdb_mem_cred *prev;
+
+    DLIST_FOR_EACH(mcred, mcc->creds) {
+        if (uuid_compare(mcred->uuid, uuid) == 0) {
+            break;
+        }
     }
 
-    for (size_t i = 0; i < nkeys; i++) {
-        if (sec_key_match_uuid(keys[i], uuid)) {
-            key_match = keys[i];
+    if (mcred == NULL) {
+        mcred = talloc_zero(mcc, struct secdb_mem_cred);
+        if (mcred == NULL) {
+            return ENOMEM;
+        }
+
+        uuid_copy(mcred->uuid, uuid);
+    } else {
+        DLIST_REMOVE(mcc->creds, mcred);
+    }
+
+    talloc_free(mcred->payload);
+    mcred->payload = talloc_steal(mcred, payload);
+    mcred->seq = seq;
+
+    /* Records are listed in database order, keep the list sorted */
+    prev = NULL;
+    DLIST_FOR_EACH(prev, mcc->creds) {
+        if (prev->next == NULL || prev->next->seq < seq) {
             break;
         }
     }
 
-    if (key_match == NULL) {
-        DEBUG(SSSDBG_TRACE_INTERNAL, "No key matched\n");
-        ret = ENOENT;
-        goto done;
+    if (prev == NULL || prev->seq < seq) {
+        DLIST_ADD(mcc->creds, mcred);
+    } else {
+        DLIST_ADD_AFTER(mcc->creds, mcred, prev);
     }
 
-    ret = EOK;
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Found key %s\n", key_match);
-    *_key = talloc_steal(mem_ctx, key_match);
-done:
+    return EOK;
+}
+
+static uint32_t secdb_mem_next_cred_seq(struct secdb_mem_cc *mcc)
+{
+    if (mcc->creds == NULL) {
+        return 1;
+    }
+
+    return mcc->creds->seq + 1;
+}
+
+static void secdb_mem_remove_cred(struct secdb_mem_cc *mcc,
+                                  struct secdb_mem_cred *mcred)
+{
+    DLIST_REMOVE(mcc->creds, mcred);
+    talloc_free(mcred);
+}
+
+static void secdb_mem_remove(struct secdb_mem_uid *mem_uid,
+                             struct secdb_mem_cc *mcc)
+{
+    DLIST_REMOVE(mem_uid->ccaches, mcc);
+    talloc_free(mcc);
+}
+
+static struct secdb_mem_cc *secdb_mem_by_key(struct secdb_mem_uid *mem_uid,
+                                             const char *key)
+{
+    struct secdb_mem_cc *mcc;
+
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        if (strcmp(mcc->key, key) == 0) {
+            return mcc;
+        }
+    }
+
+    return NULL;
+}
+
+static errno_t secdb_url_delete(struct ccdb_secdb *secdb,
+                                const char *url)
+{
+    struct sss_sec_req *sreq;
+    errno_t ret;
+
+    if (url == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_sec_new_req(NULL, secdb->sctx, url, &sreq);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sss_sec_delete(sreq);
+    talloc_free(sreq);
+    return ret;
+}
+
+static errno_t secdb_cred_delete(struct ccdb_secdb *secdb,
+                                 struct cli_creds *client,
+                                 uuid_t cc_uuid,
+                                 uuid_t cred_uuid)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *url;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    url = secdb_cred_url_create(tmp_ctx, client, cc_uuid, cred_uuid);
+    ret = secdb_url_delete(secdb, url);
     talloc_free(tmp_ctx);
     return ret;
 }
 
-static errno_t key_by_name(TALLOC_CTX *mem_ctx,
-                           struct sss_sec_ctx *sctx,
-                           struct cli_creds *client,
-                           const char *name,
-                           char **_key)
+static errno_t secdb_creds_container_delete(struct ccdb_secdb *secdb,
+                                            struct cli_creds *client,
+                                            uuid_t cc_uuid)
 {
     TALLOC_CTX *tmp_ctx;
+    const char *url;
     errno_t ret;
-    char *key_match = NULL;
-    char **keys = NULL;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    url = secdb_creds_url_create(tmp_ctx, client, cc_uuid);
+    ret = secdb_url_delete(secdb, url);
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Attach the credential records of a UID to their ccaches. Records whose
+ * ccache is gone, e.g. because it was removed to stay within the quota,
+ * are deleted. */
+static errno_t secdb_mem_load_creds(struct ccdb_secdb *secdb,
+                                    struct cli_creds *client,
+                                    struct secdb_mem_uid *mem_uid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_sec_req *sreq;
+    struct secdb_mem_cc *mcc;
+    struct sss_iobuf *payload;
+    struct kcm_cred *crd = NULL;
+    const char *url;
+    char **keys;
     size_t nkeys;
-    struct sss_sec_req *sreq = NULL;
+    char *cred_uuid_str;
+    uint32_t seq;
+    uuid_t cc_uuid;
+    uuid_t cred_uuid;
+    uuid_t *orphans = NULL;
+    size_t norphans = 0;
+    size_t i;
+    size_t j;
+    errno_t ret;
 
-    tmp_ctx = talloc_new(mem_ctx);
+    tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
         return ENOMEM;
     }
 
-    ret = secdb_container_url_req(tmp_ctx, sctx, client, &sreq);
+    url = talloc_asprintf(tmp_ctx, KCM_SECDB_CREDS_BASE_FMT,
+                          cli_creds_get_uid(client));
+    if (url == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_sec_new_req(tmp_ctx, secdb->sctx, url, &sreq);
     if (ret != EOK) {
         goto done;
     }
 
     ret = sss_sec_list(tmp_ctx, sreq, &keys, &nkeys);
     if (ret == ENOENT) {
-        DEBUG(SSSDBG_MINOR_FAILURE, "The container was not found\n");
+        ret = EOK;
         goto done;
     } else if (ret != EOK) {
         goto done;
     }
 
-    for (size_t i = 0; i < nkeys; i++) {
-        if (sec_key_match_name(keys[i], name)) {
-            key_match = keys[i];
-            break;
+    for (i = 0; i < nkeys; i++) {
+        /* <ccache uuid>/<credential uuid> */
+        cred_uuid_str = strchr(keys[i], '/');
+        if (cred_uuid_str == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unexpected key %s\n", keys[i]);
+            continue;
+        }
+        *cred_uuid_str = '\0';
+        cred_uuid_str++;
+
+        if (uuid_parse(keys[i], cc_uuid) != 0
+                || uuid_parse(cred_uuid_str, cred_uuid) != 0) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unexpected key %s/%s\n",
+                  keys[i], cred_uuid_str);
+            continue;
+        }
+
+        DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+            if (mcc->separate_creds && sec_key_match_uuid(mcc->key, cc_uuid)) {
+                break;
+            }
+        }
+
+        if (mcc == NULL) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "Removing credential %s of a removed ccache\n", keys[i]);
+            ret = secdb_cred_delete(secdb, client, cc_uuid, cred_uuid);
+            if (ret != EOK && ret != ENOENT) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Cannot remove the credential [%d]: %s\n",
+                      ret, sss_strerror(ret));
+            }
+
+            for (j = 0; j < norphans; j++) {
+                if (uuid_compare(orphans[j], cc_uuid) == 0) {
+                    break;
+                }
+            }
+
+            if (j == norphans) {
+                orphans = talloc_realloc(tmp_ctx, orphans, uuid_t,
+                                         norphans + 1);
+                if (orphans == NULL) {
+                    ret = ENOMEM;
+                    goto done;
+                }
+                uuid_copy(orphans[norphans], cc_uuid);
+                norphans++;
+            }
+            continue;
+        }
+
+        url = secdb_cred_url_create(tmp_ctx, client, cc_uuid, cred_uuid);
+        if (url == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sss_sec_new_req(tmp_ctx, secdb->sctx, url, &sreq);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = sec_get(tmp_ctx, sreq, &payload);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        ret = sec_value_to_kcm_cred_binary(tmp_ctx, payload, &seq, &crd);
+        if (ret != EOK) {
+            /* Malformed records are removed when the ccache is read */
+            seq = 0;
+        }
+        talloc_zfree(crd);
+        sss_iobuf_cursor_reset(payload);
+
+        ret = secdb_mem_set_cred(mcc, cred_uuid, seq, payload);
+        if (ret != EOK) {
+            goto done;
         }
     }
 
-    if (key_match == NULL) {
-        DEBUG(SSSDBG_TRACE_INTERNAL, "No key matched\n");
-        ret = ENOENT;
-        goto done;
+    for (j = 0; j < norphans; j++) {
+        ret = secdb_creds_container_delete(secdb, client, orphans[j]);
+        if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot remove the credentials container [%d]: %s\n",
+                  ret, sss_strerror(ret));
+        }
     }
 
     ret = EOK;
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Found key %s\n", key_match);
-    *_key = talloc_steal(mem_ctx, key_match);
+
 done:
     talloc_free(tmp_ctx);
     return ret;
 }
 
-static errno_t secdb_get_cc(TALLOC_CTX *mem_ctx,
-                            struct sss_sec_ctx *sctx,
-                            const char *secdb_key,
-                            struct cli_creds *client,
-                            struct kcm_ccache **_cc)
+static errno_t secdb_mem_load(struct ccdb_secdb *secdb,
+                              struct cli_creds *client,
+                              struct secdb_mem_uid **_mem_uid)
 {
-    errno_t ret;
-    TALLOC_CTX *tmp_ctx = NULL;
-    struct kcm_ccache *cc = NULL;
+    TALLOC_CTX *tmp_ctx;
+    struct secdb_mem_uid *mem_uid;
     struct sss_sec_req *sreq = NULL;
-    struct sss_iobuf *ccbuf;
+    struct sss_iobuf *payload;
+    hash_key_t key;
+    hash_value_t value;
+    char **keys = NULL;
+    size_t nkeys;
+    errno_t ret;
+    int hret;
 
-    tmp_ctx = talloc_new(mem_ctx);
+    key.type = HASH_KEY_ULONG;
+    key.ul = cli_creds_get_uid(client);
+
+    hret = hash_lookup(secdb->mem_uids, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        *_mem_uid = talloc_get_type(value.ptr, struct secdb_mem_uid);
+        return EOK;
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "hash_lookup failed.\n");
+        return EIO;
+    }
+
+    tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
         return ENOMEM;
     }
 
-    ret = secdb_cc_key_req(tmp_ctx, sctx, client, secdb_key, &sreq);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "Cannot create secdb request [%d][%s]\n", ret, sss_strerror(ret));
+    mem_uid = talloc_zero(tmp_ctx, struct secdb_mem_uid);
+    if (mem_uid == NULL) {
+        ret = ENOMEM;
         goto done;
     }
 
-    ret = sec_get(tmp_ctx, sreq, &ccbuf);
+    ret = secdb_container_url_req(tmp_ctx, secdb->sctx, client, &sreq);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "Cannot get the secret [%d][%s]\n", ret, sss_strerror(ret));
         goto done;
     }
 
-    ret = sec_kv_to_ccache_binary(tmp_ctx, secdb_key, ccbuf, client, &cc);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Cannot convert data to ccache [%d]: %s, "
-              "deleting this entry\n", ret, sss_strerror(ret));
-        ret = sss_sec_delete(sreq);
+    ret = sss_sec_list(tmp_ctx, sreq, &keys, &nkeys);
+    if (ret == ENOENT) {
+        nkeys = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < nkeys; i++) {
+        ret = secdb_cc_key_req(tmp_ctx, secdb->sctx, client, keys[i], &sreq);
         if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE, "Failed to delete entry: [%d]: %s",
-                  ret, sss_strerror(ret));
+            goto done;
         }
-        ret = ENOENT;
+
+        ret = sec_get(tmp_ctx, sreq, &payload);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        ret = secdb_mem_set(mem_uid, keys[i], payload);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+    mem_uid->has_container = (nkeys > 0);
+
+    ret = secdb_mem_load_creds(secdb, client, mem_uid);
+    if (ret != EOK) {
         goto done;
     }
 
+    value.type = HASH_VALUE_PTR;
+    value.ptr = mem_uid;
+
+    hret = hash_enter(secdb->mem_uids, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "hash_enter failed.\n");
+        ret = EIO;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Loaded %zu ccaches of %"SPRIuid" into memory\n",
+          nkeys, cli_creds_get_uid(client));
+
+    *_mem_uid = talloc_steal(secdb, mem_uid);
     ret = EOK;
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Fetched the ccache\n");
-    *_cc = talloc_steal(mem_ctx, cc);
+
 done:
     talloc_free(tmp_ctx);
     return ret;
 }
 
-static errno_t ccdb_secdb_init(struct kcm_ccdb *db,
-                               struct confdb_ctx *cdb,
-                               const char *confdb_service_path)
+/* Drop the in-memory copy after a failed write, it is read again from the
+ * database on next use. */
+static void secdb_mem_forget(struct ccdb_secdb *secdb,
+                             struct cli_creds *client)
 {
-    struct ccdb_secdb *secdb = NULL;
-    errno_t ret;
-    struct sss_sec_quota *kcm_quota;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_ULONG;
+    key.ul = cli_creds_get_uid(client);
+
+    hret = hash_lookup(secdb->mem_uids, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    hret = hash_delete(secdb->mem_uids, &key);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
+        return;
+    }
+
+    talloc_free(value.ptr);
+}
+
+/* Called after the payload was written to the database */
+static void secdb_mem_store(struct ccdb_secdb *secdb,
+                            struct cli_creds *client,
+                            const char *key,
+                            struct sss_iobuf *payload)
+{
+    struct secdb_mem_uid *mem_uid;
+    errno_t ret;
+
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        return;
+    }
+
+    ret = secdb_mem_set(mem_uid, key, payload);
+    if (ret != EOK) {
+        secdb_mem_forget(secdb, client);
+    }
+}
+
+static errno_t secdb_mem_keys(TALLOC_CTX *mem_ctx,
+                              struct ccdb_secdb *secdb,
+                              struct cli_creds *client,
+                              char ***_keys,
+                              size_t *_nkeys)
+{
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
+    char **keys;
+    size_t nkeys = 0;
+    errno_t ret;
+
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (!mem_uid->has_container) {
+        return ENOENT;
+    }
+
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        nkeys++;
+    }
+
+    keys = talloc_zero_array(mem_ctx, char *, nkeys + 1);
+    if (keys == NULL) {
+        return ENOMEM;
+    }
+
+    nkeys = 0;
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        keys[nkeys] = talloc_strdup(keys, mcc->key);
+        if (keys[nkeys] == NULL) {
+            talloc_free(keys);
+            return ENOMEM;
+        }
+        nkeys++;
+    }
+
+    *_keys = keys;
+    *_nkeys = nkeys;
+    return EOK;
+}
+
+static errno_t key_by_uuid(TALLOC_CTX *mem_ctx,
+                           struct ccdb_secdb *secdb,
+                           struct cli_creds *client,
+                           uuid_t uuid,
+                           char **_key)
+{
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
+    errno_t ret;
+
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        if (sec_key_match_uuid(mcc->key, uuid)) {
+            break;
+        }
+    }
+
+    if (mcc == NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "No key matched\n");
+        return ENOENT;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Found key %s\n", mcc->key);
+    *_key = talloc_strdup(mem_ctx, mcc->key);
+    if (*_key == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static errno_t key_by_name(TALLOC_CTX *mem_ctx,
+                           struct ccdb_secdb *secdb,
+                           struct cli_creds *client,
+                           const char *name,
+                           char **_key)
+{
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
+    errno_t ret;
+
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DLIST_FOR_EACH(mcc, mem_uid->ccaches) {
+        if (sec_key_match_name(mcc->key, name)) {
+            break;
+        }
+    }
+
+    if (mcc == NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "No key matched\n");
+        return ENOENT;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Found key %s\n", mcc->key);
+    *_key = talloc_strdup(mem_ctx, mcc->key);
+    if (*_key == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static errno_t secdb_get_cc(TALLOC_CTX *mem_ctx,
+                            struct ccdb_secdb *secdb,
+                            const char *secdb_key,
+                            struct cli_creds *client,
+                            struct kcm_ccache **_cc)
+{
+    errno_t ret;
+    TALLOC_CTX *tmp_ctx = NULL;
+    struct kcm_ccache *cc = NULL;
+    struct sss_sec_req *sreq = NULL;
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
+    struct secdb_mem_cred *mcred;
+    struct secdb_mem_cred *mnext;
+    struct kcm_cred *crd;
+    struct kcm_cred *last = NULL;
+    uint32_t seq;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    mcc = secdb_mem_by_key(mem_uid, secdb_key);
+    if (mcc == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot get the secret %s\n", secdb_key);
+        ret = ENOENT;
+        goto done;
+    }
+
+    sss_iobuf_cursor_reset(mcc->payload);
+    ret = sec_kv_to_ccache_binary(tmp_ctx, secdb_key, mcc->payload,
+                                  client, &cc);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot convert data to ccache [%d]: %s, "
+              "deleting this entry\n", ret, sss_strerror(ret));
+        secdb_mem_remove(mem_uid, mcc);
+
+        ret = secdb_cc_key_req(tmp_ctx, secdb->sctx, client, secdb_key, &sreq);
+        if (ret == EOK) {
+            ret = sss_sec_delete(sreq);
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to delete entry: [%d]: %s",
+                  ret, sss_strerror(ret));
+            secdb_mem_forget(secdb, client);
+        }
+        ret = ENOENT;
+        goto done;
+    }
+
+    DLIST_FOR_EACH_SAFE(mcred, mnext, mcc->creds) {
+        sss_iobuf_cursor_reset(mcred->payload);
+        ret = sec_value_to_kcm_cred_binary(cc, mcred->payload, &seq, &crd);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Cannot convert data to credential "
+                  "[%d]: %s, deleting this entry\n", ret, sss_strerror(ret));
+            ret = secdb_cred_delete(secdb, client, cc->uuid, mcred->uuid);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE, "Failed to delete entry: [%d]: %s",
+                      ret, sss_strerror(ret));
+            }
+            secdb_mem_remove_cred(mcc, mcred);
+            continue;
+        }
+
+        /* Keep the order of the in-memory list */
+        DLIST_ADD_AFTER(cc->creds, crd, last);
+        last = crd;
+    }
+
+    ret = EOK;
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Fetched the ccache\n");
+    *_cc = talloc_steal(mem_ctx, cc);
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t ccdb_secdb_init(struct kcm_ccdb *db,
+                               struct confdb_ctx *cdb,
+                               const char *confdb_service_path)
+{
+    struct ccdb_secdb *secdb = NULL;
+    errno_t ret;
+    struct sss_sec_quota *kcm_quota;
     struct sss_sec_quota_opt dfl_kcm_nest_level = {
         .opt_name = CONFDB_KCM_CONTAINERS_NEST_LEVEL,
         .default_value = DEFAULT_SEC_CONTAINERS_NEST_LEVEL,
@@ -537,6 +1138,7 @@ static errno_t ccdb_secdb_init(struct kcm_ccdb *db,
     if (kcm_quota->max_uid_secrets > 0) {
        kcm_quota->max_uid_secrets += KCM_MAX_UID_EXTRA_SECRETS;
     }
+    secdb->max_ccache_size = kcm_quota->max_payload_size;
 
     ret = sss_sec_init(db, kcm_quota, &secdb->sctx);
     if (ret != EOK) {
@@ -546,6 +1148,13 @@ static errno_t ccdb_secdb_init(struct kcm_ccdb *db,
         return ret;
     }
 
+    ret = sss_hash_create(secdb, 0, &secdb->mem_uids);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create the ccache hash table\n");
+        talloc_free(secdb);
+        return ret;
+    }
+
     DEBUG(SSSDBG_TRACE_INTERNAL, "secdb initialized\n");
     db->db_handle = secdb;
     return EOK;
@@ -577,7 +1186,6 @@ static struct tevent_req *ccdb_secdb_nextid_send(TALLOC_CTX *mem_ctx,
     const int maxtries = 3;
     int numtry;
     errno_t ret;
-    struct sss_sec_req *sreq = NULL;
     char **keys = NULL;
     size_t nkeys;
     char *nextid_name = NULL;
@@ -595,12 +1203,7 @@ static struct tevent_req *ccdb_secdb_nextid_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = secdb_container_url_req(state, secdb->sctx, client, &sreq);
-    if (ret != EOK) {
-        goto immediate;
-    }
-
-    ret = sss_sec_list(state, sreq, &keys, &nkeys);
+    ret = secdb_mem_keys(state, secdb, client, &keys, &nkeys);
     if (ret == ENOENT) {
         keys = NULL;
         nkeys = 0;
@@ -670,6 +1273,7 @@ static struct tevent_req *ccdb_secdb_set_default_send(TALLOC_CTX *mem_ctx,
     struct sss_sec_req *sreq = NULL;
     struct sss_iobuf *iobuf;
     char *cur_default;
+    struct secdb_mem_uid *mem_uid;
 
     uuid_unparse(uuid, uuid_str);
     DEBUG(SSSDBG_TRACE_INTERNAL,
@@ -702,9 +1306,16 @@ static struct tevent_req *ccdb_secdb_set_default_send(TALLOC_CTX *mem_ctx,
     }
 
     if (ret != EOK) {
+        secdb_mem_forget(secdb, client);
         goto immediate;
     }
 
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret == EOK) {
+        uuid_copy(mem_uid->dfl, uuid);
+        mem_uid->has_default = true;
+    }
+
     ret = EOK;
     DEBUG(SSSDBG_TRACE_INTERNAL, "Set the default ccache\n");
 immediate:
@@ -738,6 +1349,7 @@ static struct tevent_req *ccdb_secdb_get_default_send(TALLOC_CTX *mem_ctx,
     errno_t ret;
     struct sss_sec_req *sreq = NULL;
     struct sss_iobuf *dfl_iobuf = NULL;
+    struct secdb_mem_uid *mem_uid = NULL;
     size_t uuid_size;
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Getting the default ccache\n");
@@ -747,6 +1359,17 @@ static struct tevent_req *ccdb_secdb_get_default_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    if (mem_uid->has_default) {
+        uuid_copy(state->uuid, mem_uid->dfl);
+        ret = EOK;
+        goto immediate;
+    }
+
     ret = secdb_dfl_url_req(state, secdb->sctx, client, &sreq);
     if (ret != EOK) {
         goto immediate;
@@ -787,6 +1410,8 @@ static struct tevent_req *ccdb_secdb_get_default_send(TALLOC_CTX *mem_ctx,
     ret = EOK;
 immediate:
     if (ret == EOK) {
+        uuid_copy(mem_uid->dfl, state->uuid);
+        mem_uid->has_default = true;
         tevent_req_done(req);
     } else {
         tevent_req_error(req, ret);
@@ -884,14 +1509,14 @@ static errno_t ccdb_secdb_get_cc_for_uuid(TALLOC_CTX *mem_ctx,
         cli_cred.ucred.gid = pwd->pw_gid;
 #endif // __FreeBSD__
 
-        ret = key_by_uuid(tmp_ctx, secdb->sctx, &cli_cred, uuid, &secdb_key);
+        ret = key_by_uuid(tmp_ctx, secdb, &cli_cred, uuid, &secdb_key);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "key_by_uuid() failed for uuid = '%s'", uuid_str);
             goto done;
         }
 
-        ret = secdb_get_cc(cc_list, secdb->sctx, secdb_key, &cli_cred,
+        ret = secdb_get_cc(cc_list, secdb, secdb_key, &cli_cred,
                            &cc_list[real_count]);
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE,
@@ -992,7 +1617,6 @@ static struct tevent_req *ccdb_secdb_list_send(TALLOC_CTX *mem_ctx,
     errno_t ret;
     char **keys = NULL;
     size_t nkeys;
-    struct sss_sec_req *sreq = NULL;
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Listing all ccaches\n");
 
@@ -1001,12 +1625,7 @@ static struct tevent_req *ccdb_secdb_list_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = secdb_container_url_req(state, secdb->sctx, client, &sreq);
-    if (ret != EOK) {
-        goto immediate;
-    }
-
-    ret = sss_sec_list(state, sreq, &keys, &nkeys);
+    ret = secdb_mem_keys(state, secdb, client, &keys, &nkeys);
     if (ret == ENOENT) {
         nkeys = 0;
         /* Fall through and return an empty list */
@@ -1078,7 +1697,7 @@ static struct tevent_req *ccdb_secdb_getbyuuid_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_uuid(state, secdb->sctx, client, uuid, &secdb_key);
+    ret = key_by_uuid(state, secdb, client, uuid, &secdb_key);
     if (ret == ENOENT) {
         state->cc = NULL;
         ret = EOK;
@@ -1087,7 +1706,7 @@ static struct tevent_req *ccdb_secdb_getbyuuid_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = secdb_get_cc(state, secdb->sctx, secdb_key, client, &state->cc);
+    ret = secdb_get_cc(state, secdb, secdb_key, client, &state->cc);
     if (ret == ENOENT) {
         state->cc = NULL;
         ret = EOK;
@@ -1143,7 +1762,7 @@ static struct tevent_req *ccdb_secdb_getbyname_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_name(state, secdb->sctx, client, name, &secdb_key);
+    ret = key_by_name(state, secdb, client, name, &secdb_key);
     if (ret == ENOENT) {
         state->cc = NULL;
         ret = EOK;
@@ -1152,7 +1771,7 @@ static struct tevent_req *ccdb_secdb_getbyname_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = secdb_get_cc(state, secdb->sctx, secdb_key, client, &state->cc);
+    ret = secdb_get_cc(state, secdb, secdb_key, client, &state->cc);
     if (ret == ENOENT) {
         state->cc = NULL;
         ret = EOK;
@@ -1210,7 +1829,7 @@ struct tevent_req *ccdb_secdb_name_by_uuid_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_uuid(state, secdb->sctx, client, uuid, &key);
+    ret = key_by_uuid(state, secdb, client, uuid, &key);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1277,7 +1896,7 @@ struct tevent_req *ccdb_secdb_uuid_by_name_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_name(state, secdb->sctx, client, name, &key);
+    ret = key_by_name(state, secdb, client, name, &key);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1371,6 +1990,10 @@ static struct tevent_req *ccdb_secdb_create_send(TALLOC_CTX *mem_ctx,
     }
 
     ret = sec_put(state, ccache_req, ccache_payload);
+    /* Adding a ccache may have evicted other expired ccaches of this UID
+     * to stay within the quota, so the in-memory copy is reloaded on the
+     * next access rather than updated here. */
+    secdb_mem_forget(secdb, client);
     if (ret != EOK) {
         goto immediate;
     }
@@ -1393,6 +2016,389 @@ static errno_t ccdb_secdb_create_recv(struct tevent_req *req)
     return EOK;
 }
 
+static errno_t secdb_header_update(TALLOC_CTX *mem_ctx,
+                                   struct ccdb_secdb *secdb,
+                                   struct cli_creds *client,
+                                   const char *secdb_key,
+                                   struct kcm_ccache *cc,
+                                   time_t expiration,
+                                   struct sss_iobuf **_payload)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_sec_req *sreq;
+    struct sss_iobuf *payload;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = kcm_ccache_header_to_sec_input_binary(tmp_ctx, cc, expiration,
+                                                &payload);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = secdb_cc_key_req(tmp_ctx, secdb->sctx, client, secdb_key, &sreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sec_update(tmp_ctx, sreq, payload);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    *_payload = talloc_steal(mem_ctx, payload);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t secdb_cred_write(TALLOC_CTX *mem_ctx,
+                                struct ccdb_secdb *secdb,
+                                struct cli_creds *client,
+                                uuid_t cc_uuid,
+                                struct kcm_cred *crd,
+                                uint32_t seq,
+                                struct sss_iobuf **_payload)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_sec_req *sreq;
+    struct sss_iobuf *payload;
+    const char *url;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = kcm_cred_to_sec_input_binary(tmp_ctx, crd, seq, &payload);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    url = secdb_cred_url_create(tmp_ctx, client, cc_uuid, crd->uuid);
+    if (url == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_sec_new_req(tmp_ctx, secdb->sctx, url, &sreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The record may be left over from an interrupted migration */
+    ret = sss_sec_put(sreq, sss_iobuf_get_data(payload),
+                      sss_iobuf_get_size(payload));
+    if (ret == EEXIST) {
+        ret = sec_update(tmp_ctx, sreq, payload);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot write the credential [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    *_payload = talloc_steal(mem_ctx, payload);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t secdb_creds_container_create(struct ccdb_secdb *secdb,
+                                            struct cli_creds *client,
+                                            uuid_t cc_uuid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_sec_req *sreq;
+    const char *url;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    url = secdb_creds_url_create(tmp_ctx, client, cc_uuid);
+    if (url == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_sec_new_req(tmp_ctx, secdb->sctx, url, &sreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_sec_create_container(sreq);
+    if (ret == EEXIST) {
+        ret = EOK;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* The credentials are not counted in the per-UID quota, the size of the
+ * whole ccache is limited instead just like with the single secret. */
+static errno_t secdb_check_ccache_size(struct ccdb_secdb *secdb,
+                                       size_t size)
+{
+    if (secdb->max_ccache_size == 0) {
+        return EOK;
+    }
+
+    if (size > (size_t)secdb->max_ccache_size * 1024) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "The ccache size [%zu B] exceeds the maximum allowed size "
+              "[%d KiB]\n", size, secdb->max_ccache_size);
+        return ERR_SEC_PAYLOAD_SIZE_IS_TOO_LARGE;
+    }
+
+    return EOK;
+}
+
+/* Remove the credential records of a ccache whose header was deleted.
+ * Records left behind are removed when the UID is loaded again. */
+static void secdb_creds_delete(struct ccdb_secdb *secdb,
+                               struct cli_creds *client,
+                               uuid_t cc_uuid,
+                               struct secdb_mem_cc *mcc)
+{
+    struct secdb_mem_cred *mcred;
+    errno_t ret;
+
+    if (!mcc->separate_creds) {
+        return;
+    }
+
+    DLIST_FOR_EACH(mcred, mcc->creds) {
+        ret = secdb_cred_delete(secdb, client, cc_uuid, mcred->uuid);
+        if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot remove the credential [%d]: %s\n",
+                  ret, sss_strerror(ret));
+        }
+    }
+
+    ret = secdb_creds_container_delete(secdb, client, cc_uuid);
+    if (ret != EOK && ret != ENOENT) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot remove the credentials container [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+}
+
+static bool secdb_cc_has_cred(struct kcm_ccache *cc, uuid_t uuid)
+{
+    struct kcm_cred *crd;
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        if (uuid_compare(crd->uuid, uuid) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Write the credential that was just added to cc as a new record and
+ * remove the records of the credentials it replaced. */
+static errno_t secdb_store_new_cred(struct ccdb_secdb *secdb,
+                                    struct cli_creds *client,
+                                    const char *secdb_key,
+                                    struct kcm_ccache *cc,
+                                    struct secdb_mem_uid *mem_uid,
+                                    struct secdb_mem_cc *mcc)
+{
+    struct secdb_mem_cred *mcred;
+    struct secdb_mem_cred *mnext;
+    struct sss_iobuf *payload;
+    struct kcm_cred *crd;
+    time_t endtime;
+    size_t size;
+    uint32_t seq;
+    errno_t ret;
+
+    /* kcm_cc_store_creds() adds the new credential to the front */
+    crd = kcm_cc_get_cred(cc);
+    if (crd == NULL) {
+        return ERR_INTERNAL;
+    }
+
+    size = sss_iobuf_get_size(mcc->payload)
+                + sss_iobuf_get_size(kcm_cred_get_creds(crd));
+    DLIST_FOR_EACH(mcred, mcc->creds) {
+        size += sss_iobuf_get_size(mcred->payload);
+    }
+
+    ret = secdb_check_ccache_size(secdb, size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (mcc->creds == NULL) {
+        ret = secdb_creds_container_create(secdb, client, cc->uuid);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    seq = secdb_mem_next_cred_seq(mcc);
+
+    ret = secdb_cred_write(mcc, secdb, client, cc->uuid, crd, seq, &payload);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = secdb_mem_set_cred(mcc, crd->uuid, seq, payload);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DLIST_FOR_EACH_SAFE(mcred, mnext, mcc->creds) {
+        if (secdb_cc_has_cred(cc, mcred->uuid)) {
+            continue;
+        }
+
+        ret = secdb_cred_delete(secdb, client, cc->uuid, mcred->uuid);
+        if (ret != EOK && ret != ENOENT) {
+            return ret;
+        }
+        secdb_mem_remove_cred(mcc, mcred);
+    }
+
+    /* The ccache expires with the last of its credentials */
+    endtime = kcm_cred_get_endtime(crd);
+    if (endtime > mcc->expiration) {
+        ret = secdb_header_update(mem_uid, secdb, client, secdb_key, cc,
+                                  endtime, &payload);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        ret = secdb_mem_set(mem_uid, secdb_key, payload);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+/* Move the credentials of a ccache written in the whole-ccache format to
+ * separate records. The header is rewritten last, so the migration is
+ * simply repeated if it is interrupted. */
+static errno_t secdb_migrate_creds(struct ccdb_secdb *secdb,
+                                   struct cli_creds *client,
+                                   const char *secdb_key,
+                                   struct kcm_ccache *cc,
+                                   struct secdb_mem_uid *mem_uid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct secdb_mem_cc *mcc;
+    struct sss_iobuf *payload;
+    struct sss_iobuf **payloads;
+    struct kcm_cred **creds;
+    struct kcm_cred *crd;
+    time_t expiration = 0;
+    time_t endtime;
+    size_t ncreds = 0;
+    size_t size = 0;
+    size_t i;
+    errno_t ret;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Storing the credentials of %s as separate records\n", cc->name);
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        size += sss_iobuf_get_size(kcm_cred_get_creds(crd));
+        ncreds++;
+    }
+
+    ret = secdb_check_ccache_size(secdb, size);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    creds = talloc_zero_array(tmp_ctx, struct kcm_cred *, ncreds);
+    payloads = talloc_zero_array(tmp_ctx, struct sss_iobuf *, ncreds);
+    if (creds == NULL || payloads == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = secdb_creds_container_create(secdb, client, cc->uuid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The front of cc is the newest credential, number them so that the
+     * order survives a reload */
+    i = 0;
+    DLIST_FOR_EACH(crd, cc->creds) {
+        ret = secdb_cred_write(payloads, secdb, client, cc->uuid, crd,
+                               ncreds - i, &payloads[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        endtime = kcm_cred_get_endtime(crd);
+        if (endtime > expiration) {
+            expiration = endtime;
+        }
+
+        creds[i] = crd;
+        i++;
+    }
+
+    ret = secdb_header_update(tmp_ctx, secdb, client, secdb_key, cc,
+                              expiration, &payload);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = secdb_mem_set(mem_uid, secdb_key, payload);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    mcc = secdb_mem_by_key(mem_uid, secdb_key);
+    if (mcc == NULL) {
+        ret = ERR_INTERNAL;
+        goto done;
+    }
+
+    for (i = 0; i < ncreds; i++) {
+        ret = secdb_mem_set_cred(mcc, creds[i]->uuid, ncreds - i,
+                                 payloads[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static struct tevent_req *ccdb_secdb_mod_send(TALLOC_CTX *mem_ctx,
                                               struct tevent_context *ev,
                                               struct kcm_ccdb *db,
@@ -1408,6 +2414,8 @@ static struct tevent_req *ccdb_secdb_mod_send(TALLOC_CTX *mem_ctx,
     struct kcm_ccache *cc = NULL;
     struct sss_iobuf *payload = NULL;
     struct sss_sec_req *sreq = NULL;
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Modifying ccache\n");
 
@@ -1416,7 +2424,7 @@ static struct tevent_req *ccdb_secdb_mod_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_uuid(state, secdb->sctx, client, uuid, &secdb_key);
+    ret = key_by_uuid(state, secdb, client, uuid, &secdb_key);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1424,7 +2432,7 @@ static struct tevent_req *ccdb_secdb_mod_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = secdb_get_cc(state, secdb->sctx, secdb_key, client, &cc);
+    ret = secdb_get_cc(state, secdb, secdb_key, client, &cc);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1440,21 +2448,40 @@ static struct tevent_req *ccdb_secdb_mod_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = kcm_ccache_to_sec_input_binary(state, cc, &payload);
+    ret = secdb_mem_load(secdb, client, &mem_uid);
     if (ret != EOK) {
         goto immediate;
     }
 
-    ret = secdb_cc_key_req(state, secdb->sctx, client, secdb_key, &sreq);
-    if (ret != EOK) {
-        goto immediate;
-    }
+    mcc = secdb_mem_by_key(mem_uid, secdb_key);
+    if (mcc != NULL && mcc->separate_creds) {
+        /* Only the header changes, the credentials keep their records */
+        ret = secdb_header_update(state, secdb, client, secdb_key, cc,
+                                  mcc->expiration, &payload);
+        if (ret != EOK) {
+            secdb_mem_forget(secdb, client);
+            goto immediate;
+        }
+    } else {
+        ret = kcm_ccache_to_sec_input_binary(state, cc, &payload);
+        if (ret != EOK) {
+            goto immediate;
+        }
 
-    ret = sec_update(state, sreq, payload);
-    if (ret != EOK) {
-        goto immediate;
+        ret = secdb_cc_key_req(state, secdb->sctx, client, secdb_key, &sreq);
+        if (ret != EOK) {
+            goto immediate;
+        }
+
+        ret = sec_update(state, sreq, payload);
+        if (ret != EOK) {
+            secdb_mem_forget(secdb, client);
+            goto immediate;
+        }
     }
 
+    secdb_mem_store(secdb, client, secdb_key, payload);
+
     ret = EOK;
 immediate:
     if (ret == EOK) {
@@ -1484,8 +2511,8 @@ static struct tevent_req *ccdb_secdb_store_cred_send(TALLOC_CTX *mem_ctx,
     struct ccdb_secdb_state *state = NULL;
     char *secdb_key = NULL;
     struct kcm_ccache *cc = NULL;
-    struct sss_iobuf *payload = NULL;
-    struct sss_sec_req *sreq = NULL;
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
     errno_t ret;
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Storing creds in ccache\n");
@@ -1495,7 +2522,7 @@ static struct tevent_req *ccdb_secdb_store_cred_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = key_by_uuid(state, secdb->sctx, client, uuid, &secdb_key);
+    ret = key_by_uuid(state, secdb, client, uuid, &secdb_key);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1503,7 +2530,7 @@ static struct tevent_req *ccdb_secdb_store_cred_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = secdb_get_cc(state, secdb->sctx, secdb_key, client, &cc);
+    ret = secdb_get_cc(state, secdb, secdb_key, client, &cc);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1519,18 +2546,28 @@ static struct tevent_req *ccdb_secdb_store_cred_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = kcm_ccache_to_sec_input_binary(state, cc, &payload);
+    /* Loaded by secdb_get_cc() above */
+    ret = secdb_mem_load(secdb, client, &mem_uid);
     if (ret != EOK) {
         goto immediate;
     }
 
-    ret = secdb_cc_key_req(state, secdb->sctx, client, secdb_key, &sreq);
-    if (ret != EOK) {
+    mcc = secdb_mem_by_key(mem_uid, secdb_key);
+    if (mcc == NULL) {
+        ret = ERR_NO_CREDS;
         goto immediate;
     }
 
-    ret = sec_update(state, sreq, payload);
+    /* Each credential is a separate record, only the new one is written.
+     * Ccaches in the whole-ccache format are converted on first store. */
+    if (mcc->separate_creds) {
+        ret = secdb_store_new_cred(secdb, client, secdb_key, cc,
+                                   mem_uid, mcc);
+    } else {
+        ret = secdb_migrate_creds(secdb, client, secdb_key, cc, mem_uid);
+    }
     if (ret != EOK) {
+        secdb_mem_forget(secdb, client);
         goto immediate;
     }
 
@@ -1565,6 +2602,8 @@ static struct tevent_req *ccdb_secdb_delete_send(TALLOC_CTX *mem_ctx,
     char *secdb_key = NULL;
     char **keys = NULL;
     size_t nkeys;
+    struct secdb_mem_uid *mem_uid;
+    struct secdb_mem_cc *mcc;
     errno_t ret;
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Deleting ccache\n");
@@ -1579,7 +2618,7 @@ static struct tevent_req *ccdb_secdb_delete_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = sss_sec_list(state, container_req, &keys, &nkeys);
+    ret = secdb_mem_keys(state, secdb, client, &keys, &nkeys);
     if (ret != EOK) {
         DEBUG(SSSDBG_MINOR_FAILURE, "No ccaches to delete\n");
         goto immediate;
@@ -1591,7 +2630,7 @@ static struct tevent_req *ccdb_secdb_delete_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = key_by_uuid(state, secdb->sctx, client, uuid, &secdb_key);
+    ret = key_by_uuid(state, secdb, client, uuid, &secdb_key);
     if (ret == ENOENT) {
         ret = ERR_NO_CREDS;
         goto immediate;
@@ -1606,9 +2645,22 @@ static struct tevent_req *ccdb_secdb_delete_send(TALLOC_CTX *mem_ctx,
 
     ret = sss_sec_delete(sreq);
     if (ret != EOK) {
+        secdb_mem_forget(secdb, client);
         goto immediate;
     }
 
+    /* Loaded by secdb_mem_keys() above */
+    ret = secdb_mem_load(secdb, client, &mem_uid);
+    if (ret != EOK) {
+        mem_uid = NULL;
+    } else {
+        mcc = secdb_mem_by_key(mem_uid, secdb_key);
+        if (mcc != NULL) {
+            secdb_creds_delete(secdb, client, uuid, mcc);
+            secdb_mem_remove(mem_uid, mcc);
+        }
+    }
+
     if (nkeys > 1) {
         DEBUG(SSSDBG_TRACE_INTERNAL, "There are other ccaches, done\n");
         ret = EOK;
@@ -1618,8 +2670,12 @@ static struct tevent_req *ccdb_secdb_delete_send(TALLOC_CTX *mem_ctx,
 
     ret = sss_sec_delete(container_req);
     if (ret != EOK) {
+        secdb_mem_forget(secdb, client);
         goto immediate;
     }
+    if (mem_uid != NULL) {
+        mem_uid->has_container = false;
+    }
 
     ret = EOK;
 immediate:
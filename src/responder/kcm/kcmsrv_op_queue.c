@@ -28,6 +28,13 @@ struct kcm_ops_queue_entry {
 
     struct kcm_ops_queue *queue;
 
+    /* The ccache the request works with, NULL means all ccaches of the UID */
+    const char *ccache_name;
+    bool write;
+
+    bool running;
+    bool activate;
+
     struct kcm_ops_queue_entry *next;
     struct kcm_ops_queue_entry *prev;
 };
@@ -54,6 +61,13 @@ struct kcm_ops_queue_ctx {
  * hash table entry is kcm_ops_queue structure which in turn contains a
  * linked list of kcm_ops_queue_entry structures * which primarily hold the
  * tevent request being queued.
+ *
+ * The queue works as a reader/writer lock per ccache of the UID. A request
+ * runs as soon as it does not conflict with any request queued before it,
+ * running or not. Two requests conflict unless both only read or each of
+ * them names a different ccache. Requests without a ccache name conflict
+ * with any writer of the UID. Waiting for the requests queued earlier
+ * keeps the queue fair, a writer is not starved by a stream of readers.
  */
 struct kcm_ops_queue_ctx *kcm_ops_queue_create(TALLOC_CTX *mem_ctx,
                                                struct kcm_ctx *kctx)
@@ -116,9 +130,67 @@ void queue_removal_cb(struct tevent_context *ctx,
     talloc_free(kq);
 }
 
+static bool kcm_op_queue_entries_conflict(struct kcm_ops_queue_entry *a,
+                                          struct kcm_ops_queue_entry *b)
+{
+    if (!a->write && !b->write) {
+        return false;
+    }
+
+    if (a->ccache_name == NULL || b->ccache_name == NULL) {
+        return true;
+    }
+
+    return strcmp(a->ccache_name, b->ccache_name) == 0;
+}
+
+static bool kcm_op_queue_entry_can_run(struct kcm_ops_queue_entry *entry)
+{
+    struct kcm_ops_queue_entry *ahead;
+
+    for (ahead = entry->queue->head; ahead != entry; ahead = ahead->next) {
+        if (kcm_op_queue_entries_conflict(ahead, entry)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void kcm_op_queue_run_waiting(struct kcm_ops_queue *kq,
+                                     struct kcm_ops_queue_entry *finished)
+{
+    struct kcm_ops_queue_entry *entry;
+
+    /* Only the requests that waited for the finished one may run now. Mark
+     * all of them first, activating them runs their callbacks which may
+     * modify the queue */
+    DLIST_FOR_EACH(entry, kq->head) {
+        if (!entry->running
+                && kcm_op_queue_entries_conflict(finished, entry)
+                && kcm_op_queue_entry_can_run(entry)) {
+            entry->running = true;
+            entry->activate = true;
+        }
+    }
+
+    do {
+        DLIST_FOR_EACH(entry, kq->head) {
+            if (entry->activate) {
+                break;
+            }
+        }
+
+        if (entry != NULL) {
+            entry->activate = false;
+            tevent_req_done(entry->req);
+        }
+    } while (entry != NULL);
+}
+
 static int kcm_op_queue_entry_destructor(struct kcm_ops_queue_entry *entry)
 {
-    struct kcm_ops_queue_entry *next_entry;
+    struct kcm_ops_queue *kq;
     struct tevent_immediate *imm;
 
     if (entry == NULL) {
@@ -128,28 +200,27 @@ static int kcm_op_queue_entry_destructor(struct kcm_ops_queue_entry *entry)
         return 0;
     }
 
-    /* Take the next entry from the queue */
-    next_entry = entry->next;
+    kq = entry->queue;
 
     /* Remove the current entry from the queue */
-    DLIST_REMOVE(entry->queue->head, entry);
+    DLIST_REMOVE(kq->head, entry);
 
-    if (next_entry == NULL) {
+    if (kq->head == NULL) {
         /* If there was no other entry, schedule removal of the queue. Do it
          * in another tevent tick to avoid issues with callbacks invoking
          * the destructor while another request is touching the queue
          */
-        imm = tevent_create_immediate(entry->queue);
+        imm = tevent_create_immediate(kq);
         if (imm == NULL) {
             return 1;
         }
 
-        tevent_schedule_immediate(imm, entry->queue->ev, queue_removal_cb, entry->queue);
+        tevent_schedule_immediate(imm, kq->ev, queue_removal_cb, kq);
         return 0;
     }
 
-    /* Otherwise, mark the current head as done to run the next request */
-    tevent_req_done(next_entry->req);
+    /* Otherwise, run the requests that were waiting for this one */
+    kcm_op_queue_run_waiting(kq, entry);
     return 0;
 }
 
@@ -220,22 +291,26 @@ struct kcm_op_queue_state {
 };
 
 static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
-                                    struct tevent_req *req);
+                                    struct tevent_req *req,
+                                    enum kcm_op_access access,
+                                    const char *ccache_name);
 
 /*
  * Enqueue a request.
  *
- * If the request queue /for the given ID/ is empty, that is, if this
- * request is the first one in the queue, run the request immediately.
+ * If no request queued /for the given ID/ conflicts with this one, run
+ * the request immediately.
  *
- * Otherwise just add it to the queue and wait until the previous request
- * finishes and only at that point mark the current request as done, which
+ * Otherwise just add it to the queue and wait until the conflicting requests
+ * finish and only at that point mark the current request as done, which
  * will trigger calling the recv function and allow the request to continue.
  */
 struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
                                      struct kcm_ops_queue_ctx *qctx,
-                                     struct cli_creds *client)
+                                     struct cli_creds *client,
+                                     enum kcm_op_access access,
+                                     const char *ccache_name)
 {
     errno_t ret;
     struct tevent_req *req;
@@ -261,10 +336,10 @@ struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = kcm_op_queue_add_req(kq, req);
+    ret = kcm_op_queue_add_req(kq, req, access, ccache_name);
     if (ret == EOK) {
         DEBUG(SSSDBG_TRACE_LIBS,
-              "Queue was empty, running the request immediately\n");
+              "No conflicting request, running the request immediately\n");
         goto immediate;
     } else if (ret != EAGAIN) {
         DEBUG(SSSDBG_OP_FAILURE,
@@ -286,7 +361,9 @@ immediate:
 }
 
 static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
-                                    struct tevent_req *req)
+                                    struct tevent_req *req,
+                                    enum kcm_op_access access,
+                                    const char *ccache_name)
 {
     errno_t ret;
     struct kcm_op_queue_state *state = tevent_req_data(req,
@@ -298,17 +375,40 @@ static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
     }
     state->entry->req = req;
     state->entry->queue = kq;
+
+    switch (access) {
+    case KCM_OP_ACCESS_CC_WRITE:
+    case KCM_OP_ACCESS_CC_READ:
+        if (ccache_name != NULL) {
+            state->entry->ccache_name = talloc_strdup(state->entry,
+                                                      ccache_name);
+            if (state->entry->ccache_name == NULL) {
+                talloc_zfree(state->entry);
+                return ENOMEM;
+            }
+        }
+        break;
+    case KCM_OP_ACCESS_UID_WRITE:
+    case KCM_OP_ACCESS_UID_READ:
+        break;
+    }
+
+    state->entry->write = (access == KCM_OP_ACCESS_UID_WRITE
+                                || access == KCM_OP_ACCESS_CC_WRITE);
+
     talloc_set_destructor(state->entry, kcm_op_queue_entry_destructor);
 
-    if (kq->head == NULL) {
-        /* First entry, will run callback at once */
+    DLIST_ADD_END(kq->head, state->entry, struct kcm_ops_queue_entry *);
+
+    if (kcm_op_queue_entry_can_run(state->entry)) {
+        /* No conflicting entry, will run callback at once */
+        state->entry->running = true;
         ret = EOK;
     } else {
-        /* Will wait for the previous callbacks to finish */
+        /* Will wait for the conflicting callbacks to finish */
         ret = EAGAIN;
     }
 
-    DLIST_ADD_END(kq->head, state->entry, struct kcm_ops_queue_entry *);
     return ret;
 }
 
@@ -66,6 +66,7 @@ struct kcm_op {
     const char *name;
     kcm_srv_send_method fn_send;
     kcm_srv_recv_method fn_recv;
+    enum kcm_op_access access;
 };
 
 struct kcm_cmd_state {
@@ -94,6 +95,8 @@ struct tevent_req *kcm_cmd_send(TALLOC_CTX *mem_ctx,
     struct tevent_req *req = NULL;
     struct tevent_req *subreq = NULL;
     struct kcm_cmd_state *state = NULL;
+    enum kcm_op_access access;
+    const char *ccache_name = NULL;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state, struct kcm_cmd_state);
@@ -167,7 +170,22 @@ struct tevent_req *kcm_cmd_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    subreq = kcm_op_queue_send(state, ev, qctx, client);
+    /* Operations on a single ccache carry its name first in the input, peek
+     * at it so that the queue only serializes requests for the same ccache.
+     */
+    access = op->access;
+    if (access == KCM_OP_ACCESS_CC_WRITE || access == KCM_OP_ACCESS_CC_READ) {
+        ret = sss_iobuf_read_stringz(state->op_ctx->input, &ccache_name);
+        sss_iobuf_cursor_reset(state->op_ctx->input);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_TRACE_LIBS,
+                  "Cannot read the ccache name, locking all ccaches\n");
+            access = KCM_OP_ACCESS_UID_WRITE;
+            ccache_name = NULL;
+        }
+    }
+
+    subreq = kcm_op_queue_send(state, ev, qctx, client, access, ccache_name);
     if (subreq == NULL) {
         ret = ENOMEM;
         goto immediate;
@@ -2388,27 +2406,27 @@ static struct kcm_op kcm_optable[] = {
     { "NOOP",                NULL, NULL },
     { "GET_NAME",            NULL, NULL },
     { "RESOLVE",             NULL, NULL },
-    { "GEN_NEW",             kcm_op_gen_new_send, NULL },
-    { "INITIALIZE",          kcm_op_initialize_send, kcm_op_initialize_recv },
-    { "DESTROY",             kcm_op_destroy_send, NULL },
-    { "STORE",               kcm_op_store_send, kcm_op_store_recv },
+    { "GEN_NEW",             kcm_op_gen_new_send, NULL, KCM_OP_ACCESS_UID_READ },
+    { "INITIALIZE",          kcm_op_initialize_send, kcm_op_initialize_recv, KCM_OP_ACCESS_UID_WRITE },
+    { "DESTROY",             kcm_op_destroy_send, NULL, KCM_OP_ACCESS_CC_WRITE },
+    { "STORE",               kcm_op_store_send, kcm_op_store_recv, KCM_OP_ACCESS_CC_WRITE },
     { "RETRIEVE",            NULL, NULL },
-    { "GET_PRINCIPAL",       kcm_op_get_principal_send, NULL },
-    { "GET_CRED_UUID_LIST",  kcm_op_get_cred_uuid_list_send, NULL },
-    { "GET_CRED_BY_UUID",    kcm_op_get_cred_by_uuid_send, kcm_op_get_cred_by_uuid_recv },
-    { "REMOVE_CRED",         kcm_op_remove_cred_send, NULL },
+    { "GET_PRINCIPAL",       kcm_op_get_principal_send, NULL, KCM_OP_ACCESS_CC_READ },
+    { "GET_CRED_UUID_LIST",  kcm_op_get_cred_uuid_list_send, NULL, KCM_OP_ACCESS_CC_READ },
+    { "GET_CRED_BY_UUID",    kcm_op_get_cred_by_uuid_send, kcm_op_get_cred_by_uuid_recv, KCM_OP_ACCESS_CC_READ },
+    { "REMOVE_CRED",         kcm_op_remove_cred_send, NULL, KCM_OP_ACCESS_CC_WRITE },
     { "SET_FLAGS",           NULL, NULL },
     { "CHOWN",               NULL, NULL },
     { "CHMOD",               NULL, NULL },
     { "GET_INITIAL_TICKET",  NULL, NULL },
     { "GET_TICKET",          NULL, NULL },
     { "MOVE_CACHE",          NULL, NULL },
-    { "GET_CACHE_UUID_LIST", kcm_op_get_cache_uuid_list_send, NULL },
-    { "GET_CACHE_BY_UUID",   kcm_op_get_cache_by_uuid_send, NULL },
-    { "GET_DEFAULT_CACHE",   kcm_op_get_default_ccache_send, kcm_op_get_default_ccache_recv },
-    { "SET_DEFAULT_CACHE",   kcm_op_set_default_ccache_send, kcm_op_set_default_ccache_recv },
-    { "GET_KDC_OFFSET",      kcm_op_get_kdc_offset_send, NULL },
-    { "SET_KDC_OFFSET",      kcm_op_set_kdc_offset_send, kcm_op_set_kdc_offset_recv },
+    { "GET_CACHE_UUID_LIST", kcm_op_get_cache_uuid_list_send, NULL, KCM_OP_ACCESS_UID_READ },
+    { "GET_CACHE_BY_UUID",   kcm_op_get_cache_by_uuid_send, NULL, KCM_OP_ACCESS_UID_READ },
+    { "GET_DEFAULT_CACHE",   kcm_op_get_default_ccache_send, kcm_op_get_default_ccache_recv, KCM_OP_ACCESS_UID_READ },
+    { "SET_DEFAULT_CACHE",   kcm_op_set_default_ccache_send, kcm_op_set_default_ccache_recv, KCM_OP_ACCESS_UID_WRITE },
+    { "GET_KDC_OFFSET",      kcm_op_get_kdc_offset_send, NULL, KCM_OP_ACCESS_CC_READ },
+    { "SET_KDC_OFFSET",      kcm_op_set_kdc_offset_send, kcm_op_set_kdc_offset_recv, KCM_OP_ACCESS_CC_WRITE },
     { "ADD_NTLM_CRED",       NULL, NULL },
     { "HAVE_NTLM_CRED",      NULL, NULL },
     { "DEL_NTLM_CRED",       NULL, NULL },
@@ -2421,7 +2439,7 @@ static struct kcm_op kcm_optable[] = {
 /* MIT EXTENSIONS, see private header src/include/kcm.h in krb5 sources */
 #define KCM_MIT_OFFSET 13001
 static struct kcm_op kcm_mit_optable[] = {
-    { "GET_CRED_LIST", kcm_op_get_cred_list_send, NULL },
+    { "GET_CRED_LIST", kcm_op_get_cred_list_send, NULL, KCM_OP_ACCESS_CC_READ },
 
     { NULL, NULL, NULL }
 };
@@ -88,16 +88,31 @@ int kcm_connection_setup(struct cli_ctx *cctx);
 krb5_error_code sss2krb5_error(errno_t err);
 
 /* We enqueue all requests by the same UID to avoid concurrency issues.
+ * Requests that only read a ccache may run together and requests that
+ * touch different ccaches do not wait for each other.
  */
 struct kcm_ops_queue_entry;
 
+/* How an operation accesses the ccaches of the client. Operations that
+ * do not say otherwise have exclusive access to all ccaches of the UID. */
+enum kcm_op_access {
+    KCM_OP_ACCESS_UID_WRITE,
+    KCM_OP_ACCESS_UID_READ,
+    KCM_OP_ACCESS_CC_WRITE,
+    KCM_OP_ACCESS_CC_READ,
+};
+
 struct kcm_ops_queue_ctx *kcm_ops_queue_create(TALLOC_CTX *mem_ctx,
                                                struct kcm_ctx *kctx);
 
+/* ccache_name is only used with KCM_OP_ACCESS_CC_WRITE and
+ * KCM_OP_ACCESS_CC_READ */
 struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
                                      struct kcm_ops_queue_ctx *qctx,
-                                     struct cli_creds *client);
+                                     struct cli_creds *client,
+                                     enum kcm_op_access access,
+                                     const char *ccache_name);
 
 errno_t kcm_op_queue_recv(struct tevent_req *req,
                           TALLOC_CTX *mem_ctx,
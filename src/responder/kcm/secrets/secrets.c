@@ -134,6 +134,12 @@ done:
     return ret;
 }
 
+static bool local_is_creds_path(struct sss_sec_req *req)
+{
+    return strncmp(req->path, KCM_CREDS_PATH"/",
+                   sizeof(KCM_CREDS_PATH)) == 0;
+}
+
 static int local_db_check_number_of_secrets(TALLOC_CTX *mem_ctx,
                                             struct sss_sec_req *req)
 {
@@ -143,7 +149,7 @@ static int local_db_check_number_of_secrets(TALLOC_CTX *mem_ctx,
     struct ldb_dn *dn;
     int ret;
 
-    if (req->quota->max_secrets == 0) {
+    if (req->quota->max_secrets == 0 || local_is_creds_path(req)) {
         return EOK;
     }
 
@@ -156,6 +162,12 @@ static int local_db_check_number_of_secrets(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    /* Credential records are accounted for by the size of their ccache */
+    if (!ldb_dn_add_child_fmt(dn, "cn=persistent")) {
+        ret = ENOMEM;
+        goto done;
+    }
+
     ret = ldb_search(req->sctx->ldb, tmp_ctx, &res, dn, LDB_SCOPE_SUBTREE,
                      attrs, LOCAL_NON_CONTAINER_FILTER);
     if (ret != EOK) {
@@ -226,6 +238,7 @@ static errno_t get_secret_expiration_time(uint8_t *key, size_t key_length,
     krb5_creds **cred_list = NULL;
     krb5_creds **cred;
     const char *key_str;
+    bool separate_creds;
 
     if (_expiration == NULL) {
         return EINVAL;
@@ -248,6 +261,18 @@ static errno_t get_secret_expiration_time(uint8_t *key, size_t key_length,
         goto done;
     }
 
+    ret = sec_value_ccache_layout_binary(iobuf, &separate_creds, &expiration);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (separate_creds) {
+        /* The header keeps the expiration time of the credentials */
+        *_expiration = expiration;
+        ret = EOK;
+        goto done;
+    }
+
     ret = sec_kv_to_ccache_binary(tmp_ctx, key_str, iobuf, &client, &cc);
     if (ret != EOK) {
         goto done;
@@ -382,6 +407,10 @@ static int local_db_check_peruid_number_of_secrets(TALLOC_CTX *mem_ctx,
         return EOK;
     }
 
+    if (local_is_creds_path(req)) {
+        return EOK;
+    }
+
     tmp_ctx = talloc_new(mem_ctx);
     if (tmp_ctx == NULL) {
         return ENOMEM;
@@ -48,6 +48,11 @@
  */
 #define KCM_MAX_UID_EXTRA_SECRETS  2
 
+/* The KCM secdb backend may store the credentials of a ccache as separate
+ * secrets under this path. They are accounted for as part of their ccache
+ * and do not add up to the per-UID quota. */
+#define KCM_CREDS_PATH "creds"
+
 struct sss_sec_ctx;
 
 struct sss_sec_req;
@@ -71,6 +71,7 @@ static errno_t eval_flags(struct sss_nss_cmd_ctx *cmd_ctx,
 }
 
 static void sss_nss_getby_done(struct tevent_req *subreq);
+static void sss_nss_getby_id_batch_done(struct tevent_req *subreq);
 static void sss_nss_getlistby_done(struct tevent_req *subreq);
 
 static errno_t sss_nss_getby_name(struct cli_ctx *cli_ctx,
@@ -205,6 +206,134 @@ done:
     return EOK;
 }
 
+/* Number of lookups of a batch request that run at the same time. */
+#define SSS_NSS_BATCH_PARALLEL 32
+
+struct sss_nss_batch_lookup {
+    struct sss_nss_cmd_ctx *cmd_ctx;
+    uint32_t index;
+};
+
+static errno_t sss_nss_getby_id_batch_step(struct sss_nss_cmd_ctx *cmd_ctx,
+                                           uint32_t index)
+{
+    struct sss_nss_batch_lookup *lookup;
+    struct cache_req_data *data;
+    struct tevent_req *subreq;
+    uint32_t id;
+    errno_t ret;
+
+    id = cmd_ctx->batch[index].id;
+
+    lookup = talloc_zero(cmd_ctx, struct sss_nss_batch_lookup);
+    if (lookup == NULL) {
+        return ENOMEM;
+    }
+    lookup->cmd_ctx = cmd_ctx;
+    lookup->index = index;
+
+    data = cache_req_data_id_attrs(lookup, cmd_ctx->type, id, NULL);
+    if (data == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to set cache request data!\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = eval_flags(cmd_ctx, data);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "eval_flags failed.\n");
+        goto done;
+    }
+
+    subreq = sss_nss_get_object_send(lookup, cmd_ctx->cli_ctx->ev,
+                                     cmd_ctx->cli_ctx, data,
+                                     cmd_ctx->batch_memcache, NULL, id);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sss_nss_get_object_send() failed\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    tevent_req_set_callback(subreq, sss_nss_getby_id_batch_done, lookup);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(lookup);
+    }
+
+    return ret;
+}
+
+/* Keeps up to SSS_NSS_BATCH_PARALLEL lookups running. Returns true once all
+ * lookups are finished and the reply can be sent. */
+static bool sss_nss_getby_id_batch_next(struct sss_nss_cmd_ctx *cmd_ctx)
+{
+    uint32_t index;
+    errno_t ret;
+
+    while (cmd_ctx->batch_active < SSS_NSS_BATCH_PARALLEL
+            && cmd_ctx->batch_next < cmd_ctx->batch_count) {
+        index = cmd_ctx->batch_next++;
+
+        ret = sss_nss_getby_id_batch_step(cmd_ctx, index);
+        if (ret != EOK) {
+            cmd_ctx->batch[index].error = ret;
+            continue;
+        }
+
+        cmd_ctx->batch_active++;
+    }
+
+    return cmd_ctx->batch_active == 0;
+}
+
+static errno_t sss_nss_getby_id_batch(struct cli_ctx *cli_ctx,
+                                      enum cache_req_type type,
+                                      enum sss_mc_type memcache,
+                                      sss_nss_protocol_fill_packet_fn fill_fn)
+{
+    struct sss_nss_cmd_ctx *cmd_ctx;
+    errno_t ret;
+
+    cmd_ctx = sss_nss_cmd_ctx_create(cli_ctx, cli_ctx, type, fill_fn);
+    if (cmd_ctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_nss_protocol_parse_id_batch(cmd_ctx, cli_ctx, &cmd_ctx->batch,
+                                          &cmd_ctx->batch_count,
+                                          &cmd_ctx->flags);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request message!\n");
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Input: batch of %"PRIu32" IDs\n",
+          cmd_ctx->batch_count);
+
+    cmd_ctx->batch_memcache = memcache;
+
+    if (sss_nss_getby_id_batch_next(cmd_ctx)) {
+        /* No lookup could be started. */
+        sss_nss_protocol_reply_batch(cli_ctx, cmd_ctx->nss_ctx, cmd_ctx,
+                                     fill_fn);
+        talloc_free(cmd_ctx);
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(cmd_ctx);
+        return sss_nss_protocol_done(cli_ctx, ret);
+    }
+
+    return EOK;
+}
+
 static errno_t sss_nss_getby_svc(struct cli_ctx *cli_ctx,
                                  enum cache_req_type type,
                                  const char *protocol,
@@ -623,6 +752,40 @@ done:
     talloc_free(cmd_ctx);
 }
 
+static void sss_nss_getby_id_batch_done(struct tevent_req *subreq)
+{
+    struct sss_nss_batch_lookup *lookup;
+    struct sss_nss_batch_item *item;
+    struct sss_nss_cmd_ctx *cmd_ctx;
+    errno_t ret;
+
+    lookup = tevent_req_callback_data(subreq, struct sss_nss_batch_lookup);
+    cmd_ctx = lookup->cmd_ctx;
+    item = &cmd_ctx->batch[lookup->index];
+
+    ret = sss_nss_get_object_recv(cmd_ctx, subreq, &item->result, NULL);
+    /* this also frees subreq */
+    talloc_free(lookup);
+    if (ret == EOK
+            && (cmd_ctx->flags & SSS_NSS_EX_FLAG_INVALIDATE_CACHE) != 0) {
+        ret = invalidate_cache(cmd_ctx, item->result);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to invalidate cache for "
+                  "[%"PRIu32"].\n", item->id);
+        }
+    }
+    item->error = ret;
+
+    cmd_ctx->batch_active--;
+    if (!sss_nss_getby_id_batch_next(cmd_ctx)) {
+        return;
+    }
+
+    sss_nss_protocol_reply_batch(cmd_ctx->cli_ctx, cmd_ctx->nss_ctx, cmd_ctx,
+                                 cmd_ctx->fill_fn);
+    talloc_free(cmd_ctx);
+}
+
 static void sss_nss_setent_done(struct tevent_req *subreq);
 
 static errno_t sss_nss_setent(struct cli_ctx *cli_ctx,
@@ -925,6 +1088,12 @@ static errno_t sss_nss_cmd_getpwuid_ex(struct cli_ctx *cli_ctx)
                             SSS_MC_PASSWD, sss_nss_protocol_fill_pwent);
 }
 
+static errno_t sss_nss_cmd_getpwuid_batch(struct cli_ctx *cli_ctx)
+{
+    return sss_nss_getby_id_batch(cli_ctx, CACHE_REQ_USER_BY_ID,
+                                  SSS_MC_PASSWD, sss_nss_protocol_fill_pwent);
+}
+
 static errno_t sss_nss_cmd_setpwent(struct cli_ctx *cli_ctx)
 {
     struct sss_nss_ctx *nss_ctx;
@@ -985,6 +1154,12 @@ static errno_t sss_nss_cmd_getgrgid_ex(struct cli_ctx *cli_ctx)
                             SSS_MC_GROUP, sss_nss_protocol_fill_grent);
 }
 
+static errno_t sss_nss_cmd_getgrgid_batch(struct cli_ctx *cli_ctx)
+{
+    return sss_nss_getby_id_batch(cli_ctx, CACHE_REQ_GROUP_BY_ID,
+                                  SSS_MC_GROUP, sss_nss_protocol_fill_grent);
+}
+
 
 static errno_t sss_nss_cmd_setgrent(struct cli_ctx *cli_ctx)
 {
@@ -1393,8 +1568,10 @@ struct sss_cmd_table *get_sss_nss_cmds(void)
         { SSS_NSS_GETLISTBYCERT, sss_nss_cmd_getlistbycert },
         { SSS_NSS_GETPWNAM_EX, sss_nss_cmd_getpwnam_ex },
         { SSS_NSS_GETPWUID_EX, sss_nss_cmd_getpwuid_ex },
+        { SSS_NSS_GETPWUID_BATCH, sss_nss_cmd_getpwuid_batch },
         { SSS_NSS_GETGRNAM_EX, sss_nss_cmd_getgrnam_ex },
         { SSS_NSS_GETGRGID_EX, sss_nss_cmd_getgrgid_ex },
+        { SSS_NSS_GETGRGID_BATCH, sss_nss_cmd_getgrgid_batch },
         { SSS_NSS_INITGR_EX, sss_nss_cmd_initgroups_ex },
         { SSS_NSS_GETHOSTBYNAME, sss_nss_cmd_gethostbyname },
         { SSS_NSS_GETHOSTBYNAME2, sss_nss_cmd_gethostbyname },
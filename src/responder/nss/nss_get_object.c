@@ -22,6 +22,7 @@
 #include <talloc.h>
 
 #include "util/util.h"
+#include "util/mmap_cache.h"
 #include "responder/nss/nss_private.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 
@@ -148,6 +149,54 @@ memcache_delete_entry(struct sss_nss_ctx *nss_ctx,
     return EOK;
 }
 
+static void
+memcache_update_negative_entry(struct sss_nss_ctx *nss_ctx,
+                               const char *name,
+                               uint32_t id,
+                               enum sss_mc_type type,
+                               bool missing)
+{
+    uint32_t neg_type;
+    errno_t ret;
+
+    if (nss_ctx->neg_mc_ctx == NULL) {
+        /* Negative memory cache is disabled. */
+        return;
+    }
+
+    if (name == NULL && id == 0) {
+        /* "root" is not handled by SSSD. */
+        return;
+    }
+
+    switch (type) {
+    case SSS_MC_PASSWD:
+        neg_type = (name != NULL) ? SSS_MC_NEG_USER_NAME : SSS_MC_NEG_UID;
+        break;
+    case SSS_MC_GROUP:
+        neg_type = (name != NULL) ? SSS_MC_NEG_GROUP_NAME : SSS_MC_NEG_GID;
+        break;
+    default:
+        return;
+    }
+
+    /* The key is the name or id exactly as the client sent it, so the
+     * client can find the entry without asking us. */
+    if (missing) {
+        ret = sss_mmap_cache_neg_store(&nss_ctx->neg_mc_ctx, neg_type,
+                                       name, id);
+    } else {
+        ret = sss_mmap_cache_neg_invalidate(&nss_ctx->neg_mc_ctx, neg_type,
+                                            name, id);
+    }
+    if (ret != EOK && ret != ENOENT) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Unable to update negative memory cache entry for '%s' [%u] "
+              "[%d]: %s\n", name == NULL ? "-" : name, id,
+              ret, sss_strerror(ret));
+    }
+}
+
 static struct cache_req_data *
 hybrid_domain_retry_data(TALLOC_CTX *mem_ctx,
                          struct cache_req_data *orig,
@@ -367,6 +416,9 @@ static void sss_nss_get_object_finish_req(struct tevent_req *req,
 
     switch (ret) {
     case EOK:
+        memcache_update_negative_entry(state->nss_ctx, state->input_name,
+                                       state->input_id, state->memcache,
+                                       false);
         tevent_req_done(req);
         break;
     case ENOENT:
@@ -377,6 +429,11 @@ static void sss_nss_get_object_finish_req(struct tevent_req *req,
                                   state->memcache);
         }
 
+        /* And let the clients know it does not exist. */
+        memcache_update_negative_entry(state->nss_ctx, state->input_name,
+                                       state->input_id, state->memcache,
+                                       true);
+
         tevent_req_error(req, ENOENT);
         break;
     default:
@@ -154,6 +154,7 @@ sss_nss_memorycache_invalidate_users(TALLOC_CTX *mem_ctx,
 {
     DEBUG(SSSDBG_TRACE_LIBS, "Invalidating all users in memory cache\n");
     sss_mmap_cache_reset(nctx->pwd_mc_ctx);
+    sss_mmap_cache_reset(nctx->neg_mc_ctx);
 
     return EOK;
 }
@@ -165,6 +166,7 @@ sss_nss_memorycache_invalidate_groups(TALLOC_CTX *mem_ctx,
 {
     DEBUG(SSSDBG_TRACE_LIBS, "Invalidating all groups in memory cache\n");
     sss_mmap_cache_reset(nctx->grp_mc_ctx);
+    sss_mmap_cache_reset(nctx->neg_mc_ctx);
 
     return EOK;
 }
@@ -213,6 +215,19 @@ sss_nss_memorycache_invalidate_group_by_id(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+static errno_t
+sss_nss_memorycache_reset_negative(TALLOC_CTX *mem_ctx,
+                                   struct sbus_request *sbus_req,
+                                   struct sss_nss_ctx *nctx)
+{
+    /* The responder negative cache was reset, the clients must not keep
+     * using the negative entries either. */
+    DEBUG(SSSDBG_TRACE_LIBS, "Invalidating negative memory cache\n");
+    sss_mmap_cache_reset(nctx->neg_mc_ctx);
+
+    return EOK;
+}
+
 errno_t
 sss_nss_register_backend_iface(struct sbus_connection *conn,
                                struct sss_nss_ctx *nss_ctx)
@@ -243,7 +258,11 @@ sss_nss_register_backend_iface(struct sbus_connection *conn,
         SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateAllInitgroups,
                          SSS_BUS_PATH, sss_nss_memorycache_invalidate_initgroups, nss_ctx),
         SBUS_LISTEN_SYNC(sssd_nss_MemoryCache, InvalidateGroupById,
-                         SSS_BUS_PATH, sss_nss_memorycache_invalidate_group_by_id, nss_ctx)
+                         SSS_BUS_PATH, sss_nss_memorycache_invalidate_group_by_id, nss_ctx),
+        SBUS_LISTEN_SYNC(sssd_Responder_NegativeCache, ResetUsers,
+                         SSS_BUS_PATH, sss_nss_memorycache_reset_negative, nss_ctx),
+        SBUS_LISTEN_SYNC(sssd_Responder_NegativeCache, ResetGroups,
+                         SSS_BUS_PATH, sss_nss_memorycache_reset_negative, nss_ctx)
     );
 
     ret = sbus_router_listen_map(conn, listeners);
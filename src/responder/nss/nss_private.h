@@ -93,6 +93,7 @@ struct sss_nss_ctx {
     struct sss_mc_ctx *grp_mc_ctx;
     struct sss_mc_ctx *initgr_mc_ctx;
     struct sss_mc_ctx *sid_mc_ctx;
+    struct sss_mc_ctx *neg_mc_ctx;
 };
 
 struct sss_cmd_table *get_sss_nss_cmds(void);
@@ -99,6 +99,122 @@ done:
     sss_nss_protocol_done(cli_ctx, ret);
 }
 
+void sss_nss_protocol_reply_batch(struct cli_ctx *cli_ctx,
+                                  struct sss_nss_ctx *nss_ctx,
+                                  struct sss_nss_cmd_ctx *cmd_ctx,
+                                  sss_nss_protocol_fill_packet_fn fill_fn)
+{
+    struct sss_nss_batch_item *item;
+    struct cli_protocol *pctx;
+    struct sss_packet *entry;
+    TALLOC_CTX *tmp_ctx;
+    uint32_t num_results = 0;
+    uint32_t num_failed = 0;
+    uint32_t num_entries;
+    uint8_t *entry_body;
+    size_t entry_len;
+    uint8_t *body;
+    size_t body_len;
+    size_t rp;
+    uint32_t i;
+    errno_t ret;
+
+    pctx = talloc_get_type(cli_ctx->protocol_ctx, struct cli_protocol);
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_packet_new(pctx->creq, 0, sss_packet_get_cmd(pctx->creq->in),
+                         &pctx->creq->out);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* Reserve space for number of results and number of failures. */
+    ret = sss_packet_grow(pctx->creq->out, 2 * sizeof(uint32_t));
+    if (ret != EOK) {
+        goto done;
+    }
+    rp = 2 * sizeof(uint32_t);
+
+    for (i = 0; i < cmd_ctx->batch_count; i++) {
+        item = &cmd_ctx->batch[i];
+        if (item->error != EOK) {
+            continue;
+        }
+
+        /* Each entry is filled into its own packet with the usual fill
+         * function and its body without the header is appended. */
+        talloc_free_children(tmp_ctx);
+        ret = sss_packet_new(tmp_ctx, 0, sss_packet_get_cmd(pctx->creq->in),
+                             &entry);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = fill_fn(nss_ctx, cmd_ctx, entry, item->result);
+        if (ret == EOK) {
+            sss_packet_get_body(entry, &entry_body, &entry_len);
+            SAFEALIGN_COPY_UINT32(&num_entries, entry_body, NULL);
+            if (num_entries != 1) {
+                ret = ENOENT;
+            }
+        }
+
+        if (ret != EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Unable to fill entry for id %"PRIu32" "
+                  "[%d]: %s\n", item->id, ret, sss_strerror(ret));
+            item->error = ret;
+            continue;
+        }
+
+        entry_len -= 2 * sizeof(uint32_t);
+        ret = sss_packet_grow(pctx->creq->out, sizeof(uint32_t) + entry_len);
+        if (ret != EOK) {
+            goto done;
+        }
+        sss_packet_get_body(pctx->creq->out, &body, &body_len);
+
+        SAFEALIGN_SET_UINT32(&body[rp], i, &rp);
+        memcpy(&body[rp], entry_body + 2 * sizeof(uint32_t), entry_len);
+        rp += entry_len;
+        num_results++;
+    }
+
+    for (i = 0; i < cmd_ctx->batch_count; i++) {
+        item = &cmd_ctx->batch[i];
+        if (item->error == EOK || item->error == ENOENT) {
+            continue;
+        }
+
+        ret = sss_packet_grow(pctx->creq->out, 2 * sizeof(uint32_t));
+        if (ret != EOK) {
+            goto done;
+        }
+        sss_packet_get_body(pctx->creq->out, &body, &body_len);
+
+        SAFEALIGN_SET_UINT32(&body[rp], i, &rp);
+        SAFEALIGN_SET_UINT32(&body[rp], item->error, &rp);
+        num_failed++;
+    }
+
+    sss_packet_get_body(pctx->creq->out, &body, &body_len);
+    SAFEALIGN_COPY_UINT32(body, &num_results, NULL);
+    SAFEALIGN_COPY_UINT32(body + sizeof(uint32_t), &num_failed, NULL);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Batch of %"PRIu32" ids: %"PRIu32" found, "
+          "%"PRIu32" failed\n", cmd_ctx->batch_count, num_results, num_failed);
+
+    sss_packet_set_error(pctx->creq->out, EOK);
+
+done:
+    talloc_free(tmp_ctx);
+    sss_nss_protocol_done(cli_ctx, ret);
+}
+
 errno_t
 sss_nss_protocol_parse_name(struct cli_ctx *cli_ctx, const char **_rawname)
 {
@@ -245,6 +361,57 @@ sss_nss_protocol_parse_id_ex(struct cli_ctx *cli_ctx, uint32_t *_id,
     return EOK;
 }
 
+errno_t
+sss_nss_protocol_parse_id_batch(TALLOC_CTX *mem_ctx,
+                                struct cli_ctx *cli_ctx,
+                                struct sss_nss_batch_item **_items,
+                                uint32_t *_num_items,
+                                uint32_t *_flags)
+{
+    struct sss_nss_batch_item *items;
+    struct cli_protocol *pctx;
+    uint8_t *body;
+    size_t blen;
+    size_t rp;
+    uint32_t num_ids;
+    uint32_t flags;
+    uint32_t i;
+
+    pctx = talloc_get_type(cli_ctx->protocol_ctx, struct cli_protocol);
+
+    sss_packet_get_body(pctx->creq->in, &body, &blen);
+
+    if (blen < 2 * sizeof(uint32_t)) {
+        return EINVAL;
+    }
+
+    rp = 0;
+    SAFEALIGN_COPY_UINT32(&num_ids, body, &rp);
+    SAFEALIGN_COPY_UINT32(&flags, body + rp, &rp);
+
+    if (num_ids == 0 || num_ids > SSS_NSS_BATCH_MAX_IDS
+            || blen != (2 + num_ids) * sizeof(uint32_t)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid batch request of %"PRIu32" ids "
+              "with body of %zu bytes\n", num_ids, blen);
+        return EINVAL;
+    }
+
+    items = talloc_zero_array(mem_ctx, struct sss_nss_batch_item, num_ids);
+    if (items == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_ids; i++) {
+        SAFEALIGN_COPY_UINT32(&items[i].id, body + rp, &rp);
+    }
+
+    *_items = items;
+    *_num_items = num_ids;
+    *_flags = flags;
+
+    return EOK;
+}
+
 errno_t
 sss_nss_protocol_parse_limit(struct cli_ctx *cli_ctx, uint32_t *_limit)
 {
@@ -32,6 +32,13 @@
 
 struct sss_nss_cmd_ctx;
 
+/* Lookup of a single id of a batch request. */
+struct sss_nss_batch_item {
+    uint32_t id;
+    errno_t error;
+    struct cache_req_result *result;
+};
+
 /**
  * Fill SSSD response packet.
  *
@@ -66,6 +73,13 @@ struct sss_nss_cmd_ctx {
 
     /* For SID lookups. */
     enum sss_id_type sid_id_type;
+
+    /* For batch lookups. */
+    enum sss_mc_type batch_memcache;
+    struct sss_nss_batch_item *batch;
+    uint32_t batch_count;
+    uint32_t batch_next;
+    uint32_t batch_active;
 };
 
 /**
@@ -84,6 +98,15 @@ void sss_nss_protocol_reply(struct cli_ctx *cli_ctx,
                         struct cache_req_result *result,
                         sss_nss_protocol_fill_packet_fn fill_fn);
 
+/**
+ * Create and send SSSD response packet for a batch request, one entry
+ * is filled with fill_fn for each successful lookup in cmd_ctx->batch.
+ */
+void sss_nss_protocol_reply_batch(struct cli_ctx *cli_ctx,
+                                  struct sss_nss_ctx *nss_ctx,
+                                  struct sss_nss_cmd_ctx *cmd_ctx,
+                                  sss_nss_protocol_fill_packet_fn fill_fn);
+
 /* Parse input packet. */
 
 errno_t
@@ -100,6 +123,13 @@ errno_t
 sss_nss_protocol_parse_id_ex(struct cli_ctx *cli_ctx, uint32_t *_id,
                          uint32_t *_flags);
 
+errno_t
+sss_nss_protocol_parse_id_batch(TALLOC_CTX *mem_ctx,
+                                struct cli_ctx *cli_ctx,
+                                struct sss_nss_batch_item **_items,
+                                uint32_t *_num_items,
+                                uint32_t *_flags);
+
 errno_t
 sss_nss_protocol_parse_limit(struct cli_ctx *cli_ctx, uint32_t *_limit);
 
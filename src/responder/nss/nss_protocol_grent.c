@@ -126,12 +126,14 @@ sss_nss_protocol_fill_members(struct sss_packet *packet,
     struct resp_ctx *rctx = nss_ctx->rctx;
     struct ldb_message_element *members[2];
     struct ldb_message_element *el;
-    struct sized_string *name;
+    struct sized_string **names;
     const char *member_name;
     uint32_t num_members = 0;
+    size_t members_len = 0;
     size_t body_len;
     uint8_t *body;
     errno_t ret;
+    uint32_t k;
     int i, j;
 
     tmp_ctx = talloc_new(NULL);
@@ -160,8 +162,16 @@ sss_nss_protocol_fill_members(struct sss_packet *packet,
         goto done;
     }
 
-    sss_packet_get_body(packet, &body, &body_len);
+    names = talloc_array(tmp_ctx, struct sized_string *,
+                         (members[0] == NULL ? 0 : members[0]->num_values)
+                         + (members[1] == NULL ? 0 : members[1]->num_values));
+    if (names == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
+    /* Collect the member names first so the packet is grown only once,
+     * large groups would otherwise be reallocated many times. */
     for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
         el = members[i];
         if (el == NULL) {
@@ -181,25 +191,30 @@ sss_nss_protocol_fill_members(struct sss_packet *packet,
                 }
             }
 
-            ret = sized_domain_name(tmp_ctx, rctx, member_name, &name);
+            ret = sized_domain_name(names, rctx, member_name,
+                                    &names[num_members]);
             if (ret != EOK) {
                 DEBUG(SSSDBG_OP_FAILURE, "Unable to get sized name [%d]: %s\n",
                       ret, sss_strerror(ret));
                 goto done;
             }
 
-            ret = sss_packet_grow(packet, name->len);
-            if (ret != EOK) {
-                goto done;
-            }
-
-            sss_packet_get_body(packet, &body, &body_len);
-            SAFEALIGN_SET_STRING(&body[*_rp], name->str, name->len, _rp);
-
+            members_len += names[num_members]->len;
             num_members++;
         }
     }
 
+    ret = sss_packet_grow(packet, members_len);
+    if (ret != EOK) {
+        num_members = 0;
+        goto done;
+    }
+
+    sss_packet_get_body(packet, &body, &body_len);
+    for (k = 0; k < num_members; k++) {
+        SAFEALIGN_SET_STRING(&body[*_rp], names[k]->str, names[k]->len, _rp);
+    }
+
     ret = EOK;
 
 done:
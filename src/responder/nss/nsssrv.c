@@ -92,6 +92,8 @@ sss_nss_clear_memcache(TALLOC_CTX *mem_ctx,
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "Clearing memory caches.\n");
+    cache_req_hot_cache_flush(nctx->rctx, CACHE_REQ_HOT_ALL);
+
     ret = sss_mmap_cache_reinit(nctx,
                                 -1, /* keep current size */
                                 (time_t) memcache_timeout,
@@ -122,6 +124,18 @@ sss_nss_clear_memcache(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (nctx->neg_mc_ctx != NULL) {
+        ret = sss_mmap_cache_reinit(nctx,
+                                    -1, /* keep current size */
+                                    -1, /* keep negative timeout */
+                                    &nctx->neg_mc_ctx);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "negative mmap cache invalidation failed\n");
+            goto done;
+        }
+    }
+
 done:
     if (unlink(SSS_NSS_MCACHE_DIR"/"CLEAR_MC_FLAG) != 0) {
         if (errno != ENOENT)
@@ -154,6 +168,8 @@ sss_nss_clear_negcache(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    sss_mmap_cache_reset(nctx->neg_mc_ctx);
+
 done:
     return ret;
 }
@@ -280,6 +296,7 @@ static int setup_memcaches(struct sss_nss_ctx *nctx)
     static const size_t SSS_MC_CACHE_GROUP_SIZE     =  6;
     static const size_t SSS_MC_CACHE_INITGROUP_SIZE = 10;
     static const size_t SSS_MC_CACHE_SID_SIZE       =  6;
+    static const size_t SSS_MC_CACHE_NEGATIVE_SIZE  =  4;
 
     int ret;
     int memcache_timeout;
@@ -287,6 +304,8 @@ static int setup_memcaches(struct sss_nss_ctx *nctx)
     int mc_size_group;
     int mc_size_initgroups;
     int mc_size_sid;
+    int mc_size_negative;
+    time_t neg_timeout;
 
     /* Remove the CLEAR_MC_FLAG file if exists. */
     ret = unlink(SSS_NSS_MCACHE_DIR"/"CLEAR_MC_FLAG);
@@ -308,7 +327,7 @@ static int setup_memcaches(struct sss_nss_ctx *nctx)
         return ret;
     }
 
-    /* Get all memcache sizes from confdb (pwd, grp, initgr, sid) */
+    /* Get all memcache sizes from confdb (pwd, grp, initgr, sid, negative) */
 
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
@@ -358,6 +377,18 @@ static int setup_memcaches(struct sss_nss_ctx *nctx)
         return ret;
     }
 
+    ret = confdb_get_int(nctx->rctx->cdb,
+                         CONFDB_NSS_CONF_ENTRY,
+                         CONFDB_NSS_MEMCACHE_SIZE_NEGATIVE,
+                         SSS_MC_CACHE_NEGATIVE_SIZE,
+                         &mc_size_negative);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to get '"CONFDB_NSS_MEMCACHE_SIZE_NEGATIVE
+              "' option from confdb.\n");
+        return ret;
+    }
+
     /* Initialize the fast in-memory caches if they were not disabled */
 
     ret = sss_mmap_cache_init(nctx, "passwd",
@@ -404,6 +435,21 @@ static int setup_memcaches(struct sss_nss_ctx *nctx)
               sss_strerror(ret));
     }
 
+    /* Negative entries must not outlive the responder's own negative cache,
+     * a zero entry_negative_timeout disables this cache as well */
+    neg_timeout = MIN((time_t)memcache_timeout,
+                      (time_t)sss_ncache_get_timeout(nctx->rctx->ncache));
+    ret = sss_mmap_cache_init(nctx, "negative",
+                              SSS_MC_NEGATIVE,
+                              mc_size_negative * SSS_MC_CACHE_SLOTS_PER_MB,
+                              neg_timeout,
+                              &nctx->neg_mc_ctx);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to initialize negative mmap cache: '%s'\n",
+              sss_strerror(ret));
+    }
+
     return EOK;
 }
 
@@ -32,8 +32,12 @@
 
 #define MC_NEXT_BARRIER(val) ((((val) + 1) & 0x00ffffff) | 0xf0000000)
 
-#define MC_RAISE_BARRIER(m) do { \
-    m->b2 = MC_NEXT_BARRIER(m->b1); \
+/* Barrier values are drawn from a per cache counter instead of being derived
+ * from the previous value of b1. A record that was invalidated and reused
+ * would otherwise restart at the same barrier value and a reader that copied
+ * it across the whole invalidate/store cycle could not detect the torn copy */
+#define MC_RAISE_BARRIER(mcc, m) do { \
+    m->b2 = sss_mc_next_barrier(mcc, m->b1); \
     __sync_synchronize(); \
 } while (0)
 
@@ -68,8 +72,46 @@ struct sss_mc_ctx {
 
     uint8_t *data_table;    /* data table address (in mmap) */
     uint32_t dt_size;       /* size of data table */
+
+    struct sss_mc_bucket *bucket_table; /* v2 index address (in mmap) */
+    uint32_t bt_size;       /* size of bucket table */
+    uint32_t nbuckets;      /* number of buckets */
+
+    uint32_t barrier_seq;   /* source of the record/header barrier values */
 };
 
+static inline uint32_t sss_mc_next_barrier(struct sss_mc_ctx *mcc,
+                                           uint32_t cur)
+{
+    uint32_t next;
+
+    do {
+        next = MC_NEXT_BARRIER(mcc->barrier_seq);
+        mcc->barrier_seq++;
+    } while (next == cur);
+
+    return next;
+}
+
+/* Readers walking the hash chains without any lock snapshot the header
+ * seqnum and retry the walk if it changed under them. These two must wrap
+ * every modification of the hash table or of the next1/next2 links. */
+static inline void sss_mc_chains_write_begin(struct sss_mc_ctx *mcc)
+{
+    struct sss_mc_header *h = (struct sss_mc_header *)mcc->mmap_base;
+
+    h->seqnum++;
+    __sync_synchronize();
+}
+
+static inline void sss_mc_chains_write_end(struct sss_mc_ctx *mcc)
+{
+    struct sss_mc_header *h = (struct sss_mc_header *)mcc->mmap_base;
+
+    __sync_synchronize();
+    h->seqnum++;
+}
+
 #define MC_FIND_BIT(base, num) \
     uint32_t n = (num); \
     uint8_t *b = (base) + n / 8; \
@@ -196,6 +238,146 @@ static uint32_t sss_mc_hash(struct sss_mc_ctx *mcc,
     return murmurhash3(key, len, mcc->seed) % MC_HT_ELEMS(mcc->ht_size);
 }
 
+static const char *mc_type_to_str(enum sss_mc_type type);
+
+/* Version 2 bucket index. The index is only an accelerator for clients,
+ * the responder itself keeps using the version 1 chains. If the index
+ * can not take an entry the key is simply not indexed and version 2
+ * clients will ask the responder for it. */
+
+static inline void sss_mc_bucket_write_begin(struct sss_mc_bucket *b)
+{
+    b->seq++;
+    __sync_synchronize();
+}
+
+static inline void sss_mc_bucket_write_end(struct sss_mc_bucket *b)
+{
+    __sync_synchronize();
+    b->seq++;
+}
+
+static void sss_mc_index_add(struct sss_mc_ctx *mcc, uint32_t hash,
+                             uint16_t fp, uint32_t slot)
+{
+    struct sss_mc_bucket *b;
+    uint32_t home;
+    uint32_t cur;
+    uint32_t i;
+    int free_entry = -1;
+    int j;
+
+    if (mcc->bucket_table == NULL || hash >= MC_HT_ELEMS(mcc->ht_size)) {
+        return;
+    }
+
+    home = hash % mcc->nbuckets;
+
+    /* first free entry on the probe sequence, unless the key is already
+     * indexed (the record was rewritten in place) */
+    for (i = 0; i < mcc->nbuckets; i++) {
+        b = &mcc->bucket_table[(home + i) % mcc->nbuckets];
+        for (j = 0; j < MC_BUCKET_ENTRIES; j++) {
+            if (b->fp[j] == fp && b->slot[j] == slot) {
+                return;
+            }
+            if (free_entry == -1 && b->fp[j] == 0) {
+                free_entry = j;
+            }
+        }
+        if (free_entry != -1) {
+            break;
+        }
+    }
+
+    if (free_entry == -1) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "mmap cache index of type '%s' is full\n",
+              mc_type_to_str(mcc->type));
+        return;
+    }
+
+    /* Account for the entry in all the buckets it skips before it becomes
+     * visible so a concurrent lookup never stops probing too early */
+    for (cur = 0; cur < i; cur++) {
+        b = &mcc->bucket_table[(home + cur) % mcc->nbuckets];
+        sss_mc_bucket_write_begin(b);
+        b->overflow++;
+        sss_mc_bucket_write_end(b);
+    }
+
+    b = &mcc->bucket_table[(home + i) % mcc->nbuckets];
+    sss_mc_bucket_write_begin(b);
+    b->slot[free_entry] = slot;
+    b->fp[free_entry] = fp;
+    sss_mc_bucket_write_end(b);
+}
+
+static void sss_mc_index_rm(struct sss_mc_ctx *mcc, uint32_t hash,
+                            uint16_t fp, uint32_t slot)
+{
+    struct sss_mc_bucket *b;
+    uint32_t home;
+    uint32_t cur;
+    uint32_t i;
+    int j;
+
+    if (mcc->bucket_table == NULL || hash >= MC_HT_ELEMS(mcc->ht_size)) {
+        return;
+    }
+
+    home = hash % mcc->nbuckets;
+
+    for (i = 0; i < mcc->nbuckets; i++) {
+        b = &mcc->bucket_table[(home + i) % mcc->nbuckets];
+        for (j = 0; j < MC_BUCKET_ENTRIES; j++) {
+            if (b->fp[j] == fp && b->slot[j] == slot) {
+                break;
+            }
+        }
+        if (j < MC_BUCKET_ENTRIES) {
+            break;
+        }
+        if (b->overflow == 0) {
+            /* not indexed */
+            return;
+        }
+    }
+    if (i == mcc->nbuckets) {
+        return;
+    }
+
+    sss_mc_bucket_write_begin(b);
+    b->fp[j] = 0;
+    b->slot[j] = MC_INVALID_VAL32;
+    sss_mc_bucket_write_end(b);
+
+    for (cur = 0; cur < i; cur++) {
+        b = &mcc->bucket_table[(home + cur) % mcc->nbuckets];
+        sss_mc_bucket_write_begin(b);
+        b->overflow--;
+        sss_mc_bucket_write_end(b);
+    }
+}
+
+static void sss_mc_index_add_rec(struct sss_mc_ctx *mcc,
+                                 struct sss_mc_rec *rec)
+{
+    uint32_t slot = MC_PTR_TO_SLOT(mcc->data_table, rec);
+
+    sss_mc_index_add(mcc, rec->hash1, rec->fps & 0xffff, slot);
+    sss_mc_index_add(mcc, rec->hash2, rec->fps >> 16, slot);
+}
+
+static void sss_mc_index_rm_rec(struct sss_mc_ctx *mcc,
+                                struct sss_mc_rec *rec)
+{
+    uint32_t slot = MC_PTR_TO_SLOT(mcc->data_table, rec);
+
+    sss_mc_index_rm(mcc, rec->hash1, rec->fps & 0xffff, slot);
+    sss_mc_index_rm(mcc, rec->hash2, rec->fps >> 16, slot);
+}
+
 static void sss_mc_add_rec_to_chain(struct sss_mc_ctx *mcc,
                                     struct sss_mc_rec *rec,
                                     uint32_t hash)
@@ -294,11 +476,15 @@ static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
         return;
     }
 
+    sss_mc_chains_write_begin(mcc);
+
     /* Remove from hash chains */
     /* hash chain 1 */
     sss_mc_rm_rec_from_chain(mcc, rec, rec->hash1);
     /* hash chain 2 */
     sss_mc_rm_rec_from_chain(mcc, rec, rec->hash2);
+    /* and from the index */
+    sss_mc_index_rm_rec(mcc, rec);
 
     /* Clear from free_table */
     sss_mc_free_slots(mcc, rec);
@@ -313,7 +499,10 @@ static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
     rec->next2 = MC_INVALID_VAL32;
     rec->hash1 = MC_INVALID_VAL32;
     rec->hash2 = MC_INVALID_VAL32;
+    rec->fps = MC_INVALID_VAL32;
     MC_LOWER_BARRIER(rec);
+
+    sss_mc_chains_write_end(mcc);
 }
 
 static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
@@ -381,6 +570,8 @@ static const char *mc_type_to_str(enum sss_mc_type type)
         return "INITGROUPS";
     case SSS_MC_SID:
         return "SID";
+    case SSS_MC_NEGATIVE:
+        return "NEGATIVE";
     default:
         return "-UNKNOWN-";
     }
@@ -504,6 +695,9 @@ static errno_t sss_mc_get_strs_offset(struct sss_mc_ctx *mcc,
     case SSS_MC_SID:
         *_offset = offsetof(struct sss_mc_sid_data, sid);
         return EOK;
+    case SSS_MC_NEGATIVE:
+        *_offset = offsetof(struct sss_mc_neg_data, key);
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -527,6 +721,9 @@ static errno_t sss_mc_get_strs_len(struct sss_mc_ctx *mcc,
     case SSS_MC_SID:
         *_len = ((struct sss_mc_sid_data *)&rec->data)->sid_len;
         return EOK;
+    case SSS_MC_NEGATIVE:
+        *_len = ((struct sss_mc_neg_data *)&rec->data)->key_len;
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -633,6 +830,11 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
         old_slots = MC_SIZE_TO_SLOTS(old_rec->len);
 
         if (old_slots == num_slots) {
+            /* the keys may change, the caller indexes the record again
+             * once it is rewritten */
+            sss_mc_chains_write_begin(mcc);
+            sss_mc_index_rm_rec(mcc, old_rec);
+            sss_mc_chains_write_end(mcc);
             *_rec = old_rec;
             return EOK;
         }
@@ -660,7 +862,7 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
     rec->len = rec_len;
     rec->next1 = MC_INVALID_VAL;
     rec->next2 = MC_INVALID_VAL;
-    rec->padding = MC_INVALID_VAL;
+    rec->fps = MC_INVALID_VAL;
     MC_LOWER_BARRIER(rec);
 
     /* and now mark slots as used */
@@ -678,19 +880,30 @@ static inline void sss_mmap_set_rec_header(struct sss_mc_ctx *mcc,
                                            const char *key1, size_t key1_len,
                                            const char *key2, size_t key2_len)
 {
+    uint32_t h1;
+    uint32_t h2;
+
+    h1 = murmurhash3(key1, key1_len, mcc->seed);
+    h2 = murmurhash3(key2, key2_len, mcc->seed);
+
     rec->len = len;
     rec->expire = time(NULL) + ttl;
-    rec->hash1 = sss_mc_hash(mcc, key1, key1_len);
-    rec->hash2 = sss_mc_hash(mcc, key2, key2_len);
+    rec->hash1 = h1 % MC_HT_ELEMS(mcc->ht_size);
+    rec->hash2 = h2 % MC_HT_ELEMS(mcc->ht_size);
+    rec->fps = sss_mc_fingerprint(h1)
+               | ((uint32_t)sss_mc_fingerprint(h2) << 16);
 }
 
 static inline void sss_mmap_chain_in_rec(struct sss_mc_ctx *mcc,
                                          struct sss_mc_rec *rec)
 {
+    sss_mc_chains_write_begin(mcc);
     /* name first */
     sss_mc_add_rec_to_chain(mcc, rec, rec->hash1);
     /* then uid/gid */
     sss_mc_add_rec_to_chain(mcc, rec, rec->hash2);
+    sss_mc_index_add_rec(mcc, rec);
+    sss_mc_chains_write_end(mcc);
 }
 
 /***************************************************************************
@@ -826,7 +1039,7 @@ errno_t sss_mmap_cache_pw_store(struct sss_mc_ctx **_mcc,
     data = (struct sss_mc_pwd_data *)rec->data;
     pos = 0;
 
-    MC_RAISE_BARRIER(rec);
+    MC_RAISE_BARRIER(mcc, rec);
 
     /* header */
     sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
@@ -973,7 +1186,7 @@ int sss_mmap_cache_gr_store(struct sss_mc_ctx **_mcc,
     data = (struct sss_mc_grp_data *)rec->data;
     pos = 0;
 
-    MC_RAISE_BARRIER(rec);
+    MC_RAISE_BARRIER(mcc, rec);
 
     /* header */
     sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
@@ -1105,7 +1318,7 @@ errno_t sss_mmap_cache_initgr_store(struct sss_mc_ctx **_mcc,
     data = (struct sss_mc_initgr_data *)rec->data;
     pos = 0;
 
-    MC_RAISE_BARRIER(rec);
+    MC_RAISE_BARRIER(mcc, rec);
 
     sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
                             name->str, name->len,
@@ -1176,7 +1389,7 @@ errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
     }
 
     data = (struct sss_mc_sid_data *)rec->data;
-    MC_RAISE_BARRIER(rec);
+    MC_RAISE_BARRIER(mcc, rec);
 
     sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
                             sid->str, sid->len, idkey, strlen(idkey) + 1);
@@ -1194,6 +1407,128 @@ errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
     return EOK;
 }
 
+/***************************************************************************
+ * negative cache
+ ***************************************************************************/
+
+static errno_t sss_mc_neg_key(TALLOC_CTX *mem_ctx,
+                              uint32_t type,
+                              const char *name,
+                              uint32_t id,
+                              char **_key)
+{
+    char *key;
+
+    switch (type) {
+    case SSS_MC_NEG_USER_NAME:
+    case SSS_MC_NEG_GROUP_NAME:
+        if (name == NULL) {
+            return EINVAL;
+        }
+        key = talloc_asprintf(mem_ctx, SSS_MC_NEG_NAME_KEY_FMT,
+                              (int)type, name);
+        break;
+    case SSS_MC_NEG_UID:
+    case SSS_MC_NEG_GID:
+        key = talloc_asprintf(mem_ctx, SSS_MC_NEG_ID_KEY_FMT,
+                              (int)type, (unsigned long)id);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Unknown negative cache entry type %u\n", type);
+        return EINVAL;
+    }
+
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    *_key = key;
+    return EOK;
+}
+
+errno_t sss_mmap_cache_neg_store(struct sss_mc_ctx **_mcc,
+                                 uint32_t type,
+                                 const char *name,
+                                 uint32_t id)
+{
+    struct sss_mc_ctx *mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_neg_data *data;
+    struct sized_string key;
+    char *keystr = NULL;
+    size_t rec_len;
+    int ret;
+
+    ret = sss_mmap_cache_validate_or_reinit(_mcc);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    mcc = *_mcc;
+
+    ret = sss_mc_neg_key(NULL, type, name, id, &keystr);
+    if (ret != EOK) {
+        return ret;
+    }
+    to_sized_string(&key, keystr);
+
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_neg_data) +
+              key.len;
+    if (rec_len > mcc->dt_size) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, &key, &rec);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    data = (struct sss_mc_neg_data *)rec->data;
+    MC_RAISE_BARRIER(mcc, rec);
+
+    /* there is a single key, it is chained on both hashes */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            key.str, key.len, key.str, key.len);
+
+    data->name = MC_PTR_DIFF(data->key, data);
+    data->type = type;
+    data->id = id;
+    data->key_len = key.len;
+    memcpy(data->key, key.str, key.len);
+
+    MC_LOWER_BARRIER(rec);
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    ret = EOK;
+
+done:
+    talloc_free(keystr);
+    return ret;
+}
+
+errno_t sss_mmap_cache_neg_invalidate(struct sss_mc_ctx **_mcc,
+                                      uint32_t type,
+                                      const char *name,
+                                      uint32_t id)
+{
+    struct sized_string key;
+    char *keystr = NULL;
+    errno_t ret;
+
+    ret = sss_mc_neg_key(NULL, type, name, id, &keystr);
+    if (ret != EOK) {
+        return ret;
+    }
+    to_sized_string(&key, keystr);
+
+    ret = sss_mmap_cache_invalidate(_mcc, &key);
+    talloc_free(keystr);
+    return ret;
+}
+
 /***************************************************************************
  * initialization
  ***************************************************************************/
@@ -1311,13 +1646,28 @@ static errno_t sss_mc_create_file(struct sss_mc_ctx *mc_ctx)
     return ret;
 }
 
+static void sss_mc_header_v2_update(struct sss_mc_ctx *mc_ctx)
+{
+    struct sss_mc_header_v2 *h;
+
+    h = MC_PTR_ADD(mc_ctx->mmap_base, MC_HEADER_SIZE);
+    MC_RAISE_BARRIER(mc_ctx, h);
+    h->magic = SSS_MC_V2_MAGIC;
+    h->major_vno = SSS_MC_V2_MAJOR_VNO;
+    h->minor_vno = SSS_MC_V2_MINOR_VNO;
+    h->nbuckets = mc_ctx->nbuckets;
+    h->bt_size = mc_ctx->bt_size;
+    h->bucket_table = MC_PTR_DIFF(mc_ctx->bucket_table, mc_ctx->mmap_base);
+    MC_LOWER_BARRIER(h);
+}
+
 static void sss_mc_header_update(struct sss_mc_ctx *mc_ctx, int status)
 {
     struct sss_mc_header *h;
 
     /* update header using barriers */
     h = (struct sss_mc_header *)mc_ctx->mmap_base;
-    MC_RAISE_BARRIER(h);
+    MC_RAISE_BARRIER(mc_ctx, h);
     if (status == SSS_MC_HEADER_ALIVE) {
         /* no reason to update anything else if the file is recycled or
          * right before reset */
@@ -1330,7 +1680,9 @@ static void sss_mc_header_update(struct sss_mc_ctx *mc_ctx, int status)
         h->major_vno = SSS_MC_MAJOR_VNO;
         h->minor_vno = SSS_MC_MINOR_VNO;
         h->seed = mc_ctx->seed;
-        h->reserved = 0;
+
+        /* must be in place before clients can see the cache alive */
+        sss_mc_header_v2_update(mc_ctx);
     }
     h->status = status;
     MC_LOWER_BARRIER(h);
@@ -1378,6 +1730,8 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     static const int PAYLOAD_FACTOR = 2;
 
     struct sss_mc_ctx *mc_ctx = NULL;
+    size_t data_offset;
+    size_t bt_offset;
     int ret, dret;
     char *filename;
 
@@ -1432,10 +1786,18 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     mc_ctx->ht_size = MC_HT_SIZE(2 * n_elem / PAYLOAD_FACTOR);
     mc_ctx->dt_size = n_elem * MC_SLOT_SIZE;
     mc_ctx->ft_size = n_elem / 8; /* 1 bit per slot */
-    mc_ctx->mmap_size = MC_HEADER_SIZE +
-                        MC_ALIGN64(mc_ctx->dt_size) +
-                        MC_ALIGN64(mc_ctx->ft_size) +
-                        MC_ALIGN64(mc_ctx->ht_size);
+    mc_ctx->nbuckets = MC_HT_ELEMS(mc_ctx->ht_size) / MC_HT_ELEMS_PER_BUCKET;
+    mc_ctx->bt_size = mc_ctx->nbuckets * sizeof(struct sss_mc_bucket);
+
+    /* header, v2 header, data, free and hash tables and finally the
+     * cache line aligned bucket table */
+    data_offset = MC_ALIGN_CL(MC_HEADER_SIZE +
+                              sizeof(struct sss_mc_header_v2));
+    bt_offset = MC_ALIGN_CL(data_offset +
+                            MC_ALIGN64(mc_ctx->dt_size) +
+                            MC_ALIGN64(mc_ctx->ft_size) +
+                            MC_ALIGN64(mc_ctx->ht_size));
+    mc_ctx->mmap_size = bt_offset + mc_ctx->bt_size;
 
 
     ret = sss_mc_create_file(mc_ctx);
@@ -1472,15 +1834,17 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
         goto done;
     }
 
-    mc_ctx->data_table = MC_PTR_ADD(mc_ctx->mmap_base, MC_HEADER_SIZE);
+    mc_ctx->data_table = MC_PTR_ADD(mc_ctx->mmap_base, data_offset);
     mc_ctx->free_table = MC_PTR_ADD(mc_ctx->data_table,
                                     MC_ALIGN64(mc_ctx->dt_size));
     mc_ctx->hash_table = MC_PTR_ADD(mc_ctx->free_table,
                                     MC_ALIGN64(mc_ctx->ft_size));
+    mc_ctx->bucket_table = MC_PTR_ADD(mc_ctx->mmap_base, bt_offset);
 
     memset(mc_ctx->data_table, 0xff, mc_ctx->dt_size);
     memset(mc_ctx->free_table, 0x00, mc_ctx->ft_size);
     memset(mc_ctx->hash_table, 0xff, mc_ctx->ht_size);
+    memset(mc_ctx->bucket_table, 0x00, mc_ctx->bt_size);
 
     /* generate a pseudo-random seed.
      * Needed to fend off dictionary based collision attacks */
@@ -1586,9 +1950,12 @@ void sss_mmap_cache_reset(struct sss_mc_ctx *mc_ctx)
     sss_mc_header_update(mc_ctx, SSS_MC_HEADER_UNINIT);
 
     /* Reset the mmapped area */
+    sss_mc_chains_write_begin(mc_ctx);
     memset(mc_ctx->data_table, 0xff, mc_ctx->dt_size);
     memset(mc_ctx->free_table, 0x00, mc_ctx->ft_size);
     memset(mc_ctx->hash_table, 0xff, mc_ctx->ht_size);
+    memset(mc_ctx->bucket_table, 0x00, mc_ctx->bt_size);
+    sss_mc_chains_write_end(mc_ctx);
 
     sss_mc_header_update(mc_ctx, SSS_MC_HEADER_ALIVE);
 }
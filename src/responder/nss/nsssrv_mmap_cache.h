@@ -30,6 +30,7 @@ enum sss_mc_type {
     SSS_MC_GROUP,
     SSS_MC_INITGROUPS,
     SSS_MC_SID,
+    SSS_MC_NEGATIVE,
 };
 
 errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
@@ -62,6 +63,11 @@ errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
                                  uint32_t type,          /* enum sss_id_type*/
                                  bool explicit_lookup);  /* false ~ by_id(), true ~ by_uid/gid() */
 
+errno_t sss_mmap_cache_neg_store(struct sss_mc_ctx **_mcc,
+                                 uint32_t type,     /* enum sss_mc_neg_type */
+                                 const char *name,  /* NULL for id types */
+                                 uint32_t id);
+
 errno_t sss_mmap_cache_pw_invalidate(struct sss_mc_ctx **_mcc,
                                      const struct sized_string *name);
 
@@ -75,6 +81,11 @@ errno_t sss_mmap_cache_gr_invalidate_gid(struct sss_mc_ctx **_mcc, gid_t gid);
 errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx **_mcc,
                                          const struct sized_string *name);
 
+errno_t sss_mmap_cache_neg_invalidate(struct sss_mc_ctx **_mcc,
+                                      uint32_t type, /* enum sss_mc_neg_type */
+                                      const char *name,
+                                      uint32_t id);
+
 errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx,
                               size_t n_elem,
                               time_t timeout, struct sss_mc_ctx **mc_ctx);
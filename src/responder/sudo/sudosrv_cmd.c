@@ -38,8 +38,6 @@ static errno_t sudosrv_cmd_send_reply(struct sudo_cmd_ctx *cmd_ctx,
                                       size_t response_len)
 {
     errno_t ret;
-    uint8_t *packet_body = NULL;
-    size_t packet_len = 0;
     struct cli_ctx *cli_ctx = cmd_ctx->cli_ctx;
     struct cli_protocol *pctx;
     TALLOC_CTX *tmp_ctx;
@@ -59,14 +57,15 @@ static errno_t sudosrv_cmd_send_reply(struct sudo_cmd_ctx *cmd_ctx,
         goto done;
     }
 
-    ret = sss_packet_grow(pctx->creq->out, response_len);
+    /* The response may contain a large number of rules, it is sent as it
+     * is instead of being copied into the packet. */
+    ret = sss_packet_append_buffer(pctx->creq->out, response_body,
+                                   response_len);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Unable to create response: %s\n", strerror(ret));
         goto done;
     }
-    sss_packet_get_body(pctx->creq->out, &packet_body, &packet_len);
-    memcpy(packet_body, response_body, response_len);
 
     sss_packet_set_error(pctx->creq->out, EOK);
     sss_cmd_done(cmd_ctx->cli_ctx, cmd_ctx);
@@ -27,159 +27,117 @@
 #include "util/util.h"
 #include "responder/sudo/sudosrv_private.h"
 
-static int sudosrv_response_append_string(TALLOC_CTX *mem_ctx,
-                                          const char *str,
-                                          size_t str_len,
-                                          uint8_t **_response_body,
-                                          size_t *_response_len)
+/* The response is built in a buffer of the exact size computed in advance,
+ * so large rule sets are not copied over and over again while the buffer
+ * grows. */
+
+static void sudosrv_response_append_string(const char *str,
+                                           size_t str_len,
+                                           uint8_t *response_body,
+                                           size_t *_response_len)
 {
-    size_t response_len = *_response_len;
-    uint8_t *response_body = *_response_body;
-
-    response_body = talloc_realloc(mem_ctx, response_body, uint8_t,
-                                   response_len + (str_len * sizeof(char)));
-    if (response_body == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_realloc() failed\n");
-        return ENOMEM;
-    }
-    memcpy(response_body + response_len, str, str_len);
-    response_len += str_len;
-
-    *_response_body = response_body;
-    *_response_len = response_len;
+    memcpy(response_body + *_response_len, str, str_len);
+    *_response_len += str_len;
+}
 
-    return EOK;
+static void sudosrv_response_append_uint32(uint32_t number,
+                                           uint8_t *response_body,
+                                           size_t *_response_len)
+{
+    SAFEALIGN_SET_UINT32(response_body + *_response_len, number,
+                         _response_len);
 }
 
-static int sudosrv_response_append_uint32(TALLOC_CTX *mem_ctx,
-                                          uint32_t number,
-                                          uint8_t **_response_body,
-                                          size_t *_response_len)
+static errno_t sudosrv_response_attr_size(const char *name,
+                                          unsigned int values_num,
+                                          struct ldb_val *values,
+                                          size_t *_size)
 {
-    size_t response_len = *_response_len;
-    uint8_t *response_body = *_response_body;
+    const char *strval;
+    size_t size;
+    unsigned int i;
 
-    response_body = talloc_realloc(mem_ctx, response_body, uint8_t,
-                                   response_len + sizeof(uint32_t));
-    if (response_body == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_realloc() failed\n");
-        return ENOMEM;
+    /* attr name and values count */
+    size = strlen(name) + 1 + sizeof(uint32_t);
+
+    for (i = 0; i < values_num; i++) {
+        strval = (const char *) values[i].data;
+
+        if (strlen((strval)) != values[i].length) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "value is not a string\n");
+            return EINVAL;
+        }
+
+        size += values[i].length + 1;
     }
-    SAFEALIGN_SET_UINT32(response_body + response_len, number, &response_len);
 
-    *_response_body = response_body;
-    *_response_len = response_len;
+    *_size += size;
 
     return EOK;
 }
 
-static int sudosrv_response_append_attr(TALLOC_CTX *mem_ctx,
-                                        const char *name,
-                                        unsigned int values_num,
-                                        struct ldb_val *values,
-                                        uint8_t **_response_body,
-                                        size_t *_response_len)
+static void sudosrv_response_append_attr(const char *name,
+                                         unsigned int values_num,
+                                         struct ldb_val *values,
+                                         uint8_t *response_body,
+                                         size_t *_response_len)
 {
-    uint8_t *response_body = *_response_body;
-    size_t response_len = *_response_len;
-    TALLOC_CTX *tmp_ctx = NULL;
-    unsigned int i = 0;
-    int ret = EOK;
-    const char *strval;
-
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new() failed\n");
-        return ENOMEM;
-    }
+    unsigned int i;
 
     /* attr name */
-    ret = sudosrv_response_append_string(tmp_ctx, name, strlen(name) + 1,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto done;
-    }
+    sudosrv_response_append_string(name, strlen(name) + 1,
+                                   response_body, _response_len);
 
     /* values count */
-    ret = sudosrv_response_append_uint32(tmp_ctx, values_num,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto done;
-    }
+    sudosrv_response_append_uint32(values_num, response_body, _response_len);
 
     /* values */
     for (i = 0; i < values_num; i++) {
-        strval = (const char *) values[i].data;
+        DEBUG(SSSDBG_TRACE_INTERNAL, "%s:%s\n",
+              name, (const char *) values[i].data);
+        sudosrv_response_append_string((const char *) values[i].data,
+                                       values[i].length + 1,
+                                       response_body, _response_len);
+    }
+}
 
-        if (strlen((strval)) != values[i].length) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "value is not a string\n");
-            ret = EINVAL;
-            goto done;
-        }
+static errno_t sudosrv_response_rule_size(int attrs_num,
+                                          struct ldb_message_element *attrs,
+                                          size_t *_size)
+{
+    errno_t ret;
+    int i;
+
+    /* attrs count */
+    *_size += sizeof(uint32_t);
 
-        ret = sudosrv_response_append_string(tmp_ctx,
-                                             strval,
-                                             values[i].length + 1,
-                                             &response_body, &response_len);
-        DEBUG(SSSDBG_TRACE_INTERNAL, "%s:%s\n", name, strval);
+    for (i = 0; i < attrs_num; i++) {
+        ret = sudosrv_response_attr_size(attrs[i].name, attrs[i].num_values,
+                                         attrs[i].values, _size);
         if (ret != EOK) {
-            goto done;
+            return ret;
         }
     }
 
-    *_response_body = talloc_steal(mem_ctx, response_body);
-    *_response_len = response_len;
-
-    ret = EOK;
-
-done:
-    talloc_free(tmp_ctx);
-    return ret;
+    return EOK;
 }
 
-static int sudosrv_response_append_rule(TALLOC_CTX *mem_ctx,
-                                        int attrs_num,
-                                        struct ldb_message_element *attrs,
-                                        uint8_t **_response_body,
-                                        size_t *_response_len)
+static void sudosrv_response_append_rule(int attrs_num,
+                                         struct ldb_message_element *attrs,
+                                         uint8_t *response_body,
+                                         size_t *_response_len)
 {
-    uint8_t *response_body = *_response_body;
-    size_t response_len = *_response_len;
-    TALLOC_CTX *tmp_ctx = NULL;
-    int i = 0;
-    int ret = EOK;
-
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new() failed\n");
-        return ENOMEM;
-    }
+    int i;
 
     /* attrs count */
-    ret = sudosrv_response_append_uint32(tmp_ctx, attrs_num,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto done;
-    }
+    sudosrv_response_append_uint32(attrs_num, response_body, _response_len);
 
     /* attrs */
     for (i = 0; i < attrs_num; i++) {
-        ret = sudosrv_response_append_attr(tmp_ctx, attrs[i].name,
-                                           attrs[i].num_values, attrs[i].values,
-                                           &response_body, &response_len);
-        if (ret != EOK) {
-            goto done;
-        }
+        sudosrv_response_append_attr(attrs[i].name, attrs[i].num_values,
+                                     attrs[i].values,
+                                     response_body, _response_len);
     }
-
-    *_response_body = talloc_steal(mem_ctx, response_body);
-    *_response_len = response_len;
-
-    ret = EOK;
-
-done:
-    talloc_free(tmp_ctx);
-    return ret;
 }
 
 /*
@@ -198,23 +156,35 @@ errno_t sudosrv_build_response(TALLOC_CTX *mem_ctx,
                                size_t *_response_len)
 {
     uint8_t *response_body = NULL;
+    size_t response_size;
     size_t response_len = 0;
-    TALLOC_CTX *tmp_ctx = NULL;
     uint32_t i = 0;
-    errno_t ret = EOK;
+    errno_t ret;
 
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new() failed\n");
+    /* error code */
+    response_size = sizeof(uint32_t);
+
+    if (error == SSS_SUDO_ERROR_OK) {
+        /* domain name and rules count */
+        response_size += 1 + sizeof(uint32_t);
+
+        for (i = 0; i < rules_num; i++) {
+            ret = sudosrv_response_rule_size(rules[i]->num, rules[i]->a,
+                                             &response_size);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    response_body = talloc_array(mem_ctx, uint8_t, response_size);
+    if (response_body == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_array() failed\n");
         return ENOMEM;
     }
 
     /* error code */
-    ret = sudosrv_response_append_uint32(tmp_ctx, error,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto fail;
-    }
+    sudosrv_response_append_uint32(error, response_body, &response_len);
     DEBUG(SSSDBG_TRACE_INTERNAL, "error: [%"PRIu32"]\n", error);
 
     if (error != SSS_SUDO_ERROR_OK) {
@@ -223,39 +193,24 @@ errno_t sudosrv_build_response(TALLOC_CTX *mem_ctx,
 
     /* domain name - deprecated
      * TODO: when possible change the protocol */
-    ret = sudosrv_response_append_string(tmp_ctx, "\0", 1,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto fail;
-    }
+    sudosrv_response_append_string("\0", 1, response_body, &response_len);
 
     /* rules count */
-    ret = sudosrv_response_append_uint32(tmp_ctx, rules_num,
-                                         &response_body, &response_len);
-    if (ret != EOK) {
-        goto fail;
-    }
+    sudosrv_response_append_uint32(rules_num, response_body, &response_len);
     DEBUG(SSSDBG_TRACE_INTERNAL, "rules_num: [%"PRIu32"]\n", rules_num);
 
     /* rules */
     for (i = 0; i < rules_num; i++) {
         DEBUG(SSSDBG_TRACE_INTERNAL, "rule [%"PRIu32"]/[%"PRIu32"]\n", i+1, rules_num);
-        ret = sudosrv_response_append_rule(tmp_ctx, rules[i]->num, rules[i]->a,
-                                           &response_body, &response_len);
-        if (ret != EOK) {
-            goto fail;
-        }
+        sudosrv_response_append_rule(rules[i]->num, rules[i]->a,
+                                     response_body, &response_len);
     }
 
 done:
-    *_response_body = talloc_steal(mem_ctx, response_body);
+    *_response_body = response_body;
     *_response_len = response_len;
 
-    ret = EOK;
-
-fail:
-    talloc_free(tmp_ctx);
-    return ret;
+    return EOK;
 }
 
 errno_t sudosrv_parse_query(TALLOC_CTX *mem_ctx,
@@ -25,6 +25,7 @@
 #include <errno.h>
 
 #include <sys/param.h> /* for MIN() */
+#include <time.h>
 
 #include "sss_client/sss_cli.h"
 #include "sss_client/nss_mc.h"
@@ -531,3 +532,498 @@ int sss_nss_getgrouplist_timeout(const char *name, gid_t group,
 
     return ret;
 }
+
+/* Copy a passwd entry into a single allocation that is released with free() */
+static struct passwd *sss_nss_pw_dup(const struct passwd *pw)
+{
+    struct passwd *res;
+    const char *strs[5] = { pw->pw_name, pw->pw_passwd, pw->pw_gecos,
+                            pw->pw_dir, pw->pw_shell };
+    char **dest[5];
+    size_t lens[5];
+    size_t size;
+    char *p;
+    size_t c;
+
+    size = sizeof(struct passwd);
+    for (c = 0; c < 5; c++) {
+        lens[c] = strlen(strs[c]) + 1;
+        size += lens[c];
+    }
+
+    res = malloc(size);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    res->pw_uid = pw->pw_uid;
+    res->pw_gid = pw->pw_gid;
+    dest[0] = &res->pw_name;
+    dest[1] = &res->pw_passwd;
+    dest[2] = &res->pw_gecos;
+    dest[3] = &res->pw_dir;
+    dest[4] = &res->pw_shell;
+
+    p = (char *) (res + 1);
+    for (c = 0; c < 5; c++) {
+        memcpy(p, strs[c], lens[c]);
+        *dest[c] = p;
+        p += lens[c];
+    }
+
+    return res;
+}
+
+/* Copy a group entry into a single allocation that is released with free() */
+static struct group *sss_nss_gr_dup(const struct group *gr)
+{
+    struct group *res;
+    size_t name_len;
+    size_t passwd_len;
+    size_t mem_num;
+    size_t size;
+    size_t len;
+    char *p;
+    size_t c;
+
+    name_len = strlen(gr->gr_name) + 1;
+    passwd_len = strlen(gr->gr_passwd) + 1;
+    size = sizeof(struct group) + name_len + passwd_len;
+    for (mem_num = 0; gr->gr_mem[mem_num] != NULL; mem_num++) {
+        size += strlen(gr->gr_mem[mem_num]) + 1;
+    }
+    size += (mem_num + 1) * sizeof(char *);
+
+    res = malloc(size);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    res->gr_gid = gr->gr_gid;
+    /* the member array directly follows the struct so it is aligned */
+    res->gr_mem = (char **) (res + 1);
+    p = (char *) (res->gr_mem + mem_num + 1);
+
+    res->gr_name = p;
+    memcpy(p, gr->gr_name, name_len);
+    p += name_len;
+    res->gr_passwd = p;
+    memcpy(p, gr->gr_passwd, passwd_len);
+    p += passwd_len;
+
+    for (c = 0; c < mem_num; c++) {
+        len = strlen(gr->gr_mem[c]) + 1;
+        res->gr_mem[c] = p;
+        memcpy(p, gr->gr_mem[c], len);
+        p += len;
+    }
+    res->gr_mem[mem_num] = NULL;
+
+    return res;
+}
+
+struct nss_batch_input {
+    union {
+        const uid_t *uids;
+        const gid_t *gids;
+    } input;
+    size_t num_ids;
+    enum sss_cli_command cmd;
+    union {
+        struct passwd **pwds;
+        struct group **grps;
+    } result;
+    int *errs;
+
+    /* scratch buffer for the mmap cache and for parsing the reply */
+    char *buffer;
+    size_t buflen;
+};
+
+#define SSS_NSS_BATCH_INITIAL_BUFLEN 4096
+
+static uint32_t sss_nss_batch_id(struct nss_batch_input *inp, size_t idx)
+{
+    if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+        return inp->input.uids[idx];
+    }
+
+    return inp->input.gids[idx];
+}
+
+static int sss_nss_batch_grow(struct nss_batch_input *inp)
+{
+    char *buffer;
+    size_t buflen;
+
+    buflen = inp->buflen == 0 ? SSS_NSS_BATCH_INITIAL_BUFLEN : 2 * inp->buflen;
+    if (buflen < inp->buflen) {
+        return ERANGE;
+    }
+
+    buffer = realloc(inp->buffer, buflen);
+    if (buffer == NULL) {
+        return ENOMEM;
+    }
+
+    inp->buffer = buffer;
+    inp->buflen = buflen;
+
+    return 0;
+}
+
+/* Read one entry into the scratch buffer, growing it as needed, and store a
+ * copy of it as the result at idx. On success *len is set to the number of
+ * bytes left in buf after the entry, like the readrep functions do. */
+static int sss_nss_batch_readrep(struct nss_batch_input *inp, size_t idx,
+                                 uint8_t *buf, size_t *len)
+{
+    struct passwd pw;
+    struct group gr;
+    struct sss_nss_pw_rep pwrep = { .result = &pw };
+    struct sss_nss_gr_rep grrep = { .result = &gr };
+    size_t left;
+    int ret;
+
+    do {
+        left = *len;
+        if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+            pwrep.buffer = inp->buffer;
+            pwrep.buflen = inp->buflen;
+            ret = sss_nss_getpw_readrep(&pwrep, buf, &left);
+        } else {
+            grrep.buffer = inp->buffer;
+            grrep.buflen = inp->buflen;
+            ret = sss_nss_getgr_readrep(&grrep, buf, &left);
+        }
+
+        if (ret == ERANGE) {
+            ret = sss_nss_batch_grow(inp);
+            if (ret != 0) {
+                return ret;
+            }
+            ret = ERANGE;
+        }
+    } while (ret == ERANGE);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+        inp->result.pwds[idx] = sss_nss_pw_dup(&pw);
+        ret = inp->result.pwds[idx] == NULL ? ENOMEM : 0;
+    } else {
+        inp->result.grps[idx] = sss_nss_gr_dup(&gr);
+        ret = inp->result.grps[idx] == NULL ? ENOMEM : 0;
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    inp->errs[idx] = 0;
+    *len = left;
+
+    return 0;
+}
+
+/* Try to answer the entry at idx from the memory mapped caches */
+static int sss_nss_batch_mc_get(struct nss_batch_input *inp, size_t idx)
+{
+    struct passwd pw;
+    struct group gr;
+    uint32_t id;
+    int ret;
+
+    id = sss_nss_batch_id(inp, idx);
+
+    do {
+        if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+            ret = sss_nss_mc_getpwuid(id, &pw, inp->buffer, inp->buflen);
+        } else {
+            ret = sss_nss_mc_getgrgid(id, &gr, inp->buffer, inp->buflen);
+        }
+
+        if (ret == ERANGE) {
+            ret = sss_nss_batch_grow(inp);
+            if (ret != 0) {
+                return ret;
+            }
+            ret = ERANGE;
+        }
+    } while (ret == ERANGE);
+
+    if (ret != 0) {
+        if (sss_nss_mc_check_negative_id(inp->cmd == SSS_NSS_GETPWUID_BATCH ?
+                                                SSS_MC_NEG_UID : SSS_MC_NEG_GID,
+                                         id) == 0) {
+            inp->errs[idx] = ENOENT;
+            return 0;
+        }
+        return ret;
+    }
+
+    if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+        inp->result.pwds[idx] = sss_nss_pw_dup(&pw);
+        ret = inp->result.pwds[idx] == NULL ? ENOMEM : 0;
+    } else {
+        inp->result.grps[idx] = sss_nss_gr_dup(&gr);
+        ret = inp->result.grps[idx] == NULL ? ENOMEM : 0;
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    inp->errs[idx] = 0;
+
+    return 0;
+}
+
+/* Send one batch request for the ids at the positions in idx and store the
+ * results */
+static int sss_nss_batch_request(struct nss_batch_input *inp, uint32_t flags,
+                                 const size_t *idx, uint32_t num,
+                                 int time_left)
+{
+    struct sss_cli_req_data rd;
+    uint32_t *req_data;
+    uint8_t *repbuf = NULL;
+    size_t replen;
+    size_t len;
+    size_t rp;
+    uint32_t num_results;
+    uint32_t num_failed;
+    uint32_t pos;
+    uint32_t err;
+    uint32_t id;
+    uint32_t c;
+    int errnop;
+    int ret;
+
+    req_data = malloc((2 + num) * sizeof(uint32_t));
+    if (req_data == NULL) {
+        return ENOMEM;
+    }
+
+    SAFEALIGN_COPY_UINT32(&req_data[0], &num, NULL);
+    SAFEALIGN_COPY_UINT32(&req_data[1], &flags, NULL);
+    for (c = 0; c < num; c++) {
+        id = sss_nss_batch_id(inp, idx[c]);
+        SAFEALIGN_COPY_UINT32(&req_data[2 + c], &id, NULL);
+    }
+
+    rd.len = (2 + num) * sizeof(uint32_t);
+    rd.data = req_data;
+
+    ret = sss_nss_make_request_timeout(inp->cmd, &rd, time_left,
+                                       &repbuf, &replen, &errnop);
+    free(req_data);
+    if (ret != NSS_STATUS_SUCCESS) {
+        ret = errnop != 0 ? errnop : EIO;
+        goto done;
+    }
+
+    /* everything that is not in the reply was not found */
+    for (c = 0; c < num; c++) {
+        inp->errs[idx[c]] = ENOENT;
+    }
+
+    if (replen < 2 * sizeof(uint32_t)) {
+        ret = EBADMSG;
+        goto done;
+    }
+
+    rp = 0;
+    SAFEALIGN_COPY_UINT32(&num_results, repbuf, &rp);
+    SAFEALIGN_COPY_UINT32(&num_failed, repbuf + rp, &rp);
+
+    for (c = 0; c < num_results; c++) {
+        if (replen - rp < sizeof(uint32_t)) {
+            ret = EBADMSG;
+            goto done;
+        }
+        SAFEALIGN_COPY_UINT32(&pos, repbuf + rp, &rp);
+        if (pos >= num || inp->errs[idx[pos]] != ENOENT) {
+            ret = EBADMSG;
+            goto done;
+        }
+
+        len = replen - rp;
+        ret = sss_nss_batch_readrep(inp, idx[pos], repbuf + rp, &len);
+        if (ret != 0) {
+            goto done;
+        }
+        rp = replen - len;
+    }
+
+    if (replen - rp != num_failed * 2 * sizeof(uint32_t)) {
+        ret = EBADMSG;
+        goto done;
+    }
+
+    for (c = 0; c < num_failed; c++) {
+        SAFEALIGN_COPY_UINT32(&pos, repbuf + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&err, repbuf + rp, &rp);
+        if (pos >= num || inp->errs[idx[pos]] != ENOENT || err == 0) {
+            ret = EBADMSG;
+            goto done;
+        }
+        inp->errs[idx[pos]] = err;
+    }
+
+    ret = 0;
+
+done:
+    free(repbuf);
+    return ret;
+}
+
+static int sss_get_batch(struct nss_batch_input *inp, uint32_t flags,
+                         unsigned int timeout)
+{
+    struct timespec start;
+    struct timespec now;
+    struct timespec diff;
+    size_t *pending = NULL;
+    size_t num_pending;
+    size_t done;
+    bool skip_mc;
+    int time_left;
+    int left;
+    uint32_t num;
+    size_t c;
+    int ret;
+
+    if ((inp->input.uids == NULL && inp->num_ids != 0)
+            || inp->result.pwds == NULL || inp->errs == NULL) {
+        return EINVAL;
+    }
+
+    /* SSS_NSS_EX_FLAG_NO_CACHE and SSS_NSS_EX_FLAG_INVALIDATE_CACHE are
+     * mutually exclusive */
+    if ((flags & SSS_NSS_EX_FLAG_NO_CACHE) != 0
+            && (flags & SSS_NSS_EX_FLAG_INVALIDATE_CACHE) != 0) {
+        return EINVAL;
+    }
+    skip_mc = (flags & (SSS_NSS_EX_FLAG_NO_CACHE
+                            | SSS_NSS_EX_FLAG_INVALIDATE_CACHE)) != 0;
+
+    for (c = 0; c < inp->num_ids; c++) {
+        inp->result.pwds[c] = NULL;
+        inp->errs[c] = ENOENT;
+    }
+
+    if (inp->num_ids == 0) {
+        return 0;
+    }
+
+    pending = malloc(inp->num_ids * sizeof(size_t));
+    if (pending == NULL) {
+        return ENOMEM;
+    }
+
+    num_pending = 0;
+    for (c = 0; c < inp->num_ids; c++) {
+        if (!skip_mc && sss_nss_batch_mc_get(inp, c) == 0) {
+            continue;
+        }
+        pending[num_pending++] = c;
+    }
+
+    if (num_pending == 0) {
+        ret = 0;
+        goto done;
+    }
+
+    ret = sss_nss_timedlock(timeout, &time_left);
+    if (ret != 0) {
+        goto done;
+    }
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    if (ret != 0) {
+        ret = errno;
+        goto out;
+    }
+
+    for (done = 0; done < num_pending; done += num) {
+        num = MIN(num_pending - done, SSS_NSS_BATCH_MAX_IDS);
+
+        /* the timeout covers all requests of the batch */
+        left = time_left;
+        if (time_left != 0 && done != 0) {
+            ret = clock_gettime(CLOCK_MONOTONIC, &now);
+            if (ret != 0) {
+                ret = errno;
+                goto out;
+            }
+            diff.tv_sec = now.tv_sec - start.tv_sec;
+            diff.tv_nsec = now.tv_nsec - start.tv_nsec;
+            left -= diff.tv_sec * 1000 + diff.tv_nsec / (1000 * 1000);
+            if (left <= 0) {
+                /* the remaining ids were not sent to SSSD */
+                ret = ETIMEDOUT;
+                goto out;
+            }
+        }
+
+        ret = sss_nss_batch_request(inp, flags, pending + done, num, left);
+        if (ret != 0) {
+            goto out;
+        }
+    }
+
+    ret = 0;
+
+out:
+    sss_nss_unlock();
+
+done:
+    if (ret != 0) {
+        for (c = 0; c < inp->num_ids; c++) {
+            if (inp->cmd == SSS_NSS_GETPWUID_BATCH) {
+                free(inp->result.pwds[c]);
+                inp->result.pwds[c] = NULL;
+            } else {
+                free(inp->result.grps[c]);
+                inp->result.grps[c] = NULL;
+            }
+            inp->errs[c] = ret;
+        }
+    }
+
+    free(pending);
+    free(inp->buffer);
+    inp->buffer = NULL;
+    inp->buflen = 0;
+
+    return ret;
+}
+
+int sss_nss_getpwuid_batch_timeout(const uid_t *uids, size_t num_uids,
+                                   struct passwd **pwds, int *errs,
+                                   uint32_t flags, unsigned int timeout)
+{
+    struct nss_batch_input inp = {
+        .input.uids = uids,
+        .num_ids = num_uids,
+        .cmd = SSS_NSS_GETPWUID_BATCH,
+        .result.pwds = pwds,
+        .errs = errs};
+
+    return sss_get_batch(&inp, flags, timeout);
+}
+
+int sss_nss_getgrgid_batch_timeout(const gid_t *gids, size_t num_gids,
+                                   struct group **grps, int *errs,
+                                   uint32_t flags, unsigned int timeout)
+{
+    struct nss_batch_input inp = {
+        .input.gids = gids,
+        .num_ids = num_gids,
+        .cmd = SSS_NSS_GETGRGID_BATCH,
+        .result.grps = grps,
+        .errs = errs};
+
+    return sss_get_batch(&inp, flags, timeout);
+}
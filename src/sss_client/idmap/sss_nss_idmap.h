@@ -402,6 +402,66 @@ int sss_nss_getgrgid_timeout(gid_t gid, struct group *grp,
 int sss_nss_getgrouplist_timeout(const char *name, gid_t group,
                                  gid_t *groups, int *ngroups,
                                  uint32_t flags, unsigned int timeout);
+
+/**
+ * @brief Find user records by uid for many uids at once
+ *
+ * Entries missing in the memory cache are requested from SSSD with as few
+ * requests as possible, each request covers up to SSS_NSS_BATCH_MAX_IDS uids
+ * which are looked up by SSSD in parallel.
+ *
+ * @param[in]  uids       array of uids to look up
+ * @param[in]  num_uids   number of elements in uids
+ * @param[out] pwds       array of num_uids elements, found entries are
+ *                        stored at the position of their uid, missing
+ *                        entries are set to NULL. Each entry is a single
+ *                        allocation which must be freed with free()
+ * @param[out] errs       array of num_uids elements, contains 0 for found
+ *                        entries, ENOENT for missing entries or the error
+ *                        code of the lookup of the uid
+ * @param[in]  flags      flags to control the behavior and the results of the
+ *                        call
+ * @param[in]  timeout    timeout in milliseconds for the whole call
+ *
+ * @return
+ *  - 0:         the lookups were done, see errs for the individual results
+ *  - EINVAL:    invalid input
+ *  - ETIME:     request timed out but was send to SSSD
+ *  - ETIMEDOUT: request timed out but was not send to SSSD
+ *  On error no entry is returned.
+ */
+int sss_nss_getpwuid_batch_timeout(const uid_t *uids, size_t num_uids,
+                                   struct passwd **pwds, int *errs,
+                                   uint32_t flags, unsigned int timeout);
+
+/**
+ * @brief Find group records by gid for many gids at once
+ *
+ * Same as sss_nss_getpwuid_batch_timeout() but for groups.
+ *
+ * @param[in]  gids       array of gids to look up
+ * @param[in]  num_gids   number of elements in gids
+ * @param[out] grps       array of num_gids elements, found entries are
+ *                        stored at the position of their gid, missing
+ *                        entries are set to NULL. Each entry is a single
+ *                        allocation which must be freed with free()
+ * @param[out] errs       array of num_gids elements, contains 0 for found
+ *                        entries, ENOENT for missing entries or the error
+ *                        code of the lookup of the gid
+ * @param[in]  flags      flags to control the behavior and the results of the
+ *                        call
+ * @param[in]  timeout    timeout in milliseconds for the whole call
+ *
+ * @return
+ *  - 0:         the lookups were done, see errs for the individual results
+ *  - EINVAL:    invalid input
+ *  - ETIME:     request timed out but was send to SSSD
+ *  - ETIMEDOUT: request timed out but was not send to SSSD
+ *  On error no entry is returned.
+ */
+int sss_nss_getgrgid_batch_timeout(const gid_t *gids, size_t num_gids,
+                                   struct group **grps, int *errs,
+                                   uint32_t flags, unsigned int timeout);
 /**
  * @brief Find SID by fully qualified name with timeout
  *
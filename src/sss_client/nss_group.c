@@ -523,6 +523,12 @@ enum nss_status _nss_sss_getgrnam_r(const char *name, struct group *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder told us the entry does not exist */
+        if (sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME,
+                                           name, name_len) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -549,6 +555,13 @@ enum nss_status _nss_sss_getgrnam_r(const char *name, struct group *result,
         nret = NSS_STATUS_TRYAGAIN;
         goto out;
     case ENOENT:
+        /* or a previous thread learned it does not exist */
+        if (sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME,
+                                           name, name_len) == 0) {
+            *errnop = 0;
+            nret = NSS_STATUS_NOTFOUND;
+            goto out;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -637,6 +650,11 @@ enum nss_status _nss_sss_getgrgid_r(gid_t gid, struct group *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder told us the entry does not exist */
+        if (sss_nss_mc_check_negative_id(SSS_MC_NEG_GID, gid) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -664,6 +682,12 @@ enum nss_status _nss_sss_getgrgid_r(gid_t gid, struct group *result,
         nret = NSS_STATUS_TRYAGAIN;
         goto out;
     case ENOENT:
+        /* or a previous thread learned it does not exist */
+        if (sss_nss_mc_check_negative_id(SSS_MC_NEG_GID, gid) == 0) {
+            *errnop = 0;
+            nret = NSS_STATUS_NOTFOUND;
+            goto out;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -68,14 +68,28 @@ struct sss_cli_mc_ctx {
     uint32_t ht_size;       /* size of hash table */
 
     uint32_t active_threads; /* count of threads which use memory cache */
+
+    struct sss_mc_bucket *bucket_table; /* v2 index, NULL if not present */
+    uint32_t nbuckets;      /* number of buckets in bucket table */
 };
 
 #if HAVE_PTHREAD
-#define SSS_CLI_MC_CTX_INITIALIZER(mtx) {UNINITIALIZED, (mtx), -1, 0, 0, 0, NULL, 0, NULL, 0, NULL, 0, 0}
+#define SSS_CLI_MC_CTX_INITIALIZER(mtx) {UNINITIALIZED, (mtx), -1, 0, 0, 0, NULL, 0, NULL, 0, NULL, 0, 0, NULL, 0}
 #else
-#define SSS_CLI_MC_CTX_INITIALIZER {UNINITIALIZED, -1, 0, 0, 0, NULL, 0, NULL, 0, NULL, 0, 0}
+#define SSS_CLI_MC_CTX_INITIALIZER {UNINITIALIZED, -1, 0, 0, 0, NULL, 0, NULL, 0, NULL, 0, 0, NULL, 0}
 #endif
 
+/* State of a lookup of one key, either over the v2 bucket index or over
+ * the v1 hash chains if the cache does not have the index. */
+struct sss_nss_mc_walk {
+    uint32_t hash;          /* key hash as stored in the records */
+    uint16_t fp;            /* key fingerprint */
+    uint32_t bucket;        /* current bucket */
+    uint32_t probes;        /* number of buckets visited */
+    int entry;              /* next entry of the current bucket */
+    struct sss_mc_bucket copy; /* consistent copy of the current bucket */
+};
+
 errno_t sss_nss_mc_get_ctx(const char *name, struct sss_cli_mc_ctx *ctx);
 errno_t sss_nss_check_header(struct sss_cli_mc_ctx *ctx);
 uint32_t sss_nss_mc_hash(struct sss_cli_mc_ctx *ctx,
@@ -87,6 +101,22 @@ errno_t sss_nss_str_ptr_from_buffer(char **str, void **cookie,
 uint32_t sss_nss_mc_next_slot_with_hash(struct sss_mc_rec *rec,
                                         uint32_t hash);
 
+/* Returns the first record slot that may hold the key and sets walk->hash,
+ * the following candidates are returned by sss_nss_mc_walk_next() which
+ * needs the record read at the previous slot. MC_INVALID_VAL ends the walk. */
+uint32_t sss_nss_mc_walk_first(struct sss_cli_mc_ctx *ctx,
+                               struct sss_nss_mc_walk *walk,
+                               const char *key, size_t len);
+uint32_t sss_nss_mc_walk_next(struct sss_cli_mc_ctx *ctx,
+                              struct sss_nss_mc_walk *walk,
+                              struct sss_mc_rec *rec);
+
+/* Lock-less hash chain walk. Take the sequence before reading the hash
+ * table and, if the walk failed, ask whether it has to be restarted. */
+uint32_t sss_nss_mc_seq_begin(struct sss_cli_mc_ctx *ctx);
+bool sss_nss_mc_seq_retry(struct sss_cli_mc_ctx *ctx, uint32_t seq,
+                          errno_t ret, int *_attempt);
+
 /* passwd db */
 errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
                             struct passwd *result,
@@ -114,4 +144,9 @@ errno_t sss_nss_mc_get_sid_by_uid(uint32_t id, char **sid, uint32_t *type);
 errno_t sss_nss_mc_get_sid_by_gid(uint32_t id, char **sid, uint32_t *type);
 errno_t sss_nss_mc_get_id_by_sid(const char *sid, uint32_t *id, uint32_t *type);
 
+/* negative entries, 0 means the entry is known not to exist */
+errno_t sss_nss_mc_check_negative_name(enum sss_mc_neg_type type,
+                                       const char *name, size_t name_len);
+errno_t sss_nss_mc_check_negative_id(enum sss_mc_neg_type type, uint32_t id);
+
 #endif /* _NSS_MC_H_ */
@@ -30,6 +30,7 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sched.h>
 #include "nss_mc.h"
 #include "sss_cli.h"
 #include "shared/io.h"
@@ -55,6 +56,31 @@ do { \
     } \
 } while(0)
 
+/* Readers never take a lock to access the cache. A record which is being
+ * rewritten is retried locally: first by busy waiting for a short while as
+ * the writer only needs a few memcpy()s to finish, then by yielding the CPU
+ * in case the writer was preempted in the middle of the update. Only after
+ * MC_READ_ATTEMPTS the reader gives up and falls back to the socket. */
+#define MC_READ_SPIN_ATTEMPTS 64
+#define MC_READ_ATTEMPTS 1024
+
+/* Maximum number of times a whole hash chain walk is restarted because
+ * the writer modified the chains while we were walking them. */
+#define MC_WALK_ATTEMPTS 32
+
+static void sss_nss_mc_relax(int attempt)
+{
+    if (attempt < MC_READ_SPIN_ATTEMPTS) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        __sync_synchronize();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
 static void sss_mt_lock(struct sss_cli_mc_ctx *ctx)
 {
 #if HAVE_PTHREAD
@@ -101,6 +127,50 @@ static errno_t sss_nss_mc_validate(struct sss_cli_mc_ctx *ctx)
     return EOK;
 }
 
+/* The v2 header is optional, if it is missing or not understood the
+ * cache is used through the v1 hash chains. */
+static void sss_nss_check_header_v2(struct sss_cli_mc_ctx *ctx,
+                                    struct sss_mc_header *h)
+{
+    struct sss_mc_header_v2 h2;
+    bool copy_ok;
+    int count;
+
+    ctx->bucket_table = NULL;
+    ctx->nbuckets = 0;
+
+    if (h->data_table < MC_HEADER_SIZE + sizeof(struct sss_mc_header_v2)) {
+        /* written by a responder which does not know about v2 */
+        return;
+    }
+
+    for (count = 5; count > 0; count--) {
+        MEMCPY_WITH_BARRIERS(copy_ok, &h2,
+                             (struct sss_mc_header_v2 *)
+                                MC_PTR_ADD(ctx->mmap_base, MC_HEADER_SIZE),
+                             sizeof(struct sss_mc_header_v2));
+        if (copy_ok) {
+            break;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    if (h2.magic != SSS_MC_V2_MAGIC ||
+        h2.major_vno != SSS_MC_V2_MAJOR_VNO ||
+        h2.nbuckets == 0 ||
+        h2.bt_size != h2.nbuckets * sizeof(struct sss_mc_bucket) ||
+        h2.bucket_table % MC_CACHE_LINE != 0 ||
+        h2.bucket_table > ctx->mmap_size ||
+        h2.bt_size > ctx->mmap_size - h2.bucket_table) {
+        return;
+    }
+
+    ctx->bucket_table = MC_PTR_ADD(ctx->mmap_base, h2.bucket_table);
+    ctx->nbuckets = h2.nbuckets;
+}
+
 errno_t sss_nss_check_header(struct sss_cli_mc_ctx *ctx)
 {
     struct sss_mc_header h;
@@ -141,6 +211,7 @@ errno_t sss_nss_check_header(struct sss_cli_mc_ctx *ctx)
         ctx->hash_table = MC_PTR_ADD(ctx->mmap_base, h.hash_table);
         ctx->dt_size = h.dt_size;
         ctx->ht_size = h.ht_size;
+        sss_nss_check_header_v2(ctx, &h);
     } else {
         if (ctx->seed != h.seed ||
             ctx->data_table != MC_PTR_ADD(ctx->mmap_base, h.data_table) ||
@@ -175,6 +246,8 @@ static void sss_nss_mc_destroy_ctx(struct sss_cli_mc_ctx *ctx)
     ctx->dt_size = 0;
     ctx->hash_table = NULL;
     ctx->ht_size = 0;
+    ctx->bucket_table = NULL;
+    ctx->nbuckets = 0;
     ctx->initialized = UNINITIALIZED;
     /* `mutex` and `active_threads` should be left intact */
 }
@@ -318,9 +391,12 @@ errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
     int count;
     int ret;
 
-    /* try max 5 times */
-    for (count = 5; count > 0; count--) {
-        rec = MC_SLOT_TO_PTR(ctx->data_table, slot, struct sss_mc_rec);
+    rec = MC_SLOT_TO_PTR(ctx->data_table, slot, struct sss_mc_rec);
+
+    for (count = 0; count < MC_READ_ATTEMPTS; count++) {
+        if (count > 0) {
+            sss_nss_mc_relax(count);
+        }
 
         /* fetch record length */
         b1 = rec->b1;
@@ -328,8 +404,14 @@ errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
         rec_len = rec->len;
         __sync_synchronize();
         b2 = rec->b2;
+        if (b1 == MC_INVALID_VAL && b2 == MC_INVALID_VAL) {
+            /* record was invalidated, there is nothing to wait for, the
+             * caller will restart the walk if the chains changed */
+            ret = EIO;
+            goto done;
+        }
         if (!MC_VALID_BARRIER(b1) || b1 != b2) {
-            /* record is inconsistent, retry */
+            /* record is being written, retry */
             continue;
         }
 
@@ -358,8 +440,8 @@ errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
             break;
         }
     }
-    if (count == 0) {
-        /* couldn't successfully read header we have to give up */
+    if (count == MC_READ_ATTEMPTS) {
+        /* couldn't successfully read record we have to give up */
         ret = EIO;
         goto done;
     }
@@ -375,6 +457,146 @@ done:
     return ret;
 }
 
+/* Takes a consistent copy of a bucket. If the writer keeps it busy for
+ * too long the copy is left empty which ends the walk with a miss that
+ * sss_nss_mc_seq_retry() will turn into a new walk. */
+static void sss_nss_mc_bucket_copy(struct sss_cli_mc_ctx *ctx,
+                                   struct sss_nss_mc_walk *walk)
+{
+    volatile struct sss_mc_bucket *b = &ctx->bucket_table[walk->bucket];
+    uint32_t seq;
+    int count;
+
+    walk->entry = 0;
+
+    for (count = 0; count < MC_READ_ATTEMPTS; count++) {
+        if (count > 0) {
+            sss_nss_mc_relax(count);
+        }
+
+        seq = b->seq;
+        if (MC_SEQ_WRITE_IN_PROGRESS(seq)) {
+            continue;
+        }
+        __sync_synchronize();
+        memcpy(&walk->copy, (const void *)b, sizeof(struct sss_mc_bucket));
+        __sync_synchronize();
+        if (b->seq == seq) {
+            return;
+        }
+    }
+
+    memset(&walk->copy, 0, sizeof(struct sss_mc_bucket));
+}
+
+static uint32_t sss_nss_mc_walk_index(struct sss_cli_mc_ctx *ctx,
+                                      struct sss_nss_mc_walk *walk)
+{
+    uint32_t slot;
+
+    while (true) {
+        while (walk->entry < MC_BUCKET_ENTRIES) {
+            if (walk->copy.fp[walk->entry] == walk->fp) {
+                slot = walk->copy.slot[walk->entry];
+                walk->entry++;
+                return slot;
+            }
+            walk->entry++;
+        }
+
+        /* nothing with our home bucket was pushed any further */
+        if (walk->copy.overflow == 0) {
+            return MC_INVALID_VAL;
+        }
+
+        walk->probes++;
+        if (walk->probes >= ctx->nbuckets) {
+            return MC_INVALID_VAL;
+        }
+
+        walk->bucket = (walk->bucket + 1) % ctx->nbuckets;
+        sss_nss_mc_bucket_copy(ctx, walk);
+    }
+}
+
+uint32_t sss_nss_mc_walk_first(struct sss_cli_mc_ctx *ctx,
+                               struct sss_nss_mc_walk *walk,
+                               const char *key, size_t len)
+{
+    uint32_t h;
+
+    h = murmurhash3(key, len, ctx->seed);
+    walk->hash = h % MC_HT_ELEMS(ctx->ht_size);
+
+    if (ctx->bucket_table == NULL) {
+        return ctx->hash_table[walk->hash];
+    }
+
+    walk->fp = sss_mc_fingerprint(h);
+    walk->bucket = walk->hash % ctx->nbuckets;
+    walk->probes = 0;
+    sss_nss_mc_bucket_copy(ctx, walk);
+
+    return sss_nss_mc_walk_index(ctx, walk);
+}
+
+uint32_t sss_nss_mc_walk_next(struct sss_cli_mc_ctx *ctx,
+                              struct sss_nss_mc_walk *walk,
+                              struct sss_mc_rec *rec)
+{
+    if (ctx->bucket_table == NULL) {
+        return sss_nss_mc_next_slot_with_hash(rec, walk->hash);
+    }
+
+    return sss_nss_mc_walk_index(ctx, walk);
+}
+
+uint32_t sss_nss_mc_seq_begin(struct sss_cli_mc_ctx *ctx)
+{
+    volatile struct sss_mc_header *h = ctx->mmap_base;
+    uint32_t seq = 0;
+    int count;
+
+    for (count = 0; count < MC_READ_ATTEMPTS; count++) {
+        seq = h->seqnum;
+        __sync_synchronize();
+        if (!MC_SEQ_WRITE_IN_PROGRESS(seq)) {
+            break;
+        }
+        sss_nss_mc_relax(count);
+    }
+
+    /* If the writer is still busy the odd value is returned and
+     * sss_nss_mc_seq_retry() will ask for a new walk. */
+    return seq;
+}
+
+bool sss_nss_mc_seq_retry(struct sss_cli_mc_ctx *ctx, uint32_t seq,
+                          errno_t ret, int *_attempt)
+{
+    volatile struct sss_mc_header *h = ctx->mmap_base;
+
+    /* Only a miss or an unreadable record can be caused by walking
+     * the chains while they were modified */
+    if (ret != ENOENT && ret != EIO) {
+        return false;
+    }
+
+    __sync_synchronize();
+    if (h->seqnum == seq && !MC_SEQ_WRITE_IN_PROGRESS(seq)) {
+        /* chains did not change, the result is genuine */
+        return false;
+    }
+
+    (*_attempt)++;
+    if (*_attempt >= MC_WALK_ATTEMPTS) {
+        return false;
+    }
+
+    sss_nss_mc_relax(*_attempt);
+    return true;
+}
+
 /*
  * returns strings from a buffer.
  *
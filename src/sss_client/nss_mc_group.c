@@ -115,6 +115,9 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     int ret;
     const size_t strs_offset = offsetof(struct sss_mc_grp_data, strs);
     size_t data_size;
@@ -127,9 +130,11 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
     /* Get max size of data table. */
     data_size = gr_mc_ctx.dt_size;
 
+retry:
+    seq = sss_nss_mc_seq_begin(&gr_mc_ctx);
     /* hashes are calculated including the NULL terminator */
-    hash = sss_nss_mc_hash(&gr_mc_ctx, name, name_len + 1);
-    slot = gr_mc_ctx.hash_table[hash];
+    slot = sss_nss_mc_walk_first(&gr_mc_ctx, &walk, name, name_len + 1);
+    hash = walk.hash;
 
     /* If slot is not within the bounds of mmapped region and
      * it's value is not MC_INVALID_VAL, then the cache is
@@ -147,7 +152,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
         /* check record matches what we are searching for */
         if (hash != rec->hash1) {
             /* if name hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            slot = sss_nss_mc_walk_next(&gr_mc_ctx, &walk, rec);
             continue;
         }
 
@@ -168,7 +173,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&gr_mc_ctx, &walk, rec);
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
@@ -179,6 +184,12 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
     ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
 
 done:
+    if (sss_nss_mc_seq_retry(&gr_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
@@ -193,6 +204,9 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
     char gidstr[11];
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     int len;
     int ret;
 
@@ -207,9 +221,11 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
         goto done;
     }
 
+retry:
+    seq = sss_nss_mc_seq_begin(&gr_mc_ctx);
     /* hashes are calculated including the NULL terminator */
-    hash = sss_nss_mc_hash(&gr_mc_ctx, gidstr, len+1);
-    slot = gr_mc_ctx.hash_table[hash];
+    slot = sss_nss_mc_walk_first(&gr_mc_ctx, &walk, gidstr, len+1);
+    hash = walk.hash;
 
     /* If slot is not within the bounds of mmapped region and
      * it's value is not MC_INVALID_VAL, then the cache is
@@ -227,7 +243,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
         /* check record matches what we are searching for */
         if (hash != rec->hash2) {
             /* if uid hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            slot = sss_nss_mc_walk_next(&gr_mc_ctx, &walk, rec);
             continue;
         }
 
@@ -236,7 +252,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&gr_mc_ctx, &walk, rec);
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, gr_mc_ctx.dt_size)) {
@@ -247,6 +263,12 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
     ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
 
 done:
+    if (sss_nss_mc_seq_retry(&gr_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
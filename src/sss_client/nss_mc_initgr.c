@@ -96,6 +96,9 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     int ret;
     const size_t data_offset = offsetof(struct sss_mc_initgr_data, gids);
     size_t data_size;
@@ -108,9 +111,11 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
     /* Get max size of data table. */
     data_size = initgr_mc_ctx.dt_size;
 
+retry:
+    seq = sss_nss_mc_seq_begin(&initgr_mc_ctx);
     /* hashes are calculated including the NULL terminator */
-    hash = sss_nss_mc_hash(&initgr_mc_ctx, name, name_len + 1);
-    slot = initgr_mc_ctx.hash_table[hash];
+    slot = sss_nss_mc_walk_first(&initgr_mc_ctx, &walk, name, name_len + 1);
+    hash = walk.hash;
 
     /* If slot is not within the bounds of mmapped region and
      * it's value is not MC_INVALID_VAL, then the cache is
@@ -128,7 +133,7 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
         /* check record matches what we are searching for */
         if (hash != rec->hash1) {
             /* if name hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            slot = sss_nss_mc_walk_next(&initgr_mc_ctx, &walk, rec);
             continue;
         }
 
@@ -151,7 +156,7 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&initgr_mc_ctx, &walk, rec);
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
@@ -162,6 +167,12 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
     ret = sss_nss_mc_parse_result(rec, start, size, groups, limit);
 
 done:
+    if (sss_nss_mc_seq_retry(&initgr_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&initgr_mc_ctx.active_threads, 1);
     return ret;
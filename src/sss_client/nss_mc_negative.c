@@ -0,0 +1,150 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2026 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Negative entries NSS interface using mmap cache */
+
+#include <stddef.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "nss_mc.h"
+#include "sss_cli.h"
+#include "util/mmap_cache.h"
+
+#if HAVE_PTHREAD
+static pthread_mutex_t neg_mc_ctx_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct sss_cli_mc_ctx neg_mc_ctx = SSS_CLI_MC_CTX_INITIALIZER(&neg_mc_ctx_mutex);
+#else
+static struct sss_cli_mc_ctx neg_mc_ctx = SSS_CLI_MC_CTX_INITIALIZER;
+#endif
+
+static errno_t sss_nss_mc_neg_lookup(enum sss_mc_neg_type type,
+                                     const char *key, size_t key_len)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_neg_data *data;
+    char *rec_key;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
+    int ret;
+    const size_t key_offset = offsetof(struct sss_mc_neg_data, key);
+
+    ret = sss_nss_mc_get_ctx("negative", &neg_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+retry:
+    seq = sss_nss_mc_seq_begin(&neg_mc_ctx);
+    /* hashes are calculated including the NULL terminator */
+    slot = sss_nss_mc_walk_first(&neg_mc_ctx, &walk, key, key_len + 1);
+    hash = walk.hash;
+
+    while (MC_SLOT_WITHIN_BOUNDS(slot, neg_mc_ctx.dt_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+
+        ret = sss_nss_mc_get_record(&neg_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        if (hash != rec->hash1) {
+            slot = sss_nss_mc_walk_next(&neg_mc_ctx, &walk, rec);
+            continue;
+        }
+
+        data = (struct sss_mc_neg_data *)rec->data;
+        rec_key = (char *)data + data->name;
+        /* Integrity check
+         * - data->name must point to the key
+         * - the key must be within copy of record
+         * - rec_key is a zero-terminated string */
+        if (data->name != key_offset
+            || rec->len < sizeof(struct sss_mc_rec) + key_offset
+            || data->key_len == 0
+            || data->key_len > rec->len - sizeof(struct sss_mc_rec)
+                                        - key_offset
+            || rec_key[data->key_len - 1] != '\0') {
+            ret = ENOENT;
+            goto done;
+        }
+
+        if (data->type == type && strcmp(key, rec_key) == 0) {
+            /* an expired entry means we have to ask the responder again */
+            ret = (rec->expire < time(NULL)) ? ENOENT : 0;
+            goto done;
+        }
+
+        slot = sss_nss_mc_walk_next(&neg_mc_ctx, &walk, rec);
+    }
+
+    ret = ENOENT;
+
+done:
+    if (sss_nss_mc_seq_retry(&neg_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
+    free(rec);
+    __sync_sub_and_fetch(&neg_mc_ctx.active_threads, 1);
+    return ret;
+}
+
+errno_t sss_nss_mc_check_negative_name(enum sss_mc_neg_type type,
+                                       const char *name, size_t name_len)
+{
+    char key[SSS_NAME_MAX + SSS_MC_NEG_ID_KEY_MAX];
+    int key_len;
+
+    if (name_len >= SSS_NAME_MAX) {
+        return EINVAL;
+    }
+
+    key_len = snprintf(key, sizeof(key), SSS_MC_NEG_NAME_KEY_FMT,
+                       (int)type, name);
+    if (key_len < 0 || key_len > (sizeof(key) - 1)) {
+        return EINVAL;
+    }
+
+    return sss_nss_mc_neg_lookup(type, key, key_len);
+}
+
+errno_t sss_nss_mc_check_negative_id(enum sss_mc_neg_type type, uint32_t id)
+{
+    char key[SSS_MC_NEG_ID_KEY_MAX];
+    int key_len;
+
+    key_len = snprintf(key, sizeof(key), SSS_MC_NEG_ID_KEY_FMT,
+                       (int)type, (unsigned long)id);
+    if (key_len < 0 || key_len > (sizeof(key) - 1)) {
+        return EINVAL;
+    }
+
+    return sss_nss_mc_neg_lookup(type, key, key_len);
+}
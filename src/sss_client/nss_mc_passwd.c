@@ -108,6 +108,9 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     int ret;
     const size_t strs_offset = offsetof(struct sss_mc_pwd_data, strs);
     size_t data_size;
@@ -120,9 +123,11 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
     /* Get max size of data table. */
     data_size = pw_mc_ctx.dt_size;
 
+retry:
+    seq = sss_nss_mc_seq_begin(&pw_mc_ctx);
     /* hashes are calculated including the NULL terminator */
-    hash = sss_nss_mc_hash(&pw_mc_ctx, name, name_len + 1);
-    slot = pw_mc_ctx.hash_table[hash];
+    slot = sss_nss_mc_walk_first(&pw_mc_ctx, &walk, name, name_len + 1);
+    hash = walk.hash;
 
     /* If slot is not within the bounds of mmapped region and
      * it's value is not MC_INVALID_VAL, then the cache is
@@ -140,7 +145,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
         /* check record matches what we are searching for */
         if (hash != rec->hash1) {
             /* if name hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            slot = sss_nss_mc_walk_next(&pw_mc_ctx, &walk, rec);
             continue;
         }
 
@@ -161,7 +166,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&pw_mc_ctx, &walk, rec);
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
@@ -172,6 +177,12 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
     ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
 
 done:
+    if (sss_nss_mc_seq_retry(&pw_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&pw_mc_ctx.active_threads, 1);
     return ret;
@@ -186,6 +197,9 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
     char uidstr[11];
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     int len;
     int ret;
 
@@ -200,9 +214,11 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
         goto done;
     }
 
+retry:
+    seq = sss_nss_mc_seq_begin(&pw_mc_ctx);
     /* hashes are calculated including the NULL terminator */
-    hash = sss_nss_mc_hash(&pw_mc_ctx, uidstr, len+1);
-    slot = pw_mc_ctx.hash_table[hash];
+    slot = sss_nss_mc_walk_first(&pw_mc_ctx, &walk, uidstr, len+1);
+    hash = walk.hash;
 
     /* If slot is not within the bounds of mmapped region and
      * it's value is not MC_INVALID_VAL, then the cache is
@@ -220,7 +236,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
         /* check record matches what we are searching for */
         if (hash != rec->hash2) {
             /* if uid hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            slot = sss_nss_mc_walk_next(&pw_mc_ctx, &walk, rec);
             continue;
         }
 
@@ -229,7 +245,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&pw_mc_ctx, &walk, rec);
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, pw_mc_ctx.dt_size)) {
@@ -240,6 +256,12 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
     ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
 
 done:
+    if (sss_nss_mc_seq_retry(&pw_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&pw_mc_ctx.active_threads, 1);
     return ret;
@@ -46,6 +46,9 @@ static errno_t mc_get_sid_by_typed_id(uint32_t id, enum sss_id_type object_type,
     int key_len;
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     struct sss_mc_rec *rec = NULL;
     const struct sss_mc_sid_data *data = NULL;
 
@@ -59,8 +62,10 @@ static errno_t mc_get_sid_by_typed_id(uint32_t id, enum sss_id_type object_type,
         return ret;
     }
 
-    hash = sss_nss_mc_hash(&sid_mc_ctx, key, key_len + 1);
-    slot = sid_mc_ctx.hash_table[hash];
+retry:
+    seq = sss_nss_mc_seq_begin(&sid_mc_ctx);
+    slot = sss_nss_mc_walk_first(&sid_mc_ctx, &walk, key, key_len + 1);
+    hash = walk.hash;
 
     while (MC_SLOT_WITHIN_BOUNDS(slot, sid_mc_ctx.dt_size)) {
         free(rec); /* free record from previous iteration */
@@ -71,8 +76,9 @@ static errno_t mc_get_sid_by_typed_id(uint32_t id, enum sss_id_type object_type,
             goto done;
         }
         if (hash != rec->hash2) {
-            ret = EINVAL;
-            goto done;
+            /* fingerprint collision in the index */
+            slot = sss_nss_mc_walk_next(&sid_mc_ctx, &walk, rec);
+            continue;
         }
 
         data = (struct sss_mc_sid_data *)rec->data;
@@ -92,12 +98,18 @@ static errno_t mc_get_sid_by_typed_id(uint32_t id, enum sss_id_type object_type,
             goto done;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&sid_mc_ctx, &walk, rec);
     }
 
     ret = ENOENT;
 
 done:
+    if (sss_nss_mc_seq_retry(&sid_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&sid_mc_ctx.active_threads, 1);
     return ret;
@@ -149,6 +161,9 @@ errno_t sss_nss_mc_get_id_by_sid(const char *sid, uint32_t *id, uint32_t *type)
     int key_len;
     uint32_t hash;
     uint32_t slot;
+    uint32_t seq = 0;
+    struct sss_nss_mc_walk walk;
+    int attempt = 0;
     struct sss_mc_rec *rec = NULL;
     const struct sss_mc_sid_data *data = NULL;
 
@@ -159,8 +174,10 @@ errno_t sss_nss_mc_get_id_by_sid(const char *sid, uint32_t *id, uint32_t *type)
         return ret;
     }
 
-    hash = sss_nss_mc_hash(&sid_mc_ctx, sid, key_len);
-    slot = sid_mc_ctx.hash_table[hash];
+retry:
+    seq = sss_nss_mc_seq_begin(&sid_mc_ctx);
+    slot = sss_nss_mc_walk_first(&sid_mc_ctx, &walk, sid, key_len);
+    hash = walk.hash;
 
     while (MC_SLOT_WITHIN_BOUNDS(slot, sid_mc_ctx.dt_size)) {
         free(rec); /* free record from previous iteration */
@@ -171,8 +188,9 @@ errno_t sss_nss_mc_get_id_by_sid(const char *sid, uint32_t *id, uint32_t *type)
             goto done;
         }
         if (hash != rec->hash1) {
-            ret = EINVAL;
-            goto done;
+            /* fingerprint collision in the index */
+            slot = sss_nss_mc_walk_next(&sid_mc_ctx, &walk, rec);
+            continue;
         }
 
         data = (struct sss_mc_sid_data *)rec->data;
@@ -186,12 +204,18 @@ errno_t sss_nss_mc_get_id_by_sid(const char *sid, uint32_t *id, uint32_t *type)
             goto done; /* ret == 0 */
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = sss_nss_mc_walk_next(&sid_mc_ctx, &walk, rec);
     }
 
     ret = ENOENT;
 
 done:
+    if (sss_nss_mc_seq_retry(&sid_mc_ctx, seq, ret, &attempt)) {
+        /* the chains changed while we walked them, start over */
+        free(rec);
+        rec = NULL;
+        goto retry;
+    }
     free(rec);
     __sync_sub_and_fetch(&sid_mc_ctx.active_threads, 1);
     return ret;
@@ -173,6 +173,12 @@ enum nss_status _nss_sss_getpwnam_r(const char *name, struct passwd *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder told us the entry does not exist */
+        if (sss_nss_mc_check_negative_name(SSS_MC_NEG_USER_NAME,
+                                           name, name_len) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -199,6 +205,13 @@ enum nss_status _nss_sss_getpwnam_r(const char *name, struct passwd *result,
         nret = NSS_STATUS_TRYAGAIN;
         goto out;
     case ENOENT:
+        /* or a previous thread learned it does not exist */
+        if (sss_nss_mc_check_negative_name(SSS_MC_NEG_USER_NAME,
+                                           name, name_len) == 0) {
+            *errnop = 0;
+            nret = NSS_STATUS_NOTFOUND;
+            goto out;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -279,6 +292,11 @@ enum nss_status _nss_sss_getpwuid_r(uid_t uid, struct passwd *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder told us the entry does not exist */
+        if (sss_nss_mc_check_negative_id(SSS_MC_NEG_UID, uid) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -306,6 +324,12 @@ enum nss_status _nss_sss_getpwuid_r(uid_t uid, struct passwd *result,
         nret = NSS_STATUS_TRYAGAIN;
         goto out;
     case ENOENT:
+        /* or a previous thread learned it does not exist */
+        if (sss_nss_mc_check_negative_id(SSS_MC_NEG_UID, uid) == 0) {
+            *errnop = 0;
+            nret = NSS_STATUS_NOTFOUND;
+            goto out;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
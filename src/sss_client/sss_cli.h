@@ -82,6 +82,8 @@ enum sss_cli_command {
 
     SSS_NSS_GETPWNAM_EX    = 0x0019,
     SSS_NSS_GETPWUID_EX    = 0x001A,
+    SSS_NSS_GETPWUID_BATCH = 0x001B, /**< resolve a vector of UIDs, see
+                                      * SSS_NSS_BATCH_MAX_IDS */
 
 /* group */
 
@@ -94,6 +96,8 @@ enum sss_cli_command {
 
     SSS_NSS_GETGRNAM_EX    = 0x0029,
     SSS_NSS_GETGRGID_EX    = 0x002A,
+    SSS_NSS_GETGRGID_BATCH = 0x002B, /**< resolve a vector of GIDs, see
+                                      * SSS_NSS_BATCH_MAX_IDS */
     SSS_NSS_INITGR_EX      = 0x002E,
 
 #if 0
@@ -428,6 +432,19 @@ enum pam_item_type {
 
 #define SSS_NSS_MAX_ENTRIES 256
 #define SSS_NSS_HEADER_SIZE (sizeof(uint32_t) * 4)
+
+/* SSS_NSS_GETPWUID_BATCH and SSS_NSS_GETGRGID_BATCH
+ *
+ * request:  uint32_t num_ids, uint32_t flags (SSS_NSS_EX_FLAG_*),
+ *           num_ids * uint32_t id
+ * reply:    uint32_t num_results, uint32_t num_failed,
+ *           num_results * (uint32_t index, entry as in the GETPWUID or
+ *                          GETGRGID reply),
+ *           num_failed * (uint32_t index, uint32_t errno)
+ *
+ * index is the position of the id in the request. IDs that are neither
+ * among the results nor among the failures were not found. */
+#define SSS_NSS_BATCH_MAX_IDS 1024
 struct sss_cli_req_data {
     size_t len;
     const void *data;
@@ -89,6 +89,20 @@ bool sdap_has_deref_support(struct sdap_handle *sh,
     return sss_mock_type(bool);
 }
 
+/* Searches that were sent but not received yet */
+static size_t generic_in_flight;
+static size_t generic_in_flight_max;
+
+size_t mock_sdap_get_generic_max_in_flight(void)
+{
+    size_t max = generic_in_flight_max;
+
+    generic_in_flight = 0;
+    generic_in_flight_max = 0;
+
+    return max;
+}
+
 struct tevent_req *sdap_get_generic_send(TALLOC_CTX *mem_ctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
@@ -102,6 +116,9 @@ struct tevent_req *sdap_get_generic_send(TALLOC_CTX *mem_ctx,
                                          int timeout,
                                          bool allow_paging)
 {
+    generic_in_flight++;
+    generic_in_flight_max = MAX(generic_in_flight_max, generic_in_flight);
+
     return test_req_succeed_send(mem_ctx, ev);
 }
 
@@ -110,6 +127,10 @@ int sdap_get_generic_recv(struct tevent_req *req,
                           size_t *reply_count,
                           struct sysdb_attrs ***reply)
 {
+    if (generic_in_flight > 0) {
+        generic_in_flight--;
+    }
+
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
     *reply_count = sss_mock_type(size_t);
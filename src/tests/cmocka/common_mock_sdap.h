@@ -37,4 +37,8 @@ struct sdap_id_ctx *mock_sdap_id_ctx(TALLOC_CTX *mem_ctx,
 
 struct sdap_handle *mock_sdap_handle(TALLOC_CTX *mem_ctx);
 
+/* Highest number of sdap_get_generic_send() searches that were outstanding
+ * at once since the last call */
+size_t mock_sdap_get_generic_max_in_flight(void);
+
 #endif /* COMMON_MOCK_SDAP_H_ */
@@ -21,6 +21,8 @@
 */
 
 #include <errno.h>
+#include <stdio.h>
+#include <time.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
@@ -68,6 +70,132 @@ uint8_t buf_initgr[] = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x
 
 uint8_t buf_initgr_no_gr[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+/* If set, requests are answered by test_responder_reply() instead of the
+ * data queued with will_return() */
+static bool test_responder;
+static size_t test_responder_requests;
+static uint32_t test_responder_flags;
+/* Time each request of the emulated responder takes */
+static long test_responder_delay_ms;
+
+/* IDs of the emulated responder: ids ending with 9 do not exist and
+ * TEST_ERROR_ID fails with EIO */
+#define TEST_ERROR_ID 1013
+#define TEST_MISSING_ID(id) ((id) % 10 == 9)
+#define TEST_ENTRY_MAX 256
+
+static size_t test_responder_entry(enum sss_cli_command cmd, uint32_t id,
+                                   uint8_t *buf)
+{
+    size_t rp = 0;
+    uint32_t num_mem = 2;
+    int len;
+
+    SAFEALIGN_SET_UINT32(buf, id, &rp);
+    if (cmd == SSS_NSS_GETPWUID_EX || cmd == SSS_NSS_GETPWUID_BATCH) {
+        SAFEALIGN_SET_UINT32(buf + rp, id + 100000, &rp);
+        len = snprintf((char *) buf + rp, TEST_ENTRY_MAX - rp,
+                       "user%u%cx%cUser %u%c/home/user%u%c/bin/sh",
+                       id, '\0', '\0', id, '\0', id, '\0');
+    } else {
+        SAFEALIGN_SET_UINT32(buf + rp, num_mem, &rp);
+        len = snprintf((char *) buf + rp, TEST_ENTRY_MAX - rp,
+                       "group%u%cx%cuser%u%cadmin",
+                       id, '\0', '\0', id, '\0');
+    }
+    assert_true(len > 0 && len < TEST_ENTRY_MAX - rp);
+
+    return rp + len + 1;
+}
+
+static enum nss_status test_responder_reply(enum sss_cli_command cmd,
+                                            struct sss_cli_req_data *rd,
+                                            uint8_t **repbuf,
+                                            size_t *replen,
+                                            int *errnop)
+{
+    const uint8_t *body = rd->data;
+    bool batch;
+    uint32_t num_ids;
+    uint32_t num_results = 0;
+    uint32_t num_failed = 0;
+    uint32_t failed[SSS_NSS_BATCH_MAX_IDS];
+    uint32_t id;
+    uint32_t c;
+    uint8_t *buf;
+    size_t rp;
+
+    test_responder_requests++;
+
+    if (test_responder_delay_ms > 0) {
+        struct timespec delay = { test_responder_delay_ms / 1000,
+                                  (test_responder_delay_ms % 1000) * 1000000 };
+
+        while (nanosleep(&delay, &delay) != 0 && errno == EINTR);
+    }
+
+    batch = (cmd == SSS_NSS_GETPWUID_BATCH || cmd == SSS_NSS_GETGRGID_BATCH);
+    if (batch) {
+        SAFEALIGN_COPY_UINT32(&num_ids, body, NULL);
+        SAFEALIGN_COPY_UINT32(&test_responder_flags, body + sizeof(uint32_t),
+                              NULL);
+        assert_true(num_ids > 0 && num_ids <= SSS_NSS_BATCH_MAX_IDS);
+        assert_int_equal(rd->len, (2 + num_ids) * sizeof(uint32_t));
+        body += 2 * sizeof(uint32_t);
+    } else {
+        assert_true(cmd == SSS_NSS_GETPWUID_EX || cmd == SSS_NSS_GETGRGID_EX);
+        assert_int_equal(rd->len, 2 * sizeof(uint32_t));
+        SAFEALIGN_COPY_UINT32(&test_responder_flags, body + sizeof(uint32_t),
+                              NULL);
+        num_ids = 1;
+    }
+
+    buf = malloc(2 * sizeof(uint32_t)
+                 + num_ids * (sizeof(uint32_t) + TEST_ENTRY_MAX));
+    assert_non_null(buf);
+    rp = 2 * sizeof(uint32_t);
+
+    for (c = 0; c < num_ids; c++) {
+        SAFEALIGN_COPY_UINT32(&id, body + c * sizeof(uint32_t), NULL);
+        if (id == TEST_ERROR_ID) {
+            if (!batch) {
+                free(buf);
+                *errnop = EIO;
+                return NSS_STATUS_UNAVAIL;
+            }
+            failed[num_failed++] = c;
+            continue;
+        }
+        if (TEST_MISSING_ID(id)) {
+            continue;
+        }
+
+        if (batch) {
+            SAFEALIGN_SET_UINT32(buf + rp, c, &rp);
+        }
+        rp += test_responder_entry(cmd, id, buf + rp);
+        num_results++;
+    }
+
+    for (c = 0; c < num_failed; c++) {
+        SAFEALIGN_SET_UINT32(buf + rp, failed[c], &rp);
+        SAFEALIGN_SET_UINT32(buf + rp, EIO, &rp);
+    }
+
+    SAFEALIGN_COPY_UINT32(buf, &num_results, NULL);
+    if (batch) {
+        SAFEALIGN_COPY_UINT32(buf + sizeof(uint32_t), &num_failed, NULL);
+    } else {
+        memset(buf + sizeof(uint32_t), 0, sizeof(uint32_t));
+    }
+
+    *repbuf = buf;
+    *replen = rp;
+    *errnop = 0;
+
+    return NSS_STATUS_SUCCESS;
+}
+
 enum nss_status __wrap_sss_nss_make_request_timeout(enum sss_cli_command cmd,
                                                     struct sss_cli_req_data *rd,
                                                     int timeout,
@@ -77,6 +205,10 @@ enum nss_status __wrap_sss_nss_make_request_timeout(enum sss_cli_command cmd,
 {
     struct sss_nss_make_request_test_data *d;
 
+    if (test_responder) {
+        return test_responder_reply(cmd, rd, repbuf, replen, errnop);
+    }
+
     d = sss_mock_ptr_type(struct sss_nss_make_request_test_data *);
 
     *replen = d->replen;
@@ -179,6 +311,264 @@ void test_sss_nss_getgrouplist_timeout(void **state)
     assert_int_equal(groups[0], 111);
 }
 
+static int test_responder_setup(void **state)
+{
+    test_responder = true;
+    test_responder_requests = 0;
+    test_responder_flags = 0;
+    test_responder_delay_ms = 0;
+
+    return 0;
+}
+
+static int test_responder_teardown(void **state)
+{
+    test_responder = false;
+    test_responder_delay_ms = 0;
+
+    return 0;
+}
+
+static void check_pwd(struct passwd *pwd, uid_t uid)
+{
+    char str[64];
+
+    assert_non_null(pwd);
+    assert_int_equal(pwd->pw_uid, uid);
+    assert_int_equal(pwd->pw_gid, uid + 100000);
+    snprintf(str, sizeof(str), "user%u", uid);
+    assert_string_equal(pwd->pw_name, str);
+    assert_string_equal(pwd->pw_passwd, "x");
+    snprintf(str, sizeof(str), "User %u", uid);
+    assert_string_equal(pwd->pw_gecos, str);
+    snprintf(str, sizeof(str), "/home/user%u", uid);
+    assert_string_equal(pwd->pw_dir, str);
+    assert_string_equal(pwd->pw_shell, "/bin/sh");
+}
+
+void test_sss_nss_getpwuid_batch_timeout(void **state)
+{
+    uid_t uids[] = { 1000, 1009, TEST_ERROR_ID, 1001, 1000 };
+    struct passwd *pwds[5];
+    int errs[5];
+    size_t c;
+    int ret;
+
+    ret = sss_nss_getpwuid_batch_timeout(uids, 5, pwds, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE, 0);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_responder_requests, 1);
+    assert_int_equal(test_responder_flags, SSS_NSS_EX_FLAG_NO_CACHE);
+
+    assert_int_equal(errs[0], 0);
+    check_pwd(pwds[0], 1000);
+    assert_int_equal(errs[1], ENOENT);
+    assert_null(pwds[1]);
+    assert_int_equal(errs[2], EIO);
+    assert_null(pwds[2]);
+    assert_int_equal(errs[3], 0);
+    check_pwd(pwds[3], 1001);
+    /* duplicates are separate entries */
+    assert_int_equal(errs[4], 0);
+    check_pwd(pwds[4], 1000);
+    assert_ptr_not_equal(pwds[0], pwds[4]);
+
+    for (c = 0; c < 5; c++) {
+        free(pwds[c]);
+    }
+
+    ret = sss_nss_getpwuid_batch_timeout(uids, 5, pwds, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE
+                                            | SSS_NSS_EX_FLAG_INVALIDATE_CACHE,
+                                         0);
+    assert_int_equal(ret, EINVAL);
+    assert_int_equal(test_responder_requests, 1);
+
+    ret = sss_nss_getpwuid_batch_timeout(uids, 0, pwds, errs, 0, 0);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_responder_requests, 1);
+}
+
+void test_sss_nss_getgrgid_batch_timeout(void **state)
+{
+    gid_t gids[] = { 2019, 2000 };
+    struct group *grps[2];
+    int errs[2];
+    int ret;
+
+    ret = sss_nss_getgrgid_batch_timeout(gids, 2, grps, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE, 0);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_responder_requests, 1);
+
+    assert_int_equal(errs[0], ENOENT);
+    assert_null(grps[0]);
+
+    assert_int_equal(errs[1], 0);
+    assert_non_null(grps[1]);
+    assert_int_equal(grps[1]->gr_gid, 2000);
+    assert_string_equal(grps[1]->gr_name, "group2000");
+    assert_string_equal(grps[1]->gr_passwd, "x");
+    assert_string_equal(grps[1]->gr_mem[0], "user2000");
+    assert_string_equal(grps[1]->gr_mem[1], "admin");
+    assert_null(grps[1]->gr_mem[2]);
+
+    free(grps[1]);
+}
+
+void test_sss_nss_getpwuid_batch_budget(void **state)
+{
+    const size_t num_uids = SSS_NSS_BATCH_MAX_IDS + 1;
+    uid_t uids[SSS_NSS_BATCH_MAX_IDS + 1];
+    struct passwd *pwds[SSS_NSS_BATCH_MAX_IDS + 1];
+    int errs[SSS_NSS_BATCH_MAX_IDS + 1];
+    size_t c;
+    int ret;
+
+    for (c = 0; c < num_uids; c++) {
+        uids[c] = 100000 + c;
+    }
+
+    /* The first request uses up the whole timeout, the second one, which
+     * is needed for the last uid, is not sent */
+    test_responder_delay_ms = 50;
+    ret = sss_nss_getpwuid_batch_timeout(uids, num_uids, pwds, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE, 20);
+    assert_int_equal(ret, ETIMEDOUT);
+    assert_int_equal(test_responder_requests, 1);
+
+    for (c = 0; c < num_uids; c++) {
+        assert_null(pwds[c]);
+        assert_int_equal(errs[c], ETIMEDOUT);
+    }
+}
+
+void test_sss_nss_getpwuid_batch_bad_reply(void **state)
+{
+    uid_t uids[] = { 1000, 1001 };
+    struct passwd *pwds[2];
+    int errs[2];
+    uint8_t buf[3 * sizeof(uint32_t)];
+    uint32_t val;
+    struct sss_nss_make_request_test_data d = {buf, sizeof(buf), 0,
+                                               NSS_STATUS_SUCCESS};
+    int ret;
+
+    /* the result refers to an id that was not requested */
+    val = 1;
+    SAFEALIGN_COPY_UINT32(buf, &val, NULL);
+    val = 0;
+    SAFEALIGN_COPY_UINT32(buf + sizeof(uint32_t), &val, NULL);
+    val = 2;
+    SAFEALIGN_COPY_UINT32(buf + 2 * sizeof(uint32_t), &val, NULL);
+
+    will_return(__wrap_sss_nss_make_request_timeout, &d);
+    ret = sss_nss_getpwuid_batch_timeout(uids, 2, pwds, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE, 0);
+    assert_int_equal(ret, EBADMSG);
+    assert_null(pwds[0]);
+    assert_null(pwds[1]);
+    assert_int_equal(errs[0], EBADMSG);
+    assert_int_equal(errs[1], EBADMSG);
+}
+
+#define TEST_BENCH_IDS 10000
+
+static double test_bench_elapsed(struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) * 1000.0
+           + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* Resolves the same uids one by one and with the batch call. The responder is
+ * emulated in process, so the number of requests, each of which is a round
+ * trip to the responder in a real setup, is the main figure here. It runs
+ * only if SSS_TEST_BENCHMARK is set, this binary does not link the common
+ * test library, hence the direct getenv(). */
+void test_sss_nss_getpwuid_batch_benchmark(void **state)
+{
+    uid_t *uids;
+    struct passwd **pwds;
+    int *errs;
+    struct passwd pwd;
+    struct passwd *result;
+    char buffer[1024];
+    struct timespec start;
+    double serial_ms;
+    double batch_ms;
+    size_t serial_requests;
+    size_t found = 0;
+    size_t c;
+    int ret;
+    const char *bench;
+
+    bench = getenv("SSS_TEST_BENCHMARK");
+    if (bench == NULL || *bench == '\0' || strcmp(bench, "0") == 0) {
+        skip();
+    }
+
+    uids = malloc(TEST_BENCH_IDS * sizeof(uid_t));
+    pwds = malloc(TEST_BENCH_IDS * sizeof(struct passwd *));
+    errs = malloc(TEST_BENCH_IDS * sizeof(int));
+    assert_non_null(uids);
+    assert_non_null(pwds);
+    assert_non_null(errs);
+
+    for (c = 0; c < TEST_BENCH_IDS; c++) {
+        uids[c] = 100000 + c;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (c = 0; c < TEST_BENCH_IDS; c++) {
+        ret = sss_nss_getpwuid_timeout(uids[c], &pwd, buffer, sizeof(buffer),
+                                       &result, SSS_NSS_EX_FLAG_NO_CACHE, 0);
+        if (ret == 0) {
+            found++;
+        }
+    }
+    serial_ms = test_bench_elapsed(&start);
+    serial_requests = test_responder_requests;
+
+    assert_int_equal(serial_requests, TEST_BENCH_IDS);
+    assert_int_equal(found, TEST_BENCH_IDS - TEST_BENCH_IDS / 10);
+
+    test_responder_requests = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sss_nss_getpwuid_batch_timeout(uids, TEST_BENCH_IDS, pwds, errs,
+                                         SSS_NSS_EX_FLAG_NO_CACHE, 0);
+    batch_ms = test_bench_elapsed(&start);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_responder_requests,
+                     (TEST_BENCH_IDS + SSS_NSS_BATCH_MAX_IDS - 1)
+                        / SSS_NSS_BATCH_MAX_IDS);
+
+    found = 0;
+    for (c = 0; c < TEST_BENCH_IDS; c++) {
+        if (errs[c] == 0) {
+            check_pwd(pwds[c], uids[c]);
+            found++;
+        } else {
+            assert_int_equal(errs[c], ENOENT);
+            assert_null(pwds[c]);
+        }
+        free(pwds[c]);
+    }
+    assert_int_equal(found, TEST_BENCH_IDS - TEST_BENCH_IDS / 10);
+
+    printf("%d uids:\n", TEST_BENCH_IDS);
+    printf("  serial:  %zu requests, %.1f ms\n", serial_requests, serial_ms);
+    printf("  batched: %zu requests, %.1f ms\n", test_responder_requests,
+           batch_ms);
+
+    free(uids);
+    free(pwds);
+    free(errs);
+}
+
 int main(int argc, const char *argv[])
 {
 
@@ -186,6 +576,19 @@ int main(int argc, const char *argv[])
         cmocka_unit_test(test_getsidbyname),
         cmocka_unit_test(test_getorigbyname),
         cmocka_unit_test(test_sss_nss_getgrouplist_timeout),
+        cmocka_unit_test_setup_teardown(test_sss_nss_getpwuid_batch_timeout,
+                                        test_responder_setup,
+                                        test_responder_teardown),
+        cmocka_unit_test_setup_teardown(test_sss_nss_getgrgid_batch_timeout,
+                                        test_responder_setup,
+                                        test_responder_teardown),
+        cmocka_unit_test_setup_teardown(test_sss_nss_getpwuid_batch_budget,
+                                        test_responder_setup,
+                                        test_responder_teardown),
+        cmocka_unit_test(test_sss_nss_getpwuid_batch_bad_reply),
+        cmocka_unit_test_setup_teardown(test_sss_nss_getpwuid_batch_benchmark,
+                                        test_responder_setup,
+                                        test_responder_teardown),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
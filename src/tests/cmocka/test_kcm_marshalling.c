@@ -255,6 +255,102 @@ static void test_kcm_ccache_no_princ_binary(void **state)
     assert_cc_equal(cc, cc2);
 }
 
+static void test_kcm_ccache_separate_creds_binary(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx = talloc_get_type(*state,
+                                        struct kcm_marshalling_test_ctx);
+    errno_t ret;
+    struct cli_creds owner;
+    struct kcm_ccache *cc;
+    struct kcm_ccache *cc2;
+    struct kcm_cred *crd;
+    struct kcm_cred *crd2;
+    struct sss_iobuf *payload;
+    struct sss_iobuf *cred_blob;
+    struct sss_iobuf *cred_blob2;
+    const char *name;
+    const char *key;
+    bool separate_creds;
+    time_t expiration;
+    uuid_t uuid;
+    uuid_t uuid2;
+    uint32_t seq;
+
+    owner.ucred.uid = getuid();
+    owner.ucred.gid = getuid();
+
+    name = talloc_asprintf(test_ctx, "%"SPRIuid, getuid());
+    assert_non_null(name);
+
+    ret = kcm_cc_new(test_ctx,
+                     test_ctx->kctx,
+                     &owner,
+                     name,
+                     test_ctx->princ,
+                     &cc);
+    assert_int_equal(ret, EOK);
+
+    ret = kcm_cc_get_uuid(cc, uuid);
+    assert_int_equal(ret, EOK);
+    key = sec_key_create(test_ctx, name, uuid);
+    assert_non_null(key);
+
+    /* The whole-ccache format */
+    ret = kcm_ccache_to_sec_input_binary(test_ctx, cc, &payload);
+    assert_int_equal(ret, EOK);
+
+    ret = sec_value_ccache_layout_binary(payload, &separate_creds,
+                                         &expiration);
+    assert_int_equal(ret, EOK);
+    assert_false(separate_creds);
+    assert_int_equal(expiration, 0);
+
+    /* The header of a ccache with separate credential records */
+    ret = kcm_ccache_header_to_sec_input_binary(test_ctx, cc, 1234, &payload);
+    assert_int_equal(ret, EOK);
+
+    ret = sec_value_ccache_layout_binary(payload, &separate_creds,
+                                         &expiration);
+    assert_int_equal(ret, EOK);
+    assert_true(separate_creds);
+    assert_int_equal(expiration, 1234);
+
+    ret = sec_kv_to_ccache_binary(test_ctx, key, payload, &owner, &cc2);
+    assert_int_equal(ret, EOK);
+
+    assert_cc_equal(cc, cc2);
+    assert_null(kcm_cc_get_cred(cc2));
+
+    /* A single credential record */
+    cred_blob = sss_iobuf_init_readonly(test_ctx,
+                                        (const uint8_t *) TEST_CREDS,
+                                        sizeof(TEST_CREDS),
+                                        false);
+    assert_non_null(cred_blob);
+
+    uuid_generate(uuid);
+    crd = kcm_cred_new(test_ctx, uuid, cred_blob);
+    assert_non_null(crd);
+
+    ret = kcm_cred_to_sec_input_binary(test_ctx, crd, 42, &payload);
+    assert_int_equal(ret, EOK);
+
+    sss_iobuf_cursor_reset(payload);
+    ret = sec_value_to_kcm_cred_binary(test_ctx, payload, &seq, &crd2);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(seq, 42);
+
+    ret = kcm_cred_get_uuid(crd2, uuid2);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(uuid_compare(uuid, uuid2), 0);
+
+    cred_blob2 = kcm_cred_get_creds(crd2);
+    assert_non_null(cred_blob2);
+    assert_int_equal(sss_iobuf_get_size(cred_blob2), sizeof(TEST_CREDS));
+    assert_memory_equal(sss_iobuf_get_data(cred_blob2), TEST_CREDS,
+                        sizeof(TEST_CREDS));
+}
+
 void test_sec_key_get_uuid(void **state)
 {
     errno_t ret;
@@ -331,6 +427,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_kcm_ccache_no_princ_binary,
                                         setup_kcm_marshalling,
                                         teardown_kcm_marshalling),
+        cmocka_unit_test_setup_teardown(test_kcm_ccache_separate_creds_binary,
+                                        setup_kcm_marshalling,
+                                        teardown_kcm_marshalling),
         cmocka_unit_test(test_sec_key_get_uuid),
         cmocka_unit_test(test_sec_key_get_name),
         cmocka_unit_test(test_sec_key_match_name),
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <popt.h>
+#include <sys/time.h>
 
 #include "util/util.h"
 #include "util/util_creds.h"
@@ -32,8 +33,13 @@
 #define FAST_REQ_ID     0
 #define SLOW_REQ_ID     1
 
-#define FAST_REQ_DELAY  1
-#define SLOW_REQ_DELAY  2
+/* Delays are in milliseconds */
+#define FAST_REQ_DELAY  1000
+#define SLOW_REQ_DELAY  2000
+
+#define LOAD_NUM_CCACHES    200
+#define LOAD_READERS        4
+#define LOAD_REQ_DELAY      10
 
 /* register_cli_protocol_version is required in test since it links with
  * responder_common.c module
@@ -47,6 +53,15 @@ struct cli_protocol_version *register_cli_protocol_version(void)
     return responder_test_cli_protocol_version;
 }
 
+/* Tracks the requests running against a single ccache to detect requests
+ * the queue should have serialized
+ */
+struct ccache_usage {
+    int readers;
+    int writers;
+    bool conflict;
+};
+
 struct timed_request_state {
     struct tevent_context *ev;
     struct resp_ctx *rctx;
@@ -54,6 +69,8 @@ struct timed_request_state {
     struct cli_creds *client;
     int delay;
     int req_id;
+    bool write;
+    struct ccache_usage *usage;
 
     struct kcm_ops_queue_entry *queue_entry;
 };
@@ -69,6 +86,9 @@ static struct tevent_req *timed_request_send(TALLOC_CTX *mem_ctx,
                                              struct resp_ctx *rctx,
                                              struct kcm_ops_queue_ctx *qctx,
                                              struct cli_creds *client,
+                                             enum kcm_op_access access,
+                                             const char *ccache_name,
+                                             struct ccache_usage *usage,
                                              int delay,
                                              int req_id)
 {
@@ -86,10 +106,13 @@ static struct tevent_req *timed_request_send(TALLOC_CTX *mem_ctx,
     state->client = client;
     state->delay = delay;
     state->req_id = req_id;
+    state->write = (access == KCM_OP_ACCESS_UID_WRITE
+                        || access == KCM_OP_ACCESS_CC_WRITE);
+    state->usage = usage;
 
     DEBUG(SSSDBG_TRACE_ALL, "Request %p with delay %d\n", req, delay);
 
-    subreq = kcm_op_queue_send(state, ev, qctx, client);
+    subreq = kcm_op_queue_send(state, ev, qctx, client, access, ccache_name);
     if (subreq == NULL) {
         return NULL;
     }
@@ -115,7 +138,21 @@ static void timed_request_start(struct tevent_req *subreq)
         return;
     }
 
-    tv = tevent_timeval_current_ofs(state->delay, 0);
+    if (state->usage != NULL) {
+        if (state->usage->writers > 0
+                || (state->write && state->usage->readers > 0)) {
+            state->usage->conflict = true;
+        }
+
+        if (state->write) {
+            state->usage->writers++;
+        } else {
+            state->usage->readers++;
+        }
+    }
+
+    tv = tevent_timeval_current_ofs(state->delay / 1000,
+                                    (state->delay % 1000) * 1000);
     timeout = tevent_add_timer(state->ev, state, tv, timed_request_done, req);
     if (timeout == NULL) {
         tevent_req_error(req, ENOMEM);
@@ -131,6 +168,17 @@ static void timed_request_done(struct tevent_context *ev,
                                void *pvt)
 {
     struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct timed_request_state *state = tevent_req_data(req,
+                                                struct timed_request_state);
+
+    if (state->usage != NULL) {
+        if (state->write) {
+            state->usage->writers--;
+        } else {
+            state->usage->readers--;
+        }
+    }
+
     DEBUG(SSSDBG_TRACE_ALL, "Request %p done\n", req);
     tevent_req_done(req);
 }
@@ -252,7 +300,9 @@ static void test_kcm_queue_single(void **state)
                              test_ctx->ev,
                              test_ctx->rctx,
                              test_ctx->qctx,
-                             &client, 1, 0);
+                             &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
+                             FAST_REQ_DELAY, 0);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -286,6 +336,7 @@ static void test_kcm_queue_multi_same_id(void **state)
                              test_ctx->rctx,
                              test_ctx->qctx,
                              &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
                              SLOW_REQ_DELAY,
                              SLOW_REQ_ID);
     assert_non_null(req);
@@ -296,6 +347,7 @@ static void test_kcm_queue_multi_same_id(void **state)
                              test_ctx->rctx,
                              test_ctx->qctx,
                              &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
                              FAST_REQ_DELAY,
                              FAST_REQ_ID);
     assert_non_null(req);
@@ -333,6 +385,7 @@ static void test_kcm_queue_multi_different_id(void **state)
                              test_ctx->rctx,
                              test_ctx->qctx,
                              &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
                              SLOW_REQ_DELAY,
                              SLOW_REQ_ID);
     assert_non_null(req);
@@ -346,6 +399,7 @@ static void test_kcm_queue_multi_different_id(void **state)
                              test_ctx->rctx,
                              test_ctx->qctx,
                              &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
                              FAST_REQ_DELAY,
                              FAST_REQ_ID);
     assert_non_null(req);
@@ -360,6 +414,284 @@ static void test_kcm_queue_multi_different_id(void **state)
     assert_int_equal(test_ctx->error, EOK);
 }
 
+static void run_two_requests(struct test_ctx *test_ctx,
+                             enum kcm_op_access slow_access,
+                             const char *slow_ccache,
+                             enum kcm_op_access fast_access,
+                             const char *fast_ccache,
+                             int *req_ids)
+{
+    struct tevent_req *req;
+    struct cli_creds client;
+
+    client.ucred.uid = getuid();
+    client.ucred.gid = getgid();
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->rctx,
+                             test_ctx->qctx,
+                             &client,
+                             slow_access, slow_ccache, NULL,
+                             SLOW_REQ_DELAY,
+                             SLOW_REQ_ID);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->rctx,
+                             test_ctx->qctx,
+                             &client,
+                             fast_access, fast_ccache, NULL,
+                             FAST_REQ_DELAY,
+                             FAST_REQ_ID);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    test_ctx->num_requests = 2;
+    test_ctx->req_ids = req_ids;
+
+    while (test_ctx->done == false) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    assert_int_equal(test_ctx->error, EOK);
+}
+
+/*
+ * Test that requests reading the same ccache run concurrently
+ */
+static void test_kcm_queue_readers_same_ccache(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    static int req_ids[] = { FAST_REQ_ID, SLOW_REQ_ID };
+
+    run_two_requests(test_ctx,
+                     KCM_OP_ACCESS_CC_READ, "0",
+                     KCM_OP_ACCESS_CC_READ, "0",
+                     req_ids);
+}
+
+/*
+ * Test that requests listing the ccaches run concurrently with readers
+ */
+static void test_kcm_queue_uid_reader_cc_reader(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    static int req_ids[] = { FAST_REQ_ID, SLOW_REQ_ID };
+
+    run_two_requests(test_ctx,
+                     KCM_OP_ACCESS_CC_READ, "0",
+                     KCM_OP_ACCESS_UID_READ, NULL,
+                     req_ids);
+}
+
+/*
+ * Test that requests modifying different ccaches run concurrently
+ */
+static void test_kcm_queue_writers_different_ccache(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    static int req_ids[] = { FAST_REQ_ID, SLOW_REQ_ID };
+
+    run_two_requests(test_ctx,
+                     KCM_OP_ACCESS_CC_WRITE, "0",
+                     KCM_OP_ACCESS_CC_WRITE, "1",
+                     req_ids);
+}
+
+/*
+ * Test that a request modifying a ccache waits for its reader
+ */
+static void test_kcm_queue_reader_writer_same_ccache(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    static int req_ids[] = { SLOW_REQ_ID, FAST_REQ_ID };
+
+    run_two_requests(test_ctx,
+                     KCM_OP_ACCESS_CC_READ, "0",
+                     KCM_OP_ACCESS_CC_WRITE, "0",
+                     req_ids);
+}
+
+/*
+ * Test that a reader of a ccache waits for its writer
+ */
+static void test_kcm_queue_writer_reader_same_ccache(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    static int req_ids[] = { SLOW_REQ_ID, FAST_REQ_ID };
+
+    run_two_requests(test_ctx,
+                     KCM_OP_ACCESS_CC_WRITE, "0",
+                     KCM_OP_ACCESS_CC_READ, "0",
+                     req_ids);
+}
+
+/*
+ * Test that a request modifying all ccaches of the UID waits for the
+ * requests queued before it and that the requests queued after it wait
+ * even if they would not conflict with the requests that are running
+ */
+static void test_kcm_queue_uid_writer(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct tevent_req *req;
+    struct cli_creds client;
+    static int req_ids[] = { 0, 1, 2 };
+
+    client.ucred.uid = getuid();
+    client.ucred.gid = getgid();
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->rctx,
+                             test_ctx->qctx,
+                             &client,
+                             KCM_OP_ACCESS_CC_READ, "0", NULL,
+                             SLOW_REQ_DELAY, 0);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->rctx,
+                             test_ctx->qctx,
+                             &client,
+                             KCM_OP_ACCESS_UID_WRITE, NULL, NULL,
+                             FAST_REQ_DELAY, 1);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->rctx,
+                             test_ctx->qctx,
+                             &client,
+                             KCM_OP_ACCESS_CC_READ, "1", NULL,
+                             FAST_REQ_DELAY, 2);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    test_ctx->num_requests = 3;
+    test_ctx->req_ids = req_ids;
+
+    while (test_ctx->done == false) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    assert_int_equal(test_ctx->error, EOK);
+}
+
+static void test_kcm_queue_load_done(struct tevent_req *req)
+{
+    struct test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                struct test_ctx);
+    int req_id = INVALID_ID;
+    errno_t ret;
+
+    ret = timed_request_recv(req, &req_id);
+    talloc_zfree(req);
+    if (ret != EOK) {
+        test_ctx->error = ret;
+        test_ctx->done = true;
+        return;
+    }
+
+    test_ctx->finished_requests++;
+    if (test_ctx->finished_requests == test_ctx->num_requests) {
+        test_ctx->done = true;
+    }
+}
+
+/*
+ * Run a writer followed by several readers against each of many ccaches
+ * of a single UID. The requests for one ccache must not overlap in a
+ * conflicting way, but the ccaches must not wait for each other.
+ */
+static void test_kcm_queue_load(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct tevent_req *req;
+    struct cli_creds client;
+    struct ccache_usage *usage;
+    struct timeval start;
+    struct timeval end;
+    const char *name;
+    long serial_ms;
+    long elapsed_ms;
+    int num_requests;
+    int req_id = 0;
+    int i;
+    int j;
+
+    client.ucred.uid = getuid();
+    client.ucred.gid = getgid();
+
+    usage = talloc_zero_array(test_ctx, struct ccache_usage,
+                              LOAD_NUM_CCACHES);
+    assert_non_null(usage);
+
+    num_requests = LOAD_NUM_CCACHES * (LOAD_READERS + 1);
+    test_ctx->num_requests = num_requests;
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < LOAD_NUM_CCACHES; i++) {
+        name = talloc_asprintf(test_ctx, "%d", i);
+        assert_non_null(name);
+
+        req = timed_request_send(test_ctx,
+                                 test_ctx->ev,
+                                 test_ctx->rctx,
+                                 test_ctx->qctx,
+                                 &client,
+                                 KCM_OP_ACCESS_CC_WRITE, name, &usage[i],
+                                 LOAD_REQ_DELAY, req_id++);
+        assert_non_null(req);
+        tevent_req_set_callback(req, test_kcm_queue_load_done, test_ctx);
+
+        for (j = 0; j < LOAD_READERS; j++) {
+            req = timed_request_send(test_ctx,
+                                     test_ctx->ev,
+                                     test_ctx->rctx,
+                                     test_ctx->qctx,
+                                     &client,
+                                     KCM_OP_ACCESS_CC_READ, name, &usage[i],
+                                     LOAD_REQ_DELAY, req_id++);
+            assert_non_null(req);
+            tevent_req_set_callback(req, test_kcm_queue_load_done, test_ctx);
+        }
+    }
+
+    while (test_ctx->done == false) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    assert_int_equal(test_ctx->error, EOK);
+    assert_int_equal(test_ctx->finished_requests, num_requests);
+
+    gettimeofday(&end, NULL);
+
+    for (i = 0; i < LOAD_NUM_CCACHES; i++) {
+        assert_false(usage[i].conflict);
+        assert_int_equal(usage[i].readers, 0);
+        assert_int_equal(usage[i].writers, 0);
+    }
+
+    elapsed_ms = (end.tv_sec - start.tv_sec) * 1000
+                    + (end.tv_usec - start.tv_usec) / 1000;
+    serial_ms = (long) num_requests * LOAD_REQ_DELAY;
+
+    if (test_benchmark_enabled()) {
+        printf("%d requests on %d ccaches finished in %ld ms "
+               "(%ld ms if serialized), %.1f requests/s\n",
+               num_requests, LOAD_NUM_CCACHES, elapsed_ms, serial_ms,
+               elapsed_ms > 0 ? num_requests * 1000.0 / elapsed_ms : 0.0);
+    }
+
+    /* One writer and one batch of readers per ccache, all ccaches at once */
+    assert_true(elapsed_ms < serial_ms / 4);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -381,6 +713,27 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_kcm_queue_multi_different_id,
                                         setup_kcm_queue,
                                         teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_readers_same_ccache,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_uid_reader_cc_reader,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_writers_different_ccache,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_reader_writer_same_ccache,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_writer_reader_same_ccache,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_uid_writer,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_load,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -0,0 +1,809 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: Test the in-memory copy of the KCM secdb ccaches
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <popt.h>
+#include <sys/stat.h>
+
+#include "util/util.h"
+#include "util/util_creds.h"
+#include "tests/cmocka/common_mock.h"
+#include "responder/kcm/kcmsrv_ccache.h"
+#include "responder/kcm/kcmsrv_ccache_be.h"
+#include "responder/kcm/kcmsrv_ccache_pvt.h"
+#include "responder/kcm/kcmsrv_ccache_secdb.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_DB_FULL_PATH  TESTS_PATH "/secrets.ldb"
+
+#define TEST_REALM           "TEST.REALM"
+#define TEST_PRINC_COMPONENT "PRINC_NAME"
+
+errno_t sss_sec_init_with_path(TALLOC_CTX *mem_ctx,
+                               struct sss_sec_quota *quota,
+                               const char *dbpath,
+                               struct sss_sec_ctx **_sec_ctx);
+
+const struct kcm_ccdb_ops ccdb_mem_ops;
+
+struct kcm_secdb_test_ctx {
+    struct tevent_context *ev;
+    krb5_context kctx;
+    krb5_principal princ;
+    struct kcm_ccdb *db;
+    struct ccdb_secdb *secdb;
+    struct cli_creds client;
+};
+
+static int setup_kcm_secdb_common(void **state, struct sss_sec_quota *quota)
+{
+    struct kcm_secdb_test_ctx *test_ctx;
+    krb5_error_code kerr;
+    errno_t ret;
+
+    ret = mkdir(TESTS_PATH, 0700);
+    assert_int_equal(ret, 0);
+
+    test_ctx = talloc_zero(NULL, struct kcm_secdb_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    kerr = krb5_init_context(&test_ctx->kctx);
+    assert_int_equal(kerr, 0);
+
+    kerr = krb5_build_principal(test_ctx->kctx,
+                                &test_ctx->princ,
+                                sizeof(TEST_REALM)-1, TEST_REALM,
+                                TEST_PRINC_COMPONENT, NULL);
+    assert_int_equal(kerr, 0);
+
+    test_ctx->db = talloc_zero(test_ctx, struct kcm_ccdb);
+    assert_non_null(test_ctx->db);
+    test_ctx->db->ev = test_ctx->ev;
+    test_ctx->db->ops = &ccdb_secdb_ops;
+
+    /* Like ccdb_secdb_init() but with a database in the test directory */
+    test_ctx->secdb = talloc_zero(test_ctx->db, struct ccdb_secdb);
+    assert_non_null(test_ctx->secdb);
+
+    if (quota != NULL) {
+        quota = talloc_memdup(test_ctx->secdb, quota, sizeof(*quota));
+        assert_non_null(quota);
+    }
+
+    ret = sss_sec_init_with_path(test_ctx->secdb, quota, TEST_DB_FULL_PATH,
+                                 &test_ctx->secdb->sctx);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_hash_create(test_ctx->secdb, 0, &test_ctx->secdb->mem_uids);
+    assert_int_equal(ret, EOK);
+    test_ctx->db->db_handle = test_ctx->secdb;
+
+    test_ctx->client.ucred.uid = getuid();
+    test_ctx->client.ucred.gid = getgid();
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int setup_kcm_secdb(void **state)
+{
+    return setup_kcm_secdb_common(state, NULL);
+}
+
+static int setup_kcm_secdb_quota(void **state)
+{
+    /* No limit on the number of secrets except two ccaches per UID */
+    struct sss_sec_quota quota = { 0 };
+
+    quota.max_uid_secrets = 2;
+
+    return setup_kcm_secdb_common(state, &quota);
+}
+
+static int teardown_kcm_secdb(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    assert_non_null(test_ctx);
+
+    krb5_free_principal(test_ctx->kctx, test_ctx->princ);
+    krb5_free_context(test_ctx->kctx);
+    talloc_free(test_ctx);
+
+    unlink(TEST_DB_FULL_PATH);
+    rmdir(TESTS_PATH);
+    return 0;
+}
+
+static struct kcm_ccache *test_cc_new(struct kcm_secdb_test_ctx *test_ctx,
+                                      int num)
+{
+    struct kcm_ccache *cc;
+    char *name;
+    errno_t ret;
+
+    name = talloc_asprintf(test_ctx, "%"SPRIuid":%d",
+                           cli_creds_get_uid((&test_ctx->client)), num);
+    assert_non_null(name);
+
+    ret = kcm_cc_new(test_ctx, test_ctx->kctx, &test_ctx->client,
+                     name, test_ctx->princ, &cc);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(name);
+    return cc;
+}
+
+static bool test_mem_loaded(struct kcm_secdb_test_ctx *test_ctx)
+{
+    hash_key_t key;
+
+    key.type = HASH_KEY_ULONG;
+    key.ul = cli_creds_get_uid((&test_ctx->client));
+
+    return hash_has_key(test_ctx->secdb->mem_uids, &key);
+}
+
+static void test_create(struct kcm_secdb_test_ctx *test_ctx,
+                        struct kcm_ccache *cc)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = ccdb_secdb_create_send(test_ctx, test_ctx->ev, test_ctx->db,
+                                 &test_ctx->client, cc);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_create_recv(req);
+    assert_int_equal(ret, EOK);
+    talloc_free(req);
+}
+
+static void test_delete(struct kcm_secdb_test_ctx *test_ctx,
+                        struct kcm_ccache *cc)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = ccdb_secdb_delete_send(test_ctx, test_ctx->ev, test_ctx->db,
+                                 &test_ctx->client, cc->uuid);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_delete_recv(req);
+    assert_int_equal(ret, EOK);
+    talloc_free(req);
+}
+
+static size_t test_list(struct kcm_secdb_test_ctx *test_ctx)
+{
+    struct tevent_req *req;
+    uuid_t *uuid_list;
+    size_t count;
+    errno_t ret;
+
+    req = ccdb_secdb_list_send(test_ctx, test_ctx->ev, test_ctx->db,
+                               &test_ctx->client);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_list_recv(req, test_ctx, &uuid_list);
+    assert_int_equal(ret, EOK);
+    talloc_free(req);
+
+    for (count = 0; !uuid_is_null(uuid_list[count]); count++);
+
+    talloc_free(uuid_list);
+    return count;
+}
+
+/* Returns true if the ccache was found */
+static bool test_get(struct kcm_secdb_test_ctx *test_ctx,
+                     struct kcm_ccache *cc)
+{
+    struct tevent_req *req;
+    struct kcm_ccache *found = NULL;
+    errno_t ret;
+
+    req = ccdb_secdb_getbyuuid_send(test_ctx, test_ctx->ev, test_ctx->db,
+                                    &test_ctx->client, cc->uuid);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_getbyuuid_recv(req, test_ctx, &found);
+    assert_int_equal(ret, EOK);
+    talloc_free(req);
+
+    if (found == NULL) {
+        return false;
+    }
+
+    assert_string_equal(kcm_cc_get_name(found), kcm_cc_get_name(cc));
+    talloc_free(found);
+    return true;
+}
+
+/* Writes the ccache to the database only, bypassing the in-memory copy */
+static void test_put_behind(struct kcm_secdb_test_ctx *test_ctx,
+                            struct kcm_ccache *cc)
+{
+    struct sss_sec_req *sreq;
+    struct sss_iobuf *payload;
+    const char *url;
+    errno_t ret;
+
+    ret = kcm_ccache_to_secdb_kv(test_ctx, cc, &test_ctx->client,
+                                 &url, &payload);
+    assert_int_equal(ret, EOK);
+
+    ret = secdb_cc_url_req(test_ctx, test_ctx->secdb->sctx, &test_ctx->client,
+                           url, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sec_put(test_ctx, sreq, payload);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(sreq);
+    talloc_free(payload);
+    talloc_free(discard_const(url));
+}
+
+/* Removes the ccache from the database only, bypassing the in-memory copy */
+static void test_delete_behind(struct kcm_secdb_test_ctx *test_ctx,
+                               struct kcm_ccache *cc)
+{
+    struct sss_sec_req *sreq;
+    const char *key;
+    errno_t ret;
+
+    key = sec_key_create(test_ctx, cc->name, cc->uuid);
+    assert_non_null(key);
+
+    ret = secdb_cc_key_req(test_ctx, test_ctx->secdb->sctx, &test_ctx->client,
+                           key, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_sec_delete(sreq);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(sreq);
+    talloc_free(discard_const(key));
+}
+
+/* Writes the ccache in the format that keeps the credentials in the ccache
+ * secret, as it was stored before credentials became separate records */
+static void test_put_old_format(struct kcm_secdb_test_ctx *test_ctx,
+                                struct kcm_ccache *cc)
+{
+    struct sss_sec_req *sreq;
+    struct sss_iobuf *payload;
+    const char *key;
+    errno_t ret;
+
+    ret = secdb_container_url_req(test_ctx, test_ctx->secdb->sctx,
+                                  &test_ctx->client, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_sec_create_container(sreq);
+    if (ret != EEXIST) {
+        assert_int_equal(ret, EOK);
+    }
+    talloc_free(sreq);
+
+    ret = kcm_ccache_to_sec_input_binary(test_ctx, cc, &payload);
+    assert_int_equal(ret, EOK);
+
+    key = sec_key_create(test_ctx, cc->name, cc->uuid);
+    assert_non_null(key);
+
+    ret = secdb_cc_key_req(test_ctx, test_ctx->secdb->sctx, &test_ctx->client,
+                           key, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sec_put(test_ctx, sreq, payload);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(sreq);
+    talloc_free(payload);
+    talloc_free(discard_const(key));
+}
+
+/* Rewrites the header of a ccache with separate credential records in the
+ * database only, bypassing the in-memory copy */
+static void test_put_header_behind(struct kcm_secdb_test_ctx *test_ctx,
+                                   struct kcm_ccache *cc,
+                                   time_t expiration)
+{
+    struct sss_sec_req *sreq;
+    struct sss_iobuf *payload;
+    const char *key;
+    errno_t ret;
+
+    ret = kcm_ccache_header_to_sec_input_binary(test_ctx, cc, expiration,
+                                                &payload);
+    assert_int_equal(ret, EOK);
+
+    key = sec_key_create(test_ctx, cc->name, cc->uuid);
+    assert_non_null(key);
+
+    ret = secdb_cc_key_req(test_ctx, test_ctx->secdb->sctx, &test_ctx->client,
+                           key, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sec_update(test_ctx, sreq, payload);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(sreq);
+    talloc_free(payload);
+    talloc_free(discard_const(key));
+}
+
+static struct sss_iobuf *test_cred_blob(TALLOC_CTX *mem_ctx,
+                                        const char *blob)
+{
+    struct sss_iobuf *cred_blob;
+
+    cred_blob = sss_iobuf_init_readonly(mem_ctx, (const uint8_t *) blob,
+                                        strlen(blob) + 1, true);
+    assert_non_null(cred_blob);
+
+    return cred_blob;
+}
+
+static void test_store_cred(struct kcm_secdb_test_ctx *test_ctx,
+                            struct kcm_ccache *cc,
+                            const char *blob)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = ccdb_secdb_store_cred_send(test_ctx, test_ctx->ev, test_ctx->db,
+                                     &test_ctx->client, cc->uuid,
+                                     test_cred_blob(test_ctx, blob));
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_store_cred_recv(req);
+    assert_int_equal(ret, EOK);
+    talloc_free(req);
+}
+
+/* Checks the credentials of the ccache, newest first */
+static void test_check_creds(struct kcm_secdb_test_ctx *test_ctx,
+                             struct kcm_ccache *cc,
+                             const char **blobs)
+{
+    struct tevent_req *req;
+    struct kcm_ccache *found = NULL;
+    struct kcm_cred *crd;
+    struct sss_iobuf *cred_blob;
+    size_t i;
+    errno_t ret;
+
+    req = ccdb_secdb_getbyuuid_send(test_ctx, test_ctx->ev, test_ctx->db,
+                                    &test_ctx->client, cc->uuid);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = ccdb_secdb_getbyuuid_recv(req, test_ctx, &found);
+    assert_int_equal(ret, EOK);
+    assert_non_null(found);
+    talloc_free(req);
+
+    for (crd = kcm_cc_get_cred(found), i = 0;
+         crd != NULL;
+         crd = kcm_cc_next_cred(crd), i++) {
+        assert_non_null(blobs[i]);
+
+        cred_blob = kcm_cred_get_creds(crd);
+        assert_non_null(cred_blob);
+        assert_int_equal(sss_iobuf_get_size(cred_blob), strlen(blobs[i]) + 1);
+        assert_string_equal((const char *) sss_iobuf_get_data(cred_blob),
+                            blobs[i]);
+    }
+    assert_null(blobs[i]);
+
+    talloc_free(found);
+}
+
+/* Returns the number of credential records of the UID in the database */
+static size_t test_count_cred_records(struct kcm_secdb_test_ctx *test_ctx)
+{
+    struct sss_sec_req *sreq;
+    const char *url;
+    char **keys;
+    size_t nkeys;
+    errno_t ret;
+
+    url = talloc_asprintf(test_ctx, KCM_SECDB_CREDS_BASE_FMT,
+                          cli_creds_get_uid((&test_ctx->client)));
+    assert_non_null(url);
+
+    ret = sss_sec_new_req(test_ctx, test_ctx->secdb->sctx, url, &sreq);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_sec_list(test_ctx, sreq, &keys, &nkeys);
+    if (ret == ENOENT) {
+        nkeys = 0;
+    } else {
+        assert_int_equal(ret, EOK);
+        talloc_free(keys);
+    }
+
+    talloc_free(sreq);
+    talloc_free(discard_const(url));
+    return nkeys;
+}
+
+/* Returns true if the container of the credential records of the ccache
+ * is in the database */
+static bool test_has_creds_container(struct kcm_secdb_test_ctx *test_ctx,
+                                     struct kcm_ccache *cc)
+{
+    struct sss_sec_req *sreq;
+    const char *url;
+    errno_t ret;
+
+    url = secdb_creds_url_create(test_ctx, &test_ctx->client, cc->uuid);
+    assert_non_null(url);
+
+    ret = sss_sec_new_req(test_ctx, test_ctx->secdb->sctx, url, &sreq);
+    assert_int_equal(ret, EOK);
+
+    /* Creating the container again only succeeds if it was removed */
+    ret = sss_sec_create_container(sreq);
+    if (ret == EOK) {
+        ret = sss_sec_delete(sreq);
+        assert_int_equal(ret, EOK);
+        ret = ENOENT;
+    }
+
+    talloc_free(sreq);
+    talloc_free(discard_const(url));
+
+    if (ret == ENOENT) {
+        return false;
+    }
+
+    assert_int_equal(ret, EEXIST);
+    return true;
+}
+
+static void test_kcm_secdb_mem_hit(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+
+    test_create(test_ctx, cc1);
+    test_create(test_ctx, cc2);
+    assert_false(test_mem_loaded(test_ctx));
+
+    /* The first access reads the ccaches of the UID into memory */
+    assert_true(test_get(test_ctx, cc1));
+    assert_true(test_mem_loaded(test_ctx));
+
+    /* Further lookups are served from memory, a change made directly in
+     * the database is not seen */
+    test_delete_behind(test_ctx, cc2);
+    assert_true(test_get(test_ctx, cc2));
+    assert_int_equal(test_list(test_ctx), 2);
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+}
+
+static void test_kcm_secdb_mem_create(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+
+    /* Nothing is cached for an UID without ccaches */
+    assert_int_equal(test_list(test_ctx), 0);
+    assert_false(test_get(test_ctx, cc1));
+    assert_true(test_mem_loaded(test_ctx));
+
+    /* Creating a ccache drops the in-memory copy of the UID */
+    test_create(test_ctx, cc1);
+    assert_false(test_mem_loaded(test_ctx));
+    assert_true(test_get(test_ctx, cc1));
+    assert_int_equal(test_list(test_ctx), 1);
+
+    test_create(test_ctx, cc2);
+    assert_false(test_mem_loaded(test_ctx));
+    assert_true(test_get(test_ctx, cc2));
+    assert_int_equal(test_list(test_ctx), 2);
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+}
+
+static void test_kcm_secdb_mem_delete(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+
+    test_create(test_ctx, cc1);
+    test_create(test_ctx, cc2);
+    assert_int_equal(test_list(test_ctx), 2);
+
+    /* The deleted ccache is removed from the in-memory copy as well */
+    test_delete(test_ctx, cc1);
+    assert_true(test_mem_loaded(test_ctx));
+    assert_false(test_get(test_ctx, cc1));
+    assert_true(test_get(test_ctx, cc2));
+    assert_int_equal(test_list(test_ctx), 1);
+
+    /* Deleting the last ccache removes the container */
+    test_delete(test_ctx, cc2);
+    assert_false(test_get(test_ctx, cc2));
+    assert_int_equal(test_list(test_ctx), 0);
+
+    /* ... and the memory copy still matches the database when a new
+     * ccache is created */
+    test_create(test_ctx, cc1);
+    assert_true(test_get(test_ctx, cc1));
+    assert_int_equal(test_list(test_ctx), 1);
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+}
+
+static void test_kcm_secdb_mem_reload(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+    struct kcm_ccache *cc3;
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+    cc3 = test_cc_new(test_ctx, 3);
+
+    test_create(test_ctx, cc1);
+    assert_int_equal(test_list(test_ctx), 1);
+
+    /* The database changes behind the in-memory copy, like when creating
+     * a ccache evicts expired ccaches of the UID to stay within quota */
+    test_put_behind(test_ctx, cc2);
+    assert_int_equal(test_list(test_ctx), 1);
+    assert_false(test_get(test_ctx, cc2));
+
+    /* Creating a ccache reloads all ccaches of the UID from the database
+     * on next use instead of adding only the new one */
+    test_create(test_ctx, cc3);
+    assert_int_equal(test_list(test_ctx), 3);
+    assert_true(test_get(test_ctx, cc1));
+    assert_true(test_get(test_ctx, cc2));
+    assert_true(test_get(test_ctx, cc3));
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+    talloc_free(cc3);
+}
+
+static void test_kcm_secdb_cred_order(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc;
+    const char *old_creds[] = { "CRED3", "CRED2", "CRED1", NULL };
+    const char *migrated_creds[] = { "CRED4", "CRED3", "CRED2", "CRED1",
+                                     NULL };
+    const char *all_creds[] = { "CRED5", "CRED4", "CRED3", "CRED2", "CRED1",
+                                NULL };
+    errno_t ret;
+
+    /* kcm_cc_store_cred_blob() adds the credentials to the front */
+    cc = test_cc_new(test_ctx, 1);
+    ret = kcm_cc_store_cred_blob(cc, test_cred_blob(cc, "CRED1"));
+    assert_int_equal(ret, EOK);
+    ret = kcm_cc_store_cred_blob(cc, test_cred_blob(cc, "CRED2"));
+    assert_int_equal(ret, EOK);
+    ret = kcm_cc_store_cred_blob(cc, test_cred_blob(cc, "CRED3"));
+    assert_int_equal(ret, EOK);
+
+    test_put_old_format(test_ctx, cc);
+    test_check_creds(test_ctx, cc, old_creds);
+    assert_int_equal(test_count_cred_records(test_ctx), 0);
+
+    /* Storing a credential converts the ccache to separate records */
+    test_store_cred(test_ctx, cc, "CRED4");
+    test_check_creds(test_ctx, cc, migrated_creds);
+    assert_int_equal(test_count_cred_records(test_ctx), 4);
+
+    /* The records are read back in database order, the order of the
+     * credentials must not depend on it */
+    secdb_mem_forget(test_ctx->secdb, &test_ctx->client);
+    test_check_creds(test_ctx, cc, migrated_creds);
+
+    /* ... the same with a credential stored to the converted ccache */
+    test_store_cred(test_ctx, cc, "CRED5");
+    test_check_creds(test_ctx, cc, all_creds);
+    assert_int_equal(test_count_cred_records(test_ctx), 5);
+
+    secdb_mem_forget(test_ctx->secdb, &test_ctx->client);
+    test_check_creds(test_ctx, cc, all_creds);
+
+    talloc_free(cc);
+}
+
+static void test_kcm_secdb_orphan_creds(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+    const char *cc2_creds[] = { "CRED3", NULL };
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+
+    test_create(test_ctx, cc1);
+    test_create(test_ctx, cc2);
+    test_store_cred(test_ctx, cc1, "CRED1");
+    test_store_cred(test_ctx, cc1, "CRED2");
+    test_store_cred(test_ctx, cc2, "CRED3");
+    assert_int_equal(test_count_cred_records(test_ctx), 3);
+    assert_true(test_has_creds_container(test_ctx, cc1));
+
+    /* The ccache header is removed without its credentials, like when
+     * the ccache is evicted to stay within the quota */
+    test_delete_behind(test_ctx, cc1);
+    assert_int_equal(test_count_cred_records(test_ctx), 3);
+
+    /* Loading the UID removes the records and the container of the
+     * removed ccache and keeps the others */
+    secdb_mem_forget(test_ctx->secdb, &test_ctx->client);
+    assert_int_equal(test_list(test_ctx), 1);
+    assert_int_equal(test_count_cred_records(test_ctx), 1);
+    assert_false(test_has_creds_container(test_ctx, cc1));
+    assert_true(test_has_creds_container(test_ctx, cc2));
+    test_check_creds(test_ctx, cc2, cc2_creds);
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+}
+
+static void test_kcm_secdb_quota(void **state)
+{
+    struct kcm_secdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                struct kcm_secdb_test_ctx);
+    struct kcm_ccache *cc1;
+    struct kcm_ccache *cc2;
+    struct kcm_ccache *cc3;
+
+    cc1 = test_cc_new(test_ctx, 1);
+    cc2 = test_cc_new(test_ctx, 2);
+    cc3 = test_cc_new(test_ctx, 3);
+
+    /* An expired ccache with more credential records than the UID may
+     * have secrets */
+    test_create(test_ctx, cc1);
+    test_store_cred(test_ctx, cc1, "CRED1");
+    test_store_cred(test_ctx, cc1, "CRED2");
+    test_store_cred(test_ctx, cc1, "CRED3");
+    test_put_header_behind(test_ctx, cc1, time(NULL) - 3600);
+    assert_int_equal(test_count_cred_records(test_ctx), 3);
+
+    /* The credential records do not count towards the quota */
+    test_create(test_ctx, cc2);
+    assert_int_equal(test_list(test_ctx), 2);
+    assert_true(test_get(test_ctx, cc1));
+
+    /* When the quota is reached, the expiration time from the header
+     * selects the ccache to remove, its credentials are not read */
+    test_create(test_ctx, cc3);
+    assert_int_equal(test_list(test_ctx), 2);
+    assert_false(test_get(test_ctx, cc1));
+    assert_true(test_get(test_ctx, cc2));
+    assert_true(test_get(test_ctx, cc3));
+
+    /* The credentials of the removed ccache were dropped on reload */
+    assert_int_equal(test_count_cred_records(test_ctx), 0);
+    assert_false(test_has_creds_container(test_ctx, cc1));
+
+    talloc_free(cc1);
+    talloc_free(cc2);
+    talloc_free(cc3);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_mem_hit,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_mem_create,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_mem_delete,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_mem_reload,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_cred_order,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_orphan_creds,
+                                        setup_kcm_secdb,
+                                        teardown_kcm_secdb),
+        cmocka_unit_test_setup_teardown(test_kcm_secdb_quota,
+                                        setup_kcm_secdb_quota,
+                                        teardown_kcm_secdb),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old DB to be sure */
+    tests_set_cwd();
+    unlink(TEST_DB_FULL_PATH);
+    rmdir(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -0,0 +1,538 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: Test the pool of krb5_child workers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <security/pam_modules.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/krb5/krb5_opts.h"
+
+#include "providers/krb5/krb5_child_handler.c"
+
+#define TEST_MAX_WORKERS 4
+
+/* The pids are never signalled by the tests, no timeout is reached */
+#define TEST_WORKER_PID 1001
+
+/* A worker without a process, the test plays the krb5_child side */
+struct test_worker {
+    struct krb5_child_worker *worker;
+
+    /* krb5_child's ends of the pipes */
+    int requests_fd;
+    int replies_fd;
+};
+
+struct krb5_pool_test_ctx {
+    struct tevent_context *ev;
+    struct krb5_ctx *krb5_ctx;
+    struct sss_domain_info *dom;
+    struct krb5child_req *kr;
+
+    struct test_worker workers[TEST_MAX_WORKERS];
+    size_t num_workers;
+};
+
+static int setup_krb5_child_pool(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_zero(NULL, struct krb5_pool_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    test_ctx->krb5_ctx = talloc_zero(test_ctx, struct krb5_ctx);
+    assert_non_null(test_ctx->krb5_ctx);
+
+    ret = dp_copy_defaults(test_ctx->krb5_ctx, default_krb5_opts, KRB5_OPTS,
+                           &test_ctx->krb5_ctx->opts);
+    assert_int_equal(ret, EOK);
+
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 2);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_MAX_REQUESTS, 3);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->krb5_ctx->io_table = sss_ptr_hash_create(test_ctx->krb5_ctx,
+                                                       NULL, NULL);
+    assert_non_null(test_ctx->krb5_ctx->io_table);
+
+    test_ctx->dom = talloc_zero(test_ctx, struct sss_domain_info);
+    assert_non_null(test_ctx->dom);
+    test_ctx->dom->name = discard_const("krb5.test");
+    test_ctx->dom->type = DOM_TYPE_POSIX;
+
+    test_ctx->kr = talloc_zero(test_ctx, struct krb5child_req);
+    assert_non_null(test_ctx->kr);
+    test_ctx->kr->krb5_ctx = test_ctx->krb5_ctx;
+    test_ctx->kr->dom = test_ctx->dom;
+    test_ctx->kr->upn = talloc_strdup(test_ctx->kr, "user@KRB5.TEST");
+    assert_non_null(test_ctx->kr->upn);
+    test_ctx->kr->kuserok_user = "user";
+
+    test_ctx->kr->pd = create_pam_data(test_ctx->kr);
+    assert_non_null(test_ctx->kr->pd);
+    test_ctx->kr->pd->cmd = SSS_PAM_ACCT_MGMT;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int teardown_krb5_child_pool(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct krb5_pool_test_ctx);
+    size_t i;
+
+    /* Workers are freed together with their io structures, before the
+     * io table they are registered in */
+    for (i = 0; i < test_ctx->num_workers; i++) {
+        talloc_free(test_ctx->workers[i].worker->io);
+        close(test_ctx->workers[i].requests_fd);
+        close(test_ctx->workers[i].replies_fd);
+    }
+
+    talloc_free(test_ctx);
+    return 0;
+}
+
+/* Adds an idle worker to the pool the way krb5_child_worker_get() does
+ * after starting the process */
+static struct test_worker *test_worker_add(struct krb5_pool_test_ctx *test_ctx,
+                                           pid_t pid)
+{
+    struct test_worker *tw;
+    struct child_io_fds *io;
+    int to_child[2];
+    int from_child[2];
+    char *io_key;
+    errno_t ret;
+
+    assert_true(test_ctx->num_workers < TEST_MAX_WORKERS);
+    tw = &test_ctx->workers[test_ctx->num_workers++];
+
+    ret = pipe(to_child);
+    assert_int_equal(ret, 0);
+    ret = pipe(from_child);
+    assert_int_equal(ret, 0);
+
+    io = talloc_zero(test_ctx, struct child_io_fds);
+    assert_non_null(io);
+    io->pid = pid;
+    io->write_to_child_fd = to_child[1];
+    io->read_from_child_fd = from_child[0];
+    talloc_set_destructor((void *) io, child_io_destructor);
+
+    io_key = talloc_asprintf(io, "%d", pid);
+    assert_non_null(io_key);
+    ret = sss_ptr_hash_add(test_ctx->krb5_ctx->io_table, io_key, io,
+                           struct child_io_fds);
+    assert_int_equal(ret, EOK);
+    talloc_free(io_key);
+
+    tw->requests_fd = to_child[0];
+    tw->replies_fd = from_child[1];
+
+    tw->worker = talloc_zero(io, struct krb5_child_worker);
+    assert_non_null(tw->worker);
+    tw->worker->krb5_ctx = test_ctx->krb5_ctx;
+    tw->worker->io = io;
+    talloc_set_destructor(tw->worker, krb5_child_worker_destructor);
+    DLIST_ADD(test_ctx->krb5_ctx->child_workers, tw->worker);
+
+    return tw;
+}
+
+static size_t test_reply(uint8_t *buf, bool keep_alive, pid_t pid)
+{
+    const char *domain = "krb5.test";
+    size_t p = 0;
+
+    SAFEALIGN_SET_INT32(&buf[p], PAM_SUCCESS, &p);
+
+    SAFEALIGN_SET_INT32(&buf[p], SSS_PAM_DOMAIN_NAME, &p);
+    SAFEALIGN_SET_INT32(&buf[p], strlen(domain) + 1, &p);
+    safealign_memcpy(&buf[p], domain, strlen(domain) + 1, &p);
+
+    if (keep_alive) {
+        SAFEALIGN_SET_INT32(&buf[p], SSS_CHILD_KEEP_ALIVE, &p);
+        SAFEALIGN_SET_INT32(&buf[p], sizeof(pid_t), &p);
+        safealign_memcpy(&buf[p], &pid, sizeof(pid_t), &p);
+    }
+
+    return p;
+}
+
+/* Queue the reply of the worker to the next request */
+static void test_worker_reply(struct test_worker *tw, bool keep_alive)
+{
+    uint8_t buf[128];
+    size_t len;
+    ssize_t ret;
+
+    len = test_reply(buf, keep_alive, tw->worker->io->pid);
+
+    ret = sss_atomic_write_safe_s(tw->replies_fd, buf, len);
+    assert_int_equal(ret, len);
+}
+
+/* Check that the worker received a request, a new one starts with
+ * @chain_id while further rounds go to the request process as they are */
+static void test_worker_check_request(struct test_worker *tw,
+                                      bool new_request,
+                                      uint64_t chain_id)
+{
+    uint8_t buf[IN_BUF_SIZE];
+    uint64_t received_id;
+    uint32_t cmd;
+    size_t len;
+    size_t p = 0;
+    ssize_t ret;
+
+    ret = sss_atomic_read_safe_s(tw->requests_fd, buf, sizeof(buf), &len);
+    assert_true(ret > 0);
+    assert_int_equal(ret, len);
+
+    if (new_request) {
+        assert_true(len > sizeof(uint64_t));
+        safealign_memcpy(&received_id, buf, sizeof(uint64_t), &p);
+        assert_int_equal(received_id, chain_id);
+    }
+
+    SAFEALIGN_COPY_UINT32(&cmd, &buf[p], NULL);
+    assert_int_equal(cmd, SSS_PAM_ACCT_MGMT);
+}
+
+static bool test_worker_in_pool(struct krb5_pool_test_ctx *test_ctx,
+                                struct test_worker *tw)
+{
+    struct krb5_child_worker *worker;
+
+    DLIST_FOR_EACH(worker, test_ctx->krb5_ctx->child_workers) {
+        if (worker == tw->worker) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* A retired worker is told to exit by closing its input */
+static void test_worker_check_retired(struct krb5_pool_test_ctx *test_ctx,
+                                      struct test_worker *tw)
+{
+    uint8_t buf[1];
+
+    assert_false(test_worker_in_pool(test_ctx, tw));
+    assert_null(tw->worker->krb5_ctx);
+    assert_int_equal(tw->worker->io->write_to_child_fd, -1);
+    assert_int_equal(read(tw->requests_fd, buf, sizeof(buf)), 0);
+}
+
+static void test_krb5_child_pool_usable(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct krb5_pool_test_ctx);
+    struct sss_domain_info *parent;
+    errno_t ret;
+
+    assert_true(krb5_child_worker_usable(test_ctx->kr));
+
+    /* The pool is disabled */
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 0);
+    assert_int_equal(ret, EOK);
+    assert_false(krb5_child_worker_usable(test_ctx->kr));
+
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 2);
+    assert_int_equal(ret, EOK);
+
+    /* Users of a subdomain only need a separate krb5_child if the realm of
+     * the subdomain is used */
+    parent = talloc_zero(test_ctx, struct sss_domain_info);
+    assert_non_null(parent);
+    test_ctx->dom->parent = parent;
+    assert_true(krb5_child_worker_usable(test_ctx->kr));
+
+    ret = dp_opt_set_bool(test_ctx->krb5_ctx->opts,
+                          KRB5_USE_SUBDOMAIN_REALM, true);
+    assert_int_equal(ret, EOK);
+    assert_false(krb5_child_worker_usable(test_ctx->kr));
+
+    test_ctx->dom->parent = NULL;
+    talloc_free(parent);
+}
+
+static void test_krb5_child_pool_reserve(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct krb5_pool_test_ctx);
+    struct krb5_child_worker *first;
+    struct krb5_child_worker *second;
+    struct krb5_child_worker *worker;
+    uint8_t buf[128];
+    size_t len;
+    errno_t ret;
+
+    test_worker_add(test_ctx, TEST_WORKER_PID);
+    test_worker_add(test_ctx, TEST_WORKER_PID + 1);
+    len = test_reply(buf, false, 0);
+
+    /* Each request reserves a different idle worker */
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &first);
+    assert_int_equal(ret, EOK);
+    assert_true(first->busy);
+    assert_int_equal(first->requests, 1);
+
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &second);
+    assert_int_equal(ret, EOK);
+    assert_true(second->busy);
+    assert_int_equal(second->requests, 1);
+    assert_ptr_not_equal(first, second);
+
+    /* A full pool of busy workers makes the caller fork a krb5_child */
+    worker = NULL;
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EAGAIN);
+    assert_null(worker);
+
+    /* A finished request returns the worker to the pool */
+    krb5_child_worker_release(test_ctx->ev, first, EOK, buf, len);
+    assert_false(first->busy);
+    assert_non_null(first->krb5_ctx);
+
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(worker, first);
+    assert_int_equal(worker->requests, 2);
+
+    /* A worker which exited is not reserved anymore */
+    krb5_child_worker_release(test_ctx->ev, first, EOK, buf, len);
+    krb5_child_worker_release(test_ctx->ev, second, EOK, buf, len);
+    first->io->child_exited = true;
+
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(worker, second);
+
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EAGAIN);
+}
+
+static void test_krb5_child_pool_replace(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct krb5_pool_test_ctx);
+    struct test_worker *tw1;
+    struct test_worker *tw2;
+    struct test_worker *tw3;
+    struct krb5_child_worker *worker;
+    uint8_t buf[128];
+    size_t len;
+    int i;
+    errno_t ret;
+
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 1);
+    assert_int_equal(ret, EOK);
+    len = test_reply(buf, false, 0);
+
+    /* A worker is replaced after krb5_child_max_requests requests */
+    tw1 = test_worker_add(test_ctx, TEST_WORKER_PID);
+    for (i = 1; i <= 3; i++) {
+        ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+        assert_int_equal(ret, EOK);
+        assert_ptr_equal(worker, tw1->worker);
+        assert_int_equal(worker->requests, i);
+
+        krb5_child_worker_release(test_ctx->ev, worker, EOK, buf, len);
+        if (i < 3) {
+            assert_true(test_worker_in_pool(test_ctx, tw1));
+        }
+    }
+    test_worker_check_retired(test_ctx, tw1);
+
+    /* ... after a failed request */
+    tw2 = test_worker_add(test_ctx, TEST_WORKER_PID + 1);
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(worker, tw2->worker);
+
+    krb5_child_worker_release(test_ctx->ev, worker, EIO, NULL, 0);
+    test_worker_check_retired(test_ctx, tw2);
+
+    /* ... and when the request process exited without a reply */
+    tw3 = test_worker_add(test_ctx, TEST_WORKER_PID + 2);
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(worker, tw3->worker);
+
+    krb5_child_worker_release(test_ctx->ev, worker, EOK, NULL, 0);
+    test_worker_check_retired(test_ctx, tw3);
+
+    /* Releasing a retired worker again does nothing */
+    krb5_child_worker_release(test_ctx->ev, worker, EOK, buf, len);
+    assert_null(worker->krb5_ctx);
+    assert_null(test_ctx->krb5_ctx->child_workers);
+}
+
+static void test_krb5_child_pool_response(void **state)
+{
+    uint8_t buf[128];
+    size_t len;
+
+    /* The keep alive message is found among the other messages */
+    len = test_reply(buf, true, TEST_WORKER_PID);
+    assert_true(krb5_child_response_keep_alive(buf, len));
+
+    len = test_reply(buf, false, 0);
+    assert_false(krb5_child_response_keep_alive(buf, len));
+
+    /* Truncated or malformed replies are not kept alive */
+    len = test_reply(buf, true, TEST_WORKER_PID);
+    assert_false(krb5_child_response_keep_alive(buf, 2 * sizeof(int32_t)));
+    assert_false(krb5_child_response_keep_alive(buf, 0));
+
+    SAFEALIGN_SET_INT32(&buf[2 * sizeof(int32_t)], 1000, NULL);
+    assert_false(krb5_child_response_keep_alive(buf, len));
+}
+
+static void test_krb5_child_pool_keep_alive(void **state)
+{
+    struct krb5_pool_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct krb5_pool_test_ctx);
+    struct test_worker *tw;
+    struct krb5_child_worker *worker;
+    struct tevent_req *req;
+    uint8_t *buf;
+    ssize_t len;
+    errno_t ret;
+
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, 1);
+    assert_int_equal(ret, EOK);
+    tw = test_worker_add(test_ctx, TEST_WORKER_PID);
+
+    /* The first round of the request is sent to the pooled worker together
+     * with the chain id of the request, the worker asks to be kept alive
+     * for another round */
+    sss_chain_id_set(42);
+    test_worker_reply(tw, true);
+    req = handle_child_send(test_ctx, test_ctx->ev, test_ctx->kr);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = handle_child_recv(req, test_ctx, &buf, &len);
+    assert_int_equal(ret, EOK);
+    assert_true(krb5_child_response_keep_alive(buf, len));
+    talloc_free(buf);
+    talloc_free(req);
+    test_worker_check_request(tw, true, 42);
+
+    /* The worker stays reserved for the request */
+    assert_true(tw->worker->busy);
+    assert_non_null(tw->worker->keep_alive);
+
+    worker = NULL;
+    ret = krb5_child_worker_get(test_ctx->ev, test_ctx->kr, &worker);
+    assert_int_equal(ret, EAGAIN);
+    assert_null(worker);
+
+    /* The next round is sent to the worker by the pid it reported */
+    test_ctx->kr->pd->child_pid = TEST_WORKER_PID;
+    test_worker_reply(tw, false);
+    req = handle_child_send(test_ctx, test_ctx->ev, test_ctx->kr);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = handle_child_recv(req, test_ctx, &buf, &len);
+    assert_int_equal(ret, EOK);
+    assert_false(krb5_child_response_keep_alive(buf, len));
+    talloc_free(buf);
+    talloc_free(req);
+    test_worker_check_request(tw, false, 0);
+
+    /* The request is finished, the worker is idle again. The second round
+     * does not count as a new request. */
+    assert_true(test_worker_in_pool(test_ctx, tw));
+    assert_false(tw->worker->busy);
+    assert_null(tw->worker->keep_alive);
+    assert_int_equal(tw->worker->requests, 1);
+
+    /* A continuation of an unknown process fails */
+    test_ctx->kr->pd->child_pid = TEST_WORKER_PID + 1;
+    req = handle_child_send(test_ctx, test_ctx->ev, test_ctx->kr);
+    assert_non_null(req);
+    assert_true(tevent_req_poll(req, test_ctx->ev));
+
+    ret = handle_child_recv(req, test_ctx, &buf, &len);
+    assert_int_equal(ret, ENOENT);
+    talloc_free(req);
+    test_ctx->kr->pd->child_pid = 0;
+    sss_chain_id_set(0);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_krb5_child_pool_usable,
+                                        setup_krb5_child_pool,
+                                        teardown_krb5_child_pool),
+        cmocka_unit_test_setup_teardown(test_krb5_child_pool_reserve,
+                                        setup_krb5_child_pool,
+                                        teardown_krb5_child_pool),
+        cmocka_unit_test_setup_teardown(test_krb5_child_pool_replace,
+                                        setup_krb5_child_pool,
+                                        teardown_krb5_child_pool),
+        cmocka_unit_test(test_krb5_child_pool_response),
+        cmocka_unit_test_setup_teardown(test_krb5_child_pool_keep_alive,
+                                        setup_krb5_child_pool,
+                                        teardown_krb5_child_pool),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -85,13 +85,13 @@ void test_set_extra_args(void **state)
     struct krb5_ctx *krb5_ctx;
     const char **krb5_child_extra_args;
 
-    ret = set_extra_args(NULL, NULL, NULL, NULL);
+    ret = set_extra_args(NULL, NULL, NULL, false, NULL);
     assert_int_equal(ret, EINVAL);
 
     krb5_ctx = talloc_zero(global_talloc_context, struct krb5_ctx);
     assert_non_null(krb5_ctx);
 
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--chain-id=0");
@@ -99,7 +99,7 @@ void test_set_extra_args(void **state)
     talloc_free(krb5_child_extra_args);
 
     krb5_ctx->canonicalize = true;
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--canonicalize");
@@ -108,7 +108,7 @@ void test_set_extra_args(void **state)
     talloc_free(krb5_child_extra_args);
 
     krb5_ctx->realm = discard_const(TEST_REALM);
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--realm=" TEST_REALM);
@@ -119,7 +119,7 @@ void test_set_extra_args(void **state)
 
     /* --fast-principal will be only set if FAST is used */
     krb5_ctx->fast_principal = discard_const(TEST_FAST_PRINC);
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--realm=" TEST_REALM);
@@ -129,7 +129,7 @@ void test_set_extra_args(void **state)
     talloc_free(krb5_child_extra_args);
 
     krb5_ctx->use_fast_str = discard_const(TEST_FAST_STR);
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--realm=" TEST_REALM);
@@ -143,7 +143,7 @@ void test_set_extra_args(void **state)
 
     krb5_ctx->lifetime_str = discard_const(TEST_LIFE_STR);
     krb5_ctx->rlife_str = discard_const(TEST_RLIFE_STR);
-    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL,
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, false,
                          &krb5_child_extra_args);
     assert_int_equal(ret, EOK);
     assert_string_equal(krb5_child_extra_args[0], "--realm=" TEST_REALM);
@@ -158,6 +158,15 @@ void test_set_extra_args(void **state)
     assert_null(krb5_child_extra_args[7]);
     talloc_free(krb5_child_extra_args);
 
+    /* Workers get the chain id with each request */
+    ret = set_extra_args(global_talloc_context, krb5_ctx, NULL, true,
+                         &krb5_child_extra_args);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(krb5_child_extra_args[5], "--canonicalize");
+    assert_string_equal(krb5_child_extra_args[6], "--worker");
+    assert_null(krb5_child_extra_args[7]);
+    talloc_free(krb5_child_extra_args);
+
     talloc_free(krb5_ctx);
 }
 
@@ -0,0 +1,419 @@
+/*
+    SSSD
+
+    Unit tests - LDAP change notification
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+
+/* Including private source file to test static functions */
+#include "providers/ldap/ldap_id_notify.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "tests_conf.ldb"
+#define TEST_DOM_NAME "ldap_id_notify_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_USER_NAME "notify_user"
+#define TEST_USER_FQNAME TEST_USER_NAME "@" TEST_DOM_NAME
+#define TEST_USER_DN "uid=notify_user,ou=users,dc=example,dc=com"
+#define TEST_GROUP_NAME "notify_group"
+#define TEST_GROUP_FQNAME TEST_GROUP_NAME "@" TEST_DOM_NAME
+#define TEST_GROUP_DN "cn=notify_group,ou=groups,dc=example,dc=com"
+#define TEST_UNKNOWN_DN "uid=unknown,ou=users,dc=example,dc=com"
+
+struct tevent_req *
+sdap_handle_acct_req_send(TALLOC_CTX *mem_ctx,
+                          struct be_ctx *be_ctx,
+                          struct dp_id_data *ar,
+                          struct sdap_id_ctx *id_ctx,
+                          struct sdap_domain *sdom,
+                          struct sdap_id_conn_ctx *conn,
+                          bool noexist_delete)
+{
+    struct tevent_req *req;
+    struct tevent_context *ev;
+    int *state;
+    errno_t ret;
+
+    check_expected(ar->entry_type);
+    check_expected(ar->filter_value);
+
+    req = tevent_req_create(mem_ctx, &state, int);
+    assert_non_null(req);
+
+    ev = sss_mock_ptr_type(struct tevent_context *);
+    ret = sss_mock_type(errno_t);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    return tevent_req_post(req, ev);
+}
+
+errno_t sdap_handle_acct_req_recv(struct tevent_req *req,
+                                  int *_dp_error, const char **_err,
+                                  int *sdap_ret)
+{
+    *_dp_error = DP_ERR_OK;
+    *_err = NULL;
+    *sdap_ret = EOK;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+struct ldap_id_notify_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+    struct sdap_change_notify_ctx *nctx;
+};
+
+static int ldap_id_notify_test_setup(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+    struct sysdb_attrs *attrs;
+    char *fqname;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct ldap_id_notify_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    fqname = sss_create_internal_fqname(test_ctx, TEST_USER_NAME,
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    ret = sysdb_store_user(test_ctx->tctx->dom, fqname, NULL, 1001, 1001,
+                           NULL, "/home/" TEST_USER_NAME, "/bin/sh",
+                           TEST_USER_DN, NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(fqname);
+
+    fqname = sss_create_internal_fqname(test_ctx, TEST_GROUP_NAME,
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_ORIG_DN, TEST_GROUP_DN);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_store_group(test_ctx->tctx->dom, fqname, 2001, attrs, 300, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+    talloc_free(fqname);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+
+    test_ctx->sdom = talloc_zero(test_ctx, struct sdap_domain);
+    assert_non_null(test_ctx->sdom);
+    test_ctx->sdom->dom = test_ctx->tctx->dom;
+
+    test_ctx->nctx = talloc_zero(test_ctx, struct sdap_change_notify_ctx);
+    assert_non_null(test_ctx->nctx);
+    test_ctx->nctx->id_ctx = test_ctx->id_ctx;
+    test_ctx->nctx->sdom = test_ctx->sdom;
+    test_ctx->nctx->queued = sss_ptr_hash_create(test_ctx->nctx, NULL, NULL);
+    assert_non_null(test_ctx->nctx->queued);
+
+    test_ctx->id_ctx->notify = test_ctx->nctx;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int ldap_id_notify_test_teardown(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    talloc_zfree(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void notify_dn(struct ldap_id_notify_test_ctx *test_ctx,
+                      const char *dn)
+{
+    struct sysdb_attrs *entry;
+    errno_t ret;
+
+    entry = sysdb_new_attrs(test_ctx);
+    assert_non_null(entry);
+
+    ret = sysdb_attrs_add_string(entry, SYSDB_ORIG_DN, dn);
+    assert_int_equal(ret, EOK);
+
+    ldap_change_notify_entry(entry, test_ctx->nctx);
+    talloc_free(entry);
+}
+
+static void expect_refresh_ret(struct ldap_id_notify_test_ctx *test_ctx,
+                               int entry_type, const char *fqname,
+                               errno_t ret)
+{
+    expect_value(sdap_handle_acct_req_send, ar->entry_type, entry_type);
+    expect_string(sdap_handle_acct_req_send, ar->filter_value, fqname);
+    will_return(sdap_handle_acct_req_send, test_ctx->tctx->ev);
+    will_return(sdap_handle_acct_req_send, ret);
+}
+
+static void expect_refresh(struct ldap_id_notify_test_ctx *test_ctx,
+                           int entry_type, const char *fqname)
+{
+    expect_refresh_ret(test_ctx, entry_type, fqname, EOK);
+}
+
+static void wait_for_refresh(struct ldap_id_notify_test_ctx *test_ctx)
+{
+    while (test_ctx->nctx->account_req != NULL) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+}
+
+static void test_notify_user(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    expect_refresh(test_ctx, BE_REQ_USER, TEST_USER_FQNAME);
+    notify_dn(test_ctx, TEST_USER_DN);
+    assert_non_null(test_ctx->nctx->account_req);
+
+    wait_for_refresh(test_ctx);
+    assert_null(test_ctx->nctx->queue);
+    assert_int_equal(test_ctx->nctx->queue_len, 0);
+    assert_int_equal(hash_count(test_ctx->nctx->queued), 0);
+}
+
+static void test_notify_group(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    expect_refresh(test_ctx, BE_REQ_GROUP, TEST_GROUP_FQNAME);
+    notify_dn(test_ctx, TEST_GROUP_DN);
+
+    wait_for_refresh(test_ctx);
+    assert_int_equal(test_ctx->nctx->queue_len, 0);
+}
+
+static void test_notify_duplicate(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    /* The user is being refreshed while the group changes twice, the group
+     * is refreshed only once. */
+    expect_refresh(test_ctx, BE_REQ_USER, TEST_USER_FQNAME);
+    notify_dn(test_ctx, TEST_USER_DN);
+    notify_dn(test_ctx, TEST_GROUP_DN);
+    notify_dn(test_ctx, TEST_GROUP_DN);
+    assert_int_equal(test_ctx->nctx->queue_len, 1);
+
+    expect_refresh(test_ctx, BE_REQ_GROUP, TEST_GROUP_FQNAME);
+    wait_for_refresh(test_ctx);
+    assert_int_equal(test_ctx->nctx->queue_len, 0);
+    assert_int_equal(hash_count(test_ctx->nctx->queued), 0);
+}
+
+static void test_notify_not_cached(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    /* No refresh is expected */
+    notify_dn(test_ctx, TEST_UNKNOWN_DN);
+    assert_null(test_ctx->nctx->account_req);
+    assert_int_equal(test_ctx->nctx->queue_len, 0);
+    assert_int_equal(hash_count(test_ctx->nctx->queued), 0);
+}
+
+static void test_notify_overflow(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+    time_t now;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    test_ctx->nctx->active_since = 1;
+    assert_int_equal(sdap_change_notify_active_since(test_ctx->id_ctx), 1);
+
+    /* Pretend the queue is full, the change is dropped and the entries
+     * stored so far are no longer known to be current. */
+    test_ctx->nctx->queue_len = LDAP_CHANGE_NOTIFY_MAX_QUEUE;
+    test_ctx->nctx->account_req = talloc_zero(test_ctx->nctx,
+                                              struct dp_id_data);
+    assert_non_null(test_ctx->nctx->account_req);
+
+    now = time(NULL);
+    notify_dn(test_ctx, TEST_USER_DN);
+    assert_false(sss_ptr_hash_has_key(test_ctx->nctx->queued, TEST_USER_DN));
+    assert_true(sdap_change_notify_active_since(test_ctx->id_ctx) >= now);
+
+    /* Without an active subscription nothing is known anyway */
+    test_ctx->nctx->active_since = 0;
+    notify_dn(test_ctx, TEST_USER_DN);
+    assert_int_equal(sdap_change_notify_active_since(test_ctx->id_ctx), 0);
+
+    test_ctx->nctx->queue_len = 0;
+    talloc_zfree(test_ctx->nctx->account_req);
+}
+
+static void test_notify_activation(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+    time_t now;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    /* Without a subscription a change does not activate anything */
+    expect_refresh(test_ctx, BE_REQ_USER, TEST_USER_FQNAME);
+    notify_dn(test_ctx, TEST_USER_DN);
+    wait_for_refresh(test_ctx);
+    assert_int_equal(sdap_change_notify_active_since(test_ctx->id_ctx), 0);
+
+    /* Sending the search is not enough, the server may not have processed
+     * it yet */
+    test_ctx->nctx->subscribed = true;
+    assert_int_equal(sdap_change_notify_active_since(test_ctx->id_ctx), 0);
+
+    /* The first change notification proves it did */
+    now = time(NULL);
+    expect_refresh(test_ctx, BE_REQ_GROUP, TEST_GROUP_FQNAME);
+    notify_dn(test_ctx, TEST_GROUP_DN);
+    assert_true(sdap_change_notify_active_since(test_ctx->id_ctx) >= now);
+    wait_for_refresh(test_ctx);
+}
+
+static void test_notify_refresh_failure(void **state)
+{
+    struct ldap_id_notify_test_ctx *test_ctx;
+    time_t now;
+
+    test_ctx = talloc_get_type_abort(*state, struct ldap_id_notify_test_ctx);
+
+    test_ctx->nctx->subscribed = true;
+    test_ctx->nctx->active_since = 1;
+
+    /* A successful refresh keeps the subscription time */
+    expect_refresh(test_ctx, BE_REQ_GROUP, TEST_GROUP_FQNAME);
+    notify_dn(test_ctx, TEST_GROUP_DN);
+    wait_for_refresh(test_ctx);
+    assert_int_equal(sdap_change_notify_active_since(test_ctx->id_ctx), 1);
+
+    /* The user could not be refreshed, so it and every other entry stored
+     * so far must be searched by the background refresh again */
+    now = time(NULL);
+    expect_refresh_ret(test_ctx, BE_REQ_USER, TEST_USER_FQNAME, EIO);
+    notify_dn(test_ctx, TEST_USER_DN);
+    wait_for_refresh(test_ctx);
+    assert_true(sdap_change_notify_active_since(test_ctx->id_ctx) >= now);
+    assert_int_equal(test_ctx->nctx->queue_len, 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_notify_user,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_group,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_duplicate,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_not_cached,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_overflow,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_activation,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+        cmocka_unit_test_setup_teardown(test_notify_refresh_failure,
+                                        ldap_id_notify_test_setup,
+                                        ldap_id_notify_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old DB to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && no_cleanup == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
@@ -0,0 +1,456 @@
+/*
+    SSSD
+
+    Negative cache table - unit tests and comparison with the TDB store
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <popt.h>
+#include <tdb.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/common/negcache_table.h"
+
+#define NC_TEST_NOW 1000000
+#define NC_TEST_DOM "test.dom"
+
+/* test_nc_table_vs_tdb runs only if SSS_TEST_BENCHMARK is set, the sizes can
+ * be raised from the command line, e.g. --entries=1000000 */
+static int bench_entries = 10000;
+static int bench_lookups = 200000;
+
+struct nc_table_test_ctx {
+    struct sss_nc_table *table;
+};
+
+static int test_nc_table_setup(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct nc_table_test_ctx);
+    assert_non_null(test_ctx);
+
+    check_leaks_push(test_ctx);
+
+    ret = sss_nc_table_init(test_ctx, NC_TEST_NOW, &test_ctx->table);
+    assert_int_equal(ret, EOK);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_nc_table_teardown(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct nc_table_test_ctx);
+
+    talloc_free(test_ctx->table);
+    assert_true(check_leaks_pop(test_ctx));
+
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void nc_test_name(char *buf, size_t size, int idx)
+{
+    snprintf(buf, size, "user%d", idx);
+}
+
+static void test_nc_table_keys(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+    struct sss_nc_table *table;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct nc_table_test_ctx);
+    table = test_ctx->table;
+
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_set(table, SSS_NC_UID, NULL, "4242",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+    ret = sss_nc_table_check(table, SSS_NC_UID, NULL, "4242", NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+
+    /* type, domain and name are all part of the key */
+    ret = sss_nc_table_check(table, SSS_NC_GROUP, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_USER, "other.dom", "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost2",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_UID, NC_TEST_DOM, "4242",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    /* the separator must not allow two keys to collide */
+    ret = sss_nc_table_check(table, SSS_NC_USER, "test", "dom/ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+
+    assert_int_equal(sss_nc_table_count(table), 2);
+}
+
+static void test_nc_table_expire(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+    struct sss_nc_table *table;
+    char name[64];
+    errno_t ret;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct nc_table_test_ctx);
+    table = test_ctx->table;
+
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+
+    /* valid until the end of the expiration second */
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW + 10);
+    assert_int_equal(ret, EEXIST);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW + 11);
+    assert_int_equal(ret, ENOENT);
+    assert_int_equal(sss_nc_table_count(table), 0);
+
+    /* refreshing an entry moves its expiration */
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 20, NC_TEST_NOW + 11);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 1000000, NC_TEST_NOW + 12);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW + 50000);
+    assert_int_equal(ret, EEXIST);
+
+    /* expiration times spread over several wheel levels, the entries are
+     * released without being looked up again */
+    for (i = 0; i < 1000; i++) {
+        nc_test_name(name, sizeof(name), i);
+        ret = sss_nc_table_set(table, SSS_NC_GROUP, NC_TEST_DOM, name,
+                               NC_TEST_NOW + 50000 + i * 97,
+                               NC_TEST_NOW + 50000);
+        assert_int_equal(ret, EOK);
+    }
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "permanent",
+                           0, NC_TEST_NOW + 50000);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(sss_nc_table_count(table), 1002);
+
+    for (i = 0; i < 1000; i += 100) {
+        ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "nobody",
+                                 NC_TEST_NOW + 50000 + i * 97 + 1);
+        assert_int_equal(ret, ENOENT);
+        assert_int_equal(sss_nc_table_count(table), 1002 - i - 1);
+    }
+
+    /* a large time jump expires everything but permanent entries */
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "permanent",
+                             NC_TEST_NOW + 100000000);
+    assert_int_equal(ret, EEXIST);
+    assert_int_equal(sss_nc_table_count(table), 1);
+}
+
+static void test_nc_table_reset(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+    struct sss_nc_table *table;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct nc_table_test_ctx);
+    table = test_ctx->table;
+
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_set(table, SSS_NC_UID, NC_TEST_DOM, "4242",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "filtered",
+                           0, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_set(table, SSS_NC_GROUP, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+
+    /* resetting users keeps groups and permanent entries */
+    sss_nc_table_reset_class(table, SSS_NC_CLASS_USERS);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_UID, NC_TEST_DOM, "4242",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "filtered",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+    ret = sss_nc_table_check(table, SSS_NC_GROUP, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+
+    /* entries set after the reset are valid again */
+    ret = sss_nc_table_set(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                           NC_TEST_NOW + 10, NC_TEST_NOW);
+    assert_int_equal(ret, EOK);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+
+    sss_nc_table_reset_class(table, SSS_NC_CLASS_GROUPS);
+    ret = sss_nc_table_check(table, SSS_NC_GROUP, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+
+    sss_nc_table_reset_permanent(table);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "filtered",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nc_table_check(table, SSS_NC_USER, NC_TEST_DOM, "ghost",
+                             NC_TEST_NOW);
+    assert_int_equal(ret, EEXIST);
+}
+
+/* The negative cache as it was implemented before the table, kept here so
+ * both can be compared under the same load. */
+static int nc_tdb_set(struct tdb_context *tdb, const char *name,
+                      time_t expire)
+{
+    TDB_DATA key;
+    TDB_DATA data;
+    char *str;
+    char *timest;
+    int ret;
+
+    str = talloc_asprintf(NULL, "NCE/USER/%s/%s", NC_TEST_DOM, name);
+    timest = talloc_asprintf(NULL, "%llu", (unsigned long long int)expire);
+    assert_non_null(str);
+    assert_non_null(timest);
+
+    key.dptr = (uint8_t *)str;
+    key.dsize = strlen(str) + 1;
+    data.dptr = (uint8_t *)timest;
+    data.dsize = strlen(timest) + 1;
+    ret = tdb_store(tdb, key, data, TDB_REPLACE);
+
+    talloc_free(timest);
+    talloc_free(str);
+    return ret == 0 ? EOK : EFAULT;
+}
+
+static int nc_tdb_check(struct tdb_context *tdb, const char *name,
+                        time_t now)
+{
+    TDB_DATA key;
+    TDB_DATA data;
+    unsigned long long int timestamp;
+    char *str;
+    int ret;
+
+    str = talloc_asprintf(NULL, "NCE/USER/%s/%s", NC_TEST_DOM, name);
+    assert_non_null(str);
+
+    key.dptr = (uint8_t *)str;
+    key.dsize = strlen(str) + 1;
+    data = tdb_fetch(tdb, key);
+    if (data.dptr == NULL) {
+        ret = ENOENT;
+    } else {
+        timestamp = strtoull((const char *)data.dptr, NULL, 10);
+        ret = (timestamp == 0 || timestamp >= now) ? EEXIST : ENOENT;
+    }
+
+    free(data.dptr);
+    talloc_free(str);
+    return ret;
+}
+
+static double nc_bench_elapsed(struct timespec *start, int ops)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start->tv_sec) * 1e9
+            + (end.tv_nsec - start->tv_nsec)) / ops;
+}
+
+static void test_nc_table_vs_tdb(void **state)
+{
+    struct nc_table_test_ctx *test_ctx;
+    struct tdb_context *tdb;
+    struct timespec start;
+    unsigned int seed;
+    char name[64];
+    double tbl_set, tbl_hit, tbl_miss;
+    double tdb_set, tdb_hit, tdb_miss;
+    errno_t ret;
+    int i;
+
+    if (!test_benchmark_enabled()) {
+        skip();
+    }
+
+    test_ctx = talloc_get_type_abort(*state, struct nc_table_test_ctx);
+
+    /* same parameters as the negative cache used */
+    tdb = tdb_open("memcache", 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0);
+    assert_non_null(tdb);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_entries; i++) {
+        nc_test_name(name, sizeof(name), i);
+        ret = sss_nc_table_set(test_ctx->table, SSS_NC_USER, NC_TEST_DOM,
+                               name, NC_TEST_NOW + 1 + i % 600, NC_TEST_NOW);
+        assert_int_equal(ret, EOK);
+    }
+    tbl_set = nc_bench_elapsed(&start, bench_entries);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_entries; i++) {
+        nc_test_name(name, sizeof(name), i);
+        ret = nc_tdb_set(tdb, name, NC_TEST_NOW + 1 + i % 600);
+        assert_int_equal(ret, EOK);
+    }
+    tdb_set = nc_bench_elapsed(&start, bench_entries);
+
+    seed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_lookups; i++) {
+        nc_test_name(name, sizeof(name), rand_r(&seed) % bench_entries);
+        ret = sss_nc_table_check(test_ctx->table, SSS_NC_USER, NC_TEST_DOM,
+                                 name, NC_TEST_NOW);
+        assert_int_equal(ret, EEXIST);
+    }
+    tbl_hit = nc_bench_elapsed(&start, bench_lookups);
+
+    seed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_lookups; i++) {
+        nc_test_name(name, sizeof(name), rand_r(&seed) % bench_entries);
+        ret = nc_tdb_check(tdb, name, NC_TEST_NOW);
+        assert_int_equal(ret, EEXIST);
+    }
+    tdb_hit = nc_bench_elapsed(&start, bench_lookups);
+
+    seed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_lookups; i++) {
+        nc_test_name(name, sizeof(name),
+                     bench_entries + rand_r(&seed) % bench_entries);
+        ret = sss_nc_table_check(test_ctx->table, SSS_NC_USER, NC_TEST_DOM,
+                                 name, NC_TEST_NOW);
+        assert_int_equal(ret, ENOENT);
+    }
+    tbl_miss = nc_bench_elapsed(&start, bench_lookups);
+
+    seed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_lookups; i++) {
+        nc_test_name(name, sizeof(name),
+                     bench_entries + rand_r(&seed) % bench_entries);
+        ret = nc_tdb_check(tdb, name, NC_TEST_NOW);
+        assert_int_equal(ret, ENOENT);
+    }
+    tdb_miss = nc_bench_elapsed(&start, bench_lookups);
+
+    printf("%d entries, %d lookups, ns per operation:\n",
+           bench_entries, bench_lookups);
+    printf("  tdb:   set %.1f hit %.1f miss %.1f\n", tdb_set, tdb_hit, tdb_miss);
+    printf("  table: set %.1f hit %.1f miss %.1f\n", tbl_set, tbl_hit, tbl_miss);
+
+    /* all entries expire within ten minutes, the wheel releases them */
+    ret = sss_nc_table_check(test_ctx->table, SSS_NC_USER, NC_TEST_DOM,
+                             "nobody", NC_TEST_NOW + 601);
+    assert_int_equal(ret, ENOENT);
+    assert_int_equal(sss_nc_table_count(test_ctx->table), 0);
+
+    tdb_close(tdb);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"entries", 0, POPT_ARG_INT, &bench_entries, 0,
+         _("Number of negative cache entries for the benchmark"), NULL },
+        {"lookups", 0, POPT_ARG_INT, &bench_lookups, 0,
+         _("Number of lookups done by the benchmark"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nc_table_keys,
+                                        test_nc_table_setup,
+                                        test_nc_table_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_table_expire,
+                                        test_nc_table_setup,
+                                        test_nc_table_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_table_reset,
+                                        test_nc_table_setup,
+                                        test_nc_table_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_table_vs_tdb,
+                                        test_nc_table_setup,
+                                        test_nc_table_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (bench_entries < 1 || bench_lookups < 1) {
+        fprintf(stderr, "\nAll arguments must be positive numbers\n\n");
+        return 1;
+    }
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
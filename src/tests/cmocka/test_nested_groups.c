@@ -240,6 +240,140 @@ static void nested_groups_test_one_group_unique_members(void **state)
                                        expected, N_ELEMENTS(expected));
 }
 
+#define NESTED_GROUPS_MANY_USERS 20
+
+static void nested_groups_test_one_group_many_members(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    errno_t ret;
+    const char *users[NESTED_GROUPS_MANY_USERS + 1] = { NULL };
+    const struct sysdb_attrs **user_reply;
+    const char *expected[NESTED_GROUPS_MANY_USERS] = { NULL };
+    char *name;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    /* more members than the number of parallel lookups, the replies
+     * must be matched with the right members */
+    for (i = 0; i < NESTED_GROUPS_MANY_USERS; i++) {
+        name = talloc_asprintf(test_ctx, "user%d", i + 1);
+        assert_non_null(name);
+        expected[i] = name;
+
+        users[i] = talloc_asprintf(test_ctx, "cn=%s,"USER_BASE_DN, name);
+        assert_non_null(users[i]);
+
+        user_reply = talloc_zero_array(test_ctx, const struct sysdb_attrs *, 2);
+        assert_non_null(user_reply);
+        user_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001 + i, name);
+        assert_non_null(user_reply[0]);
+        will_return(sdap_get_generic_recv, 1);
+        will_return(sdap_get_generic_recv, user_reply);
+        will_return(sdap_get_generic_recv, ERR_OK);
+    }
+
+    rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                            "rootgroup", users);
+    assert_non_null(rootgroup);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    /* run test, check for memory leaks */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    mock_sdap_get_generic_max_in_flight();
+    req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_zfree(req_mem_ctx);
+
+    /* check return code */
+    assert_int_equal(ret, ERR_OK);
+
+    /* The members were looked up in parallel, but not more of them than
+     * configured */
+    assert_int_equal(mock_sdap_get_generic_max_in_flight(),
+                     dp_opt_get_int(test_ctx->sdap_opts->basic,
+                                    SDAP_NESTING_CONCURRENCY));
+
+    /* Check the users */
+    assert_int_equal(test_ctx->num_users, N_ELEMENTS(expected));
+    assert_int_equal(test_ctx->num_groups, 1);
+
+    compare_sysdb_string_array_noorder(test_ctx->users,
+                                       expected, N_ELEMENTS(expected));
+}
+
+static void nested_groups_test_one_group_member_error(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    errno_t ret;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            "cn=user2,"USER_BASE_DN,
+                            "cn=user3,"USER_BASE_DN,
+                            NULL };
+    const struct sysdb_attrs *user1_reply[2] = { NULL };
+    const struct sysdb_attrs *user2_reply[2] = { NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    /* mock return values */
+    rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                            "rootgroup", users);
+    assert_non_null(rootgroup);
+
+    user1_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001, "user1");
+    assert_non_null(user1_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user1_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    /* the lookup of user3 is cancelled when the lookup of user2 fails */
+    user2_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2002, "user2");
+    assert_non_null(user2_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user2_reply);
+    will_return(sdap_get_generic_recv, EIO);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    /* run test, check for memory leaks */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    mock_sdap_get_generic_max_in_flight();
+    req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_zfree(req_mem_ctx);
+
+    /* check return code */
+    assert_int_equal(ret, EIO);
+
+    /* All three lookups were outstanding when the second one failed */
+    assert_int_equal(mock_sdap_get_generic_max_in_flight(), 3);
+}
+
 static void nested_groups_test_one_group_unique_members_one_ignored(void **state)
 {
     struct nested_groups_test_ctx *test_ctx = NULL;
@@ -1374,6 +1508,8 @@ int main(int argc, const char *argv[])
         new_test(one_group_no_members),
         new_test(one_group_unique_members),
         new_test(one_group_unique_members_one_ignored),
+        new_test(one_group_many_members),
+        new_test(one_group_member_error),
         new_test(one_group_dup_users),
         new_test(one_group_unique_group_members),
         new_test(one_group_dup_group_members),
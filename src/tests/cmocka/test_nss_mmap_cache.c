@@ -0,0 +1,577 @@
+/*
+    SSSD
+
+    NSS fast cache - lock-less readers and lookup tests
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <popt.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "sss_client/nss_mc.h"
+
+#define TESTS_PATH SSS_NSS_MCACHE_DIR
+
+#define MC_TEST_SLOTS 4096
+#define MC_TEST_TIMEOUT 300
+#define MC_TEST_UID_BASE 10000
+
+/* Can be tuned from the command line to turn this into a benchmark, the
+ * lookup benchmark runs only if SSS_TEST_BENCHMARK is set */
+static int num_readers = 8;
+static int num_records = 64;
+static int duration = 1;
+static int bench_users = 10000;
+static int bench_lookups = 200000;
+
+struct mc_reader {
+    pthread_t tid;
+    volatile bool *stop;
+    unsigned int seed;
+
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t fallbacks;
+    uint64_t torn;
+};
+
+struct mc_test_ctx {
+    struct sss_mc_ctx *mcc;
+    volatile bool stop;
+    struct mc_reader *readers;
+};
+
+static void mc_test_name(char *buf, size_t len, int idx)
+{
+    snprintf(buf, len, "stressuser%d", idx);
+}
+
+/* Every field of the record is derived from the same generation number
+ * so a reader can tell whether it got a copy mixing two writes. */
+static errno_t mc_test_store(struct mc_test_ctx *test_ctx, int idx,
+                             uint32_t gen)
+{
+    struct sized_string name;
+    struct sized_string pw;
+    struct sized_string gecos;
+    struct sized_string homedir;
+    struct sized_string shell;
+    char namebuf[64];
+    char gecosbuf[64];
+    char homebuf[128];
+
+    mc_test_name(namebuf, sizeof(namebuf), idx);
+    /* vary the length so records move between slots sizes */
+    snprintf(gecosbuf, sizeof(gecosbuf), "gen %u%.*s", gen,
+             (int)(gen % 40), "........................................");
+    snprintf(homebuf, sizeof(homebuf), "/home/%s/%u", namebuf, gen);
+
+    to_sized_string(&name, namebuf);
+    to_sized_string(&pw, "*");
+    to_sized_string(&gecos, gecosbuf);
+    to_sized_string(&homedir, homebuf);
+    to_sized_string(&shell, "/bin/sh");
+
+    return sss_mmap_cache_pw_store(&test_ctx->mcc, &name, &pw,
+                                   MC_TEST_UID_BASE + idx, gen,
+                                   &gecos, &homedir, &shell);
+}
+
+static bool mc_test_consistent(struct passwd *pwd, int idx)
+{
+    char namebuf[64];
+    char homebuf[128];
+    unsigned int gen;
+
+    mc_test_name(namebuf, sizeof(namebuf), idx);
+    if (strcmp(pwd->pw_name, namebuf) != 0
+            || pwd->pw_uid != MC_TEST_UID_BASE + idx) {
+        return false;
+    }
+
+    if (sscanf(pwd->pw_gecos, "gen %u", &gen) != 1 || gen != pwd->pw_gid) {
+        return false;
+    }
+
+    snprintf(homebuf, sizeof(homebuf), "/home/%s/%u", namebuf, gen);
+    return strcmp(pwd->pw_dir, homebuf) == 0;
+}
+
+static void *mc_reader_thread(void *pvt)
+{
+    struct mc_reader *reader = pvt;
+    struct passwd pwd;
+    char buffer[1024];
+    char name[64];
+    size_t name_len;
+    int idx;
+    errno_t ret;
+
+    while (!*reader->stop) {
+        idx = rand_r(&reader->seed) % num_records;
+        mc_test_name(name, sizeof(name), idx);
+        name_len = strlen(name);
+
+        if (idx % 2) {
+            ret = sss_nss_mc_getpwnam(name, name_len, &pwd,
+                                      buffer, sizeof(buffer));
+        } else {
+            ret = sss_nss_mc_getpwuid(MC_TEST_UID_BASE + idx, &pwd,
+                                      buffer, sizeof(buffer));
+        }
+
+        reader->lookups++;
+        switch (ret) {
+        case 0:
+            reader->hits++;
+            if (!mc_test_consistent(&pwd, idx)) {
+                reader->torn++;
+            }
+            break;
+        case ENOENT:
+            reader->misses++;
+            break;
+        default:
+            /* the NSS module would ask the responder now */
+            reader->fallbacks++;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int test_nss_mc_setup(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    errno_t ret;
+    int i;
+
+    assert_true(leak_check_setup());
+
+    ret = mkdir(TESTS_PATH, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = sss_mmap_cache_init(test_ctx, "passwd", SSS_MC_PASSWD,
+                              MC_TEST_SLOTS, MC_TEST_TIMEOUT,
+                              &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+    assert_non_null(test_ctx->mcc);
+
+    for (i = 0; i < num_records; i++) {
+        ret = mc_test_store(test_ctx, i, 0);
+        assert_int_equal(ret, EOK);
+    }
+
+    test_ctx->readers = talloc_zero_array(test_ctx, struct mc_reader,
+                                          num_readers);
+    assert_non_null(test_ctx->readers);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_nss_mc_teardown(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct mc_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    unlink(TESTS_PATH"/passwd");
+    unlink(TESTS_PATH"/negative");
+    rmdir(TESTS_PATH);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_nss_mc_single_thread(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    struct passwd pwd;
+    char buffer[1024];
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct mc_test_ctx);
+
+    ret = mc_test_store(test_ctx, 1, 42);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_nss_mc_getpwuid(MC_TEST_UID_BASE + 1, &pwd,
+                              buffer, sizeof(buffer));
+    assert_int_equal(ret, EOK);
+    assert_true(mc_test_consistent(&pwd, 1));
+    assert_int_equal(pwd.pw_gid, 42);
+
+    ret = sss_mmap_cache_pw_invalidate_uid(&test_ctx->mcc,
+                                           MC_TEST_UID_BASE + 1);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_nss_mc_getpwuid(MC_TEST_UID_BASE + 1, &pwd,
+                              buffer, sizeof(buffer));
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_nss_mc_readers_vs_writer(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    struct mc_reader total = { 0 };
+    struct timespec start;
+    struct timespec now;
+    uint32_t gen = 1;
+    uint64_t writes = 0;
+    double elapsed;
+    errno_t ret;
+    int idx;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct mc_test_ctx);
+
+    for (i = 0; i < num_readers; i++) {
+        test_ctx->readers[i].stop = &test_ctx->stop;
+        test_ctx->readers[i].seed = i + 1;
+        ret = pthread_create(&test_ctx->readers[i].tid, NULL,
+                             mc_reader_thread, &test_ctx->readers[i]);
+        assert_int_equal(ret, 0);
+    }
+
+    /* Hammer the very records the readers are looking up. Every now and
+     * then drop a record completely so it is stored at a different place
+     * and the hash chains are rewritten under the readers. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        for (idx = 0; idx < num_records; idx++) {
+            if ((gen + idx) % 7 == 0) {
+                ret = sss_mmap_cache_pw_invalidate_uid(&test_ctx->mcc,
+                                                       MC_TEST_UID_BASE + idx);
+                assert_true(ret == EOK || ret == ENOENT);
+            }
+            ret = mc_test_store(test_ctx, idx, gen);
+            assert_int_equal(ret, EOK);
+            writes++;
+        }
+        gen++;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (now.tv_sec - start.tv_sec < duration);
+
+    test_ctx->stop = true;
+    for (i = 0; i < num_readers; i++) {
+        ret = pthread_join(test_ctx->readers[i].tid, NULL);
+        assert_int_equal(ret, 0);
+
+        total.lookups += test_ctx->readers[i].lookups;
+        total.hits += test_ctx->readers[i].hits;
+        total.misses += test_ctx->readers[i].misses;
+        total.fallbacks += test_ctx->readers[i].fallbacks;
+        total.torn += test_ctx->readers[i].torn;
+    }
+
+    elapsed = (now.tv_sec - start.tv_sec)
+              + (now.tv_nsec - start.tv_nsec) / 1e9;
+    if (test_benchmark_enabled()) {
+        printf("%d readers, %d records, %.2fs: %"PRIu64" writes, "
+               "%"PRIu64" lookups (%.0f/s), %"PRIu64" hits, "
+               "%"PRIu64" misses, %"PRIu64" socket fallbacks, "
+               "%"PRIu64" torn reads\n",
+               num_readers, num_records, elapsed, writes,
+               total.lookups, total.lookups / elapsed, total.hits,
+               total.misses, total.fallbacks, total.torn);
+    }
+
+    assert_int_equal(total.torn, 0);
+    assert_true(total.hits > 0);
+}
+
+static int test_nss_mc_bench_setup(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    errno_t ret;
+    int i;
+
+    assert_true(leak_check_setup());
+
+    ret = mkdir(TESTS_PATH, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    /* records of these users take 4 slots, leave some room */
+    ret = sss_mmap_cache_init(test_ctx, "passwd", SSS_MC_PASSWD,
+                              bench_users * 6, MC_TEST_TIMEOUT,
+                              &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; i < bench_users; i++) {
+        ret = mc_test_store(test_ctx, i, 1);
+        assert_int_equal(ret, EOK);
+    }
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+/* The same lookup sss_nss_mc_getpwnam() does, but on a context of our own
+ * so the index can be hidden from it. */
+static errno_t mc_bench_getpwnam(struct sss_cli_mc_ctx *ctx, const char *name)
+{
+    struct sss_nss_mc_walk walk;
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_pwd_data *data;
+    uint32_t slot;
+    errno_t ret = ENOENT;
+
+    slot = sss_nss_mc_walk_first(ctx, &walk, name, strlen(name) + 1);
+    while (MC_SLOT_WITHIN_BOUNDS(slot, ctx->dt_size)) {
+        free(rec);
+        rec = NULL;
+
+        ret = sss_nss_mc_get_record(ctx, slot, &rec);
+        if (ret != EOK) {
+            break;
+        }
+
+        if (rec->hash1 == walk.hash) {
+            data = (struct sss_mc_pwd_data *)rec->data;
+            if (strcmp(name, (char *)data + data->name) == 0) {
+                break;
+            }
+        }
+
+        ret = ENOENT;
+        slot = sss_nss_mc_walk_next(ctx, &walk, rec);
+    }
+
+    free(rec);
+    return ret;
+}
+
+static double mc_bench_run(struct sss_cli_mc_ctx *ctx, bool hits)
+{
+    struct timespec start;
+    struct timespec end;
+    char name[64];
+    unsigned int seed = 1;
+    errno_t ret;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_lookups; i++) {
+        if (hits) {
+            mc_test_name(name, sizeof(name), rand_r(&seed) % bench_users);
+        } else {
+            snprintf(name, sizeof(name), "nosuchuser%d", rand_r(&seed));
+        }
+
+        ret = mc_bench_getpwnam(ctx, name);
+        assert_int_equal(ret, hits ? EOK : ENOENT);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9
+            + (end.tv_nsec - start.tv_nsec)) / bench_lookups;
+}
+
+static void test_nss_mc_lookup_latency(void **state)
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    struct sss_cli_mc_ctx v2_ctx = SSS_CLI_MC_CTX_INITIALIZER(&mutex);
+    struct sss_cli_mc_ctx v1_ctx;
+    errno_t ret;
+
+    ret = sss_nss_mc_get_ctx("passwd", &v2_ctx);
+    assert_int_equal(ret, EOK);
+    assert_non_null(v2_ctx.bucket_table);
+
+    /* same mapping, but walk the version 1 hash chains */
+    v1_ctx = v2_ctx;
+    v1_ctx.bucket_table = NULL;
+    v1_ctx.nbuckets = 0;
+
+    printf("%d users, %d lookups, ns per lookup:\n", bench_users,
+           bench_lookups);
+    printf("  v1 chains: hit %.1f miss %.1f\n",
+           mc_bench_run(&v1_ctx, true), mc_bench_run(&v1_ctx, false));
+    printf("  v2 index:  hit %.1f miss %.1f\n",
+           mc_bench_run(&v2_ctx, true), mc_bench_run(&v2_ctx, false));
+
+    munmap(v2_ctx.mmap_base, v2_ctx.mmap_size);
+    close(v2_ctx.fd);
+}
+
+static int test_nss_mc_neg_setup(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    ret = mkdir(TESTS_PATH, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = sss_mmap_cache_init(test_ctx, "negative", SSS_MC_NEGATIVE,
+                              MC_TEST_SLOTS, MC_TEST_TIMEOUT,
+                              &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+    assert_non_null(test_ctx->mcc);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static void test_nss_mc_negative(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct mc_test_ctx);
+
+    ret = sss_mmap_cache_neg_store(&test_ctx->mcc, SSS_MC_NEG_USER_NAME,
+                                   "ghost", 0);
+    assert_int_equal(ret, EOK);
+    ret = sss_mmap_cache_neg_store(&test_ctx->mcc, SSS_MC_NEG_GROUP_NAME,
+                                   "ghost", 0);
+    assert_int_equal(ret, EOK);
+    ret = sss_mmap_cache_neg_store(&test_ctx->mcc, SSS_MC_NEG_UID,
+                                   NULL, 4242);
+    assert_int_equal(ret, EOK);
+
+    /* name keys need a name */
+    ret = sss_mmap_cache_neg_store(&test_ctx->mcc, SSS_MC_NEG_USER_NAME,
+                                   NULL, 0);
+    assert_int_equal(ret, EINVAL);
+
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_USER_NAME, "ghost", 5);
+    assert_int_equal(ret, 0);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME, "ghost", 5);
+    assert_int_equal(ret, 0);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_USER_NAME, "ghost2", 6);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nss_mc_check_negative_id(SSS_MC_NEG_UID, 4242);
+    assert_int_equal(ret, 0);
+    ret = sss_nss_mc_check_negative_id(SSS_MC_NEG_GID, 4242);
+    assert_int_equal(ret, ENOENT);
+
+    /* the user shows up, the group stays missing */
+    ret = sss_mmap_cache_neg_invalidate(&test_ctx->mcc, SSS_MC_NEG_USER_NAME,
+                                        "ghost", 0);
+    assert_int_equal(ret, EOK);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_USER_NAME, "ghost", 5);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME, "ghost", 5);
+    assert_int_equal(ret, 0);
+
+    /* storing an existing entry again refreshes it in place */
+    ret = sss_mmap_cache_neg_store(&test_ctx->mcc, SSS_MC_NEG_GROUP_NAME,
+                                   "ghost", 0);
+    assert_int_equal(ret, EOK);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME, "ghost", 5);
+    assert_int_equal(ret, 0);
+
+    /* resetting the responder negative cache drops everything */
+    sss_mmap_cache_reset(test_ctx->mcc);
+    ret = sss_nss_mc_check_negative_name(SSS_MC_NEG_GROUP_NAME, "ghost", 5);
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nss_mc_check_negative_id(SSS_MC_NEG_UID, 4242);
+    assert_int_equal(ret, ENOENT);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"readers", 0, POPT_ARG_INT, &num_readers, 0,
+         _("Number of reader threads"), NULL },
+        {"records", 0, POPT_ARG_INT, &num_records, 0,
+         _("Number of records the writer keeps rewriting"), NULL },
+        {"duration", 0, POPT_ARG_INT, &duration, 0,
+         _("Duration of the stress test in seconds"), NULL },
+        {"bench-users", 0, POPT_ARG_INT, &bench_users, 0,
+         _("Number of cached users for the lookup benchmark"), NULL },
+        {"bench-lookups", 0, POPT_ARG_INT, &bench_lookups, 0,
+         _("Number of lookups done by the lookup benchmark"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nss_mc_single_thread,
+                                        test_nss_mc_setup,
+                                        test_nss_mc_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_mc_readers_vs_writer,
+                                        test_nss_mc_setup,
+                                        test_nss_mc_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_mc_negative,
+                                        test_nss_mc_neg_setup,
+                                        test_nss_mc_teardown),
+    };
+
+    const struct CMUnitTest bench_tests[] = {
+        cmocka_unit_test_setup_teardown(test_nss_mc_lookup_latency,
+                                        test_nss_mc_bench_setup,
+                                        test_nss_mc_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (num_readers < 1 || num_records < 1 || duration < 1
+            || bench_users < 1 || bench_lookups < 1) {
+        fprintf(stderr, "\nAll arguments must be positive numbers\n\n");
+        return 1;
+    }
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && test_benchmark_enabled()) {
+        rv = cmocka_run_group_tests(bench_tests, NULL, NULL);
+    }
+
+    return rv;
+}
@@ -22,6 +22,7 @@
 #include <tevent.h>
 #include <errno.h>
 #include <popt.h>
+#include <time.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
@@ -137,6 +138,8 @@ struct cache_req_test_ctx {
 
     struct cache_req_result *result;
     bool dp_called;
+    unsigned int dp_num_calls;
+    unsigned int num_done;
 
     /* NOTE: Please, instead of adding new create_[user|group] bool,
      * use bitshift. */
@@ -536,6 +539,7 @@ __wrap_sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
 
     ctx = sss_mock_ptr_type(struct cache_req_test_ctx*);
     ctx->dp_called = true;
+    ctx->dp_num_calls++;
 
     if (ctx->create_user1) {
         prepare_user(ctx->tctx->dom, &users[0], 1000, time(NULL));
@@ -819,6 +823,56 @@ void test_user_by_name_multiple_domains_notfound(void **state)
     assert_true(test_ctx->dp_called);
 }
 
+void test_user_by_name_multiple_domains_parallel(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain_b = NULL;
+    struct sss_domain_info *domain_d = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_search = true;
+
+    /* Setup user. The entry in the last domain is found immediately but
+     * the one in the second domain takes precedence. */
+    domain_b = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_b", true);
+    assert_non_null(domain_b);
+    domain_d = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_d", true);
+    assert_non_null(domain_d);
+
+    prepare_user(domain_b, &users[0], -1000, time(NULL));
+    prepare_user(domain_d, &users[0], 1000, time(NULL));
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ERR_OK);
+    assert_true(test_ctx->dp_called);
+    check_user(test_ctx, &users[0], domain_b);
+}
+
+void test_user_by_name_multiple_domains_parallel_notfound(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_search = true;
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ENOENT);
+    assert_true(test_ctx->dp_called);
+    assert_int_equal(test_ctx->dp_num_calls, 4);
+}
+
 void test_user_by_name_multiple_domains_parse(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -906,6 +960,190 @@ void test_user_by_name_cache_valid(void **state)
     check_user(test_ctx, &users[0], test_ctx->tctx->dom);
 }
 
+static void delete_user(struct sss_domain_info *domain,
+                        struct test_user *user)
+{
+    char *fqname;
+    errno_t ret;
+
+    fqname = sss_create_internal_fqname(NULL, user->short_name, domain->name);
+    assert_non_null(fqname);
+
+    ret = sysdb_delete_user(domain, fqname, 0);
+    talloc_free(fqname);
+    assert_int_equal(ret, EOK);
+}
+
+static void run_user_by_name_hot_cache(struct cache_req_test_ctx *test_ctx,
+                                       struct test_user *user,
+                                       errno_t exp_ret)
+{
+    mock_parse_inp(user->short_name, NULL, ERR_OK);
+
+    talloc_zfree(test_ctx->result);
+    run_cache_req_domtype(test_ctx, cache_req_user_by_name_send,
+                          cache_req_user_by_name_test_done,
+                          test_ctx->tctx->dom, 0, CACHE_REQ_POSIX_DOM,
+                          user->short_name, exp_ret);
+}
+
+void test_user_by_name_hot_cache(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    uint64_t hits;
+    uint64_t misses;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->hot_cache_size = 10;
+    test_ctx->rctx->hot_cache_timeout = 1000;
+
+    /* Setup user. */
+    prepare_user(test_ctx->tctx->dom, &users[0], 1000, time(NULL));
+
+    /* Test. */
+    run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    /* The user is still returned even though it is gone from sysdb. */
+    delete_user(test_ctx->tctx->dom, &users[0]);
+    run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    cache_req_hot_cache_get_stats(test_ctx->rctx, &hits, &misses);
+    assert_int_equal(hits, 1);
+    assert_int_equal(misses, 1);
+
+    /* Flushing groups keeps the user. */
+    cache_req_hot_cache_flush(test_ctx->rctx, CACHE_REQ_HOT_GROUPS);
+    run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    /* After invalidation sysdb and the data provider are searched. */
+    cache_req_hot_cache_flush(test_ctx->rctx, CACHE_REQ_HOT_USERS);
+    will_return(__wrap_sss_dp_get_account_send, test_ctx);
+    mock_account_recv_simple();
+    run_user_by_name_hot_cache(test_ctx, &users[0], ENOENT);
+    assert_true(test_ctx->dp_called);
+
+    cache_req_hot_cache_get_stats(test_ctx->rctx, &hits, &misses);
+    assert_int_equal(hits, 2);
+    assert_int_equal(misses, 2);
+}
+
+void test_user_by_name_hot_cache_evict(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->hot_cache_size = 1;
+    test_ctx->rctx->hot_cache_timeout = 1000;
+
+    /* Setup users. */
+    prepare_user(test_ctx->tctx->dom, &users[0], 1000, time(NULL));
+    prepare_user(test_ctx->tctx->dom, &users[1], 1000, time(NULL));
+
+    /* The second user evicts the first one. */
+    run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+    run_user_by_name_hot_cache(test_ctx, &users[1], ERR_OK);
+
+    delete_user(test_ctx->tctx->dom, &users[0]);
+    delete_user(test_ctx->tctx->dom, &users[1]);
+
+    run_user_by_name_hot_cache(test_ctx, &users[1], ERR_OK);
+    check_user(test_ctx, &users[1], test_ctx->tctx->dom);
+
+    will_return(__wrap_sss_dp_get_account_send, test_ctx);
+    mock_account_recv_simple();
+    run_user_by_name_hot_cache(test_ctx, &users[0], ENOENT);
+    assert_true(test_ctx->dp_called);
+}
+
+void test_user_by_name_hot_cache_expired(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->hot_cache_size = 10;
+    test_ctx->rctx->hot_cache_timeout = 1000;
+
+    /* Setup user. */
+    prepare_user(test_ctx->tctx->dom, &users[0], -1000, time(NULL));
+
+    /* The user is expired, the cached copy is not used when the data
+     * provider refreshed the user. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+    run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+    assert_true(test_ctx->dp_called);
+
+    delete_user(test_ctx->tctx->dom, &users[0]);
+
+    test_ctx->dp_called = false;
+    run_user_by_name_hot_cache(test_ctx, &users[0], ENOENT);
+    assert_true(test_ctx->dp_called);
+}
+
+static int cmp_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+#define HOT_CACHE_BENCH_LOOKUPS 1000
+
+static void bench_user_by_name(struct cache_req_test_ctx *test_ctx,
+                               const char *label)
+{
+    uint64_t times[HOT_CACHE_BENCH_LOOKUPS];
+    struct timespec start;
+    struct timespec end;
+    int i;
+
+    for (i = 0; i < HOT_CACHE_BENCH_LOOKUPS; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_user_by_name_hot_cache(test_ctx, &users[0], ERR_OK);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        times[i] = (end.tv_sec - start.tv_sec) * 1000000000ULL
+                   + end.tv_nsec - start.tv_nsec;
+    }
+
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    qsort(times, HOT_CACHE_BENCH_LOOKUPS, sizeof(uint64_t), cmp_uint64);
+    print_message("getpwnam %s: p50 %"PRIu64" ns, p99 %"PRIu64" ns\n", label,
+                  times[HOT_CACHE_BENCH_LOOKUPS / 2],
+                  times[HOT_CACHE_BENCH_LOOKUPS * 99 / 100]);
+}
+
+void test_user_by_name_hot_cache_benchmark(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    uint64_t hits;
+    uint64_t misses;
+
+    if (!test_benchmark_enabled()) {
+        skip();
+    }
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+
+    /* Setup user. */
+    prepare_user(test_ctx->tctx->dom, &users[0], 1000, time(NULL));
+
+    bench_user_by_name(test_ctx, "without hot object cache");
+
+    test_ctx->rctx->hot_cache_size = 100;
+    test_ctx->rctx->hot_cache_timeout = 1000;
+    bench_user_by_name(test_ctx, "with hot object cache");
+
+    cache_req_hot_cache_get_stats(test_ctx->rctx, &hits, &misses);
+    assert_int_equal(hits, HOT_CACHE_BENCH_LOOKUPS - 1);
+    assert_int_equal(misses, 1);
+}
+
 void test_user_by_name_cache_expired(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -1747,6 +1985,95 @@ void test_user_by_id_missing_notfound(void **state)
     assert_true(test_ctx->dp_called);
 }
 
+#define COALESCE_NUM_REQS 1000
+
+static void cache_req_user_by_id_coalesced_done(struct tevent_req *req)
+{
+    struct cache_req_test_ctx *ctx = NULL;
+    struct cache_req_result *result = NULL;
+    errno_t ret;
+
+    ctx = tevent_req_callback_data(req, struct cache_req_test_ctx);
+
+    ret = cache_req_user_by_id_recv(ctx, req, &result);
+    talloc_zfree(req);
+    if (ret != EOK) {
+        ctx->tctx->error = ret;
+        ctx->tctx->done = true;
+        return;
+    }
+
+    /* Every request must receive its own copy of the result. */
+    assert_non_null(result);
+    assert_ptr_not_equal(result, ctx->result);
+    talloc_free(ctx->result);
+    ctx->result = result;
+
+    ctx->num_done++;
+    if (ctx->num_done == COALESCE_NUM_REQS) {
+        ctx->tctx->error = EOK;
+        ctx->tctx->done = true;
+    }
+}
+
+void test_user_by_id_coalesced(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    TALLOC_CTX *req_mem_ctx;
+    struct tevent_req *req;
+    uint64_t num_lookups;
+    uint64_t num_coalesced;
+    errno_t ret;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+
+    /* Mock values. Only a single backend call is expected. */
+    will_return(__wrap_sss_dp_get_account_send, test_ctx);
+    mock_account_recv_simple();
+
+    test_ctx->create_user1 = true;
+    test_ctx->create_user2 = false;
+
+    /* Test. */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    check_leaks_push(req_mem_ctx);
+
+    for (i = 0; i < COALESCE_NUM_REQS; i++) {
+        req = cache_req_user_by_id_send(req_mem_ctx, test_ctx->tctx->ev,
+                                        test_ctx->rctx, test_ctx->ncache, 0,
+                                        test_ctx->tctx->dom->name,
+                                        users[0].uid);
+        assert_non_null(req);
+        tevent_req_set_callback(req, cache_req_user_by_id_coalesced_done,
+                                test_ctx);
+    }
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, ERR_OK);
+    assert_true(check_leaks_pop(req_mem_ctx));
+    talloc_free(req_mem_ctx);
+
+    assert_int_equal(test_ctx->num_done, COALESCE_NUM_REQS);
+    assert_int_equal(test_ctx->dp_num_calls, 1);
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    cache_req_get_coalesce_stats(test_ctx->rctx, &num_lookups, &num_coalesced);
+    assert_int_equal(num_lookups, 1);
+    assert_int_equal(num_coalesced, COALESCE_NUM_REQS - 1);
+
+    /* A request started after the lookup finished is not coalesced. */
+    talloc_zfree(test_ctx->result);
+    test_ctx->dp_called = false;
+    run_user_by_id(test_ctx, test_ctx->tctx->dom, 0, ERR_OK);
+    assert_false(test_ctx->dp_called);
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+
+    cache_req_get_coalesce_stats(test_ctx->rctx, &num_lookups, &num_coalesced);
+    assert_int_equal(num_lookups, 2);
+    assert_int_equal(num_coalesced, COALESCE_NUM_REQS - 1);
+}
+
 void test_group_by_name_multiple_domains_found(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -4411,6 +4738,10 @@ int main(int argc, const char *argv[])
     const struct CMUnitTest tests[] = {
         new_single_domain_test(user_by_name_cache_valid),
         new_single_domain_test(user_by_name_cache_expired),
+        new_single_domain_test(user_by_name_hot_cache),
+        new_single_domain_test(user_by_name_hot_cache_evict),
+        new_single_domain_test(user_by_name_hot_cache_expired),
+        new_single_domain_test(user_by_name_hot_cache_benchmark),
         new_single_domain_test(user_by_name_cache_midpoint),
         new_single_domain_test(user_by_name_ncache),
         new_single_domain_test(user_by_name_missing_found),
@@ -4420,6 +4751,8 @@ int main(int argc, const char *argv[])
         new_single_domain_test(user_by_name_missing_notfound_cache_first_full_name),
         new_multi_domain_test(user_by_name_multiple_domains_found),
         new_multi_domain_test(user_by_name_multiple_domains_notfound),
+        new_multi_domain_test(user_by_name_multiple_domains_parallel),
+        new_multi_domain_test(user_by_name_multiple_domains_parallel_notfound),
         new_multi_domain_test(user_by_name_multiple_domains_parse),
         new_multi_domain_test(user_by_name_multiple_domains_requested_domains_found),
         new_multi_domain_test(user_by_name_multiple_domains_requested_domains_notfound),
@@ -4439,6 +4772,7 @@ int main(int argc, const char *argv[])
         new_single_domain_test(user_by_id_ncache),
         new_single_domain_test(user_by_id_missing_found),
         new_single_domain_test(user_by_id_missing_notfound),
+        new_single_domain_test(user_by_id_coalesced),
         new_multi_domain_test(user_by_id_multiple_domains_found),
         new_multi_domain_test(user_by_id_multiple_domains_notfound),
         new_single_domain_id_limit_test(user_by_id_below_id_range),
@@ -0,0 +1,366 @@
+/*
+    SSSD
+
+    Responder packets - unit tests and large reply benchmark
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/common/responder_packet.h"
+
+#define PKT_TEST_DOM "test.dom"
+
+#define PKT_TEST_MEMBERS 1000
+#define PKT_BENCH_MEMBERS 100000
+
+/* Raised to PKT_BENCH_MEMBERS if SSS_TEST_BENCHMARK is set, can be set from
+ * the command line, e.g. --members=1000000 */
+static int bench_members = 0;
+
+struct pkt_test_ctx {
+    int fds[2];
+};
+
+static int test_pkt_setup(void **state)
+{
+    struct pkt_test_ctx *test_ctx;
+    int ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct pkt_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, test_ctx->fds);
+    assert_int_equal(ret, 0);
+
+    ret = fcntl(test_ctx->fds[0], F_SETFL, O_NONBLOCK);
+    assert_int_equal(ret, 0);
+
+    check_leaks_push(test_ctx);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_pkt_teardown(void **state)
+{
+    struct pkt_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct pkt_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    close(test_ctx->fds[0]);
+    close(test_ctx->fds[1]);
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* Sends the packet and returns everything that was received on the other
+ * side of the socket. */
+static uint8_t *pkt_test_transfer(TALLOC_CTX *mem_ctx,
+                                  struct pkt_test_ctx *test_ctx,
+                                  struct sss_packet *packet,
+                                  size_t *_len)
+{
+    uint8_t *data = NULL;
+    size_t len = 0;
+    ssize_t rb;
+    int ret;
+
+    do {
+        ret = sss_packet_send(packet, test_ctx->fds[0]);
+        assert_true(ret == EOK || ret == EAGAIN);
+
+        do {
+            data = talloc_realloc(mem_ctx, data, uint8_t, len + 65536);
+            assert_non_null(data);
+
+            rb = recv(test_ctx->fds[1], data + len, 65536, MSG_DONTWAIT);
+            if (rb > 0) {
+                len += rb;
+            }
+        } while (rb > 0);
+    } while (ret == EAGAIN);
+
+    *_len = len;
+    return data;
+}
+
+static void test_pkt_append_buffer(void **state)
+{
+    struct pkt_test_ctx *test_ctx;
+    struct sss_packet *packet;
+    uint8_t *buf;
+    uint8_t *body;
+    uint8_t *data;
+    size_t blen;
+    size_t len;
+    uint32_t plen;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct pkt_test_ctx);
+
+    ret = sss_packet_new(test_ctx, 0, SSS_NSS_GETGRNAM, &packet);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_packet_grow(packet, 4);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &body, &blen);
+    memcpy(body, "body", 4);
+
+    buf = (uint8_t *)talloc_strdup(test_ctx, "first");
+    assert_non_null(buf);
+    ret = sss_packet_append_buffer(packet, buf, 5);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(talloc_parent(buf), packet);
+
+    buf = (uint8_t *)talloc_strdup(test_ctx, "second");
+    assert_non_null(buf);
+    ret = sss_packet_append_buffer(packet, buf, 6);
+    assert_int_equal(ret, EOK);
+
+    /* appended buffers are not part of the body */
+    sss_packet_get_body(packet, &body, &blen);
+    assert_int_equal(blen, 4);
+
+    /* and the body can not change anymore */
+    ret = sss_packet_grow(packet, 4);
+    assert_int_equal(ret, EINVAL);
+    ret = sss_packet_shrink(packet, 4);
+    assert_int_equal(ret, EINVAL);
+
+    data = pkt_test_transfer(test_ctx, test_ctx, packet, &len);
+    assert_int_equal(len, SSS_NSS_HEADER_SIZE + 15);
+    SAFEALIGN_COPY_UINT32(&plen, data, NULL);
+    assert_int_equal(plen, len);
+    assert_memory_equal(data + SSS_NSS_HEADER_SIZE, "bodyfirstsecond", 15);
+    talloc_free(data);
+
+    /* resetting the packet drops the buffers */
+    ret = sss_packet_set_size(packet, 0);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &body, &blen);
+    assert_int_equal(blen, 0);
+
+    talloc_free(packet);
+}
+
+static double pkt_bench_elapsed(struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3
+            + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* Group reply body up to the members: num_results, reserved, gid,
+ * num_members, name and password. */
+static void pkt_bench_group_header(struct sss_packet *packet, size_t *_rp)
+{
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    ret = sss_packet_grow(packet, 4 * sizeof(uint32_t) + sizeof("group") + 2);
+    assert_int_equal(ret, EOK);
+
+    sss_packet_get_body(packet, &body, &blen);
+    *_rp = 0;
+    SAFEALIGN_SET_UINT32(&body[*_rp], 1, _rp);
+    SAFEALIGN_SET_UINT32(&body[*_rp], 0, _rp);
+    SAFEALIGN_SET_UINT32(&body[*_rp], 10000, _rp);
+    SAFEALIGN_SET_UINT32(&body[*_rp], bench_members, _rp);
+    SAFEALIGN_SET_STRING(&body[*_rp], "group", sizeof("group"), _rp);
+    SAFEALIGN_SET_STRING(&body[*_rp], "*", 2, _rp);
+}
+
+static void test_pkt_large_group(void **state)
+{
+    struct pkt_test_ctx *test_ctx;
+    struct sss_packet *packet;
+    struct sized_string *names;
+    struct timespec start;
+    char *name;
+    uint8_t *members;
+    uint8_t *expected;
+    uint8_t *data;
+    uint8_t *body;
+    size_t expected_len;
+    size_t members_len = 0;
+    size_t blen;
+    size_t len;
+    size_t rp;
+    double grow_build, grow_send;
+    double presized_build, presized_send;
+    double segment_build, segment_send;
+    errno_t ret;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct pkt_test_ctx);
+
+    names = talloc_array(test_ctx, struct sized_string, bench_members);
+    assert_non_null(names);
+    for (i = 0; i < bench_members; i++) {
+        name = talloc_asprintf(names, "member%d@%s", i, PKT_TEST_DOM);
+        assert_non_null(name);
+        to_sized_string(&names[i], name);
+        members_len += names[i].len;
+    }
+
+    /* Grow the packet for every member */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sss_packet_new(test_ctx, 0, SSS_NSS_GETGRNAM, &packet);
+    assert_int_equal(ret, EOK);
+    pkt_bench_group_header(packet, &rp);
+    for (i = 0; i < bench_members; i++) {
+        ret = sss_packet_grow(packet, names[i].len);
+        assert_int_equal(ret, EOK);
+        sss_packet_get_body(packet, &body, &blen);
+        SAFEALIGN_SET_STRING(&body[rp], names[i].str, names[i].len, &rp);
+    }
+    grow_build = pkt_bench_elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    expected = pkt_test_transfer(test_ctx, test_ctx, packet, &expected_len);
+    grow_send = pkt_bench_elapsed(&start);
+    talloc_free(packet);
+
+    assert_int_equal(expected_len, SSS_NSS_HEADER_SIZE
+                                   + 4 * sizeof(uint32_t) + sizeof("group") + 2
+                                   + members_len);
+
+    /* Grow the packet once for all members */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sss_packet_new(test_ctx, 0, SSS_NSS_GETGRNAM, &packet);
+    assert_int_equal(ret, EOK);
+    pkt_bench_group_header(packet, &rp);
+    ret = sss_packet_grow(packet, members_len);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &body, &blen);
+    for (i = 0; i < bench_members; i++) {
+        SAFEALIGN_SET_STRING(&body[rp], names[i].str, names[i].len, &rp);
+    }
+    presized_build = pkt_bench_elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    data = pkt_test_transfer(test_ctx, test_ctx, packet, &len);
+    presized_send = pkt_bench_elapsed(&start);
+    talloc_free(packet);
+
+    assert_int_equal(len, expected_len);
+    assert_memory_equal(data, expected, len);
+    talloc_free(data);
+
+    /* Build the members separately and append them without copying */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sss_packet_new(test_ctx, 0, SSS_NSS_GETGRNAM, &packet);
+    assert_int_equal(ret, EOK);
+    pkt_bench_group_header(packet, &rp);
+    members = talloc_array(test_ctx, uint8_t, members_len);
+    assert_non_null(members);
+    rp = 0;
+    for (i = 0; i < bench_members; i++) {
+        SAFEALIGN_SET_STRING(&members[rp], names[i].str, names[i].len, &rp);
+    }
+    ret = sss_packet_append_buffer(packet, members, members_len);
+    assert_int_equal(ret, EOK);
+    segment_build = pkt_bench_elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    data = pkt_test_transfer(test_ctx, test_ctx, packet, &len);
+    segment_send = pkt_bench_elapsed(&start);
+    talloc_free(packet);
+
+    assert_int_equal(len, expected_len);
+    assert_memory_equal(data, expected, len);
+    talloc_free(data);
+
+    if (test_benchmark_enabled()) {
+        printf("group with %d members, %zu bytes reply, build/send ms:\n",
+               bench_members, expected_len);
+        printf("  grow per member: %.2f/%.2f\n", grow_build, grow_send);
+        printf("  presized:        %.2f/%.2f\n",
+               presized_build, presized_send);
+        printf("  appended buffer: %.2f/%.2f\n",
+               segment_build, segment_send);
+    }
+
+    talloc_free(expected);
+    talloc_free(names);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"members", 0, POPT_ARG_INT, &bench_members, 0,
+         _("Number of group members for the benchmark"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_pkt_append_buffer,
+                                        test_pkt_setup,
+                                        test_pkt_teardown),
+        cmocka_unit_test_setup_teardown(test_pkt_large_group,
+                                        test_pkt_setup,
+                                        test_pkt_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (bench_members < 0) {
+        fprintf(stderr, "\nAll arguments must be positive numbers\n\n");
+        return 1;
+    }
+
+    if (bench_members == 0) {
+        bench_members = test_benchmark_enabled() ? PKT_BENCH_MEMBERS
+                                                 : PKT_TEST_MEMBERS;
+    }
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -29,6 +29,9 @@
 #include "util/crypto/sss_crypto.h"
 #include "db/sysdb_iphosts.h"
 
+/* The batched search internals are tested directly */
+#include "providers/ldap/sdap_async.c"
+
 /* mock an LDAP entry */
 struct mock_ldap_attr {
     const char *name;
@@ -1223,6 +1226,564 @@ static void test_sdap_get_primary_name(void **state)
     talloc_free(attrs);
 }
 
+/* Batched search tests */
+#define BATCH_TEST_MAX 8
+
+struct batch_test_ctx {
+    size_t num_batches;
+    size_t sizes[BATCH_TEST_MAX];
+
+    /* Batch number that fails to be stored, 0 for none */
+    size_t fail_batch;
+};
+
+static errno_t test_batch_store(struct sysdb_attrs **entries,
+                                size_t count,
+                                void *pvt)
+{
+    struct batch_test_ctx *bctx = (struct batch_test_ctx *) pvt;
+    size_t i;
+
+    assert_non_null(entries);
+    assert_true(count > 0);
+    assert_true(bctx->num_batches < BATCH_TEST_MAX);
+
+    for (i = 0; i < count; i++) {
+        assert_entry_has_attr(entries[i], SYSDB_NAME, "tuser1");
+    }
+
+    bctx->sizes[bctx->num_batches++] = count;
+    if (bctx->num_batches == bctx->fail_batch) {
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static struct mock_ldap_entry *batch_test_entry(TALLOC_CTX *mem_ctx)
+{
+    static const char *oc_values[] = { "posixAccount", NULL };
+    static const char *uid_values[] = { "tuser1", NULL };
+    static struct mock_ldap_attr attrs[] = {
+        { .name = "objectClass", .values = oc_values },
+        { .name = "uid", .values = uid_values },
+        { NULL, NULL }
+    };
+    struct mock_ldap_entry *entry;
+
+    entry = talloc_zero(mem_ctx, struct mock_ldap_entry);
+    assert_non_null(entry);
+
+    entry->dn = "uid=tuser1,dc=example,dc=com";
+    entry->attrs = attrs;
+
+    return entry;
+}
+
+/* Creates the batched search request the way
+ * sdap_get_and_parse_generic_batch_send() does, with a fake LDAP search
+ * as its subrequest. Entries are fed with
+ * sdap_get_and_parse_generic_parse_entry() and the search is finished by
+ * finishing the subrequest. */
+static struct tevent_req *
+batch_test_search(TALLOC_CTX *mem_ctx,
+                  struct sdap_options *opts,
+                  size_t batch_size,
+                  struct batch_test_ctx *bctx,
+                  struct tevent_req **_ldap_req)
+{
+    struct tevent_req *req;
+    struct tevent_req *ldap_req;
+    struct sdap_get_and_parse_generic_state *state;
+    struct sdap_get_generic_ext_state *ldap_state;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_get_and_parse_generic_state);
+    assert_non_null(req);
+
+    state->map = opts->user_map;
+    state->map_num_attrs = SDAP_OPTS_USER;
+    state->opts = opts;
+    state->batch_size = batch_size;
+    state->batch_fn = test_batch_store;
+    state->batch_pvt = bctx;
+
+    ldap_req = tevent_req_create(req, &ldap_state,
+                                 struct sdap_get_generic_ext_state);
+    assert_non_null(ldap_req);
+    tevent_req_set_callback(ldap_req, sdap_get_and_parse_generic_batch_done,
+                            req);
+
+    *_ldap_req = ldap_req;
+    return req;
+}
+
+static errno_t batch_test_read_entry(struct parse_test_ctx *test_ctx,
+                                     struct tevent_req *req)
+{
+    struct sdap_get_and_parse_generic_state *state;
+
+    state = tevent_req_data(req, struct sdap_get_and_parse_generic_state);
+
+    return sdap_get_and_parse_generic_parse_entry(&test_ctx->sh,
+                                                  &test_ctx->sm,
+                                                  state);
+}
+
+static void test_sdap_batch_search_flush(void **state)
+{
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct batch_test_ctx bctx = { 0 };
+    struct sdap_get_and_parse_generic_state *search_state;
+    struct mock_ldap_entry *entry;
+    struct sdap_options *opts;
+    struct tevent_req *req;
+    struct tevent_req *ldap_req;
+    size_t total;
+    size_t i;
+    errno_t ret;
+
+    opts = mock_sdap_opts(test_ctx);
+    entry = batch_test_entry(test_ctx);
+    set_entry_parse(entry);
+
+    req = batch_test_search(test_ctx, opts, 3, &bctx, &ldap_req);
+    search_state = tevent_req_data(req, struct sdap_get_and_parse_generic_state);
+
+    for (i = 1; i <= 7; i++) {
+        ret = batch_test_read_entry(test_ctx, req);
+        assert_int_equal(ret, EOK);
+
+        /* A full batch is handed over and released at once */
+        assert_int_equal(bctx.num_batches, i / 3);
+        assert_int_equal(search_state->sreply.reply_count, i % 3);
+        if (i % 3 == 0) {
+            assert_null(search_state->sreply.reply);
+        }
+    }
+
+    /* The rest is handed over when the search finishes */
+    tevent_req_done(ldap_req);
+    assert_int_equal(bctx.num_batches, 3);
+    assert_int_equal(bctx.sizes[0], 3);
+    assert_int_equal(bctx.sizes[1], 3);
+    assert_int_equal(bctx.sizes[2], 1);
+
+    ret = sdap_get_and_parse_generic_batch_recv(req, &total);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(total, 7);
+
+    talloc_free(req);
+    talloc_free(entry);
+    talloc_free(opts);
+}
+
+static void test_sdap_batch_search_no_partial(void **state)
+{
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct batch_test_ctx bctx = { 0 };
+    struct mock_ldap_entry *entry;
+    struct sdap_options *opts;
+    struct tevent_req *req;
+    struct tevent_req *ldap_req;
+    size_t total;
+    size_t i;
+    errno_t ret;
+
+    opts = mock_sdap_opts(test_ctx);
+    entry = batch_test_entry(test_ctx);
+    set_entry_parse(entry);
+
+    req = batch_test_search(test_ctx, opts, 3, &bctx, &ldap_req);
+    for (i = 0; i < 6; i++) {
+        ret = batch_test_read_entry(test_ctx, req);
+        assert_int_equal(ret, EOK);
+    }
+
+    /* No empty batch is handed over at the end */
+    tevent_req_done(ldap_req);
+    assert_int_equal(bctx.num_batches, 2);
+
+    ret = sdap_get_and_parse_generic_batch_recv(req, &total);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(total, 6);
+    talloc_free(req);
+
+    /* An empty result does not call the batch callback at all */
+    memset(&bctx, 0, sizeof(bctx));
+    req = batch_test_search(test_ctx, opts, 3, &bctx, &ldap_req);
+    tevent_req_done(ldap_req);
+    assert_int_equal(bctx.num_batches, 0);
+
+    ret = sdap_get_and_parse_generic_batch_recv(req, &total);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(total, 0);
+
+    talloc_free(req);
+    talloc_free(entry);
+    talloc_free(opts);
+}
+
+static void test_sdap_batch_search_store_error(void **state)
+{
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct batch_test_ctx bctx = { 0 };
+    struct mock_ldap_entry *entry;
+    struct sdap_options *opts;
+    struct tevent_req *req;
+    struct tevent_req *ldap_req;
+    size_t total;
+    size_t i;
+    errno_t ret;
+
+    opts = mock_sdap_opts(test_ctx);
+    entry = batch_test_entry(test_ctx);
+    set_entry_parse(entry);
+
+    /* The second batch fails to be stored in the middle of the search */
+    bctx.fail_batch = 2;
+    req = batch_test_search(test_ctx, opts, 2, &bctx, &ldap_req);
+    for (i = 0; i < 3; i++) {
+        ret = batch_test_read_entry(test_ctx, req);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = batch_test_read_entry(test_ctx, req);
+    assert_int_equal(ret, EIO);
+    assert_int_equal(bctx.num_batches, 2);
+
+    /* The LDAP search is aborted with the error of the parse callback,
+     * the rest of the entries is not stored */
+    tevent_req_error(ldap_req, ret);
+    assert_int_equal(bctx.num_batches, 2);
+
+    ret = sdap_get_and_parse_generic_batch_recv(req, &total);
+    assert_int_equal(ret, EIO);
+    talloc_free(req);
+
+    /* Failure to store the final partial batch fails the search as well */
+    memset(&bctx, 0, sizeof(bctx));
+    bctx.fail_batch = 2;
+    req = batch_test_search(test_ctx, opts, 2, &bctx, &ldap_req);
+    for (i = 0; i < 3; i++) {
+        ret = batch_test_read_entry(test_ctx, req);
+        assert_int_equal(ret, EOK);
+    }
+
+    tevent_req_done(ldap_req);
+    assert_int_equal(bctx.num_batches, 2);
+    assert_int_equal(bctx.sizes[1], 1);
+
+    ret = sdap_get_and_parse_generic_batch_recv(req, &total);
+    assert_int_equal(ret, EIO);
+
+    talloc_free(req);
+    talloc_free(entry);
+    talloc_free(opts);
+}
+
+static void test_sdap_page_size_adjust_fixed(void **state)
+{
+    /* No adjustment if the limits are equal */
+    assert_int_equal(sdap_page_size_adjust(1000, 1000, 1000, 1000, 10), 1000);
+    assert_int_equal(sdap_page_size_adjust(1000, 1000, 1000, 10, 60000), 1000);
+}
+
+static void test_sdap_page_size_adjust_grow(void **state)
+{
+    /* Full fast pages double the size up to the maximum */
+    assert_int_equal(sdap_page_size_adjust(1000, 100, 5000, 1000, 10), 2000);
+    assert_int_equal(sdap_page_size_adjust(4000, 100, 5000, 4000, 10), 5000);
+
+    /* Pages that are not full or take longer do not */
+    assert_int_equal(sdap_page_size_adjust(1000, 100, 5000, 999, 10), 1000);
+    assert_int_equal(sdap_page_size_adjust(1000, 100, 5000, 1000,
+                                           SDAP_PAGE_TARGET_MSEC / 2), 1000);
+}
+
+static void test_sdap_page_size_adjust_shrink(void **state)
+{
+    /* Slow pages shrink in proportion to the time they took */
+    assert_int_equal(sdap_page_size_adjust(1000, 100, 5000, 1000,
+                                           SDAP_PAGE_TARGET_MSEC * 2), 500);
+
+    /* ... but at most to a quarter at once and not below the minimum */
+    assert_int_equal(sdap_page_size_adjust(1000, 100, 5000, 1000,
+                                           SDAP_PAGE_TARGET_MSEC * 100), 250);
+    assert_int_equal(sdap_page_size_adjust(200, 100, 5000, 200,
+                                           SDAP_PAGE_TARGET_MSEC * 100), 100);
+}
+
+/* Paged search tests, the libldap calls of the search are wrapped and the
+ * LDAP handle is never dereferenced */
+static int paged_test_ldap;
+
+int get_fd_from_ldap(LDAP *ldap, int *fd)
+{
+    return EIO;
+}
+
+int __wrap_ldap_msgtype(LDAPMessage *lm)
+{
+    return sss_mock_type(int);
+}
+
+int __wrap_ldap_create_page_control(LDAP *ld,
+                                    ber_int_t pagesize,
+                                    struct berval *cookie,
+                                    int iscritical,
+                                    LDAPControl **ctrlp)
+{
+    bool has_cookie = (cookie != NULL);
+
+    check_expected(pagesize);
+    check_expected(has_cookie);
+
+    return ldap_control_create(LDAP_CONTROL_PAGEDRESULTS, iscritical,
+                               NULL, 0, ctrlp);
+}
+
+int __wrap_ldap_search_ext(LDAP *ld,
+                           LDAP_CONST char *base,
+                           int scope,
+                           LDAP_CONST char *filter,
+                           char **attrs,
+                           int attrsonly,
+                           LDAPControl **serverctrls,
+                           LDAPControl **clientctrls,
+                           struct timeval *timeout,
+                           int sizelimit,
+                           int *msgidp)
+{
+    static int msgid;
+
+    *msgidp = ++msgid;
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_parse_result(LDAP *ld,
+                             LDAPMessage *res,
+                             int *errcodep,
+                             char **matcheddnp,
+                             char **errmsgp,
+                             char ***referralsp,
+                             LDAPControl ***serverctrls,
+                             int freeit)
+{
+    LDAPControl **ctrls;
+    int ret;
+
+    ctrls = ber_memcalloc(2, sizeof(LDAPControl *));
+    assert_non_null(ctrls);
+    ret = ldap_control_create(LDAP_CONTROL_PAGEDRESULTS, 0, NULL, 0,
+                              &ctrls[0]);
+    assert_int_equal(ret, LDAP_SUCCESS);
+
+    *errcodep = LDAP_SUCCESS;
+    *errmsgp = NULL;
+    *referralsp = NULL;
+    *serverctrls = ctrls;
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_parse_pageresponse_control(LDAP *ld,
+                                           LDAPControl *ctrl,
+                                           ber_int_t *countp,
+                                           struct berval *cookie)
+{
+    const char *value = sss_mock_ptr_type(const char *);
+
+    *countp = 0;
+    cookie->bv_val = value != NULL ? ber_strdup(value) : NULL;
+    cookie->bv_len = value != NULL ? strlen(value) : 0;
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_abandon_ext(LDAP *ld,
+                            int msgid,
+                            LDAPControl **serverctrls,
+                            LDAPControl **clientctrls)
+{
+    return LDAP_SUCCESS;
+}
+
+static errno_t paged_test_parse(struct sdap_handle *sh,
+                                struct sdap_msg *msg,
+                                void *pvt)
+{
+    int *entries = (int *) pvt;
+
+    (*entries)++;
+    return EOK;
+}
+
+/* Stores the entries slowly like the streaming callback of
+ * sdap_get_and_parse_generic_send() does with large batches */
+static errno_t paged_test_parse_slow(struct sdap_handle *sh,
+                                     struct sdap_msg *msg,
+                                     void *pvt)
+{
+    struct timespec delay = { 0, 20 * 1000 * 1000 };
+    int *entries = (int *) pvt;
+
+    nanosleep(&delay, NULL);
+    (*entries)++;
+    return EOK;
+}
+
+/* Returns a page of @num entries that took @msecs to the search, followed
+ * by the search result with @cookie, NULL for the last page */
+static void paged_test_page(struct tevent_req *req,
+                            struct sdap_msg *msg,
+                            int num,
+                            int64_t msecs,
+                            const char *cookie)
+{
+    struct sdap_get_generic_ext_state *state;
+    int i;
+
+    state = tevent_req_data(req, struct sdap_get_generic_ext_state);
+
+    for (i = 0; i < num; i++) {
+        will_return(__wrap_ldap_msgtype, LDAP_RES_SEARCH_ENTRY);
+        sdap_get_generic_op_finished(state->op, msg, EOK, req);
+    }
+
+    state->page_start.tv_sec -= msecs / 1000;
+
+    will_return(__wrap_ldap_msgtype, LDAP_RES_SEARCH_RESULT);
+    will_return(__wrap_ldap_parse_pageresponse_control, cookie);
+    sdap_get_generic_op_finished(state->op, msg, EOK, req);
+}
+
+static void paged_test_expect_page(ber_int_t page_size, bool has_cookie)
+{
+    expect_value(__wrap_ldap_create_page_control, pagesize, page_size);
+    expect_value(__wrap_ldap_create_page_control, has_cookie, has_cookie);
+}
+
+static void test_sdap_paged_search_page_size(void **state)
+{
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    const char *controls[] = { LDAP_CONTROL_PAGEDRESULTS, NULL };
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct tevent_req *req;
+    size_t ref_count;
+    char **refs;
+    int entries = 0;
+    errno_t ret;
+
+    ev = tevent_context_init(test_ctx);
+    assert_non_null(ev);
+    opts = mock_sdap_opts(test_ctx);
+
+    test_ctx->sh.ldap = (LDAP *) &paged_test_ldap;
+    test_ctx->sh.supported_controls.num_vals = 1;
+    test_ctx->sh.supported_controls.vals = discard_const(controls);
+    test_ctx->sh.page_size = 100;
+    test_ctx->sh.page_size_min = 50;
+    test_ctx->sh.page_size_max = 400;
+
+    paged_test_expect_page(100, false);
+    req = sdap_get_generic_ext_send(test_ctx, ev, opts, &test_ctx->sh,
+                                    "dc=example,dc=com", LDAP_SCOPE_SUBTREE,
+                                    "(objectClass=*)", NULL, NULL, NULL,
+                                    0, 0, paged_test_parse, &entries,
+                                    SDAP_SRCH_FLG_PAGING);
+    assert_non_null(req);
+    assert_true(tevent_req_is_in_progress(req));
+
+    /* A full page returned quickly doubles the next one */
+    paged_test_expect_page(200, true);
+    paged_test_page(req, &test_ctx->sm, 100, 0, "page2");
+    assert_int_equal(test_ctx->sh.page_size, 200);
+
+    /* A page that is not full does not change it */
+    paged_test_expect_page(200, true);
+    paged_test_page(req, &test_ctx->sm, 150, 0, "page3");
+    assert_int_equal(test_ctx->sh.page_size, 200);
+
+    /* A slow page shrinks the next one in proportion to the time it took */
+    paged_test_expect_page(100, true);
+    paged_test_page(req, &test_ctx->sm, 200,
+                    SDAP_PAGE_TARGET_MSEC * 2, "page4");
+    assert_int_equal(test_ctx->sh.page_size, 100);
+
+    /* ... but not below the minimum */
+    paged_test_expect_page(50, true);
+    paged_test_page(req, &test_ctx->sm, 100,
+                    SDAP_PAGE_TARGET_MSEC * 100, "page5");
+    assert_int_equal(test_ctx->sh.page_size, 50);
+
+    /* The last page finishes the search without another adjustment */
+    paged_test_page(req, &test_ctx->sm, 10,
+                    SDAP_PAGE_TARGET_MSEC * 100, NULL);
+    assert_false(tevent_req_is_in_progress(req));
+    assert_int_equal(test_ctx->sh.page_size, 50);
+    assert_int_equal(entries, 560);
+
+    ret = sdap_get_generic_ext_recv(req, test_ctx, &ref_count, &refs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(ref_count, 0);
+
+    talloc_free(req);
+    talloc_free(opts);
+    talloc_free(ev);
+}
+
+static void test_sdap_paged_search_slow_parse(void **state)
+{
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    const char *controls[] = { LDAP_CONTROL_PAGEDRESULTS, NULL };
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct tevent_req *req;
+    int entries = 0;
+    errno_t ret;
+
+    ev = tevent_context_init(test_ctx);
+    assert_non_null(ev);
+    opts = mock_sdap_opts(test_ctx);
+
+    test_ctx->sh.ldap = (LDAP *) &paged_test_ldap;
+    test_ctx->sh.supported_controls.num_vals = 1;
+    test_ctx->sh.supported_controls.vals = discard_const(controls);
+    test_ctx->sh.page_size = 20;
+    test_ctx->sh.page_size_min = 10;
+    test_ctx->sh.page_size_max = 400;
+
+    paged_test_expect_page(20, false);
+    req = sdap_get_generic_ext_send(test_ctx, ev, opts, &test_ctx->sh,
+                                    "dc=example,dc=com", LDAP_SCOPE_SUBTREE,
+                                    "(objectClass=*)", NULL, NULL, NULL,
+                                    0, 0, paged_test_parse_slow, &entries,
+                                    SDAP_SRCH_FLG_PAGING);
+    assert_non_null(req);
+
+    /* The 400 ms spent storing the entries is not the server being slow,
+     * the full page still doubles the next one */
+    paged_test_expect_page(40, true);
+    paged_test_page(req, &test_ctx->sm, 20, 0, "page2");
+    assert_int_equal(test_ctx->sh.page_size, 40);
+
+    paged_test_page(req, &test_ctx->sm, 1, 0, NULL);
+    assert_false(tevent_req_is_in_progress(req));
+    assert_int_equal(entries, 21);
+
+    ret = sdap_get_generic_ext_recv(req, test_ctx, NULL, NULL);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(req);
+    talloc_free(opts);
+    talloc_free(ev);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -1302,6 +1863,28 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sdap_get_primary_name,
                                         parse_entry_test_setup,
                                         parse_entry_test_teardown),
+
+        /* Batched search tests */
+        cmocka_unit_test_setup_teardown(test_sdap_batch_search_flush,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_sdap_batch_search_no_partial,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_sdap_batch_search_store_error,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
+
+        /* Page size adjustment tests */
+        cmocka_unit_test(test_sdap_page_size_adjust_fixed),
+        cmocka_unit_test(test_sdap_page_size_adjust_grow),
+        cmocka_unit_test(test_sdap_page_size_adjust_shrink),
+        cmocka_unit_test_setup_teardown(test_sdap_paged_search_page_size,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_sdap_paged_search_slow_parse,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -0,0 +1,685 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: Test the persistent ldap_child
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_child_tgt_cache.h"
+
+/* SSSD_LIBEXEC_PATH points to a test directory, LDAP_CHILD is a script
+ * written by the tests */
+#include "providers/ldap/sdap_child_helpers.c"
+
+#define TEST_REALM "TEST.REALM"
+#define TEST_PRINC "host/client.test.realm"
+#define TEST_KEYTAB "/etc/test.keytab"
+#define TEST_LIFETIME 86400
+#define TEST_CCNAME "FILE:/var/lib/sss/db/ccache_TEST.REALM"
+#define TEST_TIMEOUT 5
+
+/* ==The-ticket-cache-of-ldap_child=======================================*/
+
+static uint8_t *test_tgt_response(TALLOC_CTX *mem_ctx, uint32_t result,
+                                  time_t expire_time, size_t *_len)
+{
+    krb5_error_code kerr = 0;
+    uint8_t *buf;
+    size_t len;
+    size_t p = 0;
+
+    /* See pack_buffer() in ldap_child.c */
+    len = 2 * sizeof(uint32_t) + sizeof(krb5_error_code)
+              + strlen(TEST_CCNAME) + sizeof(time_t);
+    buf = talloc_size(mem_ctx, len);
+    assert_non_null(buf);
+
+    SAFEALIGN_SET_UINT32(&buf[p], result, &p);
+    safealign_memcpy(&buf[p], &kerr, sizeof(krb5_error_code), &p);
+    SAFEALIGN_SET_UINT32(&buf[p], strlen(TEST_CCNAME), &p);
+    safealign_memcpy(&buf[p], TEST_CCNAME, strlen(TEST_CCNAME), &p);
+    safealign_memcpy(&buf[p], &expire_time, sizeof(time_t), &p);
+    assert_int_equal(p, len);
+
+    *_len = len;
+    return buf;
+}
+
+static uint8_t *test_tgt_request(TALLOC_CTX *mem_ctx, const char *princ,
+                                 size_t *_len)
+{
+    struct io_buffer *buf;
+    errno_t ret;
+
+    ret = create_child_req_send_buffer(mem_ctx, LDAP_CHILD_GET_TGT,
+                                       TEST_REALM, princ, TEST_KEYTAB,
+                                       TEST_LIFETIME, false, &buf);
+    assert_int_equal(ret, EOK);
+
+    *_len = buf->size;
+    return buf->data;
+}
+
+static void test_lc_tgt_cache_update(void **state)
+{
+    struct lc_tgt_cache *cache;
+    struct lc_tgt *tgt;
+    uint8_t *req;
+    uint8_t *other_req;
+    uint8_t *resp;
+    size_t req_len;
+    size_t other_req_len;
+    size_t resp_len;
+    time_t now;
+    int timeout;
+
+    cache = talloc_zero(NULL, struct lc_tgt_cache);
+    assert_non_null(cache);
+
+    assert_int_equal(lc_tgt_renew_timeout(cache), -1);
+
+    req = test_tgt_request(cache, TEST_PRINC, &req_len);
+    other_req = test_tgt_request(cache, "host/other.test.realm",
+                                 &other_req_len);
+
+    now = time(NULL);
+    resp = test_tgt_response(cache, EOK, now + 1000, &resp_len);
+    lc_tgt_update(cache, req, req_len, resp, resp_len);
+
+    tgt = lc_tgt_find(cache, req, req_len);
+    assert_non_null(tgt);
+    assert_int_equal(tgt->resp_len, resp_len);
+    assert_memory_equal(tgt->resp, resp, resp_len);
+    assert_int_equal(tgt->expire_time, now + 1000);
+    /* The renewal is due after 80% of the remaining lifetime */
+    assert_true(tgt->renew_time >= now + 800);
+    assert_true(tgt->renew_time <= now + 801);
+
+    timeout = lc_tgt_renew_timeout(cache);
+    assert_true(timeout > 790 * 1000);
+    assert_true(timeout <= 801 * 1000);
+
+    /* Only the same request is answered from the cache */
+    assert_null(lc_tgt_find(cache, other_req, other_req_len));
+
+    /* A renewal replaces the reply instead of adding another entry */
+    resp = test_tgt_response(cache, EOK, now + 2000, &resp_len);
+    lc_tgt_update(cache, req, req_len, resp, resp_len);
+    assert_ptr_equal(lc_tgt_find(cache, req, req_len), tgt);
+    assert_null(tgt->next);
+    assert_int_equal(tgt->expire_time, now + 2000);
+
+    /* A renewal which is due is reported right away */
+    tgt->renew_time = now - 1;
+    assert_int_equal(lc_tgt_renew_timeout(cache), 0);
+
+    talloc_free(cache);
+}
+
+static void test_lc_tgt_cache_failure(void **state)
+{
+    struct lc_tgt_cache *cache;
+    struct lc_tgt *tgt;
+    uint8_t *req;
+    uint8_t *resp;
+    uint8_t *failed;
+    uint8_t *expired;
+    size_t req_len;
+    size_t resp_len;
+    size_t failed_len;
+    size_t expired_len;
+    time_t now;
+
+    cache = talloc_zero(NULL, struct lc_tgt_cache);
+    assert_non_null(cache);
+
+    now = time(NULL);
+    req = test_tgt_request(cache, TEST_PRINC, &req_len);
+    resp = test_tgt_response(cache, EOK, now + 1000, &resp_len);
+    failed = test_tgt_response(cache, EIO, now + 1000, &failed_len);
+    expired = test_tgt_response(cache, EOK, now - 1, &expired_len);
+
+    /* Failed requests are not remembered */
+    lc_tgt_update(cache, req, req_len, failed, failed_len);
+    assert_null(cache->tgts);
+    lc_tgt_update(cache, req, req_len, expired, expired_len);
+    assert_null(cache->tgts);
+    lc_tgt_update(cache, req, req_len, NULL, 0);
+    assert_null(cache->tgts);
+    lc_tgt_update(cache, req, req_len, resp, sizeof(uint32_t));
+    assert_null(cache->tgts);
+
+    lc_tgt_update(cache, req, req_len, resp, resp_len);
+    tgt = lc_tgt_find(cache, req, req_len);
+    assert_non_null(tgt);
+
+    /* A failed renewal keeps the valid ticket and retries later */
+    lc_tgt_update(cache, req, req_len, failed, failed_len);
+    assert_ptr_equal(lc_tgt_find(cache, req, req_len), tgt);
+    assert_memory_equal(tgt->resp, resp, resp_len);
+    assert_true(tgt->renew_time >= now + LC_RENEW_RETRY_TIME);
+    assert_true(tgt->renew_time <= now + LC_RENEW_RETRY_TIME + 1);
+
+    /* A ticket which expires before the retry is dropped */
+    tgt->expire_time = now + LC_RENEW_RETRY_TIME / 2;
+    lc_tgt_update(cache, req, req_len, NULL, 0);
+    assert_null(lc_tgt_find(cache, req, req_len));
+    assert_int_equal(lc_tgt_renew_timeout(cache), -1);
+
+    talloc_free(cache);
+}
+
+/* ==The-persistent-ldap_child-of-the-backend=============================*/
+
+#define TEST_MAX_PIDS 4
+
+struct sdap_child_test_ctx {
+    struct tevent_context *ev;
+    struct sdap_persistent_child *pc;
+
+    /* ldap_child's ends of the pipes of a child started by the test */
+    int requests_fd;
+    int replies_fd;
+
+    pid_t pids[TEST_MAX_PIDS];
+    size_t num_pids;
+};
+
+static int setup_sdap_child(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_zero(NULL, struct sdap_child_test_ctx);
+    assert_non_null(test_ctx);
+    test_ctx->requests_fd = -1;
+    test_ctx->replies_fd = -1;
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    ret = sdap_persistent_child_get(test_ctx->ev, &test_ctx->pc);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(persistent_child, test_ctx->pc);
+
+    ret = mkdir(SSSD_LIBEXEC_PATH, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int teardown_sdap_child(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    size_t i;
+
+    if (test_ctx->pc->child != NULL) {
+        test_ctx->pids[test_ctx->num_pids++] = test_ctx->pc->child->pid;
+    }
+
+    for (i = 0; i < test_ctx->num_pids; i++) {
+        kill(test_ctx->pids[i], SIGKILL);
+        waitpid(test_ctx->pids[i], NULL, 0);
+    }
+
+    if (test_ctx->requests_fd != -1) {
+        close(test_ctx->requests_fd);
+    }
+    if (test_ctx->replies_fd != -1) {
+        close(test_ctx->replies_fd);
+    }
+
+    talloc_free(test_ctx);
+    assert_null(persistent_child);
+
+    unlink(LDAP_CHILD);
+    rmdir(SSSD_LIBEXEC_PATH);
+    return 0;
+}
+
+/* Install a child which only waits to be killed, the test plays the
+ * ldap_child side of its pipes */
+static struct sdap_child *test_child_add(struct sdap_child_test_ctx *test_ctx)
+{
+    int to_child[2] = PIPE_INIT;
+    int from_child[2] = PIPE_INIT;
+    struct sdap_child *child;
+    pid_t pid;
+    errno_t ret;
+
+    assert_true(test_ctx->num_pids < TEST_MAX_PIDS);
+    assert_int_equal(test_ctx->requests_fd, -1);
+
+    ret = pipe(to_child);
+    assert_int_equal(ret, 0);
+    ret = pipe(from_child);
+    assert_int_equal(ret, 0);
+
+    pid = fork();
+    assert_int_not_equal(pid, -1);
+    if (pid == 0) {
+        PIPE_CLOSE(to_child);
+        PIPE_CLOSE(from_child);
+        pause();
+        _exit(0);
+    }
+    test_ctx->pids[test_ctx->num_pids++] = pid;
+
+    ret = alloc_child(test_ctx->pc, &child);
+    assert_int_equal(ret, EOK);
+
+    child->pid = pid;
+    child->io->write_to_child_fd = to_child[1];
+    child->io->read_from_child_fd = from_child[0];
+    sss_fd_nonblocking(child->io->write_to_child_fd);
+    sss_fd_nonblocking(child->io->read_from_child_fd);
+
+    test_ctx->requests_fd = to_child[0];
+    test_ctx->replies_fd = from_child[1];
+
+    test_ctx->pc->child = child;
+    return child;
+}
+
+static void test_write_reply(struct sdap_child_test_ctx *test_ctx,
+                             uint32_t result, time_t expire_time)
+{
+    uint8_t *resp;
+    size_t resp_len;
+    ssize_t len;
+
+    resp = test_tgt_response(test_ctx, result, expire_time, &resp_len);
+
+    len = sss_atomic_write_safe_s(test_ctx->replies_fd, resp, resp_len);
+    assert_int_equal(len, resp_len);
+
+    talloc_free(resp);
+}
+
+static bool test_request_pending(struct sdap_child_test_ctx *test_ctx)
+{
+    struct pollfd pfd;
+
+    pfd.fd = test_ctx->requests_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static void test_read_request(struct sdap_child_test_ctx *test_ctx,
+                              const char *princ)
+{
+    uint8_t buf[IN_BUF_SIZE];
+    uint8_t *req;
+    size_t req_len;
+    ssize_t len;
+
+    assert_true(test_request_pending(test_ctx));
+
+    len = sss_atomic_read_safe_s(test_ctx->requests_fd, buf, sizeof(buf),
+                                 NULL);
+    req = test_tgt_request(test_ctx, princ, &req_len);
+    assert_int_equal(len, req_len);
+    assert_memory_equal(buf, req, req_len);
+    talloc_free(req);
+}
+
+static struct tevent_req *test_get_tgt_send(struct sdap_child_test_ctx *test_ctx,
+                                            const char *princ,
+                                            int timeout)
+{
+    struct tevent_req *req;
+
+    req = sdap_get_tgt_send(test_ctx, test_ctx->ev, TEST_REALM, princ,
+                            TEST_KEYTAB, TEST_LIFETIME, false, true, timeout);
+    assert_non_null(req);
+
+    return req;
+}
+
+static errno_t test_get_tgt_recv(struct sdap_child_test_ctx *test_ctx,
+                                 struct tevent_req *req,
+                                 time_t *_expire_time)
+{
+    krb5_error_code kerr;
+    time_t expire_time;
+    char *ccname;
+    int result;
+    bool ok;
+    errno_t ret;
+
+    ok = tevent_req_poll(req, test_ctx->ev);
+    assert_true(ok);
+
+    ret = sdap_get_tgt_recv(req, test_ctx, &result, &kerr, &ccname,
+                            &expire_time);
+    talloc_free(req);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    assert_int_equal(result, EOK);
+    assert_int_equal(kerr, 0);
+    assert_string_equal(ccname, TEST_CCNAME);
+    talloc_free(ccname);
+
+    if (_expire_time != NULL) {
+        *_expire_time = expire_time;
+    }
+    return EOK;
+}
+
+static void test_assert_killed(pid_t pid)
+{
+    pid_t wpid;
+    int status;
+
+    do {
+        wpid = waitpid(pid, &status, 0);
+    } while (wpid == -1 && errno == EINTR);
+
+    assert_int_equal(wpid, pid);
+    assert_true(WIFSIGNALED(status));
+    assert_int_equal(WTERMSIG(status), SIGKILL);
+}
+
+static void test_sdap_child_reply(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct sdap_child *child;
+    struct tevent_req *req;
+    time_t expire_time;
+    time_t now;
+    errno_t ret;
+
+    child = test_child_add(test_ctx);
+    now = time(NULL);
+
+    test_write_reply(test_ctx, EOK, now + 1000);
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, &expire_time);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(expire_time, now + 1000);
+    test_read_request(test_ctx, TEST_PRINC);
+
+    /* The child and its pipes are kept for the next request */
+    assert_ptr_equal(test_ctx->pc->child, child);
+    assert_false(child->io->in_use);
+    assert_int_not_equal(child->io->write_to_child_fd, -1);
+    assert_int_not_equal(child->io->read_from_child_fd, -1);
+
+    test_write_reply(test_ctx, EOK, now + 2000);
+    req = test_get_tgt_send(test_ctx, "host/other.test.realm", TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, &expire_time);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(expire_time, now + 2000);
+    test_read_request(test_ctx, "host/other.test.realm");
+
+    assert_ptr_equal(test_ctx->pc->child, child);
+    assert_false(test_request_pending(test_ctx));
+}
+
+static void test_sdap_child_empty_reply(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct sdap_child *child;
+    struct tevent_req *req;
+    ssize_t len;
+    errno_t ret;
+
+    child = test_child_add(test_ctx);
+
+    /* ldap_child could not handle the request but the pipes are in sync,
+     * the child is kept */
+    len = sss_atomic_write_safe_s(test_ctx->replies_fd, NULL, 0);
+    assert_int_equal(len, 0);
+
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, NULL);
+    assert_int_equal(ret, EIO);
+    test_read_request(test_ctx, TEST_PRINC);
+
+    assert_ptr_equal(test_ctx->pc->child, child);
+    assert_false(child->io->in_use);
+    assert_int_equal(waitpid(child->pid, NULL, WNOHANG), 0);
+}
+
+static void test_sdap_child_broken_pipe(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct sdap_child *child;
+    struct tevent_req *req;
+    errno_t ret;
+
+    child = test_child_add(test_ctx);
+
+    /* ldap_child closed its output without replying */
+    close(test_ctx->replies_fd);
+    test_ctx->replies_fd = -1;
+
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, NULL);
+    assert_int_not_equal(ret, EOK);
+
+    /* The child is killed and dropped, the next request starts a new one */
+    assert_null(test_ctx->pc->child);
+    test_assert_killed(child->pid);
+    test_ctx->num_pids--;
+}
+
+static void test_sdap_child_timeout(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct sdap_child *child;
+    struct tevent_req *req;
+    errno_t ret;
+
+    child = test_child_add(test_ctx);
+
+    /* ldap_child never replies */
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, 1);
+    ret = test_get_tgt_recv(test_ctx, req, NULL);
+    assert_int_equal(ret, ETIMEDOUT);
+    test_read_request(test_ctx, TEST_PRINC);
+
+    assert_null(test_ctx->pc->child);
+    test_assert_killed(child->pid);
+    test_ctx->num_pids--;
+}
+
+static void test_sdap_child_queue(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct tevent_req *req1;
+    struct tevent_req *req2;
+    time_t now;
+    bool ok;
+    errno_t ret;
+
+    test_child_add(test_ctx);
+    now = time(NULL);
+
+    req1 = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    req2 = test_get_tgt_send(test_ctx, "host/other.test.realm", TEST_TIMEOUT);
+
+    test_write_reply(test_ctx, EOK, now + 1000);
+    ok = tevent_req_poll(req1, test_ctx->ev);
+    assert_true(ok);
+
+    /* The second request waits until the first one is finished */
+    test_read_request(test_ctx, TEST_PRINC);
+    assert_false(test_request_pending(test_ctx));
+    assert_true(tevent_req_is_in_progress(req2));
+
+    ret = test_get_tgt_recv(test_ctx, req1, NULL);
+    assert_int_equal(ret, EOK);
+
+    test_write_reply(test_ctx, EOK, now + 2000);
+    ret = test_get_tgt_recv(test_ctx, req2, NULL);
+    assert_int_equal(ret, EOK);
+    test_read_request(test_ctx, "host/other.test.realm");
+}
+
+/* Write an LDAP_CHILD which sends a single reply and then waits until its
+ * input is closed */
+static void test_write_ldap_child(struct sdap_child_test_ctx *test_ctx,
+                                  time_t expire_time)
+{
+    uint8_t *resp;
+    size_t resp_len;
+    uint32_t frame_len;
+    char *script;
+    size_t i;
+    FILE *f;
+    int ret;
+
+    resp = test_tgt_response(test_ctx, EOK, expire_time, &resp_len);
+    frame_len = resp_len;
+
+    script = talloc_strdup(test_ctx, "#!/bin/sh\nprintf '");
+    assert_non_null(script);
+    for (i = 0; i < sizeof(uint32_t); i++) {
+        script = talloc_asprintf_append(script, "\\%03o",
+                                        ((uint8_t *) &frame_len)[i]);
+        assert_non_null(script);
+    }
+    for (i = 0; i < resp_len; i++) {
+        script = talloc_asprintf_append(script, "\\%03o", resp[i]);
+        assert_non_null(script);
+    }
+    script = talloc_asprintf_append(script, "'\nexec cat > /dev/null\n");
+    assert_non_null(script);
+
+    f = fopen(LDAP_CHILD, "w");
+    assert_non_null(f);
+    ret = fputs(script, f);
+    assert_true(ret >= 0);
+    ret = fclose(f);
+    assert_int_equal(ret, 0);
+    ret = chmod(LDAP_CHILD, 0755);
+    assert_int_equal(ret, 0);
+
+    talloc_free(script);
+    talloc_free(resp);
+}
+
+static void test_sdap_child_restart(void **state)
+{
+    struct sdap_child_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct sdap_child_test_ctx);
+    struct tevent_req *req;
+    time_t expire_time;
+    pid_t pid;
+    time_t now;
+    errno_t ret;
+
+    now = time(NULL);
+    test_write_ldap_child(test_ctx, now + 1000);
+
+    /* The first request starts the child */
+    assert_null(test_ctx->pc->child);
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, &expire_time);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(expire_time, now + 1000);
+
+    assert_non_null(test_ctx->pc->child);
+    pid = test_ctx->pc->child->pid;
+
+    /* Once the child is gone it is dropped ... */
+    kill(pid, SIGKILL);
+    while (test_ctx->pc->child != NULL) {
+        ret = tevent_loop_once(test_ctx->ev);
+        assert_int_equal(ret, 0);
+    }
+
+    /* ... and the next request starts a new one */
+    req = test_get_tgt_send(test_ctx, TEST_PRINC, TEST_TIMEOUT);
+    ret = test_get_tgt_recv(test_ctx, req, &expire_time);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(expire_time, now + 1000);
+
+    assert_non_null(test_ctx->pc->child);
+    assert_int_not_equal(test_ctx->pc->child->pid, pid);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_lc_tgt_cache_update),
+        cmocka_unit_test(test_lc_tgt_cache_failure),
+        cmocka_unit_test_setup_teardown(test_sdap_child_reply,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+        cmocka_unit_test_setup_teardown(test_sdap_child_empty_reply,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+        cmocka_unit_test_setup_teardown(test_sdap_child_broken_pipe,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+        cmocka_unit_test_setup_teardown(test_sdap_child_timeout,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+        cmocka_unit_test_setup_teardown(test_sdap_child_queue,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+        cmocka_unit_test_setup_teardown(test_sdap_child_restart,
+                                        setup_sdap_child,
+                                        teardown_sdap_child),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <time.h>
 #include <pwd.h>
 
 #include "tests/cmocka/common_mock.h"
@@ -486,6 +487,178 @@ static void test_user_is_from_another_domain(void **state)
     talloc_zfree(users);
 }
 
+#define PARENTS_CACHE_DEPTH 10
+#define PARENTS_CACHE_USERS 1000
+
+static void test_parents_cache_done(struct tevent_req *req)
+{
+    struct sss_test_ctx *tctx;
+
+    tctx = tevent_req_callback_data(req, struct sss_test_ctx);
+
+    test_ev_done(tctx, rfc2307bis_nested_groups_recv(req));
+    talloc_free(req);
+}
+
+static size_t test_parents_cache_initgr(struct test_sdap_initgr_ctx *test_ctx,
+                                        struct sdap_get_initgr_state *state,
+                                        struct sysdb_attrs *direct_group)
+{
+    struct tevent_req *req;
+    struct sysdb_attrs **groups;
+    hash_table_t *group_hash;
+    size_t count;
+    errno_t ret;
+
+    groups = talloc_zero_array(test_ctx, struct sysdb_attrs *, 2);
+    assert_non_null(groups);
+    groups[0] = sysdb_new_attrs(groups);
+    assert_non_null(groups[0]);
+    ret = sysdb_attrs_copy(direct_group, groups[0]);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_hash_create(test_ctx, 0, &group_hash);
+    assert_int_equal(ret, EOK);
+
+    req = rfc2307bis_nested_groups_send(test_ctx, test_ctx->tctx->ev,
+                                        state->opts, state->dom->sysdb,
+                                        state->dom, NULL,
+                                        state->opts->sdom->group_search_bases,
+                                        groups, 1, group_hash, 0);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_parents_cache_done, test_ctx->tctx);
+
+    test_ctx->tctx->done = false;
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    count = hash_count(group_hash);
+    talloc_free(group_hash);
+    talloc_free(groups);
+
+    return count;
+}
+
+static void test_parents_cache(void **state)
+{
+    struct test_sdap_initgr_ctx *test_ctx;
+    struct sdap_get_initgr_state *initgr_state;
+    const char *domains_set[] = { domains[0], NULL };
+    struct sysdb_attrs *chain[PARENTS_CACHE_DEPTH];
+    struct sysdb_attrs **replies[PARENTS_CACHE_DEPTH];
+    struct sysdb_attrs **parents;
+    const char *group_base_dn;
+    struct timespec start;
+    struct timespec end;
+    uint64_t hits;
+    uint64_t misses;
+    size_t count;
+    char *name;
+    errno_t ret;
+    int i;
+
+    test_ctx = talloc_get_type(*state, struct test_sdap_initgr_ctx);
+    assert_non_null(test_ctx);
+
+    initgr_state = prepare_state(test_ctx, domains_set);
+    assert_non_null(initgr_state);
+    assert_non_null(initgr_state->opts->sdom->group_search_bases);
+
+    ret = dp_opt_set_int(initgr_state->opts->basic, SDAP_NESTING_LEVEL,
+                         PARENTS_CACHE_DEPTH);
+    assert_int_equal(ret, EOK);
+
+    group_base_dn = talloc_asprintf(test_ctx, "cn=groups,%s",
+                                    object_bases[0]);
+    assert_non_null(group_base_dn);
+
+    /* group0 is a member of group1, which is a member of group2 ... */
+    for (i = 0; i < PARENTS_CACHE_DEPTH; i++) {
+        name = talloc_asprintf(test_ctx, "group%d", i);
+        assert_non_null(name);
+        chain[i] = mock_sysdb_group_rfc2307bis(test_ctx, group_base_dn,
+                                               1000 + i, name, NULL);
+        assert_non_null(chain[i]);
+    }
+
+    /* the cache is disabled by default */
+    assert_int_equal(dp_opt_get_int(initgr_state->opts->basic,
+                                    SDAP_PARENTS_CACHE_TIMEOUT), 0);
+    ret = sdap_parents_cache_lookup(test_ctx, initgr_state->opts, chain[0],
+                                    &parents, &count);
+    assert_int_equal(ret, ENOENT);
+
+    ret = dp_opt_set_int(initgr_state->opts->basic, SDAP_PARENTS_CACHE_TIMEOUT,
+                         60);
+    assert_int_equal(ret, EOK);
+
+    /* only the first initgroups needs to search for the parents */
+    for (i = 0; i < PARENTS_CACHE_DEPTH; i++) {
+        replies[i] = talloc_zero_array(test_ctx, struct sysdb_attrs *, 2);
+        assert_non_null(replies[i]);
+
+        if (i + 1 < PARENTS_CACHE_DEPTH) {
+            replies[i][0] = sysdb_new_attrs(replies[i]);
+            assert_non_null(replies[i][0]);
+            ret = sysdb_attrs_copy(chain[i + 1], replies[i][0]);
+            assert_int_equal(ret, EOK);
+        }
+
+        will_return(sdap_get_generic_recv, i + 1 < PARENTS_CACHE_DEPTH);
+        will_return(sdap_get_generic_recv, replies[i]);
+        will_return(sdap_get_generic_recv, ERR_OK);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < PARENTS_CACHE_USERS; i++) {
+        count = test_parents_cache_initgr(test_ctx, initgr_state, chain[0]);
+        assert_int_equal(count, PARENTS_CACHE_DEPTH);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    sdap_parents_cache_get_stats(initgr_state->opts, &hits, &misses);
+    assert_int_equal(misses, PARENTS_CACHE_DEPTH);
+    assert_int_equal(hits, (PARENTS_CACHE_USERS - 1) * PARENTS_CACHE_DEPTH);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "%d initgroups with %d nested groups: %ld ms\n",
+          PARENTS_CACHE_USERS, PARENTS_CACHE_DEPTH,
+          (long)(end.tv_sec - start.tv_sec) * 1000
+              + (end.tv_nsec - start.tv_nsec) / 1000000);
+
+    /* a modified group is looked up again, its parents are still cached */
+    ret = sysdb_attrs_add_string(chain[0], SYSDB_ORIG_MODSTAMP,
+                                 "20260101000000Z");
+    assert_int_equal(ret, EOK);
+
+    replies[0][0] = sysdb_new_attrs(replies[0]);
+    assert_non_null(replies[0][0]);
+    ret = sysdb_attrs_copy(chain[1], replies[0][0]);
+    assert_int_equal(ret, EOK);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, replies[0]);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    count = test_parents_cache_initgr(test_ctx, initgr_state, chain[0]);
+    assert_int_equal(count, PARENTS_CACHE_DEPTH);
+
+    sdap_parents_cache_get_stats(initgr_state->opts, &hits, &misses);
+    assert_int_equal(misses, PARENTS_CACHE_DEPTH + 1);
+    assert_int_equal(hits, PARENTS_CACHE_USERS * PARENTS_CACHE_DEPTH - 1);
+
+    /* flushing the cache forgets everything */
+    sdap_parents_cache_flush(initgr_state->opts);
+    ret = sdap_parents_cache_lookup(test_ctx, initgr_state->opts, chain[1],
+                                    &parents, &count);
+    assert_int_equal(ret, ENOENT);
+
+    for (i = 0; i < PARENTS_CACHE_DEPTH; i++) {
+        talloc_free(replies[i]);
+        talloc_free(chain[i]);
+    }
+    talloc_free(discard_const(group_base_dn));
+    talloc_zfree(initgr_state);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -507,6 +680,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_user_is_from_another_domain,
                                         test_sdap_initgr_setup_other_multi_domains,
                                         test_sdap_initgr_teardown),
+        cmocka_unit_test_setup_teardown(test_parents_cache,
+                                        test_sdap_initgr_setup_one_domain,
+                                        test_sdap_initgr_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -0,0 +1,921 @@
+/*
+    SSSD
+
+    Unit tests - refresh of expired entries with a USN delta search
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "providers/be_ptask_private.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* Including private source file to test static functions */
+#include "providers/ldap/sdap_refresh.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "tests_conf.ldb"
+#define TEST_DOM_NAME "sdap_refresh_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_TIMEOUT 300
+#define TEST_FULL_INTERVAL 3600
+
+#define TEST_USER1_NAME "refresh_user1"
+#define TEST_USER1_DN "uid=refresh_user1,ou=users,dc=example,dc=com"
+#define TEST_USER2_NAME "refresh_user2"
+#define TEST_USER2_DN "uid=refresh_user2,ou=users,dc=example,dc=com"
+#define TEST_USER3_NAME "refresh_user3"
+#define TEST_USER3_DN "uid=refresh_user3,ou=users,dc=example,dc=com"
+#define TEST_GROUP_NAME "refresh_group"
+#define TEST_GROUP_DN "cn=refresh_group,ou=groups,dc=example,dc=com"
+#define TEST_UNKNOWN_DN "uid=unknown,ou=users,dc=example,dc=com"
+
+static time_t test_notify_since;
+
+time_t sdap_change_notify_active_since(struct sdap_id_ctx *id_ctx)
+{
+    return test_notify_since;
+}
+
+struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx,
+                                     struct sdap_id_conn_cache *cache)
+{
+    return (struct sdap_id_op *) talloc_new(memctx);
+}
+
+struct tevent_req *sdap_id_op_connect_send(struct sdap_id_op *op,
+                                           TALLOC_CTX *memctx,
+                                           int *ret_out)
+{
+    struct tevent_req *req;
+    struct tevent_context *ev;
+    int *state;
+
+    req = tevent_req_create(memctx, &state, int);
+    assert_non_null(req);
+
+    ev = sss_mock_ptr_type(struct tevent_context *);
+    tevent_req_done(req);
+    *ret_out = EOK;
+
+    return tevent_req_post(req, ev);
+}
+
+int sdap_id_op_connect_recv(struct tevent_req *req, int *dp_error)
+{
+    *dp_error = DP_ERR_OK;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_err_out)
+{
+    *dp_err_out = retval == EOK ? DP_ERR_OK : DP_ERR_FATAL;
+
+    return retval;
+}
+
+struct test_changed_state {
+    char *usn_value;
+};
+
+static struct tevent_req *test_changed_send(TALLOC_CTX *memctx,
+                                            struct tevent_context *ev)
+{
+    struct test_changed_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(memctx, &state, struct test_changed_state);
+    assert_non_null(req);
+
+    state->usn_value = talloc_strdup(state, sss_mock_ptr_type(const char *));
+    ret = sss_mock_type(errno_t);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+
+    return tevent_req_post(req, ev);
+}
+
+static errno_t test_changed_recv(struct tevent_req *req,
+                                 TALLOC_CTX *mem_ctx,
+                                 char **_usn_value)
+{
+    struct test_changed_state *state;
+
+    state = tevent_req_data(req, struct test_changed_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_usn_value = talloc_steal(mem_ctx, state->usn_value);
+
+    return EOK;
+}
+
+struct tevent_req *
+sdap_enum_users_changed_send(TALLOC_CTX *memctx,
+                             struct tevent_context *ev,
+                             struct sdap_id_ctx *ctx,
+                             struct sdap_domain *sdom,
+                             struct sdap_id_op *op,
+                             const char *usn_value)
+{
+    check_expected(usn_value);
+
+    return test_changed_send(memctx, ev);
+}
+
+errno_t sdap_enum_users_changed_recv(struct tevent_req *req,
+                                     TALLOC_CTX *mem_ctx,
+                                     char **_usn_value)
+{
+    return test_changed_recv(req, mem_ctx, _usn_value);
+}
+
+struct tevent_req *
+sdap_enum_groups_changed_send(TALLOC_CTX *memctx,
+                              struct tevent_context *ev,
+                              struct sdap_id_ctx *ctx,
+                              struct sdap_domain *sdom,
+                              struct sdap_id_op *op,
+                              const char *usn_value)
+{
+    check_expected(usn_value);
+
+    return test_changed_send(memctx, ev);
+}
+
+errno_t sdap_enum_groups_changed_recv(struct tevent_req *req,
+                                      TALLOC_CTX *mem_ctx,
+                                      char **_usn_value)
+{
+    return test_changed_recv(req, mem_ctx, _usn_value);
+}
+
+/* Refreshes the entries one by one in the real provider */
+static struct tevent_req *test_refresh_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct be_ctx *be_ctx,
+                                            struct sss_domain_info *domain,
+                                            char **names,
+                                            void *pvt)
+{
+    size_t num_names;
+
+    for (num_names = 0; names[num_names] != NULL; num_names++);
+    check_expected(num_names);
+
+    return test_req_succeed_send(mem_ctx, ev);
+}
+
+static errno_t test_refresh_recv(struct tevent_req *req)
+{
+    return test_request_recv(req);
+}
+
+struct sdap_refresh_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sdap_options *opts;
+    struct sdap_id_ctx *id_ctx;
+    struct be_ctx *be_ctx;
+    struct be_ptask *ptask;
+    time_t now;
+
+    char *user1;
+    char *user2;
+    char *user3;
+    char *group;
+};
+
+static void store_user(struct sdap_refresh_test_ctx *test_ctx,
+                       const char *fqname, uid_t uid, const char *dn,
+                       const char *usn, time_t last_update, time_t expire)
+{
+    struct sysdb_attrs *attrs;
+    char *remove_attrs[] = { discard_const(SYSDB_USN), NULL };
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+
+    if (usn != NULL) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_USN, usn);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = sysdb_store_user(test_ctx->tctx->dom, fqname, NULL, uid, uid,
+                           NULL, "/home/user", "/bin/sh", dn, attrs,
+                           usn == NULL ? remove_attrs : NULL,
+                           expire - last_update, last_update);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(attrs);
+}
+
+static void store_group(struct sdap_refresh_test_ctx *test_ctx,
+                        const char *fqname, gid_t gid, const char *dn,
+                        const char *usn, time_t last_update, time_t expire)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+
+    ret = sysdb_attrs_add_string(attrs, SYSDB_ORIG_DN, dn);
+    assert_int_equal(ret, EOK);
+
+    if (usn != NULL) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_USN, usn);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = sysdb_store_group(test_ctx->tctx->dom, fqname, gid, attrs,
+                            expire - last_update, last_update);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(attrs);
+}
+
+static int sdap_refresh_test_setup(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    struct sdap_options *opts;
+    time_t stored;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct sdap_refresh_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+    test_ctx->tctx->dom->user_timeout = TEST_TIMEOUT;
+    test_ctx->tctx->dom->group_timeout = TEST_TIMEOUT;
+    test_ctx->tctx->dom->refresh_expired_interval = 0;
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+
+    ret = sdap_copy_map(opts, rfc2307_user_map, SDAP_OPTS_USER,
+                        &opts->user_map);
+    assert_int_equal(ret, ERR_OK);
+
+    ret = sdap_copy_map(opts, rfc2307_group_map, SDAP_OPTS_GROUP,
+                        &opts->group_map);
+    assert_int_equal(ret, ERR_OK);
+
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, ERR_OK);
+
+    /* Normally detected from the rootDSE */
+    opts->user_map[SDAP_AT_USER_USN].name = talloc_strdup(opts->user_map,
+                                                          "entryUSN");
+    assert_non_null(opts->user_map[SDAP_AT_USER_USN].name);
+    opts->group_map[SDAP_AT_GROUP_USN].name = talloc_strdup(opts->group_map,
+                                                            "entryUSN");
+    assert_non_null(opts->group_map[SDAP_AT_GROUP_USN].name);
+
+    ret = dp_opt_set_int(opts->basic, SDAP_REFRESH_USN_FULL_INTERVAL,
+                         TEST_FULL_INTERVAL);
+    assert_int_equal(ret, EOK);
+
+    ret = sdap_domain_add(opts, test_ctx->tctx->dom, NULL);
+    assert_int_equal(ret, EOK);
+    test_ctx->opts = opts;
+
+    test_ctx->now = time(NULL);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->opts = opts;
+
+    test_ctx->id_ctx->srv_opts = talloc_zero(test_ctx->id_ctx,
+                                             struct sdap_server_opts);
+    assert_non_null(test_ctx->id_ctx->srv_opts);
+    test_ctx->id_ctx->srv_opts->supports_usn = true;
+    test_ctx->id_ctx->srv_opts->last_usn = 50;
+    test_ctx->id_ctx->srv_opts->first_seen = test_ctx->now - 1000;
+
+    test_ctx->id_ctx->conn = talloc_zero(test_ctx->id_ctx,
+                                         struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->id_ctx->conn);
+    test_ctx->id_ctx->conn->id_ctx = test_ctx->id_ctx;
+
+    /* The entries were just refreshed one by one */
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+    assert_non_null(type);
+    type->last_full = test_ctx->now;
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_GROUP);
+    assert_non_null(type);
+    type->last_full = test_ctx->now;
+
+    test_ctx->user1 = sss_create_internal_fqname(test_ctx, TEST_USER1_NAME,
+                                                 test_ctx->tctx->dom->name);
+    assert_non_null(test_ctx->user1);
+    test_ctx->user2 = sss_create_internal_fqname(test_ctx, TEST_USER2_NAME,
+                                                 test_ctx->tctx->dom->name);
+    assert_non_null(test_ctx->user2);
+    test_ctx->user3 = sss_create_internal_fqname(test_ctx, TEST_USER3_NAME,
+                                                 test_ctx->tctx->dom->name);
+    assert_non_null(test_ctx->user3);
+    test_ctx->group = sss_create_internal_fqname(test_ctx, TEST_GROUP_NAME,
+                                                 test_ctx->tctx->dom->name);
+    assert_non_null(test_ctx->group);
+
+    /* Two expired users and a group, the third user is still valid */
+    stored = test_ctx->now - 100;
+    store_user(test_ctx, test_ctx->user1, 1001, TEST_USER1_DN, "100",
+               stored, stored + 10);
+    store_user(test_ctx, test_ctx->user2, 1002, TEST_USER2_DN, "150",
+               stored, stored + 10);
+    store_user(test_ctx, test_ctx->user3, 1003, TEST_USER3_DN, "170",
+               stored, test_ctx->now + 1000);
+    store_group(test_ctx, test_ctx->group, 2001, TEST_GROUP_DN, "120",
+                stored, stored + 10);
+
+    test_notify_since = 0;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int sdap_refresh_test_teardown(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    talloc_zfree(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static int sdap_refresh_be_test_setup(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct be_refresh_cb callbacks[BE_REFRESH_TYPE_SENTINEL] = { { 0 } };
+    errno_t ret;
+
+    sdap_refresh_test_setup(state);
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+
+    callbacks[BE_REFRESH_TYPE_USERS].send_fn = test_refresh_send;
+    callbacks[BE_REFRESH_TYPE_USERS].recv_fn = test_refresh_recv;
+    callbacks[BE_REFRESH_TYPE_USERS].bulk_send_fn = sdap_refresh_users_usn_send;
+    callbacks[BE_REFRESH_TYPE_USERS].bulk_recv_fn = sdap_refresh_users_usn_recv;
+    callbacks[BE_REFRESH_TYPE_USERS].pvt = test_ctx->id_ctx;
+
+    ret = be_refresh_ctx_init_with_callbacks(test_ctx->be_ctx, SYSDB_NAME,
+                                             callbacks);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->ptask = talloc_zero(test_ctx, struct be_ptask);
+    assert_non_null(test_ctx->ptask);
+
+    return 0;
+}
+
+static void test_refresh_done(struct tevent_req *req)
+{
+    struct sss_test_ctx *tctx;
+
+    tctx = tevent_req_callback_data(req, struct sss_test_ctx);
+
+    test_ev_done(tctx, sdap_refresh_usn_recv(req));
+    talloc_free(req);
+}
+
+static errno_t refresh_usn(struct sdap_refresh_test_ctx *test_ctx,
+                           int entry_type, ...)
+{
+    struct tevent_req *req;
+    const char *name;
+    char **names;
+    size_t num = 0;
+    va_list ap;
+
+    names = talloc_zero_array(test_ctx, char *, 4);
+    assert_non_null(names);
+
+    va_start(ap, entry_type);
+    while ((name = va_arg(ap, const char *)) != NULL) {
+        assert_true(num < 3);
+        names[num] = talloc_strdup(names, name);
+        assert_non_null(names[num]);
+        num++;
+    }
+    va_end(ap);
+
+    test_ctx->tctx->done = false;
+    req = sdap_refresh_usn_send(test_ctx, test_ctx->tctx->ev,
+                                test_ctx->tctx->dom, entry_type, SYSDB_NAME,
+                                names, test_ctx->id_ctx->conn);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_refresh_done, test_ctx->tctx);
+
+    talloc_free(names);
+    return test_ev_loop(test_ctx->tctx);
+}
+
+static void test_be_refresh_done(struct tevent_req *req)
+{
+    struct sss_test_ctx *tctx;
+
+    tctx = tevent_req_callback_data(req, struct sss_test_ctx);
+
+    test_ev_done(tctx, be_refresh_recv(req));
+    talloc_free(req);
+}
+
+static errno_t be_refresh(struct sdap_refresh_test_ctx *test_ctx)
+{
+    struct tevent_req *req;
+
+    test_ctx->tctx->done = false;
+    req = be_refresh_send(test_ctx, test_ctx->tctx->ev, test_ctx->be_ctx,
+                          test_ctx->ptask, test_ctx->be_ctx->refresh_ctx);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_be_refresh_done, test_ctx->tctx);
+
+    return test_ev_loop(test_ctx->tctx);
+}
+
+static void expect_search(struct sdap_refresh_test_ctx *test_ctx,
+                          int entry_type, const char *usn_value,
+                          const char *new_usn, errno_t ret)
+{
+    will_return(sdap_id_op_connect_send, test_ctx->tctx->ev);
+    if (entry_type == BE_REQ_USER) {
+        expect_string(sdap_enum_users_changed_send, usn_value, usn_value);
+    } else {
+        expect_string(sdap_enum_groups_changed_send, usn_value, usn_value);
+    }
+    will_return(test_changed_send, new_usn);
+    will_return(test_changed_send, ret);
+}
+
+static void get_times(struct sdap_refresh_test_ctx *test_ctx,
+                      int entry_type, const char *fqname,
+                      time_t *_last_update, time_t *_expire)
+{
+    const char *attrs[] = { SYSDB_LAST_UPDATE, SYSDB_CACHE_EXPIRE, NULL };
+    struct ldb_message *msg;
+    errno_t ret;
+
+    if (entry_type == BE_REQ_USER) {
+        ret = sysdb_search_user_by_name(test_ctx, test_ctx->tctx->dom,
+                                        fqname, attrs, &msg);
+    } else {
+        ret = sysdb_search_group_by_name(test_ctx, test_ctx->tctx->dom,
+                                         fqname, attrs, &msg);
+    }
+    assert_int_equal(ret, EOK);
+
+    *_last_update = ldb_msg_find_attr_as_uint64(msg, SYSDB_LAST_UPDATE, 0);
+    *_expire = ldb_msg_find_attr_as_uint64(msg, SYSDB_CACHE_EXPIRE, 0);
+    talloc_free(msg);
+}
+
+static void assert_refreshed(struct sdap_refresh_test_ctx *test_ctx,
+                             int entry_type, const char *fqname)
+{
+    time_t last_update;
+    time_t expire;
+
+    get_times(test_ctx, entry_type, fqname, &last_update, &expire);
+    assert_true(last_update >= test_ctx->now);
+    assert_int_equal(expire, last_update + TEST_TIMEOUT);
+}
+
+static void assert_not_refreshed(struct sdap_refresh_test_ctx *test_ctx,
+                                 int entry_type, const char *fqname)
+{
+    time_t last_update;
+    time_t expire;
+
+    get_times(test_ctx, entry_type, fqname, &last_update, &expire);
+    assert_int_equal(last_update, test_ctx->now - 100);
+}
+
+static void test_refresh_usn_checkpoints(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    size_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+    assert_non_null(type);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 100), 0);
+
+    ret = sdap_refresh_usn_add_checkpoint(test_ctx->id_ctx->refresh_usn,
+                                          type, 100, 0, 500);
+    assert_int_equal(ret, EOK);
+    ret = sdap_refresh_usn_add_checkpoint(test_ctx->id_ctx->refresh_usn,
+                                          type, 200, 0, 700);
+    assert_int_equal(ret, EOK);
+
+    /* An entry is current up to the last search that started after it
+     * was stored */
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 99), 0);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 100), 500);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 150), 500);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 200), 700);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 1000), 700);
+
+    /* Checkpoints older than any cached entry are dropped */
+    ret = sdap_refresh_usn_add_checkpoint(test_ctx->id_ctx->refresh_usn,
+                                          type, 300, 150, 900);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(type->num_checkpoints, 2);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 150), 0);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 300), 900);
+
+    /* The number of checkpoints is limited, the oldest are dropped */
+    for (i = 0; i < 2 * SDAP_REFRESH_USN_MAX_CHECKPOINTS; i++) {
+        ret = sdap_refresh_usn_add_checkpoint(test_ctx->id_ctx->refresh_usn,
+                                              type, 1000 + i, 0, 1000 + i);
+        assert_int_equal(ret, EOK);
+    }
+    assert_int_equal(type->num_checkpoints, SDAP_REFRESH_USN_MAX_CHECKPOINTS);
+    assert_int_equal(type->checkpoints[0].time,
+                     1000 + SDAP_REFRESH_USN_MAX_CHECKPOINTS);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 999), 0);
+    assert_int_equal(sdap_refresh_usn_checkpoint(type, 5000),
+                     1000 + 2 * SDAP_REFRESH_USN_MAX_CHECKPOINTS - 1);
+}
+
+static void test_refresh_usn_users(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+
+    /* The search starts from the lowest USN of the expired users, the
+     * expiration of all of them is bumped whether they were returned or
+     * not */
+    expect_search(test_ctx, BE_REQ_USER, "100", "200", EOK);
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, test_ctx->user2, NULL);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user3);
+
+    assert_int_equal(type->num_checkpoints, 1);
+    assert_true(type->checkpoints[0].time >= test_ctx->now);
+    assert_int_equal(type->checkpoints[0].usn, 200);
+
+    /* The users are current up to the checkpoint, nothing changed since,
+     * which is not an error */
+    expect_search(test_ctx, BE_REQ_USER, "200", NULL, ENOENT);
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, test_ctx->user2, NULL);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+
+    assert_true(type->num_checkpoints >= 1);
+    assert_int_equal(type->checkpoints[type->num_checkpoints - 1].usn, 200);
+}
+
+static void test_refresh_usn_groups(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_GROUP);
+
+    /* The highest USN the server had when the search started is used
+     * if the search did not return a higher one */
+    test_ctx->id_ctx->srv_opts->last_usn = 300;
+    expect_search(test_ctx, BE_REQ_GROUP, "120", "130", EOK);
+    ret = refresh_usn(test_ctx, BE_REQ_GROUP, test_ctx->group, NULL);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_GROUP, test_ctx->group);
+
+    assert_int_equal(type->num_checkpoints, 1);
+    assert_int_equal(type->checkpoints[0].usn, 300);
+
+    /* Users have their own checkpoints */
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+    assert_int_equal(type->num_checkpoints, 0);
+}
+
+static void test_refresh_usn_enotsup(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    struct sdap_server_opts *srv_opts;
+    const char *usn_attr;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+    srv_opts = test_ctx->id_ctx->srv_opts;
+
+    /* No search is expected in any of the cases below */
+
+    /* Delta refresh is disabled */
+    dp_opt_set_int(test_ctx->opts->basic, SDAP_REFRESH_USN_FULL_INTERVAL, 0);
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, ENOTSUP);
+    dp_opt_set_int(test_ctx->opts->basic, SDAP_REFRESH_USN_FULL_INTERVAL,
+                   TEST_FULL_INTERVAL);
+
+    /* Full refresh is due, it is scheduled only once per interval */
+    type->last_full = test_ctx->now - TEST_FULL_INTERVAL;
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, ENOTSUP);
+    assert_true(type->last_full >= test_ctx->now);
+
+    /* An entry is not cached */
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, "unknown@" TEST_DOM_NAME, NULL);
+    assert_int_equal(ret, ENOTSUP);
+
+    /* An entry has no USN */
+    store_user(test_ctx, test_ctx->user2, 1002, TEST_USER2_DN, NULL,
+               test_ctx->now - 100, test_ctx->now - 90);
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, test_ctx->user2, NULL);
+    assert_int_equal(ret, ENOTSUP);
+
+    /* The server has no USN attribute */
+    usn_attr = test_ctx->opts->user_map[SDAP_AT_USER_USN].name;
+    test_ctx->opts->user_map[SDAP_AT_USER_USN].name = NULL;
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, ENOTSUP);
+    test_ctx->opts->user_map[SDAP_AT_USER_USN].name = usn_attr;
+
+    /* The server does not support USN */
+    srv_opts->supports_usn = false;
+    will_return(sdap_id_op_connect_send, test_ctx->tctx->ev);
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, ENOTSUP);
+    srv_opts->supports_usn = true;
+
+    /* The entry was stored from another server */
+    srv_opts->first_seen = test_ctx->now - 50;
+    will_return(sdap_id_op_connect_send, test_ctx->tctx->ev);
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, ENOTSUP);
+
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+    assert_int_equal(type->num_checkpoints, 0);
+}
+
+static void test_refresh_usn_notify(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    /* The users were stored while change notification was active, they
+     * would have been refreshed if they changed */
+    test_notify_since = test_ctx->now - 200;
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, test_ctx->user2, NULL);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+
+    /* Not if the subscription started later */
+    store_user(test_ctx, test_ctx->user1, 1001, TEST_USER1_DN, "100",
+               test_ctx->now - 100, test_ctx->now - 90);
+    test_notify_since = test_ctx->now - 50;
+    expect_search(test_ctx, BE_REQ_USER, "100", "200", EOK);
+    ret = refresh_usn(test_ctx, BE_REQ_USER, test_ctx->user1, NULL);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+}
+
+static void test_refresh_usn_search_error(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+
+    expect_search(test_ctx, BE_REQ_USER, "100", NULL, EIO);
+    ret = refresh_usn(test_ctx, BE_REQ_USER,
+                      test_ctx->user1, test_ctx->user2, NULL);
+    assert_int_equal(ret, EIO);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+    assert_int_equal(type->num_checkpoints, 0);
+}
+
+static void test_be_refresh_usn(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    /* Both expired users are refreshed with a single search, they are not
+     * refreshed one by one */
+    expect_search(test_ctx, BE_REQ_USER, "100", "200", EOK);
+    ret = be_refresh(test_ctx);
+    assert_int_equal(ret, EOK);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user3);
+
+    /* Nothing is expired anymore */
+    ret = be_refresh(test_ctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_be_refresh_usn_fallback(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sdap_refresh_usn_type *type;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+    type = sdap_refresh_usn_get_type(test_ctx->id_ctx, BE_REQ_USER);
+
+    /* Delta refresh is not possible, the expired users are refreshed one
+     * by one */
+    type->last_full = 0;
+    expect_value(test_refresh_send, num_names, 2);
+    ret = be_refresh(test_ctx);
+    assert_int_equal(ret, EOK);
+
+    /* So they are if the search fails */
+    expect_search(test_ctx, BE_REQ_USER, "100", NULL, EIO);
+    expect_value(test_refresh_send, num_names, 2);
+    ret = be_refresh(test_ctx);
+    assert_int_equal(ret, EOK);
+
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user1);
+    assert_not_refreshed(test_ctx, BE_REQ_USER, test_ctx->user2);
+}
+
+static void test_filter_cached_objects(void **state)
+{
+    struct sdap_refresh_test_ctx *test_ctx;
+    struct sysdb_attrs *objects[5];
+    const char *dns[] = { TEST_UNKNOWN_DN, TEST_USER1_DN, TEST_GROUP_DN,
+                          TEST_USER2_DN, NULL };
+    const char *dn;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sdap_refresh_test_ctx);
+
+    for (i = 0; dns[i] != NULL; i++) {
+        objects[i] = sysdb_new_attrs(test_ctx);
+        assert_non_null(objects[i]);
+        ret = sysdb_attrs_add_string(objects[i], SYSDB_ORIG_DN, dns[i]);
+        assert_int_equal(ret, EOK);
+    }
+    objects[i] = NULL;
+
+    /* Only cached users are kept, in their original order */
+    count = sdap_filter_cached_objects(test_ctx->opts, test_ctx->tctx->dom,
+                                       SYSDB_MEMBER_USER, objects, i);
+    assert_int_equal(count, 2);
+    assert_null(objects[2]);
+
+    ret = sysdb_attrs_get_string(objects[0], SYSDB_ORIG_DN, &dn);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(dn, TEST_USER1_DN);
+    ret = sysdb_attrs_get_string(objects[1], SYSDB_ORIG_DN, &dn);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(dn, TEST_USER2_DN);
+
+    /* The group is not a user but it is a cached group */
+    objects[2] = sysdb_new_attrs(test_ctx);
+    assert_non_null(objects[2]);
+    ret = sysdb_attrs_add_string(objects[2], SYSDB_ORIG_DN, TEST_GROUP_DN);
+    assert_int_equal(ret, EOK);
+
+    count = sdap_filter_cached_objects(test_ctx->opts, test_ctx->tctx->dom,
+                                       SYSDB_MEMBER_GROUP, objects + 2, 1);
+    assert_int_equal(count, 1);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_refresh_usn_checkpoints,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_refresh_usn_users,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_refresh_usn_groups,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_refresh_usn_enotsup,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_refresh_usn_notify,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_refresh_usn_search_error,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_be_refresh_usn,
+                                        sdap_refresh_be_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_be_refresh_usn_fallback,
+                                        sdap_refresh_be_test_setup,
+                                        sdap_refresh_test_teardown),
+        cmocka_unit_test_setup_teardown(test_filter_cached_objects,
+                                        sdap_refresh_test_setup,
+                                        sdap_refresh_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old DB to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
@@ -0,0 +1,145 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/cmocka/common_mock.h"
+#include "util/sss_ptr_cache.h"
+
+static int *new_payload(int value)
+{
+    int *payload;
+
+    payload = talloc_zero(global_talloc_context, int);
+    assert_non_null(payload);
+    *payload = value;
+
+    return payload;
+}
+
+static void add_payload(struct sss_ptr_cache *cache,
+                        const char *key,
+                        int value)
+{
+    errno_t ret;
+
+    ret = sss_ptr_cache_add(cache, key, new_payload(value));
+    assert_int_equal(ret, EOK);
+}
+
+static void check_payload(struct sss_ptr_cache *cache,
+                          const char *key,
+                          int value)
+{
+    int *payload;
+
+    payload = sss_ptr_cache_lookup(cache, key, NULL, NULL);
+    assert_non_null(payload);
+    assert_int_equal(*payload, value);
+}
+
+static bool payload_equals(void *ptr, void *pvt)
+{
+    return *(int *) ptr == *(int *) pvt;
+}
+
+void test_sss_ptr_cache_lookup(void **state)
+{
+    struct sss_ptr_cache *cache;
+    uint64_t hits;
+    uint64_t misses;
+    int value;
+
+    assert_null(sss_ptr_cache_create(global_talloc_context, 0, 100));
+
+    cache = sss_ptr_cache_create(global_talloc_context, 10, 100);
+    assert_non_null(cache);
+
+    add_payload(cache, "a", 1);
+    add_payload(cache, "b", 2);
+    check_payload(cache, "a", 1);
+    check_payload(cache, "b", 2);
+    assert_null(sss_ptr_cache_lookup(cache, "c", NULL, NULL));
+
+    /* A key is replaced by a new entry */
+    add_payload(cache, "a", 3);
+    check_payload(cache, "a", 3);
+
+    /* An entry the caller does not accept anymore is removed */
+    value = 3;
+    assert_non_null(sss_ptr_cache_lookup(cache, "a", payload_equals, &value));
+    value = 4;
+    assert_null(sss_ptr_cache_lookup(cache, "a", payload_equals, &value));
+    assert_null(sss_ptr_cache_lookup(cache, "a", NULL, NULL));
+
+    sss_ptr_cache_delete(cache, "b");
+    assert_null(sss_ptr_cache_lookup(cache, "b", NULL, NULL));
+
+    sss_ptr_cache_get_stats(cache, &hits, &misses);
+    assert_int_equal(hits, 4);
+    assert_int_equal(misses, 4);
+
+    sss_ptr_cache_get_stats(NULL, &hits, &misses);
+    assert_int_equal(hits, 0);
+    assert_int_equal(misses, 0);
+
+    talloc_free(cache);
+}
+
+void test_sss_ptr_cache_evict(void **state)
+{
+    struct sss_ptr_cache *cache;
+
+    cache = sss_ptr_cache_create(global_talloc_context, 2, 100);
+    assert_non_null(cache);
+
+    /* The entry that was not used since the hand passed it is evicted */
+    add_payload(cache, "a", 1);
+    add_payload(cache, "b", 2);
+    check_payload(cache, "a", 1);
+
+    add_payload(cache, "c", 3);
+    check_payload(cache, "a", 1);
+    check_payload(cache, "c", 3);
+    assert_null(sss_ptr_cache_lookup(cache, "b", NULL, NULL));
+
+    talloc_free(cache);
+}
+
+void test_sss_ptr_cache_flush(void **state)
+{
+    struct sss_ptr_cache *cache;
+    int value = 2;
+
+    cache = sss_ptr_cache_create(global_talloc_context, 10, 100);
+    assert_non_null(cache);
+
+    add_payload(cache, "a", 1);
+    add_payload(cache, "b", 2);
+    add_payload(cache, "c", 2);
+
+    /* Only the matching entries are flushed */
+    sss_ptr_cache_flush(cache, payload_equals, &value);
+    check_payload(cache, "a", 1);
+    assert_null(sss_ptr_cache_lookup(cache, "b", NULL, NULL));
+    assert_null(sss_ptr_cache_lookup(cache, "c", NULL, NULL));
+
+    add_payload(cache, "b", 2);
+    sss_ptr_cache_flush(cache, NULL, NULL);
+    assert_null(sss_ptr_cache_lookup(cache, "a", NULL, NULL));
+    assert_null(sss_ptr_cache_lookup(cache, "b", NULL, NULL));
+
+    talloc_free(cache);
+}
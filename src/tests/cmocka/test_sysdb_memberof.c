@@ -0,0 +1,944 @@
+/*
+    SSSD
+
+    Tests for the memberof ldb module on deep group hierarchies
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+#include <time.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "db/sysdb_private.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "tests_conf.ldb"
+#define TEST_ID_PROVIDER "ldap"
+#define TEST_DOM_NAME "test_sysdb_memberof"
+
+/* Depth of the group chain, group0 is a member of group1 and so on */
+#define TEST_LEVELS       10
+/* The link between these two levels is removed and added again */
+#define TEST_CUT_LEVEL    4
+
+#define TEST_GID_BASE     10000
+#define TEST_UID_BASE     20000
+
+#define TEST_CACHE_TIMEOUT 5
+
+/* Not cached member of the bottom group */
+#define TEST_GHOST        "ghost_user"
+
+#define TEST_MEMBERS      100
+#define BENCH_MEMBERS     5000
+
+/* Groups of the enumeration benchmark, nested in a tree with
+ * TEST_ENUM_FANOUT subgroups per group */
+#define TEST_ENUM_GID_BASE 500000
+#define TEST_ENUM_FANOUT   10
+#define TEST_GROUPS        20
+#define BENCH_GROUPS       1000
+
+/* Raised to BENCH_MEMBERS and BENCH_GROUPS if SSS_TEST_BENCHMARK is set,
+ * can be set from the command line, e.g. --members=200000 --groups=50000 */
+static int bench_members = 0;
+static int bench_groups = 0;
+
+struct mbof_test_ctx {
+    struct sss_test_ctx *tctx;
+};
+
+static int test_mbof_setup(void **state)
+{
+    struct mbof_test_ctx *test_ctx;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct mbof_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_mbof_teardown(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_zfree(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static double mbof_bench_elapsed(struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3
+            + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static const char *mbof_group_name(TALLOC_CTX *mem_ctx, int level)
+{
+    const char *name;
+
+    name = talloc_asprintf(mem_ctx, "group%d", level);
+    assert_non_null(name);
+    return name;
+}
+
+static const char *mbof_user_name(TALLOC_CTX *mem_ctx, int idx)
+{
+    const char *name;
+
+    name = talloc_asprintf(mem_ctx, "user%d", idx);
+    assert_non_null(name);
+    return name;
+}
+
+static void mbof_link(struct sss_domain_info *dom, int level, bool add)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    if (add) {
+        ret = sysdb_add_group_member(dom, mbof_group_name(tmp_ctx, level + 1),
+                                     mbof_group_name(tmp_ctx, level),
+                                     SYSDB_MEMBER_GROUP, false);
+    } else {
+        ret = sysdb_remove_group_member(dom,
+                                        mbof_group_name(tmp_ctx, level + 1),
+                                        mbof_group_name(tmp_ctx, level),
+                                        SYSDB_MEMBER_GROUP, false);
+    }
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+}
+
+/* Chain of TEST_LEVELS groups with num_users users in the bottom one */
+static void mbof_store_hierarchy(struct sss_domain_info *dom, int num_users,
+                                 bool bulk)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_bulk_membership *session = NULL;
+    struct sysdb_attrs *attrs;
+    time_t now = time(NULL);
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    if (bulk) {
+        ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    } else {
+        ret = sysdb_transaction_start(dom->sysdb);
+    }
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+
+    for (i = 0; i < TEST_LEVELS; i++) {
+        attrs = sysdb_new_attrs(tmp_ctx);
+        assert_non_null(attrs);
+        if (i == 0) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, TEST_GHOST);
+            assert_int_equal(ret, EOK);
+        }
+
+        ret = sysdb_store_group(dom, mbof_group_name(tmp_ctx, i),
+                                TEST_GID_BASE + i, attrs,
+                                TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+    }
+
+    for (i = 0; i < TEST_LEVELS - 1; i++) {
+        mbof_link(dom, i, true);
+    }
+
+    for (i = 0; i < num_users; i++) {
+        ret = sysdb_store_user(dom, mbof_user_name(tmp_ctx, i), NULL,
+                               TEST_UID_BASE + i, TEST_GID_BASE,
+                               NULL, NULL, NULL, NULL, NULL, NULL,
+                               TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+
+        ret = sysdb_add_group_member(dom, mbof_group_name(tmp_ctx, 0),
+                                     mbof_user_name(tmp_ctx, i),
+                                     SYSDB_MEMBER_USER, false);
+        assert_int_equal(ret, EOK);
+    }
+
+    if (bulk) {
+        ret = sysdb_bulk_membership_commit(session);
+    } else {
+        ret = sysdb_transaction_commit(dom->sysdb);
+    }
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+}
+
+/* Store the entries of the hierarchy again without changing memberships */
+static void mbof_restore_hierarchy(struct sss_domain_info *dom, int num_users)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_bulk_membership *session;
+    struct sysdb_attrs *attrs;
+    time_t now = time(NULL);
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+
+    for (i = 0; i < num_users; i++) {
+        ret = sysdb_store_user(dom, mbof_user_name(tmp_ctx, i), NULL,
+                               TEST_UID_BASE + i, TEST_GID_BASE,
+                               NULL, NULL, NULL, NULL, NULL, NULL,
+                               TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+    }
+
+    attrs = sysdb_new_attrs(tmp_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, TEST_GHOST);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_group(dom, mbof_group_name(tmp_ctx, 0),
+                            TEST_GID_BASE, attrs, TEST_CACHE_TIMEOUT, now);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_bulk_membership_commit(session);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+}
+
+static bool mbof_has_memberof(struct sss_domain_info *dom,
+                              struct ldb_message *msg,
+                              int level)
+{
+    struct ldb_message_element *el;
+    char *dn;
+    bool found = false;
+    unsigned int i;
+
+    dn = sysdb_group_strdn(NULL, dom->name, mbof_group_name(msg, level));
+    assert_non_null(dn);
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+    for (i = 0; el != NULL && i < el->num_values; i++) {
+        if (strcasecmp((const char *)el->values[i].data, dn) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    talloc_free(dn);
+    return found;
+}
+
+static void mbof_check_user(struct sss_domain_info *dom,
+                            int idx,
+                            int num_groups)
+{
+    const char *attrs[] = { SYSDB_MEMBEROF, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_search_user_by_name(tmp_ctx, dom,
+                                    mbof_user_name(tmp_ctx, idx),
+                                    attrs, &msg);
+    assert_int_equal(ret, EOK);
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+    assert_non_null(el);
+    assert_int_equal(el->num_values, num_groups);
+
+    for (i = 0; i < num_groups; i++) {
+        assert_true(mbof_has_memberof(dom, msg, i));
+    }
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_mbof_unlink_chain(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    const char *attrs[] = { SYSDB_MEMBEROF, NULL };
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    mbof_store_hierarchy(dom, 10, false);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+
+    /* user0 is also a direct member of a group above the cut */
+    ret = sysdb_add_group_member(dom, mbof_group_name(tmp_ctx, 7),
+                                 mbof_user_name(tmp_ctx, 0),
+                                 SYSDB_MEMBER_USER, false);
+    assert_int_equal(ret, EOK);
+
+    mbof_link(dom, TEST_CUT_LEVEL, false);
+
+    for (i = 1; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_CUT_LEVEL + 1);
+    }
+
+    ret = sysdb_search_user_by_name(tmp_ctx, dom, mbof_user_name(tmp_ctx, 0),
+                                    attrs, &msg);
+    assert_int_equal(ret, EOK);
+    for (i = 0; i < TEST_LEVELS; i++) {
+        assert_true(mbof_has_memberof(dom, msg, i) ==
+                    (i <= TEST_CUT_LEVEL || i >= 7));
+    }
+
+    /* the groups below the cut lost the upper part of the chain */
+    ret = sysdb_search_group_by_name(tmp_ctx, dom,
+                                     mbof_group_name(tmp_ctx, 0),
+                                     attrs, &msg);
+    assert_int_equal(ret, EOK);
+    for (i = 1; i < TEST_LEVELS; i++) {
+        assert_true(mbof_has_memberof(dom, msg, i) == (i <= TEST_CUT_LEVEL));
+    }
+
+    mbof_link(dom, TEST_CUT_LEVEL, true);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_mbof_large_hierarchy(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct timespec start;
+    double store_ms;
+    double unlink_ms;
+    double link_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_store_hierarchy(dom, bench_members, false);
+    store_ms = mbof_bench_elapsed(&start);
+
+    /* every user loses the upper part of the chain */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_link(dom, TEST_CUT_LEVEL, false);
+    unlink_ms = mbof_bench_elapsed(&start);
+
+    mbof_check_user(dom, 0, TEST_CUT_LEVEL + 1);
+    mbof_check_user(dom, bench_members - 1, TEST_CUT_LEVEL + 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_link(dom, TEST_CUT_LEVEL, true);
+    link_ms = mbof_bench_elapsed(&start);
+
+    mbof_check_user(dom, 0, TEST_LEVELS);
+    mbof_check_user(dom, bench_members - 1, TEST_LEVELS);
+
+    if (test_benchmark_enabled()) {
+        printf("%d levels with %d members, ms:\n",
+               TEST_LEVELS, bench_members);
+        printf("  store:  %.2f\n", store_ms);
+        printf("  unlink: %.2f\n", unlink_ms);
+        printf("  link:   %.2f\n", link_ms);
+    }
+}
+
+static void mbof_check_group(struct sss_domain_info *dom,
+                             int level,
+                             int num_memberuids,
+                             bool has_ghost)
+{
+    const char *attrs[] = { SYSDB_MEMBERUID, SYSDB_GHOST, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_search_group_by_name(tmp_ctx, dom,
+                                     mbof_group_name(tmp_ctx, level),
+                                     attrs, &msg);
+    assert_int_equal(ret, EOK);
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    assert_int_equal(el == NULL ? 0 : el->num_values, num_memberuids);
+
+    el = ldb_msg_find_element(msg, SYSDB_GHOST);
+    if (has_ghost) {
+        assert_non_null(el);
+        assert_int_equal(el->num_values, 1);
+        assert_string_equal((const char *)el->values[0].data, TEST_GHOST);
+    } else {
+        assert_null(el);
+    }
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_mbof_bulk_session(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct sysdb_bulk_membership *session;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    mbof_store_hierarchy(dom, 10, true);
+
+    /* same result as maintaining the memberships on every write */
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+    for (i = 0; i < TEST_LEVELS; i++) {
+        mbof_check_group(dom, i, 10, true);
+    }
+
+    /* a cancelled session does not leave the maintenance disabled */
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+    ret = sysdb_transaction_cancel(dom->sysdb);
+    assert_int_equal(ret, EOK);
+    talloc_zfree(session);
+
+    mbof_link(dom, TEST_CUT_LEVEL, false);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_CUT_LEVEL + 1);
+    }
+    mbof_check_group(dom, TEST_CUT_LEVEL, 10, true);
+    mbof_check_group(dom, TEST_CUT_LEVEL + 1, 0, false);
+
+    /* writes done inside the session are only reflected at the end */
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+
+    sysdb_bulk_membership_enter(session);
+    mbof_link(dom, TEST_CUT_LEVEL, true);
+    sysdb_bulk_membership_leave(session);
+    mbof_check_user(dom, 0, TEST_CUT_LEVEL + 1);
+
+    ret = sysdb_bulk_membership_commit(session);
+    assert_int_equal(ret, EOK);
+    talloc_zfree(session);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+    mbof_check_group(dom, TEST_LEVELS - 1, 10, true);
+
+    talloc_free(tmp_ctx);
+}
+
+/* Writes done while a session is open but outside of it, e.g. by other
+ * requests served while the enumeration waits for the server, keep their
+ * memberships maintained */
+static void test_mbof_bulk_session_other_writes(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct sysdb_bulk_membership *session;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    mbof_store_hierarchy(dom, 10, false);
+    mbof_link(dom, TEST_CUT_LEVEL, false);
+
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+
+    /* group0 is rewritten by the session */
+    sysdb_bulk_membership_enter(session);
+    ret = sysdb_add_group_member(dom, mbof_group_name(tmp_ctx, 1),
+                                 mbof_user_name(tmp_ctx, 0),
+                                 SYSDB_MEMBER_USER, false);
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_leave(session);
+
+    /* another request restores the link in the meantime */
+    mbof_link(dom, TEST_CUT_LEVEL, true);
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+    mbof_check_group(dom, TEST_LEVELS - 1, 10, true);
+
+    ret = sysdb_bulk_membership_commit(session);
+    assert_int_equal(ret, EOK);
+    talloc_zfree(session);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+    for (i = 0; i < TEST_LEVELS; i++) {
+        mbof_check_group(dom, i, 10, true);
+    }
+
+    talloc_free(tmp_ctx);
+}
+
+/* Groups unrelated to the chain, so that a session touching the chain does
+ * not recompute the whole cache. side0 has a single member. */
+#define TEST_SIDE_GROUPS  (3 * TEST_LEVELS)
+#define TEST_SIDE_USER    "side_user"
+
+static void mbof_store_side_groups(struct sss_domain_info *dom)
+{
+    TALLOC_CTX *tmp_ctx;
+    time_t now = time(NULL);
+    const char *name;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    for (i = 0; i < TEST_SIDE_GROUPS; i++) {
+        name = talloc_asprintf(tmp_ctx, "side%d", i);
+        assert_non_null(name);
+
+        ret = sysdb_store_group(dom, name, TEST_GID_BASE + 1000 + i, NULL,
+                                TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = sysdb_store_user(dom, TEST_SIDE_USER, NULL,
+                           TEST_UID_BASE + 1000, TEST_GID_BASE + 1000,
+                           NULL, NULL, NULL, NULL, NULL, NULL,
+                           TEST_CACHE_TIMEOUT, now);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_add_group_member(dom, "side0", TEST_SIDE_USER,
+                                 SYSDB_MEMBER_USER, false);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+}
+
+static void mbof_check_side_user(struct sss_domain_info *dom)
+{
+    const char *attrs[] = { SYSDB_MEMBEROF, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_search_user_by_name(tmp_ctx, dom, TEST_SIDE_USER,
+                                    attrs, &msg);
+    assert_int_equal(ret, EOK);
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+    assert_non_null(el);
+    assert_int_equal(el->num_values, 1);
+
+    talloc_free(tmp_ctx);
+}
+
+/* Sessions that write a part of the hierarchy only recompute that part */
+static void test_mbof_bulk_session_scoped(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct sysdb_bulk_membership *session;
+    TALLOC_CTX *tmp_ctx;
+    time_t now = time(NULL);
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    mbof_store_side_groups(dom);
+    mbof_store_hierarchy(dom, 10, false);
+
+    /* removing a group from a written group */
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+    mbof_link(dom, TEST_CUT_LEVEL, false);
+    ret = sysdb_bulk_membership_commit(session);
+    assert_int_equal(ret, EOK);
+    talloc_zfree(session);
+
+    for (i = 0; i < 10; i++) {
+        mbof_check_user(dom, i, TEST_CUT_LEVEL + 1);
+    }
+    for (i = 0; i < TEST_LEVELS; i++) {
+        mbof_check_group(dom, i, i <= TEST_CUT_LEVEL ? 10 : 0,
+                         i <= TEST_CUT_LEVEL);
+    }
+    mbof_check_side_user(dom);
+
+    /* adding it back together with a new user in the bottom group */
+    ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+    mbof_link(dom, TEST_CUT_LEVEL, true);
+    ret = sysdb_store_user(dom, mbof_user_name(tmp_ctx, 10), NULL,
+                           TEST_UID_BASE + 10, TEST_GID_BASE,
+                           NULL, NULL, NULL, NULL, NULL, NULL,
+                           TEST_CACHE_TIMEOUT, now);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_add_group_member(dom, mbof_group_name(tmp_ctx, 0),
+                                 mbof_user_name(tmp_ctx, 10),
+                                 SYSDB_MEMBER_USER, false);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_bulk_membership_commit(session);
+    assert_int_equal(ret, EOK);
+    talloc_zfree(session);
+
+    for (i = 0; i < 11; i++) {
+        mbof_check_user(dom, i, TEST_LEVELS);
+    }
+    for (i = 0; i < TEST_LEVELS; i++) {
+        mbof_check_group(dom, i, 11, true);
+    }
+    mbof_check_side_user(dom);
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_mbof_large_bulk(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct timespec start;
+    double first_ms;
+    double second_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_store_hierarchy(dom, bench_members, true);
+    first_ms = mbof_bench_elapsed(&start);
+
+    mbof_check_user(dom, 0, TEST_LEVELS);
+    mbof_check_user(dom, bench_members - 1, TEST_LEVELS);
+    mbof_check_group(dom, TEST_LEVELS - 1, bench_members, true);
+
+    /* storing the same data again, as a repeated enumeration does */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_restore_hierarchy(dom, bench_members);
+    second_ms = mbof_bench_elapsed(&start);
+
+    mbof_check_user(dom, bench_members - 1, TEST_LEVELS);
+    mbof_check_group(dom, TEST_LEVELS - 1, bench_members, true);
+
+    if (test_benchmark_enabled()) {
+        printf("%d levels with %d members in a bulk session, ms:\n",
+               TEST_LEVELS, bench_members);
+        printf("  store:   %.2f\n", first_ms);
+        printf("  restore: %.2f\n", second_ms);
+    }
+}
+
+static int mbof_enum_parent(int idx)
+{
+    return (idx - 1) / TEST_ENUM_FANOUT;
+}
+
+/* Number of groups a member of the group idx is a member of */
+static int mbof_enum_depth(int idx)
+{
+    int depth;
+
+    for (depth = 1; idx > 0; depth++) {
+        idx = mbof_enum_parent(idx);
+    }
+
+    return depth;
+}
+
+/* Stores num_groups nested groups and num_users users like an enumeration
+ * does: all groups first, then their nesting, then the users, each a member
+ * of one group. */
+static void mbof_store_enum(struct sss_domain_info *dom,
+                            int num_users,
+                            int num_groups,
+                            bool bulk)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_bulk_membership *session = NULL;
+    time_t now = time(NULL);
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    if (bulk) {
+        ret = sysdb_bulk_membership_start(tmp_ctx, dom->sysdb, &session);
+    } else {
+        ret = sysdb_transaction_start(dom->sysdb);
+    }
+    assert_int_equal(ret, EOK);
+    sysdb_bulk_membership_enter(session);
+
+    for (i = 0; i < num_groups; i++) {
+        ret = sysdb_store_group(dom, mbof_group_name(tmp_ctx, i),
+                                TEST_ENUM_GID_BASE + i, NULL,
+                                TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+    }
+
+    for (i = 1; i < num_groups; i++) {
+        ret = sysdb_add_group_member(dom,
+                                     mbof_group_name(tmp_ctx,
+                                                     mbof_enum_parent(i)),
+                                     mbof_group_name(tmp_ctx, i),
+                                     SYSDB_MEMBER_GROUP, false);
+        assert_int_equal(ret, EOK);
+    }
+
+    for (i = 0; i < num_users; i++) {
+        ret = sysdb_store_user(dom, mbof_user_name(tmp_ctx, i), NULL,
+                               TEST_UID_BASE + i, TEST_ENUM_GID_BASE,
+                               NULL, NULL, NULL, NULL, NULL, NULL,
+                               TEST_CACHE_TIMEOUT, now);
+        assert_int_equal(ret, EOK);
+
+        ret = sysdb_add_group_member(dom,
+                                     mbof_group_name(tmp_ctx, i % num_groups),
+                                     mbof_user_name(tmp_ctx, i),
+                                     SYSDB_MEMBER_USER, false);
+        assert_int_equal(ret, EOK);
+    }
+
+    if (bulk) {
+        ret = sysdb_bulk_membership_commit(session);
+    } else {
+        ret = sysdb_transaction_commit(dom->sysdb);
+    }
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+}
+
+static void mbof_check_enum_user(struct sss_domain_info *dom,
+                                 int idx,
+                                 int num_groups)
+{
+    const char *attrs[] = { SYSDB_MEMBEROF, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int group;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_search_user_by_name(tmp_ctx, dom,
+                                    mbof_user_name(tmp_ctx, idx),
+                                    attrs, &msg);
+    assert_int_equal(ret, EOK);
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+    assert_non_null(el);
+    assert_int_equal(el->num_values, mbof_enum_depth(idx % num_groups));
+
+    for (group = idx % num_groups; group > 0; group = mbof_enum_parent(group)) {
+        assert_true(mbof_has_memberof(dom, msg, group));
+    }
+    assert_true(mbof_has_memberof(dom, msg, 0));
+
+    talloc_free(tmp_ctx);
+}
+
+static void mbof_test_enum(struct sss_domain_info *dom, bool bulk)
+{
+    struct timespec start;
+    double store_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbof_store_enum(dom, bench_members, bench_groups, bulk);
+    store_ms = mbof_bench_elapsed(&start);
+
+    mbof_check_enum_user(dom, 0, bench_groups);
+    mbof_check_enum_user(dom, bench_members - 1, bench_groups);
+    mbof_check_enum_user(dom, bench_members / 2, bench_groups);
+
+    if (test_benchmark_enabled()) {
+        printf("enumeration of %d users and %d groups%s, ms:\n",
+               bench_members, bench_groups,
+               bulk ? " in a bulk session" : "");
+        printf("  store:   %.2f\n", store_ms);
+    }
+}
+
+static void test_mbof_enum(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+
+    mbof_test_enum(test_ctx->tctx->dom, false);
+}
+
+static void test_mbof_enum_bulk(void **state)
+{
+    struct mbof_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct mbof_test_ctx);
+
+    mbof_test_enum(test_ctx->tctx->dom, true);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        {"members", 0, POPT_ARG_INT, &bench_members, 0,
+         _("Number of users in the bottom group for the benchmark"), NULL },
+        {"groups", 0, POPT_ARG_INT, &bench_groups, 0,
+         _("Number of groups for the enumeration benchmark"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_mbof_unlink_chain,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_large_hierarchy,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_bulk_session,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_bulk_session_other_writes,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_bulk_session_scoped,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_large_bulk,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_enum,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+        cmocka_unit_test_setup_teardown(test_mbof_enum_bulk,
+                                        test_mbof_setup,
+                                        test_mbof_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (bench_members < 0 || bench_groups < 0) {
+        fprintf(stderr, "\nAll arguments must be positive numbers\n\n");
+        return 1;
+    }
+
+    if (bench_members == 0) {
+        bench_members = test_benchmark_enabled() ? BENCH_MEMBERS
+                                                 : TEST_MEMBERS;
+    }
+
+    if (bench_groups == 0) {
+        bench_groups = test_benchmark_enabled() ? BENCH_GROUPS
+                                                : TEST_GROUPS;
+    }
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    if (rv == 0 && no_cleanup == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
@@ -48,6 +48,9 @@
 #define TEST_USER_GID           4322
 #define TEST_USER_SID           "S-1-5-21-123-456-789-222"
 #define TEST_USER_UPN           "test_user@TEST_REALM"
+#define TEST_USER_NAME_2        "test_user_2"
+#define TEST_USER_UID_2         4323
+#define TEST_USER_NAME_3        "test_user_3"
 
 #define TEST_MODSTAMP_1   "20160408132553Z"
 #define TEST_MODSTAMP_2   "20160408142553Z"
@@ -1707,6 +1710,265 @@ static void test_sysdb_group_missing_ts(void **state)
     talloc_zfree(groupdn);
 }
 
+static void set_batch_user(struct sysdb_ts_test_ctx *test_ctx,
+                           struct sysdb_store_user_entry *user,
+                           const char *name,
+                           uid_t uid,
+                           const char *shell,
+                           const char *modstamp)
+{
+    memset(user, 0, sizeof(struct sysdb_store_user_entry));
+    user->name = name;
+    user->uid = uid;
+    user->gid = TEST_USER_GID;
+    user->gecos = name;
+    user->homedir = "/home/test";
+    user->shell = shell;
+    user->attrs = create_modstamp_attrs(test_ctx, modstamp);
+    assert_non_null(user->attrs);
+    user->cache_timeout = TEST_CACHE_TIMEOUT;
+    user->ret = EIO;
+}
+
+static void test_sysdb_user_batch(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct sysdb_store_user_entry users[2];
+    struct ldb_result *res = NULL;
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+
+    /* Both users are added */
+    set_batch_user(test_ctx, &users[0], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/bash", TEST_MODSTAMP_1);
+    set_batch_user(test_ctx, &users[1], TEST_USER_NAME_2, TEST_USER_UID_2,
+                   "/bin/bash", TEST_MODSTAMP_1);
+    ret = sysdb_store_users_batch(test_ctx->tctx->dom, users, 2, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(users[0].ret, EOK);
+    assert_int_equal(users[1].ret, EOK);
+
+    get_pw_timestamp_attrs(test_ctx, TEST_USER_NAME,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    get_pw_timestamp_attrs(test_ctx, TEST_USER_NAME_2,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+
+    /* Nothing but the modifyTimestamp changed, only the timestamp cache
+     * is updated */
+    set_batch_user(test_ctx, &users[0], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/bash", TEST_MODSTAMP_2);
+    set_batch_user(test_ctx, &users[1], TEST_USER_NAME_2, TEST_USER_UID_2,
+                   "/bin/bash", TEST_MODSTAMP_2);
+    ret = sysdb_store_users_batch(test_ctx->tctx->dom, users, 2, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(users[0].ret, EOK);
+    assert_int_equal(users[1].ret, EOK);
+
+    get_pw_timestamp_attrs(test_ctx, TEST_USER_NAME,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_2);
+
+    /* Only the changed user is written to the cache */
+    set_batch_user(test_ctx, &users[0], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/zsh", TEST_MODSTAMP_3);
+    set_batch_user(test_ctx, &users[1], TEST_USER_NAME_2, TEST_USER_UID_2,
+                   "/bin/bash", TEST_MODSTAMP_3);
+    ret = sysdb_store_users_batch(test_ctx->tctx->dom, users, 2, TEST_NOW_3);
+    assert_int_equal(ret, EOK);
+
+    get_pw_timestamp_attrs(test_ctx, TEST_USER_NAME,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    get_pw_timestamp_attrs(test_ctx, TEST_USER_NAME_2,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+
+    /* A user that is stored twice ends up with the last attributes */
+    set_batch_user(test_ctx, &users[0], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/bash", TEST_MODSTAMP_1);
+    set_batch_user(test_ctx, &users[1], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/zsh", TEST_MODSTAMP_2);
+    ret = sysdb_store_users_batch(test_ctx->tctx->dom, users, 2, TEST_NOW_4);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(users[0].ret, EOK);
+    assert_int_equal(users[1].ret, EOK);
+
+    ret = sysdb_getpwnam(test_ctx, test_ctx->tctx->dom, TEST_USER_NAME, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_string_equal(ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    SYSDB_SHELL, NULL),
+                        "/bin/zsh");
+    talloc_free(res);
+}
+
+/* The second user is outside of the ID range set by the test */
+static void set_batch_users_with_error(struct sysdb_ts_test_ctx *test_ctx,
+                                       struct sysdb_store_user_entry *users)
+{
+    set_batch_user(test_ctx, &users[0], TEST_USER_NAME, TEST_USER_UID,
+                   "/bin/bash", TEST_MODSTAMP_1);
+    set_batch_user(test_ctx, &users[1], TEST_USER_NAME_3, TEST_USER_UID - 1,
+                   "/bin/bash", TEST_MODSTAMP_1);
+    set_batch_user(test_ctx, &users[2], TEST_USER_NAME_2, TEST_USER_UID_2,
+                   "/bin/bash", TEST_MODSTAMP_1);
+}
+
+static void check_batch_users(struct sysdb_ts_test_ctx *test_ctx,
+                              struct sysdb_store_user_entry *users,
+                              errno_t *rets,
+                              size_t num_users)
+{
+    int ret;
+    struct ldb_result *res = NULL;
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+    size_t i;
+
+    for (i = 0; i < num_users; i++) {
+        assert_int_equal(users[i].ret, rets[i]);
+
+        ret = sysdb_getpwnam(test_ctx, test_ctx->tctx->dom, users[i].name,
+                             &res);
+        assert_int_equal(ret, EOK);
+        assert_int_equal(res->count, rets[i] == EOK ? 1 : 0);
+        talloc_zfree(res);
+
+        if (rets[i] != EOK) {
+            continue;
+        }
+
+        get_pw_timestamp_attrs(test_ctx, users[i].name,
+                               &cache_expire_sysdb, &cache_expire_ts);
+        assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+        assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    }
+}
+
+static void test_sysdb_user_batch_error(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct sysdb_store_user_entry users[3];
+    errno_t rets[3];
+    size_t i;
+
+    dom->id_min = TEST_USER_UID;
+    dom->id_max = TEST_USER_UID_2;
+
+    /* Store the users one by one first to get the expected results */
+    set_batch_users_with_error(test_ctx, users);
+    for (i = 0; i < 3; i++) {
+        rets[i] = sysdb_store_user(dom, users[i].name, users[i].pwd,
+                                   users[i].uid, users[i].gid,
+                                   users[i].gecos, users[i].homedir,
+                                   users[i].shell, users[i].orig_dn,
+                                   users[i].attrs, users[i].remove_attrs,
+                                   users[i].cache_timeout, TEST_NOW_1);
+        users[i].ret = rets[i];
+    }
+    assert_int_equal(rets[0], EOK);
+    assert_int_equal(rets[1], ERANGE);
+    assert_int_equal(rets[2], EOK);
+    check_batch_users(test_ctx, users, rets, 3);
+
+    for (i = 0; i < 3; i++) {
+        if (rets[i] == EOK) {
+            ret = sysdb_delete_user(dom, users[i].name, 0);
+            assert_int_equal(ret, EOK);
+        }
+    }
+
+    /* The batch returns the same result for each user. The failed user
+     * does not stop the batch, the user after it is stored as well. */
+    set_batch_users_with_error(test_ctx, users);
+    ret = sysdb_store_users_batch(dom, users, 3, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+    check_batch_users(test_ctx, users, rets, 3);
+}
+
+static void set_batch_group(struct sysdb_ts_test_ctx *test_ctx,
+                            struct sysdb_store_group_entry *group,
+                            const char *name,
+                            gid_t gid,
+                            const char *modstamp)
+{
+    memset(group, 0, sizeof(struct sysdb_store_group_entry));
+    group->name = name;
+    group->gid = gid;
+    group->attrs = create_modstamp_attrs(test_ctx, modstamp);
+    assert_non_null(group->attrs);
+    group->cache_timeout = TEST_CACHE_TIMEOUT;
+    group->ret = EIO;
+}
+
+static void test_sysdb_group_batch(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct sysdb_store_group_entry groups[2];
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+
+    /* Both groups are added */
+    set_batch_group(test_ctx, &groups[0], TEST_GROUP_NAME, TEST_GROUP_GID,
+                    TEST_MODSTAMP_1);
+    set_batch_group(test_ctx, &groups[1], TEST_GROUP_NAME_2, TEST_GROUP_GID_2,
+                    TEST_MODSTAMP_1);
+    ret = sysdb_store_groups_batch(test_ctx->tctx->dom, groups, 2, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(groups[0].ret, EOK);
+    assert_int_equal(groups[1].ret, EOK);
+
+    get_gr_timestamp_attrs(test_ctx, TEST_GROUP_NAME_2,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+
+    /* The same modifyTimestamp only bumps the timestamp cache */
+    set_batch_group(test_ctx, &groups[0], TEST_GROUP_NAME, TEST_GROUP_GID,
+                    TEST_MODSTAMP_1);
+    set_batch_group(test_ctx, &groups[1], TEST_GROUP_NAME_2, TEST_GROUP_GID_2,
+                    TEST_MODSTAMP_1);
+    ret = sysdb_store_groups_batch(test_ctx->tctx->dom, groups, 2, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+
+    get_gr_timestamp_attrs(test_ctx, TEST_GROUP_NAME,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_2);
+
+    /* A changed group is written to both caches */
+    set_batch_group(test_ctx, &groups[0], TEST_GROUP_NAME, TEST_GROUP_GID,
+                    TEST_MODSTAMP_1);
+    set_batch_group(test_ctx, &groups[1], TEST_GROUP_NAME_2, TEST_GROUP_GID_3,
+                    TEST_MODSTAMP_2);
+    ret = sysdb_store_groups_batch(test_ctx->tctx->dom, groups, 2, TEST_NOW_3);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(groups[1].ret, EOK);
+
+    get_gr_timestamp_attrs(test_ctx, TEST_GROUP_NAME,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    get_gr_timestamp_attrs(test_ctx, TEST_GROUP_NAME_2,
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -1767,6 +2029,15 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_group_missing_ts,
                                         test_sysdb_ts_setup,
                                         test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_user_batch,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_user_batch_error,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_group_batch,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
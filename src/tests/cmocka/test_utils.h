@@ -40,5 +40,10 @@ void test_sss_ptr_hash_overwrite_with_free_cb(void **state);
 void test_sss_ptr_hash_with_lookup_cb(void **state);
 void test_sss_ptr_hash_without_cb(void **state);
 
+/* from src/tests/cmocka/test_sss_ptr_cache.c */
+void test_sss_ptr_cache_lookup(void **state);
+void test_sss_ptr_cache_evict(void **state);
+void test_sss_ptr_cache_flush(void **state);
+
 
 #endif /* __TESTS__CMOCKA__TEST_UTILS_H__ */
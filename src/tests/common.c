@@ -119,6 +119,18 @@ bool ldb_modules_path_is_set(void)
     return false;
 }
 
+bool test_benchmark_enabled(void)
+{
+    const char *value;
+
+    value = getenv("SSS_TEST_BENCHMARK");
+    if (value == NULL || *value == '\0' || strcmp(value, "0") == 0) {
+        return false;
+    }
+
+    return true;
+}
+
 /* Returns true if all values are in array (else returns false) */
 bool are_values_in_array(const char **values, size_t values_len,
                          const char **array, size_t array_len)
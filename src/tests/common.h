@@ -138,6 +138,10 @@ void test_ev_done(struct sss_test_ctx *tctx, errno_t ret);
 
 bool ldb_modules_path_is_set(void);
 
+/* Benchmarks are slow and only informative, they run only if
+ * SSS_TEST_BENCHMARK is set in the environment */
+bool test_benchmark_enabled(void);
+
 struct sss_domain_info *named_domain(TALLOC_CTX *mem_ctx,
                                      const char *name,
                                      struct sss_domain_info *parent);
@@ -22,6 +22,7 @@ import stat
 import pwd
 import grp
 import signal
+import multiprocessing
 import subprocess
 import time
 import ldap
@@ -2105,3 +2106,64 @@ def test_conflicting_mail_addresses(request, ldap_conn, cache_first):
     # However resolving the users on their own must work
     ent.assert_passwd_by_name("userx", dict(name="userx", uid=1004, gid=2004))
     ent.assert_passwd_by_name("usery", dict(name="usery", uid=1005, gid=2005))
+
+
+POOL_LOAD_USERS = 200
+POOL_LOAD_GROUPS = 20
+
+
+@pytest.fixture
+def connection_pool_rfc2307_bis(request, ldap_conn):
+    ent_list = ldap_ent.List(ldap_conn.ds_inst.base_dn)
+    for i in range(POOL_LOAD_USERS):
+        ent_list.add_user("pooluser%d" % i, 10000 + i, 20000)
+    ent_list.add_group_bis("poolprimary", 20000)
+    for i in range(POOL_LOAD_GROUPS):
+        members = ["pooluser%d" % j
+                   for j in range(i, POOL_LOAD_USERS, POOL_LOAD_GROUPS)]
+        ent_list.add_group_bis("poolgroup%d" % i, 20001 + i, members)
+    create_ldap_fixture(request, ldap_conn, ent_list)
+
+    conf = \
+        format_basic_conf(ldap_conn, SCHEMA_RFC2307_BIS) + \
+        unindent("""
+            [domain/LDAP]
+            ldap_connection_pool_size = 4
+        """)
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
+def pool_lookup(i):
+    """Resolve a user and its groups, return an error message or None"""
+    name = "pooluser%d" % i
+    try:
+        if pwd.getpwnam(name).pw_uid != 10000 + i:
+            return "unexpected UID of " + name
+        groups = os.getgrouplist(name, 20000)
+        if 20001 + i % POOL_LOAD_GROUPS not in groups:
+            return "%s is missing in poolgroup%d" % (name,
+                                                     i % POOL_LOAD_GROUPS)
+        if i % 10 == 0:
+            group = grp.getgrnam("poolgroup%d" % (i % POOL_LOAD_GROUPS))
+            if name not in group.gr_mem:
+                return "%s is not a member of %s" % (name, group.gr_name)
+    except KeyError as e:
+        return "lookup failed: %s" % e
+    return None
+
+
+def test_connection_pool_load(ldap_conn, connection_pool_rfc2307_bis):
+    """
+    Resolve many users and their groups concurrently while the lookups
+    are spread over several connections to the server
+    """
+    with multiprocessing.Pool(16) as workers:
+        start = time.time()
+        errors = workers.map(pool_lookup, range(POOL_LOAD_USERS))
+        duration = time.time() - start
+
+    errors = [e for e in errors if e is not None]
+    assert errors == []
+    print("Resolved %d users in %.2f seconds" % (POOL_LOAD_USERS, duration))
@@ -41,6 +41,10 @@ typedef uint32_t rel_ptr_t;
 #define MC_HT_SIZE(elems) ( (elems) * MC_32 )
 #define MC_HT_ELEMS(size) ( (size) / MC_32 )
 
+#define MC_CACHE_LINE 64
+#define MC_ALIGN_CL(size) \
+    ( ((size) + MC_CACHE_LINE - 1) & (~(MC_CACHE_LINE - 1)) )
+
 #define MC_PTR_ADD(ptr, bytes) (void *)((uint8_t *)(ptr) + (bytes))
 #define MC_PTR_DIFF(ptr, base) ((uint8_t *)(ptr) - (uint8_t *)(base))
 
@@ -69,6 +73,12 @@ typedef uint32_t rel_ptr_t;
 
 #define MC_VALID_BARRIER(val) (((val) & 0xff000000) == 0xf0000000)
 
+/* The header seqnum is a table wide sequence counter. The writer makes it
+ * odd before it touches the hash chains and even again once they are
+ * consistent, readers use it to tell a genuine miss from a walk that raced
+ * with a concurrent update. */
+#define MC_SEQ_WRITE_IN_PROGRESS(seq) (((seq) & 1) != 0)
+
 #define MC_CHECK_RECORD_LENGTH(mc_ctx, rec) \
         ((rec)->len >= MC_HEADER_SIZE && (rec)->len != MC_INVALID_VAL32 \
          && ((rec)->len <= ((mc_ctx)->dt_size \
@@ -78,6 +88,22 @@ typedef uint32_t rel_ptr_t;
 #define SSS_MC_MAJOR_VNO    1
 #define SSS_MC_MINOR_VNO    1
 
+/* Version 2 of the format adds a cache line bucketed index next to the
+ * version 1 hash table and chains. Older clients check the version 1 header
+ * for an exact version match, so it keeps announcing 1.1 and the version 2
+ * header is stored right after it, before the data table. Clients that know
+ * about it use the bucket table, others keep walking the hash chains. */
+#define SSS_MC_V2_MAGIC     0x324d5353  /* "SSM2" */
+#define SSS_MC_V2_MAJOR_VNO 2
+#define SSS_MC_V2_MINOR_VNO 0
+
+/* Every bucket fills exactly one cache line and holds this many entries */
+#define MC_BUCKET_ENTRIES   8
+/* Number of hash table elements per bucket, keeps the load factor of the
+ * bucket table at or below 50% even if the cache is full of minimal
+ * records */
+#define MC_HT_ELEMS_PER_BUCKET 4
+
 #define SSS_MC_HEADER_UNINIT    0   /* after ftruncate or before reset */
 #define SSS_MC_HEADER_ALIVE     1   /* current and in use */
 #define SSS_MC_HEADER_RECYCLED  2   /* file was recycled, reopen asap */
@@ -95,7 +121,7 @@ struct sss_mc_header {
     rel_ptr_t data_table;   /* data table pointer relative to mmap base */
     rel_ptr_t free_table;   /* free table pointer relative to mmap base */
     rel_ptr_t hash_table;   /* hash table pointer relative to mmap base */
-    rel_ptr_t reserved;     /* reserved for future changes */
+    uint32_t seqnum;        /* hash chains write sequence (was reserved) */
     uint32_t b2;            /* barrier 2 */
 };
 
@@ -109,11 +135,35 @@ struct sss_mc_rec {
                             /* next2 is related to hash2 */
     uint32_t hash1;         /* val of first hash (usually name of record) */
     uint32_t hash2;         /* val of second hash (usually id of record) */
-    uint32_t padding;       /* padding & reserved for future changes */
+    uint32_t fps;           /* index fingerprints, low 16 bits for hash1
+                             * and high 16 bits for hash2 (was padding) */
     uint32_t b2;            /* barrier 2 - 32 bytes mark, fits a slot */
     char data[0];
 };
 
+struct sss_mc_header_v2 {
+    uint32_t b1;            /* barrier 1 */
+    uint32_t magic;         /* SSS_MC_V2_MAGIC */
+    uint32_t major_vno;     /* index major version number */
+    uint32_t minor_vno;     /* index minor version number */
+    uint32_t nbuckets;      /* number of buckets in bucket table */
+    uint32_t bt_size;       /* bucket table size */
+    rel_ptr_t bucket_table; /* bucket table pointer relative to mmap base */
+    uint32_t b2;            /* barrier 2 */
+};
+
+/* Open addressing with linear probing. A key lives in its home bucket
+ * (hash % nbuckets) or, if that one was full, in one of the following
+ * buckets; 'overflow' counts the entries that were pushed past this bucket
+ * so a lookup can stop at the first bucket where it is zero. */
+struct sss_mc_bucket {
+    uint32_t seq;           /* odd while the bucket is being modified */
+    uint32_t overflow;      /* entries that probed past this bucket */
+    uint16_t fp[MC_BUCKET_ENTRIES];     /* key fingerprints, 0 = free */
+    rel_ptr_t slot[MC_BUCKET_ENTRIES];  /* record slot of each entry */
+    uint32_t reserved[2];   /* pads the bucket to MC_CACHE_LINE */
+};
+
 struct sss_mc_pwd_data {
     rel_ptr_t name;         /* ptr to name string, rel. to struct base addr */
     uint32_t uid;
@@ -155,7 +205,39 @@ struct sss_mc_sid_data {
     char sid[0];
 };
 
+struct sss_mc_neg_data {
+    rel_ptr_t name;         /* ptr to key string, rel. to struct base addr */
+    uint32_t type;          /* enum sss_mc_neg_type */
+    uint32_t id;            /* uid or gid, 0 for name keys */
+    uint32_t key_len;       /* length of key */
+    char key[0];            /* "<type>:<name>" or "<type>:<id>" */
+};
+
 #pragma pack()
 
+/* Types of entries of the negative cache, the type is part of the key so
+ * the same name can be recorded as a missing user and a missing group */
+enum sss_mc_neg_type {
+    SSS_MC_NEG_USER_NAME = 1,
+    SSS_MC_NEG_UID,
+    SSS_MC_NEG_GROUP_NAME,
+    SSS_MC_NEG_GID,
+};
+
+/* Negative cache keys, the key is used for both record hashes */
+#define SSS_MC_NEG_NAME_KEY_FMT "%d:%s"
+#define SSS_MC_NEG_ID_KEY_FMT   "%d:%lu"
+/* Longest id key: "<type>:" and a 32 bit number */
+#define SSS_MC_NEG_ID_KEY_MAX   16
+
+/* Fingerprints are taken from the upper half of the unreduced key hash
+ * so they are independent of the home bucket. 0 marks a free entry. */
+static inline uint16_t sss_mc_fingerprint(uint32_t full_hash)
+{
+    uint16_t fp = full_hash >> 16;
+
+    return fp == 0 ? 1 : fp;
+}
+
 
 #endif /* _MMAP_CACHE_H_ */
@@ -59,6 +59,14 @@ int sss_ldap_get_diagnostic_msg(TALLOC_CTX *mem_ctx,
 #define LDAP_SERVER_SD_OID "1.2.840.113556.1.4.801"
 #endif /* LDAP_SERVER_SD_OID */
 
+#ifndef LDAP_SERVER_NOTIFICATION_OID
+#define LDAP_SERVER_NOTIFICATION_OID "1.2.840.113556.1.4.528"
+#endif /* LDAP_SERVER_NOTIFICATION_OID */
+
+#ifndef LDAP_CONTROL_PERSIST_REQUEST
+#define LDAP_CONTROL_PERSIST_REQUEST "2.16.840.1.113730.3.4.3"
+#endif /* LDAP_CONTROL_PERSIST_REQUEST */
+
 
 /*
  * The following four flags specify which security descriptor parts to retrieve
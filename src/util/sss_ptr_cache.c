@@ -0,0 +1,215 @@
+/*
+    SSSD
+
+    Bounded in-memory cache of talloc pointers with expiring entries
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/dlinklist.h"
+#include "util/sss_ptr_hash.h"
+#include "util/sss_ptr_cache.h"
+
+/*
+ * When the cache is full, an entry is evicted with the CLOCK algorithm: the
+ * hand walks the list of entries and evicts the first one that was not used
+ * since the hand passed it the last time.
+ */
+
+struct sss_ptr_cache_entry {
+    struct sss_ptr_cache_entry *prev;
+    struct sss_ptr_cache_entry *next;
+
+    struct sss_ptr_cache *cache;
+    time_t expire;
+    bool referenced;
+
+    void *ptr;
+};
+
+struct sss_ptr_cache {
+    hash_table_t *table;
+    struct sss_ptr_cache_entry *entries;
+    struct sss_ptr_cache_entry *hand;
+    size_t num_entries;
+    size_t max_entries;
+    time_t timeout;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+struct sss_ptr_cache *
+sss_ptr_cache_create(TALLOC_CTX *mem_ctx,
+                     size_t max_entries,
+                     time_t timeout)
+{
+    struct sss_ptr_cache *cache;
+
+    if (max_entries == 0) {
+        return NULL;
+    }
+
+    cache = talloc_zero(mem_ctx, struct sss_ptr_cache);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->table = sss_ptr_hash_create(cache, NULL, NULL);
+    if (cache->table == NULL) {
+        talloc_free(cache);
+        return NULL;
+    }
+
+    cache->max_entries = max_entries;
+    cache->timeout = timeout;
+
+    return cache;
+}
+
+static int sss_ptr_cache_entry_destructor(struct sss_ptr_cache_entry *entry)
+{
+    struct sss_ptr_cache *cache = entry->cache;
+
+    if (cache->hand == entry) {
+        cache->hand = entry->next;
+    }
+
+    DLIST_REMOVE(cache->entries, entry);
+    cache->num_entries--;
+
+    return 0;
+}
+
+static void sss_ptr_cache_evict(struct sss_ptr_cache *cache)
+{
+    struct sss_ptr_cache_entry *entry;
+
+    while (cache->num_entries >= cache->max_entries) {
+        if (cache->hand == NULL) {
+            cache->hand = cache->entries;
+        }
+
+        entry = cache->hand;
+        if (entry->referenced) {
+            entry->referenced = false;
+            cache->hand = entry->next;
+            continue;
+        }
+
+        /* Moves the hand and removes the entry from the table. */
+        talloc_free(entry);
+    }
+}
+
+errno_t sss_ptr_cache_add(struct sss_ptr_cache *cache,
+                          const char *key,
+                          void *talloc_ptr)
+{
+    struct sss_ptr_cache_entry *entry;
+    errno_t ret;
+
+    /* Drop the previous entry before making room for the new one. */
+    sss_ptr_hash_delete(cache->table, key, true);
+    sss_ptr_cache_evict(cache);
+
+    entry = talloc_zero(cache, struct sss_ptr_cache_entry);
+    if (entry == NULL) {
+        talloc_free(talloc_ptr);
+        return ENOMEM;
+    }
+
+    entry->cache = cache;
+    entry->expire = time(NULL) + cache->timeout;
+    entry->ptr = talloc_steal(entry, talloc_ptr);
+
+    ret = sss_ptr_hash_add(cache->table, key, entry,
+                           struct sss_ptr_cache_entry);
+    if (ret != EOK) {
+        talloc_free(entry);
+        return ret;
+    }
+
+    /* New entries are placed right behind the hand so they get a full
+     * round before they are considered for eviction. */
+    if (cache->hand == NULL || cache->hand == cache->entries) {
+        DLIST_ADD_END(cache->entries, entry, struct sss_ptr_cache_entry *);
+    } else {
+        DLIST_ADD_AFTER(cache->entries, entry, cache->hand->prev);
+    }
+    cache->num_entries++;
+    talloc_set_destructor(entry, sss_ptr_cache_entry_destructor);
+
+    return EOK;
+}
+
+void *sss_ptr_cache_lookup(struct sss_ptr_cache *cache,
+                           const char *key,
+                           sss_ptr_cache_match_fn valid_fn,
+                           void *pvt)
+{
+    struct sss_ptr_cache_entry *entry;
+
+    entry = sss_ptr_hash_lookup(cache->table, key,
+                                struct sss_ptr_cache_entry);
+    if (entry != NULL
+            && (entry->expire < time(NULL)
+                || (valid_fn != NULL && !valid_fn(entry->ptr, pvt)))) {
+        talloc_free(entry);
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        cache->misses++;
+        return NULL;
+    }
+
+    entry->referenced = true;
+    cache->hits++;
+
+    return entry->ptr;
+}
+
+void sss_ptr_cache_delete(struct sss_ptr_cache *cache,
+                          const char *key)
+{
+    sss_ptr_hash_delete(cache->table, key, true);
+}
+
+void sss_ptr_cache_flush(struct sss_ptr_cache *cache,
+                         sss_ptr_cache_match_fn match_fn,
+                         void *pvt)
+{
+    struct sss_ptr_cache_entry *entry;
+    struct sss_ptr_cache_entry *next;
+
+    DLIST_FOR_EACH_SAFE(entry, next, cache->entries) {
+        if (match_fn == NULL || match_fn(entry->ptr, pvt)) {
+            talloc_free(entry);
+        }
+    }
+}
+
+void sss_ptr_cache_get_stats(struct sss_ptr_cache *cache,
+                             uint64_t *_hits,
+                             uint64_t *_misses)
+{
+    *_hits = cache == NULL ? 0 : cache->hits;
+    *_misses = cache == NULL ? 0 : cache->misses;
+}
@@ -0,0 +1,94 @@
+/*
+    SSSD
+
+    Bounded in-memory cache of talloc pointers with expiring entries
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SSS_PTR_CACHE_H_
+#define _SSS_PTR_CACHE_H_
+
+#include <talloc.h>
+
+#include "util/util.h"
+
+struct sss_ptr_cache;
+
+/**
+ * Called with a cached talloc pointer @ptr and the private data @pvt
+ * passed to sss_ptr_cache_lookup() or sss_ptr_cache_flush().
+ */
+typedef bool (*sss_ptr_cache_match_fn)(void *ptr, void *pvt);
+
+/**
+ * Create a new cache with at most @max_entries entries which are kept for
+ * @timeout seconds. When the cache is full, an entry that was not used
+ * recently is evicted to make room for a new one.
+ *
+ * @return New cache or NULL on failure.
+ */
+struct sss_ptr_cache *
+sss_ptr_cache_create(TALLOC_CTX *mem_ctx,
+                     size_t max_entries,
+                     time_t timeout);
+
+/**
+ * Store @talloc_ptr under @key, replacing the previous entry. The cache
+ * takes over @talloc_ptr, it is freed when the entry is removed or if it
+ * cannot be stored.
+ *
+ * @return EOK If the pointer was stored.
+ * @return Other errno code in case of an error.
+ */
+errno_t sss_ptr_cache_add(struct sss_ptr_cache *cache,
+                          const char *key,
+                          void *talloc_ptr);
+
+/**
+ * Lookup @key in the cache. An expired entry, or one for which @valid_fn
+ * returns false, is removed. The lookup is counted as a hit or a miss.
+ *
+ * @return talloc_ptr If a valid entry was found.
+ * @return NULL Otherwise.
+ */
+void *sss_ptr_cache_lookup(struct sss_ptr_cache *cache,
+                           const char *key,
+                           sss_ptr_cache_match_fn valid_fn,
+                           void *pvt);
+
+/**
+ * Remove @key from the cache.
+ */
+void sss_ptr_cache_delete(struct sss_ptr_cache *cache,
+                          const char *key);
+
+/**
+ * Remove all entries for which @match_fn returns true, or all entries if
+ * @match_fn is NULL.
+ */
+void sss_ptr_cache_flush(struct sss_ptr_cache *cache,
+                         sss_ptr_cache_match_fn match_fn,
+                         void *pvt);
+
+/**
+ * Return the number of hits and misses of the lookups, @cache may be NULL.
+ */
+void sss_ptr_cache_get_stats(struct sss_ptr_cache *cache,
+                             uint64_t *_hits,
+                             uint64_t *_misses);
+
+#endif /* _SSS_PTR_CACHE_H_ */